@@ -47,21 +47,49 @@
 static clientid4 pxy_clientid;
 static pthread_mutex_t pxy_clientid_mutex = PTHREAD_MUTEX_INITIALIZER;
 static char pxy_hostname[MAXNAMLEN + 1];
-static pthread_t pxy_recv_thread;
 static pthread_t pxy_renewer_thread;
-static struct glist_head rpc_calls;
 static struct glist_head free_contexts;
-static int rpc_sock = -1;
 static uint32_t rpc_xid;
+static pthread_cond_t need_context = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Protects the connection counts below and the "sockless" condition.
+ */
 static pthread_mutex_t listlock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t sockless = PTHREAD_COND_INITIALIZER;
-static pthread_cond_t need_context = PTHREAD_COND_INITIALIZER;
+static unsigned int pxy_nconnected;
+static unsigned int pxy_lead_gen;	/* Bumped when connection 0 connects */
 
 /*
  * Protects the "free_contexts" list and the "need_context" condition.
  */
 static pthread_mutex_t context_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Outstanding calls of a connection are hashed on their xid */
+#define PXY_RPC_XID_BUCKETS 64
+
+/*
+ * One TCP stream to the server, with its own receiver thread.  Any
+ * number of calls may be outstanding on it at once.
+ *
+ * sock is only changed by the receiver thread and only while holding
+ * send_lock, so senders holding send_lock can never write to a stale
+ * descriptor.
+ */
+struct pxy_rpc_conn {
+	pthread_mutex_t send_lock;	/* Serializes writes on sock */
+	pthread_mutex_t calls_lock;	/* Protects calls */
+	struct glist_head calls[PXY_RPC_XID_BUCKETS];
+	int sock;
+	unsigned int index;
+	pthread_t recv_thread;
+	const proxyfs_specific_initinfo_t *info;
+};
+
+static struct pxy_rpc_conn *pxy_conns;
+static unsigned int pxy_nconns;
+static uint32_t pxy_next_conn;
+
 /* NB! nfs_prog is just an easy way to get this info into the call
  *     It should really be fetched via export pointer */
 struct pxy_rpc_io_context {
@@ -255,6 +283,23 @@ static struct bitmap4 pxy_bitmap_readdir = {
 	.bitmap4_len = 1
 };
 
+/* With the attribute cache on, have readdir bring back what a lookup
+ * would so that the lookups following it are served from the cache */
+static struct bitmap4 pxy_bitmap_readdir_prefetch = {
+	.map[0] =
+	    (PXY_ATTR_BIT(FATTR4_TYPE) | PXY_ATTR_BIT(FATTR4_CHANGE) |
+	     PXY_ATTR_BIT(FATTR4_SIZE) | PXY_ATTR_BIT(FATTR4_FSID) |
+	     PXY_ATTR_BIT(FATTR4_FILEHANDLE) | PXY_ATTR_BIT(FATTR4_FILEID)),
+	.map[1] =
+	    (PXY_ATTR_BIT2(FATTR4_MODE) | PXY_ATTR_BIT2(FATTR4_NUMLINKS) |
+	     PXY_ATTR_BIT2(FATTR4_OWNER) | PXY_ATTR_BIT2(FATTR4_OWNER_GROUP) |
+	     PXY_ATTR_BIT2(FATTR4_SPACE_USED) |
+	     PXY_ATTR_BIT2(FATTR4_TIME_ACCESS) |
+	     PXY_ATTR_BIT2(FATTR4_TIME_METADATA) |
+	     PXY_ATTR_BIT2(FATTR4_TIME_MODIFY) | PXY_ATTR_BIT2(FATTR4_RAWDEV)),
+	.bitmap4_len = 2
+};
+
 static struct bitmap4 pxy_bitmap_fsinfo = {
 	.map[0] =
 	    (PXY_ATTR_BIT(FATTR4_FILES_AVAIL) | PXY_ATTR_BIT(FATTR4_FILES_FREE)
@@ -375,7 +420,13 @@ static int pxy_got_rpc_reply(struct pxy_rpc_io_context *ctx, int sock, int sz,
 	return size;
 }
 
-static int pxy_rpc_read_reply(int sock)
+static inline struct glist_head *pxy_xid_bucket(struct pxy_rpc_conn *conn,
+						uint32_t xid)
+{
+	return &conn->calls[xid % PXY_RPC_XID_BUCKETS];
+}
+
+static int pxy_rpc_read_reply(struct pxy_rpc_conn *conn, int sock)
 {
 	struct {
 		uint recmark;
@@ -390,6 +441,8 @@ static int pxy_rpc_read_reply(int sock)
 		int bc = read(sock, buf + cnt, 8 - cnt);
 		if (bc < 0)
 			return -errno;
+		if (bc == 0)
+			return -ECONNRESET;
 		cnt += bc;
 	}
 
@@ -400,18 +453,18 @@ static int pxy_rpc_read_reply(int sock)
 	LogDebug(COMPONENT_FSAL, "Recmark %x, xid %u\n", h.recmark, h.xid);
 	h.recmark &= ~(1U << 31);
 
-	pthread_mutex_lock(&listlock);
-	glist_for_each(c, &rpc_calls) {
+	pthread_mutex_lock(&conn->calls_lock);
+	glist_for_each(c, pxy_xid_bucket(conn, h.xid)) {
 		struct pxy_rpc_io_context *ctx =
 		    container_of(c, struct pxy_rpc_io_context, calls);
 
 		if (ctx->rpc_xid == h.xid) {
 			glist_del(c);
-			pthread_mutex_unlock(&listlock);
+			pthread_mutex_unlock(&conn->calls_lock);
 			return pxy_got_rpc_reply(ctx, sock, h.recmark, h.xid);
 		}
 	}
-	pthread_mutex_unlock(&listlock);
+	pthread_mutex_unlock(&conn->calls_lock);
 
 	cnt = h.recmark - 4;
 	LogDebug(COMPONENT_FSAL, "xid %u is not on the list, skip %d bytes\n",
@@ -428,28 +481,32 @@ static int pxy_rpc_read_reply(int sock)
 	return 0;
 }
 
-static void pxy_new_socket_ready(void)
+/*
+ * The socket of conn is gone: tell the calls that went out on it to
+ * resend, they will pick whichever connection is up.
+ */
+static void pxy_rpc_fail_calls(struct pxy_rpc_conn *conn)
 {
 	struct glist_head *nxt;
 	struct glist_head *c;
+	int i;
 
-	/* If there is anyone waiting for the socket then tell them
-	 * it's ready */
-	pthread_cond_broadcast(&sockless);
-
-	/* If there are any outstanding calls then tell them to resend */
-	glist_for_each_safe(c, nxt, &rpc_calls) {
-		struct pxy_rpc_io_context *ctx =
-		    container_of(c, struct pxy_rpc_io_context, calls);
+	pthread_mutex_lock(&conn->calls_lock);
+	for (i = 0; i < PXY_RPC_XID_BUCKETS; i++) {
+		glist_for_each_safe(c, nxt, &conn->calls[i]) {
+			struct pxy_rpc_io_context *ctx =
+			    container_of(c, struct pxy_rpc_io_context, calls);
 
-		glist_del(c);
+			glist_del(c);
 
-		pthread_mutex_lock(&ctx->iolock);
-		ctx->iodone = 1;
-		ctx->ioresult = -EAGAIN;
-		pthread_cond_signal(&ctx->iowait);
-		pthread_mutex_unlock(&ctx->iolock);
+			pthread_mutex_lock(&ctx->iolock);
+			ctx->iodone = 1;
+			ctx->ioresult = -EAGAIN;
+			pthread_cond_signal(&ctx->iowait);
+			pthread_mutex_unlock(&ctx->iolock);
+		}
 	}
+	pthread_mutex_unlock(&conn->calls_lock);
 }
 
 static int pxy_connect(const proxyfs_specific_initinfo_t *info,
@@ -473,26 +530,50 @@ static int pxy_connect(const proxyfs_specific_initinfo_t *info,
 		if (connect(sock, (struct sockaddr *)dest, sizeof(*dest)) < 0) {
 			close(sock);
 			sock = -1;
-		} else {
-			pxy_new_socket_ready();
 		}
 	}
 	return sock;
 }
 
 /*
- * NB! rpc_sock can be closed by the sending thread but it will not be
- *     changing its value. Only this function will change rpc_sock which
- *     means that it can look at the value without holding the lock.
+ * Publish or withdraw the socket of a connection.  Senders hold
+ * send_lock while they use conn->sock, so once this returns with
+ * sock < 0 nobody will write to the old descriptor anymore.
+ */
+static void pxy_rpc_set_sock(struct pxy_rpc_conn *conn, int sock)
+{
+	pthread_mutex_lock(&conn->send_lock);
+	conn->sock = sock;
+	pthread_mutex_unlock(&conn->send_lock);
+
+	pthread_mutex_lock(&listlock);
+	if (sock >= 0) {
+		pxy_nconnected++;
+		if (conn->index == 0)
+			pxy_lead_gen++;
+		/* If there is anyone waiting for a socket then tell them
+		 * one is ready */
+		pthread_cond_broadcast(&sockless);
+	} else {
+		pxy_nconnected--;
+	}
+	pthread_mutex_unlock(&listlock);
+}
+
+/*
+ * Receiver thread of one connection: (re)connects it and matches the
+ * replies read from it to the calls waiting for them.
  */
 static void *pxy_rpc_recv(void *arg)
 {
-	const proxyfs_specific_initinfo_t *info = arg;
+	struct pxy_rpc_conn *conn = arg;
+	const proxyfs_specific_initinfo_t *info = conn->info;
 	struct sockaddr_in addr_rpc;
 	struct sockaddr_in *info_sock = (struct sockaddr_in *)&info->srv_addr;
 	char addr[INET_ADDRSTRLEN];
 	struct pollfd pfd;
 	int millisec = info->srv_timeout * 1000;
+	int sock;
 
 	memset(&addr_rpc, 0, sizeof(addr_rpc));
 	addr_rpc.sin_family = AF_INET;
@@ -502,10 +583,10 @@ static void *pxy_rpc_recv(void *arg)
 
 	for (;;) {
 		int nsleeps = 0;
-		pthread_mutex_lock(&listlock);
+
 		do {
-			rpc_sock = pxy_connect(info, &addr_rpc);
-			if (rpc_sock < 0) {
+			sock = pxy_connect(info, &addr_rpc);
+			if (sock < 0) {
 				if (nsleeps == 0)
 					LogCrit(COMPONENT_FSAL,
 						"Cannot connect to server %s:%u",
@@ -514,52 +595,51 @@ static void *pxy_rpc_recv(void *arg)
 							  addr,
 							  sizeof(addr)),
 						ntohs(info->srv_port));
-				pthread_mutex_unlock(&listlock);
 				sleep(info->retry_sleeptime);
 				nsleeps++;
-				pthread_mutex_lock(&listlock);
 			} else {
 				LogDebug(COMPONENT_FSAL,
-					 "Connected after %d sleeps, "
-					 "resending outstanding calls",
-					 nsleeps);
+					 "Connection %u connected after %d sleeps",
+					 conn->index, nsleeps);
 			}
-		} while (rpc_sock < 0);
-		pthread_mutex_unlock(&listlock);
+		} while (sock < 0);
 
-		pfd.fd = rpc_sock;
+		pxy_rpc_set_sock(conn, sock);
+
+		pfd.fd = sock;
 		pfd.events = POLLIN | POLLRDHUP;
 
-		while (rpc_sock >= 0) {
-			switch (poll(&pfd, 1, millisec)) {
-			case 0:
+		for (;;) {
+			int rc = poll(&pfd, 1, millisec);
+
+			if (rc == 0) {
 				LogDebug(COMPONENT_FSAL,
 					 "Timeout, wait again...");
 				continue;
-
-			case -1:
+			}
+			if (rc == -1) {
+				if (errno == EINTR)
+					continue;
 				break;
-
-			default:
-				if (pfd.revents & POLLRDHUP) {
-					LogEvent(COMPONENT_FSAL,
-						 "Other end has closed "
-						 "connection, reconnecting...");
-				} else if (pfd.revents & POLLNVAL) {
-					LogEvent(COMPONENT_FSAL,
-						 "Socket is closed");
-				} else {
-					if (pxy_rpc_read_reply(rpc_sock) >= 0)
-						continue;
-				}
+			}
+			if (pfd.revents & POLLRDHUP) {
+				LogEvent(COMPONENT_FSAL,
+					 "Other end has closed "
+					 "connection, reconnecting...");
 				break;
 			}
-
-			pthread_mutex_lock(&listlock);
-			close(rpc_sock);
-			rpc_sock = -1;
-			pthread_mutex_unlock(&listlock);
+			if (pfd.revents & (POLLNVAL | POLLERR | POLLHUP)) {
+				LogEvent(COMPONENT_FSAL,
+					 "Socket is closed");
+				break;
+			}
+			if (pxy_rpc_read_reply(conn, sock) < 0)
+				break;
 		}
+
+		pxy_rpc_set_sock(conn, -1);
+		close(sock);
+		pxy_rpc_fail_calls(conn);
 	}
 
 	return NULL;
@@ -652,25 +732,51 @@ static enum clnt_stat pxy_process_reply(struct pxy_rpc_io_context *ctx,
 static void pxy_rpc_need_sock(void)
 {
 	pthread_mutex_lock(&listlock);
-	while (rpc_sock < 0)
+	while (pxy_nconnected == 0)
 		pthread_cond_wait(&sockless, &listlock);
 	pthread_mutex_unlock(&listlock);
 }
 
+/*
+ * Wait for the lease renewal time.  Returns false early if the lead
+ * connection came back in the meantime, which calls for a new client
+ * id in case the server restarted.
+ */
 static int pxy_rpc_renewer_wait(int timeout)
 {
 	struct timespec ts;
-	int rc;
+	unsigned int gen;
+	int rc = 0;
 
 	pthread_mutex_lock(&listlock);
 	ts.tv_sec = time(NULL) + timeout;
 	ts.tv_nsec = 0;
 
-	rc = pthread_cond_timedwait(&sockless, &listlock, &ts);
+	gen = pxy_lead_gen;
+	while (gen == pxy_lead_gen && rc != ETIMEDOUT)
+		rc = pthread_cond_timedwait(&sockless, &listlock, &ts);
 	pthread_mutex_unlock(&listlock);
 	return (rc == ETIMEDOUT);
 }
 
+/*
+ * Spread the calls over the connections that are up.
+ */
+static struct pxy_rpc_conn *pxy_rpc_pick_conn(void)
+{
+	unsigned int start = atomic_postinc_uint32_t(&pxy_next_conn);
+	unsigned int i;
+
+	for (i = 0; i < pxy_nconns; i++) {
+		struct pxy_rpc_conn *conn =
+		    &pxy_conns[(start + i) % pxy_nconns];
+
+		if (conn->sock >= 0)
+			return conn;
+	}
+	return NULL;
+}
+
 static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 			       const struct user_cred *cred,
 			       COMPOUND4args *args, COMPOUND4res *res)
@@ -679,10 +785,13 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 	struct rpc_msg rmsg;
 	AUTH *au;
 	enum clnt_stat rc;
+	struct pxy_rpc_conn *conn;
 
-	pthread_mutex_lock(&listlock);
-	rmsg.rm_xid = rpc_xid++;
-	pthread_mutex_unlock(&listlock);
+	conn = pxy_rpc_pick_conn();
+	if (conn == NULL)
+		return RPC_CANTSEND;
+
+	rmsg.rm_xid = atomic_postinc_uint32_t(&rpc_xid);
 	rmsg.rm_direction = CALL;
 
 	rmsg.rm_call.cb_rpcvers = RPC_MSG_VERSION;
@@ -719,36 +828,48 @@ static int pxy_compoundv4_call(struct pxy_rpc_io_context *pcontext,
 		do {
 			int bc = 0;
 			char *buf = pcontext->sendbuf;
-			LogDebug(COMPONENT_FSAL, "%ssend XID %u with %d bytes",
+			LogDebug(COMPONENT_FSAL,
+				 "%ssend XID %u with %d bytes on connection %u",
 				 (first_try ? "First attempt to " : "Re"),
-				 rmsg.rm_xid, pos);
-			pthread_mutex_lock(&listlock);
-			while (bc < pos) {
-				int wc = write(rpc_sock, buf, pos - bc);
+				 rmsg.rm_xid, pos, conn->index);
+
+			/* Be on the list before the reply can come in */
+			if (first_try) {
+				pthread_mutex_lock(&conn->calls_lock);
+				glist_add_tail(pxy_xid_bucket(conn,
+							      rmsg.rm_xid),
+					       &pcontext->calls);
+				pthread_mutex_unlock(&conn->calls_lock);
+				first_try = 0;
+			}
+
+			pthread_mutex_lock(&conn->send_lock);
+			while (conn->sock >= 0 && bc < pos) {
+				int wc = write(conn->sock, buf, pos - bc);
 				if (wc <= 0) {
-					close(rpc_sock);
+					/* Let the receiver thread notice
+					 * and reconnect */
+					shutdown(conn->sock, SHUT_RDWR);
 					break;
 				}
 				bc += wc;
 				buf += wc;
 			}
+			pthread_mutex_unlock(&conn->send_lock);
 
 			if (bc == pos) {
-				if (first_try) {
-					glist_add_tail(&rpc_calls,
-						       &pcontext->calls);
-					first_try = 0;
-				}
-			} else {
-				if (!first_try)
-					glist_del(&pcontext->calls);
-			}
-			pthread_mutex_unlock(&listlock);
-
-			if (bc == pos)
 				rc = pxy_process_reply(pcontext, res);
-			else
+			} else {
+				pthread_mutex_lock(&conn->calls_lock);
+				glist_del(&pcontext->calls);
+				pthread_mutex_unlock(&conn->calls_lock);
+				/* Forget a failure posted by the receiver
+				 * in the meantime, we resend anyway */
+				pthread_mutex_lock(&pcontext->iolock);
+				pcontext->iodone = 0;
+				pthread_mutex_unlock(&pcontext->iolock);
 				rc = RPC_CANTSEND;
+			}
 		} while (rc == RPC_TIMEDOUT);
 	} else {
 		rc = RPC_CANTENCODEARGS;
@@ -825,11 +946,19 @@ static int pxy_setclientid(clientid4 *resultclientid, uint32_t *lease_time)
 	struct sockaddr_in sin;
 	socklen_t slen = sizeof(sin);
 	char addrbuf[sizeof("255.255.255.255")];
+	unsigned int i;
+	int sock = -1;
 
 	LogEvent(COMPONENT_FSAL,
 		 "Negotiating a new ClientId with the remote server");
 
-	if (getsockname(rpc_sock, &sin, &slen))
+	/* Name ourselves after the address of a connection that is up */
+	for (i = 0; i < pxy_nconns; i++) {
+		sock = pxy_conns[i].sock;
+		if (sock >= 0)
+			break;
+	}
+	if (getsockname(sock, &sin, &slen))
 		return -errno;
 
 	snprintf(clientid_name, MAXNAMLEN, "%s(%d) - GANESHA NFSv4 Proxy",
@@ -940,9 +1069,8 @@ static void free_io_contexts(void)
 int pxy_init_rpc(const struct pxy_fsal_module *pm)
 {
 	int rc;
-	int i = 16;
+	unsigned int i, j;
 
-	glist_init(&rpc_calls);
 	glist_init(&free_contexts);
 
 /**
@@ -959,7 +1087,7 @@ int pxy_init_rpc(const struct pxy_fsal_module *pm)
 		strncpy(pxy_hostname, "NFS-GANESHA/Proxy",
 			sizeof(pxy_hostname));
 
-	for (i = 16; i > 0; i--) {
+	for (i = pm->special.srv_max_calls; i > 0; i--) {
 		struct pxy_rpc_io_context *c =
 		    gsh_malloc(sizeof(*c) + pm->special.srv_sendsize +
 			       pm->special.srv_recvsize);
@@ -978,16 +1106,46 @@ int pxy_init_rpc(const struct pxy_fsal_module *pm)
 		glist_add(&free_contexts, &c->calls);
 	}
 
-	rc = pthread_create(&pxy_recv_thread, NULL, pxy_rpc_recv,
-			    (void *)&pm->special);
-	if (rc) {
-		LogCrit(COMPONENT_FSAL,
-			"Cannot create proxy rpc receiver thread - %s",
-			strerror(rc));
+	pxy_conns = gsh_calloc(pm->special.srv_connections,
+			       sizeof(*pxy_conns));
+	if (pxy_conns == NULL) {
 		free_io_contexts();
-		return rc;
+		return ENOMEM;
 	}
 
+	for (i = 0; i < pm->special.srv_connections; i++) {
+		struct pxy_rpc_conn *conn = &pxy_conns[i];
+
+		pthread_mutex_init(&conn->send_lock, NULL);
+		pthread_mutex_init(&conn->calls_lock, NULL);
+		for (j = 0; j < PXY_RPC_XID_BUCKETS; j++)
+			glist_init(&conn->calls[j]);
+		conn->sock = -1;
+		conn->index = i;
+		conn->info = &pm->special;
+
+		rc = pthread_create(&conn->recv_thread, NULL, pxy_rpc_recv,
+				    conn);
+		if (rc) {
+			LogCrit(COMPONENT_FSAL,
+				"Cannot create proxy rpc receiver thread - %s",
+				strerror(rc));
+			/* The threads already started keep using theirs */
+			if (i == 0) {
+				gsh_free(pxy_conns);
+				pxy_conns = NULL;
+				free_io_contexts();
+				return rc;
+			}
+			break;
+		}
+		pxy_nconns++;
+	}
+
+	LogInfo(COMPONENT_FSAL,
+		"Proxying over %u connections with up to %u calls in flight",
+		pxy_nconns, pm->special.srv_max_calls);
+
 	rc = pthread_create(&pxy_renewer_thread, NULL, pxy_clientid_renewer,
 			    NULL);
 	if (rc) {
@@ -1013,6 +1171,8 @@ static fsal_status_t pxy_make_object(struct fsal_export *export,
 	    NFS4_OK)
 		return fsalstat(ERR_FSAL_INVAL, 0);
 
+	pxy_cache_put_attrs(fh, &attributes);
+
 	pxy_hdl = pxy_alloc_handle(export, fh, &attributes);
 	if (pxy_hdl == NULL)
 		return fsalstat(ERR_FSAL_FAULT, 0);
@@ -1041,15 +1201,20 @@ static fsal_status_t pxy_lookup_impl(struct fsal_obj_handle *parent,
 	nfs_resop4 resoparray[FSAL_LOOKUP_NB_OP_ALLOC];
 	char fattr_blob[FATTR_BLOB_SZ];
 	char padfilehandle[NFS4_FHSIZE];
+	struct pxy_obj_handle *pxy_obj = NULL;
+	bool cacheable;
+	uint64_t dir_change = 0;
+	fsal_status_t st;
 
 	if (!handle)
 		return fsalstat(ERR_FSAL_INVAL, 0);
 
+	cacheable = parent && path && strcmp(path, ".") && strcmp(path, "..");
+
 	if (!parent) {
 		COMPOUNDV4_ARG_ADD_OP_PUTROOTFH(opcnt, argoparray);
 	} else {
-		struct pxy_obj_handle *pxy_obj =
-		    container_of(parent, struct pxy_obj_handle, obj);
+		pxy_obj = container_of(parent, struct pxy_obj_handle, obj);
 		switch (parent->type) {
 		case DIRECTORY:
 			break;
@@ -1058,6 +1223,27 @@ static fsal_status_t pxy_lookup_impl(struct fsal_obj_handle *parent,
 			return fsalstat(ERR_FSAL_NOTDIR, 0);
 		}
 
+		if (cacheable) {
+			struct attrlist attrs;
+			nfs_fh4 fh = {
+				.nfs_fh4_val = padfilehandle,
+				.nfs_fh4_len = sizeof(padfilehandle)
+			};
+
+			if (pxy_cache_lookup(&pxy_obj->fh4, path, &fh,
+					     &attrs)) {
+				struct pxy_obj_handle *ph =
+				    pxy_alloc_handle(export, &fh, &attrs);
+
+				if (ph == NULL)
+					return fsalstat(ERR_FSAL_FAULT, 0);
+				*handle = &ph->obj;
+				return fsalstat(ERR_FSAL_NO_ERROR, 0);
+			}
+			cacheable = pxy_cache_dir_change(&pxy_obj->fh4,
+							 &dir_change);
+		}
+
 		COMPOUNDV4_ARG_ADD_OP_PUTFH(opcnt, argoparray, pxy_obj->fh4);
 	}
 
@@ -1090,8 +1276,12 @@ static fsal_status_t pxy_lookup_impl(struct fsal_obj_handle *parent,
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
-	return pxy_make_object(export, &atok->obj_attributes, &fhok->object,
-			       handle);
+	st = pxy_make_object(export, &atok->obj_attributes, &fhok->object,
+			     handle);
+	if (!FSAL_IS_ERROR(st) && cacheable)
+		pxy_cache_add_name(&pxy_obj->fh4, dir_change, path,
+				   &fhok->object);
+	return st;
 }
 
 static fsal_status_t pxy_lookup(struct fsal_obj_handle *parent,
@@ -1218,6 +1408,7 @@ static fsal_status_t pxy_create(struct fsal_obj_handle *dir_hdl,
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
 	nfs4_Fattr_Free(&input_attr);
+	pxy_cache_drop_attrs(&ph->fh4);
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
@@ -1292,6 +1483,7 @@ static fsal_status_t pxy_mkdir(struct fsal_obj_handle *dir_hdl,
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
 	nfs4_Fattr_Free(&input_attr);
+	pxy_cache_drop_attrs(&ph->fh4);
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
@@ -1377,6 +1569,7 @@ static fsal_status_t pxy_mknod(struct fsal_obj_handle *dir_hdl,
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
 	nfs4_Fattr_Free(&input_attr);
+	pxy_cache_drop_attrs(&ph->fh4);
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
@@ -1436,6 +1629,7 @@ static fsal_status_t pxy_symlink(struct fsal_obj_handle *dir_hdl,
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
 	nfs4_Fattr_Free(&input_attr);
+	pxy_cache_drop_attrs(&ph->fh4);
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
@@ -1521,6 +1715,8 @@ static fsal_status_t pxy_link(struct fsal_obj_handle *obj_hdl,
 
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
+	pxy_cache_drop_attrs(&tgt->fh4);
+	pxy_cache_drop_attrs(&dst->fh4);
 	return nfsstat4_to_fsal(rc);
 }
 
@@ -1548,12 +1744,17 @@ static fsal_status_t pxy_do_readdir(struct pxy_obj_handle *ph,
 	nfs_resop4 resoparray[FSAL_READDIR_NB_OP_ALLOC];
 	READDIR4resok *rdok;
 	fsal_status_t st = { ERR_FSAL_NO_ERROR, 0 };
+	bool prefetch = pxy_cache_prefetch();
+	uint64_t dir_change = 0;
+	bool add_names = prefetch && pxy_cache_dir_change(&ph->fh4,
+							  &dir_change);
 
 	COMPOUNDV4_ARG_ADD_OP_PUTFH(opcnt, argoparray, ph->fh4);
 	rdok = &resoparray[opcnt].nfs_resop4_u.opreaddir.READDIR4res_u.resok4;
 	rdok->reply.entries = NULL;
 	COMPOUNDV4_ARG_ADD_OP_READDIR(opcnt, argoparray, *cookie,
-				      pxy_bitmap_readdir);
+				      prefetch ? pxy_bitmap_readdir_prefetch
+					       : pxy_bitmap_readdir);
 
 	rc = pxy_nfsv4_call(ph->obj.export, op_ctx->creds, opcnt, argoparray,
 			    resoparray);
@@ -1572,8 +1773,25 @@ static fsal_status_t pxy_do_readdir(struct pxy_obj_handle *ph,
 		memcpy(name, e4->name.utf8string_val, e4->name.utf8string_len);
 		name[e4->name.utf8string_len] = '\0';
 
-		if (nfs4_Fattr_To_FSAL_attr(&attr, &e4->attrs, NULL))
+		if (prefetch) {
+			char padfilehandle[NFS4_FHSIZE];
+			nfs_fh4 fh = {
+				.nfs_fh4_val = padfilehandle,
+				.nfs_fh4_len = 0
+			};
+
+			if (nfs4_Fattr_To_FSAL_attr_fh(&attr, &fh, &e4->attrs))
+				return fsalstat(ERR_FSAL_FAULT, 0);
+			if (fh.nfs_fh4_len != 0) {
+				pxy_cache_put_attrs(&fh, &attr);
+				if (add_names)
+					pxy_cache_add_name(&ph->fh4,
+							   dir_change, name,
+							   &fh);
+			}
+		} else if (nfs4_Fattr_To_FSAL_attr(&attr, &e4->attrs, NULL)) {
 			return fsalstat(ERR_FSAL_FAULT, 0);
+		}
 
 		*cookie = e4->cookie;
 
@@ -1631,6 +1849,10 @@ static fsal_status_t pxy_rename(struct fsal_obj_handle *olddir_hdl,
 
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
+	pxy_cache_drop_attrs(&src->fh4);
+	pxy_cache_drop_attrs(&tgt->fh4);
+	pxy_cache_drop_name(&src->fh4, old_name);
+	pxy_cache_drop_name(&tgt->fh4, new_name);
 	return nfsstat4_to_fsal(rc);
 }
 
@@ -1647,6 +1869,9 @@ static fsal_status_t pxy_getattrs_impl(const struct user_cred *creds,
 	GETATTR4resok *atok;
 	char fattr_blob[FATTR_BLOB_SZ];
 
+	if (pxy_cache_get_attrs(filehandle, obj_attr))
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
 	COMPOUNDV4_ARG_ADD_OP_PUTFH(opcnt, argoparray, *filehandle);
 
 	atok = pxy_fill_getattr_reply(resoparray + opcnt, fattr_blob,
@@ -1661,6 +1886,7 @@ static fsal_status_t pxy_getattrs_impl(const struct user_cred *creds,
 	    NFS4_OK)
 		return fsalstat(ERR_FSAL_INVAL, 0);
 
+	pxy_cache_put_attrs(filehandle, obj_attr);
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
@@ -1722,6 +1948,7 @@ static fsal_status_t pxy_setattrs(struct fsal_obj_handle *obj_hdl,
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
 	nfs4_Fattr_Free(&input_attr);
+	pxy_cache_drop_attrs(&ph->fh4);
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
@@ -1732,6 +1959,7 @@ static fsal_status_t pxy_setattrs(struct fsal_obj_handle *obj_hdl,
 			"ignoring attibutes after making changes", rc);
 	} else {
 		obj_hdl->attributes = attrs_after;
+		pxy_cache_put_attrs(&ph->fh4, &attrs_after);
 	}
 
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
@@ -1767,12 +1995,21 @@ static fsal_status_t pxy_unlink(struct fsal_obj_handle *dir_hdl,
 
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
-	if (rc != NFS4_OK)
+	pxy_cache_drop_name(&ph->fh4, name);
+	if (rc != NFS4_OK) {
+		pxy_cache_drop_attrs(&ph->fh4);
 		return nfsstat4_to_fsal(rc);
+	}
 
+	/* The new change attribute of the directory retires its cached
+	 * names */
 	if (nfs4_Fattr_To_FSAL_attr(&dirattr, &atok->obj_attributes, NULL) ==
-	    NFS4_OK)
+	    NFS4_OK) {
 		dir_hdl->attributes = dirattr;
+		pxy_cache_put_attrs(&ph->fh4, &dirattr);
+	} else {
+		pxy_cache_drop_attrs(&ph->fh4);
+	}
 
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
@@ -1932,6 +2169,7 @@ static fsal_status_t pxy_write(struct fsal_obj_handle *obj_hdl,
 
 	rc = pxy_nfsv4_call(op_ctx->fsal_export, op_ctx->creds,
 			    opcnt, argoparray, resoparray);
+	pxy_cache_drop_attrs(&ph->fh4);
 	if (rc != NFS4_OK)
 		return nfsstat4_to_fsal(rc);
 
@@ -1,9 +1,16 @@
 #include "config.h"
 #include "handle_mapping.h"
+#include "nfs4.h"
 #include "handle_mapping_db.h"
 #include "handle_mapping_internal.h"
-#include <sqlite3.h>
+#include "abstract_mem.h"
+#include "ganesha_list.h"
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
@@ -11,164 +18,108 @@
 #include <fnmatch.h>
 #include <pthread.h>
 
-/* sqlite check macros */
-
-#define CheckTable(_p_conn_, _code_, _msg_str_, _result_) \
-do { \
-	if ((_code_) != SQLITE_OK) { \
-		LogCrit(COMPONENT_FSAL, \
-			"SQLite command failed in %s line %i", \
-			__func__, __LINE__);		\
-		LogCrit(COMPONENT_FSAL, "%s (%d)", \
-			(_msg_str_ ? _msg_str_ : sqlite3_errmsg(_p_conn_)), \
-			_code_);					\
-		if (_msg_str_) {					\
-			sqlite3_free(_msg_str_);			\
-			_msg_str_ = NULL;				\
-		}							\
-		if (_result_) {						\
-			sqlite3_free_table(_result_);			\
-			_result_ = NULL;				\
-		}							\
-		return HANDLEMAP_DB_ERROR;				\
-	}								\
-} while (0)
-
-#define CheckCommand(_p_conn_, _code_, _msg_str_) \
-do { \
-	if ((_code_) != SQLITE_OK) { \
-		LogCrit(COMPONENT_FSAL, \
-			"SQLite command failed in %s line %i", \
-			__func__, __LINE__);			\
-		LogCrit(COMPONENT_FSAL, "%s (%d)", \
-			(_msg_str_ ? _msg_str_ : sqlite3_errmsg(_p_conn_)), \
-			_code_);					\
-		if (_msg_str_) { \
-			sqlite3_free(_msg_str_); \
-			_msg_str_ = NULL; \
-		}			  \
-		return HANDLEMAP_DB_ERROR;	\
-	}					\
-} while (0)
-
-#define CheckPrepare(_p_conn_, _code_) \
-do { \
-	if ((_code_) != SQLITE_OK) {	\
-		LogCrit(COMPONENT_FSAL,					\
-			"SQLite prepare statement failed in %s line %i", \
-			__func__, __LINE__);				\
-		LogCrit(COMPONENT_FSAL, "%s (%d)",			\
-			sqlite3_errmsg(_p_conn_), _code_);		\
-		return HANDLEMAP_DB_ERROR;				\
-	}								\
-} while (0)
-
-#define CheckBind(_p_conn_, _code_, _stmt_) \
-do { \
-	if ((_code_) != SQLITE_OK) { \
-		LogCrit(COMPONENT_FSAL,				 \
-			"SQLite parameter binding failed in %s line %i", \
-			__func__, __LINE__);				\
-		LogCrit(COMPONENT_FSAL, "%s (%d)",			\
-			sqlite3_errmsg(_p_conn_), _code_);		\
-		sqlite3_clear_bindings(_stmt_);				\
-		return HANDLEMAP_DB_ERROR;				\
-	}								\
-} while (0)
-
-#define CheckStep(_p_conn_, _code_, _stmt_) \
-do { \
-	if ((_code_) != SQLITE_OK  && (_code_) != \
-	    SQLITE_ROW && (_code_) != SQLITE_DONE) {			\
-		LogCrit(COMPONENT_FSAL,					\
-			"SQLite command failed in %s line %i",		\
-			__func__, __LINE__);			\
-		LogCrit(COMPONENT_FSAL, "%s (%d)",			\
-			sqlite3_errmsg(_p_conn_), _code_);		\
-		sqlite3_reset(_stmt_);					\
-		return HANDLEMAP_DB_ERROR;				\
-	}								\
-} while (0)
-
-/* Type of DB operations */
-typedef enum {
-	LOAD = 1,
-	INSERT,
-	DELETE
-} db_op_type;
-
-/* DB operation arguments */
-typedef struct db_op_item__ {
-	db_op_type op_type;
-
-	/* operation info */
-
-	union {
-		struct hdlmap_tuple {
-			nfs23_map_handle_t nfs23_digest;
-			uint8_t fh4_len;
-			char fh4_data[NFS4_FHSIZE];
-		} fh_info;
-
-		hash_table_t *hash;
-	} op_arg;
-
-	/* for chained list */
-	struct db_op_item__ *p_next;
-
-} db_op_item_t;
-
-/* the queue for each DB flusher thread */
-typedef struct flusher_queue__ {
-	/* the queue for high priority operations */
-	db_op_item_t *highprio_first;
-	db_op_item_t *highprio_last;
-
-	/* the queue for low priority operations */
-	db_op_item_t *lowprio_first;
-	db_op_item_t *lowprio_last;
-
-	/* number of operations pending */
-	unsigned int nb_waiting;
-
-	pthread_mutex_t queues_mutex;
+/*
+ * Each database is a pair of files:
+ *
+ * - DB_FILE_PREFIX.<n> is an open-addressed hash table of fixed-size
+ *   slots, mapped in memory.  The first sector is a header, then
+ *   HDLMAP_SLOTS_PER_SECTOR slots are packed in each sector, so that
+ *   no slot straddles two sectors and a torn write cannot tear one.
+ *
+ * - LOG_FILE_PREFIX.<n> holds the operations applied to the table
+ *   since it was last synced.  The database thread appends every
+ *   operation pending with a single write and fdatasync (group
+ *   commit) before applying them to the table.
+ *
+ * Once the log grows past HDLMAP_LOG_MAX the table is synced and the
+ * log truncated.  A batch that cannot be logged is not applied, and
+ * the submitters waiting for it get an error.  At start, the log is
+ * replayed on top of the table.  Pages of the table may have been
+ * written back in any order before a crash, so replay can leave a
+ * stale copy of a digest behind; such duplicates are dropped when the
+ * table is loaded.
+ */
 
-	pthread_cond_t work_avail_condition;
-	pthread_cond_t work_done_condition;
+#define HDLMAP_MAGIC		0x484d4442	/* "HMDB" */
+#define HDLMAP_SECTOR		512
+#define HDLMAP_SLOTS_PER_SECTOR	3
+#define HDLMAP_MIN_SECTORS	1024
+#define HDLMAP_MAX_FILL		70	/* % of slots not empty */
+#define HDLMAP_LOG_MAX		(4 * 1024 * 1024)
 
-	/* status (used for work_done_condition) */
-	enum { NOT_READY, IDLE, WORKING, FINISHED } status;
+/* Slot states */
+#define SLOT_EMPTY	0
+#define SLOT_USED	1
+#define SLOT_DELETED	2
 
-} flusher_queue_t;
+/* Type of DB operations */
+#define HDLMAP_OP_INSERT	1
+#define HDLMAP_OP_DELETE	2
 
-#define LOAD_ALL_STATEMENT  0
-#define INSERT_STATEMENT    1
-#define DELETE_STATEMENT    2
+struct hdlmap_header {
+	uint32_t magic;
+	uint32_t slot_size;
+	uint64_t nsectors;	/* Sectors of slots following the header */
+};
 
-#define STATEMENT_COUNT     3
+struct hdlmap_slot {
+	uint64_t object_id;
+	uint32_t handle_hash;
+	uint8_t state;
+	uint8_t fh4_len;
+	uint8_t pad[2];
+	char fh4_data[NFS4_FHSIZE];
+};
+
+/* What the log is made of */
+struct hdlmap_record {
+	uint32_t op;
+	uint32_t sum;		/* Checksum of slot, to spot a torn tail */
+	struct hdlmap_slot slot;
+};
+
+/* A synchronous submitter, waiting for its operation to be committed */
+struct hdlmap_waiter {
+	struct glist_head list;
+	uint64_t seq;
+	int rc;
+	bool done;
+};
 
-/* thread info */
+/* A database, and the queue of its thread */
 typedef struct db_thread_info__ {
 	pthread_t thr_id;
 	unsigned int thr_index;
 
-	flusher_queue_t work_queue;
+	int table_fd;
+	int log_fd;
+	char *map;
+	size_t map_len;
+	uint64_t nslots;
+	uint64_t nfilled;	/* Slots not empty */
+	uint64_t nused;		/* Slots holding a mapping */
+	off_t log_size;
 
-	/* SQLite database connection */
-	sqlite3 *db_conn;
+	pthread_mutex_t queue_mutex;
+	pthread_cond_t work_avail_condition;
+	pthread_cond_t work_done_condition;
+
+	/* Operations submitted and not picked up by the thread yet */
+	struct hdlmap_record *queue;
+	unsigned int queue_len;
+	unsigned int queue_size;
 
-	/* prepared statement table */
-	sqlite3_stmt * prep_stmt[STATEMENT_COUNT];
+	/* Operations the thread is committing */
+	struct hdlmap_record *batch;
+	unsigned int batch_size;
 
-	/* this pool is accessed by submitter
-	 * and by the db thread */
-	pthread_mutex_t pool_mutex;
-	pool_t *dbop_pool;
+	uint64_t submitted;
+	uint64_t committed;
+	struct glist_head waiters;	/* In submission order */
 
 } db_thread_info_t;
 
 static char dbmap_dir[MAXPATHLEN + 1];
-static char db_tmpdir[MAXPATHLEN + 1];
 static unsigned int nb_db_threads;
 static int synchronous;
 
@@ -178,6 +129,7 @@ static int do_terminate;
 /* all information and context for threads */
 static db_thread_info_t db_thread[MAX_DB];
 
+
 /**
  * @brief Print memory to a a hex string
  *
@@ -285,478 +237,642 @@ sscanmem(void *target, size_t tgt_size, const char *str_source)
 
 }
 
-/* Initialize basic structures for a thread */
-static int init_db_thread_info(db_thread_info_t *p_thr_info,
-			       unsigned int nb_dbop_prealloc)
+static inline struct hdlmap_slot *hdlmap_slot(db_thread_info_t *db,
+					      uint64_t i)
 {
-	unsigned int i;
+	return (struct hdlmap_slot *)(db->map +
+		HDLMAP_SECTOR * (1 + i / HDLMAP_SLOTS_PER_SECTOR) +
+		sizeof(struct hdlmap_slot) * (i % HDLMAP_SLOTS_PER_SECTOR));
+}
 
-	if (!p_thr_info)
-		return HANDLEMAP_INTERNAL_ERROR;
+static inline uint64_t hdlmap_home(db_thread_info_t *db,
+				   const struct hdlmap_slot *key)
+{
+	uint64_t h = key->object_id * 0x9e3779b97f4a7c15ULL;
 
-	memset(p_thr_info, 0, sizeof(db_thread_info_t));
+	h ^= key->handle_hash;
+	h ^= h >> 31;
+	return h % db->nslots;
+}
 
-	p_thr_info->work_queue.highprio_first = NULL;
-	p_thr_info->work_queue.highprio_last = NULL;
-	p_thr_info->work_queue.lowprio_first = NULL;
-	p_thr_info->work_queue.lowprio_last = NULL;
+/* FNV-1a of a slot, padding included */
+static uint32_t hdlmap_sum(const struct hdlmap_slot *slot)
+{
+	const unsigned char *c = (const unsigned char *)slot;
+	uint32_t sum = 2166136261U;
+	size_t i;
 
-	p_thr_info->work_queue.nb_waiting = 0;
+	for (i = 0; i < sizeof(*slot); i++)
+		sum = (sum ^ c[i]) * 16777619U;
+	return sum;
+}
 
-	if (pthread_mutex_init(&p_thr_info->work_queue.queues_mutex, NULL))
-		return HANDLEMAP_SYSTEM_ERROR;
+/*
+ * Find the slot holding the digest of key.  If there is none,
+ * free_slot is set to where it can be inserted (NULL if the table is
+ * full).
+ */
+static struct hdlmap_slot *hdlmap_find(db_thread_info_t *db,
+				       const struct hdlmap_slot *key,
+				       struct hdlmap_slot **free_slot)
+{
+	uint64_t i = hdlmap_home(db, key);
+	uint64_t n;
 
-	if (pthread_cond_init
-	    (&p_thr_info->work_queue.work_avail_condition, NULL))
-		return HANDLEMAP_SYSTEM_ERROR;
+	*free_slot = NULL;
 
-	if (pthread_cond_init
-	    (&p_thr_info->work_queue.work_done_condition, NULL))
-		return HANDLEMAP_SYSTEM_ERROR;
+	for (n = 0; n < db->nslots; n++) {
+		struct hdlmap_slot *s = hdlmap_slot(db, i);
 
-	/* init thread status */
-	p_thr_info->work_queue.status = NOT_READY;
+		if (s->state == SLOT_EMPTY) {
+			if (*free_slot == NULL)
+				*free_slot = s;
+			return NULL;
+		}
 
-	p_thr_info->db_conn = NULL;
+		if (s->state == SLOT_DELETED) {
+			if (*free_slot == NULL)
+				*free_slot = s;
+		} else if (s->object_id == key->object_id &&
+			   s->handle_hash == key->handle_hash) {
+			return s;
+		}
 
-	for (i = 0; i < STATEMENT_COUNT; i++)
-		p_thr_info->prep_stmt[i] = NULL;
+		if (++i == db->nslots)
+			i = 0;
+	}
+	return NULL;
+}
 
-	/* init memory pool */
+static int hdlmap_put(db_thread_info_t *db, const struct hdlmap_slot *new)
+{
+	struct hdlmap_slot *free_slot;
+	struct hdlmap_slot *s = hdlmap_find(db, new, &free_slot);
 
-	if (pthread_mutex_init(&p_thr_info->pool_mutex, NULL))
-		return HANDLEMAP_SYSTEM_ERROR;
+	if (s == NULL) {
+		s = free_slot;
+		if (s == NULL) {
+			LogCrit(COMPONENT_FSAL,
+				"ERROR: handle mapping database %u is full",
+				db->thr_index);
+			return HANDLEMAP_SYSTEM_ERROR;
+		}
+		if (s->state == SLOT_EMPTY)
+			db->nfilled++;
+		db->nused++;
+	}
+	*s = *new;
+	s->state = SLOT_USED;
+	return HANDLEMAP_SUCCESS;
+}
 
-	p_thr_info->dbop_pool =
-	    pool_init(NULL, sizeof(db_op_item_t), pool_basic_substrate, NULL,
-		      NULL, NULL);
+static void hdlmap_del(db_thread_info_t *db, const struct hdlmap_slot *key)
+{
+	struct hdlmap_slot *free_slot;
+	struct hdlmap_slot *s = hdlmap_find(db, key, &free_slot);
 
-	return HANDLEMAP_SUCCESS;
+	if (s != NULL) {
+		s->state = SLOT_DELETED;
+		db->nused--;
+	}
 }
 
-/* Called by a thread to initialize its database access.
- * After this call:
- *  - database connection is established
- *  - schema is created
- *  - prepared statements are ready to be used
- */
-static int init_database_access(db_thread_info_t *p_thr_info)
+static int hdlmap_apply(db_thread_info_t *db,
+			const struct hdlmap_record *rec)
 {
-	char db_file[MAXPATHLEN + 1];
-	int rc;
-	char **result = NULL;
-	int rows, cols;
-	char *errmsg = NULL;
-	const char *unparsed;
+	if (rec->op == HDLMAP_OP_INSERT)
+		return hdlmap_put(db, &rec->slot);
 
-	/* first open the database file */
+	hdlmap_del(db, &rec->slot);
+	return HANDLEMAP_SUCCESS;
+}
 
-	snprintf(db_file, MAXPATHLEN, "%s/%s.%u", dbmap_dir, DB_FILE_PREFIX,
-		 p_thr_info->thr_index);
+/* Size and map a table file, fd must be empty */
+static char *hdlmap_new_table(int fd, uint64_t nsectors, size_t *len)
+{
+	struct hdlmap_header *hdr;
+	char *map;
+
+	*len = (1 + nsectors) * HDLMAP_SECTOR;
+	if (ftruncate(fd, *len))
+		return NULL;
+
+	map = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	hdr = (struct hdlmap_header *)map;
+	hdr->magic = HDLMAP_MAGIC;
+	hdr->slot_size = sizeof(struct hdlmap_slot);
+	hdr->nsectors = nsectors;
+	return map;
+}
 
-	rc = sqlite3_open(db_file, &p_thr_info->db_conn);
+/* Make the last rename of a table durable */
+static int hdlmap_sync_dir(void)
+{
+	int fd = open(dbmap_dir, O_RDONLY | O_DIRECTORY);
+	int rc;
 
-	if (rc != 0) {
-		if (p_thr_info->db_conn) {
-			LogCrit(COMPONENT_FSAL,
-				"ERROR: could not connect to SQLite3 database (file %s): %s",
-				db_file, sqlite3_errmsg(p_thr_info->db_conn));
-			sqlite3_close(p_thr_info->db_conn);
-		} else {
-			LogCrit(COMPONENT_FSAL,
-				"ERROR: could not connect to SQLite3 database (file %s): status=%d",
-				db_file, rc);
-		}
-		return HANDLEMAP_DB_ERROR;
-	}
+	if (fd < 0)
+		return -1;
+	rc = fsync(fd);
+	close(fd);
+	return rc;
+}
 
-	/* Now check, that the map table exists */
-	rc = sqlite3_get_table(p_thr_info->db_conn,
-			       "SELECT name FROM sqlite_master WHERE type = 'table' AND name = '"
-			       MAP_TABLE "'", &result, &rows, &cols, &errmsg);
+/*
+ * Sync the table, after which the log is not needed anymore.  The
+ * directory is synced too, in case the table was just replaced by
+ * hdlmap_grow: the log must outlive the old table.
+ */
+static int hdlmap_checkpoint(db_thread_info_t *db)
+{
+	if (msync(db->map, db->map_len, MS_SYNC) || hdlmap_sync_dir() ||
+	    ftruncate(db->log_fd, 0)) {
+		LogCrit(COMPONENT_FSAL,
+			"ERROR: could not sync handle mapping database %u: %s",
+			db->thr_index, strerror(errno));
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
+	db->log_size = 0;
+	return HANDLEMAP_SUCCESS;
+}
 
-	CheckTable(p_thr_info->db_conn, rc, errmsg, result);
+/*
+ * Rehash the table into a new file with room for count more entries,
+ * dropping deleted slots.  If checkpoint is set, every logged
+ * operation must have been applied, as the log is truncated.
+ * Otherwise the log is kept, to be replayed on the new table.
+ */
+static int hdlmap_grow(db_thread_info_t *db, unsigned int count,
+		       bool checkpoint)
+{
+	char path[MAXPATHLEN + 1];
+	char new_path[MAXPATHLEN + 1];
+	db_thread_info_t grown;
+	uint64_t nsectors = HDLMAP_MIN_SECTORS;
+	uint64_t i;
+	int fd;
+
+	/* Leave the new table half as full as it may get */
+	while ((db->nused + count) * 200 >
+	       nsectors * HDLMAP_SLOTS_PER_SECTOR * HDLMAP_MAX_FILL)
+		nsectors *= 2;
+
+	snprintf(path, MAXPATHLEN, "%s/%s.%u", dbmap_dir, DB_FILE_PREFIX,
+		 db->thr_index);
+	snprintf(new_path, MAXPATHLEN, "%s.new", path);
+
+	fd = open(new_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		LogCrit(COMPONENT_FSAL, "ERROR: could not create %s: %s",
+			new_path, strerror(errno));
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
 
-	/* no need for the result, just the number of rows returned */
-	sqlite3_free_table(result);
+	memset(&grown, 0, sizeof(grown));
+	grown.thr_index = db->thr_index;
+	grown.map = hdlmap_new_table(fd, nsectors, &grown.map_len);
+	if (grown.map == NULL) {
+		LogCrit(COMPONENT_FSAL, "ERROR: could not map %s: %s",
+			new_path, strerror(errno));
+		close(fd);
+		unlink(new_path);
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
+	grown.nslots = nsectors * HDLMAP_SLOTS_PER_SECTOR;
 
-	if (rows != 1) {
-		/* table must be created */
-		rc = sqlite3_exec(p_thr_info->db_conn,
-				  "CREATE TABLE " MAP_TABLE " ( " OBJID_FIELD
-				  "   BIGINT NOT NULL, " HASH_FIELD
-				  "    INT NOT NULL, " HANDLE_FIELD "  TEXT, "
-				  "PRIMARY KEY(" OBJID_FIELD ", " HASH_FIELD
-				  ") )", NULL, NULL, &errmsg);
+	for (i = 0; i < db->nslots; i++) {
+		struct hdlmap_slot *s = hdlmap_slot(db, i);
 
-		CheckCommand(p_thr_info->db_conn, rc, errmsg);
+		/* Cannot fail, the new table is at most half full */
+		if (s->state == SLOT_USED)
+			(void)hdlmap_put(&grown, s);
+	}
 
+	if (msync(grown.map, grown.map_len, MS_SYNC) || fsync(fd) ||
+	    rename(new_path, path)) {
+		LogCrit(COMPONENT_FSAL, "ERROR: could not replace %s: %s",
+			path, strerror(errno));
+		munmap(grown.map, grown.map_len);
+		close(fd);
+		unlink(new_path);
+		return HANDLEMAP_SYSTEM_ERROR;
 	}
 
-	/* Now, create prepared statements */
+	LogEvent(COMPONENT_FSAL,
+		 "Handle mapping database %u resized to %llu slots",
+		 db->thr_index, (unsigned long long)grown.nslots);
+
+	munmap(db->map, db->map_len);
+	close(db->table_fd);
+	db->table_fd = fd;
+	db->map = grown.map;
+	db->map_len = grown.map_len;
+	db->nslots = grown.nslots;
+	db->nfilled = grown.nfilled;
+	db->nused = grown.nused;
+
+	if (checkpoint)
+		return hdlmap_checkpoint(db);
+	return HANDLEMAP_SUCCESS;
+}
 
-	rc = sqlite3_prepare_v2(p_thr_info->db_conn,
-				"SELECT " OBJID_FIELD "," HASH_FIELD ","
-				HANDLE_FIELD " FROM " MAP_TABLE, -1,
-				&(p_thr_info->prep_stmt[LOAD_ALL_STATEMENT]),
-				&unparsed);
+/*
+ * Whether count operations are sure to find a slot, which they do as
+ * long as an empty one is left: probing stops there.
+ */
+static inline bool hdlmap_fits(db_thread_info_t *db, unsigned int count)
+{
+	return db->nfilled + count < db->nslots;
+}
 
-	CheckPrepare(p_thr_info->db_conn, rc);
+static inline bool hdlmap_too_full(db_thread_info_t *db, unsigned int count)
+{
+	return (db->nfilled + count) * 100 > db->nslots * HDLMAP_MAX_FILL;
+}
 
-	rc = sqlite3_prepare_v2(p_thr_info->db_conn,
-				"INSERT INTO " MAP_TABLE "(" OBJID_FIELD ","
-				HASH_FIELD "," HANDLE_FIELD ") "
-				"VALUES (?1, ?2, ?3 )", -1,
-				&(p_thr_info->prep_stmt[INSERT_STATEMENT]),
-				&unparsed);
+/* Map the table, creating it if it does not exist */
+static int hdlmap_open_table(db_thread_info_t *db)
+{
+	char path[MAXPATHLEN + 1];
+	struct hdlmap_header *hdr;
+	struct stat st;
+	uint64_t i;
+
+	snprintf(path, MAXPATHLEN, "%s/%s.%u.new", dbmap_dir,
+		 DB_FILE_PREFIX, db->thr_index);
+	/* Left by a resize that did not complete */
+	(void)unlink(path);
+
+	snprintf(path, MAXPATHLEN, "%s/%s.%u", dbmap_dir, DB_FILE_PREFIX,
+		 db->thr_index);
+
+	db->table_fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (db->table_fd < 0 || fstat(db->table_fd, &st)) {
+		LogCrit(COMPONENT_FSAL, "ERROR: could not open %s: %s", path,
+			strerror(errno));
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
 
-	CheckPrepare(p_thr_info->db_conn, rc);
+	if (st.st_size == 0) {
+		db->map = hdlmap_new_table(db->table_fd, HDLMAP_MIN_SECTORS,
+					   &db->map_len);
+		if (db->map == NULL) {
+			LogCrit(COMPONENT_FSAL, "ERROR: could not map %s: %s",
+				path, strerror(errno));
+			return HANDLEMAP_SYSTEM_ERROR;
+		}
+	} else {
+		db->map_len = st.st_size;
+		db->map = mmap(NULL, db->map_len, PROT_READ | PROT_WRITE,
+			       MAP_SHARED, db->table_fd, 0);
+		if (db->map == MAP_FAILED) {
+			LogCrit(COMPONENT_FSAL, "ERROR: could not map %s: %s",
+				path, strerror(errno));
+			db->map = NULL;
+			return HANDLEMAP_SYSTEM_ERROR;
+		}
+	}
 
-	rc = sqlite3_prepare_v2(p_thr_info->db_conn,
-				"DELETE FROM " MAP_TABLE " WHERE " OBJID_FIELD
-				"=?1 AND " HASH_FIELD "=?2", -1,
-				&(p_thr_info->prep_stmt[DELETE_STATEMENT]),
-				&unparsed);
+	hdr = (struct hdlmap_header *)db->map;
+	if (db->map_len < HDLMAP_SECTOR || hdr->magic != HDLMAP_MAGIC ||
+	    hdr->slot_size != sizeof(struct hdlmap_slot) ||
+	    (1 + hdr->nsectors) * HDLMAP_SECTOR != db->map_len) {
+		LogCrit(COMPONENT_FSAL,
+			"ERROR: %s is not a handle mapping database", path);
+		return HANDLEMAP_DB_ERROR;
+	}
 
-	CheckPrepare(p_thr_info->db_conn, rc);
+	db->nslots = hdr->nsectors * HDLMAP_SLOTS_PER_SECTOR;
+	db->nfilled = 0;
+	db->nused = 0;
+	for (i = 0; i < db->nslots; i++) {
+		uint8_t state = hdlmap_slot(db, i)->state;
 
-	/* Everything is OK now ! */
+		if (state != SLOT_EMPTY)
+			db->nfilled++;
+		if (state == SLOT_USED)
+			db->nused++;
+	}
 	return HANDLEMAP_SUCCESS;
+}
 
-}				/* init_database_access */
-
-static int db_load_operation(db_thread_info_t *p_info, hash_table_t *p_hash)
+/* Apply what the log holds beyond the table, and get rid of it */
+static int hdlmap_replay_log(db_thread_info_t *db)
 {
-	/* the object id to be inserted to hash table */
-	uint64_t object_id;
-	unsigned int handle_hash;
-	const char *fsal_handle_str;
-	char fh4_data[NFS4_FHSIZE];
-	unsigned int nb_loaded = 0;
-	int rc;
-	struct timeval t1;
-	struct timeval t2;
-	struct timeval tdiff;
+	char path[MAXPATHLEN + 1];
+	struct hdlmap_record *log;
+	struct stat st;
+	unsigned int count, i;
+	off_t done = 0;
+
+	snprintf(path, MAXPATHLEN, "%s/%s.%u", dbmap_dir, LOG_FILE_PREFIX,
+		 db->thr_index);
+
+	db->log_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0600);
+	if (db->log_fd < 0 || fstat(db->log_fd, &st)) {
+		LogCrit(COMPONENT_FSAL, "ERROR: could not open %s: %s", path,
+			strerror(errno));
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
 
-	gettimeofday(&t1, NULL);
+	db->log_size = 0;
+	if (st.st_size == 0)
+		return HANDLEMAP_SUCCESS;
 
-	rc = sqlite3_step(p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-	CheckStep(p_info->db_conn, rc, p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-
-	/* something to read */
-	while (rc == SQLITE_ROW) {
-		object_id =
-		    sqlite3_column_int64(p_info->prep_stmt[LOAD_ALL_STATEMENT],
-					 0);
-		handle_hash =
-		    sqlite3_column_int(p_info->prep_stmt[LOAD_ALL_STATEMENT],
-				       1);
-		fsal_handle_str =
-		    sqlite3_column_text(p_info->prep_stmt[LOAD_ALL_STATEMENT],
-					2);
-
-		if (fsal_handle_str) {
-			int len = strlen(fsal_handle_str);
-
-			if ((len & 1) || len > NFS4_FHSIZE * 2) {
-				LogEvent(COMPONENT_FSAL,
-					 "Bogus handle '%s' - wrong number of symbols",
-					 fsal_handle_str);
-			} else {
-				/* convert hexa string representation
-				 * to binary data */
-				if (sscanmem(fh4_data, len / 2, fsal_handle_str)
-				    != len) {
-					LogEvent(COMPONENT_FSAL,
-						 "Bogus entry '%s' - cannot convert",
-						 fsal_handle_str);
-				} else {
-					/* now insert it to the hash table */
-					rc = handle_mapping_hash_add(
-								p_hash,
-								object_id,
-								handle_hash,
-								fh4_data,
-								len / 2);
-
-					if (rc == 0)
-						nb_loaded++;
-					else
-						LogCrit(COMPONENT_FSAL,
-							"ERROR %d adding entry to hash table <object_id=%llu, FH_hash=%u, FSAL_Handle=%s>",
-							rc,
-							(unsigned long long)
-							object_id, handle_hash,
-							fsal_handle_str);
-				}
-			}
-		} else {
-			LogEvent(COMPONENT_FSAL,
-				 "Empty handle in object %lld, hash %d",
-				 (unsigned long long)object_id, handle_hash);
-		}
+	log = gsh_malloc(st.st_size);
+	if (log == NULL)
+		return HANDLEMAP_SYSTEM_ERROR;
 
-		rc = sqlite3_step(p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-		CheckStep(p_info->db_conn, rc,
-			  p_info->prep_stmt[LOAD_ALL_STATEMENT]);
+	while (done < st.st_size) {
+		ssize_t rc = pread(db->log_fd, (char *)log + done,
+				   st.st_size - done, done);
 
+		if (rc <= 0)
+			break;
+		done += rc;
 	}
 
-	/* clear results */
-	sqlite3_reset(p_info->prep_stmt[LOAD_ALL_STATEMENT]);
-
-	/* print time and item count */
+	/* Stop at the first record the crash may have torn */
+	count = done / sizeof(*log);
+	for (i = 0; i < count; i++) {
+		if ((log[i].op != HDLMAP_OP_INSERT &&
+		     log[i].op != HDLMAP_OP_DELETE) ||
+		    log[i].sum != hdlmap_sum(&log[i].slot))
+			break;
+	}
+	count = i;
 
-	gettimeofday(&t2, NULL);
-	timersub(&t2, &t1, &tdiff);
+	/* The log must survive until its operations are in the table */
+	if (hdlmap_too_full(db, count) &&
+	    hdlmap_grow(db, count, false) != HANDLEMAP_SUCCESS &&
+	    !hdlmap_fits(db, count)) {
+		gsh_free(log);
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
 
-	LogEvent(COMPONENT_FSAL, "Reloaded %u items in %d.%06ds", nb_loaded,
-		 (int)tdiff.tv_sec, (int)tdiff.tv_usec);
+	for (i = 0; i < count; i++) {
+		if (hdlmap_apply(db, &log[i]) != HANDLEMAP_SUCCESS) {
+			gsh_free(log);
+			return HANDLEMAP_SYSTEM_ERROR;
+		}
+	}
 
-	return HANDLEMAP_SUCCESS;
+	LogEvent(COMPONENT_FSAL,
+		 "Replayed %u operations on handle mapping database %u, ignored %llu bytes",
+		 count, db->thr_index,
+		 (unsigned long long)(st.st_size - count * sizeof(*log)));
 
-}				/* db_load_operation */
+	gsh_free(log);
+	return hdlmap_checkpoint(db);
+}
 
-static int db_insert_operation(db_thread_info_t *p_info,
-			       struct hdlmap_tuple *data)
+/* Initialize a database and the queue of its thread */
+static int init_db_thread_info(db_thread_info_t *p_thr_info,
+			       unsigned int index)
 {
 	int rc;
-	char handle_str[2 * NFS4_FHSIZE + 1];
-
-	rc = sqlite3_bind_int64(p_info->prep_stmt[INSERT_STATEMENT], 1,
-				data->nfs23_digest.object_id);
-	CheckBind(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
 
-	rc = sqlite3_bind_int(p_info->prep_stmt[INSERT_STATEMENT], 2,
-			      data->nfs23_digest.handle_hash);
-	CheckBind(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+	if (!p_thr_info)
+		return HANDLEMAP_INTERNAL_ERROR;
 
-	snprintmem(handle_str, sizeof(handle_str), data->fh4_data,
-		   data->fh4_len);
+	memset(p_thr_info, 0, sizeof(db_thread_info_t));
+	p_thr_info->thr_index = index;
+	p_thr_info->table_fd = -1;
+	p_thr_info->log_fd = -1;
+	glist_init(&p_thr_info->waiters);
 
-	rc = sqlite3_bind_text(p_info->prep_stmt[INSERT_STATEMENT], 3,
-			       handle_str, -1, SQLITE_STATIC);
-	CheckBind(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+	if (pthread_mutex_init(&p_thr_info->queue_mutex, NULL))
+		return HANDLEMAP_SYSTEM_ERROR;
 
-	rc = sqlite3_step(p_info->prep_stmt[INSERT_STATEMENT]);
-	CheckStep(p_info->db_conn, rc, p_info->prep_stmt[INSERT_STATEMENT]);
+	if (pthread_cond_init(&p_thr_info->work_avail_condition, NULL))
+		return HANDLEMAP_SYSTEM_ERROR;
 
-	/* clear results */
-	sqlite3_reset(p_info->prep_stmt[INSERT_STATEMENT]);
+	if (pthread_cond_init(&p_thr_info->work_done_condition, NULL))
+		return HANDLEMAP_SYSTEM_ERROR;
 
-	return HANDLEMAP_SUCCESS;
+	rc = hdlmap_open_table(p_thr_info);
+	if (rc != HANDLEMAP_SUCCESS)
+		return rc;
 
-}				/* db_insert_operation */
+	return hdlmap_replay_log(p_thr_info);
+}
 
-static int db_delete_operation(db_thread_info_t *p_info,
-			       nfs23_map_handle_t *p_nfs23_digest)
+static int db_load_operation(db_thread_info_t *p_info, hash_table_t *p_hash,
+			     unsigned int *p_count)
 {
+	unsigned int nb_loaded = 0;
+	unsigned int nb_dup = 0;
+	struct timeval t1;
+	struct timeval t2;
+	struct timeval tdiff;
+	uint64_t i;
 	int rc;
 
-	rc = sqlite3_bind_int64(p_info->prep_stmt[DELETE_STATEMENT], 1,
-				p_nfs23_digest->object_id);
-	CheckBind(p_info->db_conn, rc, p_info->prep_stmt[DELETE_STATEMENT]);
+	gettimeofday(&t1, NULL);
 
-	rc = sqlite3_bind_int(p_info->prep_stmt[DELETE_STATEMENT], 2,
-			      p_nfs23_digest->handle_hash);
-	CheckBind(p_info->db_conn, rc, p_info->prep_stmt[DELETE_STATEMENT]);
+	for (i = 0; i < p_info->nslots; i++) {
+		struct hdlmap_slot *s = hdlmap_slot(p_info, i);
 
-	rc = sqlite3_step(p_info->prep_stmt[DELETE_STATEMENT]);
-	CheckStep(p_info->db_conn, rc, p_info->prep_stmt[DELETE_STATEMENT]);
+		if (s->state != SLOT_USED)
+			continue;
 
-	/* clear results */
-	sqlite3_reset(p_info->prep_stmt[DELETE_STATEMENT]);
+		if (p_hash == NULL) {
+			nb_loaded++;
+			continue;
+		}
 
-	return HANDLEMAP_SUCCESS;
+		rc = handle_mapping_hash_add(p_hash, s->object_id,
+					     s->handle_hash, s->fh4_data,
+					     s->fh4_len);
+		if (rc == HANDLEMAP_SUCCESS) {
+			nb_loaded++;
+		} else if (rc == HANDLEMAP_EXISTS) {
+			/* Stale copy left by a log replay */
+			s->state = SLOT_DELETED;
+			p_info->nused--;
+			nb_dup++;
+		} else {
+			LogCrit(COMPONENT_FSAL,
+				"ERROR %d adding entry to hash table <object_id=%llu, FH_hash=%u>",
+				rc, (unsigned long long)s->object_id,
+				s->handle_hash);
+		}
+	}
 
-}				/* db_delete_operation */
+	/* print time and item count */
+	gettimeofday(&t2, NULL);
+	timersub(&t2, &t1, &tdiff);
+	LogEvent(COMPONENT_FSAL,
+		 "Reloaded %u items (%u duplicates dropped) in %d.%06ds",
+		 nb_loaded, nb_dup, (int)tdiff.tv_sec, (int)tdiff.tv_usec);
 
-/* push a task to the queue */
-static int dbop_push(flusher_queue_t *p_queue, db_op_item_t *p_op)
-{
-	pthread_mutex_lock(&p_queue->queues_mutex);
+	if (p_count)
+		*p_count += nb_loaded;
+	return HANDLEMAP_SUCCESS;
+}				/* db_load_operation */
 
-	/* add an item at the end of the queue */
-	switch (p_op->op_type) {
-	case LOAD:
-	case INSERT:
+/*
+ * Log a batch of operations with a single sync, then apply them.
+ * A batch that could not be logged is dropped, so that the table never
+ * holds what a restart would not find.
+ */
+static int db_commit_operations(db_thread_info_t *p_info,
+				unsigned int count)
+{
+	size_t len = count * sizeof(struct hdlmap_record);
+	int status = HANDLEMAP_SUCCESS;
+	unsigned int i;
+	ssize_t rc;
 
-		/* high priority operations */
+	/* Resizing truncates the log, so do it before this batch is in.
+	 * If that fails, go on only with room for the whole batch. */
+	if (hdlmap_too_full(p_info, count) &&
+	    hdlmap_grow(p_info, count, true) != HANDLEMAP_SUCCESS &&
+	    !hdlmap_fits(p_info, count))
+		return HANDLEMAP_SYSTEM_ERROR;
 
-		p_op->p_next = NULL;
+	rc = write(p_info->log_fd, p_info->batch, len);
+	if (rc != (ssize_t)len || fdatasync(p_info->log_fd)) {
+		LogCrit(COMPONENT_FSAL,
+			"ERROR: could not log %u operations on handle mapping database %u: %s",
+			count, p_info->thr_index, strerror(errno));
+		/* Do not leave a torn record for later ones to follow */
+		if (ftruncate(p_info->log_fd, p_info->log_size))
+			LogCrit(COMPONENT_FSAL,
+				"ERROR: could not truncate handle mapping log %u",
+				p_info->thr_index);
+		return HANDLEMAP_SYSTEM_ERROR;
+	}
+	p_info->log_size += len;
 
-		if (p_queue->highprio_last == NULL) {
-			/* first operation */
-			p_queue->highprio_first = p_op;
-			p_queue->highprio_last = p_op;
-		} else {
-			p_queue->highprio_last->p_next = p_op;
-			p_queue->highprio_last = p_op;
-		}
+	for (i = 0; i < count; i++) {
+		if (hdlmap_apply(p_info, &p_info->batch[i]) !=
+		    HANDLEMAP_SUCCESS)
+			status = HANDLEMAP_SYSTEM_ERROR;
+	}
 
-		p_queue->nb_waiting++;
+	if (p_info->log_size > HDLMAP_LOG_MAX)
+		(void)hdlmap_checkpoint(p_info);
+	return status;
+}
 
-		break;
+/* queue an operation, and wait for it to be committed if asked to */
+static int dbop_push(db_thread_info_t *p_info, uint32_t op,
+		     const nfs23_map_handle_t *p_nfs23_digest,
+		     const void *data, uint32_t len, int wait)
+{
+	struct hdlmap_record *rec;
+	struct hdlmap_waiter waiter;
 
-	case DELETE:
+	if (len > NFS4_FHSIZE)
+		return HANDLEMAP_INVALID_PARAM;
 
-		/* low priority operation */
+	pthread_mutex_lock(&p_info->queue_mutex);
 
-		p_op->p_next = NULL;
+	if (p_info->queue_len == p_info->queue_size) {
+		unsigned int size =
+		    p_info->queue_size ? 2 * p_info->queue_size : 64;
 
-		if (p_queue->lowprio_last == NULL) {
-			/* first operation */
-			p_queue->lowprio_first = p_op;
-			p_queue->lowprio_last = p_op;
-		} else {
-			p_queue->lowprio_last->p_next = p_op;
-			p_queue->lowprio_last = p_op;
+		rec = gsh_realloc(p_info->queue, size * sizeof(*rec));
+		if (rec == NULL) {
+			pthread_mutex_unlock(&p_info->queue_mutex);
+			return HANDLEMAP_SYSTEM_ERROR;
 		}
-
-		p_queue->nb_waiting++;
-
-		break;
-
-	default:
-		LogCrit(COMPONENT_FSAL,
-			"ERROR in dbop_push: Invalid operation type %d",
-			p_op->op_type);
+		p_info->queue = rec;
+		p_info->queue_size = size;
 	}
 
-	/* there now some work available */
-	pthread_cond_signal(&p_queue->work_avail_condition);
+	rec = &p_info->queue[p_info->queue_len++];
+	memset(rec, 0, sizeof(*rec));
+	rec->op = op;
+	rec->slot.object_id = p_nfs23_digest->object_id;
+	rec->slot.handle_hash = p_nfs23_digest->handle_hash;
+	rec->slot.state = SLOT_USED;
+	rec->slot.fh4_len = len;
+	if (len)
+		memcpy(rec->slot.fh4_data, data, len);
+	rec->sum = hdlmap_sum(&rec->slot);
+
+	waiter.seq = ++p_info->submitted;
+	waiter.rc = HANDLEMAP_SUCCESS;
+	waiter.done = !wait;
+	if (wait)
+		glist_add_tail(&p_info->waiters, &waiter.list);
 
-	pthread_mutex_unlock(&p_queue->queues_mutex);
+	/* there now some work available */
+	pthread_cond_signal(&p_info->work_avail_condition);
 
-	return HANDLEMAP_SUCCESS;
+	while (!waiter.done)
+		pthread_cond_wait(&p_info->work_done_condition,
+				  &p_info->queue_mutex);
 
+	pthread_mutex_unlock(&p_info->queue_mutex);
+	return waiter.rc;
 }
 
 static void *database_worker_thread(void *arg)
 {
 	db_thread_info_t *p_info = (db_thread_info_t *) arg;
+	struct hdlmap_record *batch;
+	struct glist_head *glist, *glistn;
+	unsigned int size, count;
+	uint64_t submitted;
 	int rc;
-	db_op_item_t *to_be_done = NULL;
 	char thread_name[256];
 
 	/* initialize logging */
 	snprintf(thread_name, 256, "DB thread #%u", p_info->thr_index);
 	SetNameFunction(thread_name);
 
-	/* initialize memory management */
-
-	rc = init_database_access(p_info);
+	pthread_mutex_lock(&p_info->queue_mutex);
 
-	if (rc != HANDLEMAP_SUCCESS) {
-		/* Failed init */
-		LogCrit(COMPONENT_FSAL,
-			"ERROR: Database initialization error %d", rc);
-		exit(rc);
-	}
-
-	/* main loop */
 	while (1) {
-
-		/* Is "work done" or "work available" condition verified ? */
-
-		pthread_mutex_lock(&p_info->work_queue.queues_mutex);
-
-		/* nothing to be done ? */
-		while (p_info->work_queue.highprio_first == NULL
-		       && p_info->work_queue.lowprio_first == NULL) {
-			to_be_done = NULL;
-			p_info->work_queue.status = IDLE;
-			pthread_cond_signal(&p_info->work_queue.
-					    work_done_condition);
-
+		while (p_info->queue_len == 0) {
 			/* if termination is requested, exit */
 			if (do_terminate) {
-				p_info->work_queue.status = FINISHED;
-				pthread_mutex_unlock(&p_info->work_queue
-								.queues_mutex);
+				pthread_mutex_unlock(&p_info->queue_mutex);
 				return (void *)p_info;
 			}
-
-			/* else, wait for something to do */
-			pthread_cond_wait(&p_info->work_queue.
-					  work_avail_condition,
-					  &p_info->work_queue.queues_mutex);
-
+			pthread_cond_wait(&p_info->work_avail_condition,
+					  &p_info->queue_mutex);
 		}
 
-		/* there is something to do:
-		 * first check the highest priority list,
-		 * then the lower priority.
-		 */
-
-		if (p_info->work_queue.highprio_first != NULL) {
-			/* take the next item in the list */
-			to_be_done = p_info->work_queue.highprio_first;
-			p_info->work_queue.highprio_first = to_be_done->p_next;
-
-			/* still any entries in the list ? */
-			if (p_info->work_queue.highprio_first == NULL)
-				p_info->work_queue.highprio_last = NULL;
-			/* it it the last entry ? */
-			else if (p_info->work_queue.highprio_first->p_next ==
-				 NULL)
-				p_info->work_queue.highprio_last =
-				    p_info->work_queue.highprio_first;
-
-			/* something to do */
-			p_info->work_queue.status = WORKING;
-		} else if (p_info->work_queue.lowprio_first != NULL) {
-			/* take the next item in the list */
-			to_be_done = p_info->work_queue.lowprio_first;
-			p_info->work_queue.lowprio_first = to_be_done->p_next;
-
-			/* still any entries in the list ? */
-			if (p_info->work_queue.lowprio_first == NULL)
-				p_info->work_queue.lowprio_last = NULL;
-			/* it it the last entry ? */
-			else if (p_info->work_queue.lowprio_first->p_next ==
-				 NULL)
-				p_info->work_queue.lowprio_last =
-				    p_info->work_queue.lowprio_first;
-
-			/* something to do */
-			p_info->work_queue.status = WORKING;
-		}
-
-		p_info->work_queue.nb_waiting--;
+		/* Take everything submitted so far as one batch, and
+		 * give the thread's spare buffer to the submitters */
+		batch = p_info->batch;
+		size = p_info->batch_size;
+		p_info->batch = p_info->queue;
+		p_info->batch_size = p_info->queue_size;
+		p_info->queue = batch;
+		p_info->queue_size = size;
 
-		pthread_mutex_unlock(&p_info->work_queue.queues_mutex);
+		count = p_info->queue_len;
+		p_info->queue_len = 0;
+		submitted = p_info->submitted;
 
-		/* PROCESS THE REQUEST */
+		pthread_mutex_unlock(&p_info->queue_mutex);
 
-		switch (to_be_done->op_type) {
-		case LOAD:
-			db_load_operation(p_info, to_be_done->op_arg.hash);
-			break;
+		rc = db_commit_operations(p_info, count);
 
-		case INSERT:
-			db_insert_operation(p_info,
-					    &to_be_done->op_arg.fh_info);
-			break;
+		pthread_mutex_lock(&p_info->queue_mutex);
+		p_info->committed = submitted;
 
-		case DELETE:
-			db_delete_operation(p_info,
-					    &to_be_done->op_arg.fh_info.
-					    nfs23_digest);
-			break;
+		/* Tell the submitters of this batch how it went */
+		glist_for_each_safe(glist, glistn, &p_info->waiters) {
+			struct hdlmap_waiter *w =
+			    glist_entry(glist, struct hdlmap_waiter, list);
 
-		default:
-			LogCrit(COMPONENT_FSAL,
-				"ERROR: Invalid operation type %d",
-				to_be_done->op_type);
+			if (w->seq > submitted)
+				break;
+			glist_del(&w->list);
+			w->rc = rc;
+			w->done = true;
 		}
-
-		/* free the db operation item */
-		pthread_mutex_lock(&p_info->pool_mutex);
-		pool_free(p_info->dbop_pool, to_be_done);
-		pthread_mutex_unlock(&p_info->pool_mutex);
-
-	}			/* loop forever */
+		pthread_cond_broadcast(&p_info->work_done_condition);
+	}
 
 	return (void *)p_info;
 }
@@ -835,13 +951,11 @@ unsigned int select_db_queue(const nfs23_map_handle_t *p_nfs23_digest)
 
 	return h;
 }
-
 /**
  * Initialize databases access
- * - init DB queues
+ * - open or create the database files
+ * - replay their logs
  * - start threads
- * - establish DB connections
- * - create db schema if it was empty
  */
 int handlemap_db_init(const char *db_dir, const char *tmp_dir,
 		      unsigned int db_count, int synchronous_insert)
@@ -852,26 +966,20 @@ int handlemap_db_init(const char *db_dir, const char *tmp_dir,
 	/* first, save the parameters */
 
 	strncpy(dbmap_dir, db_dir, MAXPATHLEN);
-	strncpy(db_tmpdir, tmp_dir, MAXPATHLEN);
 
 	if (db_count > MAX_DB)
 		return HANDLEMAP_INVALID_PARAM;
 
 	nb_db_threads = db_count;
 	synchronous = synchronous_insert;
-	/* set global database engine info */
-
-	sqlite3_temp_directory = db_tmpdir;
 
 	/* initialize structures for each thread and launch it */
 
 	for (i = 0; i < nb_db_threads; i++) {
-		rc = init_db_thread_info(&db_thread[i], 100);
+		rc = init_db_thread_info(&db_thread[i], i);
 		if (rc)
 			return rc;
 
-		db_thread[i].thr_index = i;
-
 		rc = pthread_create(&db_thread[i].thr_id, NULL,
 				    database_worker_thread, &db_thread[i]);
 		if (rc)
@@ -882,109 +990,74 @@ int handlemap_db_init(const char *db_dir, const char *tmp_dir,
 	return HANDLEMAP_SUCCESS;
 }
 
-/* wait that a thread has done all its jobs */
+/* wait that a thread has committed all it was given so far */
 static void wait_thread_jobs_finished(db_thread_info_t *p_thr_info)
 {
+	uint64_t target;
 
-	pthread_mutex_lock(&p_thr_info->work_queue.queues_mutex);
-
-	/* wait until the thread has no more tasks in its queue
-	 * and it is no more working
-	 */
-	while (p_thr_info->work_queue.highprio_first != NULL
-	       || p_thr_info->work_queue.lowprio_first != NULL
-	       || p_thr_info->work_queue.status == WORKING)
-		pthread_cond_wait(&p_thr_info->work_queue.work_done_condition,
-				  &p_thr_info->work_queue.queues_mutex);
+	pthread_mutex_lock(&p_thr_info->queue_mutex);
 
-	pthread_mutex_unlock(&p_thr_info->work_queue.queues_mutex);
+	target = p_thr_info->submitted;
+	while (p_thr_info->committed < target)
+		pthread_cond_wait(&p_thr_info->work_done_condition,
+				  &p_thr_info->queue_mutex);
 
+	pthread_mutex_unlock(&p_thr_info->queue_mutex);
 }
 
 /**
- * Gives the order to each DB thread to reload
- * the content of its database and insert it
- * to the hash table.
- * The function blocks until all threads have loaded their data.
+ * Load the content of every database into the hash table.
+ * This is meant to be called at start, before any insert.
  */
 int handlemap_db_reaload_all(hash_table_t *target_hash)
 {
 	unsigned int i;
-	db_op_item_t *new_task;
 	int rc;
 
-	/* give the job to all threads */
 	for (i = 0; i < nb_db_threads; i++) {
-		/* get a new db operation  */
-		pthread_mutex_lock(&db_thread[i].pool_mutex);
-
-		new_task = pool_alloc(db_thread[i].dbop_pool, NULL);
-
-		pthread_mutex_unlock(&db_thread[i].pool_mutex);
-
-		if (!new_task)
-			return HANDLEMAP_SYSTEM_ERROR;
-
-		/* can you fill it ? */
-		new_task->op_type = LOAD;
-		new_task->op_arg.hash = target_hash;
-
-		rc = dbop_push(&db_thread[i].work_queue, new_task);
+		wait_thread_jobs_finished(&db_thread[i]);
 
+		rc = db_load_operation(&db_thread[i], target_hash, NULL);
 		if (rc)
 			return rc;
 	}
 
-	/* wait for all threads to finish their job */
-
-	for (i = 0; i < nb_db_threads; i++)
-		wait_thread_jobs_finished(&db_thread[i]);
-
 	return HANDLEMAP_SUCCESS;
-
 }				/* handlemap_db_reaload_all */
 
 /**
- * Submit a db 'insert' request.
- * The request is inserted in the appropriate db queue.
+ * Count the mappings held by every database, once everything
+ * submitted so far is committed.
  */
-int handlemap_db_insert(nfs23_map_handle_t *p_in_nfs23_digest,
-			const void *data, uint32_t len)
+int handlemap_db_count_entries(unsigned int *p_count)
 {
 	unsigned int i;
-	db_op_item_t *new_task;
 	int rc;
 
-	if (!synchronous) {
-		/* which thread is going to handle this inode ? */
-
-		i = select_db_queue(p_in_nfs23_digest);
-
-		/* get a new db operation  */
-		pthread_mutex_lock(&db_thread[i].pool_mutex);
-
-		new_task = pool_alloc(db_thread[i].dbop_pool, NULL);
-
-		pthread_mutex_unlock(&db_thread[i].pool_mutex);
-
-		if (!new_task)
-			return HANDLEMAP_SYSTEM_ERROR;
-
-		/* fill the task info */
-		new_task->op_type = INSERT;
-		new_task->op_arg.fh_info.nfs23_digest = *p_in_nfs23_digest;
-		memcpy(new_task->op_arg.fh_info.fh4_data, data, len);
-		new_task->op_arg.fh_info.fh4_len = len;
-
-		rc = dbop_push(&db_thread[i].work_queue, new_task);
+	*p_count = 0;
+	for (i = 0; i < nb_db_threads; i++) {
+		wait_thread_jobs_finished(&db_thread[i]);
 
+		rc = db_load_operation(&db_thread[i], NULL, p_count);
 		if (rc)
 			return rc;
 	}
-	/* else: @todo not supported yet */
 
 	return HANDLEMAP_SUCCESS;
+}
+
+/**
+ * Submit a db 'insert' request.
+ * The request is inserted in the appropriate db queue, and waited
+ * for if inserts are synchronous.
+ */
+int handlemap_db_insert(nfs23_map_handle_t *p_in_nfs23_digest,
+			const void *data, uint32_t len)
+{
+	unsigned int i = select_db_queue(p_in_nfs23_digest);
 
+	return dbop_push(&db_thread[i], HDLMAP_OP_INSERT, p_in_nfs23_digest,
+			 data, len, synchronous);
 }
 
 /**
@@ -994,35 +1067,10 @@ int handlemap_db_insert(nfs23_map_handle_t *p_in_nfs23_digest,
  */
 int handlemap_db_delete(nfs23_map_handle_t *p_in_nfs23_digest)
 {
-	unsigned int i;
-	db_op_item_t *new_task;
-	int rc;
-
-	/* which thread is going to handle this inode ? */
-
-	i = select_db_queue(p_in_nfs23_digest);
-
-	/* get a new db operation  */
-	pthread_mutex_lock(&db_thread[i].pool_mutex);
-
-	new_task = pool_alloc(db_thread[i].dbop_pool, NULL);
-
-	pthread_mutex_unlock(&db_thread[i].pool_mutex);
-
-	if (!new_task)
-		return HANDLEMAP_SYSTEM_ERROR;
-
-	/* fill the task info */
-	new_task->op_type = DELETE;
-	new_task->op_arg.fh_info.nfs23_digest = *p_in_nfs23_digest;
-
-	rc = dbop_push(&db_thread[i].work_queue, new_task);
-
-	if (rc)
-		return rc;
-
-	return HANDLEMAP_SUCCESS;
+	unsigned int i = select_db_queue(p_in_nfs23_digest);
 
+	return dbop_push(&db_thread[i], HDLMAP_OP_DELETE, p_in_nfs23_digest,
+			 NULL, 0, false);
 }
 
 /**
@@ -1038,7 +1086,7 @@ int handlemap_db_flush()
 	unsigned int to_sync = 0;
 
 	for (i = 0; i < nb_db_threads; i++)
-		to_sync += db_thread[i].work_queue.nb_waiting;
+		to_sync += db_thread[i].submitted - db_thread[i].committed;
 
 	LogEvent(COMPONENT_FSAL,
 		 "Waiting for database synchronization (%u operations pending)",
@@ -1061,3 +1109,42 @@ int handlemap_db_flush()
 	return HANDLEMAP_SUCCESS;
 
 }
+
+/**
+ * Commit what is pending, stop the threads and close the databases.
+ * handlemap_db_init may be called again afterwards.
+ */
+int handlemap_db_shutdown()
+{
+	db_thread_info_t *p_info;
+	unsigned int i;
+	int rc = HANDLEMAP_SUCCESS;
+
+	do_terminate = true;
+
+	for (i = 0; i < nb_db_threads; i++) {
+		p_info = &db_thread[i];
+
+		pthread_mutex_lock(&p_info->queue_mutex);
+		pthread_cond_signal(&p_info->work_avail_condition);
+		pthread_mutex_unlock(&p_info->queue_mutex);
+
+		pthread_join(p_info->thr_id, NULL);
+
+		if (hdlmap_checkpoint(p_info) != HANDLEMAP_SUCCESS)
+			rc = HANDLEMAP_SYSTEM_ERROR;
+
+		munmap(p_info->map, p_info->map_len);
+		close(p_info->table_fd);
+		close(p_info->log_fd);
+		gsh_free(p_info->queue);
+		gsh_free(p_info->batch);
+		pthread_cond_destroy(&p_info->work_done_condition);
+		pthread_cond_destroy(&p_info->work_avail_condition);
+		pthread_mutex_destroy(&p_info->queue_mutex);
+	}
+
+	nb_db_threads = 0;
+	do_terminate = false;
+	return rc;
+}
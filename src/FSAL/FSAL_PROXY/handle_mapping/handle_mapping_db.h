@@ -4,13 +4,8 @@
 #include "handle_mapping.h"
 #include "hashtable.h"
 
-#define DB_FILE_PREFIX "handlemap.sqlite"
-
-/* Database definition */
-#define MAP_TABLE      "HandleMap"
-#define OBJID_FIELD    "ObjectId"
-#define HASH_FIELD     "HandleHash"
-#define HANDLE_FIELD   "FSALHandle"
+#define DB_FILE_PREFIX  "handlemap.db"
+#define LOG_FILE_PREFIX "handlemap.log"
 
 #define MAX_DB  32
 
@@ -23,23 +18,30 @@ int handlemap_db_count(const char *dir);
 
 /**
  * Initialize databases access
- * (init DB queues, start threads, establish DB connections,
- * and create db schema if it was empty).
+ * (open or create the database files, replay their logs,
+ * init DB queues and start threads).
+ * tmp_dir is not used anymore.
  */
 int handlemap_db_init(const char *db_dir, const char *tmp_dir,
 		      unsigned int db_count, int synchronous_insert);
 
 /**
- * Gives the order to each DB thread to reload
- * the content of its database and insert it
- * to the hash table.
- * The function blocks until all threads have loaded their data.
+ * Reload the content of each database and insert it
+ * to the hash table (only count it if target_hash is NULL).
+ * The function blocks until all databases have been loaded.
  */
 int handlemap_db_reaload_all(hash_table_t *target_hash);
 
+/**
+ * Count the mappings held by all databases.
+ * Blocks until the operations submitted so far are committed.
+ */
+int handlemap_db_count_entries(unsigned int *p_count);
+
 /**
  * Submit a db 'insert' request.
- * The request is inserted in the appropriate db queue.
+ * The request is inserted in the appropriate db queue,
+ * and waited for if inserts are synchronous.
  */
 int handlemap_db_insert(nfs23_map_handle_t *p_in_nfs23_digest,
 			const void *data, uint32_t len);
@@ -57,4 +59,9 @@ int handlemap_db_delete(nfs23_map_handle_t *p_in_nfs23_digest);
  */
 int handlemap_db_flush();
 
+/**
+ * Flush the databases, stop their threads and close them.
+ */
+int handlemap_db_shutdown();
+
 #endif
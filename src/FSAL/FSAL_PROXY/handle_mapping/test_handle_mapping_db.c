@@ -1,118 +1,220 @@
 #include "config.h"
+#include "nfs4.h"
 #include "handle_mapping_db.h"
 #include <sys/time.h>
+#include <pthread.h>
+#include <limits.h>
 
-int main(int argc, char **argv)
+static unsigned int nb_items = 10000;
+static unsigned int nb_threads = 1;
+static unsigned int base;
+static time_t now;
+
+static inline void make_digest(nfs23_map_handle_t *p_digest, unsigned int i)
 {
-	unsigned int i;
-	struct timeval tv1, tv2, tv3, tvdiff;
-	int count, rc;
-	char *dir;
-	time_t now;
+	p_digest->object_id = 12345 + i;
+	p_digest->handle_hash = (1999 * i + now) % 479001599;
+}
 
-	if (argc != 3) {
-		LogTest("usage: test_handle_mapping_db <db_dir> <db_count>");
-		exit(1);
-	}
+/* each thread inserts its share of the handles */
+static void *insert_thread(void *arg)
+{
+	unsigned int first = (uintptr_t) arg;
+	unsigned int i;
+	int rc;
 
-	count = atoi(argv[2])
-	if (count == 0) {
-		LogTest("usage: test_handle_mapping_db <db_dir> <db_count>");
-		exit(1);
-	}
+	for (i = first; i < nb_items; i += nb_threads) {
+		nfs23_map_handle_t nfs23_digest;
+		char handle[NFS4_FHSIZE];
 
-	dir = argv[1];
+		memset(handle, i, sizeof(handle));
+		make_digest(&nfs23_digest, base + i);
 
-	/* Init logging */
-	SetNamePgm("test_handle_mapping");
-	SetNameFileLog("/dev/tty");
-	SetNameFunction("main");
-	SetNameHost("localhost");
+		rc = handlemap_db_insert(&nfs23_digest, handle,
+					 sizeof(handle));
+		if (rc) {
+			LogTest("handlemap_db_insert() = %d", rc);
+			exit(rc);
+		}
+	}
 
-	/* count databases */
+	return NULL;
+}
 
-	rc = handlemap_db_count(dir);
+static void log_rate(const char *what, unsigned int n, struct timeval *tv)
+{
+	double secs = tv->tv_sec + tv->tv_usec / 1000000.0;
 
-	LogTest("handlemap_db_count(%s)=%d", dir, rc);
+	LogTest("%s %u handles in %d.%06ds (%.0f ops/s)", what, n,
+		(int)tv->tv_sec, (int)tv->tv_usec, secs > 0 ? n / secs : 0);
+}
 
-	if (rc != 0 && count != rc) {
-		LogTest(
-			"Warning: incompatible thread count %d <> database count %d",
-			count, rc);
-	}
+/* Open the databases and check how many mappings they hold */
+static unsigned int open_dbs(char *dir, unsigned int count, int sync,
+		     unsigned int expected)
+{
+	unsigned int loaded;
+	int rc;
 
-	rc = handlemap_db_init(dir, "/tmp", count, 1024, false);
+	rc = handlemap_db_init(dir, "/tmp", count, sync);
 
 	LogTest("handlemap_db_init() = %d", rc);
 	if (rc)
 		exit(rc);
 
-	rc = handlemap_db_reaload_all(NULL);
+	rc = handlemap_db_count_entries(&loaded);
 
-	LogTest("handlemap_db_reaload_all() = %d", rc);
+	LogTest("handlemap_db_count_entries() = %d, %u entries", rc, loaded);
 	if (rc)
 		exit(rc);
 
-	gettimeofday(&tv1, NULL);
-
-	/* Now insert a set of handles */
+	if (expected != UINT_MAX && loaded != expected) {
+		LogTest("ERROR: expected %u entries, found %u", expected,
+			loaded);
+		exit(1);
+	}
+	return loaded;
+}
 
-	now = time(NULL);
+/*
+ * Insert nb_items handles from base, then delete every other one.
+ * Returns the number of handles left.
+ */
+static unsigned int run_benchmark(unsigned int count, const char *mode)
+{
+	unsigned int i, ndel = 0;
+	struct timeval tv1, tv2, tv3, tvdiff;
+	pthread_t threads[64];
+	int rc;
 
-	for (i = 0; i < 10000; i++) {
-		nfs23_map_handle_t nfs23_digest;
-		fsal_handle_t handle;
+	LogTest("%u threads on %u databases, %s inserts:", nb_threads,
+		count, mode);
 
-		memset(&handle, i, sizeof(fsal_handle_t));
-		nfs23_digest.object_id = 12345 + i;
-		nfs23_digest.handle_hash = (1999 * i + now) % 479001599;
+	gettimeofday(&tv1, NULL);
 
-		rc = handlemap_db_insert(&nfs23_digest, &handle);
+	for (i = 0; i < nb_threads; i++) {
+		rc = pthread_create(&threads[i], NULL, insert_thread,
+				    (void *)(uintptr_t) i);
 		if (rc)
 			exit(rc);
 	}
 
-	gettimeofday(&tv2, NULL);
+	for (i = 0; i < nb_threads; i++)
+		pthread_join(threads[i], NULL);
 
+	gettimeofday(&tv2, NULL);
 	timersub(&tv2, &tv1, &tvdiff);
-
-	LogTest("%u threads inserted 10000 handles in %d.%06ds", count,
-		(int)tvdiff.tv_sec, (int)tvdiff.tv_usec);
+	log_rate("queued inserts of", nb_items, &tvdiff);
 
 	rc = handlemap_db_flush();
 
 	gettimeofday(&tv3, NULL);
-
 	timersub(&tv3, &tv1, &tvdiff);
-	LogTest("Total time with %u threads (including flush): %d.%06ds", count,
-		(int)tvdiff.tv_sec, (int)tvdiff.tv_usec);
+	log_rate("committed inserts of", nb_items, &tvdiff);
 
 	LogTest("Now, delete operations");
 
-	for (i = 0; i < 10000; i++) {
+	for (i = 0; i < nb_items; i += 2) {
 		nfs23_map_handle_t nfs23_digest;
 
-		nfs23_digest.object_id = 12345 + i;
-		nfs23_digest.handle_hash = (1999 * i + now) % 479001599;
+		make_digest(&nfs23_digest, base + i);
 
 		rc = handlemap_db_delete(&nfs23_digest);
 		if (rc)
 			exit(rc);
+		ndel++;
 	}
 
 	gettimeofday(&tv2, NULL);
 	timersub(&tv2, &tv3, &tvdiff);
-
-	LogTest("%u threads deleted 10000 handles in %d.%06ds", count,
-		(int)tvdiff.tv_sec, (int)tvdiff.tv_usec);
+	log_rate("queued deletes of", ndel, &tvdiff);
 
 	rc = handlemap_db_flush();
 
 	gettimeofday(&tv1, NULL);
 	timersub(&tv1, &tv3, &tvdiff);
-	LogTest("Delete time with %u threads (including flush): %d.%06ds",
-		count, (int)tvdiff.tv_sec, (int)tvdiff.tv_usec);
+	log_rate("committed deletes of", ndel, &tvdiff);
+
+	base += nb_items;
+	return nb_items - ndel;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int expected;
+	struct timeval tv;
+	int count, rc;
+	char *dir;
+
+	if (argc < 3 || argc > 5) {
+		LogTest("usage: test_handle_mapping_db <db_dir> <db_count> [count] [threads]");
+		exit(1);
+	}
+
+	count = atoi(argv[2]);
+	if (count == 0) {
+		LogTest("usage: test_handle_mapping_db <db_dir> <db_count> [count] [threads]");
+		exit(1);
+	}
+
+	if (argc > 3)
+		nb_items = atoi(argv[3]);
+
+	if (argc > 4)
+		nb_threads = atoi(argv[4]);
+
+	if (nb_threads == 0 || nb_threads > 64) {
+		LogTest("threads must be between 1 and 64");
+		exit(1);
+	}
+
+	dir = argv[1];
+
+	/* Init logging */
+	SetNamePgm("test_handle_mapping");
+	SetNameFileLog("/dev/tty");
+	SetNameFunction("main");
+	SetNameHost("localhost");
+
+	/* count databases */
+
+	rc = handlemap_db_count(dir);
+
+	LogTest("handlemap_db_count(%s)=%d", dir, rc);
+
+	if (rc != 0 && count != rc) {
+		LogTest(
+			"Warning: incompatible thread count %d <> database count %d",
+			count, rc);
+	}
+
+	/* Keep apart from the handles of earlier runs */
+	gettimeofday(&tv, NULL);
+	now = tv.tv_sec * 1000000 + tv.tv_usec;
+
+	/* Whatever an earlier run left is counted first */
+	expected = open_dbs(dir, count, false, UINT_MAX);
+
+	expected += run_benchmark(count, "asynchronous");
+
+	/* Reopen with synchronous inserts: each one waits for the group
+	 * commit of its batch */
+	rc = handlemap_db_shutdown();
+	LogTest("handlemap_db_shutdown() = %d", rc);
+	if (rc)
+		exit(rc);
+	open_dbs(dir, count, true, expected);
+
+	expected += run_benchmark(count, "synchronous");
+
+	rc = handlemap_db_shutdown();
+	LogTest("handlemap_db_shutdown() = %d", rc);
+	if (rc)
+		exit(rc);
+	open_dbs(dir, count, false, expected);
 
-	exit(0);
+	rc = handlemap_db_shutdown();
+	LogTest("handlemap_db_shutdown() = %d", rc);
+	exit(rc);
 
 }
@@ -90,6 +90,16 @@ static struct config_item proxy_client_params[] = {
 		       pxy_client_params, use_privileged_client_port),
 	CONF_ITEM_UI32("RPC_Client_Timeout", 1, 60*4, 60,
 		       pxy_client_params, srv_timeout),
+	CONF_ITEM_UI32("RPC_Connections", 1, 64, 4,
+		       pxy_client_params, srv_connections),
+	CONF_ITEM_UI32("RPC_Max_Calls", 1, 4096, 64,
+		       pxy_client_params, srv_max_calls),
+	CONF_ITEM_UI32("Attr_Cache_Timeout", 0, 3600, 0,
+		       pxy_client_params, attr_cache_timeout),
+	CONF_ITEM_UI32("Attr_Cache_Entries", 1024, 1 << 24, 65536,
+		       pxy_client_params, attr_cache_entries),
+	CONF_ITEM_BOOL("Readdir_Prefetch", true,
+		       pxy_client_params, readdir_prefetch),
 #ifdef _USE_GSSRPC
 	CONF_ITEM_STR("Remote_PrincipalName", 0, MAXNAMLEN, NULL,
 		      pxy_client_params, remote_principal),
@@ -185,6 +195,10 @@ static fsal_status_t pxy_init_config(struct fsal_module *fsal_hdl,
 		return fsalstat(ERR_FSAL_INVAL, -rc);
 #endif
 
+	rc = pxy_cache_init(&pxy->special);
+	if (rc)
+		return fsalstat(ERR_FSAL_NOMEM, rc);
+
 	rc = pxy_init_rpc(pxy);
 	if (rc)
 		return fsalstat(ERR_FSAL_FAULT, rc);
@@ -0,0 +1,522 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file pxy_cache.c
+ * @brief Attribute and name cache in front of the remote server
+ *
+ * Attributes are kept for Attr_Cache_Timeout seconds, keyed on the
+ * remote filehandle.  Names are kept together with the change
+ * attribute their directory had when they were looked up, and are
+ * only trusted while the directory's cached attributes still carry
+ * that change attribute: every time the directory's attributes are
+ * refetched, all its names are revalidated at once.
+ *
+ * Both tables are split into partitions with their own lock and LRU
+ * list, the least recently used entry of a partition is recycled
+ * when it is full.
+ */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "fsal.h"
+#include "ganesha_list.h"
+#include "city.h"
+#include "pxy_fsal_methods.h"
+
+#define PXY_CACHE_PARTS 16
+
+struct pxy_cache_part {
+	pthread_mutex_t lock;
+	struct glist_head lru;		/* Most recently used first */
+	uint32_t count;
+	struct glist_head *buckets;
+};
+
+struct pxy_cache_table {
+	struct pxy_cache_part parts[PXY_CACHE_PARTS];
+	uint32_t nbuckets;		/* Per partition */
+	uint32_t max;			/* Entries per partition */
+};
+
+struct pxy_attr_entry {
+	struct glist_head hash;
+	struct glist_head lru;
+	uint64_t key;
+	time_t expire;
+	struct attrlist attrs;
+	uint32_t fhlen;
+	char fh[NFS4_FHSIZE];
+};
+
+struct pxy_name_entry {
+	struct glist_head hash;
+	struct glist_head lru;
+	uint64_t key;
+	uint64_t dir_change;		/* Change attribute of directory */
+	uint32_t dirfhlen;
+	uint32_t fhlen;
+	char dirfh[NFS4_FHSIZE];
+	char fh[NFS4_FHSIZE];
+	char name[MAXNAMLEN + 1];
+};
+
+static struct pxy_cache_table attr_table;
+static struct pxy_cache_table name_table;
+static uint32_t attr_timeout;
+static bool readdir_prefetch;
+
+static int pxy_cache_table_init(struct pxy_cache_table *table,
+				uint32_t entries)
+{
+	int i;
+	uint32_t j;
+
+	table->max = entries / PXY_CACHE_PARTS + 1;
+	table->nbuckets = table->max / 2 + 1;
+
+	for (i = 0; i < PXY_CACHE_PARTS; i++) {
+		struct pxy_cache_part *part = &table->parts[i];
+
+		part->buckets = gsh_malloc(table->nbuckets *
+					   sizeof(*part->buckets));
+		if (part->buckets == NULL)
+			return ENOMEM;
+		for (j = 0; j < table->nbuckets; j++)
+			glist_init(&part->buckets[j]);
+		glist_init(&part->lru);
+		part->count = 0;
+		pthread_mutex_init(&part->lock, NULL);
+	}
+	return 0;
+}
+
+/**
+ * @brief Set up the caches
+ *
+ * @param[in] info Remote server parameters
+ *
+ * @return 0 or an errno.
+ */
+
+int pxy_cache_init(const proxyfs_specific_initinfo_t *info)
+{
+	int rc;
+
+	attr_timeout = info->attr_cache_timeout;
+	readdir_prefetch = info->readdir_prefetch;
+	if (attr_timeout == 0)
+		return 0;
+
+	rc = pxy_cache_table_init(&attr_table, info->attr_cache_entries);
+	if (rc == 0)
+		rc = pxy_cache_table_init(&name_table,
+					  info->attr_cache_entries);
+	if (rc != 0) {
+		LogCrit(COMPONENT_FSAL, "Cannot allocate proxy cache - %s",
+			strerror(rc));
+		attr_timeout = 0;
+		return rc;
+	}
+
+	LogInfo(COMPONENT_FSAL,
+		"Caching attributes for %u seconds, %u entries",
+		attr_timeout, info->attr_cache_entries);
+	return 0;
+}
+
+/**
+ * @brief Tell whether readdir should fetch attributes for the cache
+ */
+
+bool pxy_cache_prefetch(void)
+{
+	return attr_timeout != 0 && readdir_prefetch;
+}
+
+static inline struct pxy_cache_part *
+pxy_cache_part(struct pxy_cache_table *table, uint64_t key)
+{
+	return &table->parts[key % PXY_CACHE_PARTS];
+}
+
+static inline struct glist_head *
+pxy_cache_bucket(struct pxy_cache_table *table, struct pxy_cache_part *part,
+		 uint64_t key)
+{
+	return &part->buckets[(key / PXY_CACHE_PARTS) % table->nbuckets];
+}
+
+static inline uint64_t pxy_fh_key(const nfs_fh4 *fh)
+{
+	return CityHash64(fh->nfs_fh4_val, fh->nfs_fh4_len);
+}
+
+static inline uint64_t pxy_name_key(const nfs_fh4 *dir, const char *name)
+{
+	return CityHash64WithSeed(name, strlen(name), pxy_fh_key(dir));
+}
+
+/*
+ * Make room for one more entry in part, returning a recycled entry
+ * if the partition was full.  Called with the partition locked.
+ */
+static struct glist_head *pxy_cache_reclaim(struct pxy_cache_table *table,
+					    struct pxy_cache_part *part)
+{
+	struct glist_head *lru;
+
+	if (part->count < table->max)
+		return NULL;
+
+	lru = part->lru.prev;
+	glist_del(lru);
+	part->count--;
+	return lru;
+}
+
+static struct pxy_attr_entry *pxy_attr_find(struct pxy_cache_part *part,
+					    const nfs_fh4 *fh, uint64_t key)
+{
+	struct glist_head *bucket = pxy_cache_bucket(&attr_table, part, key);
+	struct glist_head *node;
+
+	glist_for_each(node, bucket) {
+		struct pxy_attr_entry *e =
+		    glist_entry(node, struct pxy_attr_entry, hash);
+
+		if (e->key == key && e->fhlen == fh->nfs_fh4_len &&
+		    !memcmp(e->fh, fh->nfs_fh4_val, e->fhlen))
+			return e;
+	}
+	return NULL;
+}
+
+static void pxy_attr_free(struct pxy_cache_part *part,
+			  struct pxy_attr_entry *e)
+{
+	glist_del(&e->hash);
+	glist_del(&e->lru);
+	part->count--;
+	gsh_free(e);
+}
+
+/**
+ * @brief Get the cached attributes of an object
+ *
+ * @param[in]  fh    Remote filehandle
+ * @param[out] attrs Attributes, if found
+ *
+ * @return true if the attributes were cached and are still fresh.
+ */
+
+bool pxy_cache_get_attrs(const nfs_fh4 *fh, struct attrlist *attrs)
+{
+	uint64_t key;
+	struct pxy_cache_part *part;
+	struct pxy_attr_entry *e;
+	bool found = false;
+
+	if (attr_timeout == 0)
+		return false;
+
+	key = pxy_fh_key(fh);
+	part = pxy_cache_part(&attr_table, key);
+
+	pthread_mutex_lock(&part->lock);
+	e = pxy_attr_find(part, fh, key);
+	if (e != NULL) {
+		if (e->expire > time(NULL)) {
+			*attrs = e->attrs;
+			glist_del(&e->lru);
+			glist_add(&part->lru, &e->lru);
+			found = true;
+		} else {
+			pxy_attr_free(part, e);
+		}
+	}
+	pthread_mutex_unlock(&part->lock);
+	return found;
+}
+
+/**
+ * @brief Remember fresh attributes of an object
+ *
+ * @param[in] fh    Remote filehandle
+ * @param[in] attrs Attributes just returned by the server
+ */
+
+void pxy_cache_put_attrs(const nfs_fh4 *fh, const struct attrlist *attrs)
+{
+	uint64_t key;
+	struct pxy_cache_part *part;
+	struct pxy_attr_entry *e;
+
+	if (attr_timeout == 0 || fh->nfs_fh4_len > NFS4_FHSIZE)
+		return;
+
+	key = pxy_fh_key(fh);
+	part = pxy_cache_part(&attr_table, key);
+
+	pthread_mutex_lock(&part->lock);
+	e = pxy_attr_find(part, fh, key);
+	if (e != NULL) {
+		glist_del(&e->lru);
+	} else {
+		struct glist_head *old = pxy_cache_reclaim(&attr_table, part);
+
+		if (old != NULL) {
+			e = glist_entry(old, struct pxy_attr_entry, lru);
+			glist_del(&e->hash);
+		} else {
+			e = gsh_malloc(sizeof(*e));
+			if (e == NULL) {
+				pthread_mutex_unlock(&part->lock);
+				return;
+			}
+		}
+		e->key = key;
+		e->fhlen = fh->nfs_fh4_len;
+		memcpy(e->fh, fh->nfs_fh4_val, e->fhlen);
+		glist_add(pxy_cache_bucket(&attr_table, part, key), &e->hash);
+		part->count++;
+	}
+	e->attrs = *attrs;
+	e->expire = time(NULL) + attr_timeout;
+	glist_add(&part->lru, &e->lru);
+	pthread_mutex_unlock(&part->lock);
+}
+
+/**
+ * @brief Forget the attributes of an object the proxy changed
+ *
+ * @param[in] fh Remote filehandle
+ */
+
+void pxy_cache_drop_attrs(const nfs_fh4 *fh)
+{
+	uint64_t key;
+	struct pxy_cache_part *part;
+	struct pxy_attr_entry *e;
+
+	if (attr_timeout == 0)
+		return;
+
+	key = pxy_fh_key(fh);
+	part = pxy_cache_part(&attr_table, key);
+
+	pthread_mutex_lock(&part->lock);
+	e = pxy_attr_find(part, fh, key);
+	if (e != NULL)
+		pxy_attr_free(part, e);
+	pthread_mutex_unlock(&part->lock);
+}
+
+static struct pxy_name_entry *pxy_name_find(struct pxy_cache_part *part,
+					    const nfs_fh4 *dir,
+					    const char *name, uint64_t key)
+{
+	struct glist_head *bucket = pxy_cache_bucket(&name_table, part, key);
+	struct glist_head *node;
+
+	glist_for_each(node, bucket) {
+		struct pxy_name_entry *e =
+		    glist_entry(node, struct pxy_name_entry, hash);
+
+		if (e->key == key && e->dirfhlen == dir->nfs_fh4_len &&
+		    !memcmp(e->dirfh, dir->nfs_fh4_val, e->dirfhlen) &&
+		    !strcmp(e->name, name))
+			return e;
+	}
+	return NULL;
+}
+
+static void pxy_name_free(struct pxy_cache_part *part,
+			  struct pxy_name_entry *e)
+{
+	glist_del(&e->hash);
+	glist_del(&e->lru);
+	part->count--;
+	gsh_free(e);
+}
+
+/**
+ * @brief Look a name up in the cache
+ *
+ * The name is only trusted if its directory's attributes are cached
+ * with the change attribute the name was cached under, and the
+ * object it leads to has fresh attributes.
+ *
+ * @param[in]     dir   Remote filehandle of the directory
+ * @param[in]     name  Name in the directory
+ * @param[in,out] fh    Filehandle of the object, nfs_fh4_val must
+ *                      point to NFS4_FHSIZE bytes
+ * @param[out]    attrs Attributes of the object
+ *
+ * @return true on a hit.
+ */
+
+bool pxy_cache_lookup(const nfs_fh4 *dir, const char *name, nfs_fh4 *fh,
+		      struct attrlist *attrs)
+{
+	struct attrlist dirattrs;
+	uint64_t key;
+	struct pxy_cache_part *part;
+	struct pxy_name_entry *e;
+	bool found = false;
+
+	if (attr_timeout == 0)
+		return false;
+
+	if (!pxy_cache_get_attrs(dir, &dirattrs))
+		return false;
+
+	key = pxy_name_key(dir, name);
+	part = pxy_cache_part(&name_table, key);
+
+	pthread_mutex_lock(&part->lock);
+	e = pxy_name_find(part, dir, name, key);
+	if (e != NULL) {
+		if (e->dir_change == dirattrs.change) {
+			fh->nfs_fh4_len = e->fhlen;
+			memcpy(fh->nfs_fh4_val, e->fh, e->fhlen);
+			glist_del(&e->lru);
+			glist_add(&part->lru, &e->lru);
+			found = true;
+		} else {
+			pxy_name_free(part, e);
+		}
+	}
+	pthread_mutex_unlock(&part->lock);
+
+	return found && pxy_cache_get_attrs(fh, attrs);
+}
+
+/**
+ * @brief Tell the change attribute a name looked up now can be cached under
+ *
+ * @param[in]  dir        Remote filehandle of the directory
+ * @param[out] dir_change Change attribute of the directory
+ *
+ * @return false if the directory's attributes are not cached.
+ */
+
+bool pxy_cache_dir_change(const nfs_fh4 *dir, uint64_t *dir_change)
+{
+	struct attrlist dirattrs;
+
+	if (!pxy_cache_get_attrs(dir, &dirattrs))
+		return false;
+	*dir_change = dirattrs.change;
+	return true;
+}
+
+/**
+ * @brief Remember the object a name leads to
+ *
+ * dir_change must have been taken with pxy_cache_dir_change before
+ * the server was asked about the name.  Nothing is cached if the
+ * directory changed since, as the answer may predate the change.
+ *
+ * @param[in] dir        Remote filehandle of the directory
+ * @param[in] dir_change Change attribute of the directory
+ * @param[in] name       Name in the directory
+ * @param[in] fh         Remote filehandle of the object
+ */
+
+void pxy_cache_add_name(const nfs_fh4 *dir, uint64_t dir_change,
+			const char *name, const nfs_fh4 *fh)
+{
+	struct attrlist dirattrs;
+	uint64_t key;
+	struct pxy_cache_part *part;
+	struct pxy_name_entry *e;
+
+	if (attr_timeout == 0 || strlen(name) > MAXNAMLEN ||
+	    dir->nfs_fh4_len > NFS4_FHSIZE || fh->nfs_fh4_len > NFS4_FHSIZE)
+		return;
+
+	if (!pxy_cache_get_attrs(dir, &dirattrs) ||
+	    dirattrs.change != dir_change)
+		return;
+
+	key = pxy_name_key(dir, name);
+	part = pxy_cache_part(&name_table, key);
+
+	pthread_mutex_lock(&part->lock);
+	e = pxy_name_find(part, dir, name, key);
+	if (e != NULL) {
+		glist_del(&e->lru);
+	} else {
+		struct glist_head *old = pxy_cache_reclaim(&name_table, part);
+
+		if (old != NULL) {
+			e = glist_entry(old, struct pxy_name_entry, lru);
+			glist_del(&e->hash);
+		} else {
+			e = gsh_malloc(sizeof(*e));
+			if (e == NULL) {
+				pthread_mutex_unlock(&part->lock);
+				return;
+			}
+		}
+		e->key = key;
+		e->dirfhlen = dir->nfs_fh4_len;
+		memcpy(e->dirfh, dir->nfs_fh4_val, e->dirfhlen);
+		strcpy(e->name, name);
+		glist_add(pxy_cache_bucket(&name_table, part, key), &e->hash);
+		part->count++;
+	}
+	e->dir_change = dirattrs.change;
+	e->fhlen = fh->nfs_fh4_len;
+	memcpy(e->fh, fh->nfs_fh4_val, e->fhlen);
+	glist_add(&part->lru, &e->lru);
+	pthread_mutex_unlock(&part->lock);
+}
+
+/**
+ * @brief Forget a name the proxy removed or replaced
+ *
+ * @param[in] dir  Remote filehandle of the directory
+ * @param[in] name Name in the directory
+ */
+
+void pxy_cache_drop_name(const nfs_fh4 *dir, const char *name)
+{
+	uint64_t key;
+	struct pxy_cache_part *part;
+	struct pxy_name_entry *e;
+
+	if (attr_timeout == 0)
+		return;
+
+	key = pxy_name_key(dir, name);
+	part = pxy_cache_part(&name_table, key);
+
+	pthread_mutex_lock(&part->lock);
+	e = pxy_name_find(part, dir, name, key);
+	if (e != NULL)
+		pxy_name_free(part, e);
+	pthread_mutex_unlock(&part->lock);
+}
@@ -12,6 +12,11 @@ typedef struct pxy_client_params {
 	unsigned int srv_sendsize;
 	unsigned int srv_recvsize;
 	unsigned int srv_timeout;
+	unsigned int srv_connections;
+	unsigned int srv_max_calls;
+	unsigned int attr_cache_timeout;
+	unsigned int attr_cache_entries;
+	bool readdir_prefetch;
 	unsigned short srv_port;
 	unsigned int use_privileged_client_port;
 	char *remote_principal;
@@ -44,6 +49,18 @@ void pxy_handle_ops_init(struct fsal_obj_ops *ops);
 
 int pxy_init_rpc(const struct pxy_fsal_module *);
 
+int pxy_cache_init(const proxyfs_specific_initinfo_t *info);
+bool pxy_cache_prefetch(void);
+bool pxy_cache_get_attrs(const nfs_fh4 *fh, struct attrlist *attrs);
+void pxy_cache_put_attrs(const nfs_fh4 *fh, const struct attrlist *attrs);
+void pxy_cache_drop_attrs(const nfs_fh4 *fh);
+bool pxy_cache_lookup(const nfs_fh4 *dir, const char *name, nfs_fh4 *fh,
+		      struct attrlist *attrs);
+bool pxy_cache_dir_change(const nfs_fh4 *dir, uint64_t *dir_change);
+void pxy_cache_add_name(const nfs_fh4 *dir, uint64_t dir_change,
+			const char *name, const nfs_fh4 *fh);
+void pxy_cache_drop_name(const nfs_fh4 *dir, const char *name);
+
 fsal_status_t pxy_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
 				 const struct req_op_context *opctx,
 				 unsigned int cookie,
@@ -129,6 +129,10 @@ static bool fs_supports(struct fsal_export *exp_hdl,
 {
 	struct fsal_staticfsinfo_t *info;
 
+	/* read2/write2 only complete asynchronously on the ring */
+	if (option == fso_async_io)
+		return vfs_uring_running();
+
 	info = vfs_staticinfo(exp_hdl->fsal);
 	return fsal_supports(info, option);
 }
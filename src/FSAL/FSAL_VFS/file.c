@@ -39,6 +39,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include "FSAL/fsal_commonlib.h"
+#include "gsh_bufpool.h"
 #include "vfs_methods.h"
 
 /** vfs_open
@@ -141,6 +142,56 @@ fsal_status_t vfs_read(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(fsal_error, retval);
 }
 
+/* vfs_read_iobuf
+ * pread straight into a pooled payload, which the protocol layer
+ * encodes from without copying it into a reply buffer of its own.
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t vfs_read_iobuf(struct fsal_obj_handle *obj_hdl,
+			     uint64_t offset, size_t buffer_size,
+			     struct gsh_iobuf **iob, bool *end_of_file)
+{
+	struct vfs_fsal_obj_handle *myself;
+	struct gsh_iobuf *new_iob;
+	ssize_t nb_read;
+	int retval = 0;
+
+	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+
+	if (obj_hdl->fsal != obj_hdl->fs->fsal) {
+		LogDebug(COMPONENT_FSAL,
+			 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+			 obj_hdl->fsal->name, obj_hdl->fs->fsal->name);
+		retval = EXDEV;
+		return fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	assert(myself->u.file.fd >= 0
+	       && myself->u.file.openflags != FSAL_O_CLOSED);
+
+	new_iob = gsh_bufpool_iobuf(buffer_size);
+	if (new_iob == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, 0);
+
+	nb_read = pread(myself->u.file.fd, new_iob->addr, buffer_size,
+			offset);
+	if (nb_read == -1) {
+		retval = errno;
+		gsh_iobuf_put(new_iob);
+		return fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	new_iob->len = nb_read;
+	*iob = new_iob;
+
+	/* dual eof condition, as in vfs_read */
+	*end_of_file = nb_read == 0 ||
+	    offset + nb_read >= obj_hdl->attributes.filesize;
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 /* vfs_write
  * concurrency (locks) is managed in cache_inode_*
  */
@@ -195,6 +246,124 @@ fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(fsal_error, retval);
 }
 
+/* Asynchronous read and write.
+ * The operation goes on the io_uring and done_cb runs from the reaper
+ * once it completes.  Without a ring, or when it is full, the I/O is
+ * done synchronously and done_cb runs before returning.
+ */
+
+struct vfs_io_ctx {
+	struct fsal_obj_handle *obj_hdl;
+	struct fsal_io_arg *io_arg;
+	fsal_async_cb done_cb;
+	void *caller_arg;
+	uint64_t filesize;	/* for the read eof test */
+	bool write;
+};
+
+static void vfs_io_done(ssize_t res, void *arg)
+{
+	struct vfs_io_ctx *ctx = arg;
+	struct fsal_io_arg *io_arg = ctx->io_arg;
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	if (res < 0) {
+		status = fsalstat(posix2fsal_error(-res), -res);
+	} else {
+		io_arg->io_amount = res;
+		/* same dual eof condition as vfs_read */
+		if (!ctx->write)
+			io_arg->end_of_file = res == 0 ||
+			    io_arg->offset + res >= ctx->filesize;
+	}
+
+	ctx->done_cb(ctx->obj_hdl, status, io_arg, ctx->caller_arg);
+	gsh_free(ctx);
+}
+
+static bool vfs_io_submit(struct fsal_obj_handle *obj_hdl, bool write,
+			  struct fsal_io_arg *io_arg,
+			  fsal_async_cb done_cb, void *caller_arg)
+{
+	struct vfs_fsal_obj_handle *myself;
+	struct vfs_io_ctx *ctx;
+	int rc;
+
+	myself = container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+
+	/* Let the synchronous path report EXDEV */
+	if (obj_hdl->fsal != obj_hdl->fs->fsal)
+		return false;
+
+	ctx = gsh_malloc(sizeof(*ctx));
+	if (ctx == NULL)
+		return false;
+
+	ctx->obj_hdl = obj_hdl;
+	ctx->io_arg = io_arg;
+	ctx->done_cb = done_cb;
+	ctx->caller_arg = caller_arg;
+	ctx->write = write;
+
+	if (write) {
+		/* Stable only if the fd was opened O_SYNC; otherwise the
+		 * caller commits */
+		io_arg->fsal_stable =
+		    (myself->u.file.openflags & FSAL_O_SYNC) != 0;
+		fsal_set_credentials(op_ctx->creds);
+		rc = vfs_uring_submit(VFS_URING_WRITE, myself->u.file.fd,
+				      io_arg->buffer, io_arg->io_length,
+				      io_arg->offset, vfs_io_done, ctx);
+		fsal_restore_ganesha_credentials();
+	} else {
+		/* cache_inode_rdwr_async holds the attribute lock across
+		 * read2, so the size is stable here */
+		ctx->filesize = obj_hdl->attributes.filesize;
+		rc = vfs_uring_submit(VFS_URING_READ, myself->u.file.fd,
+				      io_arg->buffer, io_arg->io_length,
+				      io_arg->offset, vfs_io_done, ctx);
+	}
+
+	if (rc != 0) {
+		gsh_free(ctx);
+		return false;
+	}
+
+	return true;
+}
+
+void vfs_read2(struct fsal_obj_handle *obj_hdl,
+	       struct fsal_io_arg *read_arg,
+	       fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (vfs_io_submit(obj_hdl, false, read_arg, done_cb, caller_arg))
+		return;
+
+	status = vfs_read(obj_hdl, read_arg->offset, read_arg->io_length,
+			  read_arg->buffer, &read_arg->io_amount,
+			  &read_arg->end_of_file);
+	done_cb(obj_hdl, status, read_arg, caller_arg);
+}
+
+void vfs_write2(struct fsal_obj_handle *obj_hdl,
+		struct fsal_io_arg *write_arg,
+		fsal_async_cb done_cb, void *caller_arg)
+{
+	bool stable = write_arg->fsal_stable;
+	fsal_status_t status;
+
+	if (vfs_io_submit(obj_hdl, true, write_arg, done_cb, caller_arg))
+		return;
+
+	write_arg->fsal_stable = stable;
+	status = vfs_write(obj_hdl, write_arg->offset, write_arg->io_length,
+			   write_arg->buffer, &write_arg->io_amount,
+			   &write_arg->fsal_stable);
+	done_cb(obj_hdl, status, write_arg, caller_arg);
+}
+
 /* vfs_commit
  * Commit a file range to storage.
  * for right now, fsync will have to do.
@@ -1517,7 +1517,10 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->open = vfs_open;
 	ops->status = vfs_status;
 	ops->read = vfs_read;
+	ops->read_iobuf = vfs_read_iobuf;
 	ops->write = vfs_write;
+	ops->read2 = vfs_read2;
+	ops->write2 = vfs_write2;
 	ops->commit = vfs_commit;
 	ops->lock_op = vfs_lock_op;
 	ops->close = vfs_close;
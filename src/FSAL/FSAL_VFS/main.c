@@ -39,6 +39,7 @@
 #include <sys/types.h>
 #include "ganesha_list.h"
 #include "FSAL/fsal_init.h"
+#include "vfs_methods.h"
 
 /* VFS FSAL module private storage
  */
@@ -55,6 +56,7 @@
 struct vfs_fsal_module {
 	struct fsal_module fsal;
 	struct fsal_staticfsinfo_t fs_info;
+	struct vfs_uring_params uring;
 	/* vfsfs_specific_initinfo_t specific_info;  placeholder */
 };
 
@@ -85,21 +87,25 @@ static struct fsal_staticfsinfo_t default_posix_info = {
 
 static struct config_item vfs_params[] = {
 	CONF_ITEM_BOOL("link_support", true,
-		       fsal_staticfsinfo_t, link_support),
+		       vfs_fsal_module, fs_info.link_support),
 	CONF_ITEM_BOOL("symlink_support", true,
-		       fsal_staticfsinfo_t, symlink_support),
+		       vfs_fsal_module, fs_info.symlink_support),
 	CONF_ITEM_BOOL("cansettime", true,
-		       fsal_staticfsinfo_t, cansettime),
+		       vfs_fsal_module, fs_info.cansettime),
 	CONF_ITEM_UI64("maxread", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       fsal_staticfsinfo_t, maxread),
+		       vfs_fsal_module, fs_info.maxread),
 	CONF_ITEM_UI64("maxwrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       fsal_staticfsinfo_t, maxwrite),
+		       vfs_fsal_module, fs_info.maxwrite),
 	CONF_ITEM_MODE("umask", 0, 0777, 0,
-		       fsal_staticfsinfo_t, umask),
+		       vfs_fsal_module, fs_info.umask),
 	CONF_ITEM_BOOL("auth_xdev_export", false,
-		       fsal_staticfsinfo_t, auth_exportpath_xdev),
+		       vfs_fsal_module, fs_info.auth_exportpath_xdev),
 	CONF_ITEM_MODE("xattr_access_rights", 0, 0777, 0400,
-		       fsal_staticfsinfo_t, xattr_access_rights),
+		       vfs_fsal_module, fs_info.xattr_access_rights),
+	CONF_ITEM_BOOL("io_uring", false,
+		       vfs_fsal_module, uring.enable),
+	CONF_ITEM_UI32("io_uring_depth", 8, 4096, 128,
+		       vfs_fsal_module, uring.depth),
 	CONFIG_EOL
 };
 
@@ -140,7 +146,7 @@ static fsal_status_t init_config(struct fsal_module *fsal_hdl,
 	vfs_me->fs_info = default_posix_info;	/* copy the consts */
 	(void) load_config_from_parse(config_struct,
 				      &vfs_param,
-				      &vfs_me->fs_info,
+				      vfs_me,
 				      true,
 				      &err_type);
 	if (!config_error_is_harmless(&err_type))
@@ -155,6 +161,7 @@ static fsal_status_t init_config(struct fsal_module *fsal_hdl,
 	LogDebug(COMPONENT_FSAL,
 		 "FSAL INIT: Supported attributes mask = 0x%" PRIx64,
 		 vfs_me->fs_info.supported_attrs);
+	(void) vfs_uring_init(&vfs_me->uring);
 	return fsalstat(ERR_FSAL_NO_ERROR, 0);
 }
 
@@ -197,6 +204,8 @@ MODULE_FINI void vfs_unload(void)
 {
 	int retval;
 
+	vfs_uring_shutdown();
+
 	retval = unregister_fsal(&VFS.fsal);
 	if (retval != 0) {
 		fprintf(stderr, "VFS module failed to unregister");
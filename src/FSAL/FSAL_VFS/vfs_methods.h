@@ -191,6 +191,27 @@ static inline bool vfs_unopenable_type(object_file_type_t type)
 	}
 }
 
+/* io_uring engine, vfs_uring.c */
+enum vfs_uring_op {
+	VFS_URING_READ,
+	VFS_URING_WRITE,
+};
+
+typedef void (*vfs_uring_cb_t)(ssize_t res, void *arg);
+
+/* io_uring options from the VFS or XFS config block */
+struct vfs_uring_params {
+	bool enable;		/*< Queue async file I/O on the ring */
+	uint32_t depth;		/*< Submission queue size */
+};
+
+int vfs_uring_init(struct vfs_uring_params *params);
+void vfs_uring_shutdown(void);
+bool vfs_uring_running(void);
+int vfs_uring_submit(enum vfs_uring_op op, int fd, void *buf,
+		     size_t count, uint64_t offset,
+		     vfs_uring_cb_t cb, void *arg);
+
 	/* I/O management */
 fsal_status_t vfs_open(struct fsal_obj_handle *obj_hdl,
 		       fsal_openflags_t openflags);
@@ -199,10 +220,19 @@ fsal_status_t vfs_read(struct fsal_obj_handle *obj_hdl,
 		       uint64_t offset,
 		       size_t buffer_size, void *buffer, size_t *read_amount,
 		       bool *end_of_file);
+fsal_status_t vfs_read_iobuf(struct fsal_obj_handle *obj_hdl,
+			     uint64_t offset, size_t buffer_size,
+			     struct gsh_iobuf **iob, bool *end_of_file);
 fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
 			uint64_t offset,
 			size_t buffer_size, void *buffer, size_t *write_amount,
 			bool *fsal_stable);
+void vfs_read2(struct fsal_obj_handle *obj_hdl,
+	       struct fsal_io_arg *read_arg,
+	       fsal_async_cb done_cb, void *caller_arg);
+void vfs_write2(struct fsal_obj_handle *obj_hdl,
+		struct fsal_io_arg *write_arg,
+		fsal_async_cb done_cb, void *caller_arg);
 fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,	/* sync */
 			 off_t offset, size_t len);
 fsal_status_t vfs_lock_op(struct fsal_obj_handle *obj_hdl,
@@ -0,0 +1,358 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/* vfs_uring.c
+ * io_uring engine for VFS file I/O
+ *
+ * When the io_uring option is set, the asynchronous read2 and write2
+ * methods queue their I/O on a ring shared by all workers.  The worker
+ * fills and submits the SQE itself, so the operation carries that
+ * thread's fs credentials, and returns at once; a single reaper thread
+ * takes completions off the CQ and runs each request's callback.  The
+ * synchronous methods never touch the ring, so no worker sleeps on it.
+ *
+ * If the ring cannot be created (old kernel, seccomp, no liburing at
+ * build time) or is full, vfs_uring_submit returns -EAGAIN and the
+ * caller does the I/O with the plain system calls.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "fsal.h"
+#include "abstract_atomic.h"
+#include "ganesha_list.h"
+#include "vfs_methods.h"
+
+#ifdef USE_IO_URING
+#include <liburing.h>
+
+/* user_data of the NOP that tells the reaper to exit */
+#define VFS_URING_STOP ((void *)1)
+
+struct vfs_uring_req {
+	struct glist_head list;	/*< On vfs_ring_reqs while queued */
+	vfs_uring_cb_t cb;
+	void *arg;
+};
+
+static struct io_uring vfs_ring;
+static bool vfs_ring_up;
+static bool vfs_ring_reaping;
+/* Guards the SQ, vfs_ring_up, vfs_ring_reaping and vfs_ring_reqs */
+static pthread_mutex_t vfs_ring_sq_mtx = PTHREAD_MUTEX_INITIALIZER;
+/* Signalled when vfs_ring_reqs empties after vfs_ring_up is cleared */
+static pthread_cond_t vfs_ring_drained = PTHREAD_COND_INITIALIZER;
+static struct glist_head vfs_ring_reqs = GLIST_HEAD_INIT(vfs_ring_reqs);
+static pthread_t vfs_ring_reaper;
+static uint32_t vfs_ring_depth;
+static uint32_t vfs_ring_inflight;
+
+/**
+ * @brief Fail every queued request after the reaper lost the CQ
+ *
+ * Stops new submissions and runs each outstanding callback with
+ * the error, so no caller waits on a completion that will never be
+ * reaped.
+ *
+ * @param[in] res Negative errno handed to the callbacks
+ */
+
+static void vfs_uring_fail_all(ssize_t res)
+{
+	struct glist_head failed;
+	struct vfs_uring_req *req;
+
+	glist_init(&failed);
+
+	pthread_mutex_lock(&vfs_ring_sq_mtx);
+	vfs_ring_up = false;
+	vfs_ring_reaping = false;
+	glist_splice_tail(&failed, &vfs_ring_reqs);
+	pthread_cond_broadcast(&vfs_ring_drained);
+	pthread_mutex_unlock(&vfs_ring_sq_mtx);
+
+	while ((req = glist_first_entry(&failed, struct vfs_uring_req,
+					list)) != NULL) {
+		glist_del(&req->list);
+		(void)atomic_dec_uint32_t(&vfs_ring_inflight);
+		req->cb(res, req->arg);
+		gsh_free(req);
+	}
+}
+
+static void *vfs_uring_reap(void *arg)
+{
+	struct io_uring_cqe *cqe;
+	struct vfs_uring_req *req;
+	ssize_t res;
+	int rc;
+
+	SetNameFunction("vfs_uring");
+
+	for (;;) {
+		rc = io_uring_wait_cqe(&vfs_ring, &cqe);
+		if (rc == -EINTR)
+			continue;
+		if (rc < 0) {
+			LogCrit(COMPONENT_FSAL,
+				"io_uring wait failed: %s", strerror(-rc));
+			vfs_uring_fail_all(rc);
+			break;
+		}
+
+		req = io_uring_cqe_get_data(cqe);
+		res = cqe->res;
+		io_uring_cqe_seen(&vfs_ring, cqe);
+
+		if (req == VFS_URING_STOP)
+			break;
+		if (req == NULL)
+			continue;
+
+		pthread_mutex_lock(&vfs_ring_sq_mtx);
+		glist_del(&req->list);
+		if (!vfs_ring_up && glist_empty(&vfs_ring_reqs))
+			pthread_cond_broadcast(&vfs_ring_drained);
+		pthread_mutex_unlock(&vfs_ring_sq_mtx);
+
+		(void)atomic_dec_uint32_t(&vfs_ring_inflight);
+		req->cb(res, req->arg);
+		gsh_free(req);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Create the ring and start the reaper
+ *
+ * @param[in] params io_uring options from the config block
+ *
+ * @return 0 if the engine runs, else a positive errno and the plain
+ *         system calls are used.
+ */
+
+int vfs_uring_init(struct vfs_uring_params *params)
+{
+	int rc;
+
+	if (!params->enable || vfs_ring_depth != 0)
+		return 0;
+
+	rc = io_uring_queue_init(params->depth, &vfs_ring, 0);
+	if (rc < 0) {
+		LogWarn(COMPONENT_FSAL,
+			"io_uring unavailable (%s), using synchronous I/O",
+			strerror(-rc));
+		return -rc;
+	}
+
+	/* Set before the reaper runs, it clears them if it fails */
+	vfs_ring_depth = params->depth;
+	vfs_ring_reaping = true;
+	vfs_ring_up = true;
+
+	rc = pthread_create(&vfs_ring_reaper, NULL, vfs_uring_reap, NULL);
+	if (rc != 0) {
+		LogWarn(COMPONENT_FSAL,
+			"Could not start io_uring reaper (%s), using synchronous I/O",
+			strerror(rc));
+		vfs_ring_up = false;
+		vfs_ring_reaping = false;
+		vfs_ring_depth = 0;
+		io_uring_queue_exit(&vfs_ring);
+		return rc;
+	}
+
+	LogInfo(COMPONENT_FSAL, "io_uring engine started, depth %u",
+		vfs_ring_depth);
+	return 0;
+}
+
+/**
+ * @brief Stop the reaper and tear down the ring
+ *
+ * New submissions are refused first, then every queued request is
+ * reaped and its callback run before the reaper is told to exit.
+ */
+
+void vfs_uring_shutdown(void)
+{
+	struct io_uring_sqe *sqe = NULL;
+
+	pthread_mutex_lock(&vfs_ring_sq_mtx);
+	if (!vfs_ring_up && !vfs_ring_reaping) {
+		/* never started, or the reaper already failed out */
+		pthread_mutex_unlock(&vfs_ring_sq_mtx);
+		if (vfs_ring_depth != 0) {
+			pthread_join(vfs_ring_reaper, NULL);
+			io_uring_queue_exit(&vfs_ring);
+			vfs_ring_depth = 0;
+		}
+		return;
+	}
+
+	vfs_ring_up = false;
+	while (vfs_ring_reaping && !glist_empty(&vfs_ring_reqs))
+		pthread_cond_wait(&vfs_ring_drained, &vfs_ring_sq_mtx);
+
+	if (vfs_ring_reaping) {
+		/* Nothing is queued, so the SQ has room for the NOP */
+		sqe = io_uring_get_sqe(&vfs_ring);
+		if (sqe != NULL) {
+			io_uring_prep_nop(sqe);
+			io_uring_sqe_set_data(sqe, VFS_URING_STOP);
+			(void)io_uring_submit(&vfs_ring);
+		}
+		vfs_ring_reaping = false;
+	}
+	pthread_mutex_unlock(&vfs_ring_sq_mtx);
+
+	if (sqe == NULL)
+		pthread_cancel(vfs_ring_reaper);
+	pthread_join(vfs_ring_reaper, NULL);
+	io_uring_queue_exit(&vfs_ring);
+	vfs_ring_depth = 0;
+}
+
+/**
+ * @brief Whether operations go on the ring
+ */
+
+bool vfs_uring_running(void)
+{
+	return vfs_ring_up;
+}
+
+/**
+ * @brief Queue a read or write on the ring
+ *
+ * The callback runs on the reaper thread with the operation's result,
+ * a byte count or a negative errno.  It must not block.
+ *
+ * @param[in] op     The operation
+ * @param[in] fd     File descriptor
+ * @param[in] buf    Data buffer
+ * @param[in] count  Bytes to transfer
+ * @param[in] offset File offset
+ * @param[in] cb     Completion callback
+ * @param[in] arg    Argument for cb
+ *
+ * @retval 0 if queued; cb will run exactly once.
+ * @retval -EAGAIN if the ring is full or not running; cb will not run.
+ * @retval Other negative errno if submission failed.
+ */
+
+int vfs_uring_submit(enum vfs_uring_op op, int fd, void *buf,
+		     size_t count, uint64_t offset,
+		     vfs_uring_cb_t cb, void *arg)
+{
+	struct vfs_uring_req *req;
+	struct io_uring_sqe *sqe;
+	int rc;
+
+	if (!vfs_ring_up)
+		return -EAGAIN;
+
+	if (atomic_inc_uint32_t(&vfs_ring_inflight) > vfs_ring_depth) {
+		(void)atomic_dec_uint32_t(&vfs_ring_inflight);
+		return -EAGAIN;
+	}
+
+	req = gsh_malloc(sizeof(*req));
+	if (req == NULL) {
+		(void)atomic_dec_uint32_t(&vfs_ring_inflight);
+		return -ENOMEM;
+	}
+	req->cb = cb;
+	req->arg = arg;
+
+	pthread_mutex_lock(&vfs_ring_sq_mtx);
+	sqe = vfs_ring_up ? io_uring_get_sqe(&vfs_ring) : NULL;
+	if (sqe == NULL) {
+		pthread_mutex_unlock(&vfs_ring_sq_mtx);
+		(void)atomic_dec_uint32_t(&vfs_ring_inflight);
+		gsh_free(req);
+		return -EAGAIN;
+	}
+
+	switch (op) {
+	case VFS_URING_READ:
+		io_uring_prep_read(sqe, fd, buf, count, offset);
+		break;
+	case VFS_URING_WRITE:
+		io_uring_prep_write(sqe, fd, buf, count, offset);
+		break;
+	}
+	io_uring_sqe_set_data(sqe, req);
+
+	/* Submitted from this thread so the kernel takes its fsuid */
+	rc = io_uring_submit(&vfs_ring);
+	if (rc < 0) {
+		/* The SQE stays queued and goes out with the next submit;
+		 * turn it into a NOP the reaper will ignore. */
+		io_uring_prep_nop(sqe);
+		io_uring_sqe_set_data(sqe, NULL);
+	} else {
+		glist_add_tail(&vfs_ring_reqs, &req->list);
+	}
+	pthread_mutex_unlock(&vfs_ring_sq_mtx);
+
+	if (rc < 0) {
+		(void)atomic_dec_uint32_t(&vfs_ring_inflight);
+		gsh_free(req);
+		return rc;
+	}
+
+	return 0;
+}
+
+#else				/* USE_IO_URING */
+
+int vfs_uring_init(struct vfs_uring_params *params)
+{
+	if (params->enable)
+		LogWarn(COMPONENT_FSAL,
+			"Built without io_uring support, using synchronous I/O");
+	return 0;
+}
+
+void vfs_uring_shutdown(void)
+{
+}
+
+bool vfs_uring_running(void)
+{
+	return false;
+}
+
+int vfs_uring_submit(enum vfs_uring_op op, int fd, void *buf,
+		     size_t count, uint64_t offset,
+		     vfs_uring_cb_t cb, void *arg)
+{
+	return -EAGAIN;
+}
+
+#endif				/* USE_IO_URING */
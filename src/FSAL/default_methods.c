@@ -52,6 +52,7 @@
 #include "config_parsing.h"
 #include "ganesha_types.h"
 #include "fsal_private.h"
+#include "gsh_bufpool.h"
 
 /** fsal module method defaults and common methods
  */
@@ -714,6 +715,36 @@ static fsal_status_t file_read_plus(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(ERR_FSAL_NOTSUPP, 0);
 }
 
+/* file_read_iobuf
+ * default case reads into a pooled payload through the FSAL's read op
+ */
+
+static fsal_status_t file_read_iobuf(struct fsal_obj_handle *obj_hdl,
+				     uint64_t seek_descriptor,
+				     size_t buffer_size,
+				     struct gsh_iobuf **iob,
+				     bool *end_of_file)
+{
+	struct gsh_iobuf *new_iob;
+	size_t read_amount = 0;
+	fsal_status_t status;
+
+	new_iob = gsh_bufpool_iobuf(buffer_size);
+	if (new_iob == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, 0);
+
+	status = obj_hdl->ops->read(obj_hdl, seek_descriptor, buffer_size,
+				    new_iob->addr, &read_amount, end_of_file);
+	if (FSAL_IS_ERROR(status)) {
+		gsh_iobuf_put(new_iob);
+		return status;
+	}
+
+	new_iob->len = read_amount;
+	*iob = new_iob;
+	return status;
+}
+
 /* file_write
  * default case not supported
  */
@@ -738,6 +769,40 @@ static fsal_status_t file_write_plus(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(ERR_FSAL_NOTSUPP, 0);
 }
 
+/* file_read2
+ * default case does a synchronous read and completes inline
+ */
+
+static void file_read2(struct fsal_obj_handle *obj_hdl,
+		       struct fsal_io_arg *read_arg,
+		       fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	status = obj_hdl->ops->read(obj_hdl, read_arg->offset,
+				    read_arg->io_length, read_arg->buffer,
+				    &read_arg->io_amount,
+				    &read_arg->end_of_file);
+	done_cb(obj_hdl, status, read_arg, caller_arg);
+}
+
+/* file_write2
+ * default case does a synchronous write and completes inline
+ */
+
+static void file_write2(struct fsal_obj_handle *obj_hdl,
+			struct fsal_io_arg *write_arg,
+			fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	status = obj_hdl->ops->write(obj_hdl, write_arg->offset,
+				     write_arg->io_length, write_arg->buffer,
+				     &write_arg->io_amount,
+				     &write_arg->fsal_stable);
+	done_cb(obj_hdl, status, write_arg, caller_arg);
+}
+
 /* seek
  * default case not supported
  */
@@ -1030,8 +1095,11 @@ struct fsal_obj_ops def_handle_ops = {
 	.status = file_status,
 	.read = file_read,
 	.read_plus = file_read_plus,
+	.read_iobuf = file_read_iobuf,
 	.write = file_write,
 	.write_plus = file_write_plus,
+	.read2 = file_read2,
+	.write2 = file_write2,
 	.seek = file_seek,
 	.io_advise = file_io_advise,
 	.commit = commit,
@@ -44,7 +44,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
-#include <poll.h>
+#include <sys/epoll.h>
 #include <arpa/inet.h>		/* For inet_ntop() */
 #include "hashtable.h"
 #include "log.h"
@@ -59,6 +59,7 @@
 #include "client_mgr.h"
 #include "server_stats.h"
 #include "9p.h"
+#include "gsh_bufpool.h"
 #include <stdbool.h>
 
 #define P_FAMILY AF_INET6
@@ -102,251 +103,457 @@ void DispatchWork9P(request_data_t *req)
 }
 
 /**
- * _9p_socket_thread: 9p socket manager.
+ * @brief A 9P/TCP connection as seen by its event loop
  *
- * This function is the main loop for the 9p socket manager.
- * One such thread exists per connection.
- *
- * @param Arg the socket number cast as a void * in pthread_create
+ * Workers only ever see the embedded _9p_conn.
+ */
+struct _9p_tcp_conn {
+	struct _9p_conn conn;
+	struct _9p_evloop *loop;	/* Loop polling the socket */
+	struct glist_head closing;	/* Link on loop->closing */
+	char *msg;		/* Message being received, or NULL */
+	uint32_t readlen;	/* Bytes of msg received so far */
+	char strcaller[INET6_ADDRSTRLEN];
+};
+
+/**
+ * @brief One of the threads multiplexing the 9P/TCP connections
+ */
+struct _9p_evloop {
+	int epfd;
+	uint32_t nconns;	/* Connections polled, for placement */
+	struct glist_head closing;	/* Shut down, waiting on workers */
+};
+
+/* Most events taken from a single epoll_wait */
+#define _9P_EVLOOP_EVENTS 64
+
+/* Most messages read from one connection per wakeup, so a busy
+ * client cannot starve the others sharing its loop. */
+#define _9P_EVLOOP_BUDGET 16
+
+static struct _9p_evloop *_9p_evloops;
+static uint16_t _9p_nevloops;
+
+/**
+ * @brief Stop polling a connection and shut its socket down
  *
- * @return NULL
+ * The fd stays open, so its number cannot be reused under a worker
+ * still replying on it, until _9p_tcp_reap sees the last request
+ * go.
  *
+ * @param[in,out] tconn The connection
  */
-
-void *_9p_socket_thread(void *Arg)
+static void _9p_tcp_shutdown(struct _9p_tcp_conn *tconn)
 {
-	long int tcp_sock = (long int)Arg;
-	int rc = -1;
-	struct pollfd fds[1];
-	int fdcount = 1;
-	static char my_name[MAXNAMLEN + 1];
-	socklen_t addrpeerlen = 0;
-	struct sockaddr_storage addrpeer;
-	char strcaller[INET6_ADDRSTRLEN];
-	request_data_t *req = NULL;
-	int tag;
-	unsigned long sequence = 0;
-	unsigned int i = 0;
-	char *_9pmsg = NULL;
-	uint32_t msglen;
-
-	struct _9p_conn _9p_conn;
+	long int tcp_sock = tconn->conn.trans_data.sockfd;
 
-	int readlen = 0;
-	int total_readlen = 0;
+	LogEvent(COMPONENT_9P, "Closing connection on socket %lu", tcp_sock);
 
-	snprintf(my_name, MAXNAMLEN, "9p_sock_mgr#fd=%ld", tcp_sock);
-	SetNameFunction(my_name);
+	(void)epoll_ctl(tconn->loop->epfd, EPOLL_CTL_DEL, tcp_sock, NULL);
+	(void)shutdown(tcp_sock, SHUT_RDWR);
 
-	/* Init the struct _9p_conn structure */
-	memset(&_9p_conn, 0, sizeof(_9p_conn));
-	pthread_mutex_init(&_9p_conn.sock_lock, NULL);
-	_9p_conn.trans_type = _9P_TCP;
-	_9p_conn.trans_data.sockfd = tcp_sock;
-	for (i = 0; i < FLUSH_BUCKETS; i++) {
-		pthread_mutex_init(&_9p_conn.flush_buckets[i].lock, NULL);
-		glist_init(&_9p_conn.flush_buckets[i].list);
+	/* Free buffer if we encountered an error
+	 * before we could give it to a worker */
+	if (tconn->msg != NULL) {
+		gsh_bufpool_put(tconn->msg, _9P_MSG_SIZE);
+		tconn->msg = NULL;
 	}
-	atomic_store_uint32_t(&_9p_conn.refcount, 0);
 
-	/* Init the fids pointers array */
-	memset(&_9p_conn.fids, 0, _9P_FID_PER_CONN * sizeof(struct _9p_fid *));
+	atomic_dec_uint32_t(&tconn->loop->nconns);
+	glist_add_tail(&tconn->loop->closing, &tconn->closing);
+}
 
-	/* Set initial msize.
-	 * Client may request a lower value during TVERSION */
-	_9p_conn.msize = _9p_param._9p_tcp_msize;
+/**
+ * @brief Close a connection and free everything it holds
+ *
+ * @param[in] tconn The connection, no longer polled or referenced
+ */
+static void _9p_tcp_conn_free(struct _9p_tcp_conn *tconn)
+{
+	struct _9p_conn *_9p_conn = &tconn->conn;
+	unsigned int i;
 
-	if (gettimeofday(&_9p_conn.birth, NULL) == -1)
-		LogFatal(COMPONENT_9P, "Cannot get connection's time of birth");
+	close(_9p_conn->trans_data.sockfd);
 
-	addrpeerlen = sizeof(addrpeer);
-	rc = getpeername(tcp_sock, (struct sockaddr *)&addrpeer,
-			 &addrpeerlen);
-	if (rc == -1) {
-		LogMajor(COMPONENT_9P,
-			 "Cannot get peername to tcp socket for 9p, error %d (%s)",
-			 errno, strerror(errno));
-		/* XXX */
-		strncpy(strcaller, "(unresolved)", INET6_ADDRSTRLEN);
-		strcaller[12] = '\0';
-	} else {
-		switch (addrpeer.ss_family) {
-		case AF_INET:
-			inet_ntop(addrpeer.ss_family,
-				  &((struct sockaddr_in *)&addrpeer)->
-				  sin_addr, strcaller, INET6_ADDRSTRLEN);
-			break;
-		case AF_INET6:
-			inet_ntop(addrpeer.ss_family,
-				  &((struct sockaddr_in6 *)&addrpeer)->
-				  sin6_addr, strcaller, INET6_ADDRSTRLEN);
-			break;
-		default:
-			snprintf(strcaller, INET6_ADDRSTRLEN, "BAD ADDRESS");
-			break;
-		}
+	_9p_cleanup_fids(_9p_conn);
 
-		LogEvent(COMPONENT_9P, "9p socket #%ld is connected to %s",
-			 tcp_sock, strcaller);
-		printf("9p socket #%ld is connected to %s\n", tcp_sock,
-		       strcaller);
-	}
-	_9p_conn.client = get_gsh_client(&addrpeer, false);
+	if (_9p_conn->client != NULL)
+		put_gsh_client(_9p_conn->client);
 
-	/* Set up the structure used by poll */
-	memset((char *)fds, 0, sizeof(struct pollfd));
-	fds[0].fd = tcp_sock;
-	fds[0].events =
-	    POLLIN | POLLPRI | POLLRDBAND | POLLRDNORM | POLLRDHUP | POLLHUP |
-	    POLLERR | POLLNVAL;
+	for (i = 0; i < FLUSH_BUCKETS; i++)
+		pthread_mutex_destroy(&_9p_conn->flush_buckets[i].lock);
+	pthread_mutex_destroy(&_9p_conn->sock_lock);
+	gsh_free(tconn);
+}
 
-	for (;;) {
-		total_readlen = 0;  /* new message */
-		rc = poll(fds, fdcount, -1);
-		if (rc == -1) {
-			/* timeout = -1 => Wait indefinitely for events */
-			/* Interruption if not an issue */
-			if (errno == EINTR)
-				continue;
+/**
+ * @brief Release the shut down connections no worker holds anymore
+ *
+ * @param[in,out] loop The event loop
+ */
+static void _9p_tcp_reap(struct _9p_evloop *loop)
+{
+	struct glist_head *glist, *glistn;
+	struct _9p_tcp_conn *tconn;
 
-			LogCrit(COMPONENT_9P,
-				"Got error %u (%s) on fd %ld connect to %s while polling on socket",
-				errno, strerror(errno), tcp_sock, strcaller);
-		}
+	glist_for_each_safe(glist, glistn, &loop->closing) {
+		tconn = glist_entry(glist, struct _9p_tcp_conn, closing);
 
-		if (fds[0].revents & POLLNVAL) {
-			LogEvent(COMPONENT_9P,
-				 "Client %s on socket %lu produced POLLNVAL",
-				 strcaller, tcp_sock);
-			goto end;
+		if (atomic_fetch_uint32_t(&tconn->conn.refcount)) {
+			LogFullDebug(COMPONENT_9P,
+				     "Waiting for workers to release pconn on socket %lu",
+				     tconn->conn.trans_data.sockfd);
+			continue;
 		}
 
-		if (fds[0].revents & (POLLERR | POLLHUP | POLLRDHUP)) {
-			LogEvent(COMPONENT_9P,
-				 "Client %s on socket %lu has shut down and closed",
-				 strcaller, tcp_sock);
-			goto end;
-		}
+		glist_del(&tconn->closing);
+		_9p_tcp_conn_free(tconn);
+	}
+}
 
-		if (!(fds[0].revents & (POLLIN | POLLRDNORM)))
-			continue;
+/**
+ * @brief Read what a connection has for us and dispatch its messages
+ *
+ * Messages may arrive in any number of pieces, the partial one is
+ * kept on the connection until the next wakeup.
+ *
+ * @param[in,out] tconn The connection
+ *
+ * @return false if the connection must be closed.
+ */
+static bool _9p_tcp_read(struct _9p_tcp_conn *tconn)
+{
+	struct _9p_conn *_9p_conn = &tconn->conn;
+	long int tcp_sock = _9p_conn->trans_data.sockfd;
+	request_data_t *req;
+	uint32_t msglen = _9P_HDR_SIZE;
+	ssize_t readlen;
+	int budget = _9P_EVLOOP_BUDGET;
+	int tag;
 
-		/* Prepare to read the message */
-		_9pmsg = gsh_malloc(_9p_conn.msize);
-		if (_9pmsg == NULL) {
-			LogCrit(COMPONENT_9P,
-				"Could not allocate 9pmsg buffer for client %s on socket %lu",
-				strcaller, tcp_sock);
-			goto end;
+	while (budget > 0) {
+		if (tconn->msg == NULL) {
+			/* Prepare to read the message.  The buffer is
+			 * always taken at the largest msize, so the worker
+			 * can return it to the same pool class whatever
+			 * msize was since negotiated. */
+			tconn->msg = gsh_bufpool_get(_9P_MSG_SIZE);
+			if (tconn->msg == NULL) {
+				LogCrit(COMPONENT_9P,
+					"Could not allocate 9pmsg buffer for client %s on socket %lu",
+					tconn->strcaller, tcp_sock);
+				return false;
+			}
+			tconn->readlen = 0;
 		}
 
 		/* An incoming 9P request: the msg has a 4 bytes header
 		   showing the size of the msg including the header */
-		readlen = recv(fds[0].fd, _9pmsg,
-			       _9P_HDR_SIZE, MSG_WAITALL);
-		if (readlen != _9P_HDR_SIZE)
-			goto badmsg;
-
-		msglen = *(uint32_t *) _9pmsg;
-		if (msglen > _9p_conn.msize) {
-			LogCrit(COMPONENT_9P,
-				"Message size too big! got %u, max = %u",
-				msglen, _9p_conn.msize);
-			goto end;
+		if (tconn->readlen >= _9P_HDR_SIZE) {
+			msglen = *(uint32_t *) tconn->msg;
+			if (msglen > _9p_conn->msize) {
+				LogCrit(COMPONENT_9P,
+					"Message size too big! got %u, max = %u",
+					msglen, _9p_conn->msize);
+				return false;
+			}
+			if (msglen < _9P_STD_HDR_SIZE) {
+				LogEvent(COMPONENT_9P,
+					 "Message too small! for client %s on socket %lu: msglen=%u expected=%u",
+					 tconn->strcaller, tcp_sock, msglen,
+					 _9P_STD_HDR_SIZE);
+				return false;
+			}
+		} else {
+			msglen = _9P_HDR_SIZE;
 		}
 
-		LogFullDebug(COMPONENT_9P,
-			     "Received 9P/TCP message of size %u from client %s on socket %lu",
-			     msglen, strcaller, tcp_sock);
-
-		total_readlen += readlen;
-		while (total_readlen < msglen) {
-			readlen = recv(fds[0].fd,
-				       _9pmsg + total_readlen,
-				       msglen - total_readlen,
-				       0);
+		if (tconn->readlen < msglen) {
+			readlen = recv(tcp_sock, tconn->msg + tconn->readlen,
+				       msglen - tconn->readlen, MSG_DONTWAIT);
+
+			if (readlen < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return true;
+				if (errno == EINTR)
+					continue;
+				LogEvent(COMPONENT_9P,
+					 "Read error client %s on socket %lu errno=%d, total read = %u",
+					 tconn->strcaller, tcp_sock, errno,
+					 tconn->readlen);
+				return false;
+			}
 
-			if (readlen > 0) {
-				total_readlen += readlen;
-				continue;
+			if (readlen == 0) {
+				if (tconn->readlen == 0)
+					LogEvent(COMPONENT_9P,
+						 "Client %s on socket %lu has shut down and closed",
+						 tconn->strcaller, tcp_sock);
+				else
+					LogEvent(COMPONENT_9P,
+						 "Premature end for Client %s on socket %lu, total read = %u",
+						 tconn->strcaller, tcp_sock,
+						 tconn->readlen);
+				return false;
 			}
-			if (readlen == 0 ||
-			    (readlen < 0 && errno != EINTR))
-				goto badmsg;
-		}	/* while */
 
-		server_stats_transport_done(_9p_conn.client,
-					    total_readlen, 1, 0,
+			tconn->readlen += readlen;
+			continue;
+		}
+
+		LogFullDebug(COMPONENT_9P,
+			     "Received 9P/TCP message of size %u from client %s on socket %lu",
+			     msglen, tconn->strcaller, tcp_sock);
+
+		server_stats_transport_done(_9p_conn->client,
+					    msglen, 1, 0,
 					    0, 0, 0);
 
 		/* Message is good. */
 		req = pool_alloc(request_pool, NULL);
 
 		req->rtype = _9P_REQUEST;
-		req->r_u._9p._9pmsg = _9pmsg;
-		req->r_u._9p.pconn = &_9p_conn;
+		req->r_u._9p._9pmsg = tconn->msg;
+		req->r_u._9p.pconn = _9p_conn;
 
 		/* Add this request to the request list,
 		 * should it be flushed later. */
-		tag = *(u16 *) (_9pmsg + _9P_HDR_SIZE +
-				_9P_TYPE_SIZE);
-		_9p_AddFlushHook(&req->r_u._9p, tag,
-				 sequence++);
-		LogFullDebug(COMPONENT_9P,
-			     "Request tag is %d\n", tag);
+		tag = *(u16 *) (tconn->msg + _9P_HDR_SIZE + _9P_TYPE_SIZE);
+		_9p_AddFlushHook(&req->r_u._9p, tag, _9p_conn->sequence++);
+		LogFullDebug(COMPONENT_9P, "Request tag is %d\n", tag);
 
 		/* Message was OK push it */
 		DispatchWork9P(req);
 
 		/* Not our buffer anymore */
-		_9pmsg = NULL;
-		continue;
-
-badmsg:
-		if (readlen == 0)
-			LogEvent(COMPONENT_9P,
-				 "Premature end for Client %s on socket %lu, total read = %u",
-				 strcaller, tcp_sock, total_readlen);
-		else if (readlen < 0) {
-			LogEvent(COMPONENT_9P,
-				 "Read error client %s on socket %lu errno=%d, total read = %u",
-				 strcaller, tcp_sock,
-				 errno, total_readlen);
-		} else
-			LogEvent(COMPONENT_9P,
-				 "Header too small! for client %s on socket %lu: readlen=%u expected=%u",
-				 strcaller, tcp_sock, readlen,
-				 _9P_HDR_SIZE);
-
-		/* Either way, we close the connection.
-		 * It is not possible to survive
-		 * once we get out of sync in the TCP stream
-		 * with the client
-		 */
-		break; /* bail out */
-	}			/* for( ;; ) */
-
-end:
-	LogEvent(COMPONENT_9P, "Closing connection on socket %lu", tcp_sock);
-	close(tcp_sock);
+		tconn->msg = NULL;
+		budget--;
+	}
 
-	/* Free buffer if we encountered an error
-	 * before we could give it to a worker */
-	if (_9pmsg)
-		gsh_free(_9pmsg);
+	return true;
+}
 
-	while (atomic_fetch_uint32_t(&_9p_conn.refcount)) {
-		LogEvent(COMPONENT_9P, "Waiting for workers to release pconn");
-		sleep(1);
+/**
+ * @brief Main loop of a 9P/TCP event thread
+ *
+ * Each connection is polled by one loop for its whole life, so its
+ * messages are dispatched in the order they were sent, with the same
+ * flush sequence numbering the per connection threads used to give.
+ *
+ * @param[in] arg The event loop
+ *
+ * @return NULL, never in practice.
+ */
+static void *_9p_evloop_thread(void *arg)
+{
+	struct _9p_evloop *loop = arg;
+	struct epoll_event events[_9P_EVLOOP_EVENTS];
+	struct _9p_tcp_conn *tconn;
+	char my_name[MAXNAMLEN + 1];
+	int nevents, i;
+
+	snprintf(my_name, MAXNAMLEN, "9p_evloop#%ld",
+		 (long int)(loop - _9p_evloops));
+	SetNameFunction(my_name);
+
+	for (;;) {
+		/* Only wake up on our own while connections wait on
+		 * workers to let go of them. */
+		nevents = epoll_wait(loop->epfd, events, _9P_EVLOOP_EVENTS,
+				     glist_empty(&loop->closing) ? -1 : 1000);
+		if (nevents == -1) {
+			if (errno != EINTR)
+				LogCrit(COMPONENT_9P,
+					"Got error %u (%s) while polling 9p sockets",
+					errno, strerror(errno));
+			continue;
+		}
+
+		for (i = 0; i < nevents; i++) {
+			tconn = events[i].data.ptr;
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				LogEvent(COMPONENT_9P,
+					 "Client %s on socket %lu has shut down and closed",
+					 tconn->strcaller,
+					 tconn->conn.trans_data.sockfd);
+				_9p_tcp_shutdown(tconn);
+				continue;
+			}
+
+			/* EPOLLRDHUP still lets us read what came before
+			 * the shutdown, recv then reports the end. */
+			if (!_9p_tcp_read(tconn))
+				_9p_tcp_shutdown(tconn);
+		}
+
+		if (!glist_empty(&loop->closing))
+			_9p_tcp_reap(loop);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Start the 9P/TCP event loops
+ *
+ * @return 0 or -1 if none could be started.
+ */
+static int _9p_evloops_init(void)
+{
+	pthread_attr_t attr_thr;
+	pthread_t thrid;
+	uint16_t i;
+
+	_9p_evloops = gsh_calloc(_9p_param._9p_tcp_event_loops,
+				 sizeof(*_9p_evloops));
+	if (_9p_evloops == NULL)
+		return -1;
+
+	if (pthread_attr_init(&attr_thr) != 0)
+		LogDebug(COMPONENT_9P_DISPATCH,
+			 "can't init pthread's attributes");
+
+	if (pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM) != 0)
+		LogDebug(COMPONENT_9P_DISPATCH, "can't set pthread's scope");
+
+	if (pthread_attr_setdetachstate(&attr_thr,
+					PTHREAD_CREATE_DETACHED) != 0)
+		LogDebug(COMPONENT_9P_DISPATCH,
+			 "can't set pthread's join state");
+
+	for (i = 0; i < _9p_param._9p_tcp_event_loops; i++) {
+		struct _9p_evloop *loop = &_9p_evloops[_9p_nevloops];
+
+		loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (loop->epfd == -1) {
+			LogCrit(COMPONENT_9P_DISPATCH,
+				"Could not create 9p event loop, error %d (%s)",
+				errno, strerror(errno));
+			break;
+		}
+		glist_init(&loop->closing);
+
+		if (pthread_create(&thrid, &attr_thr, _9p_evloop_thread,
+				   loop) != 0) {
+			LogCrit(COMPONENT_THREAD,
+				"Could not create 9p event loop thread, error = %d (%s)",
+				errno, strerror(errno));
+			close(loop->epfd);
+			break;
+		}
+		_9p_nevloops++;
 	}
 
-	_9p_cleanup_fids(&_9p_conn);
+	pthread_attr_destroy(&attr_thr);
 
-	if (_9p_conn.client != NULL)
-		put_gsh_client(_9p_conn.client);
+	LogInfo(COMPONENT_9P_DISPATCH, "Started %u 9p event loops",
+		_9p_nevloops);
 
-	pthread_exit(NULL);
-}				/* _9p_socket_thread */
+	return _9p_nevloops > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Set up an accepted connection and hand it to an event loop
+ *
+ * The connection goes to the loop polling the fewest.
+ *
+ * @param[in] tcp_sock The accepted socket
+ */
+static void _9p_tcp_conn_add(long int tcp_sock)
+{
+	struct _9p_tcp_conn *tconn;
+	struct _9p_conn *_9p_conn;
+	struct _9p_evloop *loop = &_9p_evloops[0];
+	socklen_t addrpeerlen = 0;
+	struct sockaddr_storage addrpeer;
+	struct epoll_event ev;
+	unsigned int i;
+	int rc;
+
+	tconn = gsh_calloc(1, sizeof(*tconn));
+	if (tconn == NULL) {
+		LogCrit(COMPONENT_9P,
+			"Could not allocate 9p connection for socket %lu",
+			tcp_sock);
+		close(tcp_sock);
+		return;
+	}
+	_9p_conn = &tconn->conn;
+
+	/* Init the struct _9p_conn structure */
+	pthread_mutex_init(&_9p_conn->sock_lock, NULL);
+	_9p_conn->trans_type = _9P_TCP;
+	_9p_conn->trans_data.sockfd = tcp_sock;
+	for (i = 0; i < FLUSH_BUCKETS; i++) {
+		pthread_mutex_init(&_9p_conn->flush_buckets[i].lock, NULL);
+		glist_init(&_9p_conn->flush_buckets[i].list);
+	}
+	atomic_store_uint32_t(&_9p_conn->refcount, 0);
+
+	/* Set initial msize.
+	 * Client may request a lower value during TVERSION */
+	_9p_conn->msize = _9p_param._9p_tcp_msize;
+
+	if (gettimeofday(&_9p_conn->birth, NULL) == -1)
+		LogFatal(COMPONENT_9P, "Cannot get connection's time of birth");
+
+	addrpeerlen = sizeof(addrpeer);
+	rc = getpeername(tcp_sock, (struct sockaddr *)&addrpeer,
+			 &addrpeerlen);
+	if (rc == -1) {
+		LogMajor(COMPONENT_9P,
+			 "Cannot get peername to tcp socket for 9p, error %d (%s)",
+			 errno, strerror(errno));
+		/* XXX */
+		strncpy(tconn->strcaller, "(unresolved)", INET6_ADDRSTRLEN);
+		tconn->strcaller[12] = '\0';
+	} else {
+		switch (addrpeer.ss_family) {
+		case AF_INET:
+			inet_ntop(addrpeer.ss_family,
+				  &((struct sockaddr_in *)&addrpeer)->
+				  sin_addr, tconn->strcaller, INET6_ADDRSTRLEN);
+			break;
+		case AF_INET6:
+			inet_ntop(addrpeer.ss_family,
+				  &((struct sockaddr_in6 *)&addrpeer)->
+				  sin6_addr, tconn->strcaller,
+				  INET6_ADDRSTRLEN);
+			break;
+		default:
+			snprintf(tconn->strcaller, INET6_ADDRSTRLEN,
+				 "BAD ADDRESS");
+			break;
+		}
+
+		LogEvent(COMPONENT_9P, "9p socket #%ld is connected to %s",
+			 tcp_sock, tconn->strcaller);
+	}
+	_9p_conn->client = get_gsh_client(&addrpeer, false);
+
+	for (i = 1; i < _9p_nevloops; i++)
+		if (atomic_fetch_uint32_t(&_9p_evloops[i].nconns) <
+		    atomic_fetch_uint32_t(&loop->nconns))
+			loop = &_9p_evloops[i];
+	tconn->loop = loop;
+	atomic_inc_uint32_t(&loop->nconns);
+
+	/* The socket itself stays blocking for the workers sending
+	 * replies, the loop reads with MSG_DONTWAIT. */
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLRDHUP;
+	ev.data.ptr = tconn;
+
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, tcp_sock, &ev) == -1) {
+		LogCrit(COMPONENT_9P,
+			"Could not poll 9p socket %lu, error %d (%s)",
+			tcp_sock, errno, strerror(errno));
+		atomic_dec_uint32_t(&loop->nconns);
+		_9p_tcp_conn_free(tconn);
+	}
+}
 
 /**
  * _9p_create_socket: create the accept socket for 9P
@@ -446,42 +653,20 @@ bad_socket:
  */
 void _9p_dispatcher_svc_run(long int sock)
 {
-	int rc = 0;
 	struct sockaddr_in addr;
 	socklen_t addrlen = sizeof(addr);
 	long int newsock = -1;
-	pthread_attr_t attr_thr;
-	pthread_t tcp_thrid;
-
-	/* Init for thread parameter (mostly for scheduling) */
-	if (pthread_attr_init(&attr_thr) != 0)
-		LogDebug(COMPONENT_9P_DISPATCH,
-			 "can't init pthread's attributes");
-
-	if (pthread_attr_setscope(&attr_thr, PTHREAD_SCOPE_SYSTEM) != 0)
-		LogDebug(COMPONENT_9P_DISPATCH, "can't set pthread's scope");
-
-	if (pthread_attr_setdetachstate(&attr_thr,
-					PTHREAD_CREATE_DETACHED) != 0)
-		LogDebug(COMPONENT_9P_DISPATCH,
-			 "can't set pthread's join state");
 
 	LogEvent(COMPONENT_9P_DISPATCH, "9P dispatcher started");
 	while (true) {
+		addrlen = sizeof(addr);
 		newsock = accept(sock, (struct sockaddr *)&addr, &addrlen);
 		if (newsock < 0) {
 			LogCrit(COMPONENT_9P_DISPATCH, "accept failed");
 			continue;
 		}
 
-		/* Starting the thread dedicated to signal handling */
-		rc = pthread_create(&tcp_thrid, &attr_thr,
-				    _9p_socket_thread, (void *)newsock);
-		if (rc != 0) {
-			LogFatal(COMPONENT_THREAD,
-				 "Could not create 9p socket manager thread, error = %d (%s)",
-				 errno, strerror(errno));
-		}
+		_9p_tcp_conn_add(newsock);
 	}			/* while */
 	return;
 }				/* _9p_dispatcher_svc_run */
@@ -510,6 +695,12 @@ void *_9p_dispatcher_thread(void *Arg)
 	LogDebug(COMPONENT_9P_DISPATCH, "My pthread id is %p",
 		 (caddr_t) pthread_self());
 
+	if (_9p_evloops_init() != 0) {
+		LogCrit(COMPONENT_9P_DISPATCH,
+			"Can't start event loops for 9p dispatcher");
+		exit(1);
+	}
+
 	/* Set up the _9p_socket */
 	_9p_socket = _9p_create_socket();
 	if (_9p_socket == -1) {
@@ -224,10 +224,198 @@ static struct gsh_dbus_method method_purge_gids = {
 		 END_ARG_LIST}
 };
 
+static void admin_dbus_append_reclaimer(const char *name, bool nlm,
+					void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter;
+	dbus_bool_t is_nlm = nlm;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_BOOLEAN,
+				       &is_nlm);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Dbus method listing the clients the grace period waits for
+ *
+ * Replies with whether the server is in grace, how many clients
+ * known from before the restart have not finished reclaiming, and
+ * their names, each flagged if it is an NLM host.
+ *
+ * @param[in]  args  Unused
+ * @param[out] reply The reply
+ */
+
+static bool admin_dbus_get_reclaimers(DBusMessageIter *args,
+				      DBusMessage *reply,
+				      DBusError *error)
+{
+	char *errormsg = "OK";
+	bool success = true;
+	DBusMessageIter iter, array_iter;
+	dbus_bool_t in_grace;
+	uint32_t pending;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args != NULL) {
+		errormsg = "Get reclaimers takes no arguments.";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		dbus_status_reply(&iter, success, errormsg);
+		return success;
+	}
+
+	in_grace = nfs_in_grace();
+	dbus_status_reply(&iter, success, errormsg);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &in_grace);
+
+	/* The count follows the list it was taken with */
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sb)",
+					 &array_iter);
+	pending = nfs4_foreach_reclaimer(admin_dbus_append_reclaimer,
+					 &array_iter);
+	dbus_message_iter_close_container(&iter, &array_iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &pending);
+
+	return success;
+}
+
+static struct gsh_dbus_method method_get_reclaimers = {
+	.name = "get_reclaimers",
+	.method = admin_dbus_get_reclaimers,
+	.args = {STATUS_REPLY,
+		 {
+		  .name = "in_grace",
+		  .type = "b",
+		  .direction = "out"},
+		 {
+		  .name = "reclaimers",
+		  .type = "a(sb)",
+		  .direction = "out"},
+		 {
+		  .name = "pending",
+		  .type = "u",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief Dbus method reporting the worker pool size
+ *
+ * Replies with the bounds and current size of the worker pool, how
+ * many workers are idle, how many threads are in the FSAL, the
+ * request backlog and average queue wait it was last sized by, how
+ * many workers it has added and retired, and, with sharded queues,
+ * how many requests were stolen from a peer's shard or overflowed to
+ * the shared queues.
+ *
+ * @param[in]  args  Unused
+ * @param[out] reply The reply
+ */
+
+static bool admin_dbus_get_worker_pool(DBusMessageIter *args,
+				       DBusMessage *reply,
+				       DBusError *error)
+{
+	char *errormsg = "OK";
+	bool success = true;
+	DBusMessageIter iter;
+	struct worker_pool_stats stats;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args != NULL) {
+		errormsg = "Get worker pool takes no arguments.";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		dbus_status_reply(&iter, success, errormsg);
+		return success;
+	}
+
+	worker_pool_stats(&stats);
+	dbus_status_reply(&iter, success, errormsg);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &stats.min);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &stats.max);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &stats.threads);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &stats.idle);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &stats.fsal_busy);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &stats.backlog);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &stats.qwait_us);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &stats.grown);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64,
+				       &stats.shrunk);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64,
+				       &stats.steals);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64,
+				       &stats.overflows);
+
+	return success;
+}
+
+static struct gsh_dbus_method method_get_worker_pool = {
+	.name = "get_worker_pool",
+	.method = admin_dbus_get_worker_pool,
+	.args = {STATUS_REPLY,
+		 {
+		  .name = "min",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "max",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "threads",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "idle",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "fsal_busy",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "backlog",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "qwait_us",
+		  .type = "u",
+		  .direction = "out"},
+		 {
+		  .name = "grown",
+		  .type = "t",
+		  .direction = "out"},
+		 {
+		  .name = "shrunk",
+		  .type = "t",
+		  .direction = "out"},
+		 {
+		  .name = "steals",
+		  .type = "t",
+		  .direction = "out"},
+		 {
+		  .name = "overflows",
+		  .type = "t",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *admin_methods[] = {
 	&method_shutdown,
 	&method_grace_period,
 	&method_purge_gids,
+	&method_get_reclaimers,
+	&method_get_worker_pool,
 	NULL
 };
 
@@ -68,10 +68,13 @@
 #include "delayed_exec.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "server_stats.h"
+#include "gsh_bufpool.h"
 #ifdef USE_CAPS
 #include <sys/capability.h>	/* For capget/capset */
 #endif
 #include "uid2grp.h"
+#include "nfs_trace.h"
 
 
 /* global information exported to all layers (as extern vars) */
@@ -175,6 +178,8 @@ void nfs_print_param_config()
 	printf("\tNFS_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
 	printf("\tMNT_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
 	printf("\tNb_Worker = %u ;\n", nfs_param.core_param.nb_worker);
+	printf("\tMin_Worker = %u ;\n", nfs_param.core_param.min_worker);
+	printf("\tMax_Worker = %u ;\n", nfs_param.core_param.max_worker);
 	printf("\tDRC_TCP_Npart = %u ;\n", nfs_param.core_param.drc.tcp.npart);
 	printf("\tDRC_TCP_Size = %u ;\n", nfs_param.core_param.drc.tcp.size);
 	printf("\tDRC_TCP_Cachesz = %u ;\n",
@@ -193,6 +198,10 @@ void nfs_print_param_config()
 	printf("\tDRC_UDP_Hiwat = %u ;\n", nfs_param.core_param.drc.udp.hiwat);
 	printf("\tDRC_UDP_Checksum = %u ;\n",
 	       nfs_param.core_param.drc.udp.checksum);
+	printf("\tDRC_Memory_Budget = %" PRIu64 " ;\n",
+	       nfs_param.core_param.drc.memory_budget);
+	printf("\tDRC_Retire_Window_S = %u ;\n",
+	       nfs_param.core_param.drc.retire_window_s);
 	printf("\tDecoder_Fridge_Expiration_Delay = %" PRIu64 " ;\n",
 	       nfs_param.core_param.decoder_fridge_expiration_delay);
 	printf("\tDecoder_Fridge_Block_Timeout = %" PRIu64 " ;\n",
@@ -327,6 +336,9 @@ int init_server_pkgs(void)
 	/* init uid2grp cache */
 	uid2grp_cache_init();
 
+	/* per-op latency histograms */
+	server_stats_pkginit();
+
 	/* Cache Inode Initialisation */
 	cache_status = cache_inode_init();
 	if (cache_status != CACHE_INODE_SUCCESS) {
@@ -360,6 +372,11 @@ int init_server_pkgs(void)
 		return -1;
 	}
 	LogEvent(COMPONENT_INIT, "ID Mapper successfully initialized.");
+
+	if (!nfs_trace_init()) {
+		LogCrit(COMPONENT_INIT, "Failed initializing request tracer.");
+		return -1;
+	}
 	return 0;
 }
 
@@ -540,6 +557,10 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 		LogFatal(COMPONENT_INIT,
 			"Error while allocating duplicate request pool");
 
+	if (gsh_bufpool_init() != 0)
+		LogFatal(COMPONENT_INIT,
+			 "Error while allocating I/O buffer pools");
+
 	/* If rpcsec_gss is used, set the path to the keytab */
 #ifdef _HAVE_GSSAPI
 #ifdef HAVE_KRB5
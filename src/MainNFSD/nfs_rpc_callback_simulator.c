@@ -131,6 +131,28 @@ static struct gsh_dbus_method cbsim_get_client_ids = {
 		 }
 };
 
+/**
+ * @brief Append one session id to a DBus array
+ *
+ * Callback for hashtable_for_each over ht_session_id.
+ */
+
+static void nfs_rpc_cbsim_append_session_id(struct gsh_buffdesc *key,
+					    struct gsh_buffdesc *val,
+					    void *arg)
+{
+	DBusMessageIter *sub_iter = arg;
+	char session_id[2 * NFS4_SESSIONID_SIZE];	/* guaranteed to fit */
+	char *session_str = session_id;
+	nfs41_session_t *session_data = val->addr;
+
+	/* format */
+	b64_ntop((unsigned char *)session_data->session_id,
+		 NFS4_SESSIONID_SIZE, session_id, (2 * NFS4_SESSIONID_SIZE));
+	dbus_message_iter_append_basic(sub_iter, DBUS_TYPE_STRING,
+				       &session_str);
+}
+
 /**
  * @brief Return a timestamped list of session ids.
  *
@@ -142,13 +164,6 @@ static bool nfs_rpc_cbsim_get_session_ids(DBusMessageIter *args,
 					  DBusMessage *reply,
 					  DBusError *error)
 {
-	uint32_t i;
-	hash_table_t *ht = ht_session_id;
-	struct rbt_head *head_rbt;
-	struct hash_data *pdata = NULL;
-	struct rbt_node *pn;
-	char session_id[2 * NFS4_SESSIONID_SIZE];	/* guaranteed to fit */
-	nfs41_session_t *session_data;
 	DBusMessageIter iter, sub_iter;
 	struct timespec ts;
 
@@ -159,28 +174,9 @@ static bool nfs_rpc_cbsim_get_session_ids(DBusMessageIter *args,
 
 	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
 					 DBUS_TYPE_UINT64_AS_STRING, &sub_iter);
-	/* For each bucket of the hashtable */
-	for (i = 0; i < ht->parameter.index_size; i++) {
-		head_rbt = &(ht->partitions[i].rbt);
-
-		/* acquire mutex */
-		PTHREAD_RWLOCK_wrlock(&(ht->partitions[i].lock));
-
-		/* go through all entries in the red-black-tree */
-		RBT_LOOP(head_rbt, pn) {
-			pdata = RBT_OPAQ(pn);
-			session_data = pdata->val.addr;
-			/* format */
-			b64_ntop((unsigned char *)session_data->session_id,
-				 NFS4_SESSIONID_SIZE, session_id,
-				 (2 * NFS4_SESSIONID_SIZE));
-			dbus_message_iter_append_basic(&sub_iter,
-						       DBUS_TYPE_STRING,
-						       &session_id);
-			RBT_INCREMENT(pn);
-		}
-		PTHREAD_RWLOCK_unlock(&(ht->partitions[i].lock));
-	}
+	/* the session table may be open-addressed, so no tree walk */
+	hashtable_for_each(ht_session_id, nfs_rpc_cbsim_append_session_id,
+			   &sub_iter);
 	dbus_message_iter_close_container(&iter, &sub_iter);
 	return true;
 }
@@ -56,6 +56,7 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "fridgethr.h"
+#include "nfs_trace.h"
 
 /**
  * TI-RPC event channels.  Each channel is a thread servicing an event
@@ -751,24 +752,44 @@ request_data_t *nfs_rpc_get_nfsreq(uint32_t __attribute__ ((unused)) flags)
 	return nfsreq;
 }
 
-uint32_t nfs_rpc_outstanding_reqs_est(void)
+/**
+ * @brief Count the requests waiting for a worker
+ *
+ * @return The number of queued requests.
+ */
+
+uint32_t nfs_rpc_outstanding_reqs(void)
 {
-	static uint32_t ctr;
-	static uint32_t nreqs;
 	struct req_q_pair *qpair;
 	uint32_t treqs;
+	uint32_t sx;
 	int ix;
 
-	if ((atomic_inc_uint32_t(&ctr) % 10) != 0)
-		return atomic_fetch_uint32_t(&nreqs);
-
 	treqs = 0;
 	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
 		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
 		treqs += atomic_fetch_uint32_t(&qpair->producer.size);
 		treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
 	}
+	for (sx = 0; sx < nfs_req_st.shard.nshards; ++sx) {
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix)
+			treqs += nfs_rpc_ring_size(
+				&nfs_req_st.shard.shards[sx].ring[ix]);
+	}
+
+	return treqs;
+}
 
+uint32_t nfs_rpc_outstanding_reqs_est(void)
+{
+	static uint32_t ctr;
+	static uint32_t nreqs;
+	uint32_t treqs;
+
+	if ((atomic_inc_uint32_t(&ctr) % 10) != 0)
+		return atomic_fetch_uint32_t(&nreqs);
+
+	treqs = nfs_rpc_outstanding_reqs();
 	atomic_store_uint32_t(&nreqs, treqs);
 	return treqs;
 }
@@ -887,6 +908,46 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 	return TRUE;
 }
 
+/**
+ * @brief Allocate the per-worker request shards
+ *
+ * One shard per configured worker, each holding a ring per queue
+ * class.  Ring sizes are rounded up to a power of two.
+ */
+
+static void nfs_rpc_shard_init(void)
+{
+	uint32_t nshards = nfs_param.core_param.nb_worker;
+	uint32_t size = 1;
+	uint32_t sx;
+	int ix;
+
+	while (size < nfs_param.core_param.dispatch_shard_size)
+		size <<= 1;
+
+	nfs_req_st.shard.shards =
+	    gsh_calloc(nshards, sizeof(struct req_shard));
+	if (!nfs_req_st.shard.shards)
+		LogFatal(COMPONENT_DISPATCH,
+			 "Unable to allocate %u request shards", nshards);
+
+	for (sx = 0; sx < nshards; ++sx) {
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			if (!nfs_rpc_ring_init(
+				    &nfs_req_st.shard.shards[sx].ring[ix],
+				    size))
+				LogFatal(COMPONENT_DISPATCH,
+					 "Unable to allocate request ring %s for shard %u",
+					 req_q_s[ix], sx);
+		}
+	}
+	nfs_req_st.shard.nshards = nshards;
+
+	LogEvent(COMPONENT_DISPATCH,
+		 "Sharded request queues: %u shards, %u slots per queue",
+		 nshards, size);
+}
+
 void nfs_rpc_queue_init(void)
 {
 	struct fridgethr_params reqparams;
@@ -922,6 +983,14 @@ void nfs_rpc_queue_init(void)
 		nfs_rpc_q_init(&qpair->consumer);
 	}
 
+	/* per-worker shards */
+	nfs_req_st.shard.mode = nfs_param.core_param.dispatch_queue_mode;
+	nfs_req_st.shard.nshards = 0;
+	nfs_req_st.shard.shards = NULL;
+	nfs_req_st.shard.overflows = 0;
+	if (nfs_req_st.shard.mode == REQ_Q_MODE_SHARDED)
+		nfs_rpc_shard_init();
+
 	/* waitq */
 	glist_init(&nfs_req_st.reqs.wait_list);
 	nfs_req_st.reqs.waiters = 0;
@@ -936,11 +1005,162 @@ void nfs_rpc_queue_init(void)
 static uint32_t enqueued_reqs;
 static uint32_t dequeued_reqs;
 
+/**
+ * @brief Choose the shard for a request
+ *
+ * Requests from one transport go to the same worker, which keeps a
+ * connection's requests (and its xprt lock) on one core.  UDP shares
+ * a single transport among all clients, so it is spread instead.
+ *
+ * @param[in] req The request
+ *
+ * @return Shard index.
+ */
+
+static inline uint32_t nfs_rpc_shard_of(request_data_t *req)
+{
+	uint32_t nshards = nfs_req_st.shard.nshards;
+	uintptr_t key;
+
+	switch (req->rtype) {
+	case NFS_REQUEST:
+		if (req->r_u.nfs->xprt->xp_type == XPRT_UDP)
+			return nfs_rpc_q_next_slot() % nshards;
+		key = (uintptr_t) req->r_u.nfs->xprt;
+		break;
+#ifdef _USE_9P
+	case _9P_REQUEST:
+		key = (uintptr_t) req->r_u._9p.pconn;
+		break;
+#endif
+	default:
+		return nfs_rpc_q_next_slot() % nshards;
+	}
+
+	/* low bits of a heap address carry no information */
+	return (uint32_t) ((key >> 6) % nshards);
+}
+
+/**
+ * @brief Queue a request on a worker's shard
+ *
+ * Try the transport's home shard and its neighbour.  If both rings
+ * are full the caller falls back to the shared LIFO queues, which
+ * every worker also drains.
+ *
+ * @param[in] req  The request
+ * @param[in] qidx Queue class (REQ_Q_*)
+ *
+ * @retval true if queued.
+ * @retval false if the caller must use the shared queues.
+ */
+
+static bool nfs_rpc_shard_enqueue(request_data_t *req, uint32_t qidx)
+{
+	uint32_t nshards = nfs_req_st.shard.nshards;
+	uint32_t home = nfs_rpc_shard_of(req);
+	uint32_t ix;
+
+	for (ix = 0; ix < 2 && ix < nshards; ++ix) {
+		struct req_shard *shard =
+		    &nfs_req_st.shard.shards[(home + ix) % nshards];
+
+		if (nfs_rpc_ring_push(&shard->ring[qidx], req)) {
+			LogFullDebug(COMPONENT_DISPATCH,
+				     "enqueued req %p on shard %u %s",
+				     req, (home + ix) % nshards,
+				     req_q_s[qidx]);
+			return true;
+		}
+	}
+
+	atomic_inc_uint64_t(&nfs_req_st.shard.overflows);
+	return false;
+}
+
+/**
+ * @brief Take a request from the shards
+ *
+ * The worker's own shard is tried first, then peers are robbed in
+ * order.  Queue classes are visited starting at slot, so the
+ * weighting between LOW and HIGH latency requests matches the
+ * shared queues.
+ *
+ * @param[in] worker The worker
+ * @param[in] slot   First queue class to try
+ *
+ * @return A request, or NULL if every shard is empty.
+ */
+
+static request_data_t *nfs_rpc_shard_dequeue(nfs_worker_data_t *worker,
+					     uint32_t slot)
+{
+	uint32_t nshards = nfs_req_st.shard.nshards;
+	uint32_t home = worker->worker_index % nshards;
+	request_data_t *nfsreq;
+	struct req_shard *shard;
+	uint32_t ix, jx;
+
+	for (ix = 0; ix < nshards; ++ix) {
+		shard = &nfs_req_st.shard.shards[(home + ix) % nshards];
+		for (jx = 0; jx < N_REQ_QUEUES; ++jx) {
+			nfsreq = nfs_rpc_ring_pop(
+				&shard->ring[(slot + jx) % N_REQ_QUEUES]);
+			if (!nfsreq)
+				continue;
+			if (ix != 0)
+				atomic_inc_uint64_t(&shard->steals);
+			atomic_inc_uint32_t(&dequeued_reqs);
+			return nfsreq;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Wake one worker on the global waitq, if any
+ *
+ * @param[in] q Queue the request went on, for logging (may be NULL)
+ */
+
+static void nfs_rpc_wake_waiter(struct req_q *q)
+{
+	wait_q_entry_t *wqe;
+
+	/* SPIN LOCKED */
+	pthread_spin_lock(&nfs_req_st.reqs.sp);
+	if (nfs_req_st.reqs.waiters) {
+		wqe = glist_first_entry(&nfs_req_st.reqs.wait_list,
+					wait_q_entry_t, waitq);
+
+		LogFullDebug(COMPONENT_DISPATCH,
+			     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
+			     nfs_req_st.reqs.waiters, wqe, q);
+
+		/* release 1 waiter */
+		glist_del(&wqe->waitq);
+		--(nfs_req_st.reqs.waiters);
+		--(wqe->waiters);
+		/* ! SPIN LOCKED */
+		pthread_spin_unlock(&nfs_req_st.reqs.sp);
+		pthread_mutex_lock(&wqe->lwe.mtx);
+		/* XXX reliable handoff */
+		wqe->flags |= Wqe_LFlag_SyncDone;
+		if (wqe->flags & Wqe_LFlag_WaitSync)
+			pthread_cond_signal(&wqe->lwe.cv);
+		pthread_mutex_unlock(&wqe->lwe.mtx);
+	} else
+		/* ! SPIN LOCKED */
+		pthread_spin_unlock(&nfs_req_st.reqs.sp);
+}
+
 void nfs_rpc_enqueue_req(request_data_t *req)
 {
 	struct req_q_set *nfs_request_q;
 	struct req_q_pair *qpair;
-	struct req_q *q;
+	struct req_q *q = NULL;
+	uint32_t qidx;
 
 	nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
 
@@ -951,22 +1171,22 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 			     req->r_u.nfs->req.rq_xid,
 			     req->r_u.nfs->lookahead.flags);
 		if (req->r_u.nfs->lookahead.flags & NFS_LOOKAHEAD_MOUNT) {
-			qpair = &(nfs_request_q->qset[REQ_Q_MOUNT]);
+			qidx = REQ_Q_MOUNT;
 			break;
 		}
 		if (NFS_LOOKAHEAD_HIGH_LATENCY(req->r_u.nfs->lookahead))
-			qpair = &(nfs_request_q->qset[REQ_Q_HIGH_LATENCY]);
+			qidx = REQ_Q_HIGH_LATENCY;
 		else
-			qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+			qidx = REQ_Q_LOW_LATENCY;
 		break;
 	case NFS_CALL:
-		qpair = &(nfs_request_q->qset[REQ_Q_CALL]);
+		qidx = REQ_Q_CALL;
 		break;
 #ifdef _USE_9P
 	case _9P_REQUEST:
 		/* XXX identify high-latency requests and allocate
 		 * to the high-latency queue, as above */
-		qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+		qidx = REQ_Q_LOW_LATENCY;
 		break;
 #endif
 	default:
@@ -977,7 +1197,18 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 	/* this one is real, timestamp it
 	 */
 	now(&req->time_queued);
+	NFS_TRACE(req->trace_id, NFS_TRACE_ENQUEUE, 0);
+
+	if (nfs_req_st.shard.mode == REQ_Q_MODE_SHARDED
+	    && nfs_rpc_shard_enqueue(req, qidx)) {
+		atomic_inc_uint32_t(&enqueued_reqs);
+		/* waiters is only read under reqs.sp; a worker registers
+		 * there before its last look at the shards */
+		goto wakeup;
+	}
+
 	/* always append to producer queue */
+	qpair = &(nfs_request_q->qset[qidx]);
 	q = &qpair->producer;
 	pthread_spin_lock(&q->sp);
 	glist_add_tail(&q->q, &req->req_q);
@@ -991,38 +1222,9 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 		 q, qpair->s, &qpair->producer, &qpair->consumer, q->size,
 		 enqueued_reqs, dequeued_reqs);
 
+ wakeup:
 	/* potentially wakeup some thread */
-
-	/* global waitq */
-	{
-		wait_q_entry_t *wqe;
-
-		/* SPIN LOCKED */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		if (nfs_req_st.reqs.waiters) {
-			wqe = glist_first_entry(&nfs_req_st.reqs.wait_list,
-						wait_q_entry_t, waitq);
-
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
-				     nfs_req_st.reqs.waiters, wqe, q);
-
-			/* release 1 waiter */
-			glist_del(&wqe->waitq);
-			--(nfs_req_st.reqs.waiters);
-			--(wqe->waiters);
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-			pthread_mutex_lock(&wqe->lwe.mtx);
-			/* XXX reliable handoff */
-			wqe->flags |= Wqe_LFlag_SyncDone;
-			if (wqe->flags & Wqe_LFlag_WaitSync)
-				pthread_cond_signal(&wqe->lwe.cv);
-			pthread_mutex_unlock(&wqe->lwe.mtx);
-		} else
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-	}
+	nfs_rpc_wake_waiter(q);
 
  out:
 	return;
@@ -1101,7 +1303,11 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 	/* slot in 1..4 */
  retry_deq:
 	slot = (nfs_rpc_q_next_slot() % 4);
-	for (ix = 0; ix < 4; ++ix) {
+	if (nfs_req_st.shard.mode == REQ_Q_MODE_SHARDED)
+		nfsreq = nfs_rpc_shard_dequeue(worker, slot);
+
+	/* in sharded mode, the shared queues only hold overflow */
+	for (ix = 0; !nfsreq && ix < 4; ++ix) {
 		switch (slot) {
 		case 0:
 			/* MOUNT */
@@ -1153,6 +1359,37 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 		glist_add_tail(&nfs_req_st.reqs.wait_list, &wqe->waitq);
 		++(nfs_req_st.reqs.waiters);
 		pthread_spin_unlock(&nfs_req_st.reqs.sp);
+
+		/* A ring push does not take reqs.sp, so look at the shards
+		 * again now that enqueuers can see us waiting */
+		if (nfs_req_st.shard.mode == REQ_Q_MODE_SHARDED)
+			nfsreq = nfs_rpc_shard_dequeue(worker, slot);
+		if (nfsreq) {
+			bool signalled = true;
+
+			pthread_spin_lock(&nfs_req_st.reqs.sp);
+			if (wqe->waitq.next != NULL
+			    || wqe->waitq.prev != NULL) {
+				glist_del(&wqe->waitq);
+				--(nfs_req_st.reqs.waiters);
+				--(wqe->waiters);
+				signalled = false;
+			}
+			pthread_spin_unlock(&nfs_req_st.reqs.sp);
+			/* let a signaller finish with wqe before reuse */
+			while (signalled
+			       && !(wqe->flags & Wqe_LFlag_SyncDone))
+				pthread_cond_wait(&wqe->lwe.cv, &wqe->lwe.mtx);
+			wqe->flags &=
+			    ~(Wqe_LFlag_WaitSync | Wqe_LFlag_SyncDone);
+			pthread_mutex_unlock(&wqe->lwe.mtx);
+			/* an enqueuer picked us for its request; pass the
+			 * wakeup on, that request may not be this one */
+			if (signalled)
+				nfs_rpc_wake_waiter(NULL);
+			return nfsreq;
+		}
+
 		while (!(wqe->flags & Wqe_LFlag_SyncDone)) {
 			timeout.tv_sec = time(NULL) + 5;
 			timeout.tv_nsec = 0;
@@ -1219,6 +1456,8 @@ static inline request_data_t *alloc_nfs_request(SVCXPRT *xprt)
 		Fatal();
 	}
 
+	nfsreq->r_u.nfs->async = NULL;
+
 	/* set up req */
 	req = &(nfsreq->r_u.nfs->req);
 
@@ -1571,6 +1810,9 @@ static inline enum xprt_stat thr_decode_rpc_request(struct fridgethr_context
 		if (!nfs_rpc_get_args(thr_ctx, nfsreq->r_u.nfs))
 			goto finish;
 
+		if (unlikely(nfs_trace_enabled))
+			nfs_trace_decode(nfsreq);
+
 		/* update accounting */
 		if (!gsh_xprt_ref
 		    (xprt, XPRT_PRIVATE_FLAG_INCREQ, __func__, __LINE__)) {
@@ -64,6 +64,9 @@
 #include "export_mgr.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "os/subr.h"
+#include "gsh_bufpool.h"
+#include "nfs_trace.h"
 
 pool_t *request_pool;
 pool_t *request_data_pool;
@@ -71,6 +74,30 @@ pool_t *dupreq_pool;
 
 static struct fridgethr *worker_fridge;
 
+/* Seconds between samples of the worker pool load */
+#define WORKER_ADJUST_DELAY 1
+/* Busy samples in a row before the pool grows */
+#define WORKER_GROW_TICKS 2
+/* Quiet samples in a row before the pool shrinks */
+#define WORKER_SHRINK_TICKS 30
+
+/**
+ * @brief State of the worker pool sizing
+ */
+
+static struct worker_pool {
+	bool adaptive;		/*< Min_Worker and Max_Worker differ */
+	uint32_t min;		/*< Fewest workers */
+	uint32_t max;		/*< Most workers */
+	uint64_t qwait_ns;	/*< Queue wait summed since last sample */
+	uint64_t qwait_reqs;	/*< Requests summed in qwait_ns */
+	uint32_t busy_ticks;	/*< Busy samples in a row */
+	uint32_t quiet_ticks;	/*< Quiet samples in a row */
+	struct worker_pool_stats last;	/*< Last sample */
+} worker_pool;
+
+static struct fridgethr *worker_ctl_fridge;
+
 const nfs_function_desc_t invalid_funcdesc = {
 	.service_function = nfs_null,
 	.free_function = nfs_null_free,
@@ -694,14 +721,335 @@ const nfs_function_desc_t *nfs_rpc_get_funcdesc(nfs_request_data_t *reqnfs)
 	return funcdesc;
 }
 
+/**
+ * @brief Request state saved while a request waits on asynchronous I/O
+ *
+ * The request context normally lives on the worker's stack.  When a
+ * service function suspends the request, the context is moved here so
+ * that whichever worker picks the request up again can restore it.
+ */
+
+struct nfs_async_req {
+	int32_t pending;	/*< Completion and suspension, requeued at 0 */
+	nfs_async_resume_t resume;	/*< Continuation of the service
+					    function */
+	void *arg;		/*< Argument for resume */
+	request_data_t *req;	/*< The suspended request */
+	dupreq_status_t dpq_status;	/*< From nfs_dupreq_start */
+	struct req_op_context req_ctx;
+	struct user_cred creds;
+	struct export_perms export_perms;
+	sockaddr_t hostaddr;
+};
+
+/**
+ * @brief Prepare to suspend the current request on asynchronous I/O
+ *
+ * A service function calls this before starting an I/O whose
+ * completion callback will call nfs_rpc_async_done.  Once the I/O is
+ * started the service function returns nfs_rpc_async_wait(), and
+ * resume is called later, on some worker and with the request context
+ * restored, to fill in the result.  If the I/O could not be started,
+ * nfs_rpc_async_cancel undoes this call.
+ *
+ * @param[in] worker Worker running the service function
+ * @param[in] resume Continuation of the service function
+ * @param[in] arg    Argument for resume
+ *
+ * @return The handle to give nfs_rpc_async_done, or NULL if the
+ *         request must be processed synchronously.
+ */
+
+struct nfs_async_req *nfs_rpc_async_start(nfs_worker_data_t *worker,
+					  nfs_async_resume_t resume,
+					  void *arg)
+{
+	struct nfs_async_req *async;
+
+	assert(worker->async == NULL);
+
+	async = gsh_malloc(sizeof(*async));
+	if (async == NULL)
+		return NULL;
+
+	async->pending = 2;
+	async->resume = resume;
+	async->arg = arg;
+	async->req = NULL;
+	worker->async = async;
+
+	return async;
+}
+
+/**
+ * @brief Abandon a suspension whose I/O was not started
+ *
+ * @param[in] worker Worker running the service function
+ */
+
+void nfs_rpc_async_cancel(nfs_worker_data_t *worker)
+{
+	gsh_free(worker->async);
+	worker->async = NULL;
+}
+
+/**
+ * @brief Suspend the request, unless its I/O has already completed
+ *
+ * An FSAL without asynchronous I/O completes inline; the request then
+ * goes on synchronously instead of taking a trip through the queue.
+ *
+ * @param[in]  worker Worker running the service function
+ * @param[out] res    Result of the request
+ *
+ * @return NFS_REQ_ASYNC_WAIT, or the result of resume.
+ */
+
+int nfs_rpc_async_wait(nfs_worker_data_t *worker, nfs_res_t *res)
+{
+	struct nfs_async_req *async = worker->async;
+	int rc;
+
+	/* Only the completion can have dropped pending to 1, and once it
+	 * has it no longer touches async. */
+	if (atomic_fetch_int32_t(&async->pending) == 2)
+		return NFS_REQ_ASYNC_WAIT;
+
+	rc = async->resume(async->arg, res);
+	nfs_rpc_async_cancel(worker);
+	return rc;
+}
+
+/**
+ * @brief Signal that the I/O a request waits on has completed
+ *
+ * Called from the completion callback, on any thread.  The request
+ * is queued again once both this and the suspension have happened.
+ *
+ * @param[in] async Handle from nfs_rpc_async_start
+ */
+
+void nfs_rpc_async_done(struct nfs_async_req *async)
+{
+	if (atomic_dec_int32_t(&async->pending) == 0)
+		nfs_rpc_enqueue_req(async->req);
+}
+
+/**
+ * @brief Move the request context off the worker's stack
+ *
+ * @param[in] req         The request being suspended
+ * @param[in] worker_data Worker that ran the service function
+ * @param[in] dpq_status  Status from nfs_dupreq_start
+ */
+
+static void nfs_rpc_suspend(request_data_t *req,
+			    nfs_worker_data_t *worker_data,
+			    dupreq_status_t dpq_status)
+{
+	struct nfs_async_req *async = worker_data->async;
+
+	worker_data->async = NULL;
+
+	async->req = req;
+	async->dpq_status = dpq_status;
+	async->req_ctx = *op_ctx;
+	async->creds = *op_ctx->creds;
+	async->export_perms = *op_ctx->export_perms;
+	async->hostaddr = *op_ctx->caller_addr;
+	async->req_ctx.creds = &async->creds;
+	async->req_ctx.export_perms = &async->export_perms;
+	async->req_ctx.caller_addr = &async->hostaddr;
+	req->r_u.nfs->async = async;
+
+	LogFullDebug(COMPONENT_DISPATCH,
+		     "Suspended rpc_xid=%u", req->r_u.nfs->req.rq_xid);
+
+	/* The references and credentials now belong to async */
+	SetClientIP(NULL);
+	op_ctx = NULL;
+
+	nfs_rpc_async_done(async);
+}
+
+/**
+ * @brief Send the reply to a request, or drop it
+ *
+ * @param[in] req        The request
+ * @param[in] rc         Return from the service function
+ * @param[in] dpq_status Status from nfs_dupreq_start
+ * @param[in] client_ip  Client address for logging
+ */
+
+static void nfs_rpc_reply(request_data_t *req, int rc,
+			  dupreq_status_t dpq_status, const char *client_ip)
+{
+	nfs_request_data_t *reqnfs = req->r_u.nfs;
+	struct svc_req *svcreq = &reqnfs->req;
+	SVCXPRT *xprt = reqnfs->xprt;
+	nfs_res_t *res_nfs = reqnfs->res_nfs;
+	bool slocked = false;
+
+/* NFSv4 stats are handled in nfs4_compound()
+ */
+	if (svcreq->rq_prog != nfs_param.core_param.program[P_NFS]
+	    || svcreq->rq_vers != NFS_V4)
+		server_stats_nfs_done(req, rc, false);
+
+	/* If request is dropped, no return to the client */
+	if (rc == NFS_REQ_DROP) {
+		/* The request was dropped */
+		LogDebug(COMPONENT_DISPATCH,
+			 "Drop request rpc_xid=%u, program %u, version %u, function %u",
+			 svcreq->rq_xid, (int)svcreq->rq_prog,
+			 (int)svcreq->rq_vers, (int)svcreq->rq_proc);
+
+		/* If the request is not normally cached, then the entry
+		 * will be removed later.  We only remove a reply that is
+		 * normally cached that has been dropped.
+		 */
+		if (nfs_dupreq_delete(svcreq) != DUPREQ_SUCCESS) {
+			LogCrit(COMPONENT_DISPATCH,
+				"Attempt to delete duplicate request failed on line %d",
+				__LINE__);
+		}
+		goto out;
+	} else {
+		LogFullDebug(COMPONENT_DISPATCH,
+			     "Before svc_sendreply on socket %d", xprt->xp_fd);
+
+		DISP_SLOCK(xprt);
+
+		if (unlikely(nfs_trace_enabled) && req->trace_id != 0)
+			nfs_trace_encode(req);
+
+		/* encoding the result on xdr output */
+		if (svc_sendreply(
+			    xprt, svcreq, reqnfs->funcdesc->xdr_encode_func,
+		     (caddr_t) res_nfs) == false) {
+			LogDebug(COMPONENT_DISPATCH,
+				 "NFS DISPATCHER: FAILURE: Error while calling "
+				 "svc_sendreply on a new request. rpcxid=%u "
+				 "socket=%d function:%s client:%s program:%d "
+				 "nfs version:%d proc:%d xid:%u errno: %d",
+				 svcreq->rq_xid, xprt->xp_fd,
+				 reqnfs->funcdesc->funcname,
+				 client_ip,
+				 (int)svcreq->rq_prog, (int)svcreq->rq_vers,
+				 (int)svcreq->rq_proc, svcreq->rq_xid, errno);
+			if (xprt->xp_type != XPRT_UDP)
+				svc_destroy(xprt);
+			goto out;
+		}
+
+		LogFullDebug(COMPONENT_DISPATCH,
+			     "After svc_sendreply on socket %d", xprt->xp_fd);
+
+	}			/* rc == NFS_REQ_DROP */
+
+	/* Finish any request not already deleted */
+	if (dpq_status == DUPREQ_SUCCESS)
+		(void)nfs_dupreq_finish(svcreq, res_nfs);
+
+ out:
+	DISP_SUNLOCK(xprt);
+
+	if (unlikely(nfs_trace_enabled) && req->trace_id != 0) {
+		struct nfs_trace_rec *rec;
+
+		rec = nfs_trace_emit(req->trace_id, NFS_TRACE_SEND,
+				     svcreq->rq_proc);
+		if (rec != NULL)
+			rec->status = rc;
+	}
+}
+
+/**
+ * @brief Release the arguments and credentials of a request
+ *
+ * @param[in] req The request
+ */
+
+static void nfs_rpc_free_args(request_data_t *req)
+{
+	nfs_request_data_t *reqnfs = req->r_u.nfs;
+
+	clean_credentials();
+
+	/* Free the allocated resources once the work is done */
+	/* Free the arguments */
+	if ((reqnfs->req.rq_vers == 2) || (reqnfs->req.rq_vers == 3)
+	    || (reqnfs->req.rq_vers == 4)) {
+		if (!SVC_FREEARGS
+		    (reqnfs->xprt, reqnfs->funcdesc->xdr_decode_func,
+		     (caddr_t) &reqnfs->arg_nfs)) {
+			LogCrit(COMPONENT_DISPATCH,
+				"NFS DISPATCHER: FAILURE: Bad SVC_FREEARGS for %s",
+				reqnfs->funcdesc->funcname);
+		}
+	}
+
+	/* Finalize the request. */
+	if (reqnfs->res_nfs)
+		nfs_dupreq_rele(&reqnfs->req, reqnfs->funcdesc);
+}
+
+/**
+ * @brief Drop the references held by the request context
+ */
+
+static void nfs_rpc_put_ctx(void)
+{
+	SetClientIP(NULL);
+	if (op_ctx->client != NULL)
+		put_gsh_client(op_ctx->client);
+	if (op_ctx->export != NULL)
+		put_gsh_export(op_ctx->export);
+	op_ctx = NULL;
+}
+
+/**
+ * @brief Resume a request suspended on asynchronous I/O
+ *
+ * @param[in,out] req         The request
+ * @param[in,out] worker_data Worker thread context
+ */
+
+static void nfs_rpc_resume(request_data_t *req,
+			   nfs_worker_data_t *worker_data)
+{
+	nfs_request_data_t *reqnfs = req->r_u.nfs;
+	struct nfs_async_req *async = reqnfs->async;
+	const char *client_ip = "<unknown client>";
+	int rc;
+
+	reqnfs->async = NULL;
+	op_ctx = &async->req_ctx;
+	if (op_ctx->client != NULL) {
+		SetClientIP(op_ctx->client->hostaddr_str);
+		client_ip = op_ctx->client->hostaddr_str;
+	}
+
+	LogFullDebug(COMPONENT_DISPATCH,
+		     "Resuming rpc_xid=%u", reqnfs->req.rq_xid);
+
+	rc = async->resume(async->arg, reqnfs->res_nfs);
+	nfs_rpc_reply(req, rc, async->dpq_status, client_ip);
+	nfs_rpc_free_args(req);
+	nfs_rpc_put_ctx();
+	gsh_free(async);
+}
+
 /**
  * @brief Main RPC dispatcher routine
  *
  * @param[in,out] req         NFS request
  * @param[in,out] worker_data Worker thread context
  *
+ * @return true if the request was suspended on asynchronous I/O, and
+ *         will be resumed and released by another worker.
  */
-static void nfs_rpc_execute(request_data_t *req,
+static bool nfs_rpc_execute(request_data_t *req,
 			    nfs_worker_data_t *worker_data)
 {
 	nfs_request_data_t *reqnfs = req->r_u.nfs;
@@ -736,6 +1084,7 @@ static void nfs_rpc_execute(request_data_t *req,
 	op_ctx->nfs_vers = svcreq->rq_vers;
 	op_ctx->req_type = req->rtype;
 	op_ctx->export_perms = &export_perms;
+	op_ctx->trace_id = req->trace_id;
 
 	/* Initialized user_credentials */
 	init_credentials();
@@ -791,6 +1140,7 @@ static void nfs_rpc_execute(request_data_t *req,
 	op_ctx->queue_wait =
 	    op_ctx->start_time - timespec_diff(&ServerBootTime,
 					       &req->time_queued);
+	worker_note_qwait(op_ctx->queue_wait);
 
 	/* If req is uncacheable, or if req is v41+, nfs_dupreq_start will do
 	 * nothing but allocate a result object and mark the request (ie, the
@@ -1260,64 +1610,11 @@ static void nfs_rpc_execute(request_data_t *req,
 	}
 
  req_error:
-
-/* NFSv4 stats are handled in nfs4_compound()
- */
-	if (svcreq->rq_prog != nfs_param.core_param.program[P_NFS]
-	    || svcreq->rq_vers != NFS_V4)
-		server_stats_nfs_done(req, rc, false);
-
-	/* If request is dropped, no return to the client */
-	if (rc == NFS_REQ_DROP) {
-		/* The request was dropped */
-		LogDebug(COMPONENT_DISPATCH,
-			 "Drop request rpc_xid=%u, program %u, version %u, function %u",
-			 svcreq->rq_xid, (int)svcreq->rq_prog,
-			 (int)svcreq->rq_vers, (int)svcreq->rq_proc);
-
-		/* If the request is not normally cached, then the entry
-		 * will be removed later.  We only remove a reply that is
-		 * normally cached that has been dropped.
-		 */
-		if (nfs_dupreq_delete(svcreq) != DUPREQ_SUCCESS) {
-			LogCrit(COMPONENT_DISPATCH,
-				"Attempt to delete duplicate request failed on line %d",
-				__LINE__);
-		}
-		goto freeargs;
-	} else {
-		LogFullDebug(COMPONENT_DISPATCH,
-			     "Before svc_sendreply on socket %d", xprt->xp_fd);
-
-		DISP_SLOCK(xprt);
-
-		/* encoding the result on xdr output */
-		if (svc_sendreply(
-			    xprt, svcreq, reqnfs->funcdesc->xdr_encode_func,
-		     (caddr_t) res_nfs) == false) {
-			LogDebug(COMPONENT_DISPATCH,
-				 "NFS DISPATCHER: FAILURE: Error while calling "
-				 "svc_sendreply on a new request. rpcxid=%u "
-				 "socket=%d function:%s client:%s program:%d "
-				 "nfs version:%d proc:%d xid:%u errno: %d",
-				 svcreq->rq_xid, xprt->xp_fd,
-				 reqnfs->funcdesc->funcname,
-				 client_ip,
-				 (int)svcreq->rq_prog, (int)svcreq->rq_vers,
-				 (int)svcreq->rq_proc, svcreq->rq_xid, errno);
-			if (xprt->xp_type != XPRT_UDP)
-				svc_destroy(xprt);
-			goto freeargs;
-		}
-
-		LogFullDebug(COMPONENT_DISPATCH,
-			     "After svc_sendreply on socket %d", xprt->xp_fd);
-
-	}			/* rc == NFS_REQ_DROP */
-
-	/* Finish any request not already deleted */
-	if (dpq_status == DUPREQ_SUCCESS)
-		dpq_status = nfs_dupreq_finish(svcreq, res_nfs);
+	if (rc == NFS_REQ_ASYNC_WAIT) {
+		nfs_rpc_suspend(req, worker_data, dpq_status);
+		return true;
+	}
+	nfs_rpc_reply(req, rc, dpq_status, client_ip);
 	goto freeargs;
 
  handle_err:
@@ -1344,35 +1641,13 @@ static void nfs_rpc_execute(request_data_t *req,
 	}
 
  freeargs:
-	clean_credentials();
 	/* XXX no need for xprt slock across SVC_FREEARGS */
 	DISP_SUNLOCK(xprt);
-
-	/* Free the allocated resources once the work is done */
-	/* Free the arguments */
-	if ((reqnfs->req.rq_vers == 2) || (reqnfs->req.rq_vers == 3)
-	    || (reqnfs->req.rq_vers == 4)) {
-		if (!SVC_FREEARGS
-		    (xprt, reqnfs->funcdesc->xdr_decode_func,
-		     (caddr_t) arg_nfs)) {
-			LogCrit(COMPONENT_DISPATCH,
-				"NFS DISPATCHER: FAILURE: Bad SVC_FREEARGS for %s",
-				reqnfs->funcdesc->funcname);
-		}
-	}
-
-	/* Finalize the request. */
-	if (res_nfs)
-		nfs_dupreq_rele(svcreq, reqnfs->funcdesc);
+	nfs_rpc_free_args(req);
 
 out:
-	SetClientIP(NULL);
-	if (op_ctx->client != NULL)
-		put_gsh_client(op_ctx->client);
-	if (op_ctx->export != NULL)
-		put_gsh_export(op_ctx->export);
-	op_ctx = NULL;
-	return;
+	nfs_rpc_put_ctx();
+	return false;
 }
 
 #ifdef _USE_9P
@@ -1406,7 +1681,7 @@ static void _9p_execute(request_data_t *req, nfs_worker_data_t *worker_data)
 static void _9p_free_reqdata(struct _9p_request_data *req9p)
 {
 	if (req9p->pconn->trans_type == _9P_TCP)
-		gsh_free(req9p->_9pmsg);
+		gsh_bufpool_put(req9p->_9pmsg, _9P_MSG_SIZE);
 
 	/* decrease connection refcount */
 	atomic_dec_uint32_t(&req9p->pconn->refcount);
@@ -1434,6 +1709,18 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 	snprintf(thr_name, sizeof(thr_name), "work-%u", wd->worker_index);
 	SetNameFunction(thr_name);
 
+	/* Keep the worker, and the cache entries it allocates, on one
+	 * node. */
+	if (nfs_param.core_param.worker_numa_bind) {
+		uint32_t node = wd->worker_index % gsh_numa_node_count();
+		int rc = gsh_numa_bind_self(node);
+
+		if (rc != 0)
+			LogWarn(COMPONENT_DISPATCH,
+				"Unable to bind %s to NUMA node %u: %d",
+				thr_name, node, rc);
+	}
+
 	/* Initalize thr waitq */
 	init_wait_q_entry(&wd->wqe);
 	wd->ctx = ctx;
@@ -1477,6 +1764,8 @@ static void worker_run(struct fridgethr_context *ctx)
 		if (!nfsreq)
 			continue;
 
+		NFS_TRACE(nfsreq->trace_id, NFS_TRACE_DEQUEUE, 0);
+
 /* need to do a getpeername(2) on the socket fd before we dive into the
  * rpc_execute.  9p is messy but we do have the fd....
  */
@@ -1487,6 +1776,11 @@ static void worker_run(struct fridgethr_context *ctx)
 				"Unexpected unknown request");
 			break;
 		case NFS_REQUEST:
+			/* a suspended request whose I/O has completed */
+			if (nfsreq->r_u.nfs->async != NULL) {
+				nfs_rpc_resume(nfsreq, worker_data);
+				break;
+			}
 			/* check for destroyed xprts */
 			xu = (gsh_xprt_private_t *) nfsreq->r_u.nfs->xprt->
 			    xp_u1;
@@ -1503,7 +1797,8 @@ static void worker_run(struct fridgethr_context *ctx)
 			LogDebug(COMPONENT_DISPATCH,
 				 "NFS protocol request, nfsreq=%p xprt=%p req_cnt=%d",
 				 nfsreq, nfsreq->r_u.nfs->xprt, reqcnt);
-			nfs_rpc_execute(nfsreq, worker_data);
+			if (nfs_rpc_execute(nfsreq, worker_data))
+				continue;	/* resumed later */
 			break;
 
 		case NFS_CALL:
@@ -1550,14 +1845,169 @@ static void worker_run(struct fridgethr_context *ctx)
 	}
 }
 
+/**
+ * @brief Account the queue wait of a request taken by a worker
+ *
+ * @param[in] qwait Time the request spent queued
+ */
+
+void worker_note_qwait(nsecs_elapsed_t qwait)
+{
+	if (!worker_pool.adaptive)
+		return;
+
+	(void)atomic_add_uint64_t(&worker_pool.qwait_ns, qwait);
+	(void)atomic_inc_uint64_t(&worker_pool.qwait_reqs);
+}
+
+/**
+ * @brief Grow or shrink the worker pool
+ *
+ * Run every WORKER_ADJUST_DELAY seconds.  A sample is busy when
+ * requests are queued with no worker free to take them and either
+ * they waited longer than Worker_Qwait_Target on average or most
+ * workers are stuck in the FSAL.  It is quiet when nothing is queued,
+ * a quarter of the workers are waiting for work and the queue wait is
+ * under half the target.  The pool grows by a quarter after
+ * WORKER_GROW_TICKS busy samples in a row and gives back half its
+ * idle workers after WORKER_SHRINK_TICKS quiet ones, so it answers a
+ * burst quickly but does not shed threads it will want again soon.
+ *
+ * @param[in] ctx Thread context
+ */
+
+static void worker_adjust(struct fridgethr_context *ctx)
+{
+	struct worker_pool *wp = ctx->arg;
+	struct worker_pool_stats *last = &wp->last;
+	uint32_t target = nfs_param.core_param.worker_qwait_target;
+	uint64_t qwait_ns, qwait_reqs;
+	uint32_t n;
+	bool busy, quiet;
+
+	SetNameFunction("work_ctl");
+
+	qwait_ns = atomic_postclear_uint64_t_bits(&wp->qwait_ns, UINT64_MAX);
+	qwait_reqs = atomic_postclear_uint64_t_bits(&wp->qwait_reqs,
+						    UINT64_MAX);
+
+	last->threads = fridgethr_nthreads(worker_fridge);
+	last->idle = atomic_fetch_uint32_t(&nfs_req_st.reqs.waiters);
+	last->fsal_busy = atomic_fetch_uint32_t(&cache_inode_fsal_busy);
+	last->backlog = nfs_rpc_outstanding_reqs();
+	last->qwait_us = qwait_reqs ? qwait_ns / qwait_reqs / 1000 : 0;
+
+	busy = last->backlog > 0 && last->idle == 0
+	    && (last->qwait_us >= target
+		|| last->fsal_busy * 4 >= last->threads * 3);
+	quiet = last->backlog == 0 && last->idle > last->threads / 4
+	    && last->qwait_us < target / 2;
+
+	if (busy) {
+		wp->quiet_ticks = 0;
+		if (++wp->busy_ticks < WORKER_GROW_TICKS
+		    || last->threads >= wp->max)
+			return;
+		wp->busy_ticks = 0;
+
+		n = MAX(last->threads / 4, 1);
+		n = MIN(n, wp->max - last->threads);
+		if (fridgethr_grow(worker_fridge, worker_run, NULL, n) != 0)
+			return;
+		last->grown += n;
+		LogInfo(COMPONENT_DISPATCH,
+			"Adding %u workers to %u, %u requests queued %u us, %u in FSAL",
+			n, last->threads, last->backlog, last->qwait_us,
+			last->fsal_busy);
+	} else if (quiet) {
+		wp->busy_ticks = 0;
+		if (++wp->quiet_ticks < WORKER_SHRINK_TICKS)
+			return;
+		wp->quiet_ticks = 0;
+
+		n = fridgethr_shrink(worker_fridge, MAX(last->idle / 2, 1));
+		if (n == 0)
+			return;
+		last->shrunk += n;
+		LogInfo(COMPONENT_DISPATCH,
+			"Retiring %u of %u workers, %u idle", n,
+			last->threads, last->idle);
+	} else {
+		wp->busy_ticks = 0;
+		wp->quiet_ticks = 0;
+	}
+}
+
+/**
+ * @brief Report the worker pool size and load
+ *
+ * @param[out] stats Filled in from the last sample
+ */
+
+void worker_pool_stats(struct worker_pool_stats *stats)
+{
+	uint32_t ix;
+
+	*stats = worker_pool.last;
+	stats->min = worker_pool.min;
+	stats->max = worker_pool.max;
+	stats->threads = fridgethr_nthreads(worker_fridge);
+	if (!worker_pool.adaptive) {
+		/* Nothing samples a fixed pool */
+		stats->idle = atomic_fetch_uint32_t(&nfs_req_st.reqs.waiters);
+		stats->fsal_busy =
+		    atomic_fetch_uint32_t(&cache_inode_fsal_busy);
+		stats->backlog = nfs_rpc_outstanding_reqs();
+	}
+
+	stats->steals = 0;
+	for (ix = 0; ix < nfs_req_st.shard.nshards; ++ix)
+		stats->steals +=
+		    atomic_fetch_uint64_t(&nfs_req_st.shard.shards[ix].steals);
+	stats->overflows = atomic_fetch_uint64_t(&nfs_req_st.shard.overflows);
+}
+
+/**
+ * @brief Work out the bounds of the worker pool
+ *
+ * Min_Worker and Max_Worker default to Nb_Worker, and Nb_Worker, the
+ * size the pool starts at, is kept between them.
+ */
+
+static void worker_pool_bounds(void)
+{
+	struct nfs_core_param *core = &nfs_param.core_param;
+	uint32_t min = core->min_worker ? core->min_worker : core->nb_worker;
+	uint32_t max = core->max_worker ? core->max_worker : core->nb_worker;
+
+	if (min > core->nb_worker) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Min_Worker %u is above Nb_Worker %u, using %u",
+			min, core->nb_worker, core->nb_worker);
+		min = core->nb_worker;
+	}
+	if (max < core->nb_worker) {
+		LogWarn(COMPONENT_DISPATCH,
+			"Max_Worker %u is below Nb_Worker %u, using %u",
+			max, core->nb_worker, core->nb_worker);
+		max = core->nb_worker;
+	}
+
+	worker_pool.min = min;
+	worker_pool.max = max;
+	worker_pool.adaptive = min != max;
+}
+
 int worker_init(void)
 {
 	struct fridgethr_params frp;
 	int rc = 0;
 
+	worker_pool_bounds();
+
 	memset(&frp, 0, sizeof(struct fridgethr_params));
-	frp.thr_max = nfs_param.core_param.nb_worker;
-	frp.thr_min = nfs_param.core_param.nb_worker;
+	frp.thr_max = worker_pool.max;
+	frp.thr_min = worker_pool.min;
 	frp.flavor = fridgethr_flavor_looper;
 	frp.thread_initialize = worker_thread_initializer;
 	frp.thread_finalize = worker_thread_finalizer;
@@ -1571,21 +2021,63 @@ int worker_init(void)
 		return rc;
 	}
 
+	/* Start with the minimum, then grow to Nb_Worker */
 	rc = fridgethr_populate(worker_fridge, worker_run, NULL);
+	if (rc == 0 && nfs_param.core_param.nb_worker > worker_pool.min)
+		rc = fridgethr_grow(worker_fridge, worker_run, NULL,
+				    nfs_param.core_param.nb_worker -
+				    worker_pool.min);
 
 	if (rc != 0) {
 		LogMajor(COMPONENT_DISPATCH,
 			 "Unable to populate worker fridge: %d", rc);
+		return rc;
 	}
 
-	return rc;
+	if (!worker_pool.adaptive)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 1;
+	frp.thr_min = 1;
+	frp.thread_delay = WORKER_ADJUST_DELAY;
+	frp.flavor = fridgethr_flavor_looper;
+
+	rc = fridgethr_init(&worker_ctl_fridge, "Wrk_Ctl", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Unable to initialize worker pool fridge: %d", rc);
+		return rc;
+	}
+
+	rc = fridgethr_submit(worker_ctl_fridge, worker_adjust, &worker_pool);
+	if (rc != 0) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Unable to start worker pool thread: %d", rc);
+		return rc;
+	}
+
+	LogEvent(COMPONENT_DISPATCH,
+		 "Worker pool sized between %u and %u threads, starting at %u",
+		 worker_pool.min, worker_pool.max,
+		 nfs_param.core_param.nb_worker);
+
+	return 0;
 }
 
 int worker_shutdown(void)
 {
-	int rc = fridgethr_sync_command(worker_fridge,
-					fridgethr_comm_stop,
-					120);
+	int rc;
+
+	/* Stop resizing before taking the workers down */
+	if (worker_ctl_fridge != NULL) {
+		rc = fridgethr_sync_command(worker_ctl_fridge,
+					    fridgethr_comm_stop, 120);
+		if (rc == ETIMEDOUT)
+			fridgethr_cancel(worker_ctl_fridge);
+	}
+
+	rc = fridgethr_sync_command(worker_fridge, fridgethr_comm_stop, 120);
 
 	if (rc == ETIMEDOUT) {
 		LogMajor(COMPONENT_DISPATCH,
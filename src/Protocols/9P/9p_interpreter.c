@@ -42,6 +42,7 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "server_stats.h"
+#include "gsh_bufpool.h"
 
 /* opcode to function array */
 const struct _9p_function_desc _9pfuncdesc[] = {
@@ -123,7 +124,17 @@ void _9p_tcp_process_request(struct _9p_request_data *req9p,
 {
 	u32 outdatalen = 0;
 	int rc = 0;
-	char replydata[_9P_MSG_SIZE];
+	char *replydata;
+
+	/* TREAD fills the reply in place, so this is its payload buffer */
+	replydata = gsh_bufpool_get(_9P_MSG_SIZE);
+	if (replydata == NULL) {
+		LogMajor(COMPONENT_9P,
+			 "Could not allocate 9P reply on socket #%lu",
+			 req9p->pconn->trans_data.sockfd);
+		_9p_DiscardFlushHook(req9p);
+		return;
+	}
 
 	rc = _9p_process_buffer(req9p, worker_data, replydata, &outdatalen);
 	if (rc != 1) {
@@ -137,6 +148,7 @@ void _9p_tcp_process_request(struct _9p_request_data *req9p,
 				 "Could not send 9P/TCP reply correclty on socket #%lu",
 				 req9p->pconn->trans_data.sockfd);
 	}
+	gsh_bufpool_put(replydata, _9P_MSG_SIZE);
 	_9p_DiscardFlushHook(req9p);
 	return;
 }				/* _9p_process_request */
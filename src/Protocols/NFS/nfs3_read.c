@@ -47,16 +47,20 @@
 #include "nfs_convert.h"
 #include "server_stats.h"
 #include "export_mgr.h"
+#include "gsh_bufpool.h"
 
-static void nfs_read_ok(struct svc_req *req,
-			nfs_res_t *res,
-			char *data, uint32_t read_size, cache_entry_t *entry,
+static void nfs_read_ok(nfs_res_t *res,
+			struct gsh_iobuf *iob, cache_entry_t *entry,
 			int eof)
 {
-	if ((read_size == 0) && (data != NULL)) {
-		gsh_free(data);
-		data = NULL;
+	uint32_t read_size = 0;
+
+	if (iob != NULL && iob->len == 0) {
+		gsh_iobuf_put(iob);
+		iob = NULL;
 	}
+	if (iob != NULL)
+		read_size = iob->len;
 
 	/* Build Post Op Attributes */
 	nfs_SetPostOpAttr(entry,
@@ -64,12 +68,164 @@ static void nfs_read_ok(struct svc_req *req,
 
 	res->res_read3.READ3res_u.resok.eof = eof;
 	res->res_read3.READ3res_u.resok.count = read_size;
-	res->res_read3.READ3res_u.resok.data.data_val = data;
+	res->res_read3.READ3res_u.resok.data.data_val =
+	    iob != NULL ? iob->addr : NULL;
 	res->res_read3.READ3res_u.resok.data.data_len = read_size;
+	res->res_read3.READ3res_u.resok.data_iob = iob;
 
 	res->res_read3.status = NFS3_OK;
 }
 
+/**
+ * @brief Fill in the result of a READ once the data are in
+ *
+ * @param[in]  entry        File read
+ * @param[out] res          Result
+ * @param[in]  cache_status Status of the read
+ * @param[in]  iob          Data read, consumed
+ * @param[in]  eof          Whether the read reached end of file
+ *
+ * @return NFS_REQ_OK or NFS_REQ_DROP.
+ */
+
+static int nfs3_read_complete(cache_entry_t *entry, nfs_res_t *res,
+			      cache_inode_status_t cache_status,
+			      struct gsh_iobuf *iob, bool eof)
+{
+	if (cache_status == CACHE_INODE_SUCCESS) {
+		nfs_read_ok(res, iob, entry, eof);
+		return NFS_REQ_OK;
+	}
+
+	if (iob != NULL)
+		gsh_iobuf_put(iob);
+
+	/* If we are here, there was an error */
+	if (nfs_RetryableError(cache_status))
+		return NFS_REQ_DROP;
+
+	res->res_read3.status = nfs3_Errno(cache_status);
+
+	nfs_SetPostOpAttr(entry,
+			  &res->res_read3.READ3res_u.resfail.file_attributes);
+
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief State of a READ suspended on asynchronous I/O
+ */
+
+struct nfs3_read_async {
+	struct fsal_io_arg io;
+	struct gsh_iobuf *iob;		/*< Payload being read into */
+	cache_entry_t *entry;		/*< Reference held until resume */
+	struct nfs_async_req *async;
+	fsal_status_t fsal_status;	/*< From the completion */
+	uint64_t trace_id;		/*< Of the request, for the callback */
+};
+
+static void nfs3_read_cb(struct fsal_obj_handle *obj_hdl,
+			 fsal_status_t ret, struct fsal_io_arg *io_arg,
+			 void *caller_arg)
+{
+	struct nfs3_read_async *rd = caller_arg;
+
+	cache_inode_fsal_async_done(rd->trace_id, NFS_TRACE_FSAL_READ);
+	rd->fsal_status = ret;
+	nfs_rpc_async_done(rd->async);
+}
+
+static int nfs3_read_resume(void *arg, nfs_res_t *res)
+{
+	struct nfs3_read_async *rd = arg;
+	cache_inode_status_t cache_status;
+	size_t read_size = 0;
+	int rc;
+
+	cache_status = cache_inode_rdwr_async_done(rd->entry,
+						   CACHE_INODE_READ,
+						   &rd->io, NULL,
+						   rd->fsal_status);
+	if (cache_status == CACHE_INODE_SUCCESS) {
+		read_size = rd->io.io_amount;
+		rd->iob->len = read_size;
+	}
+
+	rc = nfs3_read_complete(rd->entry, res, cache_status, rd->iob,
+				rd->io.end_of_file);
+
+	cache_inode_put(rd->entry);
+	server_stats_io_done(rd->io.io_length, read_size,
+			     (rc == NFS_REQ_OK) ? true : false,
+			     false);
+	gsh_free(rd);
+	return rc;
+}
+
+/**
+ * @brief Start a READ on asynchronous I/O
+ *
+ * @param[in]  entry  File to read, the reference passes to the I/O
+ * @param[in]  offset Position to read from
+ * @param[in]  size   Bytes to read
+ * @param[in]  worker Worker thread data
+ * @param[out] res    Result, if the read completed at once
+ * @param[out] rc     Return for the service function
+ *
+ * @return false if the read was not started and should be done
+ *         synchronously.
+ */
+
+static bool nfs3_read_async(cache_entry_t *entry, uint64_t offset,
+			    size_t size, nfs_worker_data_t *worker,
+			    nfs_res_t *res, int *rc)
+{
+	struct nfs3_read_async *rd;
+	cache_inode_status_t cache_status;
+
+	rd = gsh_malloc(sizeof(*rd));
+	if (rd == NULL)
+		return false;
+
+	rd->iob = gsh_bufpool_iobuf(size);
+	if (rd->iob == NULL) {
+		gsh_free(rd);
+		return false;
+	}
+
+	rd->async = nfs_rpc_async_start(worker, nfs3_read_resume, rd);
+	if (rd->async == NULL) {
+		gsh_iobuf_put(rd->iob);
+		gsh_free(rd);
+		return false;
+	}
+
+	rd->entry = entry;
+	rd->trace_id = op_ctx->trace_id;
+	rd->io.offset = offset;
+	rd->io.io_length = size;
+	rd->io.buffer = rd->iob->addr;
+
+	cache_status = cache_inode_rdwr_async(entry, CACHE_INODE_READ,
+					      &rd->io, NULL, nfs3_read_cb, rd);
+	if (cache_status != CACHE_INODE_SUCCESS) {
+		nfs_rpc_async_cancel(worker);
+		gsh_iobuf_put(rd->iob);
+		gsh_free(rd);
+		*rc = nfs3_read_complete(entry, res, cache_status, NULL,
+					 false);
+		cache_inode_put(entry);
+		server_stats_io_done(size, 0,
+				     (*rc == NFS_REQ_OK) ? true : false,
+				     false);
+		return true;
+	}
+
+	*rc = nfs_rpc_async_wait(worker, res);
+	return true;
+}
+
 /**
  *
  * @brief The NFSPROC3_READ
@@ -98,10 +254,9 @@ int nfs3_read(nfs_arg_t *arg,
 	size_t size = 0;
 	size_t read_size = 0;
 	uint64_t offset = 0;
-	void *data = NULL;
+	struct gsh_iobuf *iob = NULL;
 	bool eof_met = false;
 	int rc = NFS_REQ_OK;
-	bool sync = false;
 
 	if (isDebug(COMPONENT_NFSPROTO)) {
 		char str[LEN_FH_STR];
@@ -123,6 +278,7 @@ int nfs3_read(nfs_arg_t *arg,
 	res->res_read3.READ3res_u.resok.count = 0;
 	res->res_read3.READ3res_u.resok.data.data_val = NULL;
 	res->res_read3.READ3res_u.resok.data.data_len = 0;
+	res->res_read3.READ3res_u.resok.data_iob = NULL;
 	res->res_read3.status = NFS3_OK;
 	entry = nfs3_FhandleToCache(&arg->arg_read3.file,
 				    &res->res_read3.status, &rc);
@@ -207,46 +363,26 @@ int nfs3_read(nfs_arg_t *arg,
 	}
 
 	if (size == 0) {
-		nfs_read_ok(req, res, NULL, 0, entry, 0);
+		nfs_read_ok(res, NULL, entry, 0);
 		rc = NFS_REQ_OK;
 		goto out;
-	} else {
-		data = gsh_malloc(size);
-		if (data == NULL) {
-			rc = NFS_REQ_DROP;
-			goto out;
-		}
-
-		cache_status = cache_inode_rdwr(entry,
-						CACHE_INODE_READ,
-						offset,
-						size,
-						&read_size,
-						data,
-						&eof_met,
-						&sync);
-
-		if (cache_status == CACHE_INODE_SUCCESS) {
-			nfs_read_ok(req, res, data, read_size,
-				    entry, eof_met);
-			rc = NFS_REQ_OK;
-			goto out;
-		}
-		gsh_free(data);
-	}
-
-	/* If we are here, there was an error */
-	if (nfs_RetryableError(cache_status)) {
-		rc = NFS_REQ_DROP;
-		goto out;
 	}
 
-	res->res_read3.status = nfs3_Errno(cache_status);
+	/* Where the FSAL really completes reads asynchronously, the
+	 * reply is sent, and the entry released, when the read
+	 * completes.  Elsewhere the FSAL reads into a payload the reply
+	 * takes as is. */
+	if (op_ctx->fsal_export->ops->fs_supports(op_ctx->fsal_export,
+						  fso_async_io) &&
+	    nfs3_read_async(entry, offset, size, worker, res, &rc))
+		return rc;
 
-	nfs_SetPostOpAttr(entry,
-			  &res->res_read3.READ3res_u.resfail.file_attributes);
+	cache_status = cache_inode_read_iobuf(entry, offset, size,
+					      &iob, &eof_met);
+	if (cache_status == CACHE_INODE_SUCCESS)
+		read_size = iob->len;
 
-	rc = NFS_REQ_OK;
+	rc = nfs3_read_complete(entry, res, cache_status, iob, eof_met);
 
  out:
 	/* return references */
@@ -269,7 +405,7 @@ int nfs3_read(nfs_arg_t *arg,
 void nfs3_read_free(nfs_res_t *res)
 {
 	if ((res->res_read3.status == NFS3_OK)
-	    && (res->res_read3.READ3res_u.resok.data.data_len != 0)) {
-		gsh_free(res->res_read3.READ3res_u.resok.data.data_val);
+	    && (res->res_read3.READ3res_u.resok.data_iob != NULL)) {
+		gsh_iobuf_put(res->res_read3.READ3res_u.resok.data_iob);
 	}
 }
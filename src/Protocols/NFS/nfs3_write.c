@@ -50,6 +50,170 @@
 #include "server_stats.h"
 #include "export_mgr.h"
 
+/**
+ * @brief Fill in the result of a WRITE once the data are out
+ *
+ * @param[in]  entry        File written
+ * @param[out] res          Result
+ * @param[in]  cache_status Status of the write
+ * @param[in]  written_size Bytes written
+ * @param[in]  sync         Whether the write was stable
+ *
+ * @return NFS_REQ_OK or NFS_REQ_DROP.
+ */
+
+static int nfs3_write_complete(cache_entry_t *entry, nfs_res_t *res,
+			       cache_inode_status_t cache_status,
+			       size_t written_size, bool sync)
+{
+	if (cache_status == CACHE_INODE_SUCCESS) {
+		/* Build Weak Cache Coherency data */
+		nfs_SetWccData(NULL, entry,
+			       &res->res_write3.WRITE3res_u.resok.file_wcc);
+
+		/* Set the written size */
+		res->res_write3.WRITE3res_u.resok.count = written_size;
+
+		/* How do we commit data ? */
+		if (sync)
+			res->res_write3.WRITE3res_u.resok.committed =
+			    FILE_SYNC;
+		else
+			res->res_write3.WRITE3res_u.resok.committed =
+			    UNSTABLE;
+
+		/* Set the write verifier */
+		memcpy(res->res_write3.WRITE3res_u.resok.verf,
+		       NFS3_write_verifier,
+		       sizeof(writeverf3));
+
+		res->res_write3.status = NFS3_OK;
+
+		return NFS_REQ_OK;
+	}
+
+	LogFullDebug(COMPONENT_NFSPROTO,
+		     "failed write: cache_status=%s",
+		     cache_inode_err_str(cache_status));
+
+	/* If we are here, there was an error */
+	if (nfs_RetryableError(cache_status))
+		return NFS_REQ_DROP;
+
+	res->res_write3.status = nfs3_Errno(cache_status);
+
+	nfs_SetWccData(NULL, entry,
+		       &res->res_write3.WRITE3res_u.resfail.file_wcc);
+
+	return NFS_REQ_OK;
+}
+
+/**
+ * @brief State of a WRITE suspended on asynchronous I/O
+ */
+
+struct nfs3_write_async {
+	struct fsal_io_arg io;
+	cache_entry_t *entry;		/*< Reference held until resume */
+	struct nfs_async_req *async;
+	fsal_status_t fsal_status;	/*< From the completion */
+	uint64_t trace_id;		/*< Of the request, for the callback */
+	bool sync;			/*< Stable asked for, then done */
+};
+
+static void nfs3_write_cb(struct fsal_obj_handle *obj_hdl,
+			  fsal_status_t ret, struct fsal_io_arg *io_arg,
+			  void *caller_arg)
+{
+	struct nfs3_write_async *wr = caller_arg;
+
+	cache_inode_fsal_async_done(wr->trace_id, NFS_TRACE_FSAL_WRITE);
+	wr->fsal_status = ret;
+	nfs_rpc_async_done(wr->async);
+}
+
+static int nfs3_write_resume(void *arg, nfs_res_t *res)
+{
+	struct nfs3_write_async *wr = arg;
+	cache_inode_status_t cache_status;
+	int rc;
+
+	cache_status = cache_inode_rdwr_async_done(wr->entry,
+						   CACHE_INODE_WRITE,
+						   &wr->io, &wr->sync,
+						   wr->fsal_status);
+
+	rc = nfs3_write_complete(wr->entry, res, cache_status,
+				 wr->io.io_amount, wr->sync);
+
+	cache_inode_put(wr->entry);
+	server_stats_io_done(wr->io.io_length, wr->io.io_amount,
+			     (rc == NFS_REQ_OK) ? true : false,
+			     true);
+	gsh_free(wr);
+	return rc;
+}
+
+/**
+ * @brief Start a WRITE on asynchronous I/O
+ *
+ * @param[in]  entry  File to write, the reference passes to the I/O
+ * @param[in]  offset Position to write at
+ * @param[in]  size   Bytes to write
+ * @param[in]  data   Data to write, alive until the request is freed
+ * @param[in]  sync   Whether the write should be stable
+ * @param[in]  worker Worker thread data
+ * @param[out] res    Result, if the write completed at once
+ * @param[out] rc     Return for the service function
+ *
+ * @return false if the write was not started and should be done
+ *         synchronously.
+ */
+
+static bool nfs3_write_async(cache_entry_t *entry, uint64_t offset,
+			     size_t size, void *data, bool sync,
+			     nfs_worker_data_t *worker,
+			     nfs_res_t *res, int *rc)
+{
+	struct nfs3_write_async *wr;
+	cache_inode_status_t cache_status;
+
+	wr = gsh_malloc(sizeof(*wr));
+	if (wr == NULL)
+		return false;
+
+	wr->async = nfs_rpc_async_start(worker, nfs3_write_resume, wr);
+	if (wr->async == NULL) {
+		gsh_free(wr);
+		return false;
+	}
+
+	wr->entry = entry;
+	wr->trace_id = op_ctx->trace_id;
+	wr->sync = sync;
+	wr->io.offset = offset;
+	wr->io.io_length = size;
+	wr->io.buffer = data;
+
+	cache_status = cache_inode_rdwr_async(entry, CACHE_INODE_WRITE,
+					      &wr->io, &wr->sync,
+					      nfs3_write_cb, wr);
+	if (cache_status != CACHE_INODE_SUCCESS) {
+		nfs_rpc_async_cancel(worker);
+		gsh_free(wr);
+		*rc = nfs3_write_complete(entry, res, cache_status, 0,
+					  false);
+		cache_inode_put(entry);
+		server_stats_io_done(size, 0,
+				     (*rc == NFS_REQ_OK) ? true : false,
+				     true);
+		return true;
+	}
+
+	*rc = nfs_rpc_async_wait(worker, res);
+	return true;
+}
+
 /**
  *
  * @brief The NFSPROC3_WRITE
@@ -218,58 +382,27 @@ int nfs3_write(nfs_arg_t *arg,
 	}
 
 	if (size == 0) {
-		cache_status = CACHE_INODE_SUCCESS;
-		written_size = 0;
-	} else {
-		/* An actual write is to be made, prepare it */
-		cache_status =
-		    cache_inode_rdwr(entry, CACHE_INODE_WRITE, offset, size,
-				     &written_size, data, &eof_met, &sync);
-		if (cache_status == CACHE_INODE_SUCCESS) {
-			/* Build Weak Cache Coherency data */
-			nfs_SetWccData(NULL, entry,
-				       &res->res_write3.WRITE3res_u.resok.
-				       file_wcc);
-
-			/* Set the written size */
-			res->res_write3.WRITE3res_u.resok.count = written_size;
-
-			/* How do we commit data ? */
-			if (sync)
-				res->res_write3.WRITE3res_u.resok.committed =
-				    FILE_SYNC;
-			else
-				res->res_write3.WRITE3res_u.resok.committed =
-				    UNSTABLE;
-
-			/* Set the write verifier */
-			memcpy(res->res_write3.WRITE3res_u.resok.verf,
-			       NFS3_write_verifier,
-			       sizeof(writeverf3));
-
-			res->res_write3.status = NFS3_OK;
-
-			rc = NFS_REQ_OK;
-			goto out;
-		}
-	}
-
-	LogFullDebug(COMPONENT_NFSPROTO,
-		     "failed write: cache_status=%s",
-		     cache_inode_err_str(cache_status));
-
-	/* If we are here, there was an error */
-	if (nfs_RetryableError(cache_status)) {
-		rc = NFS_REQ_DROP;
+		rc = nfs3_write_complete(entry, res, CACHE_INODE_SUCCESS, 0,
+					 sync);
 		goto out;
 	}
 
-	res->res_write3.status = nfs3_Errno(cache_status);
-
-	nfs_SetWccData(NULL, entry,
-		       &res->res_write3.WRITE3res_u.resfail.file_wcc);
-
-	rc = NFS_REQ_OK;
+	/* Where the FSAL really completes writes asynchronously, the
+	 * reply is sent, and the entry released, when the write
+	 * completes */
+	if (op_ctx->fsal_export->ops->fs_supports(op_ctx->fsal_export,
+						  fso_async_io) &&
+	    nfs3_write_async(entry, offset, size, data, sync, worker,
+			     res, &rc))
+		return rc;
+
+	/* An actual write is to be made, prepare it */
+	cache_status =
+	    cache_inode_rdwr(entry, CACHE_INODE_WRITE, offset, size,
+			     &written_size, data, &eof_met, &sync);
+
+	rc = nfs3_write_complete(entry, res, cache_status, written_size,
+				 sync);
 
  out:
 	/* return references */
@@ -48,6 +48,7 @@
 #include "fsal_pnfs.h"
 #include "server_stats.h"
 #include "export_mgr.h"
+#include "gsh_bufpool.h"
 
 /**
  * @brief Read on a pNFS pNFS data server
@@ -70,8 +71,8 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 	READ4res * const res_READ4 = &resp->nfs_resop4_u.opread;
 	/* NFSv4 return code */
 	nfsstat4 nfs_status = 0;
-	/* Buffer into which data is to be read */
-	void *buffer = NULL;
+	/* Payload into which data is to be read */
+	struct gsh_iobuf *iob = NULL;
 	/* End of file flag */
 	bool eof = false;
 
@@ -87,14 +88,15 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Construct the FSAL file handle */
 
-	buffer = gsh_malloc_aligned(4096, arg_READ4->count);
-	if (buffer == NULL) {
+	iob = gsh_bufpool_iobuf(arg_READ4->count);
+	if (iob == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate read buffer");
 		res_READ4->status = NFS4ERR_SERVERFAULT;
 		return res_READ4->status;
 	}
 
-	res_READ4->READ4res_u.resok4.data.data_val = buffer;
+	res_READ4->READ4res_u.resok4.data.data_val = iob->addr;
+	res_READ4->READ4res_u.resok4.data.data_iob = iob;
 
 	nfs_status = data->current_ds->ops->read(
 				data->current_ds,
@@ -107,8 +109,9 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 				&eof);
 
 	if (nfs_status != NFS4_OK) {
-		gsh_free(buffer);
+		gsh_iobuf_put(iob);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
+		res_READ4->READ4res_u.resok4.data.data_iob = NULL;
 	}
 
 	if (eof)
@@ -220,6 +223,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	uint64_t offset = 0;
 	bool eof_met = false;
 	void *bufferdata = NULL;
+	struct gsh_iobuf *iob = NULL;
 	cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
 	state_t *state_found = NULL;
 	state_t *state_open = NULL;
@@ -235,6 +239,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	/* Say we are managing NFS4_OP_READ */
 	resp->resop = NFS4_OP_READ;
 	res_READ4->status = NFS4_OK;
+	res_READ4->READ4res_u.resok4.data.data_iob = NULL;
 
 	/* Do basic checks on a filehandle Only files can be read */
 
@@ -445,35 +450,51 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 		goto done;
 	}
 
-	/* Some work is to be done */
-	bufferdata = gsh_malloc_aligned(4096, size);
-
-	if (bufferdata == NULL) {
-		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate bufferdata");
-		res_READ4->status = NFS4ERR_SERVERFAULT;
-		goto done;
-	}
-
 	if (!anonymous && data->minorversion == 0) {
 		op_ctx->clientid =
 		    &state_found->state_owner->so_owner.so_nfs4_owner.
 		    so_clientid;
 	}
 
-	cache_status =
-	    cache_inode_rdwr_plus(entry, io, offset, size, &read_size,
-				  bufferdata, &eof_met, &sync, info);
+	if (io == CACHE_INODE_READ) {
+		/* Plain reads take the payload the FSAL hands back and
+		 * attach it to the reply as is. */
+		cache_status = cache_inode_read_iobuf(entry, offset, size,
+						      &iob, &eof_met);
+		if (cache_status == CACHE_INODE_SUCCESS) {
+			read_size = iob->len;
+			bufferdata = iob->addr;
+		}
+	} else {
+		bufferdata = gsh_malloc_aligned(4096, size);
+
+		if (bufferdata == NULL) {
+			LogEvent(COMPONENT_NFS_V4,
+				 "FAILED to allocate bufferdata");
+			res_READ4->status = NFS4ERR_SERVERFAULT;
+			goto done;
+		}
+
+		cache_status =
+		    cache_inode_rdwr_plus(entry, io, offset, size, &read_size,
+					  bufferdata, &eof_met, &sync, info);
+		if (cache_status != CACHE_INODE_SUCCESS)
+			gsh_free(bufferdata);
+	}
+
 	if (cache_status != CACHE_INODE_SUCCESS) {
 		res_READ4->status = nfs4_Errno(cache_status);
-		gsh_free(bufferdata);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 		goto done;
 	}
 
-	if (cache_inode_size(entry, &file_size) !=
-	    CACHE_INODE_SUCCESS) {
+	cache_status = cache_inode_size(entry, &file_size);
+	if (cache_status != CACHE_INODE_SUCCESS) {
 		res_READ4->status = nfs4_Errno(cache_status);
-		gsh_free(bufferdata);
+		if (iob != NULL)
+			gsh_iobuf_put(iob);
+		else
+			gsh_free(bufferdata);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 		goto done;
 	}
@@ -483,6 +504,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 
 	res_READ4->READ4res_u.resok4.data.data_len = read_size;
 	res_READ4->READ4res_u.resok4.data.data_val = bufferdata;
+	res_READ4->READ4res_u.resok4.data.data_iob = iob;
 
 	LogFullDebug(COMPONENT_NFS_V4,
 		     "NFS4_OP_READ: offset = %" PRIu64
@@ -541,10 +563,13 @@ void nfs4_op_read_Free(nfs_resop4 *res)
 {
 	READ4res *resp = &res->nfs_resop4_u.opread;
 
-	if (resp->status == NFS4_OK)
-		if (resp->READ4res_u.resok4.data.data_val != NULL)
-			gsh_free(resp->READ4res_u.resok4.data.data_val);
-	return;
+	if (resp->status != NFS4_OK)
+		return;
+
+	if (resp->READ4res_u.resok4.data.data_iob != NULL)
+		gsh_iobuf_put(resp->READ4res_u.resok4.data.data_iob);
+	else if (resp->READ4res_u.resok4.data.data_val != NULL)
+		gsh_free(resp->READ4res_u.resok4.data.data_val);
 }				/* nfs4_op_read_Free */
 
 /**
@@ -4018,6 +4018,26 @@ int nfs4_Fattr_To_FSAL_attr(struct attrlist *FSAL_attr, fattr4 *Fattr,
 	return Fattr4_To_FSAL_attr(FSAL_attr, Fattr, NULL, NULL, data);
 }
 
+/**
+ * @brief Convert NFSv4 attributes that may carry a filehandle
+ *
+ * Same as nfs4_Fattr_To_FSAL_attr, but a FATTR4_FILEHANDLE attribute
+ * is decoded into hdl4, whose nfs_fh4_val must point to NFS4_FHSIZE
+ * bytes.  hdl4->nfs_fh4_len is left alone if Fattr has no filehandle.
+ *
+ * @param[out]    FSAL_attr FSAL attributes
+ * @param[in,out] hdl4      Filehandle
+ * @param[in]     Fattr     NFSv4 attributes
+ *
+ * @return NFS4_OK if successful, NFS4ERR codes if not.
+ */
+int nfs4_Fattr_To_FSAL_attr_fh(struct attrlist *FSAL_attr, nfs_fh4 *hdl4,
+			       fattr4 *Fattr)
+{
+	memset(FSAL_attr, 0, sizeof(struct attrlist));
+	return Fattr4_To_FSAL_attr(FSAL_attr, Fattr, hdl4, NULL, NULL);
+}
+
 /**
  *
  * nfs4_Fattr_To_fsinfo: Decode filesystem info out of NFSv4 attributes.
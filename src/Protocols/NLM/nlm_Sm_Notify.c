@@ -54,6 +54,9 @@ int nlm4_Sm_Notify(nfs_arg_t *args,
 		 "REQUEST PROCESSING: Calling nlm4_sm_notify for %s",
 		 arg->name);
 
+	/* A host that rebooted has no locks left to reclaim */
+	nlm_reclaim_complete(arg->name);
+
 	nsm_client = get_nsm_client(CARE_NOT, NULL, arg->name);
 
 	if (nsm_client != NULL) {
@@ -29,6 +29,7 @@
 #include "ganesha_rpc.h"
 #include "nsm.h"
 #include "sal_data.h"
+#include "sal_functions.h"
 
 pthread_mutex_t nsm_mutex = PTHREAD_MUTEX_INITIALIZER;
 CLIENT *nsm_clnt;
@@ -164,6 +165,9 @@ bool nsm_monitor(state_nsm_client_t *host)
 
 	pthread_mutex_unlock(&nsm_mutex);
 	pthread_mutex_unlock(&host->ssc_mutex);
+
+	/* The caller's reference keeps host around */
+	nfs4_recov_nsm_monitor(host->ssc_nlm_caller_name);
 	return true;
 }
 
@@ -236,6 +240,8 @@ bool nsm_unmonitor(state_nsm_client_t *host)
 
 	pthread_mutex_unlock(&nsm_mutex);
 	pthread_mutex_unlock(&host->ssc_mutex);
+
+	nfs4_recov_nsm_unmonitor(host->ssc_nlm_caller_name);
 	return true;
 }
 
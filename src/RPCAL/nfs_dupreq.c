@@ -50,6 +50,7 @@
 #include "nfs_dupreq.h"
 #include "city.h"
 #include "abstract_mem.h"
+#include "abstract_atomic.h"
 #include "gsh_intrinsic.h"
 #include "wait_queue.h"
 
@@ -73,18 +74,66 @@ const char *dupreq_state_table[] = {
 	"DUPREQ_DELETED",
 };
 
+/**
+ * @brief Recycle queue of one partition of the recycle tree
+ *
+ * Protected by the mutex of the matching rbtree_x partition, so
+ * connections hashing to different partitions never contend.
+ */
+struct drc_recycle_q {
+	TAILQ_HEAD(drc_st_tailq, drc) q;	/* fifo */
+	int32_t qlen;
+	time_t last_expire_check;
+};
+
 struct drc_st {
-	pthread_mutex_t mtx;
 	drc_t udp_drc;		/* shared DRC */
 	struct rbtree_x tcp_drc_recycle_t;
-	 TAILQ_HEAD(drc_st_tailq, drc) tcp_drc_recycle_q;	/* fifo */
-	int32_t tcp_drc_recycle_qlen;
-	time_t last_expire_check;
+	struct drc_recycle_q *recycle_q;	/* one per partition */
 	uint32_t expire_delta;
+	uint64_t budget;	/* cached entries allowed, 0 for no limit */
+	uint64_t tcp_drcs;	/* per-connection DRCs allocated */
 };
 
 static struct drc_st *drc_st;
 
+/**
+ * @brief Counters, sharded by request hash to keep them off one line
+ */
+
+#define DRC_COUNTER_SHARDS 16
+
+struct drc_counters {
+	uint64_t hits;
+	uint64_t in_progress;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t entries;
+	CACHE_PAD(0);
+};
+
+static struct drc_counters drc_counters[DRC_COUNTER_SHARDS];
+
+static inline struct drc_counters *drc_counters_of(uint64_t hk)
+{
+	return &drc_counters[hk % DRC_COUNTER_SHARDS];
+}
+
+/* What a cached request costs against DRC_Memory_Budget, not counting
+ * any result data hanging off the nfs_res_t */
+#define DRC_ENTRY_COST (sizeof(dupreq_entry_t) + sizeof(nfs_res_t))
+
+static inline struct drc_part *drc_part_of(drc_t *drc,
+					   struct rbtree_x_part *t)
+{
+	return &drc->part[t - drc->xt.tree];
+}
+
+static inline struct drc_recycle_q *drc_recycle_q_of(struct rbtree_x_part *t)
+{
+	return &drc_st->recycle_q[t - drc_st->tcp_drc_recycle_t.tree];
+}
+
 /**
  * @brief Comparison function for duplicate request entries.
  *
@@ -215,6 +264,30 @@ static inline int drc_recycle_cmpf(const struct opr_rbtree_node *lhs,
 		&lk->d_u.tcp.addr, &rk->d_u.tcp.addr, false);
 }
 
+/**
+ * @brief Set up the per-partition retire state of a DRC
+ *
+ * @param[in,out] drc The DRC, with npart, maxsize and hiwat set
+ *
+ * @return 0 on success, ENOMEM otherwise.
+ */
+static int init_drc_parts(drc_t *drc)
+{
+	int ix;
+
+	drc->part = gsh_calloc(drc->npart, sizeof(struct drc_part));
+	if (unlikely(!drc->part))
+		return ENOMEM;
+
+	for (ix = 0; ix < drc->npart; ++ix)
+		TAILQ_INIT(&drc->part[ix].dupreq_q);
+
+	drc->part_maxsize = MAX(drc->maxsize / drc->npart, 1);
+	drc->part_hiwat = MAX(drc->hiwat / drc->npart, 1);
+
+	return 0;
+}
+
 /**
  * @brief Initialize a shared duplicate request cache
  */
@@ -225,7 +298,7 @@ static inline void init_shared_drc()
 
 	drc->type = DRC_UDP_V234;
 	drc->refcnt = 0;
-	drc->retwnd = 0;
+	drc->flags = DRC_FLAG_NONE;
 	drc->d_u.tcp.recycle_time = 0;
 	drc->maxsize = nfs_param.core_param.drc.udp.size;
 	drc->cachesz = nfs_param.core_param.drc.udp.cachesz;
@@ -241,7 +314,9 @@ static inline void init_shared_drc()
 	assert(!code);
 
 	/* completed requests */
-	TAILQ_INIT(&drc->dupreq_q);
+	if (init_drc_parts(drc) != 0)
+		LogFatal(COMPONENT_INIT,
+			 "Error while allocating UDP DRC partitions");
 
 	/* init closed-form "cache" partition */
 	for (ix = 0; ix < drc->npart; ++ix) {
@@ -266,7 +341,7 @@ static inline void init_shared_drc()
  */
 void dupreq2_pkginit(void)
 {
-	int code __attribute__ ((unused)) = 0;
+	int ix, code __attribute__ ((unused)) = 0;
 
 	dupreq_pool = pool_init("Duplicate Request Pool",
 				sizeof(dupreq_entry_t),
@@ -285,14 +360,14 @@ void dupreq2_pkginit(void)
 	tcp_drc_pool = pool_init("TCP DRC Pool", sizeof(drc_t),
 				 pool_basic_substrate,
 				 NULL, NULL, NULL);
-	if (!(dupreq_pool))
+	if (!(tcp_drc_pool))
 		LogFatal(COMPONENT_INIT,
 			 "Error while allocating duplicate request pool");
 
 	drc_st = gsh_calloc(1, sizeof(struct drc_st));
-
-	/* init shared statics */
-	gsh_mutex_init(&drc_st->mtx, NULL);
+	if (unlikely(!drc_st))
+		LogFatal(COMPONENT_INIT,
+			 "Error while allocating DRC state");
 
 	/* recycle_t */
 	code =
@@ -301,11 +376,20 @@ void dupreq2_pkginit(void)
 		      RBT_X_FLAG_ALLOC);
 	/* XXX error? */
 
-	/* init recycle_q */
-	TAILQ_INIT(&drc_st->tcp_drc_recycle_q);
-	drc_st->tcp_drc_recycle_qlen = 0;
-	drc_st->last_expire_check = time(NULL);
+	/* init recycle_q, one per partition of recycle_t */
+	drc_st->recycle_q =
+	    gsh_calloc(nfs_param.core_param.drc.tcp.recycle_npart,
+		       sizeof(struct drc_recycle_q));
+	if (unlikely(!drc_st->recycle_q))
+		LogFatal(COMPONENT_INIT,
+			 "Error while allocating DRC recycle queues");
+	for (ix = 0; ix < nfs_param.core_param.drc.tcp.recycle_npart; ++ix) {
+		TAILQ_INIT(&drc_st->recycle_q[ix].q);
+		drc_st->recycle_q[ix].last_expire_check = time(NULL);
+	}
 	drc_st->expire_delta = nfs_param.core_param.drc.tcp.recycle_expire_s;
+	drc_st->budget =
+	    nfs_param.core_param.drc.memory_budget / DRC_ENTRY_COST;
 
 	/* UDP DRC is global, shared */
 	init_shared_drc();
@@ -368,12 +452,20 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
 
 	drc->type = dtype;	/* DRC_TCP_V3 or DRC_TCP_V4 */
 	drc->refcnt = 0;
-	drc->retwnd = 0;
+	drc->flags = DRC_FLAG_NONE;
 	drc->d_u.tcp.recycle_time = 0;
 	drc->maxsize = nfs_param.core_param.drc.tcp.size;
 	drc->cachesz = nfs_param.core_param.drc.tcp.cachesz;
 	drc->npart = nfs_param.core_param.drc.tcp.npart;
-	drc->hiwat = nfs_param.core_param.drc.udp.hiwat;
+	drc->hiwat = nfs_param.core_param.drc.tcp.hiwat;
+
+	/* completed requests */
+	if (unlikely(init_drc_parts(drc) != 0)) {
+		LogCrit(COMPONENT_DUPREQ, "alloc TCP DRC partitions failed");
+		pool_free(tcp_drc_pool, drc);
+		drc = NULL;
+		goto out;
+	}
 
 	pthread_mutex_init(&drc->mtx, NULL);
 
@@ -383,9 +475,6 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
 		      RBT_X_FLAG_ALLOC | RBT_X_FLAG_CACHE_WT);
 	assert(!code);
 
-	/* completed requests */
-	TAILQ_INIT(&drc->dupreq_q);
-
 	/* recycling DRC */
 	TAILQ_INIT_ENTRY(drc, d_u.tcp.recycle_q);
 
@@ -404,22 +493,44 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
 		}
 	}
 
+	(void)atomic_inc_uint64_t(&drc_st->tcp_drcs);
+
  out:
 	return drc;
 }
 
+static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv);
+
 /**
  * @brief Deep-free a per-connection (TCP) duplicate request cache
  *
  * @param[in] drc  The DRC to dispose
  *
  * Assumes that the DRC has been allocated from the tcp_drc_pool.
+ * Requests still cached in it are freed as well.  None of them can be
+ * in flight, since a request holds a reference on its DRC from
+ * nfs_dupreq_start to nfs_dupreq_rele.
  */
 static inline void free_tcp_drc(drc_t *drc)
 {
-	if (drc->xt.tree[0].cache)
-		gsh_free(drc->xt.tree[0].cache);
+	struct drc_part *dp;
+	dupreq_entry_t *dv;
+	int ix;
+
+	for (ix = 0; ix < drc->npart; ++ix) {
+		dp = &drc->part[ix];
+		while ((dv = TAILQ_FIRST(&dp->dupreq_q)) != NULL) {
+			TAILQ_REMOVE(&dp->dupreq_q, dv, fifo_q);
+			(void)atomic_dec_uint64_t(
+				&drc_counters_of(dv->hk)->entries);
+			nfs_dupreq_free_dupreq(dv);
+		}
+		if (drc->xt.tree[ix].cache)
+			gsh_free(drc->xt.tree[ix].cache);
+	}
+	gsh_free(drc->part);
 	pthread_mutex_destroy(&drc->mtx);
+	(void)atomic_dec_uint64_t(&drc_st->tcp_drcs);
 	LogFullDebug(COMPONENT_DUPREQ, "free TCP drc %p", drc);
 	pool_free(tcp_drc_pool, drc);
 }
@@ -433,7 +544,7 @@ static inline void free_tcp_drc(drc_t *drc)
  */
 static inline uint32_t nfs_dupreq_ref_drc(drc_t *drc)
 {
-	return ++(drc->refcnt); /* locked */
+	return atomic_inc_uint32_t(&drc->refcnt);
 }
 
 /**
@@ -445,78 +556,55 @@ static inline uint32_t nfs_dupreq_ref_drc(drc_t *drc)
  */
 static inline uint32_t nfs_dupreq_unref_drc(drc_t *drc)
 {
-	return --(drc->refcnt); /* locked */
+	return atomic_dec_uint32_t(&drc->refcnt);
 }
 
-#define DRC_ST_LOCK()				\
-	pthread_mutex_lock(&drc_st->mtx);
-
-#define DRC_ST_UNLOCK()				\
-	pthread_mutex_unlock(&drc_st->mtx);
-
 /**
- * @brief Check for expired TCP DRCs.
+ * @brief Check for expired TCP DRCs in one recycle partition.
+ *
+ * Only the partition a new connection hashed to is checked, under
+ * that partition's lock.
+ *
+ * @param[in] t The partition of the recycle tree
  */
-static inline void drc_free_expired(void)
+static inline void drc_free_expired(struct rbtree_x_part *t)
 {
+	struct drc_recycle_q *rq = drc_recycle_q_of(t);
 	drc_t *drc;
 	time_t now = time(NULL);
-	struct rbtree_x_part *t;
-	struct opr_rbtree_node *odrc = NULL;
 
-	DRC_ST_LOCK();
+	pthread_mutex_lock(&t->mtx);
 
-	if ((drc_st->tcp_drc_recycle_qlen < 1) ||
-	    (now - drc_st->last_expire_check) < 600) /* 10m */
+	if ((rq->qlen < 1) || (now - rq->last_expire_check) < 600) /* 10m */
 		goto unlock;
 
 	do {
-		drc = TAILQ_FIRST(&drc_st->tcp_drc_recycle_q);
+		drc = TAILQ_FIRST(&rq->q);
 		if (drc && (drc->d_u.tcp.recycle_time > 0)
 		    && ((now - drc->d_u.tcp.recycle_time) >
 			drc_st->expire_delta) && (drc->refcnt == 0)) {
 			LogFullDebug(COMPONENT_DUPREQ,
 				     "remove expired drc %p from "
 				     "recycle queue", drc);
-			t = rbtx_partition_of_scalar(&drc_st->tcp_drc_recycle_t,
-						     drc->d_u.tcp.hk);
-
-			odrc =
-			    opr_rbtree_lookup(&t->t, &drc->d_u.tcp.recycle_k);
-			if (!odrc) {
-				LogCrit(COMPONENT_DUPREQ,
-					"BUG: asked to dequeue DRC not on "
-					" queue");
-			} else {
-				(void)opr_rbtree_remove(&t->t,
-							&drc->d_u.tcp.
-							recycle_k);
-			}
-			TAILQ_REMOVE(&drc_st->tcp_drc_recycle_q, drc,
-				     d_u.tcp.recycle_q);
-			--(drc_st->tcp_drc_recycle_qlen);
-			/* expect DRC to be reachable from some xprt(s) */
-			pthread_mutex_lock(&drc->mtx);
-			drc->flags &= ~DRC_FLAG_RECYCLE;
-			/* but if not, dispose it */
-			if (drc->refcnt == 0) {
-				pthread_mutex_unlock(&drc->mtx);
-				free_tcp_drc(drc);
-				continue;
-			}
-			pthread_mutex_unlock(&drc->mtx);
+			(void)opr_rbtree_remove(&t->t, &drc->d_u.tcp.recycle_k);
+			TAILQ_REMOVE(&rq->q, drc, d_u.tcp.recycle_q);
+			TAILQ_INIT_ENTRY(drc, d_u.tcp.recycle_q);
+			(void)atomic_dec_int32_t(&rq->qlen);
+			/* queued DRCs are unreferenced, and with it off
+			 * the tree nobody can find it again */
+			free_tcp_drc(drc);
 		} else {
 			LogFullDebug(COMPONENT_DUPREQ,
 				     "unexpired drc %p in recycle queue "
 				     "expire check (nothing happens)", drc);
-			drc_st->last_expire_check = now;
+			rq->last_expire_check = now;
 			break;
 		}
 
 	} while (1);
 
  unlock:
-	DRC_ST_UNLOCK();
+	pthread_mutex_unlock(&t->mtx);
 }
 
 /**
@@ -531,16 +619,14 @@ nfs_dupreq_get_drc(struct svc_req *req)
 {
 	enum drc_type dtype = get_drc_type(req);
 	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) req->rq_xprt->xp_u1;
+	struct rbtree_x_part *t = NULL;
 	drc_t *drc = NULL;
-	bool drc_check_expired = false;
 
 	switch (dtype) {
 	case DRC_UDP_V234:
 		LogFullDebug(COMPONENT_DUPREQ, "ref shared UDP DRC");
 		drc = &(drc_st->udp_drc);
-		DRC_ST_LOCK();
 		(void)nfs_dupreq_ref_drc(drc);
-		DRC_ST_UNLOCK();
 		goto out;
 		break;
 	case DRC_TCP_V4:
@@ -553,7 +639,6 @@ nfs_dupreq_get_drc(struct svc_req *req)
 			pthread_mutex_lock(&drc->mtx);	/* LOCKED */
 		} else {
 			drc_t drc_k;
-			struct rbtree_x_part *t = NULL;
 			struct opr_rbtree_node *ndrc = NULL;
 			drc_t *tdrc = NULL;
 
@@ -574,19 +659,28 @@ nfs_dupreq_get_drc(struct svc_req *req)
 
 			t = rbtx_partition_of_scalar(&drc_st->tcp_drc_recycle_t,
 						     drc_k.d_u.tcp.hk);
-			DRC_ST_LOCK();
+			/* lock order is t->mtx, then drc->mtx */
+			pthread_mutex_lock(&t->mtx);
 			ndrc =
 			    opr_rbtree_lookup(&t->t, &drc_k.d_u.tcp.recycle_k);
 			if (ndrc) {
 				/* reuse old DRC */
+				struct drc_recycle_q *rq = drc_recycle_q_of(t);
+
 				tdrc =
 				    opr_containerof(ndrc, drc_t,
 						    d_u.tcp.recycle_k);
 				pthread_mutex_lock(&tdrc->mtx);	/* LOCKED */
 				if (tdrc->flags & DRC_FLAG_RECYCLE) {
-					TAILQ_REMOVE(&drc_st->tcp_drc_recycle_q,
-						     tdrc, d_u.tcp.recycle_q);
-					--(drc_st->tcp_drc_recycle_qlen);
+					if (TAILQ_IS_ENQUEUED(tdrc,
+							d_u.tcp.recycle_q)) {
+						TAILQ_REMOVE(&rq->q, tdrc,
+							d_u.tcp.recycle_q);
+						TAILQ_INIT_ENTRY(tdrc,
+							d_u.tcp.recycle_q);
+						(void)atomic_dec_int32_t(
+							&rq->qlen);
+					}
 					tdrc->flags &= ~DRC_FLAG_RECYCLE;
 				}
 				drc = tdrc;
@@ -596,6 +690,12 @@ nfs_dupreq_get_drc(struct svc_req *req)
 			}
 			if (!drc) {
 				drc = alloc_tcp_drc(dtype);
+				if (unlikely(!drc)) {
+					pthread_mutex_unlock(&t->mtx);
+					pthread_mutex_unlock(
+						&req->rq_xprt->xp_lock);
+					goto out;
+				}
 				LogFullDebug(COMPONENT_DUPREQ,
 					     "alloc new TCP DRC=%p for xprt=%p",
 					     drc, req->rq_xprt);
@@ -605,21 +705,15 @@ nfs_dupreq_get_drc(struct svc_req *req)
 				/* assign already-computed hash */
 				drc->d_u.tcp.hk = drc_k.d_u.tcp.hk;
 				pthread_mutex_lock(&drc->mtx);	/* LOCKED */
-				/* xprt ref */
-				drc->refcnt = 1;
 				/* insert dict */
 				opr_rbtree_insert(&t->t,
 						  &drc->d_u.tcp.recycle_k);
 			}
-			DRC_ST_UNLOCK();
+			pthread_mutex_unlock(&t->mtx);
 			drc->d_u.tcp.recycle_time = 0;
 			/* xprt drc */
 			(void)nfs_dupreq_ref_drc(drc);	/* xu ref */
 
-			/* try to expire unused DRCs somewhat in proportion to
-			 * new connection arrivals */
-			drc_check_expired = true;
-
 			LogFullDebug(COMPONENT_DUPREQ,
 				     "after ref drc %p refcnt==%u ", drc,
 				     drc->refcnt);
@@ -637,8 +731,10 @@ nfs_dupreq_get_drc(struct svc_req *req)
 	(void)nfs_dupreq_ref_drc(drc);
 	pthread_mutex_unlock(&drc->mtx);
 
-	if (drc_check_expired)
-		drc_free_expired();
+	/* try to expire unused DRCs somewhat in proportion to new
+	 * connection arrivals, one recycle partition at a time */
+	if (t)
+		drc_free_expired(t);
 
 out:
 	return drc;
@@ -656,6 +752,17 @@ out:
  */
 void nfs_dupreq_put_drc(SVCXPRT *xprt, drc_t *drc, uint32_t flags)
 {
+	struct rbtree_x_part *t;
+	struct drc_recycle_q *rq;
+
+	if (drc->type == DRC_UDP_V234) {
+		/* the shared DRC is never recycled */
+		(void)nfs_dupreq_unref_drc(drc);
+		if (flags & DRC_FLAG_LOCKED)
+			pthread_mutex_unlock(&drc->mtx);
+		return;
+	}
+
 	if (!(flags & DRC_FLAG_LOCKED))
 		pthread_mutex_lock(&drc->mtx);
 	/* drc LOCKED */
@@ -670,36 +777,31 @@ void nfs_dupreq_put_drc(SVCXPRT *xprt, drc_t *drc, uint32_t flags)
 
 	LogFullDebug(COMPONENT_DUPREQ, "drc %p refcnt==%u", drc, drc->refcnt);
 
-	switch (drc->type) {
-	case DRC_UDP_V234:
-		/* do nothing */
-		break;
-	case DRC_TCP_V4:
-	case DRC_TCP_V3:
-		if (drc->refcnt == 0) {
-			if (!(drc->flags & DRC_FLAG_RECYCLE)) {
-				/* note t's lock order wrt drc->mtx is
-				 * the opposite of drc->xt[*].lock */
-				drc->d_u.tcp.recycle_time = time(NULL);
-				drc->flags |= DRC_FLAG_RECYCLE;
-				pthread_mutex_unlock(&drc->mtx); /* !LOCKED */
-				DRC_ST_LOCK();
-				TAILQ_INSERT_TAIL(&drc_st->tcp_drc_recycle_q,
-						  drc, d_u.tcp.recycle_q);
-				++(drc_st->tcp_drc_recycle_qlen);
-				LogFullDebug(COMPONENT_DUPREQ,
-					     "enqueue drc %p for recycle", drc);
-				DRC_ST_UNLOCK();
-				goto out;
-			}
+	if (drc->refcnt == 0 && !(drc->flags & DRC_FLAG_RECYCLE)) {
+		drc->d_u.tcp.recycle_time = time(NULL);
+		drc->flags |= DRC_FLAG_RECYCLE;
+		pthread_mutex_unlock(&drc->mtx); /* !LOCKED */
+
+		/* t->mtx orders before drc->mtx, so retake both and
+		 * check nobody picked the DRC up in between */
+		t = rbtx_partition_of_scalar(&drc_st->tcp_drc_recycle_t,
+					     drc->d_u.tcp.hk);
+		rq = drc_recycle_q_of(t);
+		pthread_mutex_lock(&t->mtx);
+		pthread_mutex_lock(&drc->mtx);
+		if ((drc->flags & DRC_FLAG_RECYCLE) && (drc->refcnt == 0)
+		    && !TAILQ_IS_ENQUEUED(drc, d_u.tcp.recycle_q)) {
+			TAILQ_INSERT_TAIL(&rq->q, drc, d_u.tcp.recycle_q);
+			(void)atomic_inc_int32_t(&rq->qlen);
+			LogFullDebug(COMPONENT_DUPREQ,
+				     "enqueue drc %p for recycle", drc);
 		}
-	default:
-		break;
-	};
+		pthread_mutex_unlock(&drc->mtx);
+		pthread_mutex_unlock(&t->mtx);
+		return;
+	}
 
 	pthread_mutex_unlock(&drc->mtx); /* !LOCKED */
-out:
-	return;
 }
 
 /**
@@ -814,12 +916,18 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
 /**
  * @page DRC_RETIRE DRC request retire heuristic.
  *
- * We add a new, per-drc semphore like counter, retwnd.  The value of
+ * We add a new, per-partition semphore like counter, retwnd.  The value of
  * retwnd begins at 0, and is always >= 0.  The value of retwnd is increased
  * when a a duplicate req cache hit occurs.  If it was 0, it is increased by
  * some small constant, say, 16, otherwise, by 1.  And retwnd decreases by 1
  * when we successfully finish any request.  Likewise in finish, a cached
  * request may be retired iff we are above our water mark, and retwnd is 0.
+ *
+ * The water mark itself adapts to load: each partition keeps a smoothed
+ * count of new requests per second, and holds at least DRC_Retire_Window_S
+ * seconds worth of them, up to its share of the hard bound.  Independently
+ * of retwnd, requests are retired whenever the cached entries of all DRCs
+ * together exceed DRC_Memory_Budget.
  */
 
 #define RETWND_START_BIAS 16
@@ -827,54 +935,131 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
 /**
  * @brief advance retwnd.
  *
- * If (drc)->retwnd is 0, advance its value to RETWND_START_BIAS, else
+ * If (dp)->retwnd is 0, advance its value to RETWND_START_BIAS, else
  * increase its value by 1.
  *
- * @param[in] drc The duplicate request cache
+ * @param[in] dp The DRC partition
  */
-#define drc_inc_retwnd(drc)					\
+#define drc_inc_retwnd(dp)					\
 	do {							\
-		if ((drc)->retwnd == 0)				\
-			(drc)->retwnd = RETWND_START_BIAS;	\
+		if ((dp)->retwnd == 0)				\
+			(dp)->retwnd = RETWND_START_BIAS;	\
 		else						\
-			++((drc)->retwnd);			\
+			++((dp)->retwnd);			\
 	} while (0)
 
 /**
  * @brief conditionally decrement retwnd.
  *
- * If (drc)->retwnd > 0, decrease its value by 1.
+ * If (dp)->retwnd > 0, decrease its value by 1.
  *
- * @param[in] drc The duplicate request cache
+ * @param[in] dp The DRC partition
  */
-#define drc_dec_retwnd(drc)			\
+#define drc_dec_retwnd(dp)			\
 	do {					\
-		if ((drc)->retwnd > 0)		\
-			--((drc)->retwnd);	\
+		if ((dp)->retwnd > 0)		\
+			--((dp)->retwnd);	\
 	} while (0)
 
+/**
+ * @brief Account a new request in a partition's arrival rate
+ *
+ * The rate is averaged with the count of the previous second, and
+ * halved for each further second that saw no requests.
+ *
+ * @param[in] dp  The DRC partition, locked
+ * @param[in] now The current time
+ */
+static inline void drc_part_tick(struct drc_part *dp, time_t now)
+{
+	time_t gap = now - dp->tick;
+
+	if (gap != 0) {
+		dp->rate = (dp->rate + dp->count) / 2;
+		if (gap > 1)
+			dp->rate = (gap > 32) ? 0 : dp->rate >> (gap - 1);
+		dp->count = 0;
+		dp->tick = now;
+	}
+	++(dp->count);
+}
+
+/**
+ * @brief Water mark of a partition under its current load
+ *
+ * @param[in] drc The duplicate request cache
+ * @param[in] dp  The DRC partition
+ *
+ * @return The number of requests the partition should keep.
+ */
+static inline uint32_t drc_part_hiwat(drc_t *drc, struct drc_part *dp)
+{
+	uint64_t want = (uint64_t) dp->rate *
+	    nfs_param.core_param.drc.retire_window_s;
+
+	if (want > drc->part_maxsize)
+		want = drc->part_maxsize;
+
+	return MAX(drc->part_hiwat, (uint32_t) want);
+}
+
+/**
+ * @brief Check the global memory budget
+ *
+ * The shard of the calling request is checked first; only if it is
+ * past its share are the other shards read.
+ *
+ * @param[in] ctr The counter shard of the calling request
+ *
+ * @return true if cached requests exceed DRC_Memory_Budget.
+ */
+static inline bool drc_over_budget(struct drc_counters *ctr)
+{
+	uint64_t entries = 0;
+	int ix;
+
+	if (drc_st->budget == 0)
+		return false;
+
+	if (atomic_fetch_uint64_t(&ctr->entries) * DRC_COUNTER_SHARDS <=
+	    drc_st->budget)
+		return false;
+
+	for (ix = 0; ix < DRC_COUNTER_SHARDS; ++ix)
+		entries += atomic_fetch_uint64_t(&drc_counters[ix].entries);
+
+	return entries > drc_st->budget;
+}
+
 /**
  * @brief retire request predicate.
  *
  * Calculate whether a request may be retired from the provided duplicate
- * request cache.
+ * request cache partition.
  *
  * @param[in] drc The duplicate request cache
+ * @param[in] dp  The DRC partition, locked
+ * @param[in] ctr The counter shard of the calling request
  *
  * @return true if a request may be retired, else false.
  */
-static inline bool drc_should_retire(drc_t *drc)
+static inline bool drc_should_retire(drc_t *drc, struct drc_part *dp,
+				     struct drc_counters *ctr)
 {
 	/* do not exeed the hard bound on cache size */
-	if (unlikely(drc->size > drc->maxsize))
+	if (unlikely(dp->size > drc->part_maxsize))
+		return true;
+
+	/* nor the memory budget shared by all DRCs */
+	if (unlikely(drc_over_budget(ctr)))
 		return true;
 
 	/* otherwise, are we permitted to retire requests */
-	if (unlikely(drc->retwnd > 0))
+	if (unlikely(dp->retwnd > 0))
 		return false;
 
-	/* finally, retire if drc->size is above intended high water mark */
-	if (unlikely(drc->size > drc->hiwat))
+	/* finally, retire if dp->size is above intended high water mark */
+	if (unlikely(dp->size > drc_part_hiwat(drc, dp)))
 		return true;
 
 	return false;
@@ -905,6 +1090,10 @@ static inline bool nfs_dupreq_v4_cacheable(nfs_request_data_t *nfs_req)
  * creates one in the START state.  On any non-error return, the refcnt
  * of the corresponding entry is incremented.
  *
+ * A request given a cache entry also keeps a reference on the DRC,
+ * dropped by nfs_dupreq_rele, so that the DRC cannot be freed while
+ * the request still points into it.
+ *
  * @param[in] nfs_req The NFS request data
  * @param[in] req     The request to be cached
  *
@@ -917,6 +1106,7 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 	dupreq_status_t status = DUPREQ_SUCCESS;
 	dupreq_entry_t *dv, *dk = NULL;
 	bool release_dk = true;
+	bool hold_drc = false;
 	nfs_res_t *res = NULL;
 	drc_t *drc;
 
@@ -946,7 +1136,7 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 				 * by the v41 slot reply cache */
 				req->rq_u1 = (void *)DUPREQ_NOCACHE;
 				res = alloc_nfs_res();
-				goto out;
+				goto put_drc;
 			}
 		}
 		break;
@@ -956,7 +1146,7 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 		if (!(nfs_req->funcdesc->dispatch_behaviour & CAN_BE_DUP)) {
 			req->rq_u1 = (void *)DUPREQ_NOCACHE;
 			res = alloc_nfs_res();
-			goto out;
+			goto put_drc;
 		}
 		break;
 	}
@@ -1000,6 +1190,11 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 		struct opr_rbtree_node *nv;
 		struct rbtree_x_part *t =
 		    rbtx_partition_of_scalar(&drc->xt, dk->hk);
+		struct drc_part *dp = drc_part_of(drc, t);
+		struct drc_counters *ctr = drc_counters_of(dk->hk);
+
+		/* the partition lock also covers dp, so requests hashing
+		 * to different partitions never share a lock */
 		pthread_mutex_lock(&t->mtx);	/* partition lock */
 		nv = rbtree_x_cached_lookup(&drc->xt, t, &dk->rbt_k, dk->hk);
 		if (nv) {
@@ -1008,15 +1203,16 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 			pthread_mutex_lock(&dv->mtx);
 			if (unlikely(dv->state == DUPREQ_START)) {
 				status = DUPREQ_BEING_PROCESSED;
+				(void)atomic_inc_uint64_t(&ctr->in_progress);
 			} else {
 				/* satisfy req from the DRC, incref,
 				   extend window */
 				res = dv->res;
-				pthread_mutex_lock(&drc->mtx);
-				drc_inc_retwnd(drc);
-				pthread_mutex_unlock(&drc->mtx);
+				drc_inc_retwnd(dp);
 				status = DUPREQ_EXISTS;
 				(dv->refcnt)++;
+				hold_drc = true;
+				(void)atomic_inc_uint64_t(&ctr->hits);
 			}
 			LogDebug(COMPONENT_DUPREQ,
 				 "dupreq hit dk=%p, dk xid=%u cksum %" PRIu64
@@ -1031,12 +1227,14 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 						     dk->hk);
 			(dk->refcnt)++;
 			/* add to q tail */
-			pthread_mutex_lock(&drc->mtx);
-			TAILQ_INSERT_TAIL(&drc->dupreq_q, dk, fifo_q);
-			++(drc->size);
-			pthread_mutex_unlock(&drc->mtx);
+			TAILQ_INSERT_TAIL(&dp->dupreq_q, dk, fifo_q);
+			++(dp->size);
+			drc_part_tick(dp, dk->timestamp);
+			(void)atomic_inc_uint64_t(&ctr->misses);
+			(void)atomic_inc_uint64_t(&ctr->entries);
 			req->rq_u1 = dk;
 			release_dk = false;
+			hold_drc = true;
 			dv = dk;
 		}
 		pthread_mutex_unlock(&t->mtx);
@@ -1052,7 +1250,10 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 	if (release_dk)
 		nfs_dupreq_free_dupreq(dk);
 
-	nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_NONE);	/* dk ref */
+ put_drc:
+	/* a request holding an entry keeps the call path ref */
+	if (!hold_drc)
+		nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_NONE);
 
  out:
 	if (res)
@@ -1075,8 +1276,9 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
  * water mark, and a windowing heuristic.  One or more requests will be
  * retired if the water mark/timeout is exceeded, and if a no duplicate
  * requests have been found in the cache in a configurable window of
- * immediately preceding requests.  A timeout may supplement the water mark,
- * in future.
+ * immediately preceding requests.  The water mark follows the request
+ * rate of the partition, see @ref DRC_RETIRE.  Only the partition of the
+ * completed request is examined, under its own lock.
  *
  * req->rq_u1 has either a magic value, or points to a duplicate request
  * cache entry allocated in nfs_dupreq_start.
@@ -1092,6 +1294,7 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	dupreq_entry_t *ov = NULL, *dv = (dupreq_entry_t *)req->rq_u1;
 	dupreq_status_t status = DUPREQ_SUCCESS;
 	struct rbtree_x_part *t;
+	struct drc_part *dp;
 	drc_t *drc = NULL;
 
 	/* do nothing if req is marked no-cache */
@@ -1110,7 +1313,9 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	pthread_mutex_unlock(&dv->mtx);
 
 	/* cond. remove from q head */
-	pthread_mutex_lock(&drc->mtx);
+	t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
+	dp = drc_part_of(drc, t);
+	pthread_mutex_lock(&t->mtx);	/* partition lock */
 
 	LogFullDebug(COMPONENT_DUPREQ,
 		     "completing dv=%p xid=%u on DRC=%p state=%s, status=%s, "
@@ -1118,45 +1323,43 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 		     dupreq_state_table[dv->state], dupreq_status_table[status],
 		     dv->refcnt);
 
-	/* ok, do the new retwnd calculation here.  then, put drc only if
-	 * we retire an entry */
-	if (drc_should_retire(drc)) {
-		/* again: */
-		ov = TAILQ_FIRST(&drc->dupreq_q);
-		if (likely(ov)) {
-			/* finished request count against retwnd */
-			drc_dec_retwnd(drc);
-			/* check refcnt */
-			if (ov->refcnt > 0) {
-				/* ov still in use, apparently */
-				goto unlock;
-			}
+	/* finished request count against retwnd */
+	drc_dec_retwnd(dp);
+
+	/* ok, do the new retwnd calculation here.  then, retire the
+	 * oldest request of this partition, unless it is still in use */
+	if (drc_should_retire(drc, dp, drc_counters_of(dv->hk))) {
+		ov = TAILQ_FIRST(&dp->dupreq_q);
+		if (likely(ov) && ov->refcnt == 0) {
 			/* remove q entry */
-			TAILQ_REMOVE(&drc->dupreq_q, ov, fifo_q);
-			--(drc->size);
+			TAILQ_REMOVE(&dp->dupreq_q, ov, fifo_q);
+			TAILQ_INIT_ENTRY(ov, fifo_q);
+			--(dp->size);
 
-			/* remove dict entry */
-			t = rbtx_partition_of_scalar(&drc->xt, ov->hk);
-			/* interlock */
-			pthread_mutex_unlock(&drc->mtx);
-			pthread_mutex_lock(&t->mtx);	/* partition lock */
+			/* remove dict entry, same partition as dp */
 			rbtree_x_cached_remove(&drc->xt, t, &ov->rbt_k, ov->hk);
-			pthread_mutex_unlock(&t->mtx);
-
-			LogDebug(COMPONENT_DUPREQ,
-				 "retiring ov=%p xid=%u on DRC=%p state=%s, "
-				 "status=%s, refcnt=%d", ov, ov->hin.tcp.rq_xid,
-				 ov->hin.drc, dupreq_state_table[dv->state],
-				 dupreq_status_table[status], ov->refcnt);
-
-			/* deep free ov */
-			nfs_dupreq_free_dupreq(ov);
-			goto out;
+		} else {
+			ov = NULL;
 		}
 	}
 
- unlock:
-	pthread_mutex_unlock(&drc->mtx);
+	pthread_mutex_unlock(&t->mtx);
+
+	if (ov) {
+		struct drc_counters *ctr = drc_counters_of(ov->hk);
+
+		(void)atomic_inc_uint64_t(&ctr->evictions);
+		(void)atomic_dec_uint64_t(&ctr->entries);
+
+		LogDebug(COMPONENT_DUPREQ,
+			 "retiring ov=%p xid=%u on DRC=%p state=%s, "
+			 "status=%s, refcnt=%d", ov, ov->hin.tcp.rq_xid,
+			 ov->hin.drc, dupreq_state_table[dv->state],
+			 dupreq_status_table[status], ov->refcnt);
+
+		/* deep free ov */
+		nfs_dupreq_free_dupreq(ov);
+	}
 
  out:
 	return status;
@@ -1183,6 +1386,7 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
 	dupreq_entry_t *dv = (dupreq_entry_t *)req->rq_u1;
 	dupreq_status_t status = DUPREQ_SUCCESS;
 	struct rbtree_x_part *t;
+	struct drc_part *dp;
 	drc_t *drc;
 
 	/* do nothing if req is marked no-cache */
@@ -1204,22 +1408,21 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
 		     dupreq_state_table[dv->state], dupreq_status_table[status],
 		     dv->refcnt);
 
-	/* XXX dv holds a ref on drc */
+	/* the request holds a ref on drc until nfs_dupreq_rele */
 	t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
 
+	dp = drc_part_of(drc, t);
+
 	pthread_mutex_lock(&t->mtx);
 	rbtree_x_cached_remove(&drc->xt, t, &dv->rbt_k, dv->hk);
 
+	if (TAILQ_IS_ENQUEUED(dv, fifo_q)) {
+		TAILQ_REMOVE(&dp->dupreq_q, dv, fifo_q);
+		TAILQ_INIT_ENTRY(dv, fifo_q);
+		--(dp->size);
+		(void)atomic_dec_uint64_t(&drc_counters_of(dv->hk)->entries);
+	}
 	pthread_mutex_unlock(&t->mtx);
-	pthread_mutex_lock(&drc->mtx);
-
-	if (TAILQ_IS_ENQUEUED(dv, fifo_q))
-		TAILQ_REMOVE(&drc->dupreq_q, dv, fifo_q);
-	--(drc->size);
-
-	/* release dv's ref and unlock */
-	nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_LOCKED);
-	/* !LOCKED */
 
  out:
 	return status;
@@ -1233,7 +1436,8 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
  *
  * In the common case, a refcnt of 0 indicates that dv is cached.  If
  * also dv->state == DUPREQ_DELETED, the request entry has been discarded
- * and should be destroyed here.
+ * and should be destroyed here.  The request's reference on the DRC
+ * is dropped last.
  *
  * @param[in] req  The svc_req structure.
  * @param[in] func The function descriptor for this request type
@@ -1241,6 +1445,7 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
 void nfs_dupreq_rele(struct svc_req *req, const nfs_function_desc_t *func)
 {
 	dupreq_entry_t *dv = (dupreq_entry_t *) req->rq_u1;
+	drc_t *drc;
 
 	/* no-cache cleanup */
 	if (dv == (void *)DUPREQ_NOCACHE) {
@@ -1258,16 +1463,20 @@ void nfs_dupreq_rele(struct svc_req *req, const nfs_function_desc_t *func)
 		     dv, dv->hin.tcp.rq_xid, dv->hin.drc,
 		     dupreq_state_table[dv->state], dv->refcnt);
 
+	/* dv may be retired as soon as its refcnt drops */
+	drc = dv->hin.drc;
 	(dv->refcnt)--;
 	if (dv->refcnt == 0) {
 		if (dv->state == DUPREQ_DELETED) {
 			pthread_mutex_unlock(&dv->mtx);
 			/* deep free */
 			nfs_dupreq_free_dupreq(dv);
+			nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_NONE);
 			return;
 		}
 	}
 	pthread_mutex_unlock(&dv->mtx);
+	nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_NONE);
 
  out:
 	/* dispose RPC header */
@@ -1283,6 +1492,36 @@ void nfs_dupreq_rele(struct svc_req *req, const nfs_function_desc_t *func)
 	return;
 }
 
+/**
+ * @brief Sum the DRC counters
+ *
+ * @param[out] stats The counters
+ */
+void nfs_dupreq_stats(struct drc_stats *stats)
+{
+	struct drc_counters *ctr;
+	int ix;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (ix = 0; ix < DRC_COUNTER_SHARDS; ++ix) {
+		ctr = &drc_counters[ix];
+		stats->hits += atomic_fetch_uint64_t(&ctr->hits);
+		stats->in_progress += atomic_fetch_uint64_t(&ctr->in_progress);
+		stats->misses += atomic_fetch_uint64_t(&ctr->misses);
+		stats->evictions += atomic_fetch_uint64_t(&ctr->evictions);
+		stats->entries += atomic_fetch_uint64_t(&ctr->entries);
+	}
+
+	if (!drc_st)
+		return;
+
+	stats->tcp_drcs = atomic_fetch_uint64_t(&drc_st->tcp_drcs);
+	for (ix = 0; ix < drc_st->tcp_drc_recycle_t.npart; ++ix)
+		stats->tcp_recycled +=
+		    atomic_fetch_int32_t(&drc_st->recycle_q[ix].qlen);
+}
+
 /**
  * @brief Shutdown the dupreq2 package.
  */
@@ -175,7 +175,7 @@ static hash_parameter_t session_id_param = {
 	.compare_key = compare_session_id,
 	.key_to_str = display_session_id_key,
 	.val_to_str = display_session_id_val,
-	.flags = HT_FLAG_CACHE,
+	.flags = HT_FLAG_OPEN_ADDR,
 };
 
 /**
@@ -34,6 +34,7 @@
 #include "nfs_core.h"
 #include "nfs4.h"
 #include "sal_functions.h"
+#include "city.h"
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <ctype.h>
@@ -50,7 +51,20 @@ char v4_old_dir[PATH_MAX + 1];
  */
 static grace_t grace;
 
+/**
+ * @brief Clients that may reclaim after the next restart, when
+ *        Recovery_Backend is db
+ */
+static struct recov_db *recov_db;
+
+/**
+ * @brief NLM hosts being monitored, kept to know which to expect
+ *        back after a restart when Early_Grace_Exit is set
+ */
+static struct recov_db *nsm_db;
+
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp);
+static void nfs4_load_recov_nsm_nolock(nfs_grace_start_t *gsp);
 static void nfs_release_nlm_state();
 static void nfs_release_v4_client(char *ip);
 
@@ -61,10 +75,183 @@ extern struct fridgethr *state_async_fridge;
  */
 void nfs4_init_grace()
 {
+	int i;
+
 	glist_init(&grace.g_clid_list);
+	for (i = 0; i < CLID_HASH_SIZE; i++)
+		glist_init(&grace.g_clid_hash[i]);
 	pthread_mutex_init(&grace.g_mutex, NULL);
 }
 
+static bool nfs4_recov_use_db(void)
+{
+	return nfs_param.nfsv4_param.recovery_backend == RECOVERY_BACKEND_DB;
+}
+
+/**
+ * @brief Name of the database standing in for a recovery directory
+ *
+ * @param[out] path    Buffer for the name
+ * @param[in]  pathlen Size of path
+ * @param[in]  dir     The directory
+ */
+static void nfs4_recov_db_path(char *path, size_t pathlen, const char *dir)
+{
+	snprintf(path, pathlen, "%s.db", dir);
+}
+
+static clid_entry_t *nfs4_find_reclaim_clid(const char *name, size_t len,
+					    bool nlm)
+{
+	uint64_t hashval = CityHash64(name, len);
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+
+	glist_for_each(node,
+		       &grace.g_clid_hash[hashval & (CLID_HASH_SIZE - 1)]) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_hash);
+		if (clid_ent->cl_hashval == hashval &&
+		    clid_ent->cl_nlm == nlm &&
+		    strncmp(clid_ent->cl_name, name, len + 1) == 0)
+			return clid_ent;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Add a client to the list of those that may reclaim
+ *
+ * Called with the grace mutex held.  A client already on the list
+ * that finished reclaiming in an earlier grace period, as when its
+ * server fails over to this one, has to reclaim again.
+ *
+ * @param[in] name Client name
+ * @param[in] nlm  Whether name is an NLM caller name
+ */
+static void nfs4_add_reclaim_clid(const char *name, bool nlm)
+{
+	size_t len = strlen(name);
+	clid_entry_t *new_ent;
+
+	new_ent = nfs4_find_reclaim_clid(name, len, nlm);
+	if (new_ent != NULL) {
+		if (new_ent->cl_reclaimed) {
+			new_ent->cl_reclaimed = false;
+			grace.g_reclaim_pending++;
+		}
+		return;
+	}
+
+	new_ent = gsh_calloc(1, sizeof(clid_entry_t) + len + 1);
+	if (new_ent == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Unable to allocate memory.");
+		return;
+	}
+	new_ent->cl_hashval = CityHash64(name, len);
+	new_ent->cl_nlm = nlm;
+	memcpy(new_ent->cl_name, name, len + 1);
+	glist_add(&grace.g_clid_list, &new_ent->cl_list);
+	glist_add(&grace.g_clid_hash[new_ent->cl_hashval &
+				     (CLID_HASH_SIZE - 1)],
+		  &new_ent->cl_hash);
+	grace.g_reclaim_pending++;
+	LogDebug(COMPONENT_CLIENTID, "added %s to clid list",
+		 new_ent->cl_name);
+}
+
+static void nfs4_add_reclaim_clid_cb(const char *name, void *arg)
+{
+	nfs4_add_reclaim_clid(name, false);
+}
+
+static void nfs4_add_reclaim_nlm_cb(const char *name, void *arg)
+{
+	nfs4_add_reclaim_clid(name, true);
+}
+
+/**
+ * @brief End the grace period if nobody is left to reclaim
+ *
+ * Called with the grace mutex held.
+ */
+static void nfs4_check_reclaim_done_nolock(void)
+{
+	time_t now;
+
+	/* Until the list is loaded for this grace period, an empty
+	 * one only means we do not know who may reclaim. */
+	if (!nfs_param.nfsv4_param.early_grace_exit ||
+	    !grace.g_reclaim_loaded || grace.g_reclaim_pending != 0)
+		return;
+
+	now = time(NULL);
+	if (grace.g_start + grace.g_duration <= now)
+		return;
+
+	LogEvent(COMPONENT_STATE,
+		 "All clients done reclaiming, ending grace %d seconds early",
+		 (int)(grace.g_start + grace.g_duration - now));
+	grace.g_duration = now - grace.g_start;
+}
+
+/**
+ * @brief Note that a client is done reclaiming
+ *
+ * Called with the grace mutex held.
+ */
+static void nfs4_reclaimed_nolock(clid_entry_t *clid_ent)
+{
+	if (clid_ent->cl_reclaimed)
+		return;
+
+	clid_ent->cl_reclaimed = true;
+	grace.g_reclaim_pending--;
+	LogDebug(COMPONENT_STATE, "%s %s done reclaiming, %u left",
+		 clid_ent->cl_nlm ? "NLM host" : "Client",
+		 clid_ent->cl_name, grace.g_reclaim_pending);
+	nfs4_check_reclaim_done_nolock();
+}
+
+/**
+ * @brief Settle the reclaim list once a grace period is over
+ *
+ * Called with the grace mutex held.  NLM hosts that never came back
+ * are no longer monitored, so they are not waited for next time.
+ */
+static void nfs4_end_reclaim_nolock(void)
+{
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+
+	glist_for_each(node, &grace.g_clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		if (clid_ent->cl_nlm && !clid_ent->cl_seen && nsm_db != NULL)
+			(void)recov_db_del(nsm_db, clid_ent->cl_name);
+		clid_ent->cl_reclaimed = true;
+	}
+	grace.g_reclaim_pending = 0;
+	grace.g_reclaim_loaded = false;
+}
+
+/**
+ * @brief Empty the list of clients that may reclaim
+ *
+ * Called with the grace mutex held.
+ */
+static void nfs4_free_reclaim_clids(void)
+{
+	struct glist_head *node, *noden;
+	clid_entry_t *clid_entry;
+
+	glist_for_each_safe(node, noden, &grace.g_clid_list) {
+		clid_entry = glist_entry(node, clid_entry_t, cl_list);
+		glist_del(&clid_entry->cl_list);
+		glist_del(&clid_entry->cl_hash);
+		gsh_free(clid_entry);
+	}
+	grace.g_reclaim_pending = 0;
+}
+
 /**
  * @brief Start grace period
  *
@@ -92,6 +279,11 @@ void nfs4_start_grace(nfs_grace_start_t *gsp)
 	 * if called from failover code and given a nodeid, then this node
 	 * is doing a take over.  read in the client ids from the failing node
 	 */
+	/* On a restart the list was loaded before, otherwise only a
+	 * takeover says who may reclaim in this grace period. */
+	if (gsp != NULL)
+		grace.g_reclaim_loaded = false;
+
 	if (gsp && gsp->event != EVENT_JUST_GRACE) {
 		LogEvent(COMPONENT_STATE,
 			 "NFS Server recovery event %d nodeid %d ip %s",
@@ -103,10 +295,14 @@ void nfs4_start_grace(nfs_grace_start_t *gsp)
 			nfs_release_nlm_state();
 			if (gsp->event == EVENT_RELEASE_IP)
 				nfs_release_v4_client(gsp->ipaddr);
-			else
+			else {
 				nfs4_load_recov_clids_nolock(gsp);
+				nfs4_load_recov_nsm_nolock(gsp);
+				grace.g_reclaim_loaded = true;
+			}
 		}
 	}
+	nfs4_check_reclaim_done_nolock();
 	pthread_mutex_unlock(&grace.g_mutex);
 }
 
@@ -132,6 +328,8 @@ int nfs_in_grace(void)
 	if (in_grace != last_grace) {
 		LogEvent(COMPONENT_STATE, "NFS Server Now %s",
 			 in_grace ? "IN GRACE" : "NOT IN GRACE");
+		if (!in_grace)
+			nfs4_end_reclaim_nolock();
 		last_grace = in_grace;
 	} else if (in_grace) {
 		LogDebug(COMPONENT_STATE, "NFS Server IN GRACE");
@@ -331,6 +529,17 @@ void nfs4_add_clid(nfs_client_id_t *clientid)
 		return;
 	}
 
+	if (nfs4_recov_use_db()) {
+		if (recov_db == NULL)
+			return;
+		err = recov_db_add(recov_db, clientid->cid_recov_dir);
+		if (err != 0)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to add client %s to recovery db, errno=%d",
+				 clientid->cid_recov_dir, err);
+		return;
+	}
+
 	/* break clientid down if it is greater than max dir name */
 	/* and create a directory hierachy to represent the clientid. */
 	snprintf(path, sizeof(path), "%s", v4_recov_dir);
@@ -384,6 +593,17 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
 	if (recov_dir == NULL)
 		return;
 
+	if (nfs4_recov_use_db()) {
+		if (recov_db == NULL)
+			return;
+		err = recov_db_del(recov_db, recov_dir);
+		if (err != 0)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to remove client %s from recovery db, errno=%d",
+				 recov_dir, err);
+		return;
+	}
+
 	len = strlen(recov_dir);
 	if (position == len)
 		return;
@@ -442,8 +662,7 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
  */
 void nfs4_chk_clid(nfs_client_id_t *clientid)
 {
-	struct glist_head *node;
-	clid_entry_t *clid_ent;
+	size_t len;
 
 	LogDebug(COMPONENT_CLIENTID, "chk for %s", clientid->cid_recov_dir);
 	if (clientid->cid_recov_dir == NULL)
@@ -462,28 +681,22 @@ void nfs4_chk_clid(nfs_client_id_t *clientid)
 	}
 
 	/*
-	 * loop through the list and try to find this client.  if we
-	 * find it, mark it to allow reclaims.  perhaps the client should
-	 * be removed from the list at this point to make the list shorter?
+	 * look this client up and, if we find it, mark it to allow
+	 * reclaims.
 	 */
-	glist_for_each(node, &grace.g_clid_list) {
-		clid_ent = glist_entry(node, clid_entry_t, cl_list);
-		LogDebug(COMPONENT_CLIENTID, "compare %s to %s",
-			 clid_ent->cl_name, clientid->cid_recov_dir);
-		if (!strncmp(clid_ent->cl_name, clientid->cid_recov_dir, PATH_MAX)) {
-			if (isDebug(COMPONENT_CLIENTID)) {
-				char str[HASHTABLE_DISPLAY_STRLEN];
+	len = strnlen(clientid->cid_recov_dir, PATH_MAX);
+	if (nfs4_find_reclaim_clid(clientid->cid_recov_dir, len, false)
+	    != NULL) {
+		if (isDebug(COMPONENT_CLIENTID)) {
+			char str[HASHTABLE_DISPLAY_STRLEN];
 
-				display_client_id_rec(clientid, str);
+			display_client_id_rec(clientid, str);
 
-				LogFullDebug(COMPONENT_CLIENTID,
-					     "Allowed to reclaim ClientId %s",
-					     str);
-			}
-			clientid->cid_allow_reclaim = 1;
-			pthread_mutex_unlock(&grace.g_mutex);
-			return;
+			LogFullDebug(COMPONENT_CLIENTID,
+				     "Allowed to reclaim ClientId %s",
+				     str);
 		}
+		clientid->cid_allow_reclaim = 1;
 	}
 	pthread_mutex_unlock(&grace.g_mutex);
 }
@@ -523,7 +736,6 @@ static int nfs4_read_recov_clids(DIR *dp,
 {
 	struct dirent *dentp;
 	DIR *subdp;
-	clid_entry_t *new_ent;
 	char *path = NULL;
 	char *new_path = NULL;
 	char *build_clid = NULL;
@@ -691,24 +903,9 @@ static int nfs4_read_recov_clids(DIR *dp,
 				cid_len = atoi(temp);
 				len = strlen(ptr2);
 				if ((len == (cid_len+2)) &&
-				    (ptr2[len-1] == ')')) {
-					new_ent =
-					    gsh_malloc(sizeof(clid_entry_t));
-					if (new_ent == NULL) {
-						LogEvent(COMPONENT_CLIENTID,
-							 "Unable to allocate memory.");
-						free_heap(path,
-							  NULL,
-							  build_clid);
-						continue;
-					}
-					strcpy(new_ent->cl_name, build_clid);
-					glist_add(&grace.g_clid_list,
-						  &new_ent->cl_list);
-					LogDebug(COMPONENT_CLIENTID,
-						 "added %s to clid list",
-						 new_ent->cl_name);
-				}
+				    (ptr2[len-1] == ')'))
+					nfs4_add_reclaim_clid(build_clid,
+							      false);
 			}
 			gsh_free(build_clid);
 			/* If this is not for takeover, remove the directory
@@ -730,6 +927,72 @@ static int nfs4_read_recov_clids(DIR *dp,
 	return num;
 }
 
+/**
+ * @brief Load clients for recovery from the databases, with no lock
+ *
+ * The same as the directory walk below: on a restart the clients of
+ * both the old and the current database may reclaim, and the current
+ * one is folded into the old one and emptied.  On a takeover the
+ * other node's database is only read.
+ *
+ * @param[in] gsp Grace period start information, NULL on a restart
+ */
+static void nfs4_load_recov_db_nolock(nfs_grace_start_t *gsp)
+{
+	struct recov_db *old_db, *src_db;
+	char path[PATH_MAX + 1];
+	int rc;
+
+	if (gsp == NULL) {
+		nfs4_free_reclaim_clids();
+		src_db = recov_db;
+	} else if (gsp->event == EVENT_UPDATE_CLIENTS) {
+		src_db = recov_db;
+	} else {
+		if (gsp->event == EVENT_TAKE_IP)
+			snprintf(path, sizeof(path), "%s/%s/%s.db",
+				 NFS_V4_RECOV_ROOT, gsp->ipaddr,
+				 NFS_V4_RECOV_DIR);
+		else if (gsp->event == EVENT_TAKE_NODEID)
+			snprintf(path, sizeof(path), "%s/%s/node%d.db",
+				 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR,
+				 gsp->nodeid);
+		else
+			return;
+
+		LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d db (%s)",
+			 gsp->nodeid, path);
+		src_db = recov_db_open(path, true);
+	}
+
+	if (src_db == NULL)
+		return;
+
+	nfs4_recov_db_path(path, sizeof(path), v4_old_dir);
+	old_db = recov_db_open(path, false);
+
+	if (gsp == NULL && old_db != NULL)
+		recov_db_foreach(old_db, nfs4_add_reclaim_clid_cb, NULL);
+	recov_db_foreach(src_db, nfs4_add_reclaim_clid_cb, NULL);
+
+	/* Only forget the current clients once the old database
+	 * durably holds them.
+	 */
+	if (old_db != NULL) {
+		rc = recov_db_merge(old_db, src_db);
+		if (rc != 0)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to save clients to %s, errno=%d",
+				 path, rc);
+		else if (gsp == NULL)
+			(void)recov_db_clear(src_db);
+		recov_db_close(old_db);
+	}
+
+	if (src_db != recov_db)
+		recov_db_close(src_db);
+}
+
 /**
  * @brief Load clients for recovery, with no lock
  *
@@ -738,23 +1001,19 @@ static int nfs4_read_recov_clids(DIR *dp,
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 {
 	DIR *dp;
-	struct glist_head *node;
-	clid_entry_t *clid_entry;
 	int rc;
 	char path[PATH_MAX + 1];
 
 	LogDebug(COMPONENT_STATE, "Load recovery cli %p", gsp);
 
+	if (nfs4_recov_use_db()) {
+		nfs4_load_recov_db_nolock(gsp);
+		return;
+	}
+
 	if (gsp == NULL) {
 		/* when not doing a takeover, start with an empty list */
-		if (!glist_empty(&grace.g_clid_list)) {
-			glist_for_each(node, &grace.g_clid_list) {
-				glist_del(node);
-				clid_entry =
-				    glist_entry(node, clid_entry_t, cl_list);
-				gsh_free(clid_entry);
-			}
-		}
+		nfs4_free_reclaim_clids();
 
 		dp = opendir(v4_old_dir);
 		if (dp == NULL) {
@@ -841,6 +1100,49 @@ static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 	}
 }
 
+/**
+ * @brief Load the NLM hosts that may reclaim, with no lock
+ *
+ * On a restart these are the hosts this node monitored; on a takeover,
+ * those the failed node monitored, from its database next to its
+ * recovery directory.
+ *
+ * @param[in] gsp Grace period start information, NULL on a restart
+ */
+static void nfs4_load_recov_nsm_nolock(nfs_grace_start_t *gsp)
+{
+	struct recov_db *src_db;
+	char path[PATH_MAX + 1];
+
+	if (!nfs_param.nfsv4_param.early_grace_exit)
+		return;
+
+	if (gsp == NULL || gsp->event == EVENT_UPDATE_CLIENTS) {
+		if (nsm_db != NULL)
+			recov_db_foreach(nsm_db, nfs4_add_reclaim_nlm_cb,
+					 NULL);
+		return;
+	}
+
+	if (gsp->event == EVENT_TAKE_IP)
+		snprintf(path, sizeof(path), "%s/%s/%s.nsm",
+			 NFS_V4_RECOV_ROOT, gsp->ipaddr, NFS_V4_RECOV_DIR);
+	else if (gsp->event == EVENT_TAKE_NODEID)
+		snprintf(path, sizeof(path), "%s/%s/node%d.nsm",
+			 NFS_V4_RECOV_ROOT, NFS_V4_RECOV_DIR, gsp->nodeid);
+	else
+		return;
+
+	src_db = recov_db_open(path, true);
+	if (src_db == NULL)
+		return;
+
+	LogEvent(COMPONENT_CLIENTID, "NLM recovery for nodeid %d db (%s)",
+		 gsp->nodeid, path);
+	recov_db_foreach(src_db, nfs4_add_reclaim_nlm_cb, NULL);
+	recov_db_close(src_db);
+}
+
 /**
  * @brief Load clients for recovery
  *
@@ -851,10 +1153,136 @@ void nfs4_load_recov_clids(nfs_grace_start_t *gsp)
 	pthread_mutex_lock(&grace.g_mutex);
 
 	nfs4_load_recov_clids_nolock(gsp);
+	nfs4_load_recov_nsm_nolock(gsp);
+	grace.g_reclaim_loaded = true;
+
+	pthread_mutex_unlock(&grace.g_mutex);
+}
+
+/**
+ * @brief Note that an NFSv4.1 client sent RECLAIM_COMPLETE
+ *
+ * NFSv4.0 has no such operation, so NFSv4.0 clients known from before
+ * the restart keep the grace period to its full length.
+ *
+ * @param[in] clientid Client record
+ */
+void nfs4_reclaim_complete(nfs_client_id_t *clientid)
+{
+	clid_entry_t *clid_ent;
 
+	if (clientid->cid_recov_dir == NULL)
+		return;
+
+	pthread_mutex_lock(&grace.g_mutex);
+	clid_ent = nfs4_find_reclaim_clid(clientid->cid_recov_dir,
+					  strnlen(clientid->cid_recov_dir,
+						  PATH_MAX),
+					  false);
+	if (clid_ent != NULL)
+		nfs4_reclaimed_nolock(clid_ent);
 	pthread_mutex_unlock(&grace.g_mutex);
 }
 
+/**
+ * @brief Note that an NLM host is done reclaiming
+ *
+ * NLM has no RECLAIM_COMPLETE, and a host may ask for new locks
+ * before it has processed our SM_NOTIFY, so there is no telling when
+ * it is done.  Only a host that rebooted, and so sent us SM_NOTIFY,
+ * is known to hold nothing to reclaim; the others keep the grace
+ * period to its full length.
+ *
+ * @param[in] caller_name Caller name of the host
+ */
+void nlm_reclaim_complete(const char *caller_name)
+{
+	clid_entry_t *clid_ent;
+
+	pthread_mutex_lock(&grace.g_mutex);
+	clid_ent = nfs4_find_reclaim_clid(caller_name, strlen(caller_name),
+					  true);
+	if (clid_ent != NULL) {
+		clid_ent->cl_seen = true;
+		nfs4_reclaimed_nolock(clid_ent);
+	}
+	pthread_mutex_unlock(&grace.g_mutex);
+}
+
+/**
+ * @brief Record that an NLM host is monitored
+ *
+ * @param[in] caller_name Caller name of the host
+ */
+void nfs4_recov_nsm_monitor(const char *caller_name)
+{
+	clid_entry_t *clid_ent;
+	int rc;
+
+	if (nsm_db == NULL)
+		return;
+
+	rc = recov_db_add(nsm_db, caller_name);
+	if (rc != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to add NLM host %s to recovery db, errno=%d",
+			 caller_name, rc);
+
+	pthread_mutex_lock(&grace.g_mutex);
+	clid_ent = nfs4_find_reclaim_clid(caller_name, strlen(caller_name),
+					  true);
+	if (clid_ent != NULL)
+		clid_ent->cl_seen = true;
+	pthread_mutex_unlock(&grace.g_mutex);
+}
+
+/**
+ * @brief Record that an NLM host is no longer monitored
+ *
+ * @param[in] caller_name Caller name of the host
+ */
+void nfs4_recov_nsm_unmonitor(const char *caller_name)
+{
+	int rc;
+
+	if (nsm_db == NULL)
+		return;
+
+	rc = recov_db_del(nsm_db, caller_name);
+	if (rc != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove NLM host %s from recovery db, errno=%d",
+			 caller_name, rc);
+}
+
+/**
+ * @brief Call a function on every client not done reclaiming
+ *
+ * @param[in] cb  Function to call, with the grace mutex held
+ * @param[in] arg Passed to cb
+ *
+ * @return Number of such clients.
+ */
+uint32_t nfs4_foreach_reclaimer(void (*cb)(const char *name, bool nlm,
+					   void *arg),
+				void *arg)
+{
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+	uint32_t pending;
+
+	pthread_mutex_lock(&grace.g_mutex);
+	glist_for_each(node, &grace.g_clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		if (!clid_ent->cl_reclaimed)
+			cb(clid_ent->cl_name, clid_ent->cl_nlm, arg);
+	}
+	pending = grace.g_reclaim_pending;
+	pthread_mutex_unlock(&grace.g_mutex);
+
+	return pending;
+}
+
 /**
  * @brief Clean up recovery directory
  */
@@ -867,6 +1295,17 @@ void nfs4_clean_old_recov_dir(char *parent_path)
 	int segment_len;
 	int total_len;
 
+	if (nfs4_recov_use_db()) {
+		char db_path[PATH_MAX + 1];
+
+		nfs4_recov_db_path(db_path, sizeof(db_path), parent_path);
+		if (unlink(db_path) == -1 && errno != ENOENT)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to remove %s, errno=%d", db_path,
+				 errno);
+		return;
+	}
+
 	dp = opendir(parent_path);
 	if (dp == NULL) {
 		LogEvent(COMPONENT_CLIENTID,
@@ -960,6 +1399,20 @@ void nfs4_create_recov_dir(void)
 				 v4_old_dir, errno);
 		}
 	}
+
+	if (nfs4_recov_use_db() && recov_db == NULL) {
+		char path[PATH_MAX + 1];
+
+		nfs4_recov_db_path(path, sizeof(path), v4_recov_dir);
+		recov_db = recov_db_open(path, false);
+	}
+
+	if (nfs_param.nfsv4_param.early_grace_exit && nsm_db == NULL) {
+		char path[PATH_MAX + 1];
+
+		snprintf(path, sizeof(path), "%s.nsm", v4_recov_dir);
+		nsm_db = recov_db_open(path, false);
+	}
 }
 
 /**
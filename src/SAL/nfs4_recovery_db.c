@@ -0,0 +1,714 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs4_recovery_db.c
+ * @brief Single file client recovery database
+ *
+ * With Recovery_Backend = db the client names that nfs4_recovery.c
+ * would keep as one directory each live in one file instead.  The
+ * file is a header followed by records appended as clients come and
+ * go, each adding or removing one name and carrying a CRC32C of its
+ * contents.  Opening the file reads it in one go and replays it into a
+ * hash of live names; a torn record at the tail from a crash ends the
+ * replay and is cut off.  Once removed names outnumber live ones the
+ * file is rewritten with just the live names and renamed into place.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "city.h"
+#include "sal_functions.h"
+
+#define RECOV_DB_MAGIC 0x47524342	/* "GRCB" */
+#define RECOV_DB_VERSION 1
+
+/* Records that do not name a live client before compaction is tried */
+#define RECOV_DB_COMPACT_MIN 1024
+
+/* Initial number of hash buckets, always a power of two */
+#define RECOV_DB_HASH_MIN 1024
+
+enum recov_db_op {
+	RECOV_DB_ADD = 1,
+	RECOV_DB_DEL = 2
+};
+
+struct recov_db_hdr {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct recov_db_rec {
+	uint32_t crc;		/*< CRC32C of the rest of the record */
+	uint16_t len;		/*< Length of name, without NUL */
+	uint8_t op;		/*< enum recov_db_op */
+	uint8_t pad;
+	char name[];
+};
+
+/* Records are padded to keep the next header aligned */
+#define RECOV_DB_RECLEN(len) \
+	((sizeof(struct recov_db_rec) + (len) + 3) & ~(size_t)3)
+
+struct recov_db_name {
+	struct recov_db_name *next;	/*< Next in the hash chain */
+	uint64_t hash;
+	uint16_t len;
+	char name[];
+};
+
+/**
+ * @brief An open recovery database
+ */
+
+struct recov_db {
+	pthread_mutex_t mtx;		/*< Serializes appends */
+	char *path;			/*< The file */
+	int fd;				/*< For appending, -1 if read-only */
+	struct recov_db_name **buckets;	/*< Live names */
+	uint32_t nbuckets;
+	uint32_t live;			/*< Names in the hash */
+	uint32_t recs;			/*< Records in the file */
+	off_t size;			/*< Length of the synced records */
+};
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init(void)
+{
+	uint32_t i, j, crc;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+		crc32c_table[i] = crc;
+	}
+}
+
+static uint32_t crc32c(const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint32_t crc = ~0U;
+
+	while (len--)
+		crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static struct recov_db_name *recov_db_find(struct recov_db *db,
+					   const char *name, size_t len,
+					   uint64_t hash,
+					   struct recov_db_name ***prevp)
+{
+	struct recov_db_name **prev, *n;
+
+	prev = &db->buckets[hash & (db->nbuckets - 1)];
+	for (n = *prev; n != NULL; prev = &n->next, n = n->next) {
+		if (n->hash == hash && n->len == len
+		    && memcmp(n->name, name, len) == 0)
+			break;
+	}
+	if (prevp != NULL)
+		*prevp = prev;
+	return n;
+}
+
+static void recov_db_grow(struct recov_db *db)
+{
+	struct recov_db_name **buckets, *n, *next;
+	uint32_t nbuckets = db->nbuckets * 2;
+	uint32_t i;
+
+	buckets = gsh_calloc(nbuckets, sizeof(*buckets));
+	if (buckets == NULL)
+		return;		/* Keep the longer chains */
+
+	for (i = 0; i < db->nbuckets; i++) {
+		for (n = db->buckets[i]; n != NULL; n = next) {
+			next = n->next;
+			n->next = buckets[n->hash & (nbuckets - 1)];
+			buckets[n->hash & (nbuckets - 1)] = n;
+		}
+	}
+	gsh_free(db->buckets);
+	db->buckets = buckets;
+	db->nbuckets = nbuckets;
+}
+
+/**
+ * @brief Apply one record to the hash of live names
+ *
+ * @return true if the record changed the set.
+ */
+
+static bool recov_db_apply(struct recov_db *db, enum recov_db_op op,
+			   const char *name, size_t len)
+{
+	uint64_t hash = CityHash64(name, len);
+	struct recov_db_name **prev, *n;
+
+	n = recov_db_find(db, name, len, hash, &prev);
+
+	if (op == RECOV_DB_DEL) {
+		if (n == NULL)
+			return false;
+		*prev = n->next;
+		gsh_free(n);
+		db->live--;
+		return true;
+	}
+
+	if (n != NULL)
+		return false;
+
+	n = gsh_malloc(sizeof(*n) + len + 1);
+	if (n == NULL) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Could not allocate recovery entry");
+		return false;
+	}
+	n->hash = hash;
+	n->len = len;
+	memcpy(n->name, name, len);
+	n->name[len] = '\0';
+	n->next = *prev;
+	*prev = n;
+	if (++db->live > db->nbuckets)
+		recov_db_grow(db);
+	return true;
+}
+
+static void recov_db_free_names(struct recov_db *db)
+{
+	struct recov_db_name *n, *next;
+	uint32_t i;
+
+	for (i = 0; i < db->nbuckets; i++) {
+		for (n = db->buckets[i]; n != NULL; n = next) {
+			next = n->next;
+			gsh_free(n);
+		}
+		db->buckets[i] = NULL;
+	}
+	db->live = 0;
+	db->recs = 0;
+}
+
+/**
+ * @brief Read the whole file and replay it
+ *
+ * @return Length of the valid prefix, or -1 if the file is not a
+ *         recovery database.
+ */
+
+static off_t recov_db_replay(struct recov_db *db, int fd)
+{
+	struct recov_db_hdr *hdr;
+	struct recov_db_rec *rec;
+	struct stat st;
+	char *buf;
+	size_t done = 0, off, reclen;
+	ssize_t n;
+
+	if (fstat(fd, &st) != 0)
+		return -1;
+	if (st.st_size == 0)
+		return 0;
+	if ((size_t)st.st_size < sizeof(*hdr))
+		return -1;
+
+	buf = gsh_malloc(st.st_size);
+	if (buf == NULL)
+		return -1;
+
+	while (done < (size_t)st.st_size) {
+		n = pread(fd, buf + done, st.st_size - done, done);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+		done += n;
+	}
+
+	hdr = (struct recov_db_hdr *)buf;
+	if (done < sizeof(*hdr) || hdr->magic != RECOV_DB_MAGIC
+	    || hdr->version != RECOV_DB_VERSION) {
+		gsh_free(buf);
+		return -1;
+	}
+
+	off = sizeof(*hdr);
+	while (off + sizeof(*rec) <= done) {
+		rec = (struct recov_db_rec *)(buf + off);
+		reclen = RECOV_DB_RECLEN(rec->len);
+		if (off + reclen > done
+		    || crc32c(&rec->len, reclen - sizeof(rec->crc)) != rec->crc
+		    || (rec->op != RECOV_DB_ADD && rec->op != RECOV_DB_DEL))
+			break;
+		(void)recov_db_apply(db, rec->op, rec->name, rec->len);
+		db->recs++;
+		off += reclen;
+	}
+
+	if (off < done)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Recovery database %s is damaged after byte %zu, %zu bytes ignored",
+			 db->path, off, done - off);
+
+	gsh_free(buf);
+	return off;
+}
+
+/**
+ * @brief Write one record at the end of a file
+ *
+ * @param[in] fd   The file, open for appending
+ * @param[in] op   What the record does
+ * @param[in] name Client name
+ * @param[in] len  Length of name
+ *
+ * @return 0 or an errno.
+ */
+
+static int recov_db_write_rec(int fd, enum recov_db_op op, const char *name,
+			      size_t len)
+{
+	struct recov_db_rec *rec;
+	size_t reclen = RECOV_DB_RECLEN(len);
+	ssize_t n;
+	int rc = 0;
+
+	rec = gsh_calloc(1, reclen);
+	if (rec == NULL)
+		return ENOMEM;
+
+	rec->len = len;
+	rec->op = op;
+	memcpy(rec->name, name, len);
+	rec->crc = crc32c(&rec->len, reclen - sizeof(rec->crc));
+
+	/* One write per record, so a crash tears at most the last one */
+	n = write(fd, rec, reclen);
+	if (n != (ssize_t)reclen)
+		rc = n < 0 ? errno : EIO;
+
+	gsh_free(rec);
+	return rc;
+}
+
+/**
+ * @brief Append one record and sync it
+ *
+ * A record that was not fully written and synced is cut off again, so
+ * that later records do not follow a torn one that replay stops at.
+ *
+ * @param[in] db   Database, locked by the caller
+ * @param[in] op   What the record does
+ * @param[in] name Client name
+ * @param[in] len  Length of name
+ *
+ * @return 0 or an errno.
+ */
+
+static int recov_db_append(struct recov_db *db, enum recov_db_op op,
+			   const char *name, size_t len)
+{
+	int rc = recov_db_write_rec(db->fd, op, name, len);
+
+	if (rc == 0 && fdatasync(db->fd) != 0)
+		rc = errno;
+
+	if (rc != 0) {
+		if (ftruncate(db->fd, db->size) != 0)
+			LogCrit(COMPONENT_CLIENTID,
+				"Could not truncate recovery database %s, errno=%d",
+				db->path, errno);
+		return rc;
+	}
+
+	db->size += RECOV_DB_RECLEN(len);
+	db->recs++;
+	return 0;
+}
+
+/**
+ * @brief Sync the directory holding a file
+ *
+ * Makes a rename onto path durable.
+ *
+ * @param[in] path The file
+ *
+ * @return 0 or an errno.
+ */
+
+static int recov_db_sync_dir(const char *path)
+{
+	char dir[PATH_MAX];
+	char *slash;
+	int fd, rc = 0;
+
+	if (strlen(path) >= sizeof(dir))
+		return ENAMETOOLONG;
+	strcpy(dir, path);
+	slash = strrchr(dir, '/');
+	if (slash == NULL)
+		strcpy(dir, ".");
+	else if (slash == dir)
+		slash[1] = '\0';
+	else
+		*slash = '\0';
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return errno;
+	if (fsync(fd) != 0)
+		rc = errno;
+	(void)close(fd);
+	return rc;
+}
+
+/**
+ * @brief Write the live names to a new file and rename it into place
+ *
+ * The rename is synced before returning, so that a caller may drop
+ * the names from elsewhere once this succeeds.
+ *
+ * @param[in] db Database, locked by the caller
+ *
+ * @return 0 or an errno.
+ */
+
+static int recov_db_compact_locked(struct recov_db *db)
+{
+	struct recov_db_hdr hdr = { RECOV_DB_MAGIC, RECOV_DB_VERSION };
+	struct recov_db_name *n;
+	off_t size = sizeof(hdr);
+	char tmp[PATH_MAX];
+	int fd, rc = 0;
+	uint32_t i;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", db->path);
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+	if (fd < 0)
+		return errno;
+
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+		rc = EIO;
+
+	/* Sync once at the end rather than per record */
+	for (i = 0; rc == 0 && i < db->nbuckets; i++)
+		for (n = db->buckets[i]; rc == 0 && n != NULL; n = n->next) {
+			rc = recov_db_write_rec(fd, RECOV_DB_ADD, n->name,
+						n->len);
+			size += RECOV_DB_RECLEN(n->len);
+		}
+
+	if (rc == 0 && fsync(fd) != 0)
+		rc = errno;
+	if (rc == 0 && rename(tmp, db->path) != 0)
+		rc = errno;
+
+	if (rc != 0) {
+		(void)close(fd);
+		(void)unlink(tmp);
+		return rc;
+	}
+
+	(void)close(db->fd);
+	db->fd = fd;
+	db->recs = db->live;
+	db->size = size;
+
+	return recov_db_sync_dir(db->path);
+}
+
+static void recov_db_maybe_compact(struct recov_db *db)
+{
+	int rc;
+	uint32_t dead = db->recs - db->live;
+
+	if (dead < RECOV_DB_COMPACT_MIN || dead <= db->live)
+		return;
+
+	rc = recov_db_compact_locked(db);
+	if (rc != 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Could not compact recovery database %s: %s",
+			 db->path, strerror(rc));
+	else
+		LogDebug(COMPONENT_CLIENTID,
+			 "Compacted recovery database %s to %u clients",
+			 db->path, db->live);
+}
+
+/**
+ * @brief Open a recovery database
+ *
+ * @param[in] path     The file
+ * @param[in] readonly Only read the names, as when taking over
+ *                     another node's clients.  A missing file is
+ *                     then empty rather than created.
+ *
+ * @return The database or NULL.
+ */
+
+struct recov_db *recov_db_open(const char *path, bool readonly)
+{
+	struct recov_db_hdr hdr = { RECOV_DB_MAGIC, RECOV_DB_VERSION };
+	struct recov_db *db;
+	off_t valid;
+	int fd;
+
+	(void)pthread_once(&crc32c_once, crc32c_init);
+
+	db = gsh_calloc(1, sizeof(*db));
+	if (db == NULL)
+		return NULL;
+	db->fd = -1;
+	db->path = gsh_strdup(path);
+	db->nbuckets = RECOV_DB_HASH_MIN;
+	db->buckets = gsh_calloc(db->nbuckets, sizeof(*db->buckets));
+	if (db->path == NULL || db->buckets == NULL)
+		goto err;
+	pthread_mutex_init(&db->mtx, NULL);
+
+	fd = open(path, readonly ? O_RDONLY : O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		if (readonly && errno == ENOENT)
+			return db;
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to open recovery database %s, errno=%d",
+			 path, errno);
+		goto err_mtx;
+	}
+
+	valid = recov_db_replay(db, fd);
+	if (valid < 0) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "%s is not a recovery database", path);
+		(void)close(fd);
+		goto err_mtx;
+	}
+
+	if (readonly) {
+		(void)close(fd);
+		return db;
+	}
+
+	/* Start a new file, or cut off a torn tail so appends follow
+	 * the last good record.
+	 */
+	if (valid == 0) {
+		if (pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+			goto err_fd;
+		valid = sizeof(hdr);
+	}
+	if (ftruncate(fd, valid) != 0 || lseek(fd, 0, SEEK_END) < 0)
+		goto err_fd;
+	(void)fcntl(fd, F_SETFL, O_APPEND);
+	db->fd = fd;
+	db->size = valid;
+
+	LogEvent(COMPONENT_CLIENTID,
+		 "Recovery database %s holds %u clients", path, db->live);
+	recov_db_maybe_compact(db);
+	return db;
+
+ err_fd:
+	LogEvent(COMPONENT_CLIENTID,
+		 "Failed to prepare recovery database %s, errno=%d", path,
+		 errno);
+	(void)close(fd);
+ err_mtx:
+	recov_db_free_names(db);
+	pthread_mutex_destroy(&db->mtx);
+ err:
+	gsh_free(db->buckets);
+	gsh_free(db->path);
+	gsh_free(db);
+	return NULL;
+}
+
+/**
+ * @brief Close a recovery database
+ *
+ * @param[in] db The database
+ */
+
+void recov_db_close(struct recov_db *db)
+{
+	if (db->fd >= 0)
+		(void)close(db->fd);
+	recov_db_free_names(db);
+	pthread_mutex_destroy(&db->mtx);
+	gsh_free(db->buckets);
+	gsh_free(db->path);
+	gsh_free(db);
+}
+
+/**
+ * @brief Record a client in a recovery database
+ *
+ * @param[in] db   Database, not read-only
+ * @param[in] name Client name, as made by nfs4_create_clid_name
+ *
+ * @return 0 or an errno.
+ */
+
+int recov_db_add(struct recov_db *db, const char *name)
+{
+	size_t len = strlen(name);
+	int rc = 0;
+
+	if (len > UINT16_MAX)
+		return ENAMETOOLONG;
+
+	pthread_mutex_lock(&db->mtx);
+	if (recov_db_find(db, name, len, CityHash64(name, len), NULL) == NULL) {
+		rc = recov_db_append(db, RECOV_DB_ADD, name, len);
+		if (rc == 0)
+			(void)recov_db_apply(db, RECOV_DB_ADD, name, len);
+	}
+	pthread_mutex_unlock(&db->mtx);
+
+	return rc;
+}
+
+/**
+ * @brief Forget a client in a recovery database
+ *
+ * @param[in] db   Database, not read-only
+ * @param[in] name Client name
+ *
+ * @return 0 or an errno.
+ */
+
+int recov_db_del(struct recov_db *db, const char *name)
+{
+	size_t len = strlen(name);
+	int rc = 0;
+
+	pthread_mutex_lock(&db->mtx);
+	if (recov_db_find(db, name, len, CityHash64(name, len), NULL) != NULL) {
+		rc = recov_db_append(db, RECOV_DB_DEL, name, len);
+		if (rc == 0) {
+			(void)recov_db_apply(db, RECOV_DB_DEL, name, len);
+			recov_db_maybe_compact(db);
+		}
+	}
+	pthread_mutex_unlock(&db->mtx);
+
+	return rc;
+}
+
+/**
+ * @brief Forget every client in a recovery database
+ *
+ * @param[in] db Database, not read-only
+ *
+ * @return 0 or an errno.
+ */
+
+int recov_db_clear(struct recov_db *db)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&db->mtx);
+	recov_db_free_names(db);
+	if (ftruncate(db->fd, sizeof(struct recov_db_hdr)) != 0) {
+		rc = errno;
+	} else {
+		db->size = sizeof(struct recov_db_hdr);
+		if (fdatasync(db->fd) != 0)
+			rc = errno;
+	}
+	pthread_mutex_unlock(&db->mtx);
+
+	return rc;
+}
+
+/**
+ * @brief Add every client of one recovery database to another
+ *
+ * dst is rewritten once with the union, so merging many clients
+ * costs one sync rather than one per client.
+ *
+ * @param[in] dst Database to add to, not read-only
+ * @param[in] src Database to take the clients from
+ *
+ * @return 0 or an errno.
+ */
+
+int recov_db_merge(struct recov_db *dst, struct recov_db *src)
+{
+	struct recov_db_name *n;
+	uint32_t i, added = 0;
+	int rc = 0;
+
+	pthread_mutex_lock(&dst->mtx);
+	pthread_mutex_lock(&src->mtx);
+	for (i = 0; i < src->nbuckets; i++)
+		for (n = src->buckets[i]; n != NULL; n = n->next)
+			if (recov_db_apply(dst, RECOV_DB_ADD, n->name, n->len))
+				added++;
+	pthread_mutex_unlock(&src->mtx);
+
+	if (added != 0)
+		rc = recov_db_compact_locked(dst);
+	pthread_mutex_unlock(&dst->mtx);
+
+	return rc;
+}
+
+/**
+ * @brief Call a function on every client in a recovery database
+ *
+ * @param[in] db  The database
+ * @param[in] cb  Function to call, must not modify db
+ * @param[in] arg Passed to cb
+ */
+
+void recov_db_foreach(struct recov_db *db,
+		      void (*cb)(const char *name, void *arg), void *arg)
+{
+	struct recov_db_name *n;
+	uint32_t i;
+
+	pthread_mutex_lock(&db->mtx);
+	for (i = 0; i < db->nbuckets; i++)
+		for (n = db->buckets[i]; n != NULL; n = n->next)
+			cb(n->name, arg);
+	pthread_mutex_unlock(&db->mtx);
+}
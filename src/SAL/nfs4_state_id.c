@@ -205,7 +205,7 @@ static hash_parameter_t state_id_param = {
 	.compare_key = compare_state_id,
 	.key_to_str = display_state_id_key,
 	.val_to_str = display_state_id_val,
-	.flags = HT_FLAG_CACHE,
+	.flags = HT_FLAG_OPEN_ADDR,
 };
 
 /**
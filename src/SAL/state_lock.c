@@ -680,6 +680,114 @@ void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 	}
 }
 
+/**
+ * @brief Put a lock entry on its file's lock list
+ *
+ * The entry is also indexed by range and, if not granted yet, queued
+ * on the blocked locks of the file.
+ *
+ * @param[in,out] lock_entry Entry to add
+ */
+static void add_to_locklist(state_lock_entry_t *lock_entry)
+{
+	struct cache_inode_file *file = &lock_entry->sle_entry->object.file;
+
+	if (glist_empty(&file->lock_list)) {
+		file->lock_export = lock_entry->sle_export;
+		file->lock_exports_mixed = false;
+	} else if (lock_entry->sle_export != file->lock_export) {
+		file->lock_exports_mixed = true;
+	}
+
+	glist_add_tail(&file->lock_list, &lock_entry->sle_list);
+
+	lock_entry->sle_range.start = lock_entry->sle_lock.lock_start;
+	lock_entry->sle_range.end = lock_end(&lock_entry->sle_lock);
+	itree_insert(&file->lock_tree, &lock_entry->sle_range);
+
+	if (lock_entry->sle_blocked != STATE_NON_BLOCKING)
+		glist_add_tail(&file->lock_blocked,
+			       &lock_entry->sle_blocked_link);
+}
+
+/**
+ * @brief Take a lock entry off whatever list holds it
+ *
+ * Entries on the file lock list also leave its range index and
+ * blocked queue, entries on a private list are just unlinked.
+ *
+ * @param[in,out] lock_entry Entry to unlink
+ */
+static void unlink_lock_entry(state_lock_entry_t *lock_entry)
+{
+	if (itree_node_linked(&lock_entry->sle_range)) {
+		itree_remove(&lock_entry->sle_entry->object.file.lock_tree,
+			     &lock_entry->sle_range);
+		glist_del(&lock_entry->sle_blocked_link);
+	}
+
+	glist_del(&lock_entry->sle_list);
+}
+
+/**
+ * @brief Re-key a lock entry whose range changed
+ *
+ * @param[in,out] lock_entry Entry to re-key
+ */
+static void reindex_lock_entry(state_lock_entry_t *lock_entry)
+{
+	struct itree *tree = &lock_entry->sle_entry->object.file.lock_tree;
+
+	if (!itree_node_linked(&lock_entry->sle_range))
+		return;
+
+	itree_remove(tree, &lock_entry->sle_range);
+	lock_entry->sle_range.start = lock_entry->sle_lock.lock_start;
+	lock_entry->sle_range.end = lock_end(&lock_entry->sle_lock);
+	itree_insert(tree, &lock_entry->sle_range);
+}
+
+/**
+ * @brief Collect the locks on a list that may overlap a range
+ *
+ * The file lock list is answered from its range index, any other list
+ * is taken whole.  The caller walks scan through sle_scan and must
+ * hold the state_lock for write until done.
+ *
+ * @param[in]  entry File owning the lock list
+ * @param[in]  list  List to search
+ * @param[in]  start First offset of the range
+ * @param[in]  end   Last offset of the range
+ * @param[out] scan  Candidates, in start order for the file list
+ */
+static void collect_lock_entries(cache_entry_t *entry,
+				 struct glist_head *list,
+				 uint64_t start, uint64_t end,
+				 struct glist_head *scan)
+{
+	state_lock_entry_t *found_entry;
+	struct itree_node *node;
+	struct glist_head *glist;
+
+	glist_init(scan);
+
+	if (list != &entry->object.file.lock_list) {
+		glist_for_each(glist, list) {
+			found_entry =
+			    glist_entry(glist, state_lock_entry_t, sle_list);
+			glist_add_tail(scan, &found_entry->sle_scan);
+		}
+		return;
+	}
+
+	itree_for_each_overlap(node, &entry->object.file.lock_tree,
+			       start, end) {
+		found_entry =
+		    itree_container_of(node, state_lock_entry_t, sle_range);
+		glist_add_tail(scan, &found_entry->sle_scan);
+	}
+}
+
 /**
  * @brief Remove an entry from the lock lists
  *
@@ -733,7 +841,7 @@ static void remove_from_locklist(state_lock_entry_t *lock_entry)
 	}
 
 	lock_entry->sle_owner = NULL;
-	glist_del(&lock_entry->sle_list);
+	unlink_lock_entry(lock_entry);
 	lock_entry_dec_ref(lock_entry);
 }
 
@@ -750,12 +858,14 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 						 state_owner_t *owner,
 						 fsal_lock_param_t *lock)
 {
-	struct glist_head *glist;
+	struct itree_node *node;
 	state_lock_entry_t *found_entry = NULL;
-	uint64_t found_entry_end, range_end = lock_end(lock);
+	uint64_t range_end = lock_end(lock);
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	itree_for_each_overlap(node, &entry->object.file.lock_tree,
+			       lock->lock_start, range_end) {
+		found_entry =
+		    itree_container_of(node, state_lock_entry_t, sle_range);
 
 		LogEntry("Checking", found_entry);
 
@@ -765,21 +875,15 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 		    || found_entry->sle_blocked == STATE_CANCELED)
 			continue;
 
-		found_entry_end = lock_end(&found_entry->sle_lock);
-
-		if ((found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
-			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
-			     || lock->lock_type == FSAL_LOCK_W)
-			    && different_owners(found_entry->sle_owner, owner)
-			    ) {
-				/* found a conflicting lock, return it */
-				return found_entry;
-			}
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
+		if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
+		     || lock->lock_type == FSAL_LOCK_W)
+		    && different_owners(found_entry->sle_owner, owner)) {
+			/* found a conflicting lock, return it */
+			return found_entry;
 		}
 	}
 
@@ -789,7 +893,7 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 /**
  * @brief Add a lock, potentially merging with existing locks
  *
- * We need to iterate over the full lock list and remove
+ * We need to look at every lock touching lock_entry and remove
  * any mapping entry. And l_offset = 0 and sle_lock.lock_length = 0 lock_entry
  * implies remove all entries
  *
@@ -803,13 +907,27 @@ static void merge_lock_entry(cache_entry_t *entry,
 	state_lock_entry_t *check_entry_right;
 	uint64_t check_entry_end;
 	uint64_t lock_entry_end;
+	uint64_t scan_start, scan_end;
+	struct glist_head scan;
 	struct glist_head *glist;
 	struct glist_head *glistn;
 
 	/* lock_entry might be STATE_NON_BLOCKING or STATE_GRANTING */
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+ rescan:
+	/* Only locks touching lock_entry can merge with it. Should it
+	 * grow, look again at what touches its new bounds.
+	 */
+	scan_start = lock_entry->sle_lock.lock_start;
+	scan_end = lock_end(&lock_entry->sle_lock);
+	collect_lock_entries(entry, &entry->object.file.lock_list,
+			     scan_start == 0 ? 0 : scan_start - 1,
+			     scan_end == UINT64_MAX ? UINT64_MAX : scan_end + 1,
+			     &scan);
+
+	glist_for_each_safe(glist, glistn, &scan) {
+		check_entry = glist_entry(glist, state_lock_entry_t, sle_scan);
+		glist_del(&check_entry->sle_scan);
 
 		/* Skip entry being merged - it could be in the list */
 		if (check_entry == lock_entry)
@@ -860,8 +978,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 						 "Memory allocation failure during lock upgrade/downgrade");
 					continue;
 				}
-				glist_add_tail(&entry->object.file.lock_list,
-					       &(check_entry_right->sle_list));
+				add_to_locklist(check_entry_right);
 			} else {
 				/* No split, just shrink, make the logic below
 				 * work on original lock
@@ -878,6 +995,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 				    lock_entry_end + 1;
 				check_entry_right->sle_lock.lock_length =
 				    check_entry_end - lock_entry_end;
+				reindex_lock_entry(check_entry_right);
 				LogEntry("Merge shrunk right",
 					 check_entry_right);
 			}
@@ -890,6 +1008,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 				check_entry->sle_lock.lock_length =
 				    lock_entry->sle_lock.lock_start -
 				    check_entry->sle_lock.lock_start;
+				reindex_lock_entry(check_entry);
 				LogEntry("Merge shrunk left", check_entry);
 			}
 			/* Done splitting/shrinking old lock */
@@ -918,6 +1037,12 @@ static void merge_lock_entry(cache_entry_t *entry,
 		LogEntry("Merging removing", check_entry);
 		remove_from_locklist(check_entry);
 	}
+
+	if (lock_entry->sle_lock.lock_start != scan_start
+	    || lock_end(&lock_entry->sle_lock) != scan_end) {
+		reindex_lock_entry(lock_entry);
+		goto rescan;
+	}
 }
 
 /**
@@ -946,7 +1071,7 @@ static void free_list(struct glist_head *list)
  * @param[in,out] found_entry Lock being modified
  * @param[in]     lock        Lock being removed
  * @param[out]    split_list  Remaining fragments of found_entry
- * @param[out]    remove_list Removed lock entries
+ * @param[out]    remove_list Lock entries to remove, linked by sle_scan
  * @param[out]    removed     True if lock is removed
  *
  * @return State status.
@@ -1019,11 +1144,10 @@ static state_status_t subtract_lock_from_entry(cache_entry_t *entry,
 
  complete_remove:
 
-	/* Remove the lock from the list it's
-	 * on and put it on the remove_list
+	/* Queue the lock for removal.  It stays where it is on its list
+	 * until the caller knows the whole subtraction succeeded.
 	 */
-	glist_del(&found_entry->sle_list);
-	glist_add_tail(remove_list, &(found_entry->sle_list));
+	glist_add_tail(remove_list, &found_entry->sle_scan);
 
 	*removed = true;
 	return status;
@@ -1093,18 +1217,23 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 					      struct glist_head *list)
 {
 	state_lock_entry_t *found_entry;
-	struct glist_head split_lock_list, remove_list;
+	struct glist_head split_lock_list, remove_list, scan;
 	struct glist_head *glist, *glistn;
 	state_status_t status = STATE_SUCCESS;
 	bool removed_one = false;
+	bool indexed = list == &entry->object.file.lock_list;
 
 	*removed = false;
 
 	glist_init(&split_lock_list);
 	glist_init(&remove_list);
 
-	glist_for_each_safe(glist, glistn, list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	collect_lock_entries(entry, list, lock->lock_start, lock_end(lock),
+			     &scan);
+
+	glist_for_each_safe(glist, glistn, &scan) {
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_scan);
+		glist_del(&found_entry->sle_scan);
 
 		if (owner != NULL
 		    && different_owners(found_entry->sle_owner, owner))
@@ -1142,22 +1271,36 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 
 	if (status != STATE_SUCCESS) {
 		/* We ran out of memory while splitting. split_lock_list
-		 * has been freed. For each entry on the remove_list, put
-		 * it back on the list.
+		 * has been freed. The entries on the remove_list never
+		 * left the list, so they keep their place in it.
 		 */
 		LogDebug(COMPONENT_STATE, "Failed %s", state_err_str(status));
 		glist_for_each_safe(glist, glistn, &remove_list) {
 			found_entry =
-			    glist_entry(glist, state_lock_entry_t, sle_list);
-			glist_del(&found_entry->sle_list);
-			glist_add_tail(list, &(found_entry->sle_list));
+			    glist_entry(glist, state_lock_entry_t, sle_scan);
+			glist_del(&found_entry->sle_scan);
 		}
 	} else {
-		/* free the enttries on the remove_list */
-		free_list(&remove_list);
+		/* free the entries on the remove_list */
+		glist_for_each_safe(glist, glistn, &remove_list) {
+			found_entry =
+			    glist_entry(glist, state_lock_entry_t, sle_scan);
+			glist_del(&found_entry->sle_scan);
+			remove_from_locklist(found_entry);
+		}
 
 		/* now add the split lock list */
-		glist_add_list_tail(list, &split_lock_list);
+		if (!indexed) {
+			glist_add_list_tail(list, &split_lock_list);
+		} else {
+			glist_for_each_safe(glist, glistn, &split_lock_list) {
+				found_entry = glist_entry(glist,
+							  state_lock_entry_t,
+							  sle_list);
+				glist_del(&found_entry->sle_list);
+				add_to_locklist(found_entry);
+			}
+		}
 	}
 
 	LogFullDebug(COMPONENT_STATE,
@@ -1168,25 +1311,32 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 }
 
 /**
- * @brief Remove locks in list from another list of locks
+ * @brief Remove the locks on a file from another list of locks
+ *
+ * Only the file's locks overlapping range can affect target.
  *
- * @param[in]     entry  File to modify
+ * @param[in]     entry  File whose locks to subtract
  * @param[in,out] target List of locks to modify
- * @param[in]     source List of locks to subtract
+ * @param[in]     range  Range covered by target
  *
  * @return State status.
  */
 static state_status_t subtract_list_from_list(cache_entry_t *entry,
 					      struct glist_head *target,
-					      struct glist_head *source)
+					      fsal_lock_param_t *range)
 {
 	state_lock_entry_t *found_entry;
+	struct glist_head scan;
 	struct glist_head *glist, *glistn;
 	state_status_t status = STATE_SUCCESS;
 	bool removed = false;
 
-	glist_for_each_safe(glist, glistn, source) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	collect_lock_entries(entry, &entry->object.file.lock_list,
+			     range->lock_start, lock_end(range), &scan);
+
+	glist_for_each_safe(glist, glistn, &scan) {
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_scan);
+		glist_del(&found_entry->sle_scan);
 
 		status =
 		    subtract_lock_from_list(entry, NULL, NULL,
@@ -1665,6 +1815,7 @@ void grant_blocked_lock_immediate(cache_entry_t *entry,
 
 	/* Mark lock as granted */
 	lock_entry->sle_blocked = STATE_NON_BLOCKING;
+	glist_del(&lock_entry->sle_blocked_link);
 
 	/* Merge any touching or overlapping locks into this one. */
 	LogEntry("Granted immediate, merging locks for", lock_entry);
@@ -1704,6 +1855,7 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 	if (lock_entry->sle_blocked == STATE_GRANTING) {
 		/* Mark lock as granted */
 		lock_entry->sle_blocked = STATE_NON_BLOCKING;
+		glist_del(&lock_entry->sle_blocked_link);
 
 		/* Merge any touching or overlapping locks into this one. */
 		LogEntry("Granted, merging locks for", lock_entry);
@@ -1840,8 +1992,9 @@ static void grant_blocked_locks(cache_entry_t *entry)
 	if (export->ops->fs_supports(export, fso_lock_support_async_block))
 		return;
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	glist_for_each_safe(glist, glistn, &entry->object.file.lock_blocked) {
+		found_entry = glist_entry(glist, state_lock_entry_t,
+					  sle_blocked_link);
 
 		if (found_entry->sle_blocked != STATE_NLM_BLOCKING
 		    && found_entry->sle_blocked != STATE_NFSV4_BLOCKING)
@@ -1971,8 +2124,9 @@ void cancel_blocked_locks_range(cache_entry_t *entry,
 	state_lock_entry_t *found_entry = NULL;
 	uint64_t found_entry_end, range_end = lock_end(lock);
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	glist_for_each_safe(glist, glistn, &entry->object.file.lock_blocked) {
+		found_entry = glist_entry(glist, state_lock_entry_t,
+					  sle_blocked_link);
 
 		/* Skip locks not owned by owner */
 		if (owner != NULL
@@ -2163,8 +2317,7 @@ state_status_t do_unlock_no_owner(cache_entry_t *entry,
 	LogEntry("Generating FSAL Unlock List", unlock_entry);
 
 	status =
-	    subtract_list_from_list(entry, &fsal_unlock_list,
-				    &entry->object.file.lock_list);
+	    subtract_list_from_list(entry, &fsal_unlock_list, lock);
 	if (status != STATE_SUCCESS) {
 		/* We ran out of memory while trying to build the unlock list.
 		 * We have already released the locks from cache inode lock
@@ -2426,6 +2579,40 @@ state_status_t state_test(cache_entry_t *entry,
 	return status;
 }
 
+/**
+ * @brief Find a lock of this owner held through another export
+ *
+ * Most files are only ever locked through one export, which is
+ * remembered so the whole lock list need not be walked.
+ *
+ * @param[in] entry The file
+ * @param[in] owner The lock owner
+ *
+ * @return An offending entry or NULL.
+ */
+static state_lock_entry_t *get_export_conflict(cache_entry_t *entry,
+					       state_owner_t *owner)
+{
+	struct cache_inode_file *file = &entry->object.file;
+	state_lock_entry_t *found_entry;
+	struct glist_head *glist;
+
+	if (glist_empty(&file->lock_list)
+	    || (!file->lock_exports_mixed
+		&& file->lock_export == op_ctx->export))
+		return NULL;
+
+	glist_for_each(glist, &file->lock_list) {
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+
+		if (found_entry->sle_export != op_ctx->export
+		    && !different_owners(found_entry->sle_owner, owner))
+			return found_entry;
+	}
+
+	return NULL;
+}
+
 /**
  * @brief Attempt to acquire a lock
  *
@@ -2451,6 +2638,7 @@ state_status_t state_lock(cache_entry_t *entry,
 {
 	bool allow = true, overlap = false;
 	struct glist_head *glist;
+	struct itree_node *node;
 	state_lock_entry_t *found_entry;
 	uint64_t found_entry_end;
 	uint64_t range_end = lock_end(lock);
@@ -2499,41 +2687,43 @@ state_status_t state_lock(cache_entry_t *entry,
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
+	/* Need to reject lock request if this lock owner already has
+	 * a lock on this file via a different export.
+	 */
+	found_entry = get_export_conflict(entry, owner);
+
+	if (found_entry != NULL) {
+		PTHREAD_RWLOCK_unlock(&entry->state_lock);
+
+		cache_inode_dec_pin_ref(entry, false);
+
+		LogEvent(COMPONENT_STATE,
+			 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
+			 found_entry->sle_export->export_id,
+			 found_entry->sle_export->fullpath,
+			 op_ctx->export->export_id,
+			 op_ctx->export->fullpath);
+
+		LogEntry("Found lock entry belonging to another export",
+			 found_entry);
+
+		status = STATE_INVALID_ARGUMENT;
+		return status;
+	}
+
 	if (blocking != STATE_NON_BLOCKING) {
 		/* First search for a blocked request. Client can ignore the
 		 * blocked request and keep sending us new lock request again
 		 * and again. So if we have a mapping blocked request return
 		 * that
 		 */
-		glist_for_each(glist, &entry->object.file.lock_list) {
-			found_entry =
-			    glist_entry(glist, state_lock_entry_t, sle_list);
+		glist_for_each(glist, &entry->object.file.lock_blocked) {
+			found_entry = glist_entry(glist, state_lock_entry_t,
+						  sle_blocked_link);
 
 			if (different_owners(found_entry->sle_owner, owner))
 				continue;
 
-			/* Need to reject lock request if this lock owner
-			 * already has a lock on this file via a different
-			 * export.
-			 */
-			if (found_entry->sle_export != op_ctx->export) {
-				PTHREAD_RWLOCK_unlock(&entry->state_lock);
-
-				cache_inode_dec_pin_ref(entry, false);
-
-				LogEvent(COMPONENT_STATE,
-					 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-					 found_entry->sle_export->export_id,
-					 found_entry->sle_export->fullpath,
-					 op_ctx->export->export_id,
-					 op_ctx->export->fullpath);
-				LogEntry(
-					"Found lock entry belonging to another export",
-					found_entry);
-				status = STATE_INVALID_ARGUMENT;
-				return status;
-			}
-
 			if (found_entry->sle_blocked != blocking)
 				continue;
 
@@ -2554,8 +2744,10 @@ state_status_t state_lock(cache_entry_t *entry,
 		}
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	itree_for_each_overlap(node, &entry->object.file.lock_tree,
+			       lock->lock_start, range_end) {
+		found_entry =
+		    itree_container_of(node, state_lock_entry_t, sle_range);
 
 		/* Delegations owned by a client won't conflict with delegations
 		   to that same client, but maybe we should just return
@@ -2566,53 +2758,25 @@ state_status_t state_lock(cache_entry_t *entry,
 		    found_entry->sle_owner->so_owner.so_nfs4_owner.so_clientid)
 			continue;
 
-		/* Need to reject lock request if this lock owner already has
-		 * a lock on this file via a different export.
-		 */
-		if (found_entry->sle_export != op_ctx->export
-		    && !different_owners(found_entry->sle_owner, owner)) {
-			PTHREAD_RWLOCK_unlock(&entry->state_lock);
-
-			cache_inode_dec_pin_ref(entry, false);
-
-			LogEvent(COMPONENT_STATE,
-				 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-				 found_entry->sle_export->export_id,
-				 found_entry->sle_export->fullpath,
-				 op_ctx->export->export_id,
-				 op_ctx->export->fullpath);
-
-			LogEntry("Found lock entry belonging to another export",
-				 found_entry);
-
-			status = STATE_INVALID_ARGUMENT;
-			return status;
-		}
-
 		/* Don't skip blocked locks for fairness */
 		found_entry_end = lock_end(&found_entry->sle_lock);
 
-		if ((found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
+		if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
+		     || lock->lock_type == FSAL_LOCK_W)
+		    && different_owners(found_entry->sle_owner, owner)) {
+			/* Found a conflicting lock, break out of loop.
+			 * Also indicate overlap hint.
 			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
-			     || lock->lock_type == FSAL_LOCK_W)
-			    && different_owners(found_entry->sle_owner,
-						owner)) {
-				/* Found a conflicting lock, break out of loop.
-				 * Also indicate overlap hint.
-				 */
-				LogEntry("Conflicts with", found_entry);
-				LogList("Locks", entry,
-					&entry->object.file.lock_list);
-				copy_conflict(found_entry, holder, conflict);
-				allow = false;
-				overlap = true;
-				break;
-			}
+			LogEntry("Conflicts with", found_entry);
+			LogList("Locks", entry, &entry->object.file.lock_list);
+			copy_conflict(found_entry, holder, conflict);
+			allow = false;
+			overlap = true;
+			break;
 		}
 
 		if (found_entry_end >= range_end
@@ -2792,8 +2956,7 @@ state_status_t state_lock(cache_entry_t *entry,
 		if (glist_empty(&entry->object.file.lock_list))
 			cache_inode_inc_pin_ref(entry);
 
-		glist_add_tail(&entry->object.file.lock_list,
-			       &found_entry->sle_list);
+		add_to_locklist(found_entry);
 
 		/* A lock downgrade could unblock blocked locks */
 		grant_blocked_locks(entry);
@@ -2818,8 +2981,7 @@ state_status_t state_lock(cache_entry_t *entry,
 		if (glist_empty(&entry->object.file.lock_list))
 			cache_inode_inc_pin_ref(entry);
 
-		glist_add_tail(&entry->object.file.lock_list,
-			       &found_entry->sle_list);
+		add_to_locklist(found_entry);
 
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 
@@ -3038,8 +3200,9 @@ state_status_t state_cancel(cache_entry_t *entry,
 		return STATE_SUCCESS;
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	glist_for_each(glist, &entry->object.file.lock_blocked) {
+		found_entry = glist_entry(glist, state_lock_entry_t,
+					  sle_blocked_link);
 
 		if (different_owners(found_entry->sle_owner, owner))
 			continue;
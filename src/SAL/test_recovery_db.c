@@ -0,0 +1,170 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file test_recovery_db.c
+ * @brief Replay and compaction test for the recovery database
+ *
+ * usage: test_recovery_db <dir>
+ *
+ * Adds and removes clients, checking after each step that reopening
+ * the file replays the same set, that compaction shrinks it, and that
+ * a torn tail is cut off so later records are not lost behind it.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "log.h"
+#include "sal_functions.h"
+
+#define NB_CLIENTS 3000
+#define NB_KEPT 500
+
+static char path[PATH_MAX];
+static unsigned int removed;	/*< Clients 0 to removed - 1 are gone */
+
+static void check(bool ok, const char *what)
+{
+	if (!ok) {
+		LogTest("ERROR: %s", what);
+		exit(1);
+	}
+}
+
+static void make_name(char *name, size_t size, unsigned int i)
+{
+	snprintf(name, size, "client-%u", i);
+}
+
+static off_t file_size(void)
+{
+	struct stat st;
+
+	check(stat(path, &st) == 0, "stat");
+	return st.st_size;
+}
+
+struct count_state {
+	unsigned int count;
+	unsigned int gone;	/*< Removed clients seen */
+};
+
+static void count_cb(const char *name, void *arg)
+{
+	struct count_state *state = arg;
+	unsigned int i;
+
+	state->count++;
+	if (sscanf(name, "client-%u", &i) == 1 && i < removed)
+		state->gone++;
+}
+
+/* Close the database and check the file replays to expected clients */
+static struct recov_db *reopen(struct recov_db *db, unsigned int expected)
+{
+	struct count_state state = { 0, 0 };
+
+	if (db != NULL)
+		recov_db_close(db);
+
+	db = recov_db_open(path, false);
+	check(db != NULL, "recov_db_open");
+
+	recov_db_foreach(db, count_cb, &state);
+	LogTest("%s replays to %u clients, %lld bytes", path, state.count,
+		(long long)file_size());
+	check(state.count == expected, "client count after replay");
+	check(state.gone == 0, "removed client replayed");
+	return db;
+}
+
+int main(int argc, char **argv)
+{
+	static const char junk[12] = "\xff\xff\xff\xff\xff\xff";
+	struct recov_db *db;
+	char name[32];
+	off_t size, full;
+	unsigned int i;
+	int fd;
+
+	if (argc != 2) {
+		LogTest("usage: test_recovery_db <dir>");
+		exit(1);
+	}
+
+	/* Init logging */
+	SetNamePgm("test_recovery_db");
+	SetNameFileLog("/dev/tty");
+	SetNameFunction("main");
+	SetNameHost("localhost");
+
+	snprintf(path, sizeof(path), "%s/recovery.db", argv[1]);
+	(void)unlink(path);
+
+	db = reopen(NULL, 0);
+
+	for (i = 0; i < NB_CLIENTS; i++) {
+		make_name(name, sizeof(name), i);
+		check(recov_db_add(db, name) == 0, "recov_db_add");
+	}
+	/* A client already recorded is not appended again */
+	check(recov_db_add(db, "client-0") == 0, "recov_db_add again");
+	full = file_size();
+	db = reopen(db, NB_CLIENTS);
+	check(file_size() == full, "replay of a clean file");
+
+	/* Removing most clients compacts the file on the way */
+	for (i = 0; i < NB_CLIENTS - NB_KEPT; i++) {
+		make_name(name, sizeof(name), i);
+		check(recov_db_del(db, name) == 0, "recov_db_del");
+	}
+	removed = NB_CLIENTS - NB_KEPT;
+	check(file_size() < full, "compaction");
+	db = reopen(db, NB_KEPT);
+
+	/* A torn record at the tail is cut off on open */
+	size = file_size();
+	recov_db_close(db);
+	fd = open(path, O_WRONLY | O_APPEND);
+	check(fd >= 0, "open for tearing");
+	check(write(fd, junk, sizeof(junk)) == sizeof(junk), "tear");
+	(void)close(fd);
+	db = reopen(NULL, NB_KEPT);
+	check(file_size() == size, "torn tail cut off");
+
+	/* and the records appended after it replay */
+	make_name(name, sizeof(name), NB_CLIENTS);
+	check(recov_db_add(db, name) == 0, "recov_db_add after tear");
+	db = reopen(db, NB_KEPT + 1);
+
+	check(recov_db_clear(db) == 0, "recov_db_clear");
+	db = reopen(db, 0);
+
+	recov_db_close(db);
+	LogTest("recovery database tests passed");
+	exit(0);
+}
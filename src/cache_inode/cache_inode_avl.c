@@ -53,6 +53,233 @@
 #include <pthread.h>
 #include <assert.h>
 
+/* Slabs start small so that the many tiny directories stay cheap */
+#define DIR_SLAB_MIN 512
+#define DIR_SLAB_MAX (64 * 1024)
+
+struct dir_slab {
+	struct glist_head list;
+	char data[];
+};
+
+/**
+ * @brief Initialize an empty arena
+ *
+ * @param[out] arena The arena
+ */
+
+void dir_arena_init(struct dir_arena *arena)
+{
+	glist_init(&arena->slabs);
+	arena->next = NULL;
+	arena->avail = 0;
+	arena->slab_size = DIR_SLAB_MIN;
+	arena->used = 0;
+	arena->dead = 0;
+}
+
+/**
+ * @brief Free every slab of an arena
+ *
+ * All dirents carved from the arena become invalid.  The arena is
+ * left empty and may be used again.
+ *
+ * @param[in,out] arena The arena
+ */
+
+void dir_arena_release(struct dir_arena *arena)
+{
+	struct glist_head *glist, *glistn;
+
+	glist_for_each_safe(glist, glistn, &arena->slabs) {
+		glist_del(glist);
+		gsh_free(glist_entry(glist, struct dir_slab, list));
+	}
+	dir_arena_init(arena);
+}
+
+static void *dir_arena_alloc(struct dir_arena *arena, size_t size)
+{
+	struct dir_slab *slab;
+	size_t slab_size;
+	void *p;
+
+	/* Keep every dirent 8-byte aligned */
+	size = (size + 7) & ~(size_t) 7;
+
+	if (size > arena->avail) {
+		slab_size = MAX(arena->slab_size,
+				size + sizeof(struct dir_slab));
+		slab = gsh_malloc(slab_size);
+		if (slab == NULL)
+			return NULL;
+		glist_add(&arena->slabs, &slab->list);
+		arena->next = slab->data;
+		arena->avail = slab_size - sizeof(struct dir_slab);
+		if (arena->slab_size < DIR_SLAB_MAX)
+			arena->slab_size *= 2;
+	}
+
+	p = arena->next;
+	arena->next += size;
+	arena->avail -= size;
+	arena->used += size;
+
+	return p;
+}
+
+/**
+ * @brief Check whether an arena is mostly dead space
+ *
+ * Renames and lost insert races leave space behind that only comes
+ * back when the whole arena is released.  Once more than half of it
+ * is dead, the owner should release its dirents rather than let a
+ * busy directory grow without bound.
+ *
+ * @param[in] arena The arena
+ *
+ * @return true if the arena should be released.
+ */
+
+bool dir_arena_wasteful(const struct dir_arena *arena)
+{
+	return arena->dead >= DIR_SLAB_MIN &&
+	       arena->dead > arena->used - arena->dead;
+}
+
+/* Space of a key that was allocated on its own by set_key */
+static size_t dirent_key_outside(cache_inode_dir_entry_t *dirent)
+{
+	if (dirent->ckey.kv.len == 0 ||
+	    dirent->ckey.kv.addr == dirent->name + strlen(dirent->name) + 1)
+		return 0;
+
+	return (dirent->ckey.kv.len + 7) & ~(size_t) 7;
+}
+
+/* Allocate a dirent behind prefix bytes, with its name and key inline */
+static cache_inode_dir_entry_t *
+dirent_alloc(struct dir_arena *arena, size_t prefix, const char *name,
+	     const cache_inode_key_t *key)
+{
+	cache_inode_dir_entry_t *dirent;
+	size_t namesize = strlen(name) + 1;
+	size_t size = prefix + sizeof(cache_inode_dir_entry_t) + namesize
+		      + key->kv.len;
+	char *p;
+
+	p = dir_arena_alloc(arena, size);
+	if (p == NULL)
+		return NULL;
+
+	dirent = (cache_inode_dir_entry_t *)(p + prefix);
+	dirent->flags = DIR_ENTRY_FLAG_NONE;
+	dirent->size = (size + 7) & ~(size_t) 7;
+	memcpy(dirent->name, name, namesize);
+
+	dirent->ckey.hk = key->hk;
+	dirent->ckey.fsal = key->fsal;
+	dirent->ckey.kv.len = key->kv.len;
+	dirent->ckey.kv.addr = dirent->name + namesize;
+	memcpy(dirent->ckey.kv.addr, key->kv.addr, key->kv.len);
+
+	return dirent;
+}
+
+/**
+ * @brief Allocate a dirent with its name and key inline
+ *
+ * @param[in,out] arena Arena to allocate from
+ * @param[in]     name  The NUL-terminated filename
+ * @param[in]     key   Key of the cache entry the name refers to
+ *
+ * @return The dirent, with flags clear, or NULL if out of memory.
+ */
+
+cache_inode_dir_entry_t *
+cache_inode_dirent_alloc(struct dir_arena *arena, const char *name,
+			 const cache_inode_key_t *key)
+{
+	return dirent_alloc(arena, 0, name, key);
+}
+
+/**
+ * @brief Allocate a dirent for a directory chunk
+ *
+ * As cache_inode_dirent_alloc, with a struct dir_chunk_link in front
+ * of the dirent; the caller fills it in.
+ *
+ * @param[in,out] arena Arena of the chunk
+ * @param[in]     name  The NUL-terminated filename
+ * @param[in]     key   Key of the cache entry the name refers to
+ *
+ * @return The dirent, flagged DIR_ENTRY_FLAG_CHUNKED, or NULL if out
+ *         of memory.
+ */
+
+cache_inode_dir_entry_t *
+cache_inode_dirent_alloc_chunked(struct dir_arena *arena, const char *name,
+				 const cache_inode_key_t *key)
+{
+	cache_inode_dir_entry_t *dirent;
+
+	dirent = dirent_alloc(arena, sizeof(struct dir_chunk_link), name,
+			      key);
+	if (dirent != NULL)
+		dirent->flags = DIR_ENTRY_FLAG_CHUNKED;
+
+	return dirent;
+}
+
+/**
+ * @brief Give up a dirent that is no longer referenced
+ *
+ * The space is only counted as dead; it comes back when the arena is
+ * released.
+ *
+ * @param[in,out] arena  Arena the dirent was allocated from
+ * @param[in]     dirent The dirent
+ */
+
+void cache_inode_dirent_free(struct dir_arena *arena,
+			     cache_inode_dir_entry_t *dirent)
+{
+	arena->dead += dirent->size + dirent_key_outside(dirent);
+}
+
+/**
+ * @brief Point a dirent at a different cache entry
+ *
+ * The old key is not freed; its space is counted as dead and goes
+ * back with the arena.
+ *
+ * @param[in,out] arena  Arena the dirent was allocated from
+ * @param[in,out] dirent The dirent
+ * @param[in]     key    Key of the new cache entry
+ *
+ * @return 0 or ENOMEM.
+ */
+
+int
+cache_inode_dirent_set_key(struct dir_arena *arena,
+			   cache_inode_dir_entry_t *dirent,
+			   const cache_inode_key_t *key)
+{
+	void *addr = dir_arena_alloc(arena, key->kv.len);
+
+	if (addr == NULL)
+		return ENOMEM;
+
+	arena->dead += dirent_key_outside(dirent);
+	memcpy(addr, key->kv.addr, key->kv.len);
+	dirent->ckey.hk = key->hk;
+	dirent->ckey.fsal = key->fsal;
+	dirent->ckey.kv.len = key->kv.len;
+	dirent->ckey.kv.addr = addr;
+
+	return 0;
+}
+
 void
 cache_inode_avl_init(cache_entry_t *entry)
 {
@@ -60,6 +287,14 @@ cache_inode_avl_init(cache_entry_t *entry)
 		     0 /* flags */);
 	avltree_init(&entry->object.dir.avl.c, avl_dirent_hk_cmpf,
 		     0 /* flags */);
+	dir_arena_init(&entry->object.dir.avl.arena);
+	avltree_init(&entry->object.dir.chunks.t, avl_dir_chunk_cmpf,
+		     0 /* flags */);
+	avltree_init(&entry->object.dir.chunks.ck, avl_dirent_hk_cmpf,
+		     0 /* flags */);
+	avltree_init(&entry->object.dir.chunks.names, avl_dirent_name_cmpf,
+		     0 /* flags */);
+	entry->object.dir.chunks.count = 0;
 }
 
 static inline struct avltree_node *
@@ -100,7 +335,9 @@ avl_dirent_set_deleted(cache_entry_t *entry, cache_inode_dir_entry_t *v)
 #endif
 
 	v->flags |= DIR_ENTRY_FLAG_DELETED;
-	cache_inode_key_delete(&v->ckey);
+	/* Only the cookie is still of use.  The key is left in place,
+	 * a rename onto another name copies it from here. */
+	cache_inode_dirent_free(&entry->object.dir.avl.arena, v);
 
 	/* save cookie in deleted avl */
 	avltree_insert(&v->node_hk, &entry->object.dir.avl.c);
@@ -123,6 +360,7 @@ avl_dirent_clear_deleted(cache_entry_t *entry,
 	assert(!node);
 
 	v->flags &= ~DIR_ENTRY_FLAG_DELETED;
+	entry->object.dir.avl.arena.dead -= v->size + dirent_key_outside(v);
 }
 
 static inline int
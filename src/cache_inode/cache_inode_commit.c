@@ -96,8 +96,10 @@ cache_inode_commit(cache_entry_t *entry, uint64_t offset, size_t count)
 		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
 	}
 
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_COMMIT);
 	fsal_status = entry->obj_handle->ops->commit(entry->obj_handle,
 						     offset, count);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_COMMIT);
 
 	if (FSAL_IS_ERROR(fsal_status)) {
 		status = cache_inode_error_convert(fsal_status);
@@ -112,15 +112,19 @@ cache_inode_create(cache_entry_t *parent,
 
 	switch (type) {
 	case REGULAR_FILE:
+		cache_inode_fsal_enter(NFS_TRACE_FSAL_CREATE);
 		fsal_status =
 		    dir_handle->ops->create(dir_handle, name,
 					    &object_attributes, &object_handle);
+		cache_inode_fsal_exit(NFS_TRACE_FSAL_CREATE);
 		break;
 
 	case DIRECTORY:
+		cache_inode_fsal_enter(NFS_TRACE_FSAL_CREATE);
 		fsal_status =
 		    dir_handle->ops->mkdir(dir_handle, name,
 					   &object_attributes, &object_handle);
+		cache_inode_fsal_exit(NFS_TRACE_FSAL_CREATE);
 		break;
 
 	case SYMBOLIC_LINK:
@@ -211,6 +215,7 @@ cache_inode_create(cache_entry_t *parent,
 
 	PTHREAD_RWLOCK_wrlock(&parent->content_lock);
 	/* Add this entry to the directory (also takes an internal ref) */
+	cache_inode_dir_chunks_changed(parent);
 	status = cache_inode_add_cached_dirent(parent, name, *entry, NULL);
 	PTHREAD_RWLOCK_unlock(&parent->content_lock);
 	if (status != CACHE_INODE_SUCCESS) {
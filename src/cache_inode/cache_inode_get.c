@@ -233,6 +233,7 @@ cache_inode_get(cache_inode_fsal_data_t *fsdata,
 	}
 
 	/* Cache miss, allocate a new entry */
+	(void)atomic_inc_uint64_t(&cache_stp->inode_miss);
 	exp_hdl = fsdata->export;
 	fsal_status =
 	    exp_hdl->ops->create_handle(exp_hdl, &fsdata->fh_desc,
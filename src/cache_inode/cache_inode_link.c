@@ -111,6 +111,7 @@ cache_inode_link(cache_entry_t *entry,
 	/* Add the new entry in the destination directory */
 	PTHREAD_RWLOCK_wrlock(&dest_dir->content_lock);
 
+	cache_inode_dir_chunks_changed(dest_dir);
 	status = cache_inode_add_cached_dirent(dest_dir, name, entry, NULL);
 
 	PTHREAD_RWLOCK_unlock(&dest_dir->content_lock);
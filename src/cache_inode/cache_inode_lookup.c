@@ -161,8 +161,10 @@ cache_inode_lookup_impl(cache_entry_t *parent,
 	}
 
 	dir_handle = parent->obj_handle;
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_LOOKUP);
 	fsal_status =
 	    dir_handle->ops->lookup(dir_handle, name, &object_handle);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_LOOKUP);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		if (fsal_status.major == ERR_FSAL_STALE) {
 			LogEvent(COMPONENT_CACHE_INODE,
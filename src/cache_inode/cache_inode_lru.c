@@ -54,6 +54,7 @@
 #include "cache_inode_hash.h"
 #include "gsh_intrinsic.h"
 #include "sal_functions.h"
+#include "os/subr.h"
 
 /**
  *
@@ -84,6 +85,22 @@
  * under the cache inode hash table latch.  Likewise, entries must first be
  * made unreachable to the cache inode hash table, then independently reach
  * a refcnt of 0, before they may be disposed or recycled.
+ *
+ * With LRU_Policy = 2Q, a new entry is first placed on a per-lane
+ * probation queue, which is reclaimed in FIFO order ahead of L1 and L2
+ * once it holds more than LRU_Probation_Percent of Entries_HWMark.
+ * References to a probationary entry do not promote it, so a single
+ * pass over a large tree (a backup, a find) churns only probation.
+ * When a probationary entry is reclaimed, its cih hash key is recorded
+ * in a ghost list; an entry that is loaded again while its key is
+ * still there has been re-referenced at a distance, and is admitted
+ * directly to the MRU end of L1 [Johnson and Shasha 1994].
+ *
+ * Each NUMA node owns its own set of LRU_N_Q_LANES lanes.  A new entry
+ * is queued on the lanes of the node its allocating thread runs on,
+ * and keeps that node when it is recycled.  Reclaim looks at the
+ * caller's node first, so entries (and their locks) tend to stay on
+ * the node whose workers use them.
  */
 
 struct lru_state lru_state;
@@ -108,6 +125,7 @@ struct lru_q_lane {
 	struct lru_q L2;
 	struct lru_q pinned;	/* uncollectable, due to state */
 	struct lru_q cleanup;	/* deferred cleanup */
+	struct lru_q probation;	/* new entries, under LRU_POLICY_2Q */
 	pthread_mutex_t mtx;
 	/* LRU thread scan position */
 	struct {
@@ -141,7 +159,24 @@ struct lru_q_lane {
  * processing onto L2 constrains oscillation in this algorithm.
  */
 
-static struct lru_q_lane LRU[LRU_N_Q_LANES];
+static struct lru_q_lane *LRU;
+
+/**
+ * Per-node state.  Lanes node * LRU_N_Q_LANES through
+ * (node + 1) * LRU_N_Q_LANES - 1 belong to node.
+ */
+
+struct lru_node {
+	uint64_t entries_used;	/* entries queued on this node */
+	uint32_t reap_lane;	/* reclaim cursor within the node */
+	 CACHE_PAD(0);
+};
+
+static struct lru_node *lru_nodes;
+static uint32_t lru_n_nodes;
+static uint32_t lru_n_lanes;
+
+#define LRU_NODE_OF_LANE(lane) ((lane) / LRU_N_Q_LANES)
 
 /**
  * This is a global counter of files opened by cache_inode.  This is
@@ -193,11 +228,12 @@ static const uint32_t FD_FALLBACK_LIMIT = 0x400;
 	(atomic_inc_uint32_t(&(n)) % LRU_N_Q_LANES)
 
 /* Delete lru, use iif the current thread is not the LRU
- * thread.  The node being removed is lru, glist a pointer to L1's q,
- * qlane its lane. */
+ * thread.  The node being removed is lru, glist a pointer to L1's
+ * (or probation's) q, qlane its lane. */
 #define LRU_DQ_SAFE(lru, q) \
 	do { \
-		if ((lru)->qid == LRU_ENTRY_L1) { \
+		if ((lru)->qid == LRU_ENTRY_L1 || \
+		    (lru)->qid == LRU_ENTRY_PROBATION) { \
 			struct lru_q_lane *qlane = &LRU[(lru)->lane]; \
 			if (unlikely((qlane->iter.active) && \
 				     ((&(lru)->q) == qlane->iter.glistn))) { \
@@ -210,7 +246,8 @@ static const uint32_t FD_FALLBACK_LIMIT = 0x400;
 
 #define LRU_ENTRY_L1_OR_L2(e) \
 	(((e)->lru.qid == LRU_ENTRY_L2) || \
-	 ((e)->lru.qid == LRU_ENTRY_L1))
+	 ((e)->lru.qid == LRU_ENTRY_L1) || \
+	 ((e)->lru.qid == LRU_ENTRY_PROBATION))
 
 #define LRU_ENTRY_RECLAIMABLE(e, n) \
 	(LRU_ENTRY_L1_OR_L2(e) && \
@@ -231,14 +268,30 @@ lru_init_queue(struct lru_q *q, enum lru_q_id qid)
 	q->size = 0;
 }
 
-static inline void
+static inline int
 lru_init_queues(void)
 {
 	int ix;
 
 	pthread_mutex_init(&lru_mtx, NULL);
 
-	for (ix = 0; ix < LRU_N_Q_LANES; ++ix) {
+	lru_n_nodes = gsh_numa_node_count();
+	lru_n_lanes = lru_n_nodes * LRU_N_Q_LANES;
+
+	LRU = gsh_malloc_aligned(CACHE_LINE_SIZE,
+				 lru_n_lanes * sizeof(struct lru_q_lane));
+	lru_nodes = gsh_malloc_aligned(CACHE_LINE_SIZE,
+				       lru_n_nodes * sizeof(struct lru_node));
+	if (LRU == NULL || lru_nodes == NULL) {
+		LogCrit(COMPONENT_CACHE_INODE_LRU,
+			"Unable to allocate LRU lanes for %u nodes",
+			lru_n_nodes);
+		return ENOMEM;
+	}
+	memset(LRU, 0, lru_n_lanes * sizeof(struct lru_q_lane));
+	memset(lru_nodes, 0, lru_n_nodes * sizeof(struct lru_node));
+
+	for (ix = 0; ix < lru_n_lanes; ++ix) {
 		struct lru_q_lane *qlane = &LRU[ix];
 
 		/* one mutex per lane */
@@ -252,7 +305,13 @@ lru_init_queues(void)
 		lru_init_queue(&LRU[ix].L2, LRU_ENTRY_L2);
 		lru_init_queue(&LRU[ix].pinned, LRU_ENTRY_PINNED);
 		lru_init_queue(&LRU[ix].cleanup, LRU_ENTRY_CLEANUP);
+		lru_init_queue(&LRU[ix].probation, LRU_ENTRY_PROBATION);
 	}
+
+	LogInfo(COMPONENT_CACHE_INODE_LRU,
+		"LRU queues set up for %u NUMA node(s)", lru_n_nodes);
+
+	return 0;
 }
 
 /**
@@ -268,22 +327,25 @@ lru_init_queues(void)
  * @return A pointer to entry's current queue, NULL if none.
  */
 static inline struct lru_q *
-lru_queue_of(cache_entry_t *entry)
+lru_lane_queue(struct lru_q_lane *qlane, enum lru_q_id qid)
 {
 	struct lru_q *q;
 
-	switch (entry->lru.qid) {
+	switch (qid) {
 	case LRU_ENTRY_PINNED:
-		q = &LRU[(entry->lru.lane)].pinned;
+		q = &qlane->pinned;
 		break;
 	case LRU_ENTRY_L1:
-		q = &LRU[(entry->lru.lane)].L1;
+		q = &qlane->L1;
 		break;
 	case LRU_ENTRY_L2:
-		q = &LRU[(entry->lru.lane)].L2;
+		q = &qlane->L2;
 		break;
 	case LRU_ENTRY_CLEANUP:
-		q = &LRU[(entry->lru.lane)].cleanup;
+		q = &qlane->cleanup;
+		break;
+	case LRU_ENTRY_PROBATION:
+		q = &qlane->probation;
 		break;
 	default:
 		/* LRU_NO_LANE */
@@ -294,20 +356,96 @@ lru_queue_of(cache_entry_t *entry)
 	return q;
 }
 
+static inline struct lru_q *
+lru_queue_of(cache_entry_t *entry)
+{
+	return lru_lane_queue(&LRU[(entry->lru.lane)], entry->lru.qid);
+}
+
+/**
+ * @brief The 2Q ghost list
+ *
+ * A direct-mapped table of the cih hash keys of recently reclaimed
+ * probationary entries.  A newer key simply overwrites an older one
+ * sharing its slot, which approximates FIFO aging of the ghost list
+ * without any locking; a lost ghost only costs an entry one more trip
+ * through probation.
+ */
+
+static uint64_t *lru_ghost;
+static uint64_t lru_ghost_mask;
+
+static inline void
+lru_ghost_insert(uint64_t hk)
+{
+	if (lru_ghost == NULL || hk == 0)
+		return;
+
+	atomic_store_uint64_t(&lru_ghost[hk & lru_ghost_mask], hk);
+}
+
+/**
+ * @brief Consume a ghost
+ *
+ * @param[in] hk  cih hash key of the entry being loaded
+ *
+ * @return true if hk was on the ghost list (and is no longer).
+ */
+static inline bool
+lru_ghost_take(uint64_t hk)
+{
+	if (lru_ghost == NULL || hk == 0)
+		return false;
+
+	return atomic_cas_uint64_t(&lru_ghost[hk & lru_ghost_mask], hk, 0);
+}
+
+/**
+ * @brief Count the probationary entries on the lanes of a node
+ *
+ * Lanes are read without their locks, so the sum is only advisory.
+ *
+ * @param[in] node  The NUMA node
+ */
+static inline uint64_t
+lru_probation_size(uint32_t node)
+{
+	uint64_t size = 0;
+	int ix;
+
+	for (ix = 0; ix < LRU_N_Q_LANES; ++ix)
+		size += LRU[node * LRU_N_Q_LANES + ix].probation.size;
+
+	return size;
+}
+
+/**
+ * @brief Return the node of the calling thread, as an LRU node index
+ */
+static inline uint32_t
+lru_node_self(void)
+{
+	uint32_t node = gsh_numa_node_self();
+
+	return (node < lru_n_nodes) ? node : 0;
+}
+
 /**
  * @brief Get the appropriate lane for a cache_entry
  *
  * This function gets the LRU lane by taking the modulus of the
- * supplied pointer.
+ * supplied pointer, within the lanes of the given node.
  *
  * @param[in] entry  A pointer to a cache entry
+ * @param[in] node   The NUMA node that owns entry
  *
  * @return The LRU lane in which that entry should be stored.
  */
 static inline uint32_t
-lru_lane_of_entry(cache_entry_t *entry)
+lru_lane_of_entry(cache_entry_t *entry, uint32_t node)
 {
-	return (uint32_t) (((uintptr_t) entry) % LRU_N_Q_LANES);
+	return node * LRU_N_Q_LANES +
+	    (uint32_t) (((uintptr_t) entry) % LRU_N_Q_LANES);
 }
 
 /**
@@ -405,8 +543,13 @@ cache_inode_lru_clean(cache_entry_t *entry)
 		}
 	}
 
-	if (entry->type == DIRECTORY)
+	if (entry->type == DIRECTORY) {
+		/* Chunk eviction may be working on another thread's
+		 * behalf, under the content lock */
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
 
 	/* Free FSAL resources */
 	if (entry->obj_handle) {
@@ -437,11 +580,11 @@ cache_inode_lru_clean(cache_entry_t *entry)
  * permitted to dispose or recycle.
  */
 
-static uint32_t reap_lane;
-
 static inline cache_inode_lru_t *
-lru_reap_impl(enum lru_q_id qid)
+lru_reap_impl(enum lru_q_id qid, uint32_t node)
 {
+	uint32_t base = node * LRU_N_Q_LANES;
+	uint32_t *reap_lane = &lru_nodes[node].reap_lane;
 	uint32_t lane;
 	struct lru_q_lane *qlane;
 	struct lru_q *lq;
@@ -451,10 +594,11 @@ lru_reap_impl(enum lru_q_id qid)
 	cih_latch_t latch;
 	int ix;
 
-	lane = LRU_NEXT(reap_lane);
-	for (ix = 0; ix < LRU_N_Q_LANES; ++ix, lane = LRU_NEXT(reap_lane)) {
+	lane = base + LRU_NEXT(*reap_lane);
+	for (ix = 0; ix < LRU_N_Q_LANES;
+	     ++ix, lane = base + LRU_NEXT(*reap_lane)) {
 		qlane = &LRU[lane];
-		lq = (qid == LRU_ENTRY_L1) ? &qlane->L1 : &qlane->L2;
+		lq = lru_lane_queue(qlane, qid);
 
 		QLOCK(qlane);
 		lru = glist_first_entry(&lq->q, cache_inode_lru_t, q);
@@ -489,6 +633,11 @@ lru_reap_impl(enum lru_q_id qid)
 				entry->lru.qid = LRU_ENTRY_NONE;
 				QUNLOCK(qlane);
 				cih_latch_rele(&latch);
+				if (qid == LRU_ENTRY_PROBATION)
+					lru_ghost_insert(
+						entry->fh_hk.key.hk);
+				(void)atomic_inc_uint64_t(
+					&cache_stp->inode_reclaim);
 				goto out;
 			}
 			cih_latch_rele(&latch);
@@ -510,16 +659,48 @@ lru_reap_impl(enum lru_q_id qid)
 }
 
 static inline cache_inode_lru_t *
-lru_try_reap_entry(void)
+lru_try_reap_node(uint32_t node)
+{
+	cache_inode_lru_t *lru;
+
+	if (cache_param.lru_policy == LRU_POLICY_2Q &&
+	    lru_probation_size(node) >
+	    lru_state.probation_hiwat / lru_n_nodes) {
+		lru = lru_reap_impl(LRU_ENTRY_PROBATION, node);
+		if (lru)
+			return lru;
+	}
+
+	lru = lru_reap_impl(LRU_ENTRY_L2, node);
+	if (!lru)
+		lru = lru_reap_impl(LRU_ENTRY_L1, node);
+	if (!lru && cache_param.lru_policy == LRU_POLICY_2Q)
+		lru = lru_reap_impl(LRU_ENTRY_PROBATION, node);
+
+	return lru;
+}
+
+/**
+ * @brief Reclaim an entry, preferring the given node
+ *
+ * The high water mark is global, but reclaim works through every
+ * queue of the caller's node before taking an entry from another
+ * node, so a recycled entry is usually already local.
+ *
+ * @param[in] node  Node of the calling thread
+ */
+static inline cache_inode_lru_t *
+lru_try_reap_entry(uint32_t node)
 {
 	cache_inode_lru_t *lru;
+	uint32_t ix;
 
 	if (lru_state.entries_used < lru_state.entries_hiwat)
 		return NULL;
 
-	lru = lru_reap_impl(LRU_ENTRY_L2);
-	if (!lru)
-		lru = lru_reap_impl(LRU_ENTRY_L1);
+	lru = lru_try_reap_node(node);
+	for (ix = 1; !lru && ix < lru_n_nodes; ++ix)
+		lru = lru_try_reap_node((node + ix) % lru_n_nodes);
 
 	return lru;
 }
@@ -608,6 +789,132 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
 	QUNLOCK(qlane);
 }
 
+#define CL_FLAGS \
+	(CACHE_INODE_FLAG_REALLYCLOSE| \
+	 CACHE_INODE_FLAG_NOT_PINNED| \
+	 CACHE_INODE_FLAG_CONTENT_HAVE| \
+	 CACHE_INODE_FLAG_CONTENT_HOLD)
+
+/**
+ * @brief Close the file descriptors held by one queue of one lane
+ *
+ * Walks up to per_lane_work entries from the LRU end of the given
+ * queue, closing any open file descriptor.  Entries examined on L1
+ * are moved to L2, so they are not examined again; probationary
+ * entries are rotated to the MRU end of probation, since only reclaim
+ * or a ghost hit may move them out of it, so the next pass starts on
+ * entries not yet examined.
+ *
+ * @param[in]     lane         The lane to process
+ * @param[in]     qid          LRU_ENTRY_L1 or LRU_ENTRY_PROBATION
+ * @param[in,out] totalclosed  Running count of descriptors closed
+ *
+ * @return The number of entries examined.
+ */
+
+static size_t
+lru_run_lane(size_t lane, enum lru_q_id qid, uint64_t *totalclosed)
+{
+	/* The amount of work done on this lane on this pass. */
+	size_t workdone = 0;
+	/* The entry being examined */
+	cache_inode_lru_t *lru = NULL;
+	/* Number of entries closed in this run. */
+	size_t closed = 0;
+	/* a cache_status */
+	cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
+	/* a cache entry */
+	cache_entry_t *entry;
+	/* Current queue lane */
+	struct lru_q_lane *qlane = &LRU[lane];
+	struct lru_q *q = lru_lane_queue(qlane, qid);
+	/* First probationary entry rotated on this pass */
+	cache_inode_lru_t *rotated = NULL;
+	/* entry refcnt */
+	uint32_t refcnt;
+
+	LogDebug(COMPONENT_CACHE_INODE_LRU,
+		 "Reaping up to %d entries from lane %zd",
+		 lru_state.per_lane_work, lane);
+
+	QLOCK(qlane);
+	qlane->iter.active = true;	/* ACTIVE */
+	/* While for_each_safe per se is NOT MT-safe, the iteration can
+	 * be made so by the convention that any competing thread which
+	 * would invalidate the iteration also adjusts glist and (in
+	 * particular) glistn */
+	glist_for_each_safe(qlane->iter.glist, qlane->iter.glistn, &q->q) {
+		/* check per-lane work */
+		if (workdone >= lru_state.per_lane_work)
+			break;
+
+		lru = glist_entry(qlane->iter.glist, cache_inode_lru_t, q);
+
+		/* wrapped around to the entries rotated this pass */
+		if (lru == rotated)
+			break;
+
+		refcnt = atomic_inc_int32_t(&lru->refcnt);
+
+		/* get entry early */
+		entry = container_of(lru, cache_entry_t, lru);
+
+		/* check refcnt in range */
+		if (unlikely(refcnt > 2)) {
+			cache_inode_lru_unref(entry, LRU_UNREF_QLOCKED);
+			workdone++;	/* but count it */
+			/* qlane LOCKED, lru refcnt is restored */
+			continue;
+		}
+
+		if (qid == LRU_ENTRY_L1) {
+			/* Move entry to MRU of L2 */
+			LRU_DQ_SAFE(lru, q);
+			lru->qid = LRU_ENTRY_L2;
+			glist_add(&qlane->L2.q, &lru->q);
+			++(qlane->L2.size);
+		} else {
+			/* Rotate entry to MRU of probation */
+			LRU_DQ_SAFE(lru, q);
+			glist_add_tail(&q->q, &lru->q);
+			++(q->size);
+			if (rotated == NULL)
+				rotated = lru;
+		}
+
+		/* Drop the lane lock while performing (slow) operations
+		 * on entry */
+		QUNLOCK(qlane);
+
+		/* Acquire the content lock first; we may need to look at
+		 * fds and close it. */
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		if (is_open(entry)) {
+			cache_status = cache_inode_close(entry, CL_FLAGS);
+			if (cache_status != CACHE_INODE_SUCCESS) {
+				LogCrit(COMPONENT_CACHE_INODE_LRU,
+					"Error closing file in LRU thread.");
+			} else {
+				++(*totalclosed);
+				++closed;
+			}
+		}
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+		QLOCK(qlane);	/* QLOCKED */
+		cache_inode_lru_unref(entry, LRU_UNREF_QLOCKED);
+		++workdone;
+	}			/* for_each_safe lru */
+
+	qlane->iter.active = false;	/* !ACTIVE */
+	QUNLOCK(qlane);
+	LogDebug(COMPONENT_CACHE_INODE_LRU,
+		 "Actually processed %zd entries on lane %zd closing %zd "
+		 "descriptors", workdone, lane, closed);
+
+	return workdone;
+}
+
 /**
  * @brief Function that executes in the lru thread
  *
@@ -632,7 +939,9 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
  *    level system is twofold: First, seldom used entries congregate
  *    in L2 and the promotion behaviour provides some scan
  *    resistance.  Second, once an entry is examined, it is moved to
- *    L2, so we won't examine the same cache entry repeatedly.
+ *    L2, so we won't examine the same cache entry repeatedly.  Under
+ *    LRU_POLICY_2Q the probation queue is examined as well; its
+ *    entries stay on probation but are rotated to its MRU end.
  *
  *  - If the number of open FDs is greater than the high water mark,
  *    we consider ourselves to be in extremis.  In this case we make a
@@ -658,12 +967,6 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
  * @param[in] ctx Fridge context
  */
 
-#define CL_FLAGS \
-	(CACHE_INODE_FLAG_REALLYCLOSE| \
-	 CACHE_INODE_FLAG_NOT_PINNED| \
-	 CACHE_INODE_FLAG_CONTENT_HAVE| \
-	 CACHE_INODE_FLAG_CONTENT_HOLD)
-
 static void
 lru_run(struct fridgethr_context *ctx)
 {
@@ -684,7 +987,6 @@ lru_run(struct fridgethr_context *ctx)
 	uint64_t totalclosed = 0;
 	/* The current count (after reaping) of open FDs */
 	size_t currentopen = 0;
-	struct lru_q *q;
 
 	SetNameFunction("cache_lru");
 
@@ -754,123 +1056,20 @@ lru_run(struct fridgethr_context *ctx)
 		/* Total fds closed between all lanes and all current runs. */
 		do {
 			workpass = 0;
-			for (lane = 0; lane < LRU_N_Q_LANES; ++lane) {
-				/* The amount of work done on this lane on
-				   this pass. */
-				size_t workdone = 0;
-				/* The entry being examined */
-				cache_inode_lru_t *lru = NULL;
-				/* Number of entries closed in this run. */
-				size_t closed = 0;
-				/* a cache_status */
-				cache_inode_status_t cache_status =
-				    CACHE_INODE_SUCCESS;
-				/* a cache entry */
-				cache_entry_t *entry;
-				/* Current queue lane */
-				struct lru_q_lane *qlane = &LRU[lane];
-				q = &qlane->L1;
-				/* entry refcnt */
-				uint32_t refcnt;
-
-				LogDebug(COMPONENT_CACHE_INODE_LRU,
-					 "Reaping up to %d entries from lane "
-					 "%zd",
-					 lru_state.per_lane_work, lane);
-
+			for (lane = 0; lane < lru_n_lanes; ++lane) {
 				LogFullDebug(COMPONENT_CACHE_INODE_LRU,
 					     "formeropen=%zd totalwork=%zd "
-					     "workpass=%zd closed:%zd "
-					     "totalclosed:%" PRIu64, formeropen,
-					     totalwork, workpass, closed,
-					     totalclosed);
-
-				QLOCK(qlane);
-				qlane->iter.active = true;	/* ACTIVE */
-				/* While for_each_safe per se is NOT MT-safe,
-				 * the iteration can be made so by the
-				 * convention that any competing thread which
-				 * would invalidate the iteration also adjusts
-				 * glist and (in particular) glistn */
-				glist_for_each_safe(qlane->iter.glist,
-						    qlane->iter.glistn, &q->q) {
-					struct lru_q *q;
-
-					/* check per-lane work */
-					if (workdone >= lru_state.per_lane_work)
-						goto next_lane;
-
-					lru =
-					    glist_entry(qlane->iter.glist,
-							cache_inode_lru_t, q);
-					refcnt =
-					    atomic_inc_int32_t(&lru->refcnt);
-
-					/* get entry early */
-					entry =
-					    container_of(lru, cache_entry_t,
-							 lru);
-
-					/* check refcnt in range */
-					if (unlikely(refcnt > 2)) {
-						cache_inode_lru_unref(
-							entry,
-							LRU_UNREF_QLOCKED);
-						workdone++; /* but count it */
-						/* qlane LOCKED, lru refcnt is
-						 * restored */
-						continue;
-					}
-
-					/* Move entry to MRU of L2 */
-					q = &qlane->L1;
-					LRU_DQ_SAFE(lru, q);
-					lru->qid = LRU_ENTRY_L2;
-					q = &qlane->L2;
-					glist_add(&q->q, &lru->q);
-					++(q->size);
-
-					/* Drop the lane lock while performing
-					 * (slow) operations on entry */
-					QUNLOCK(qlane);
-
-					/* Acquire the content lock first; we
-					 * may need to look at fds and close
-					 * it. */
-					PTHREAD_RWLOCK_wrlock(&entry->
-							      content_lock);
-					if (is_open(entry)) {
-						cache_status =
-						    cache_inode_close(
-							    entry, CL_FLAGS);
-						if (cache_status !=
-						    CACHE_INODE_SUCCESS) {
-							LogCrit(
-						      COMPONENT_CACHE_INODE_LRU,
-							"Error closing file in LRU thread.");
-						} else {
-							++totalclosed;
-							++closed;
-						}
-					}
-					PTHREAD_RWLOCK_unlock(&entry->
-							      content_lock);
-
-					QLOCK(qlane);	/* QLOCKED */
-					cache_inode_lru_unref(
-						entry,
-						LRU_UNREF_QLOCKED);
-					++workdone;
-				} /* for_each_safe lru */
-
- next_lane:
-				qlane->iter.active = false; /* !ACTIVE */
-				QUNLOCK(qlane);
-				LogDebug(COMPONENT_CACHE_INODE_LRU,
-					 "Actually processed %zd entries on "
-					 "lane %zd closing %zd descriptors",
-					 workdone, lane, closed);
-				workpass += workdone;
+					     "workpass=%zd totalclosed:%"
+					     PRIu64, formeropen, totalwork,
+					     workpass, totalclosed);
+
+				if (cache_param.lru_policy == LRU_POLICY_2Q)
+					workpass +=
+					    lru_run_lane(lane,
+							 LRU_ENTRY_PROBATION,
+							 &totalclosed);
+				workpass += lru_run_lane(lane, LRU_ENTRY_L1,
+							 &totalclosed);
 			}	/* foreach lane */
 			totalwork += workpass;
 		} while (extremis && (workpass >= lru_state.per_lane_work)
@@ -933,7 +1132,7 @@ lru_run(struct fridgethr_context *ctx)
 		     "currentopen=%zd futility=%d totalwork=%zd "
 		     "biggest_window=%d extremis=%d lanes=%d " "fds_lowat=%d ",
 		     currentopen, lru_state.futility, totalwork,
-		     lru_state.biggest_window, extremis, LRU_N_Q_LANES,
+		     lru_state.biggest_window, extremis, lru_n_lanes,
 		     lru_state.fds_lowat);
 }
 
@@ -966,6 +1165,29 @@ cache_inode_lru_pkginit(void)
 	   bit fishy, so come back and revisit this. */
 	lru_state.entries_hiwat = cache_param.entries_hwmark;
 	lru_state.entries_used = 0;
+	lru_state.probation_hiwat =
+	    (lru_state.entries_hiwat * cache_param.lru_probation_percent) /
+	    100;
+
+	if (cache_param.lru_policy == LRU_POLICY_2Q &&
+	    cache_param.lru_ghost_percent > 0) {
+		uint64_t want =
+		    (lru_state.entries_hiwat * cache_param.lru_ghost_percent) /
+		    100;
+		uint64_t slots = 64;
+
+		while (slots < want)
+			slots <<= 1;
+		lru_ghost = gsh_calloc(slots, sizeof(uint64_t));
+		if (lru_ghost == NULL) {
+			LogCrit(COMPONENT_CACHE_INODE_LRU,
+				"Unable to allocate %" PRIu64
+				" ghost slots, running 2Q without ghosts.",
+				slots);
+		} else {
+			lru_ghost_mask = slots - 1;
+		}
+	}
 
 	/* Find out the system-imposed file descriptor limit */
 	if (getrlimit(RLIMIT_NOFILE, &rlim) != 0) {
@@ -1050,8 +1272,15 @@ err_open:
 	     lru_state.fds_system_imposed) / 100;
 	lru_state.futility = 0;
 
+	/* init queue complex */
+	code = lru_init_queues();
+	if (code != 0)
+		return code;
+
 	lru_state.per_lane_work =
-	    (cache_param.reaper_work / LRU_N_Q_LANES);
+	    (cache_param.reaper_work / lru_n_lanes);
+	if (lru_state.per_lane_work == 0)
+		lru_state.per_lane_work = 1;
 	lru_state.biggest_window =
 	    (cache_param.biggest_window *
 	     lru_state.fds_system_imposed) / 100;
@@ -1060,9 +1289,6 @@ err_open:
 
 	lru_state.caching_fds = cache_param.use_fd_cache;
 
-	/* init queue complex */
-	lru_init_queues();
-
 	/* spawn LRU background thread */
 	code = fridgethr_init(&lru_fridge, "LRU_fridge", &frp);
 	if (code != 0) {
@@ -1147,7 +1373,7 @@ fail:
 }
 
 static cache_inode_status_t
-alloc_cache_entry(cache_entry_t **entry)
+alloc_cache_entry(cache_entry_t **entry, uint32_t node)
 {
 	cache_inode_status_t status;
 	cache_entry_t *nentry;
@@ -1171,6 +1397,7 @@ alloc_cache_entry(cache_entry_t **entry)
 
 	status = CACHE_INODE_SUCCESS;
 	atomic_inc_int64_t(&lru_state.entries_used);
+	atomic_inc_uint64_t(&lru_nodes[node].entries_used);
 
  out:
 	*entry = nentry;
@@ -1185,35 +1412,44 @@ alloc_cache_entry(cache_entry_t **entry)
  * On success, this function always returns an entry with two
  * references (one for the sentinel, one to allow the caller's use.)
  *
+ * Under LRU_POLICY_2Q the entry starts out on probation, unless key
+ * is on the ghost list.
+ *
+ * @param[in]  key   Hash key of the object the entry will cache
  * @param[out] entry Returned status
  *
  * @return CACHE_INODE_SUCCESS or error.
  */
 cache_inode_status_t
-cache_inode_lru_get(cache_entry_t **entry)
+cache_inode_lru_get(const cache_inode_key_t *key, cache_entry_t **entry)
 {
 	cache_inode_lru_t *lru;
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 	cache_entry_t *nentry = NULL;
+	uint32_t node = lru_node_self();
 	uint32_t lane;
 
-	lru = lru_try_reap_entry();
+	lru = lru_try_reap_entry(node);
 	if (lru) {
 		/* we uniquely hold entry */
 		nentry = container_of(lru, cache_entry_t, lru);
 		LogFullDebug(COMPONENT_CACHE_INODE_LRU,
 			     "Recycling entry at %p.", nentry);
+		/* a recycled entry stays with the node it came from */
+		node = LRU_NODE_OF_LANE(lru->lane);
 		cache_inode_lru_clean(nentry);
 		if (!init_rw_locks(nentry)) {
 			/* Recycle */
 			status = CACHE_INODE_INIT_ENTRY_FAILED;
 			pool_free(cache_inode_entry_pool, nentry);
+			atomic_dec_int64_t(&lru_state.entries_used);
+			atomic_dec_uint64_t(&lru_nodes[node].entries_used);
 			nentry = NULL;
 			goto out;
 		}
 	} else {
 		/* alloc entry */
-		status = alloc_cache_entry(&nentry);
+		status = alloc_cache_entry(&nentry, node);
 		if (!nentry)
 			goto out;
 	}
@@ -1224,14 +1460,62 @@ cache_inode_lru_get(cache_entry_t **entry)
 	nentry->lru.cf = 0;
 
 	/* Enqueue. */
-	lane = lru_lane_of_entry(nentry);
-	lru_insert_entry(nentry, &LRU[lane].L1, lane, LRU_HEAD);
+	lane = lru_lane_of_entry(nentry, node);
+	if (cache_param.lru_policy != LRU_POLICY_2Q) {
+		lru_insert_entry(nentry, &LRU[lane].L1, lane, LRU_HEAD);
+	} else if (lru_ghost_take(key->hk)) {
+		(void)atomic_inc_uint64_t(&cache_stp->inode_ghost_hit);
+		lru_insert_entry(nentry, &LRU[lane].L1, lane, LRU_TAIL);
+	} else {
+		lru_insert_entry(nentry, &LRU[lane].probation, lane,
+				 LRU_TAIL);
+	}
 
  out:
 	*entry = nentry;
 	return status;
 }
 
+/**
+ * @brief Return the number of NUMA nodes with their own LRU lanes
+ */
+uint32_t
+cache_inode_lru_nodes(void)
+{
+	return lru_n_nodes;
+}
+
+/**
+ * @brief Report the occupancy of one node's lanes
+ *
+ * Queue sizes are read without the lane locks, so this is a snapshot
+ * for monitoring only.
+ *
+ * @param[in]  node  The NUMA node
+ * @param[out] st    Occupancy of node's lanes
+ */
+void
+cache_inode_lru_node_stats(uint32_t node, struct lru_node_stats *st)
+{
+	struct lru_q_lane *qlane;
+	int ix;
+
+	memset(st, 0, sizeof(*st));
+	if (node >= lru_n_nodes)
+		return;
+
+	st->entries_used =
+	    atomic_fetch_uint64_t(&lru_nodes[node].entries_used);
+	for (ix = 0; ix < LRU_N_Q_LANES; ++ix) {
+		qlane = &LRU[node * LRU_N_Q_LANES + ix];
+		st->l1 += qlane->L1.size;
+		st->l2 += qlane->L2.size;
+		st->probation += qlane->probation.size;
+		st->pinned += qlane->pinned.size;
+		st->cleanup += qlane->cleanup.size;
+	}
+}
+
 /**
  * @brief Function to let the state layer pin an entry
  *
@@ -1407,6 +1691,9 @@ cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags)
 				glist_add_tail(&q->q, &lru->q);
 			}
 			break;
+		case LRU_ENTRY_PROBATION:
+			/* probation is FIFO; promotion only happens
+			 * through the ghost list */
 		default:
 			/* do nothing */
 			break;
@@ -1486,6 +1773,8 @@ cache_inode_lru_unref(cache_entry_t *entry, uint32_t flags)
 		pool_free(cache_inode_entry_pool, entry);
 
 		atomic_dec_int64_t(&lru_state.entries_used);
+		atomic_dec_uint64_t(&lru_nodes[LRU_NODE_OF_LANE(lane)].
+				    entries_used);
 	}			/* refcnt == 0 */
  out:
 	return;
@@ -1524,6 +1813,7 @@ cache_inode_lru_putback(cache_entry_t *entry, uint32_t flags)
 	/* We do NOT call lru_clean_entry, since it was never initialized. */
 	pool_free(cache_inode_entry_pool, entry);
 	atomic_dec_int64_t(&lru_state.entries_used);
+	atomic_dec_uint64_t(&lru_nodes[LRU_NODE_OF_LANE(lane)].entries_used);
 
 	if (!qlocked)
 		QUNLOCK(qlane);
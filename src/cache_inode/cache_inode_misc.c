@@ -55,6 +55,10 @@
 
 pool_t *cache_inode_entry_pool;
 
+/* Threads inside an FSAL call made through the cache */
+uint32_t cache_inode_fsal_busy;
+__thread uint32_t cache_inode_fsal_depth;
+
 const char *
 cache_inode_err_str(cache_inode_status_t err)
 {
@@ -277,7 +281,7 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 	/* !LATCHED */
 
 	/* We did not find the object.  Pull an entry off the LRU. */
-	status = cache_inode_lru_get(&nentry);
+	status = cache_inode_lru_get(&key, &nentry);
 
 	if (nentry == NULL) {
 		/* Release the subtree hash table lock */
@@ -337,6 +341,10 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		/* No shares or locks, yet. */
 		glist_init(&nentry->object.file.deleg_list);
 		glist_init(&nentry->object.file.lock_list);
+		itree_init(&nentry->object.file.lock_tree);
+		glist_init(&nentry->object.file.lock_blocked);
+		nentry->object.file.lock_export = NULL;
+		nentry->object.file.lock_exports_mixed = false;
 		glist_init(&nentry->object.file.nlm_share_list);
 		memset(&nentry->object.file.share_state, 0,
 		       sizeof(cache_inode_share_t));
@@ -790,8 +798,9 @@ cache_inode_print_dir(cache_entry_t *entry)
  * cache_inode_release_dirents: release cached dirents associated
  * with an entry.
  *
- * releases dirents associated with pentry.  this is simple, but maybe
- * should be abstracted.
+ * releases dirents associated with pentry.  The dirents live in the
+ * directory's arena, so the trees are just emptied; the memory goes
+ * back in one piece when both are released.
  *
  * @param[in] entry Directory to have entries be released
  * @param[in] which Caches to clear (dense, sparse, or both)
@@ -801,56 +810,28 @@ void
 cache_inode_release_dirents(cache_entry_t *entry,
 			    cache_inode_avl_which_t which)
 {
-	struct avltree_node *dirent_node = NULL;
-	struct avltree_node *next_dirent_node = NULL;
-	struct avltree *tree = NULL;
-	cache_inode_dir_entry_t *dirent = NULL;
-
 	/* Won't see this */
 	if (entry->type != DIRECTORY)
 		return;
 
-	switch (which) {
-	case CACHE_INODE_AVL_NAMES:
-		tree = &entry->object.dir.avl.t;
-		break;
-
-	case CACHE_INODE_AVL_COOKIES:
-		tree = &entry->object.dir.avl.c;
-		break;
-
-	case CACHE_INODE_AVL_BOTH:
-		cache_inode_release_dirents(entry, CACHE_INODE_AVL_NAMES);
-		cache_inode_release_dirents(entry, CACHE_INODE_AVL_COOKIES);
-		/* tree == NULL */
-		break;
-
-	default:
-		/* tree == NULL */
-		break;
+	if (which & CACHE_INODE_AVL_NAMES) {
+		avltree_init(&entry->object.dir.avl.t, avl_dirent_hk_cmpf,
+			     0 /* flags */);
+		entry->object.dir.nbactive = 0;
+		atomic_clear_uint32_t_bits(&entry->flags,
+					   CACHE_INODE_DIR_POPULATED);
 	}
 
-	if (tree) {
-		dirent_node = avltree_first(tree);
-
-		while (dirent_node) {
-			next_dirent_node = avltree_next(dirent_node);
-			dirent =
-			    avltree_container_of(dirent_node,
-						 cache_inode_dir_entry_t,
-						 node_hk);
-			avltree_remove(dirent_node, tree);
-			if (dirent->ckey.kv.len)
-				cache_inode_key_delete(&dirent->ckey);
-			gsh_free(dirent);
-			dirent_node = next_dirent_node;
-		}
+	if (which & CACHE_INODE_AVL_COOKIES)
+		avltree_init(&entry->object.dir.avl.c, avl_dirent_hk_cmpf,
+			     0 /* flags */);
 
-		if (tree == &entry->object.dir.avl.t) {
-			entry->object.dir.nbactive = 0;
-			atomic_clear_uint32_t_bits(&entry->flags,
-						   CACHE_INODE_DIR_POPULATED);
-		}
+	if (which == CACHE_INODE_AVL_BOTH) {
+		dir_arena_release(&entry->object.dir.avl.arena);
+		cache_inode_release_dir_chunks(entry);
+		/* The next populate decides afresh whether to chunk */
+		atomic_clear_uint32_t_bits(&entry->flags,
+					   CACHE_INODE_DIR_CHUNKED);
 	}
 }
 
@@ -207,7 +207,9 @@ cache_inode_open(cache_entry_t *entry,
 	}
 
 	if ((current_flags == FSAL_O_CLOSED)) {
+		cache_inode_fsal_enter(NFS_TRACE_FSAL_OPEN);
 		fsal_status = obj_hdl->ops->open(obj_hdl, openflags);
+		cache_inode_fsal_exit(NFS_TRACE_FSAL_OPEN);
 		if (FSAL_IS_ERROR(fsal_status)) {
 			status = cache_inode_error_convert(fsal_status);
 			LogDebug(COMPONENT_CACHE_INODE,
@@ -53,6 +53,56 @@
 #include <pthread.h>
 #include <assert.h>
 
+/**
+ * @brief Make sure a file is open for I/O
+ *
+ * Takes the content lock for read and makes sure the file is open in
+ * a mode compatible with openflags, opening it if need be.
+ *
+ * @param[in]  entry     File to be read or written
+ * @param[in]  openflags Mode the I/O needs
+ * @param[out] opened    Set to true if the file had to be opened
+ *
+ * @return CACHE_INODE_SUCCESS with the content lock held for read, or
+ *         an error with the content lock released.
+ */
+
+static cache_inode_status_t
+cache_inode_rdwr_open(cache_entry_t *entry, fsal_openflags_t openflags,
+		      bool *opened)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	fsal_openflags_t loflags;
+	cache_inode_status_t status;
+
+	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+	loflags = obj_hdl->ops->status(obj_hdl);
+	while ((!is_open(entry))
+	       || (loflags && loflags != FSAL_O_RDWR && loflags != openflags)) {
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		loflags = obj_hdl->ops->status(obj_hdl);
+		if ((!is_open(entry))
+		    || (loflags && loflags != FSAL_O_RDWR
+			&& loflags != openflags)) {
+			status =
+			    cache_inode_open(entry, openflags,
+					     (CACHE_INODE_FLAG_CONTENT_HAVE |
+					      CACHE_INODE_FLAG_CONTENT_HOLD));
+			if (status != CACHE_INODE_SUCCESS) {
+				PTHREAD_RWLOCK_unlock(&entry->content_lock);
+				return status;
+			}
+			*opened = true;
+		}
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+		loflags = obj_hdl->ops->status(obj_hdl);
+	}
+
+	return CACHE_INODE_SUCCESS;
+}
+
 /**
  * @brief Reads/Writes through the cache layer
  *
@@ -65,7 +115,9 @@
  * @param[in]     offset       Absolute file position for I/O
  * @param[in]     io_size      Amount of data to be read or written
  * @param[out]    bytes_moved  The length of data successfuly read or written
- * @param[in,out] buffer       Where in memory to read or write data
+ * @param[in,out] buffer       Where in memory to read or write data, or
+ *                             a struct gsh_iobuf ** for
+ *                             CACHE_INODE_READ_IOBUF
  * @param[out]    eof          Whether a READ encountered the end of file.  May
  *                             be NULL for writes.
  * @param[in]     sync         Whether the write is synchronous or not
@@ -86,19 +138,21 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
 	/* Required open mode to successfully read or write */
 	fsal_openflags_t openflags = FSAL_O_CLOSED;
-	fsal_openflags_t loflags;
 	/* True if we have taken the content lock on 'entry' */
 	bool content_locked = false;
 	/* True if we have taken the attribute lock on 'entry' */
 	bool attributes_locked = false;
 	/* TRUE if we opened a previously closed FD */
 	bool opened = false;
+	/* FSAL operation reported to the tracer */
+	uint16_t trace_op;
 
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
 	/* Set flags for a read or write, as appropriate */
 	if (io_direction == CACHE_INODE_READ ||
-	    io_direction == CACHE_INODE_READ_PLUS) {
+	    io_direction == CACHE_INODE_READ_PLUS ||
+	    io_direction == CACHE_INODE_READ_IOBUF) {
 		openflags = FSAL_O_READ;
 	} else {
 		struct export_perms *perms;
@@ -130,29 +184,15 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 
 	/* Write through the FSAL.  We need a write lock only if we need
 	   to open or close a file descriptor. */
-	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+	status = cache_inode_rdwr_open(entry, openflags, &opened);
+	if (status != CACHE_INODE_SUCCESS)
+		goto out;
 	content_locked = true;
-	loflags = obj_hdl->ops->status(obj_hdl);
-	while ((!is_open(entry))
-	       || (loflags && loflags != FSAL_O_RDWR && loflags != openflags)) {
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
-		loflags = obj_hdl->ops->status(obj_hdl);
-		if ((!is_open(entry))
-		    || (loflags && loflags != FSAL_O_RDWR
-			&& loflags != openflags)) {
-			status =
-			    cache_inode_open(entry, openflags,
-					     (CACHE_INODE_FLAG_CONTENT_HAVE |
-					      CACHE_INODE_FLAG_CONTENT_HOLD));
-			if (status != CACHE_INODE_SUCCESS)
-				goto out;
-			opened = true;
-		}
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
-		loflags = obj_hdl->ops->status(obj_hdl);
-	}
+
+	trace_op = (io_direction == CACHE_INODE_WRITE ||
+		    io_direction == CACHE_INODE_WRITE_PLUS) ?
+	    NFS_TRACE_FSAL_WRITE : NFS_TRACE_FSAL_READ;
+	cache_inode_fsal_enter(trace_op);
 
 	/* Call FSAL_read or FSAL_write */
 	if (io_direction == CACHE_INODE_READ) {
@@ -163,6 +203,14 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		fsal_status =
 		    obj_hdl->ops->read_plus(obj_hdl, offset, io_size,
 					    buffer, bytes_moved, eof, info);
+	} else if (io_direction == CACHE_INODE_READ_IOBUF) {
+		struct gsh_iobuf **iob = buffer;
+
+		fsal_status =
+		    obj_hdl->ops->read_iobuf(obj_hdl, offset, io_size,
+					     iob, eof);
+		if (!FSAL_IS_ERROR(fsal_status))
+			*bytes_moved = (*iob)->len;
 	} else {
 		bool fsal_sync = *sync;
 		if (io_direction == CACHE_INODE_WRITE)
@@ -188,6 +236,7 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 			*sync = fsal_sync;
 		}
 	}
+	cache_inode_fsal_exit(trace_op);
 
 	LogFullDebug(COMPONENT_FSAL,
 		     "cache_inode_rdwr: FSAL IO operation returned "
@@ -305,4 +354,244 @@ cache_inode_rdwr(cache_entry_t *entry,
 				     bytes_moved, buffer, eof, sync, NULL);
 }
 
+/**
+ * @brief Read into a payload supplied by the FSAL
+ *
+ * The data are read into a reference counted payload chosen by the
+ * FSAL, which the caller attaches to its reply as is.  On
+ * success the caller owns one reference and must drop it with
+ * gsh_iobuf_put once the reply is sent.
+ *
+ * @param[in]  entry   File to be read
+ * @param[in]  offset  Absolute file position for I/O
+ * @param[in]  io_size Amount of data to be read
+ * @param[out] iob     Payload holding the data read
+ * @param[out] eof     Whether the read encountered the end of file
+ *
+ * @return CACHE_INODE_SUCCESS or various errors
+ */
+
+cache_inode_status_t
+cache_inode_read_iobuf(cache_entry_t *entry, uint64_t offset,
+		       size_t io_size, struct gsh_iobuf **iob, bool *eof)
+{
+	cache_inode_status_t status;
+	size_t bytes_moved = 0;
+	bool sync = false;
+
+	*iob = NULL;
+	status = cache_inode_rdwr_plus(entry, CACHE_INODE_READ_IOBUF,
+				       offset, io_size, &bytes_moved, iob,
+				       eof, &sync, NULL);
+
+	/* The read may have succeeded with a later step failing */
+	if (status != CACHE_INODE_SUCCESS && *iob != NULL) {
+		gsh_iobuf_put(*iob);
+		*iob = NULL;
+	}
+
+	return status;
+}
+
+/**
+ * @brief Start an asynchronous read or write
+ *
+ * The file is opened if need be and the I/O handed to the FSAL's
+ * read2 or write2 method; the content lock is dropped as soon as the
+ * FSAL has taken the operation.  done_cb runs once the data have
+ * moved, possibly on an FSAL thread and possibly before this function
+ * returns.  It must not block: the post-I/O work (commit, attribute
+ * refresh) is left to cache_inode_rdwr_async_done, which the caller
+ * runs from a context that may block.
+ *
+ * A file opened here is left open for the fd cache to reap, since the
+ * I/O may still be in flight when this function returns.
+ *
+ * For reads the attribute lock is held across read2 so that the FSAL
+ * can sample the file size for its end-of-file test.
+ *
+ * Only the submission is traced here.  done_cb should trace the
+ * FSAL_EXIT event with cache_inode_fsal_async_done, so that the FSAL
+ * time of the request covers the I/O itself.
+ *
+ * The caller MUST NOT hold either the content or attribute locks and
+ * must hold a reference on entry until done_cb has run.
+ *
+ * @param[in]     entry        File to be read or written
+ * @param[in]     io_direction CACHE_INODE_READ or CACHE_INODE_WRITE
+ * @param[in,out] io_arg       Offset, length and buffer; results
+ * @param[in,out] sync         Whether a write should be stable.  May be
+ *                             NULL for reads.
+ * @param[in]     done_cb      Completion callback
+ * @param[in]     caller_arg   Argument for done_cb
+ *
+ * @return CACHE_INODE_SUCCESS if done_cb will be called, else an
+ *         error and done_cb is not called.
+ */
+
+cache_inode_status_t
+cache_inode_rdwr_async(cache_entry_t *entry,
+		       cache_inode_io_direction_t io_direction,
+		       struct fsal_io_arg *io_arg, bool *sync,
+		       fsal_async_cb done_cb, void *caller_arg)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	fsal_openflags_t openflags;
+	cache_inode_status_t status;
+	bool opened = false;
+
+	if (entry->type != REGULAR_FILE)
+		return entry->type == DIRECTORY ?
+		    CACHE_INODE_IS_A_DIRECTORY : CACHE_INODE_BAD_TYPE;
+
+	io_arg->io_amount = 0;
+	io_arg->end_of_file = false;
+
+	if (io_direction == CACHE_INODE_READ) {
+		openflags = FSAL_O_READ;
+		io_arg->fsal_stable = false;
+	} else {
+		/* As in cache_inode_rdwr_plus */
+		if (op_ctx->export->export_perms.options &
+		    EXPORT_OPTION_COMMIT)
+			*sync = true;
+		openflags = FSAL_O_WRITE;
+		if (*sync)
+			openflags |= FSAL_O_SYNC;
+		io_arg->fsal_stable = *sync;
+	}
+
+	/* attr_lock is taken before content_lock, as in setattr */
+	if (io_direction == CACHE_INODE_READ)
+		PTHREAD_RWLOCK_rdlock(&entry->attr_lock);
+
+	status = cache_inode_rdwr_open(entry, openflags, &opened);
+	if (status != CACHE_INODE_SUCCESS) {
+		if (io_direction == CACHE_INODE_READ)
+			PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+		return status;
+	}
+
+	if (io_direction == CACHE_INODE_READ) {
+		cache_inode_fsal_enter(NFS_TRACE_FSAL_READ);
+		obj_hdl->ops->read2(obj_hdl, io_arg, done_cb, caller_arg);
+		cache_inode_fsal_submitted();
+	} else {
+		cache_inode_fsal_enter(NFS_TRACE_FSAL_WRITE);
+		obj_hdl->ops->write2(obj_hdl, io_arg, done_cb, caller_arg);
+		cache_inode_fsal_submitted();
+	}
+
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	if (io_direction == CACHE_INODE_READ)
+		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Commit an asynchronous write that was not done stable
+ *
+ * This commits on whatever fd is open: reopening with other flags
+ * would drop the process's locks on the file.  The fd is only opened
+ * if the fd cache reaped it while the write was in flight.
+ *
+ * @param[in]  entry       File written
+ * @param[in]  io_arg      Range written
+ * @param[out] fsal_status Result of the commit
+ *
+ * @return CACHE_INODE_SUCCESS or the error reopening the file.
+ */
+
+static cache_inode_status_t
+cache_inode_async_commit(cache_entry_t *entry, struct fsal_io_arg *io_arg,
+			 fsal_status_t *fsal_status)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	cache_inode_status_t status = CACHE_INODE_SUCCESS;
+
+	PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+	if (!is_open(entry)) {
+		status = cache_inode_open(entry, FSAL_O_WRITE,
+					  (CACHE_INODE_FLAG_CONTENT_HAVE |
+					   CACHE_INODE_FLAG_CONTENT_HOLD));
+		if (status != CACHE_INODE_SUCCESS)
+			goto out;
+	}
+
+	*fsal_status = obj_hdl->ops->commit(obj_hdl, io_arg->offset,
+					    io_arg->io_amount);
+ out:
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	return status;
+}
+
+/**
+ * @brief Finish an asynchronous read or write
+ *
+ * Called once the completion callback of cache_inode_rdwr_async has
+ * run, from a context that may block.  This does what
+ * cache_inode_rdwr_plus does after the FSAL call: commits a write
+ * that was asked to be stable and was not, kills stale entries and
+ * updates the cached attributes.
+ *
+ * @param[in]     entry        File that was read or written
+ * @param[in]     io_direction CACHE_INODE_READ or CACHE_INODE_WRITE
+ * @param[in,out] io_arg       Results of the I/O
+ * @param[in,out] sync         In, whether a stable write was asked
+ *                             for.  Out, whether it was done.  May be
+ *                             NULL for reads.
+ * @param[in]     fsal_status  Status given to the completion callback
+ *
+ * @return CACHE_INODE_SUCCESS or various errors
+ */
+
+cache_inode_status_t
+cache_inode_rdwr_async_done(cache_entry_t *entry,
+			    cache_inode_io_direction_t io_direction,
+			    struct fsal_io_arg *io_arg, bool *sync,
+			    fsal_status_t fsal_status)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	cache_inode_status_t status;
+
+	if (io_direction == CACHE_INODE_WRITE && !FSAL_IS_ERROR(fsal_status)) {
+		if (*sync && !io_arg->fsal_stable) {
+			status = cache_inode_async_commit(entry, io_arg,
+							  &fsal_status);
+			if (status != CACHE_INODE_SUCCESS)
+				return status;
+		} else {
+			*sync = io_arg->fsal_stable;
+		}
+	}
+
+	LogFullDebug(COMPONENT_FSAL,
+		     "cache_inode_rdwr_async: FSAL IO operation returned "
+		     "%d, asked_size=%zu, effective_size=%zu",
+		     fsal_status.major, io_arg->io_length, io_arg->io_amount);
+
+	if (FSAL_IS_ERROR(fsal_status)) {
+		LogDebug(COMPONENT_CACHE_INODE,
+			 "cache_inode_rdwr_async: fsal_status.major = %d",
+			 fsal_status.major);
+
+		io_arg->io_amount = 0;
+		if (fsal_status.major == ERR_FSAL_STALE)
+			cache_inode_kill_entry(entry);
+		return cache_inode_error_convert(fsal_status);
+	}
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+	if (io_direction == CACHE_INODE_WRITE)
+		status = cache_inode_refresh_attrs(entry);
+	else {
+		cache_inode_set_time_current(&obj_hdl->attributes.atime);
+		status = CACHE_INODE_SUCCESS;
+	}
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	return status;
+}
+
 /** @} */
@@ -52,6 +52,12 @@
 
 struct cache_inode_parameter cache_param;
 
+static struct config_item_list lru_policies[] = {
+	CONFIG_LIST_TOK("LRU", LRU_POLICY_LRU),
+	CONFIG_LIST_TOK("2Q", LRU_POLICY_2Q),
+	CONFIG_LIST_EOL
+};
+
 static struct config_item cache_inode_params[] = {
 	CONF_ITEM_UI32("NParts", 1, 20, 7,
 		       cache_inode_parameter, nparts),
@@ -63,6 +69,12 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, entries_hwmark),
 	CONF_ITEM_UI32("LRU_Run_Interval", 1, 24 * 3600, 90,
 		       cache_inode_parameter, lru_run_interval),
+	CONF_ITEM_ENUM("LRU_Policy", LRU_POLICY_LRU, lru_policies,
+		       cache_inode_parameter, lru_policy),
+	CONF_ITEM_UI32("LRU_Probation_Percent", 1, 100, 25,
+		       cache_inode_parameter, lru_probation_percent),
+	CONF_ITEM_UI32("LRU_Ghost_Percent", 0, 100, 50,
+		       cache_inode_parameter, lru_ghost_percent),
 	CONF_ITEM_BOOL("Cache_FDs", true,
 		       cache_inode_parameter, use_fd_cache),
 	CONF_ITEM_UI32("FD_Limit_Percent", 0, 100, 99,
@@ -81,6 +93,10 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, futility_count),
 	CONF_ITEM_BOOL("Retry_Readdir", false,
 		       cache_inode_parameter, retry_readdir),
+	CONF_ITEM_UI32("Dir_Chunk", 0, UINT32_MAX, 0,
+		       cache_inode_parameter, dir_chunk),
+	CONF_ITEM_UI32("Dir_Chunk_HWMark", 1, UINT32_MAX, 1000000,
+		       cache_inode_parameter, dir_chunk_hwmark),
 	CONFIG_EOL
 };
 
@@ -140,6 +140,11 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 		     CACHE_INODE_DIRENT_OP_REMOVE ? "REMOVE" : "RENAME",
 		     directory, name, newname);
 
+	if (dirent_op == CACHE_INODE_DIRENT_OP_REMOVE)
+		cache_inode_dir_chunks_removed(directory, name);
+	else if (dirent_op == CACHE_INODE_DIRENT_OP_RENAME)
+		cache_inode_dir_chunks_changed(directory);
+
 	/* If no active entry, do nothing */
 	if (directory->object.dir.nbactive == 0) {
 		if (!
@@ -197,8 +202,9 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 				 * old */
 				cache_entry_t *oldentry;
 				avl_dirent_set_deleted(directory, dirent);
-				cache_inode_key_dup(&dirent2->ckey,
-						    &dirent->ckey);
+				cache_inode_dirent_set_key(
+					&directory->object.dir.avl.arena,
+					dirent2, &dirent->ckey);
 				oldentry =
 				    cache_inode_get_keyed(
 					    &dirent2->ckey,
@@ -217,14 +223,14 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 			} else
 				status = CACHE_INODE_ENTRY_EXISTS;
 		} else {
-			/* Size (including terminating NUL) of the filename */
-			size_t newnamesize = strlen(newname) + 1;
 			/* try to rename--no longer in-place */
-			dirent3 = gsh_malloc(sizeof(cache_inode_dir_entry_t)
-					     + newnamesize);
-			memcpy(dirent3->name, newname, newnamesize);
-			dirent3->flags = DIR_ENTRY_FLAG_NONE;
-			cache_inode_key_dup(&dirent3->ckey, &dirent->ckey);
+			dirent3 = cache_inode_dirent_alloc(
+					&directory->object.dir.avl.arena,
+					newname, &dirent->ckey);
+			if (dirent3 == NULL) {
+				status = CACHE_INODE_MALLOC_ERROR;
+				break;
+			}
 			avl_dirent_set_deleted(directory, dirent);
 			code = cache_inode_avl_qp_insert(directory, dirent3);
 			if (code < 0) {
@@ -232,8 +238,9 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 				status = CACHE_INODE_ENTRY_EXISTS;
 				/* dirent is on persist tree, undelete it */
 				avl_dirent_clear_deleted(directory, dirent);
-				/* dirent3 was never inserted */
-				gsh_free(dirent3);
+				cache_inode_dirent_free(
+					&directory->object.dir.avl.arena,
+					dirent3);
 			}
 		}		/* !found */
 		break;
@@ -243,6 +250,15 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 		break;
 	}
 
+	/* A directory that keeps being renamed in fills its arena with
+	 * dead dirents; start over once they outweigh the live ones. */
+	if (dir_arena_wasteful(&directory->object.dir.avl.arena)) {
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "Releasing dirents of %p, arena mostly dead",
+			     directory);
+		cache_inode_release_dirents(directory, CACHE_INODE_AVL_BOTH);
+	}
+
 out:
 	return status;
 }				/* cache_inode_operate_cached_dirent */
@@ -272,7 +288,6 @@ cache_inode_add_cached_dirent(cache_entry_t *parent,
 			      cache_inode_dir_entry_t **dir_entry)
 {
 	cache_inode_dir_entry_t *new_dir_entry = NULL;
-	size_t namesize = strlen(name) + 1;
 	int code = 0;
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
@@ -283,24 +298,20 @@ cache_inode_add_cached_dirent(cache_entry_t *parent,
 	}
 
 	/* in cache inode avl, we always insert on pentry_parent */
-	new_dir_entry = gsh_malloc(sizeof(cache_inode_dir_entry_t) + namesize);
+	new_dir_entry =
+	    cache_inode_dirent_alloc(&parent->object.dir.avl.arena, name,
+				     &entry->fh_hk.key);
 	if (new_dir_entry == NULL) {
 		status = CACHE_INODE_MALLOC_ERROR;
 		return status;
 	}
 
-	new_dir_entry->flags = DIR_ENTRY_FLAG_NONE;
-
-	memcpy(&new_dir_entry->name, name, namesize);
-	cache_inode_key_dup(&new_dir_entry->ckey, &entry->fh_hk.key);
-
 	/* add to avl */
 	code = cache_inode_avl_qp_insert(parent, new_dir_entry);
 	if (code < 0) {
-		/* collision, tree not updated--release both pool objects and
-		 * return err */
-		gsh_free(new_dir_entry->ckey.kv.addr);
-		gsh_free(new_dir_entry);
+		/* collision, tree not updated */
+		cache_inode_dirent_free(&parent->object.dir.avl.arena,
+					new_dir_entry);
 		status = CACHE_INODE_ENTRY_EXISTS;
 		return status;
 	}
@@ -347,6 +358,8 @@ cache_inode_remove_cached_dirent(cache_entry_t *directory,
 
 }
 
+static cache_inode_status_t dir_chunk_populate(cache_entry_t *directory);
+
 /**
  * @brief State to be passed to FSAL readdir callbacks
  */
@@ -443,8 +456,9 @@ populate_dirent(const char *name, void *dir_state,
  * @brief Cache complete directory contents
  *
  * This function reads a complete directory from the FSAL and caches
- * both the names and filess.  The content lock must be held on the
- * directory being read.
+ * both the names and filess.  With Dir_Chunk set, a directory larger
+ * than a chunk is cached in chunks instead.  The content lock must be
+ * held on the directory being read.
  *
  * @param[in] directory  Entry for the parent directory to be read
  *
@@ -486,16 +500,22 @@ cache_inode_readdir_populate(cache_entry_t *directory)
 		return status;
 	}
 
+	/* Its first chunk tells whether the directory is huge */
+	if (cache_param.dir_chunk != 0)
+		return dir_chunk_populate(directory);
+
 	state.directory = directory;
 	state.status = &status;
 	state.offset_cookie = 0;
 
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_READDIR);
 	fsal_status =
 		directory->obj_handle->ops->readdir(directory->obj_handle,
 						    NULL,
 						    (void *)&state,
 						    populate_dirent,
 						    &eod);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_READDIR);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		if (fsal_status.major == ERR_FSAL_STALE) {
 			LogEvent(COMPONENT_NFS_READDIR,
@@ -533,6 +553,777 @@ cache_inode_readdir_populate(cache_entry_t *directory)
 	return status;
 }				/* cache_inode_readdir_populate */
 
+/**
+ * @brief Entries held in directory chunks across all directories
+ */
+
+static uint64_t dir_chunk_entries;
+
+/**
+ * @brief Chunks of all directories, least recently used first
+ */
+
+static struct glist_head dir_chunk_lru = GLIST_HEAD_INIT(dir_chunk_lru);
+static pthread_mutex_t dir_chunk_lru_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Chunks of busy directories skipped before an eviction gives up */
+#define DIR_CHUNK_EVICT_SCAN 16
+
+/**
+ * @brief Free a chunk and its entries
+ *
+ * The content lock must be held for write.
+ *
+ * @param[in,out] directory The chunked directory
+ * @param[in]     chunk     The chunk to free
+ */
+
+static void dir_chunk_free(cache_entry_t *directory, struct dir_chunk *chunk)
+{
+	struct glist_head *glist;
+	struct dir_chunk_link *link;
+
+	glist_for_each(glist, &chunk->dirents) {
+		link = glist_entry(glist, struct dir_chunk_link, chunk_list);
+		avltree_remove(&chunk_link_dirent(link)->node_hk,
+			       &directory->object.dir.chunks.ck);
+		avltree_remove(&link->node_name,
+			       &directory->object.dir.chunks.names);
+	}
+	dir_arena_release(&chunk->arena);
+
+	/* Eviction unlinks its victim itself */
+	pthread_mutex_lock(&dir_chunk_lru_mtx);
+	if (!glist_null(&chunk->lru))
+		glist_del(&chunk->lru);
+	pthread_mutex_unlock(&dir_chunk_lru_mtx);
+
+	(void)atomic_sub_uint64_t(&dir_chunk_entries, chunk->count);
+	avltree_remove(&chunk->node_whence, &directory->object.dir.chunks.t);
+	directory->object.dir.chunks.count--;
+	gsh_free(chunk);
+}
+
+/**
+ * @brief Release all chunks of a directory
+ *
+ * The content lock must be held for write.
+ *
+ * @param[in,out] entry The directory
+ */
+
+void cache_inode_release_dir_chunks(cache_entry_t *entry)
+{
+	struct avltree_node *node;
+
+	while ((node = avltree_first(&entry->object.dir.chunks.t)) != NULL)
+		dir_chunk_free(entry, avltree_container_of(node,
+							   struct dir_chunk,
+							   node_whence));
+}
+
+/**
+ * @brief Find a chunked entry by name
+ *
+ * The content lock must be held.
+ *
+ * @param[in] directory The chunked directory
+ * @param[in] name      The name
+ *
+ * @return The entry, or NULL if no cached chunk holds the name.
+ */
+
+static cache_inode_dir_entry_t *
+dir_chunk_lookup_name(cache_entry_t *directory, const char *name)
+{
+	struct avltree_node *node = directory->object.dir.chunks.names.root;
+	cache_inode_dir_entry_t *dirent;
+	int res;
+
+	while (node) {
+		dirent = chunk_link_dirent(
+			avltree_container_of(node, struct dir_chunk_link,
+					     node_name));
+		res = strcmp(name, dirent->name);
+		if (res == 0)
+			return dirent;
+		node = res < 0 ? node->left : node->right;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Note a name added to a directory
+ *
+ * Where the FSAL puts a new entry among its cookies is unknown, so any
+ * chunk may now be missing it.  If the directory is chunked, stop
+ * trusting its content so the next readdir drops the chunks and reads
+ * them again.  The content lock must be held.
+ *
+ * @param[in,out] directory The directory that changed
+ */
+
+void cache_inode_dir_chunks_changed(cache_entry_t *directory)
+{
+	if (directory->flags & CACHE_INODE_DIR_CHUNKED)
+		atomic_clear_uint32_t_bits(&directory->flags,
+					   CACHE_INODE_TRUST_CONTENT);
+}
+
+/**
+ * @brief Note a name removed from a directory
+ *
+ * Only the chunk holding the name is dropped.  A client reading past
+ * it sends a cookie that is no longer cached, and the chunk that
+ * follows the cookie is read again.  The content lock must be held for
+ * write.
+ *
+ * @param[in,out] directory The directory that changed
+ * @param[in]     name      The name removed
+ */
+
+void cache_inode_dir_chunks_removed(cache_entry_t *directory,
+				    const char *name)
+{
+	cache_inode_dir_entry_t *dirent;
+
+	if (!(directory->flags & CACHE_INODE_DIR_CHUNKED))
+		return;
+
+	dirent = dir_chunk_lookup_name(directory, name);
+	if (dirent != NULL)
+		dir_chunk_free(directory, dirent_chunk_link(dirent)->chunk);
+}
+
+/**
+ * @brief Find the cached entry that follows a cookie
+ *
+ * The content lock must be held.
+ *
+ * @param[in]  directory The chunked directory
+ * @param[in]  cookie    FSAL cookie of the last entry returned, 0 to
+ *                       start at the beginning
+ * @param[out] eod       Set if the cookie is known to end the directory
+ *
+ * @return The next entry, or NULL if it is not cached or *eod is set.
+ */
+
+static cache_inode_dir_entry_t *
+dir_chunk_seek(cache_entry_t *directory, fsal_cookie_t cookie, bool *eod)
+{
+	struct dir_chunk chunk_key, *chunk;
+	cache_inode_dir_entry_t dirent_key;
+	struct dir_chunk_link *link;
+	struct avltree_node *node;
+
+	*eod = false;
+
+	/* A chunk read from this cookie starts with the next entry */
+	chunk_key.whence = cookie;
+	node = avltree_lookup(&chunk_key.node_whence,
+			      &directory->object.dir.chunks.t);
+	if (node != NULL) {
+		chunk = avltree_container_of(node, struct dir_chunk,
+					     node_whence);
+		if (glist_empty(&chunk->dirents)) {
+			*eod = chunk->eod;
+			return NULL;
+		}
+		link = glist_first_entry(&chunk->dirents,
+					 struct dir_chunk_link, chunk_list);
+		return chunk_link_dirent(link);
+	}
+
+	/* Otherwise the entry with this cookie may be in a chunk */
+	dirent_key.hk.k = cookie;
+	node = avltree_lookup(&dirent_key.node_hk,
+			      &directory->object.dir.chunks.ck);
+	if (node == NULL)
+		return NULL;
+
+	link = dirent_chunk_link(avltree_container_of(node,
+						      cache_inode_dir_entry_t,
+						      node_hk));
+	chunk = link->chunk;
+	if (link->chunk_list.next == &chunk->dirents) {
+		/* Last of its chunk, the next one is not cached */
+		*eod = chunk->eod;
+		return NULL;
+	}
+
+	return chunk_link_dirent(glist_entry(link->chunk_list.next,
+					     struct dir_chunk_link,
+					     chunk_list));
+}
+
+/**
+ * @brief Mark a chunk as the most recently used
+ *
+ * @param[in,out] chunk The chunk
+ */
+
+static void dir_chunk_touch(struct dir_chunk *chunk)
+{
+	pthread_mutex_lock(&dir_chunk_lru_mtx);
+	if (!glist_null(&chunk->lru)) {
+		glist_del(&chunk->lru);
+		glist_add_tail(&dir_chunk_lru, &chunk->lru);
+	}
+	pthread_mutex_unlock(&dir_chunk_lru_mtx);
+}
+
+/**
+ * @brief Evict least recently used chunks of any directory
+ *
+ * Called after loading a chunk, until the chunked entries fall below
+ * Dir_Chunk_HWMark.  A chunk of another directory is only taken if
+ * that directory's content lock is free; holding ours, we must not
+ * wait for it.  The content lock of directory must be held for write.
+ *
+ * @param[in,out] directory The chunked directory
+ * @param[in]     keep      The chunk just loaded
+ */
+
+static void dir_chunk_evict(cache_entry_t *directory, struct dir_chunk *keep)
+{
+	struct glist_head *glist, *glistn;
+	struct dir_chunk *chunk, *victim;
+	cache_entry_t *owner;
+	unsigned int skipped;
+
+	while (atomic_fetch_uint64_t(&dir_chunk_entries) >
+	       cache_param.dir_chunk_hwmark) {
+		victim = NULL;
+		skipped = 0;
+
+		pthread_mutex_lock(&dir_chunk_lru_mtx);
+		glist_for_each_safe(glist, glistn, &dir_chunk_lru) {
+			chunk = glist_entry(glist, struct dir_chunk, lru);
+			if (chunk == keep)
+				continue;
+			if (chunk->directory == directory ||
+			    pthread_rwlock_trywrlock(
+				    &chunk->directory->content_lock) == 0) {
+				victim = chunk;
+				glist_del(&victim->lru);
+				break;
+			}
+			/* Busy, try it again later */
+			glist_del(&chunk->lru);
+			glist_add_tail(&dir_chunk_lru, &chunk->lru);
+			if (++skipped == DIR_CHUNK_EVICT_SCAN)
+				break;
+		}
+		pthread_mutex_unlock(&dir_chunk_lru_mtx);
+
+		if (victim == NULL)
+			break;
+
+		owner = victim->directory;
+		LogFullDebug(COMPONENT_NFS_READDIR,
+			     "Evicting chunk at %" PRIu64 " of %p",
+			     victim->whence, owner);
+		dir_chunk_free(owner, victim);
+		if (owner != directory)
+			PTHREAD_RWLOCK_unlock(&owner->content_lock);
+	}
+}
+
+/**
+ * @brief State passed to dir_chunk_dirent
+ */
+
+struct dir_chunk_load_state {
+	cache_entry_t *directory;
+	struct dir_chunk *chunk;
+	cache_inode_status_t status;
+};
+
+/**
+ * @brief Add a single entry to the chunk being loaded
+ *
+ * @param[in]     name      Name of the directory entry
+ * @param[in,out] dir_state Callback state
+ * @param[in]     cookie    Directory cookie
+ *
+ * @retval true if more entries are requested
+ * @retval false if no more should be sent and the last was not processed
+ */
+
+static bool
+dir_chunk_dirent(const char *name, void *dir_state, fsal_cookie_t cookie)
+{
+	struct dir_chunk_load_state *state = dir_state;
+	cache_entry_t *directory = state->directory;
+	struct dir_chunk *chunk = state->chunk;
+	struct fsal_obj_handle *dir_hdl = directory->obj_handle;
+	struct fsal_obj_handle *entry_hdl;
+	cache_entry_t *cache_entry = NULL;
+	cache_inode_dir_entry_t dirent_key, *dirent;
+	struct dir_chunk_link *link;
+	struct avltree_node *node;
+	fsal_status_t fsal_status;
+
+	if (chunk->count >= cache_param.dir_chunk)
+		return false;
+
+	if (cookie > UINT64_MAX - DIR_CHUNK_COOKIE_OFFSET) {
+		LogCrit(COMPONENT_NFS_READDIR,
+			"Cookie %" PRIu64 " of %s in dir %p collides with the reserved cookies",
+			cookie, name, dir_hdl);
+		state->status = CACHE_INODE_SERVERFAULT;
+		return false;
+	}
+
+	/* An older chunk overlaps this one, drop it */
+	dirent_key.hk.k = cookie;
+	node = avltree_lookup(&dirent_key.node_hk,
+			      &directory->object.dir.chunks.ck);
+	if (node != NULL) {
+		link = dirent_chunk_link(
+			avltree_container_of(node, cache_inode_dir_entry_t,
+					     node_hk));
+		if (link->chunk == chunk) {
+			LogInfo(COMPONENT_NFS_READDIR,
+				"Duplicate cookie %" PRIu64 " in dir %p",
+				cookie, dir_hdl);
+			return true;
+		}
+		dir_chunk_free(directory, link->chunk);
+	}
+
+	/* So does one that holds the name, the entry moved since */
+	dirent = dir_chunk_lookup_name(directory, name);
+	if (dirent != NULL) {
+		link = dirent_chunk_link(dirent);
+		if (link->chunk == chunk) {
+			LogInfo(COMPONENT_NFS_READDIR,
+				"Duplicate name %s in dir %p", name, dir_hdl);
+			return true;
+		}
+		dir_chunk_free(directory, link->chunk);
+	}
+
+	fsal_status = dir_hdl->ops->lookup(dir_hdl, name, &entry_hdl);
+	if (FSAL_IS_ERROR(fsal_status)) {
+		state->status = cache_inode_error_convert(fsal_status);
+		if (state->status == CACHE_INODE_FSAL_XDEV) {
+			LogInfo(COMPONENT_NFS_READDIR,
+				"Ignoring XDEV entry %s",
+				name);
+			state->status = CACHE_INODE_SUCCESS;
+			return true;
+		}
+		LogInfo(COMPONENT_CACHE_INODE,
+			"Lookup failed on %s in dir %p with %s",
+			name, dir_hdl, cache_inode_err_str(state->status));
+		return !cache_param.retry_readdir;
+	}
+
+	state->status = cache_inode_new_entry(entry_hdl, CACHE_INODE_FLAG_NONE,
+					      &cache_entry);
+	if (cache_entry == NULL) {
+		state->status = CACHE_INODE_NOT_FOUND;
+		LogEvent(COMPONENT_NFS_READDIR,
+			 "cache_inode_new_entry failed with %s",
+			 cache_inode_err_str(state->status));
+		return false;
+	}
+
+	if (cache_entry->type == DIRECTORY) {
+		/* Insert Parent's key */
+		cache_inode_key_dup(&cache_entry->object.dir.parent,
+				    &directory->fh_hk.key);
+	}
+
+	dirent = cache_inode_dirent_alloc_chunked(&chunk->arena, name,
+						  &cache_entry->fh_hk.key);
+	/* return initial ref */
+	cache_inode_put(cache_entry);
+	if (dirent == NULL) {
+		state->status = CACHE_INODE_MALLOC_ERROR;
+		return false;
+	}
+
+	dirent->hk.k = cookie;
+	dirent->hk.p = 0;
+
+	link = dirent_chunk_link(dirent);
+	link->chunk = chunk;
+	glist_add_tail(&chunk->dirents, &link->chunk_list);
+	avltree_insert(&dirent->node_hk, &directory->object.dir.chunks.ck);
+	avltree_insert(&link->node_name, &directory->object.dir.chunks.names);
+	chunk->count++;
+	(void)atomic_inc_uint64_t(&dir_chunk_entries);
+	state->status = CACHE_INODE_SUCCESS;
+
+	return true;
+}
+
+/**
+ * @brief Read one chunk of a directory from the FSAL
+ *
+ * Reads up to Dir_Chunk entries following whence.  The content lock
+ * must be held for write.
+ *
+ * @param[in,out] directory The chunked directory
+ * @param[in]     whence    FSAL cookie to read from, 0 for the start
+ * @param[out]    loaded    The chunk read, if not NULL
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t
+dir_chunk_load(cache_entry_t *directory, fsal_cookie_t whence,
+	       struct dir_chunk **loaded)
+{
+	struct dir_chunk_load_state state;
+	struct dir_chunk *chunk;
+	fsal_status_t fsal_status;
+	bool eod = false;
+
+	chunk = gsh_malloc(sizeof(struct dir_chunk));
+	if (chunk == NULL)
+		return CACHE_INODE_MALLOC_ERROR;
+
+	glist_init(&chunk->dirents);
+	dir_arena_init(&chunk->arena);
+	chunk->whence = whence;
+	chunk->count = 0;
+	chunk->eod = false;
+	chunk->directory = directory;
+	avltree_insert(&chunk->node_whence, &directory->object.dir.chunks.t);
+	directory->object.dir.chunks.count++;
+
+	pthread_mutex_lock(&dir_chunk_lru_mtx);
+	glist_add_tail(&dir_chunk_lru, &chunk->lru);
+	pthread_mutex_unlock(&dir_chunk_lru_mtx);
+
+	state.directory = directory;
+	state.chunk = chunk;
+	state.status = CACHE_INODE_SUCCESS;
+
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_READDIR);
+	fsal_status =
+		directory->obj_handle->ops->readdir(directory->obj_handle,
+						    whence ? &whence : NULL,
+						    (void *)&state,
+						    dir_chunk_dirent,
+						    &eod);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_READDIR);
+	if (FSAL_IS_ERROR(fsal_status)) {
+		dir_chunk_free(directory, chunk);
+		if (fsal_status.major == ERR_FSAL_STALE) {
+			LogEvent(COMPONENT_NFS_READDIR,
+				 "FSAL returned STALE from readdir.");
+			cache_inode_kill_entry(directory);
+		}
+		return cache_inode_error_convert(fsal_status);
+	}
+
+	chunk->eod = eod;
+	if (chunk->count == 0 && !eod) {
+		/* Only a callback failure stops an empty chunk */
+		dir_chunk_free(directory, chunk);
+		return state.status != CACHE_INODE_SUCCESS
+			? state.status : CACHE_INODE_DELAY;
+	}
+
+	LogFullDebug(COMPONENT_NFS_READDIR,
+		     "Loaded %" PRIu32 " entries at %" PRIu64 " of %p%s",
+		     chunk->count, whence, directory, eod ? " (eod)" : "");
+
+	dir_chunk_evict(directory, chunk);
+
+	if (loaded != NULL)
+		*loaded = chunk;
+
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Populate a directory, in chunks if it is huge
+ *
+ * The first Dir_Chunk entries are read as the directory's first chunk.
+ * If that reaches the end of the directory, the entries move to the
+ * whole-directory cache.  Otherwise the directory is marked chunked
+ * and keeps the chunk, so no lookup is done twice.  The content lock
+ * must be held for write, with the dirents already released.
+ *
+ * @param[in,out] directory The directory
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t dir_chunk_populate(cache_entry_t *directory)
+{
+	struct dir_arena *arena = &directory->object.dir.avl.arena;
+	cache_inode_dir_entry_t *dirent, *new_dir_entry;
+	cache_inode_status_t status;
+	struct dir_chunk *chunk;
+	struct glist_head *glist;
+
+	status = dir_chunk_load(directory, 0, &chunk);
+	if (status != CACHE_INODE_SUCCESS)
+		return status;
+
+	if (!chunk->eod) {
+		LogDebug(COMPONENT_NFS_READDIR,
+			 "Directory %p has more than %" PRIu32
+			 " entries, caching it in chunks",
+			 directory, chunk->count);
+		atomic_set_uint32_t_bits(&directory->flags,
+					 CACHE_INODE_DIR_CHUNKED);
+		return CACHE_INODE_SUCCESS;
+	}
+
+	glist_for_each(glist, &chunk->dirents) {
+		dirent = chunk_link_dirent(glist_entry(glist,
+						       struct dir_chunk_link,
+						       chunk_list));
+		new_dir_entry = cache_inode_dirent_alloc(arena, dirent->name,
+							 &dirent->ckey);
+		if (new_dir_entry == NULL) {
+			status = CACHE_INODE_MALLOC_ERROR;
+			break;
+		}
+		if (cache_inode_avl_qp_insert(directory, new_dir_entry) < 0) {
+			/* collision, tree not updated */
+			cache_inode_dirent_free(arena, new_dir_entry);
+			continue;
+		}
+		directory->object.dir.nbactive++;
+	}
+	dir_chunk_free(directory, chunk);
+
+	if (status != CACHE_INODE_SUCCESS) {
+		cache_inode_release_dirents(directory, CACHE_INODE_AVL_BOTH);
+		return status;
+	}
+
+	atomic_set_uint32_t_bits(&directory->flags, CACHE_INODE_DIR_POPULATED);
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Pass one cached entry to the readdir callback
+ *
+ * @param[in]     directory   The directory being read
+ * @param[in]     dirent      The entry
+ * @param[in]     attr_status Result of the attribute permission check
+ * @param[in,out] cb_parms    Callback parameters
+ * @param[in]     cb          The callback
+ * @param[in,out] retry_stale Whether an ESTALE may still be retried
+ * @param[in,out] nbfound     Count of entries returned
+ *
+ * @return CACHE_INODE_SUCCESS if the entry was returned or skipped,
+ *         otherwise the error that ends the readdir.
+ */
+
+static cache_inode_status_t
+cache_inode_readdir_dirent(cache_entry_t *directory,
+			   cache_inode_dir_entry_t *dirent,
+			   cache_inode_status_t attr_status,
+			   struct cache_inode_readdir_cb_parms *cb_parms,
+			   cache_inode_getattr_cb_t cb,
+			   bool *retry_stale, unsigned int *nbfound)
+{
+	cache_entry_t *entry = NULL;
+	cache_inode_status_t status;
+	cache_inode_status_t tmp_status = 0;
+
+ estale_retry:
+	LogFullDebug(COMPONENT_NFS_READDIR,
+		     "Lookup direct %s",
+		     dirent->name);
+
+	entry =
+	    cache_inode_get_keyed(&dirent->ckey,
+				  CIG_KEYED_FLAG_NONE, &tmp_status);
+	if (!entry) {
+		LogFullDebug(COMPONENT_NFS_READDIR,
+			     "Lookup returned %s",
+			     cache_inode_err_str(tmp_status));
+
+		if (*retry_stale
+		    && tmp_status == CACHE_INODE_FSAL_ESTALE) {
+			LogDebug(COMPONENT_NFS_READDIR,
+				 "cache_inode_get_keyed returned %s "
+				 "for %s - retrying entry",
+				 cache_inode_err_str(tmp_status),
+				 dirent->name);
+			*retry_stale = false; /* only one retry per dirent */
+			goto estale_retry;
+		}
+
+		if (tmp_status == CACHE_INODE_NOT_FOUND
+		    || tmp_status == CACHE_INODE_FSAL_ESTALE) {
+			/* Directory changed out from under us.
+			   Invalidate it, skip the name, and keep
+			   going. */
+			atomic_clear_uint32_t_bits(
+				&directory->flags,
+				CACHE_INODE_TRUST_CONTENT);
+			LogDebug(COMPONENT_NFS_READDIR,
+				 "cache_inode_get_keyed returned %s "
+				 "for %s - skipping entry",
+				 cache_inode_err_str(tmp_status),
+				 dirent->name);
+			return CACHE_INODE_SUCCESS;
+		} else {
+			/* Something is more seriously wrong,
+			   probably an inconsistency. */
+			status = tmp_status;
+			LogCrit(COMPONENT_NFS_READDIR,
+				"cache_inode_get_keyed returned %s "
+				"for %s - bailing out",
+				cache_inode_err_str(status),
+				dirent->name);
+			return status;
+		}
+	}
+
+	LogFullDebug(COMPONENT_NFS_READDIR,
+		     "cache_inode_readdir: dirent=%p name=%s "
+		     "cookie=%" PRIu64 " (probes %d)", dirent,
+		     dirent->name, dirent->hk.k, dirent->hk.p);
+
+	cb_parms->name = dirent->name;
+	cb_parms->attr_allowed = attr_status == CACHE_INODE_SUCCESS;
+	cb_parms->cookie = (dirent->flags & DIR_ENTRY_FLAG_CHUNKED)
+		? dirent->hk.k + DIR_CHUNK_COOKIE_OFFSET : dirent->hk.k;
+
+	tmp_status = cache_inode_getattr(entry, cb_parms, cb);
+
+	if (tmp_status != CACHE_INODE_SUCCESS) {
+		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
+		if (tmp_status == CACHE_INODE_FSAL_ESTALE) {
+			if (*retry_stale) {
+				LogDebug(COMPONENT_NFS_READDIR,
+					 "cache_inode_getattr returned "
+					 "%s for %s - retrying entry",
+					 cache_inode_err_str
+					 (tmp_status), dirent->name);
+				/* only one retry per dirent */
+				*retry_stale = false;
+				goto estale_retry;
+			}
+
+			/* Directory changed out from under us.
+			   Invalidate it, skip the name, and keep
+			   going. */
+			atomic_clear_uint32_t_bits(
+				&directory->flags,
+				CACHE_INODE_TRUST_CONTENT);
+
+			LogDebug(COMPONENT_NFS_READDIR,
+				 "cache_inode_lock_trust_attrs "
+				 "returned %s for %s - skipping entry",
+				 cache_inode_err_str(tmp_status),
+				 dirent->name);
+			return CACHE_INODE_SUCCESS;
+		}
+
+		status = tmp_status;
+
+		LogCrit(COMPONENT_NFS_READDIR,
+			"cache_inode_lock_trust_attrs returned %s for "
+			"%s - bailing out",
+			cache_inode_err_str(status), dirent->name);
+
+		return status;
+	}
+
+	(*nbfound)++;
+
+	cache_inode_lru_unref(entry, LRU_FLAG_NONE);
+
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Read a chunked directory
+ *
+ * Entries are served from the cached chunks, and a chunk that is not
+ * cached is read from the FSAL at the cookie the client sent.  Called
+ * with the content lock held for read or write; takes it for write
+ * when a chunk must be loaded.
+ *
+ * @param[in]     directory   The directory to be read
+ * @param[in]     cookie      FSAL cookie of the last entry the client has
+ * @param[out]    nbfound     Number of entries returned
+ * @param[out]    eod_met     Whether the end of directory was met
+ * @param[in]     attr_status Result of the attribute permission check
+ * @param[in,out] cb_parms    Callback parameters
+ * @param[in]     cb          The callback function to receive entries
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t
+cache_inode_readdir_chunked(cache_entry_t *directory, fsal_cookie_t cookie,
+			    unsigned int *nbfound, bool *eod_met,
+			    cache_inode_status_t attr_status,
+			    struct cache_inode_readdir_cb_parms *cb_parms,
+			    cache_inode_getattr_cb_t cb)
+{
+	cache_inode_status_t status = CACHE_INODE_SUCCESS;
+	cache_inode_dir_entry_t *dirent;
+	struct dir_chunk *chunk = NULL;
+	bool retry_stale = true;
+	bool wrlocked = false;
+
+	*nbfound = 0;
+	*eod_met = false;
+
+	/* Undo the shift of cookies past "." and ".." */
+	if (cookie != 0) {
+		if (cookie <= DIR_CHUNK_COOKIE_OFFSET)
+			return CACHE_INODE_BAD_COOKIE;
+		cookie -= DIR_CHUNK_COOKIE_OFFSET;
+	}
+
+	while (cb_parms->in_result) {
+		dirent = dir_chunk_seek(directory, cookie, eod_met);
+		if (*eod_met)
+			break;
+
+		if (dirent == NULL) {
+			if (!wrlocked) {
+				/* Someone may load it while we wait */
+				PTHREAD_RWLOCK_unlock(&directory->content_lock);
+				PTHREAD_RWLOCK_wrlock(&directory->content_lock);
+				wrlocked = true;
+				continue;
+			}
+			status = dir_chunk_load(directory, cookie, NULL);
+			if (status != CACHE_INODE_SUCCESS)
+				break;
+			continue;
+		}
+
+		if (dirent_chunk_link(dirent)->chunk != chunk) {
+			chunk = dirent_chunk_link(dirent)->chunk;
+			dir_chunk_touch(chunk);
+		}
+
+		status = cache_inode_readdir_dirent(directory, dirent,
+						    attr_status, cb_parms,
+						    cb, &retry_stale, nbfound);
+		if (status != CACHE_INODE_SUCCESS)
+			break;
+
+		cookie = dirent->hk.k;
+	}
+
+	LogDebug(COMPONENT_NFS_READDIR,
+		 "chunked readdir of %p nbfound = %u, eod = %s, status = %s",
+		 directory, *nbfound, *eod_met ? "TRUE" : "FALSE",
+		 cache_inode_err_str(status));
+
+	return status;
+}
+
 /**
  * @brief Reads a directory
  *
@@ -643,7 +1434,8 @@ cache_inode_readdir(cache_entry_t *directory,
 	PTHREAD_RWLOCK_unlock(&directory->attr_lock);
 	if (!
 	    ((directory->flags & CACHE_INODE_TRUST_CONTENT)
-	     && (directory->flags & CACHE_INODE_DIR_POPULATED))) {
+	     && (directory->flags & (CACHE_INODE_DIR_POPULATED |
+				     CACHE_INODE_DIR_CHUNKED)))) {
 		PTHREAD_RWLOCK_unlock(&directory->content_lock);
 		PTHREAD_RWLOCK_wrlock(&directory->content_lock);
 		status = cache_inode_readdir_populate(directory);
@@ -655,6 +1447,14 @@ cache_inode_readdir(cache_entry_t *directory,
 		}
 	}
 
+	if (directory->flags & CACHE_INODE_DIR_CHUNKED) {
+		status = cache_inode_readdir_chunked(directory, cookie,
+						     nbfound, eod_met,
+						     attr_status, &cb_parms,
+						     cb);
+		goto unlock_dir;
+	}
+
 	/* deal with initial cookie value:
 	 * 1. cookie is invalid (-should- be checked by caller)
 	 * 2. cookie is 0 (first cookie) -- ok
@@ -719,118 +1519,15 @@ cache_inode_readdir(cache_entry_t *directory,
 	for (; cb_parms.in_result && dirent_node;
 	     dirent_node = avltree_next(dirent_node)) {
 
-		cache_entry_t *entry = NULL;
-		cache_inode_status_t tmp_status = 0;
-
 		dirent =
 		    avltree_container_of(dirent_node, cache_inode_dir_entry_t,
 					 node_hk);
 
- estale_retry:
-		LogFullDebug(COMPONENT_NFS_READDIR,
-			     "Lookup direct %s",
-			     dirent->name);
-
-		entry =
-		    cache_inode_get_keyed(&dirent->ckey,
-					  CIG_KEYED_FLAG_NONE, &tmp_status);
-		if (!entry) {
-			LogFullDebug(COMPONENT_NFS_READDIR,
-				     "Lookup returned %s",
-				     cache_inode_err_str(tmp_status));
-
-			if (retry_stale
-			    && tmp_status == CACHE_INODE_FSAL_ESTALE) {
-				LogDebug(COMPONENT_NFS_READDIR,
-					 "cache_inode_get_keyed returned %s "
-					 "for %s - retrying entry",
-					 cache_inode_err_str(tmp_status),
-					 dirent->name);
-				retry_stale = false; /* only one retry per
-						      * dirent */
-				goto estale_retry;
-			}
-
-			if (tmp_status == CACHE_INODE_NOT_FOUND
-			    || tmp_status == CACHE_INODE_FSAL_ESTALE) {
-				/* Directory changed out from under us.
-				   Invalidate it, skip the name, and keep
-				   going. */
-				atomic_clear_uint32_t_bits(
-					&directory->flags,
-					CACHE_INODE_TRUST_CONTENT);
-				LogDebug(COMPONENT_NFS_READDIR,
-					 "cache_inode_get_keyed returned %s "
-					 "for %s - skipping entry",
-					 cache_inode_err_str(tmp_status),
-					 dirent->name);
-				continue;
-			} else {
-				/* Something is more seriously wrong,
-				   probably an inconsistency. */
-				status = tmp_status;
-				LogCrit(COMPONENT_NFS_READDIR,
-					"cache_inode_get_keyed returned %s "
-					"for %s - bailing out",
-					cache_inode_err_str(status),
-					dirent->name);
-				goto unlock_dir;
-			}
-		}
-
-		LogFullDebug(COMPONENT_NFS_READDIR,
-			     "cache_inode_readdir: dirent=%p name=%s "
-			     "cookie=%" PRIu64 " (probes %d)", dirent,
-			     dirent->name, dirent->hk.k, dirent->hk.p);
-
-		cb_parms.name = dirent->name;
-		cb_parms.attr_allowed = attr_status == CACHE_INODE_SUCCESS;
-		cb_parms.cookie = dirent->hk.k;
-
-		tmp_status = cache_inode_getattr(entry, &cb_parms, cb);
-
-		if (tmp_status != CACHE_INODE_SUCCESS) {
-			cache_inode_lru_unref(entry, LRU_FLAG_NONE);
-			if (tmp_status == CACHE_INODE_FSAL_ESTALE) {
-				if (retry_stale) {
-					LogDebug(COMPONENT_NFS_READDIR,
-						 "cache_inode_getattr returned "
-						 "%s for %s - retrying entry",
-						 cache_inode_err_str
-						 (tmp_status), dirent->name);
-					retry_stale = false; /* only one retry
-							      * per dirent */
-					goto estale_retry;
-				}
-
-				/* Directory changed out from under us.
-				   Invalidate it, skip the name, and keep
-				   going. */
-				atomic_clear_uint32_t_bits(
-					&directory->flags,
-					CACHE_INODE_TRUST_CONTENT);
-
-				LogDebug(COMPONENT_NFS_READDIR,
-					 "cache_inode_lock_trust_attrs "
-					 "returned %s for %s - skipping entry",
-					 cache_inode_err_str(tmp_status),
-					 dirent->name);
-				continue;
-			}
-
-			status = tmp_status;
-
-			LogCrit(COMPONENT_NFS_READDIR,
-				"cache_inode_lock_trust_attrs returned %s for "
-				"%s - bailing out",
-				cache_inode_err_str(status), dirent->name);
-
+		status = cache_inode_readdir_dirent(directory, dirent,
+						    attr_status, &cb_parms,
+						    cb, &retry_stale, nbfound);
+		if (status != CACHE_INODE_SUCCESS)
 			goto unlock_dir;
-		}
-
-		(*nbfound)++;
-
-		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 
 		if (!cb_parms.in_result) {
 			LogDebug(COMPONENT_NFS_READDIR,
@@ -136,8 +136,10 @@ cache_inode_remove(cache_entry_t *entry, const char *name)
 		}
 	}
 
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_UNLINK);
 	fsal_status =
 	    entry->obj_handle->ops->unlink(entry->obj_handle, name);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_UNLINK);
 
 	if (FSAL_IS_ERROR(fsal_status)) {
 		if (fsal_status.major == ERR_FSAL_STALE)
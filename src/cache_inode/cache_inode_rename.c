@@ -261,10 +261,12 @@ cache_inode_rename(cache_entry_t *dir_src,
 	 */
 	LogFullDebug(COMPONENT_CACHE_INODE, "about to call FSAL rename");
 
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_RENAME);
 	fsal_status =
 	    dir_src->obj_handle->ops->rename(dir_src->obj_handle,
 					     oldname, dir_dest->obj_handle,
 					     newname);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_RENAME);
 
 	LogFullDebug(COMPONENT_CACHE_INODE, "returned from FSAL rename");
 
@@ -364,6 +366,7 @@ cache_inode_rename(cache_entry_t *dir_src,
 			cache_inode_invalidate_all_cached_dirent(dir_dest);
 		}
 
+		cache_inode_dir_chunks_changed(dir_dest);
 		tmp_status =
 		    cache_inode_add_cached_dirent(dir_dest, newname, lookup_src,
 						  NULL);
@@ -106,7 +106,9 @@ cache_inode_setattr(cache_entry_t *entry,
 
 	saved_acl = obj_handle->attributes.acl;
 	before = obj_handle->attributes.change;
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_SETATTRS);
 	fsal_status = obj_handle->ops->setattrs(obj_handle, attr);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_SETATTRS);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		status = cache_inode_error_convert(fsal_status);
 		if (fsal_status.major == ERR_FSAL_STALE) {
@@ -116,7 +118,9 @@ cache_inode_setattr(cache_entry_t *entry,
 		}
 		goto unlock;
 	}
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_GETATTRS);
 	fsal_status = obj_handle->ops->getattrs(obj_handle);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_GETATTRS);
 	*attr = obj_handle->attributes;
 	if (FSAL_IS_ERROR(fsal_status)) {
 		status = cache_inode_error_convert(fsal_status);
@@ -39,6 +39,15 @@
  * determines which of the partitions (each containing a tree and each
  * separately locked), and a hash which acts as the key within an
  * individual Red-Black Tree.
+ *
+ * Tables created with HT_FLAG_OPEN_ADDR keep the same partitioning
+ * and API, but each partition is an array of cache-line sized,
+ * open-addressed buckets instead of a tree.  Lookups in such tables
+ * take no lock: a reader announces itself in the partition's current
+ * epoch, and writers (which still serialize on the partition lock)
+ * wait for the readers of the epoch to leave before freeing anything
+ * they unlinked.  Bucket arrays grow by incremental migration,
+ * a few buckets per write.
  */
 
 #include "config.h"
@@ -226,6 +235,457 @@ key_locate(struct hash_table *ht, const struct gsh_buffdesc *key,
 	return HASHTABLE_SUCCESS;
 }
 
+/*
+ * Open-addressed backend (HT_FLAG_OPEN_ADDR)
+ */
+
+/**
+ * @brief Buckets in a partition's first array
+ */
+#define HASH_OA_INITIAL_BUCKETS 64
+
+/**
+ * @brief Buckets of a draining array moved per write operation
+ */
+#define HASH_OA_MIGRATE_STEP 16
+
+/**
+ * @brief Whether a table uses the open-addressed backend
+ *
+ * @param[in] ht The hash table
+ *
+ * @return true for open addressing, false for red-black trees.
+ */
+static inline bool
+oa_table(const struct hash_table *ht)
+{
+	return (ht->parameter.flags & HT_FLAG_OPEN_ADDR) != 0;
+}
+
+/**
+ * @brief Home bucket of a hash in an array
+ *
+ * The partition index was derived from the same hash, so mix it
+ * before masking.
+ *
+ * @param[in] arr  The bucket array
+ * @param[in] hash The key's hash
+ *
+ * @return Bucket index.
+ */
+static inline uint32_t
+oa_bucket_of(const struct hash_oa_array *arr, uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return (uint32_t) hash & arr->mask;
+}
+
+/**
+ * @brief Allocate an empty bucket array
+ *
+ * @param[in] nbuckets Number of buckets, a power of two
+ *
+ * @return The array or NULL.
+ */
+static struct hash_oa_array *
+oa_array_alloc(uint32_t nbuckets)
+{
+	struct hash_oa_array *arr = gsh_calloc(1, sizeof(*arr));
+
+	if (arr == NULL)
+		return NULL;
+
+	arr->buckets = gsh_malloc_aligned(sizeof(struct hash_oa_bucket),
+					  nbuckets *
+					  sizeof(struct hash_oa_bucket));
+	if (arr->buckets == NULL) {
+		gsh_free(arr);
+		return NULL;
+	}
+	memset(arr->buckets, 0, nbuckets * sizeof(struct hash_oa_bucket));
+	arr->mask = nbuckets - 1;
+	arr->used = 0;
+
+	return arr;
+}
+
+static void
+oa_array_free(struct hash_oa_array *arr)
+{
+	gsh_free(arr->buckets);
+	gsh_free(arr);
+}
+
+/**
+ * @brief Leave a lock-free read section on a partition
+ *
+ * @param[in] partition The partition that was read
+ * @param[in] phase     The phase returned by oa_read_enter
+ */
+static inline void
+oa_read_exit(struct hash_partition *partition, int phase)
+{
+	if (atomic_dec_uint32_t(&partition->oa_readers[phase]) != 0 ||
+	    atomic_fetch_uint32_t(&partition->oa_waiting) == 0)
+		return;
+
+	/* Last reader out while a writer sleeps */
+	pthread_mutex_lock(&partition->oa_mtx);
+	pthread_cond_broadcast(&partition->oa_cond);
+	pthread_mutex_unlock(&partition->oa_mtx);
+}
+
+/**
+ * @brief Enter a lock-free read section on a partition
+ *
+ * @param[in] partition The partition to be read
+ *
+ * @return The epoch phase to pass to oa_read_exit.
+ */
+static inline int
+oa_read_enter(struct hash_partition *partition)
+{
+	uint32_t epoch;
+	int phase;
+
+	for (;;) {
+		epoch = atomic_fetch_uint32_t(&partition->oa_epoch);
+		phase = epoch & 1;
+		atomic_inc_uint32_t(&partition->oa_readers[phase]);
+		if (atomic_fetch_uint32_t(&partition->oa_epoch) == epoch)
+			return phase;
+		/* Raced with a writer flipping the epoch */
+		oa_read_exit(partition, phase);
+	}
+}
+
+/**
+ * @brief Wait for the readers of one epoch phase to leave
+ *
+ * The writer announces itself in oa_waiting before looking at the
+ * count again, and the last reader out looks at oa_waiting after
+ * dropping the count, so one of them sees the other and the wakeup
+ * cannot be lost.
+ *
+ * @param[in] partition The partition, locked for writing
+ * @param[in] phase     The phase to drain
+ */
+static void
+oa_wait_readers(struct hash_partition *partition, int phase)
+{
+	uint32_t *readers = &partition->oa_readers[phase];
+
+	if (atomic_fetch_uint32_t(readers) == 0)
+		return;
+
+	pthread_mutex_lock(&partition->oa_mtx);
+	atomic_inc_uint32_t(&partition->oa_waiting);
+	while (atomic_fetch_uint32_t(readers) != 0)
+		pthread_cond_wait(&partition->oa_cond, &partition->oa_mtx);
+	atomic_dec_uint32_t(&partition->oa_waiting);
+	pthread_mutex_unlock(&partition->oa_mtx);
+}
+
+/**
+ * @brief Wait out the readers of a partition
+ *
+ * On return, no reader can still hold a pointer to anything that was
+ * unlinked before the call.  The partition lock must be held for
+ * writing.
+ *
+ * @param[in] partition The partition
+ */
+static void
+oa_synchronize(struct hash_partition *partition)
+{
+	uint32_t epoch = atomic_fetch_uint32_t(&partition->oa_epoch);
+
+	oa_wait_readers(partition, (epoch + 1) & 1);
+	atomic_store_uint32_t(&partition->oa_epoch, epoch + 1);
+	oa_wait_readers(partition, epoch & 1);
+}
+
+/**
+ * @brief Search one bucket array for a key
+ *
+ * @param[in]  ht    The hash table
+ * @param[in]  arr   The bucket array
+ * @param[in]  key   The key to look up
+ * @param[in]  hash  The key's hash
+ * @param[out] found The entry, if found
+ *
+ * @return The slot holding the key, or NULL.
+ */
+static struct hash_oa_slot *
+oa_probe(struct hash_table *ht, struct hash_oa_array *arr,
+	 const struct gsh_buffdesc *key, uint64_t hash,
+	 struct hash_data **found)
+{
+	uint32_t first = oa_bucket_of(arr, hash);
+	struct hash_oa_bucket *bucket;
+	struct hash_oa_slot *slot;
+	struct hash_data *data;
+	uint32_t n, i;
+
+	for (n = 0; n <= arr->mask; ++n) {
+		bucket = &arr->buckets[(first + n) & arr->mask];
+		for (i = 0; i < HASH_OA_SLOTS; ++i) {
+			slot = &bucket->slot[i];
+			data = atomic_fetch_voidptr((void **)&slot->data);
+			if (data == NULL)
+				return NULL;
+			if (data == HASH_OA_TOMBSTONE)
+				continue;
+			if (atomic_fetch_uint64_t(&slot->hash) == hash
+			    && ht->parameter.
+			    compare_key((struct gsh_buffdesc *)key,
+					&data->key) == 0) {
+				*found = data;
+				return slot;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Search a partition for a key
+ *
+ * While a resize is in progress, entries not yet migrated are only
+ * in the draining array, so both arrays are searched.
+ *
+ * @param[in]  ht        The hash table
+ * @param[in]  partition The partition
+ * @param[in]  key       The key to look up
+ * @param[in]  hash      The key's hash
+ * @param[out] found     The entry, if found
+ *
+ * @return The slot holding the key, or NULL.
+ */
+static struct hash_oa_slot *
+oa_locate(struct hash_table *ht, struct hash_partition *partition,
+	  const struct gsh_buffdesc *key, uint64_t hash,
+	  struct hash_data **found)
+{
+	struct hash_oa_array *arr;
+	struct hash_oa_slot *slot = NULL;
+
+	arr = atomic_fetch_voidptr((void **)&partition->oa);
+	if (arr != NULL)
+		slot = oa_probe(ht, arr, key, hash, found);
+
+	if (slot == NULL) {
+		arr = atomic_fetch_voidptr((void **)&partition->oa_old);
+		if (arr != NULL)
+			slot = oa_probe(ht, arr, key, hash, found);
+	}
+
+	return slot;
+}
+
+/**
+ * @brief Put an entry into a free slot of an array
+ *
+ * @param[in] arr  The bucket array
+ * @param[in] hash The key's hash
+ * @param[in] data The entry
+ *
+ * @return true on success, false if the array is full.
+ */
+static bool
+oa_place(struct hash_oa_array *arr, uint64_t hash, struct hash_data *data)
+{
+	uint32_t first = oa_bucket_of(arr, hash);
+	struct hash_oa_bucket *bucket;
+	struct hash_oa_slot *slot;
+	uint32_t n, i;
+
+	for (n = 0; n <= arr->mask; ++n) {
+		bucket = &arr->buckets[(first + n) & arr->mask];
+		for (i = 0; i < HASH_OA_SLOTS; ++i) {
+			slot = &bucket->slot[i];
+			if (slot->data != NULL && slot->data != HASH_OA_TOMBSTONE)
+				continue;
+			if (slot->data == NULL)
+				++arr->used;
+			/* Readers check the hash after seeing the entry */
+			atomic_store_uint64_t(&slot->hash, hash);
+			atomic_store_voidptr((void **)&slot->data, data);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Replace the slot pointing at an entry
+ *
+ * @param[in] arr  The bucket array, may be NULL
+ * @param[in] hash The entry's hash
+ * @param[in] from The entry to replace
+ * @param[in] to   The replacement, or HASH_OA_TOMBSTONE
+ */
+static void
+oa_retarget(struct hash_oa_array *arr, uint64_t hash,
+	    struct hash_data *from, struct hash_data *to)
+{
+	struct hash_oa_bucket *bucket;
+	uint32_t first;
+	uint32_t n, i;
+
+	if (arr == NULL)
+		return;
+
+	first = oa_bucket_of(arr, hash);
+	for (n = 0; n <= arr->mask; ++n) {
+		bucket = &arr->buckets[(first + n) & arr->mask];
+		for (i = 0; i < HASH_OA_SLOTS; ++i) {
+			if (bucket->slot[i].data == NULL)
+				return;
+			if (bucket->slot[i].data == from) {
+				atomic_store_voidptr((void **)
+						     &bucket->slot[i].data, to);
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Move buckets from the draining array to the current one
+ *
+ * Entries are copied, not moved, so a reader still holding the old
+ * array finds them.  Once all buckets are copied the old array is
+ * retired and, after the readers leave, freed.
+ *
+ * @param[in] partition The partition, locked for writing
+ * @param[in] nbuckets  Maximum number of buckets to migrate
+ */
+static void
+oa_migrate(struct hash_partition *partition, uint32_t nbuckets)
+{
+	struct hash_oa_array *old = partition->oa_old;
+	struct hash_oa_bucket *bucket;
+	struct hash_data *data;
+	uint32_t i;
+
+	if (old == NULL)
+		return;
+
+	while (nbuckets-- > 0 && partition->oa_migrated <= old->mask) {
+		bucket = &old->buckets[partition->oa_migrated++];
+		for (i = 0; i < HASH_OA_SLOTS; ++i) {
+			data = bucket->slot[i].data;
+			if (data == NULL || data == HASH_OA_TOMBSTONE)
+				continue;
+			if (!oa_place(partition->oa, bucket->slot[i].hash,
+				      data)) {
+				/* The new array is at least as large as
+				   the old one was when it was retired. */
+				LogFatal(COMPONENT_HASHTABLE,
+					 "Bucket array overflow during resize");
+			}
+		}
+	}
+
+	if (partition->oa_migrated <= old->mask)
+		return;
+
+	atomic_store_voidptr((void **)&partition->oa_old, NULL);
+	oa_synchronize(partition);
+	oa_array_free(old);
+}
+
+/**
+ * @brief Start a resize if the current array is getting full
+ *
+ * Arrays are kept at most three quarters used, counting tombstones.
+ * An array that is mostly tombstones is rebuilt at the same size.
+ *
+ * @param[in] partition The partition, locked for writing
+ */
+static void
+oa_maybe_grow(struct hash_partition *partition)
+{
+	struct hash_oa_array *arr = partition->oa;
+	struct hash_oa_array *bigger;
+	uint32_t nslots = (arr->mask + 1) * HASH_OA_SLOTS;
+	uint32_t nbuckets = arr->mask + 1;
+
+	if ((uint64_t) (arr->used + 1) * 4 <= (uint64_t) nslots * 3)
+		return;
+
+	/* A resize still in progress must finish first */
+	if (partition->oa_old != NULL) {
+		oa_migrate(partition, UINT32_MAX);
+		arr = partition->oa;
+		nslots = (arr->mask + 1) * HASH_OA_SLOTS;
+		nbuckets = arr->mask + 1;
+		if ((uint64_t) (arr->used + 1) * 4 <= (uint64_t) nslots * 3)
+			return;
+	}
+
+	if (partition->count * 2 >= nslots / 2)
+		nbuckets *= 2;
+
+	bigger = oa_array_alloc(nbuckets);
+	if (bigger == NULL) {
+		LogMajor(COMPONENT_HASHTABLE,
+			 "Unable to grow hash partition to %" PRIu32
+			 " buckets", nbuckets);
+		return;
+	}
+
+	atomic_store_voidptr((void **)&partition->oa_old, arr);
+	partition->oa_migrated = 0;
+	atomic_store_voidptr((void **)&partition->oa, bigger);
+}
+
+/**
+ * @brief Visit every entry of a partition
+ *
+ * Buckets of a draining array that were already migrated are
+ * skipped, so each entry is visited once.
+ *
+ * @param[in] arr      The current array
+ * @param[in] old      The draining array, or NULL
+ * @param[in] migrated Buckets of old already migrated
+ * @param[in] visit    Function called on each entry
+ * @param[in] arg      Argument to visit
+ */
+static void
+oa_walk(struct hash_oa_array *arr, struct hash_oa_array *old,
+	uint32_t migrated, void (*visit)(struct hash_data *, void *),
+	void *arg)
+{
+	struct hash_data *data;
+	uint32_t b, i;
+
+	if (arr != NULL) {
+		for (b = 0; b <= arr->mask; ++b) {
+			for (i = 0; i < HASH_OA_SLOTS; ++i) {
+				data = arr->buckets[b].slot[i].data;
+				if (data != NULL && data != HASH_OA_TOMBSTONE)
+					visit(data, arg);
+			}
+		}
+	}
+
+	if (old != NULL) {
+		for (b = migrated; b <= old->mask; ++b) {
+			for (i = 0; i < HASH_OA_SLOTS; ++i) {
+				data = old->buckets[b].slot[i].data;
+				if (data != NULL && data != HASH_OA_TOMBSTONE)
+					visit(data, arg);
+			}
+		}
+	}
+}
+
 /**
  * @brief Compute the values to search a hash store
  *
@@ -341,6 +801,19 @@ hashtable_init(struct hash_param *hparam)
 			goto deconstruct;
 		}
 
+		if (hparam->flags & HT_FLAG_OPEN_ADDR) {
+			partition->oa =
+			    oa_array_alloc(HASH_OA_INITIAL_BUCKETS);
+			if (!(partition->oa)) {
+				pthread_rwlock_destroy(&partition->lock);
+				goto deconstruct;
+			}
+			pthread_mutex_init(&partition->oa_mtx, NULL);
+			pthread_cond_init(&partition->oa_cond, NULL);
+			completed++;
+			continue;
+		}
+
 		/* Allocate a cache if requested */
 		if (hparam->flags & HT_FLAG_CACHE) {
 			partition->cache = gsh_calloc(1, cache_page_size(ht));
@@ -370,10 +843,15 @@ hashtable_init(struct hash_param *hparam)
  deconstruct:
 
 	while (completed != 0) {
-		if (hparam->flags & HT_FLAG_CACHE)
-			gsh_free(ht->partitions[completed - 1].cache);
-
-		pthread_rwlock_destroy(&(ht->partitions[completed - 1].lock));
+		partition = &ht->partitions[completed - 1];
+		if (partition->oa) {
+			oa_array_free(partition->oa);
+			pthread_mutex_destroy(&partition->oa_mtx);
+			pthread_cond_destroy(&partition->oa_cond);
+		} else if (hparam->flags & HT_FLAG_CACHE)
+			gsh_free(partition->cache);
+
+		pthread_rwlock_destroy(&partition->lock);
 		completed--;
 	}
 	if (ht->node_pool)
@@ -417,6 +895,18 @@ hashtable_destroy(struct hash_table *ht,
 			ht->partitions[index].cache = NULL;
 		}
 
+		if (ht->partitions[index].oa_old) {
+			oa_array_free(ht->partitions[index].oa_old);
+			ht->partitions[index].oa_old = NULL;
+		}
+
+		if (ht->partitions[index].oa) {
+			oa_array_free(ht->partitions[index].oa);
+			ht->partitions[index].oa = NULL;
+			pthread_mutex_destroy(&ht->partitions[index].oa_mtx);
+			pthread_cond_destroy(&ht->partitions[index].oa_cond);
+		}
+
 		pthread_rwlock_destroy(&(ht->partitions[index].lock));
 	}
 	pool_destroy(ht->node_pool);
@@ -427,6 +917,67 @@ hashtable_destroy(struct hash_table *ht,
 	return hrc;
 }
 
+/**
+ * @brief Look up an entry in an open-addressed table
+ *
+ * Reads, latched or not, take no lock: the latch holds the reader
+ * epoch instead, which keeps the entry from being freed until it is
+ * released.  Writes lock the partition as in the tree case.
+ *
+ * @param[in]  ht        The hash table to search
+ * @param[in]  key       The key for which to search
+ * @param[out] val       The value found
+ * @param[in]  may_write Whether the followup call might mutate the table
+ * @param[out] latch     Retained state, may be NULL for reads
+ * @param[in]  index     Partition index
+ * @param[in]  hash      Hash of the key
+ *
+ * @retval HASHTABLE_SUCCESS The entry was found.
+ * @retval HASHTABLE_ERROR_NO_SUCH_KEY The entry was not found.
+ */
+static hash_error_t
+oa_getlatch(struct hash_table *ht, const struct gsh_buffdesc *key,
+	    struct gsh_buffdesc *val, bool may_write,
+	    struct hash_latch *latch, uint32_t index, uint64_t hash)
+{
+	struct hash_partition *partition = &ht->partitions[index];
+	struct hash_data *data = NULL;
+	struct hash_oa_slot *slot;
+	int phase = -1;
+
+	if (may_write)
+		PTHREAD_RWLOCK_wrlock(&partition->lock);
+	else
+		phase = oa_read_enter(partition);
+
+	slot = oa_locate(ht, partition, key, hash, &data);
+
+	if (slot != NULL && val != NULL) {
+		val->addr = data->val.addr;
+		val->len = data->val.len;
+	}
+
+	if (latch != NULL) {
+		latch->index = index;
+		latch->rbt_hash = hash;
+		latch->locator = NULL;
+		latch->slot = slot;
+		latch->oa_phase = phase;
+	} else {
+		oa_read_exit(partition, phase);
+	}
+
+	if (isDebug(COMPONENT_HASHTABLE)
+	    && isFullDebug(ht->parameter.ht_log_component))
+		LogFullDebug(ht->parameter.ht_log_component,
+			     "Get %s %s Value=%p", ht->parameter.ht_name,
+			     slot ? "found" : "did not find",
+			     slot ? data->val.addr : NULL);
+
+	return (slot != NULL) ? HASHTABLE_SUCCESS
+	    : HASHTABLE_ERROR_NO_SUCH_KEY;
+}
+
 /**
  * @brief Look up an entry, latching the table
  *
@@ -473,6 +1024,10 @@ hashtable_getlatch(struct hash_table *ht,
 	if (rc != HASHTABLE_SUCCESS)
 		return rc;
 
+	if (oa_table(ht))
+		return oa_getlatch(ht, key, val, may_write, latch, index,
+				   rbt_hash);
+
 	/* Acquire mutex */
 	if (may_write)
 		PTHREAD_RWLOCK_wrlock(&(ht->partitions[index].lock));
@@ -510,6 +1065,8 @@ hashtable_getlatch(struct hash_table *ht,
 		latch->index = index;
 		latch->rbt_hash = rbt_hash;
 		latch->locator = locator;
+		latch->slot = NULL;
+		latch->oa_phase = -1;
 	} else {
 		PTHREAD_RWLOCK_unlock(&ht->partitions[index].lock);
 	}
@@ -541,11 +1098,83 @@ void
 hashtable_releaselatched(struct hash_table *ht, struct hash_latch *latch)
 {
 	if (latch) {
-		PTHREAD_RWLOCK_unlock(&ht->partitions[latch->index].lock);
+		if (oa_table(ht) && latch->oa_phase >= 0)
+			oa_read_exit(&ht->partitions[latch->index],
+				     latch->oa_phase);
+		else
+			PTHREAD_RWLOCK_unlock(&ht->partitions[latch->index].
+					      lock);
 		memset(latch, 0, sizeof(struct hash_latch));
 	}
 }
 
+/**
+ * @brief Set a value in an open-addressed table
+ *
+ * An overwrite publishes a new descriptor pair and frees the old one
+ * once no reader can see it, so readers never see a torn entry.  The
+ * caller releases the latch.
+ *
+ * @param[in,out] ht         The hash store to be modified
+ * @param[in]     key        The key to set
+ * @param[in]     val        The value to insert
+ * @param[in]     latch      Write latch from hashtable_getlatch
+ * @param[in]     overwrite  Whether to overwrite an existing key
+ * @param[out]    stored_key If non-NULL, the overwritten key
+ * @param[out]    stored_val If non-NULL, the overwritten value
+ *
+ * @return As hashtable_setlatched.
+ */
+static hash_error_t
+oa_setlatched(struct hash_table *ht, struct gsh_buffdesc *key,
+	      struct gsh_buffdesc *val, struct hash_latch *latch,
+	      int overwrite, struct gsh_buffdesc *stored_key,
+	      struct gsh_buffdesc *stored_val)
+{
+	struct hash_partition *partition = &ht->partitions[latch->index];
+	struct hash_data *descriptors = NULL;
+	struct hash_data *old = NULL;
+	hash_error_t rc = HASHTABLE_SUCCESS;
+
+	if (latch->slot && !overwrite)
+		return HASHTABLE_ERROR_KEY_ALREADY_EXISTS;
+
+	descriptors = pool_alloc(ht->data_pool, NULL);
+	if (descriptors == NULL)
+		return HASHTABLE_INSERT_MALLOC_ERROR;
+
+	descriptors->key = *key;
+	descriptors->val = *val;
+
+	if (latch->slot) {
+		old = latch->slot->data;
+
+		if (stored_key)
+			*stored_key = old->key;
+
+		if (stored_val)
+			*stored_val = old->val;
+
+		oa_retarget(partition->oa, latch->rbt_hash, old, descriptors);
+		oa_retarget(partition->oa_old, latch->rbt_hash, old,
+			    descriptors);
+		oa_synchronize(partition);
+		pool_free(ht->data_pool, old);
+		rc = HASHTABLE_OVERWRITTEN;
+	} else {
+		oa_maybe_grow(partition);
+		if (!oa_place(partition->oa, latch->rbt_hash, descriptors)) {
+			pool_free(ht->data_pool, descriptors);
+			return HASHTABLE_INSERT_MALLOC_ERROR;
+		}
+		++partition->count;
+	}
+
+	oa_migrate(partition, HASH_OA_MIGRATE_STEP);
+
+	return rc;
+}
+
 /**
  * @brief Set a value in a table following a previous GetLatch
  *
@@ -612,6 +1241,12 @@ hashtable_setlatched(struct hash_table *ht,
 			     latch->index, latch->rbt_hash);
 	}
 
+	if (oa_table(ht)) {
+		rc = oa_setlatched(ht, key, val, latch, overwrite, stored_key,
+				   stored_val);
+		goto out;
+	}
+
 	/* In the case of collision */
 	if (latch->locator) {
 		if (!overwrite) {
@@ -737,12 +1372,12 @@ hashtable_deletelatched(struct hash_table *ht,
 	/* Its partition */
 	struct hash_partition *partition = &ht->partitions[latch->index];
 
-	if (!latch->locator) {
+	if (!latch->locator && !latch->slot) {
 		hashtable_releaselatched(ht, latch);
 		return HASHTABLE_SUCCESS;
 	}
 
-	data = RBT_OPAQ(latch->locator);
+	data = latch->slot ? latch->slot->data : RBT_OPAQ(latch->locator);
 
 	if (isDebug(COMPONENT_HASHTABLE)
 	    && isFullDebug(ht->parameter.ht_log_component)) {
@@ -773,6 +1408,20 @@ hashtable_deletelatched(struct hash_table *ht,
 	if (stored_val)
 		*stored_val = data->val;
 
+	if (latch->slot) {
+		oa_retarget(partition->oa, latch->rbt_hash, data,
+			    HASH_OA_TOMBSTONE);
+		oa_retarget(partition->oa_old, latch->rbt_hash, data,
+			    HASH_OA_TOMBSTONE);
+		--partition->count;
+		/* The caller may free the key and value on return */
+		oa_synchronize(partition);
+		pool_free(ht->data_pool, data);
+		oa_migrate(partition, HASH_OA_MIGRATE_STEP);
+		hashtable_releaselatched(ht, latch);
+		return HASHTABLE_SUCCESS;
+	}
+
 	/* Clear cache */
 	if (partition->cache) {
 		uint32_t offset = cache_offsetof(ht, latch->rbt_hash);
@@ -807,6 +1456,88 @@ hashtable_deletelatched(struct hash_table *ht,
 	return HASHTABLE_SUCCESS;
 }
 
+/**
+ * @brief State for oa_delall_visit
+ */
+struct oa_delall_state {
+	struct hash_table *ht;
+	int (*free_func)(struct gsh_buffdesc, struct gsh_buffdesc);
+	bool failed;
+};
+
+static void
+oa_delall_visit(struct hash_data *data, void *arg)
+{
+	struct oa_delall_state *st = arg;
+	struct gsh_buffdesc key = data->key;
+	struct gsh_buffdesc val = data->val;
+
+	pool_free(st->ht->data_pool, data);
+
+	/* After a failure, only release our own descriptors */
+	if (!st->failed && st->free_func(key, val) == 0)
+		st->failed = true;
+}
+
+/**
+ * @brief Remove and free all entries of an open-addressed table
+ *
+ * Each partition's arrays are detached and replaced by an empty one,
+ * so only a single wait for readers is needed per partition.
+ *
+ * @param[in,out] ht        The hashtable to be cleared of all entries
+ * @param[in]     free_func The function with which to free the contents
+ *                          of each entry
+ *
+ * @return HASHTABLE_SUCCESS or errors
+ */
+static hash_error_t
+oa_delall(struct hash_table *ht,
+	  int (*free_func)(struct gsh_buffdesc, struct gsh_buffdesc))
+{
+	struct oa_delall_state st = {
+		.ht = ht,
+		.free_func = free_func,
+		.failed = false
+	};
+	struct hash_partition *partition;
+	struct hash_oa_array *arr, *old, *fresh;
+	uint32_t migrated;
+	uint32_t index;
+
+	for (index = 0; index < ht->parameter.index_size; index++) {
+		partition = &ht->partitions[index];
+
+		fresh = oa_array_alloc(HASH_OA_INITIAL_BUCKETS);
+		if (fresh == NULL)
+			return HASHTABLE_ERROR_DELALL_FAIL;
+
+		PTHREAD_RWLOCK_wrlock(&partition->lock);
+
+		arr = partition->oa;
+		old = partition->oa_old;
+		migrated = partition->oa_migrated;
+
+		atomic_store_voidptr((void **)&partition->oa_old, NULL);
+		atomic_store_voidptr((void **)&partition->oa, fresh);
+		partition->oa_migrated = 0;
+		partition->count = 0;
+		oa_synchronize(partition);
+
+		PTHREAD_RWLOCK_unlock(&partition->lock);
+
+		oa_walk(arr, old, migrated, oa_delall_visit, &st);
+		oa_array_free(arr);
+		if (old != NULL)
+			oa_array_free(old);
+
+		if (st.failed)
+			return HASHTABLE_ERROR_DELALL_FAIL;
+	}
+
+	return HASHTABLE_SUCCESS;
+}
+
 /**
  * @brief Remove and free all (key,val) couples from the hash store
  *
@@ -827,6 +1558,9 @@ hashtable_delall(struct hash_table *ht,
 	/* Successive partition numbers */
 	uint32_t index = 0;
 
+	if (oa_table(ht))
+		return oa_delall(ht, free_func);
+
 	for (index = 0; index < ht->parameter.index_size; index++) {
 		/* The root of each successive partition */
 		struct rbt_head *root = &ht->partitions[index].rbt;
@@ -915,6 +1649,18 @@ hashtable_log(log_components_t component, struct hash_table *ht)
 
 	LogFullDebug(component, "The hash contains %zd entries", nb_entries);
 
+	if (oa_table(ht)) {
+		for (i = 0; i < ht->parameter.index_size; i++)
+			LogFullDebug(component,
+				     "The partition in position %" PRIu32
+				     " contains: %zu entries in %" PRIu32
+				     " buckets%s", i, ht->partitions[i].count,
+				     ht->partitions[i].oa->mask + 1,
+				     ht->partitions[i].oa_old ?
+				     " (resizing)" : "");
+		return;
+	}
+
 	for (i = 0; i < ht->parameter.index_size; i++) {
 		root = &ht->partitions[i].rbt;
 		LogFullDebug(component,
@@ -943,6 +1689,70 @@ hashtable_log(log_components_t component, struct hash_table *ht)
 	}
 }
 
+/**
+ * @brief State for oa_for_each_visit
+ */
+struct oa_for_each_state {
+	void (*func)(struct gsh_buffdesc *, struct gsh_buffdesc *, void *);
+	void *arg;
+};
+
+static void
+oa_for_each_visit(struct hash_data *data, void *arg)
+{
+	struct oa_for_each_state *st = arg;
+
+	st->func(&data->key, &data->val, st->arg);
+}
+
+/**
+ * @brief Call a function on every entry of a hash table
+ *
+ * Each partition is locked for writing while it is visited, so the
+ * function must not call back into the table.  This works for either
+ * backend and should be preferred over walking partitions directly.
+ *
+ * @param[in] ht   The hash table
+ * @param[in] func Function called with each key and value
+ * @param[in] arg  Argument passed to func
+ */
+
+void
+hashtable_for_each(struct hash_table *ht,
+		   void (*func)(struct gsh_buffdesc *,
+				struct gsh_buffdesc *, void *),
+		   void *arg)
+{
+	struct oa_for_each_state st = {
+		.func = func,
+		.arg = arg
+	};
+	struct hash_partition *partition;
+	struct rbt_node *it;
+	struct hash_data *data;
+	uint32_t i;
+
+	for (i = 0; i < ht->parameter.index_size; i++) {
+		partition = &ht->partitions[i];
+
+		PTHREAD_RWLOCK_wrlock(&partition->lock);
+
+		if (oa_table(ht)) {
+			oa_walk(partition->oa, partition->oa_old,
+				partition->oa_migrated, oa_for_each_visit,
+				&st);
+		} else {
+			RBT_LOOP(&partition->rbt, it) {
+				data = RBT_OPAQ(it);
+				func(&data->key, &data->val, arg);
+				RBT_INCREMENT(it);
+			}
+		}
+
+		PTHREAD_RWLOCK_unlock(&partition->lock);
+	}
+}
+
 /**
  * @brief Set a pair (key,value) into the Hash Table
  *
@@ -44,6 +44,7 @@
 #include <grp.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <errno.h>
 #ifdef USE_NFSIDMAP
 #include <nfsidmap.h>
 #endif				/* USE_NFSIDMAP */
@@ -52,9 +53,24 @@
 #endif
 #include "common_utils.h"
 #include "idmapper.h"
+#include "fridgethr.h"
 
 static struct gsh_buffdesc owner_domain;
 
+/**
+ * @brief Fridge that refreshes expired cache entries and preloads
+ */
+
+static struct fridgethr *idmapper_fridge;
+
+/**
+ * @brief Largest passwd/group buffer to try while preloading
+ */
+
+#define IDMAPPER_PRELOAD_BUF_MAX (1024 * 1024)
+
+static void idmapper_preload(struct fridgethr_context *);
+
 /**
  * @brief Initialize the ID Mapper
  *
@@ -63,6 +79,9 @@ static struct gsh_buffdesc owner_domain;
 
 bool idmapper_init(void)
 {
+	struct fridgethr_params frp;
+	int rc;
+
 #ifdef USE_NFSIDMAP
 	if (!nfs_param.nfsv4_param.use_getpwnam) {
 		if (nfs4_init_name_mapping(nfs_param.nfsv4_param.idmapconf)
@@ -91,153 +110,186 @@ bool idmapper_init(void)
 	}
 
 	idmapper_cache_init();
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 2;
+	frp.deferment = fridgethr_defer_queue;
+	rc = fridgethr_init(&idmapper_fridge, "Idmapper", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_IDMAPPER,
+			 "Unable to initialize ID Mapper fridge, error code %d.",
+			 rc);
+		return false;
+	}
+
+	if (nfs_param.nfsv4_param.idmap_preload) {
+		rc = fridgethr_submit(idmapper_fridge, idmapper_preload, NULL);
+		if (rc != 0)
+			LogWarn(COMPONENT_IDMAPPER,
+				"Unable to start ID Mapper preload, error code %d.",
+				rc);
+	}
+
 	return true;
 }
 
 /**
- * @brief Encode a UID or GID as a string
+ * @brief Size of buffer needed for an owner or group string we build
  *
- * @param[in,out] xdrs  XDR stream to which to encode
- * @param[in]     id    UID or GID
- * @param[in]     group True if this is a GID, false for a UID
+ * @return The size in bytes.
+ */
+
+static inline size_t idmapper_name_max(void)
+{
+	return nfs_param.nfsv4_param.use_getpwnam ?
+	    (PWENT_MAX_LEN + owner_domain.len + 2) :
+	    (NFS4_MAX_DOMAIN_LEN + 2);
+}
+
+/**
+ * @brief Look up the name of a UID or GID and cache it
  *
- * @retval true on success.
- * @retval false on failure.
+ * If the directory does not know id, new_name is set to the numeric id
+ * or nobody, and that is cached as a negative entry.  If the lookup
+ * itself failed, new_name is set the same way but nothing is cached,
+ * so an entry already cached for id stays.
+ *
+ * @param[in]     id       UID or GID
+ * @param[in]     group    True if this is a GID, false for a UID
+ * @param[in,out] new_name Buffer of idmapper_name_max() bytes, set to
+ *                         the name found
+ *
+ * @return false if the lookup failed and nothing was cached.
  */
 
-static bool xdr_encode_nfs4_princ(XDR *xdrs, uint32_t id, bool group)
+static bool id2name_cache(uint32_t id, bool group,
+			  struct gsh_buffdesc *new_name)
 {
-	const struct gsh_buffdesc *found;
-	uint32_t not_a_size_t;
-	bool success = false;
+	int rc;
+	bool looked_up = false;
+	bool transient = false;
+	bool success;
+	char *namebuff = new_name->addr;
 
-	PTHREAD_RWLOCK_rdlock(group ? &idmapper_group_lock :
-			      &idmapper_user_lock);
-	if (group)
-		success = idmapper_lookup_by_gid(id, &found);
-	else
-		success = idmapper_lookup_by_uid(id, &found, NULL);
+	if (nfs_param.nfsv4_param.use_getpwnam) {
+		char *cursor;
+		bool nulled;
 
-	if (likely(success)) {
-		not_a_size_t = found->len;
+		if (group) {
+			struct group g;
+			struct group *gres;
 
-		/* Fully qualified owners are always stored in the
-		   hash table, no matter what our lookup method. */
-		success =
-		    inline_xdr_bytes(xdrs, (char **)&found->addr, &not_a_size_t,
-				     UINT32_MAX);
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		return success;
-	} else {
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		int rc;
-		bool looked_up = false;
-		char *namebuff =
-		    alloca(nfs_param.nfsv4_param.
-			   use_getpwnam ? (PWENT_MAX_LEN + owner_domain.len +
-					   2) : (NFS4_MAX_DOMAIN_LEN + 2));
-		struct gsh_buffdesc new_name = {
-			.addr = namebuff
-		};
-		if (nfs_param.nfsv4_param.use_getpwnam) {
-			char *cursor;
-			bool nulled;
-
-			if (group) {
-				struct group g;
-				struct group *gres;
-
-				rc = getgrgid_r(id, &g, namebuff, PWENT_MAX_LEN,
-						&gres);
-				nulled = (gres == NULL);
-			} else {
-				struct passwd p;
-				struct passwd *pres;
-
-				rc = getpwuid_r(id, &p, namebuff, PWENT_MAX_LEN,
-						&pres);
-				nulled = (pres == NULL);
-			}
+			rc = getgrgid_r(id, &g, namebuff, PWENT_MAX_LEN,
+					&gres);
+			nulled = (gres == NULL);
+		} else {
+			struct passwd p;
+			struct passwd *pres;
 
-			if ((rc == 0) && !nulled) {
-				new_name.len = strlen(namebuff);
-				cursor = namebuff + new_name.len;
-				*(cursor++) = '@';
-				++new_name.len;
-				memcpy(cursor, owner_domain.addr,
-				       owner_domain.len);
-				new_name.len += owner_domain.len;
-				looked_up = true;
-			} else {
-				LogWarn(COMPONENT_IDMAPPER,
-					"%s failed with code %d.",
-					(group ? "getgrgid_r" : "getpwuid_r"),
-					rc);
-			}
+			rc = getpwuid_r(id, &p, namebuff, PWENT_MAX_LEN,
+					&pres);
+			nulled = (pres == NULL);
+		}
+
+		if ((rc == 0) && !nulled) {
+			new_name->len = strlen(namebuff);
+			cursor = namebuff + new_name->len;
+			*(cursor++) = '@';
+			++new_name->len;
+			memcpy(cursor, owner_domain.addr, owner_domain.len);
+			new_name->len += owner_domain.len;
+			looked_up = true;
 		} else {
+			/* Not found is rc 0 with no entry */
+			transient = rc != 0;
+			LogWarn(COMPONENT_IDMAPPER,
+				"%s failed with code %d.",
+				(group ? "getgrgid_r" : "getpwuid_r"), rc);
+		}
+	} else {
 #ifdef USE_NFSIDMAP
-			if (group) {
-				rc = nfs4_gid_to_name(id, owner_domain.addr,
-						      namebuff,
-						      NFS4_MAX_DOMAIN_LEN + 1);
-			} else {
-				rc = nfs4_uid_to_name(id, owner_domain.addr,
-						      namebuff,
-						      NFS4_MAX_DOMAIN_LEN + 1);
-			}
-			if (rc == 0) {
-				new_name.len = strlen(namebuff);
-				looked_up = true;
-			} else {
-				LogWarn(COMPONENT_IDMAPPER,
-					"%s failed with code %d.",
-					(group ? "nfs4_gid_to_name" :
-					 "nfs4_uid_to_name"), rc);
-			}
+		if (group) {
+			rc = nfs4_gid_to_name(id, owner_domain.addr, namebuff,
+					      NFS4_MAX_DOMAIN_LEN + 1);
+		} else {
+			rc = nfs4_uid_to_name(id, owner_domain.addr, namebuff,
+					      NFS4_MAX_DOMAIN_LEN + 1);
+		}
+		if (rc == 0) {
+			new_name->len = strlen(namebuff);
+			looked_up = true;
+		} else {
+			transient = rc != -ENOENT;
+			LogWarn(COMPONENT_IDMAPPER,
+				"%s failed with code %d.",
+				(group ? "nfs4_gid_to_name" :
+				 "nfs4_uid_to_name"), rc);
+		}
 #else				/* USE_NFSIDMAP */
-			looked_up = false;
+		looked_up = false;
 #endif				/* !USE_NFSIDMAP */
-		}
+	}
 
-		if (!looked_up) {
-			if (nfs_param.nfsv4_param.allow_numeric_owners) {
-				LogWarn(COMPONENT_IDMAPPER,
-					"Lookup for %d failed, "
-					"using numeric %s", id,
-					(group ? "group" : "owner"));
-				/* 2³² is 10 digits long in decimal */
-				sprintf(namebuff, "%u", id);
-				new_name.len = strlen(namebuff);
-			} else {
-				LogWarn(COMPONENT_IDMAPPER,
-					"Lookup for %d failed, using nobody.",
-					id);
-				memcpy(new_name.addr, "nobody", 6);
-				new_name.len = 6;
-			}
+	if (!looked_up) {
+		if (nfs_param.nfsv4_param.allow_numeric_owners) {
+			LogWarn(COMPONENT_IDMAPPER,
+				"Lookup for %d failed, using numeric %s", id,
+				(group ? "group" : "owner"));
+			/* 2³² is 10 digits long in decimal */
+			sprintf(namebuff, "%u", id);
+			new_name->len = strlen(namebuff);
+		} else {
+			LogWarn(COMPONENT_IDMAPPER,
+				"Lookup for %d failed, using nobody.", id);
+			memcpy(namebuff, "nobody", 6);
+			new_name->len = 6;
 		}
+		if (transient)
+			return false;
+		success = idmapper_add_negative_id(group, id, new_name);
+	} else if (group) {
+		success = idmapper_add_group(new_name, id);
+	} else {
+		success = idmapper_add_user(new_name, id, NULL, false);
+	}
 
-		/* Add to the cache and encode the result. */
-		PTHREAD_RWLOCK_wrlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		if (group)
-			success = idmapper_add_group(&new_name, id);
-		else
-			success = idmapper_add_user(&new_name, id, NULL, false);
-
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		if (unlikely(!success)) {
-			LogMajor(COMPONENT_IDMAPPER, "%s failed.",
-				 group ? "idmapper_add_group" :
-				 "idmaper_add_user");
-		}
-		not_a_size_t = new_name.len;
-		return inline_xdr_bytes(xdrs, (char **)&new_name.addr,
-					&not_a_size_t, UINT32_MAX);
+	if (unlikely(!success)) {
+		LogMajor(COMPONENT_IDMAPPER, "%s failed.",
+			 group ? "idmapper_add_group" : "idmaper_add_user");
+	}
+	return true;
+}
+
+/**
+ * @brief Encode a UID or GID as a string
+ *
+ * @param[in,out] xdrs  XDR stream to which to encode
+ * @param[in]     id    UID or GID
+ * @param[in]     group True if this is a GID, false for a UID
+ *
+ * @retval true on success.
+ * @retval false on failure.
+ */
+
+static bool xdr_encode_nfs4_princ(XDR *xdrs, uint32_t id, bool group)
+{
+	uint32_t not_a_size_t;
+	struct gsh_buffdesc name = {
+		.len = idmapper_name_max()
+	};
+
+	name.addr = alloca(name.len);
+
+	/* Fully qualified owners are always stored in the cache, no
+	   matter what our lookup method. */
+	if (idmapper_lookup_id(group, id, &name) == IDMAP_MISS) {
+		name.len = idmapper_name_max();
+		(void)id2name_cache(id, group, &name);
 	}
+
+	not_a_size_t = name.len;
+	return inline_xdr_bytes(xdrs, (char **)&name.addr, &not_a_size_t,
+				UINT32_MAX);
 }
 
 /**
@@ -276,26 +328,25 @@ bool xdr_encode_nfs4_group(XDR *xdrs, gid_t gid)
  * @param[in]  name C string of name
  * @param[in]  len  Length of name
  * @param[out] id   ID found
- * @param[in]  anon ID to use in case of nobody
  *
- * @return true on success, false on just phoning it in.
+ * @retval IDMAP_HIT for a numeric id.
+ * @retval IDMAP_NEGATIVE for nobody.
+ * @retval IDMAP_MISS on just phoning it in.
  */
 
-static bool atless2id(char *name, size_t len, uint32_t *id,
-		      const uint32_t anon)
+static enum idmap_hit atless2id(char *name, size_t len, uint32_t *id)
 {
 	if ((len == 6) && (!memcmp(name, "nobody", 6))) {
-		*id = anon;
-		return true;
+		return IDMAP_NEGATIVE;
 	} else if (nfs_param.nfsv4_param.allow_numeric_owners) {
 		char *end = NULL;
 		*id = strtol(name, &end, 10);
 		if (!(end && *end != '\0'))
-			return true;
+			return IDMAP_HIT;
 	}
 
 	/* Nothing else without an @ is allowed. */
-	return false;
+	return IDMAP_MISS;
 }
 
 /**
@@ -304,18 +355,18 @@ static bool atless2id(char *name, size_t len, uint32_t *id,
  * @param[in]  name       C string of name
  * @param[in]  len        Length of name
  * @param[out] id         ID found
- * @param[in]  anon       ID to use in case of nobody
  * @param[in]  group      Whether this a group lookup
  * @param[out] gss_gid    Found GID
  * @param[out] gss_uid    Found UID
  * @apram[out] gotgss_gid Found a GID.
  * @param[in]  at         Location of the @
+ * @param[out] transient  Set if the lookup itself failed
  *
  * @return true on success, false not making the grade
  */
 static bool pwentname2id(char *name, size_t len, uint32_t *id,
-			 const uint32_t anon, bool group, gid_t *gid,
-			 bool *got_gid, char *at)
+			 bool group, gid_t *gid, bool *got_gid, char *at,
+			 bool *transient)
 {
 	if (at != NULL) {
 		if (strcmp(at + 1, owner_domain.addr) != 0) {
@@ -332,6 +383,7 @@ static bool pwentname2id(char *name, size_t len, uint32_t *id,
 		if (getgrnam_r(name, &g, gbuf, PWENT_MAX_LEN, &gres) != 0) {
 			LogMajor(COMPONENT_IDMAPPER, "getpwnam_r %s failed",
 				 name);
+			*transient = true;
 			return false;
 		} else if (gres != NULL) {
 			*id = gres->gr_gid;
@@ -358,6 +410,7 @@ static bool pwentname2id(char *name, size_t len, uint32_t *id,
 		if (getpwnam_r(name, &p, buf, PWENT_MAX_LEN, &pres) != 0) {
 			LogInfo(COMPONENT_IDMAPPER, "getpwnam_r %s failed",
 				name);
+			*transient = true;
 			return false;
 		} else if (pres != NULL) {
 			*id = pres->pw_uid;
@@ -389,19 +442,19 @@ static bool pwentname2id(char *name, size_t len, uint32_t *id,
  * @param[in]  name       C string of name
  * @param[in]  len        Length of name
  * @param[out] id         ID found
- * @param[in]  anon       ID to use in case of nobody
  * @param[in]  group      Whether this a group lookup
  * @param[out] gss_gid    Found GID
  * @param[out] gss_uid    Found UID
  * @apram[out] gotgss_gid Found a GID.
  * @param[in]  at         Location of the @
+ * @param[out] transient  Set if the lookup itself failed
  *
  * @return true on success, false not making the grade
  */
 
 static bool idmapname2id(char *name, size_t len, uint32_t *id,
-			 const uint32_t anon, bool group, gid_t *gid,
-			 bool *got_gid, char *at)
+			 bool group, gid_t *gid, bool *got_gid, char *at,
+			 bool *transient)
 {
 #ifdef USE_NFSIDMAP
 	int rc;
@@ -414,6 +467,7 @@ static bool idmapname2id(char *name, size_t len, uint32_t *id,
 	if (rc == 0) {
 		return true;
 	} else {
+		*transient = rc != -ENOENT;
 		LogInfo(COMPONENT_IDMAPPER,
 			"%s %s failed with %d, using anonymous.",
 			(group ? "nfs4_name_to_gid" : "nfs4_name_to_uid"), name,
@@ -425,6 +479,89 @@ static bool idmapname2id(char *name, size_t len, uint32_t *id,
 #endif				/* USE_NFSIDMAP */
 }
 
+/**
+ * @brief Look up a name in the directory and cache the result
+ *
+ * @param[in]  name    The name of the user or group
+ * @param[out] id      The resulting id, set on IDMAP_HIT
+ * @param[in]  group   True if this is a group name
+ * @param[out] gid       Primary GID of a user
+ * @param[out] got_gid   Whether gid was found
+ * @param[out] transient Set if the lookup itself failed.  Nothing is
+ *                       cached then, so an entry already cached for
+ *                       name stays.
+ *
+ * @retval IDMAP_HIT if the name maps to id.
+ * @retval IDMAP_NEGATIVE if the name maps to the anonymous id.
+ * @retval IDMAP_MISS if the name is not acceptable at all.
+ */
+
+static enum idmap_hit name2id_cache(const struct gsh_buffdesc *name,
+				    uint32_t *id, bool group, gid_t *gid,
+				    bool *got_gid, bool *transient)
+{
+	/* Something we can mutate and count on as terminated */
+	char *namebuff = alloca(name->len + 1);
+	char *at;
+	enum idmap_hit hit;
+	uint32_t old_id;
+	bool success;
+
+	memcpy(namebuff, name->addr, name->len);
+	*(namebuff + name->len) = '\0';
+	at = memchr(namebuff, '@', name->len);
+	*got_gid = false;
+	*transient = false;
+
+	if (at == NULL) {
+		if (pwentname2id(namebuff, name->len, id, group, gid, got_gid,
+				 NULL, transient))
+			hit = IDMAP_HIT;
+		else
+			hit = atless2id(namebuff, name->len, id);
+		if (hit == IDMAP_MISS)
+			return IDMAP_MISS;
+		/* Settled without the directory */
+		*transient = false;
+	} else if (nfs_param.nfsv4_param.use_getpwnam) {
+		hit = pwentname2id(namebuff, name->len, id, group, gid,
+				   got_gid, at, transient) ?
+		    IDMAP_HIT : IDMAP_NEGATIVE;
+	} else {
+		hit = idmapname2id(namebuff, name->len, id, group, gid,
+				   got_gid, at, transient) ?
+		    IDMAP_HIT : IDMAP_NEGATIVE;
+	}
+
+	if (*transient)
+		return hit;
+
+	/* Keep a GID learned elsewhere, as from a Kerberos principal,
+	 * when the directory gives none */
+	if (hit == IDMAP_HIT && !group && !*got_gid &&
+	    idmapper_lookup_name(false, name, &old_id, gid, got_gid) ==
+	    IDMAP_HIT && old_id != *id)
+		*got_gid = false;
+
+	if (hit == IDMAP_NEGATIVE) {
+		LogInfo(COMPONENT_IDMAPPER,
+			"All lookups failed for %s, using anonymous.",
+			namebuff);
+		success = idmapper_add_negative_name(group, name);
+	} else if (group) {
+		success = idmapper_add_group(name, *id);
+	} else {
+		success = idmapper_add_user(name, *id, *got_gid ? gid : NULL,
+					    false);
+	}
+
+	if (!success)
+		LogMajor(COMPONENT_IDMAPPER, "%s(%s %u) failed",
+			 (group ? "gidmap_add" : "uidmap_add"), namebuff,
+			 hit == IDMAP_HIT ? *id : 0);
+	return hit;
+}
+
 /**
  * @brief Convert a name to an ID
  *
@@ -439,75 +576,29 @@ static bool idmapname2id(char *name, size_t len, uint32_t *id,
 static bool name2id(const struct gsh_buffdesc *name, uint32_t *id, bool group,
 		    const uint32_t anon)
 {
-	bool success;
-
-	PTHREAD_RWLOCK_rdlock(group ? &idmapper_group_lock :
-			      &idmapper_user_lock);
-	if (group)
-		success = idmapper_lookup_by_gname(name, id);
-	else
-		success = idmapper_lookup_by_uname(name, id, NULL, false);
-	PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-			      &idmapper_user_lock);
-
-	if (success)
+	enum idmap_hit hit;
+	gid_t gid;
+	bool got_gid;
+	bool transient;
+
+	hit = idmapper_lookup_name(group, name, id, NULL, NULL);
+	if (hit == IDMAP_MISS)
+		hit = name2id_cache(name, id, group, &gid, &got_gid,
+				    &transient);
+
+	switch (hit) {
+	case IDMAP_HIT:
 		return true;
-	else {
-		gid_t gid;
-		bool got_gid = false;
-		/* Something we can mutate and count on as terminated */
-		char *namebuff = alloca(name->len + 1);
-		char *at;
-		bool looked_up = false;
-
-		memcpy(namebuff, name->addr, name->len);
-		*(namebuff + name->len) = '\0';
-		at = memchr(namebuff, '@', name->len);
-
-		if (at == NULL) {
-			if (pwentname2id
-			    (namebuff, name->len, id, anon, group, &gid,
-			     &got_gid, NULL))
-				looked_up = true;
-			else if (atless2id(namebuff, name->len, id, anon))
-				looked_up = true;
-			else
-				return false;
-		} else if (nfs_param.nfsv4_param.use_getpwnam) {
-			looked_up =
-			    pwentname2id(namebuff, name->len, id, anon, group,
-					 &gid, &got_gid, at);
-		} else {
-			looked_up =
-			    idmapname2id(namebuff, name->len, id, anon, group,
-					 &gid, &got_gid, at);
-		}
-
-		if (!looked_up) {
-			LogInfo(COMPONENT_IDMAPPER,
-				"All lookups failed for %s, using anonymous.",
-				namebuff);
-			*id = anon;
-		}
-
-		PTHREAD_RWLOCK_wrlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-		if (group)
-			success = idmapper_add_group(name, *id);
-		else
-			success =
-			    idmapper_add_user(name, *id, got_gid ? &gid : NULL,
-					      false);
-
-		PTHREAD_RWLOCK_unlock(group ? &idmapper_group_lock :
-				      &idmapper_user_lock);
-
-		if (!success)
-			LogMajor(COMPONENT_IDMAPPER, "%s(%s %u) failed",
-				 (group ? "gidmap_add" : "uidmap_add"),
-				 namebuff, *id);
+	case IDMAP_NEGATIVE:
+		/* Negative entries are shared by all exports, so the
+		   anonymous id is always the caller's. */
+		*id = anon;
 		return true;
+	case IDMAP_MISS:
+		break;
 	}
+
+	return false;
 }
 
 /**
@@ -539,6 +630,222 @@ bool name2gid(const struct gsh_buffdesc *name, gid_t *gid, const gid_t anon)
 	return name2id(name, gid, true, anon);
 }
 
+/**
+ * @brief A cache entry to look up again
+ */
+
+struct idmap_refresh {
+	enum idmap_kind kind;	/*< Which map the entry is in */
+	uint32_t id;		/*< Key of the id maps */
+	size_t len;		/*< Length of name */
+	char name[];		/*< Key of the name maps */
+};
+
+/**
+ * @brief Look up an expired entry again and replace it
+ *
+ * @param[in] ctx Thread context, arg is the struct idmap_refresh
+ */
+
+static void idmapper_refresh_job(struct fridgethr_context *ctx)
+{
+	struct idmap_refresh *refresh = ctx->arg;
+	struct gsh_buffdesc name = {
+		.addr = refresh->name,
+		.len = refresh->len
+	};
+	enum idmap_hit hit;
+	uint32_t id;
+	gid_t gid;
+	bool got_gid;
+	bool transient;
+
+	switch (refresh->kind) {
+	case IDMAP_UID:
+	case IDMAP_GID:
+		name.len = idmapper_name_max();
+		name.addr = alloca(name.len);
+		/* On a failed lookup keep what we had, and try later */
+		if (!id2name_cache(refresh->id, refresh->kind == IDMAP_GID,
+				   &name))
+			idmapper_refresh_failed(refresh->kind, NULL,
+						refresh->id);
+		break;
+	case IDMAP_UNAME:
+	case IDMAP_GNAME:
+		hit = name2id_cache(&name, &id, refresh->kind == IDMAP_GNAME,
+				    &gid, &got_gid, &transient);
+		/* A name that is no longer acceptable at all is
+		   dropped, so the next use is rejected as a first one
+		   would be. */
+		if (transient)
+			idmapper_refresh_failed(refresh->kind, &name, 0);
+		else if (hit == IDMAP_MISS)
+			idmapper_remove_name(refresh->kind == IDMAP_GNAME,
+					     &name);
+		break;
+	case IDMAP_KINDS:
+		break;
+	}
+
+	gsh_free(refresh);
+}
+
+/**
+ * @brief Queue an expired cache entry to be looked up again
+ *
+ * Called by the cache with the entry's shard locked, so this only
+ * copies the key and hands it off.
+ *
+ * @param[in] kind Which map the entry is in
+ * @param[in] name Key of the name maps
+ * @param[in] id   Key of the id maps
+ *
+ * @return true if the refresh was queued.
+ */
+
+bool idmapper_refresh(enum idmap_kind kind, const struct gsh_buffdesc *name,
+		      uint32_t id)
+{
+	struct idmap_refresh *refresh;
+	size_t len = (kind == IDMAP_UNAME || kind == IDMAP_GNAME) ?
+	    name->len : 0;
+
+	if (idmapper_fridge == NULL)
+		return false;
+
+	refresh = gsh_malloc(sizeof(struct idmap_refresh) + len);
+	if (refresh == NULL)
+		return false;
+
+	refresh->kind = kind;
+	refresh->id = id;
+	refresh->len = len;
+	memcpy(refresh->name, name->addr, len);
+
+	if (fridgethr_submit(idmapper_fridge, idmapper_refresh_job,
+			     refresh) != 0) {
+		gsh_free(refresh);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Cache one enumerated user or group
+ *
+ * @param[in] id     UID or GID
+ * @param[in] pwname Name from the passwd or group database
+ * @param[in] group  True for a group
+ * @param[in] gid    Primary GID of a user, or NULL
+ */
+
+static void preload_one(uint32_t id, const char *pwname, bool group,
+			const gid_t *gid)
+{
+	struct gsh_buffdesc name;
+	size_t len = strlen(pwname);
+
+	if (!nfs_param.nfsv4_param.use_getpwnam) {
+		/* Only the mapping library knows the owner string */
+		name.len = idmapper_name_max();
+		name.addr = alloca(name.len);
+		(void)id2name_cache(id, group, &name);
+		return;
+	}
+
+	name.len = len + 1 + owner_domain.len;
+	name.addr = alloca(name.len);
+	memcpy(name.addr, pwname, len);
+	((char *)name.addr)[len] = '@';
+	memcpy((char *)name.addr + len + 1, owner_domain.addr,
+	       owner_domain.len);
+
+	if (group)
+		idmapper_add_group(&name, id);
+	else
+		idmapper_add_user(&name, id, gid, false);
+}
+
+/**
+ * @brief Grow the buffer for getpwent_r and getgrent_r
+ *
+ * @param[in,out] buf  The buffer, left alone on failure
+ * @param[in,out] size Its size
+ *
+ * @return true if the buffer was grown.
+ */
+
+static bool preload_grow(char **buf, size_t *size)
+{
+	char *bigger;
+
+	if (*size >= IDMAPPER_PRELOAD_BUF_MAX)
+		return false;
+
+	bigger = gsh_realloc(*buf, *size * 2);
+	if (bigger == NULL)
+		return false;
+
+	*buf = bigger;
+	*size *= 2;
+	return true;
+}
+
+/**
+ * @brief Load every user and group the directory enumerates
+ *
+ * Runs once at startup when Idmap_Preload is set, so that the first
+ * GETATTRs of a busy server do not each wait on the directory.
+ *
+ * @param[in] ctx Thread context, unused
+ */
+
+static void idmapper_preload(struct fridgethr_context *ctx)
+{
+	size_t size = 1024;
+	char *buf = gsh_malloc(size);
+	struct passwd p;
+	struct passwd *pres;
+	struct group g;
+	struct group *gres;
+	unsigned int users = 0;
+	unsigned int groups = 0;
+	int rc;
+
+	if (buf == NULL)
+		return;
+
+	setpwent();
+	for (;;) {
+		rc = getpwent_r(&p, buf, size, &pres);
+		if (rc == ERANGE && preload_grow(&buf, &size))
+			continue;
+		if (rc != 0 || pres == NULL)
+			break;
+		preload_one(p.pw_uid, p.pw_name, false, &p.pw_gid);
+		++users;
+	}
+	endpwent();
+
+	setgrent();
+	for (;;) {
+		rc = getgrent_r(&g, buf, size, &gres);
+		if (rc == ERANGE && preload_grow(&buf, &size))
+			continue;
+		if (rc != 0 || gres == NULL)
+			break;
+		preload_one(g.gr_gid, g.gr_name, true, NULL);
+		++groups;
+	}
+	endgrent();
+
+	gsh_free(buf);
+	LogEvent(COMPONENT_IDMAPPER, "Preloaded %u users and %u groups.",
+		 users, groups);
+}
+
 #ifdef _HAVE_GSSAPI
 #ifdef _MSPAC_SUPPORT
 /**
@@ -567,7 +874,6 @@ bool principal2uid(char *principal, uid_t *uid, gid_t *gid)
 #ifdef USE_NFSIDMAP
 	uid_t gss_uid = ANON_UID;
 	gid_t gss_gid = ANON_GID;
-	const gid_t *gss_gidres = NULL;
 	int rc;
 	bool success;
 	struct gsh_buffdesc princbuff = {
@@ -580,12 +886,8 @@ bool principal2uid(char *principal, uid_t *uid, gid_t *gid)
 		return false;
 
 #ifdef USE_NFSIDMAP
-	PTHREAD_RWLOCK_rdlock(&idmapper_user_lock);
-	success =
-	    idmapper_lookup_by_uname(&princbuff, &gss_uid, &gss_gidres, true);
-	if (success && gss_gidres)
-		gss_gid = *gss_gidres;
-	PTHREAD_RWLOCK_unlock(&idmapper_user_lock);
+	success = idmapper_lookup_name(false, &princbuff, &gss_uid, &gss_gid,
+				       NULL) == IDMAP_HIT;
 	if (unlikely(!success)) {
 		if ((princbuff.len >= 4)
 		    && (!memcmp(princbuff.addr, "nfs/", 4)
@@ -681,10 +983,8 @@ bool principal2uid(char *principal, uid_t *uid, gid_t *gid)
  principal_found:
 #endif
 
-		PTHREAD_RWLOCK_wrlock(&idmapper_user_lock);
 		success =
 		    idmapper_add_user(&princbuff, gss_uid, &gss_gid, true);
-		PTHREAD_RWLOCK_unlock(&idmapper_user_lock);
 
 		if (!success) {
 			LogMajor(COMPONENT_IDMAPPER,
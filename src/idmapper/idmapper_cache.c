@@ -30,103 +30,94 @@
 /**
  * @file    idmapper_cache.c
  * @brief   Id mapping cache functions
+ *
+ * The cache holds four independent maps: user name to UID, UID to
+ * user name, group name to GID and GID to group name.  Each map is
+ * split into shards, every shard having its own lock and tree, so
+ * lookups of unrelated ids do not contend and a refresh only locks
+ * out the shard it writes.
+ *
+ * Entries expire after Idmap_Cache_TTL seconds (Idmap_Negative_TTL
+ * for names or ids the directory did not know).  An expired entry is
+ * still returned; the first lookup to see it hands the key to
+ * idmapper_refresh(), which looks it up again in the background and
+ * replaces the entry.  Worker threads therefore only wait on the
+ * directory service for ids that were never cached.
+ *
+ * Lookups copy the result out, so no lock is held by the caller.
  */
 #include "config.h"
 #include "log.h"
 #include "config_parsing.h"
 #include <string.h>
+#include <time.h>
 #include <pwd.h>
 #include <grp.h>
 #include "gsh_intrinsic.h"
 #include "ganesha_types.h"
 #include "common_utils.h"
 #include "avltree.h"
+#include "city.h"
+#include "nfs_core.h"
 #include "idmapper.h"
 #include "abstract_atomic.h"
 
 /**
- * @brief User entry in the IDMapper cache
- */
-
-struct cache_user {
-	struct gsh_buffdesc uname;	/*< Username */
-	uid_t uid;		/*< Corresponding UID */
-	gid_t gid;		/*< Corresponding GID */
-	bool gid_set;		/*< if the GID has been set */
-	struct avltree_node uname_node;	/*< Node in the name tree */
-	struct avltree_node uid_node;	/*< Node in the UID tree */
-	bool in_uidtree;		/* true iff this is in uid_tree */
-};
-
-/**
- * @brief Group entry in the IDMapper cache
- */
-
-struct cache_group {
-	struct gsh_buffdesc gname;	/*< Group name */
-	gid_t gid;		/*< Group ID */
-	struct avltree_node gname_node;	/*< Node in the name tree */
-	struct avltree_node gid_node;	/*< Node in the GID tree */
-};
-
-/**
- * @brief Number of entires in the UID cache, should be prime.
- */
-
-#define id_cache_size 1009
-
-/**
- * @brief UID cache, may only be accessed with idmapper_user_lock
- * held.  If idmapper_user_lock is held for read, it must be accessed
- * atomically.  (For a write, normal fetch/store is sufficient since
- * others are kept out.)
- */
-
-static struct avltree_node *uid_cache[id_cache_size];
-
-/**
- * @brief GID cache, may only be accessed with idmapper_group_lock
- * held.  If idmapper_group_lock is held for read, it must be accessed
- * atomically.  (For a write, normal fetch/store is sufficient since
- * others are kept out.)
+ * @brief Number of shards per map, must be a power of two.
  */
 
-static struct avltree_node *gid_cache[id_cache_size];
+#define IDMAPPER_SHARDS 16
 
 /**
- * @brief Lock that protects the idmapper user cache
+ * @brief Number of direct-mapped slots per id shard, should be prime.
  */
 
-pthread_rwlock_t idmapper_user_lock = PTHREAD_RWLOCK_INITIALIZER;
+#define IDMAPPER_SLOTS 67
 
 /**
- * @brief Lock that protects the idmapper group cache
- */
-
-pthread_rwlock_t idmapper_group_lock = PTHREAD_RWLOCK_INITIALIZER;
-
-/**
- * @brief Tree of users, by name
+ * @brief An entry in one of the IDMapper maps
+ *
+ * The key is name for the name maps and id for the id maps; the other
+ * field is the value.
  */
 
-static struct avltree uname_tree;
+struct idmap_entry {
+	struct avltree_node node;	/*< Node in the shard tree */
+	struct gsh_buffdesc name;	/*< User or group name */
+	uint32_t id;		/*< UID or GID */
+	gid_t gid;		/*< Primary GID of a user */
+	bool gid_set;		/*< if the GID has been set */
+	bool negative;		/*< The directory did not know the key */
+	bool gss_princ;		/*< Kerberos principal, never expires */
+	uint32_t refreshing;	/*< A refresh has been queued */
+	time_t expires;		/*< When to look the key up again */
+};
 
 /**
- * @brief Tree of users, by ID
+ * @brief One shard of a map
+ *
+ * For the id maps, slots caches the last entry found in each slot and
+ * may only be accessed with lock held.  If lock is held for read, it
+ * must be accessed atomically.
  */
 
-static struct avltree uid_tree;
+struct idmap_shard {
+	pthread_rwlock_t lock;	/*< Protects the tree and slots */
+	struct avltree tree;	/*< Entries, by key */
+	struct avltree_node *slots[IDMAPPER_SLOTS];
+	CACHE_PAD(0);
+};
 
 /**
- * @brief Tree of groups, by name
+ * @brief The four maps, indexed by enum idmap_kind
  */
-static struct avltree gname_tree;
 
-/**
- * @brief Tree of groups, by ID
- */
+static struct idmap_shard idmap_shards[IDMAP_KINDS][IDMAPPER_SHARDS];
 
-static struct avltree gid_tree;
+static inline bool idmap_by_id(enum idmap_kind kind)
+{
+	return kind == IDMAP_UID || kind == IDMAP_GID;
+}
 
 /**
  * @brief Compare two buffers
@@ -160,7 +151,7 @@ static inline int buffdesc_comparator(const struct gsh_buffdesc *buffa,
 }
 
 /**
- * @brief Comparison for user names
+ * @brief Comparison for names
  *
  * @param[in] node1 A node
  * @param[in] nodea Another node
@@ -170,21 +161,19 @@ static inline int buffdesc_comparator(const struct gsh_buffdesc *buffa,
  * @retval 1 if node1 is greater than nodea
  */
 
-static int uname_comparator(const struct avltree_node *node1,
-			    const struct avltree_node *nodea)
+static int name_comparator(const struct avltree_node *node1,
+			   const struct avltree_node *nodea)
 {
-	struct cache_user *user1 =
-	    avltree_container_of(node1, struct cache_user,
-				 uname_node);
-	struct cache_user *usera =
-	    avltree_container_of(nodea, struct cache_user,
-				 uname_node);
-
-	return buffdesc_comparator(&user1->uname, &usera->uname);
+	struct idmap_entry *entry1 =
+	    avltree_container_of(node1, struct idmap_entry, node);
+	struct idmap_entry *entrya =
+	    avltree_container_of(nodea, struct idmap_entry, node);
+
+	return buffdesc_comparator(&entry1->name, &entrya->name);
 }
 
 /**
- * @brief Comparison for UIDs
+ * @brief Comparison for UIDs and GIDs
  *
  * @param[in] node1 A node
  * @param[in] nodea Another node
@@ -194,97 +183,164 @@ static int uname_comparator(const struct avltree_node *node1,
  * @retval 1 if node1 is greater than nodea
  */
 
-static int uid_comparator(const struct avltree_node *node1,
-			  const struct avltree_node *nodea)
+static int id_comparator(const struct avltree_node *node1,
+			 const struct avltree_node *nodea)
 {
-	struct cache_user *user1 =
-	    avltree_container_of(node1, struct cache_user,
-				 uid_node);
-	struct cache_user *usera =
-	    avltree_container_of(nodea, struct cache_user,
-				 uid_node);
-
-	if (user1->uid < usera->uid)
+	struct idmap_entry *entry1 =
+	    avltree_container_of(node1, struct idmap_entry, node);
+	struct idmap_entry *entrya =
+	    avltree_container_of(nodea, struct idmap_entry, node);
+
+	if (entry1->id < entrya->id)
 		return -1;
-	else if (user1->uid > usera->uid)
+	else if (entry1->id > entrya->id)
 		return 1;
 	else
 		return 0;
 }
 
 /**
- * @brief Comparison for group names
+ * @brief Find the shard holding a key
  *
- * @param[in] node1 A node
- * @param[in] nodea Another node
+ * @param[in] kind Which map
+ * @param[in] key  Entry carrying the key
  *
- * @retval -1 if node1 is less than nodea
- * @retval 0 if node1 and nodea are equal
- * @retval 1 if node1 is greater than nodea
+ * @return The shard.
  */
 
-static inline int gname_comparator(const struct avltree_node *node1,
-				   const struct avltree_node *nodea)
+static inline struct idmap_shard *idmap_shard(enum idmap_kind kind,
+					      const struct idmap_entry *key)
 {
-	struct cache_group *group1 =
-	    avltree_container_of(node1, struct cache_group,
-				 gname_node);
-	struct cache_group *groupa =
-	    avltree_container_of(nodea, struct cache_group,
-				 gname_node);
-
-	return buffdesc_comparator(&group1->gname, &groupa->gname);
+	uint64_t hash;
+
+	if (idmap_by_id(kind))
+		hash = key->id;
+	else
+		hash = CityHash64(key->name.addr, key->name.len);
+
+	return &idmap_shards[kind][hash & (IDMAPPER_SHARDS - 1)];
+}
+
+static inline struct avltree_node **idmap_slot(struct idmap_shard *shard,
+					       uint32_t id)
+{
+	return &shard->slots[(id / IDMAPPER_SHARDS) % IDMAPPER_SLOTS];
 }
 
 /**
- * @brief Comparison for GIDs
+ * @brief Initialize the IDMapper cache
+ */
+
+void idmapper_cache_init(void)
+{
+	int kind, i;
+	struct idmap_shard *shard;
+
+	for (kind = 0; kind < IDMAP_KINDS; kind++) {
+		for (i = 0; i < IDMAPPER_SHARDS; i++) {
+			shard = &idmap_shards[kind][i];
+			pthread_rwlock_init(&shard->lock, NULL);
+			avltree_init(&shard->tree,
+				     idmap_by_id(kind) ? id_comparator :
+				     name_comparator, 0);
+			memset(shard->slots, 0, sizeof(shard->slots));
+		}
+	}
+}
+
+/**
+ * @brief Allocate an entry
  *
- * @param[in] node1 A node
- * @param[in] nodea Another node
+ * @param[in] name     Name, copied into the entry
+ * @param[in] id       UID or GID
+ * @param[in] negative Whether the directory did not know the key
  *
- * @retval -1 if node1 is less than nodea
- * @retval 0 if node1 and nodea are equal
- * @retval 1 if node1 is greater than nodea
+ * @return The entry, expiry set from the configured TTLs, or NULL.
  */
 
-static int gid_comparator(const struct avltree_node *node1,
-			  const struct avltree_node *nodea)
+static struct idmap_entry *idmap_entry_alloc(const struct gsh_buffdesc *name,
+					     uint32_t id, bool negative)
 {
-	struct cache_group *group1 =
-	    avltree_container_of(node1, struct cache_group,
-				 gid_node);
-	struct cache_group *groupa =
-	    avltree_container_of(nodea, struct cache_group,
-				 gid_node);
-
-	if (group1->gid < groupa->gid)
-		return -1;
-	else if (group1->gid > groupa->gid)
-		return 1;
-	else
-		return 0;
+	struct idmap_entry *entry;
+	uint32_t ttl = negative ? nfs_param.nfsv4_param.idmap_negative_ttl
+				: nfs_param.nfsv4_param.idmap_cache_ttl;
+
+	entry = gsh_calloc(1, sizeof(struct idmap_entry) + name->len);
+	if (entry == NULL)
+		return NULL;
+
+	entry->name.addr = (char *)entry + sizeof(struct idmap_entry);
+	entry->name.len = name->len;
+	memcpy(entry->name.addr, name->addr, name->len);
+	entry->id = id;
+	entry->negative = negative;
+	/* A TTL of 0 keeps entries until the cache is cleared */
+	entry->expires = ttl ? time(NULL) + ttl : 0;
+
+	return entry;
 }
 
 /**
- * @brief Initialize the IDMapper cache
+ * @brief Put an entry in a map, replacing any entry with its key
+ *
+ * @param[in] kind  Which map
+ * @param[in] entry The entry, owned by the map on return
  */
 
-void idmapper_cache_init(void)
+static void idmap_insert(enum idmap_kind kind, struct idmap_entry *entry)
 {
-	avltree_init(&uname_tree, uname_comparator, 0);
-	avltree_init(&uid_tree, uid_comparator, 0);
-	memset(uid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
+	struct idmap_shard *shard = idmap_shard(kind, entry);
+	struct avltree_node *found;
+	struct avltree_node **slot = NULL;
+
+	if (idmap_by_id(kind))
+		slot = idmap_slot(shard, entry->id);
+
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
+	found = avltree_lookup(&entry->node, &shard->tree);
+	if (found != NULL) {
+		avltree_replace(found, &entry->node, &shard->tree);
+		if (slot != NULL && *slot == found)
+			*slot = &entry->node;
+		gsh_free(avltree_container_of(found, struct idmap_entry,
+					      node));
+	} else {
+		avltree_insert(&entry->node, &shard->tree);
+	}
+	PTHREAD_RWLOCK_unlock(&shard->lock);
+}
+
+/**
+ * @brief Allocate and insert one entry
+ *
+ * @return true on success, false if out of memory.
+ */
+
+static bool idmap_add(enum idmap_kind kind, const struct gsh_buffdesc *name,
+		      uint32_t id, const gid_t *gid, bool gss_princ,
+		      bool negative)
+{
+	struct idmap_entry *entry = idmap_entry_alloc(name, id, negative);
+
+	if (unlikely(entry == NULL))
+		return false;
+
+	if (gid != NULL) {
+		entry->gid = *gid;
+		entry->gid_set = true;
+	}
+	if (gss_princ) {
+		entry->gss_princ = true;
+		entry->expires = 0;
+	}
 
-	avltree_init(&gname_tree, gname_comparator, 0);
-	avltree_init(&gid_tree, gid_comparator, 0);
-	memset(gid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
+	idmap_insert(kind, entry);
+	return true;
 }
 
 /**
  * @brief Add a user entry to the cache
  *
- * @note The caller must hold idmapper_user_lock for write.
- *
  * @param[in] name The user name
  * @param[in] uid  The user ID
  * @param[in] gid  Optional.  Set to NULL if no gid is known.
@@ -298,89 +354,20 @@ void idmapper_cache_init(void)
 bool idmapper_add_user(const struct gsh_buffdesc *name, uid_t uid,
 		       const gid_t *gid, bool gss_princ)
 {
-	struct avltree_node *found_name;
-	struct avltree_node *found_id;
-	struct cache_user *tmp;
-	struct cache_user *new =
-	    gsh_malloc(sizeof(struct cache_user) + name->len);
-
-	if (new == NULL) {
-		LogMajor(COMPONENT_IDMAPPER,
-			 "Unable to allocate memory for new node. "
-			 "This is not wonderful.");
+	if (!idmap_add(IDMAP_UNAME, name, uid, gid, gss_princ, false))
 		return false;
-	}
-	new->uname.addr = (char *)new + sizeof(struct cache_user);
-	new->uname.len = name->len;
-	new->uid = uid;
-	memcpy(new->uname.addr, name->addr, name->len);
-	if (gid) {
-		new->gid = *gid;
-		new->gid_set = true;
-	} else {
-		new->gid = -1;
-		new->gid_set = false;
-	}
-
-	/*
-	 * The threads that lookup by-name or by-id use the read lock. If
-	 * they don't find an entry, then they release the read lock,
-	 * acquire the write lock and then add the entry. So it is
-	 * possible that multiple threads may fail to find an entry at
-	 * one point and they all try to add. In this case, we will be
-	 * trying to insert same name,id mapping. It is also possible
-	 * that name got a different id or an id got a different name
-	 * causing us to find an existing entry when we are trying to
-	 * add an entry!
-	 *
-	 * If we find an existing entry, we remove it from both the name
-	 * and the id AVL trees, and then add the new entry.
-	 */
-	found_name = avltree_insert(&new->uname_node, &uname_tree);
-	if (unlikely(found_name)) {
-		tmp = avltree_container_of(found_name, struct cache_user,
-					   uname_node);
-		avltree_remove(found_name, &uname_tree);
-		if (tmp->in_uidtree) {
-			uid_cache[tmp->uid % id_cache_size] = NULL;
-			avltree_remove(&tmp->uid_node, &uid_tree);
-		}
-		gsh_free(tmp);
-		found_name = avltree_insert(&new->uname_node, &uname_tree);
-		assert(found_name == NULL);
-	}
-
-	/* If this is gss principal, we don't add to uid_tree */
-	if (gss_princ) {
-		new->in_uidtree = false;
-		goto out;
-	}
 
-	new->in_uidtree = true; /* we will sure insert it! */
-	found_id = avltree_insert(&new->uid_node, &uid_tree);
-	if (unlikely(found_id)) {
-		tmp = avltree_container_of(found_id, struct cache_user,
-					   uid_node);
-		uid_cache[tmp->uid % id_cache_size] = NULL;
-		avltree_remove(found_id, &uid_tree);
-		avltree_remove(&tmp->uname_node, &uname_tree);
-		gsh_free(tmp);
-		found_id = avltree_insert(&new->uid_node, &uid_tree);
-		assert(found_id == NULL);
-	}
-	uid_cache[uid % id_cache_size] = &new->uid_node;
+	if (gss_princ)
+		return true;
 
-out:
-	return true;
+	return idmap_add(IDMAP_UID, name, uid, gid, false, false);
 }
 
 /**
  * @brief Add a group entry to the cache
  *
- * @note The caller must hold idmapper_group_lock for write.
- *
- * @param[in] name The user name
- * @param[in] gid  The group id
+ * @param[in] name The group name
+ * @param[in] gid  The group ID
  *
  * @retval true on success.
  * @retval false if our reach exceeds our grasp.
@@ -388,270 +375,236 @@ out:
 
 bool idmapper_add_group(const struct gsh_buffdesc *name, const gid_t gid)
 {
-	struct avltree_node *found_name;
-	struct avltree_node *found_id;
-	struct cache_group *tmp;
-	struct cache_group *new =
-	    gsh_malloc(sizeof(struct cache_group) + name->len);
-
-	if (new == NULL) {
-		LogMajor(COMPONENT_IDMAPPER,
-			 "Unable to allocate memory for new node. "
-			 "This is not wonderful.");
+	if (!idmap_add(IDMAP_GNAME, name, gid, NULL, false, false))
 		return false;
-	}
-	new->gname.addr = (char *)new + sizeof(struct cache_group);
-	new->gname.len = name->len;
-	new->gid = gid;
-	memcpy(new->gname.addr, name->addr, name->len);
-
-	/*
-	 * The threads that lookup by-name or by-id use the read lock. If
-	 * they don't find an entry, then they release the read lock,
-	 * acquire the write lock and then add the entry. So it is
-	 * possible that multiple threads may fail to find an entry at
-	 * one point and they all try to add. In this case, we will be
-	 * trying to insert same name,id mapping. It is also possible
-	 * that name got a different id or an id got a different name
-	 * causing us to find an existing entry when we are trying to
-	 * add an entry!
-	 *
-	 * If we find an existing entry, we remove it from both the name
-	 * and the id AVL trees, and then add the new entry.
-	 */
-	found_name = avltree_insert(&new->gname_node, &gname_tree);
-	if (unlikely(found_name)) {
-		tmp = avltree_container_of(found_name, struct cache_group,
-					   gname_node);
-		avltree_remove(found_name, &gname_tree);
-		avltree_remove(&tmp->gid_node, &gid_tree);
-		gid_cache[tmp->gid % id_cache_size] = NULL;
-		gsh_free(tmp);
-		found_name = avltree_insert(&new->gname_node, &gname_tree);
-		assert(found_name == NULL);
-	}
 
-	found_id = avltree_insert(&new->gid_node, &gid_tree);
-	if (unlikely(found_id)) {
-		tmp = avltree_container_of(found_id, struct cache_group,
-					   gid_node);
-
-		gid_cache[tmp->gid % id_cache_size] = NULL;
-		avltree_remove(found_id, &gid_tree);
-		avltree_remove(&tmp->gname_node, &gname_tree);
-		gsh_free(tmp);
-		found_id = avltree_insert(&new->gid_node, &gid_tree);
-		assert(found_id == NULL);
-	}
-	gid_cache[gid % id_cache_size] = &new->gid_node;
-
-	return true;
+	return idmap_add(IDMAP_GID, name, gid, NULL, false, false);
 }
 
 /**
- * @brief Look up a user by name
+ * @brief Remember that the directory does not know an id
  *
- * @note The caller must hold idmapper_user_lock for read.
+ * Only the id to name map is touched; name is what we send in its
+ * place (nobody or the number) and never maps back to id.
  *
- * @param[in]  name The user name to look up.
- * @param[out] uid  The user ID found.  May be NULL if the caller
- *                  isn't interested in the UID.  (This seems
- *                  unlikely.)
- * @param[out] gid  The GID for the user, or NULL if there is
- *                  none. The caller may specify NULL if it isn't
- *                  interested.
+ * @param[in] group Whether id is a GID
+ * @param[in] id    The UID or GID
+ * @param[in] name  Name to encode for it
  *
  * @retval true on success.
- * @retval false if we need to try, try again.
+ * @retval false if our reach exceeds our grasp.
  */
 
-bool idmapper_lookup_by_uname(const struct gsh_buffdesc *name, uid_t *uid,
-			      const gid_t **gid, bool gss_princ)
+bool idmapper_add_negative_id(bool group, uint32_t id,
+			      const struct gsh_buffdesc *name)
 {
-	struct cache_user prototype = {
-		.uname = *name
-	};
-	struct avltree_node *found_node = avltree_lookup(&prototype.uname_node,
-							 &uname_tree);
-	struct cache_user *found_user;
-	void **cache_slot;
+	return idmap_add(group ? IDMAP_GID : IDMAP_UID, name, id, NULL,
+			 false, true);
+}
 
-	if (unlikely(!found_node))
-		return false;
+/**
+ * @brief Remember that the directory does not know a name
+ *
+ * The caller substitutes its own anonymous id on a hit, so none is
+ * stored.
+ *
+ * @param[in] group Whether name is a group name
+ * @param[in] name  The name
+ *
+ * @retval true on success.
+ * @retval false if our reach exceeds our grasp.
+ */
 
-	found_user =
-	    avltree_container_of(found_node, struct cache_user, uname_node);
-	if (!gss_princ) {
-		/* I assume that if someone likes this user enough to look it
-		   up by name, they'll like it enough to look it up by ID
-		   later.
+bool idmapper_add_negative_name(bool group, const struct gsh_buffdesc *name)
+{
+	return idmap_add(group ? IDMAP_GNAME : IDMAP_UNAME, name, 0, NULL,
+			 false, true);
+}
 
-		   If the name is gss principal it does not have entry
-		   in uid tree */
+/**
+ * @brief Drop a name from the name to id map
+ *
+ * @param[in] group Whether name is a group name
+ * @param[in] name  The name
+ */
 
-		cache_slot = (void **)
-			&uid_cache[found_user->uid % id_cache_size];
-		atomic_store_voidptr(cache_slot, &found_user->uid_node);
+void idmapper_remove_name(bool group, const struct gsh_buffdesc *name)
+{
+	enum idmap_kind kind = group ? IDMAP_GNAME : IDMAP_UNAME;
+	struct idmap_entry prototype = {
+		.name = *name
+	};
+	struct idmap_shard *shard = idmap_shard(kind, &prototype);
+	struct avltree_node *found;
+
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
+	found = avltree_lookup(&prototype.node, &shard->tree);
+	if (found != NULL) {
+		avltree_remove(found, &shard->tree);
+		gsh_free(avltree_container_of(found, struct idmap_entry,
+					      node));
 	}
-
-	if (likely(uid))
-		*uid = found_user->uid;
-
-	if (unlikely(gid))
-		*gid = (found_user->gid_set ? &found_user->gid : NULL);
-
-	return true;
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 }
 
 /**
- * @brief Look up a user by ID
- *
- * @note The caller must hold idmapper_user_lock for read.
+ * @brief Keep an entry whose refresh could not look it up
  *
- * @param[in]  uid  The user ID to look up.
- * @param[out] name The user name to look up. (May be NULL if the user
- *                  doesn't care about the name.)
- * @param[out] gid  The GID for the user, or NULL if there is
- *                  none. The caller may specify NULL if it isn't
- *                  interested.
+ * The entry stays as it was.  It is tried again once the negative
+ * TTL has passed, or on its next use if that is 0.
  *
- * @retval true on success.
- * @retval false if we weren't so successful.
+ * @param[in] kind Which map the entry is in
+ * @param[in] name Key of the name maps
+ * @param[in] id   Key of the id maps
  */
 
-bool idmapper_lookup_by_uid(const uid_t uid, const struct gsh_buffdesc **name,
-			    const gid_t **gid)
+void idmapper_refresh_failed(enum idmap_kind kind,
+			     const struct gsh_buffdesc *name, uint32_t id)
 {
-	struct cache_user prototype = {
-		.uid = uid
+	struct idmap_entry prototype = {
+		.id = id
 	};
-	void **cache_slot = (void **)&uid_cache[uid % id_cache_size];
-	struct avltree_node *found_node = atomic_fetch_voidptr(cache_slot);
-	struct cache_user *found_user;
-	bool found = false;
-
-	if (likely(found_node)) {
-		found_user = avltree_container_of(found_node,
-						  struct cache_user,
-						  uid_node);
-		if (found_user->uid == uid)
-			found = true;
+	struct idmap_shard *shard;
+	struct avltree_node *found;
+	struct idmap_entry *entry;
+	uint32_t retry = nfs_param.nfsv4_param.idmap_negative_ttl;
+
+	if (!idmap_by_id(kind))
+		prototype.name = *name;
+	shard = idmap_shard(kind, &prototype);
+
+	PTHREAD_RWLOCK_wrlock(&shard->lock);
+	found = avltree_lookup(&prototype.node, &shard->tree);
+	if (found != NULL) {
+		entry = avltree_container_of(found, struct idmap_entry, node);
+		if (entry->expires != 0 && retry != 0)
+			entry->expires = time(NULL) + retry;
+		atomic_store_uint32_t(&entry->refreshing, 0);
 	}
+	PTHREAD_RWLOCK_unlock(&shard->lock);
+}
 
-	if (unlikely(!found)) {
-		found_node = avltree_lookup(&prototype.uid_node, &uid_tree);
-		if (unlikely(!found_node))
-			return false;
+/**
+ * @brief Classify a found entry and queue a refresh if it is stale
+ *
+ * @note The caller must hold the shard lock.
+ *
+ * @param[in] kind  Which map
+ * @param[in] entry The entry found
+ *
+ * @return IDMAP_HIT or IDMAP_NEGATIVE.
+ */
 
-		atomic_store_voidptr(cache_slot, found_node);
-		found_user = avltree_container_of(found_node,
-						  struct cache_user,
-						  uid_node);
+static enum idmap_hit idmap_check(enum idmap_kind kind,
+				  struct idmap_entry *entry)
+{
+	if (entry->expires != 0 && entry->expires <= time(NULL)
+	    && atomic_inc_uint32_t(&entry->refreshing) == 1) {
+		if (!idmapper_refresh(kind, &entry->name, entry->id))
+			atomic_store_uint32_t(&entry->refreshing, 0);
 	}
 
-	if (likely(name))
-		*name = &found_user->uname;
-
-	if (gid)
-		*gid = (found_user->gid_set ? &found_user->gid : NULL);
-
-	return true;
+	return entry->negative ? IDMAP_NEGATIVE : IDMAP_HIT;
 }
 
 /**
- * @brief Lookup a group by name
+ * @brief Look up a user or group by name
  *
- * @note The caller must hold idmapper_group_lock for read.
+ * @param[in]  group   Whether name is a group name
+ * @param[in]  name    The name to look up
+ * @param[out] id      The UID or GID, set on IDMAP_HIT
+ * @param[out] gid     Optional.  Primary GID of a user, if known
+ * @param[out] got_gid Optional.  Whether gid was set
  *
- * @param[in]  name The user name to look up.
- * @param[out] gid  The group ID found.  May be NULL if the caller
- *                  isn't interested in the GID.  (This seems
- *                  unlikely, since you can't get anything else from
- *                  this function.)
- *
- * @retval true on success.
- * @retval false if we need to try, try again.
+ * @retval IDMAP_HIT if the name is cached.
+ * @retval IDMAP_NEGATIVE if the name is cached as unknown.
+ * @retval IDMAP_MISS if the name must be looked up.
  */
 
-bool idmapper_lookup_by_gname(const struct gsh_buffdesc *name, uid_t *gid)
+enum idmap_hit idmapper_lookup_name(bool group,
+				    const struct gsh_buffdesc *name,
+				    uint32_t *id, gid_t *gid, bool *got_gid)
 {
-	struct cache_group prototype = {
-		.gname = *name
+	enum idmap_kind kind = group ? IDMAP_GNAME : IDMAP_UNAME;
+	struct idmap_entry prototype = {
+		.name = *name
 	};
-	struct avltree_node *found_node = avltree_lookup(&prototype.gname_node,
-							 &gname_tree);
-	struct cache_group *found_group;
-	void **cache_slot;
-
-	if (unlikely(!found_node))
-		return false;
-
-	found_group =
-	    avltree_container_of(found_node, struct cache_group, gname_node);
-
-	/* I assume that if someone likes this group enough to look it
-	   up by name, they'll like it enough to look it up by ID
-	   later. */
-
-	cache_slot = (void **)&gid_cache[found_group->gid % id_cache_size];
-	atomic_store_voidptr(cache_slot, &found_group->gid_node);
-
-	if (likely(gid))
-		*gid = found_group->gid;
-	else
-		LogDebug(COMPONENT_IDMAPPER, "Caller is being weird.");
+	struct idmap_shard *shard = idmap_shard(kind, &prototype);
+	struct avltree_node *found;
+	struct idmap_entry *entry;
+	enum idmap_hit hit = IDMAP_MISS;
+
+	PTHREAD_RWLOCK_rdlock(&shard->lock);
+	found = avltree_lookup(&prototype.node, &shard->tree);
+	if (found != NULL) {
+		entry = avltree_container_of(found, struct idmap_entry, node);
+		hit = idmap_check(kind, entry);
+		if (hit == IDMAP_HIT) {
+			*id = entry->id;
+			if (gid != NULL && entry->gid_set)
+				*gid = entry->gid;
+			if (got_gid != NULL)
+				*got_gid = entry->gid_set;
+		}
+	}
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 
-	return true;
+	return hit;
 }
 
 /**
- * @brief Look up a group by ID
+ * @brief Look up the name of a UID or GID
  *
- * @note The caller must hold idmapper_group_lock for read.
+ * On entry name->addr points to a buffer of name->len bytes; on a hit
+ * the name is copied there and name->len set to its length.  A cached
+ * name that does not fit counts as a miss.
  *
- * @param[in]  gid  The group ID to look up.
- * @param[out] name The user name to look up. (May be NULL if the user
- *                  doesn't care about the name, which would be weird.)
+ * @param[in]     group Whether id is a GID
+ * @param[in]     id    The UID or GID
+ * @param[in,out] name  Buffer for the name
  *
- * @retval true on success.
- * @retval false if we're most unfortunate.
+ * @retval IDMAP_HIT if the id is cached.
+ * @retval IDMAP_NEGATIVE if the id is cached as unknown; name is set
+ *         to the name to use in its place.
+ * @retval IDMAP_MISS if the id must be looked up.
  */
 
-bool idmapper_lookup_by_gid(const gid_t gid, const struct gsh_buffdesc **name)
+enum idmap_hit idmapper_lookup_id(bool group, uint32_t id,
+				  struct gsh_buffdesc *name)
 {
-	struct cache_group prototype = {
-		.gid = gid
+	enum idmap_kind kind = group ? IDMAP_GID : IDMAP_UID;
+	struct idmap_entry prototype = {
+		.id = id
 	};
-	void **cache_slot = (void **)&gid_cache[gid % id_cache_size];
-	struct avltree_node *found_node = atomic_fetch_voidptr(cache_slot);
-	struct cache_group *found_group;
-	bool found = false;
-
-	if (likely(found_node)) {
-		found_group = avltree_container_of(found_node,
-						   struct cache_group,
-						   gid_node);
-		if (found_group->gid == gid)
-			found = true;
+	struct idmap_shard *shard = idmap_shard(kind, &prototype);
+	struct avltree_node **slot = idmap_slot(shard, id);
+	struct avltree_node *found;
+	struct idmap_entry *entry = NULL;
+	enum idmap_hit hit = IDMAP_MISS;
+
+	PTHREAD_RWLOCK_rdlock(&shard->lock);
+	found = atomic_fetch_voidptr((void **)slot);
+	if (found != NULL)
+		entry = avltree_container_of(found, struct idmap_entry, node);
+	if (entry == NULL || entry->id != id) {
+		entry = NULL;
+		found = avltree_lookup(&prototype.node, &shard->tree);
+		if (found != NULL) {
+			atomic_store_voidptr((void **)slot, found);
+			entry = avltree_container_of(found,
+						     struct idmap_entry, node);
+		}
 	}
-
-	if (unlikely(!found)) {
-		found_node = avltree_lookup(&prototype.gid_node, &gid_tree);
-		if (unlikely(!found_node))
-			return false;
-
-		atomic_store_voidptr(cache_slot, found_node);
-		found_group = avltree_container_of(found_node,
-						   struct cache_group,
-						   gid_node);
+	if (entry != NULL) {
+		if (entry->name.len <= name->len) {
+			hit = idmap_check(kind, entry);
+			memcpy(name->addr, entry->name.addr, entry->name.len);
+			name->len = entry->name.len;
+		}
 	}
+	PTHREAD_RWLOCK_unlock(&shard->lock);
 
-	if (likely(name))
-		*name = &found_group->gname;
-	else
-		LogDebug(COMPONENT_IDMAPPER, "Caller is being weird.");
-
-	return true;
+	return hit;
 }
 
 /**
@@ -661,43 +614,27 @@ bool idmapper_lookup_by_gid(const gid_t gid, const struct gsh_buffdesc **name)
 void idmapper_clear_cache(void)
 {
 	struct avltree_node *node;
-
-	PTHREAD_RWLOCK_wrlock(&idmapper_user_lock);
-	PTHREAD_RWLOCK_wrlock(&idmapper_group_lock);
-
-	memset(uid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
-	memset(gid_cache, 0, id_cache_size * sizeof(struct avltree_node *));
-
-	for (node = avltree_first(&uname_tree);
-	     node != NULL;
-	     node = avltree_first(&uname_tree)) {
-		struct cache_user *user;
-
-		user = avltree_container_of(node,
-					    struct cache_user, uname_node);
-		avltree_remove(&user->uname_node, &uname_tree);
-		avltree_remove(&user->uid_node, &uid_tree);
-		gsh_free(user);
-	}
-
-	assert(avltree_first(&uid_tree) == NULL);
-
-	for (node = avltree_first(&gname_tree);
-	     node != NULL;
-	     node = avltree_first(&gname_tree)) {
-		struct cache_group *group;
-
-		group = avltree_container_of(node,
-					     struct cache_group, gname_node);
-		avltree_remove(&group->gname_node, &gname_tree);
-		avltree_remove(&group->gid_node, &gid_tree);
-		gsh_free(group);
+	struct idmap_entry *entry;
+	struct idmap_shard *shard;
+	int kind, i;
+
+	for (kind = 0; kind < IDMAP_KINDS; kind++) {
+		for (i = 0; i < IDMAPPER_SHARDS; i++) {
+			shard = &idmap_shards[kind][i];
+			PTHREAD_RWLOCK_wrlock(&shard->lock);
+			memset(shard->slots, 0, sizeof(shard->slots));
+			for (node = avltree_first(&shard->tree);
+			     node != NULL;
+			     node = avltree_first(&shard->tree)) {
+				entry = avltree_container_of(node,
+							     struct idmap_entry,
+							     node);
+				avltree_remove(node, &shard->tree);
+				gsh_free(entry);
+			}
+			PTHREAD_RWLOCK_unlock(&shard->lock);
+		}
 	}
-
-	assert(avltree_first(&gid_tree) == NULL);
-
-	PTHREAD_RWLOCK_unlock(&idmapper_group_lock);
-	PTHREAD_RWLOCK_unlock(&idmapper_user_lock);
 }
 
 /** @} */
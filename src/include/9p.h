@@ -578,6 +578,11 @@ do {                                                   \
  */
 #define _9P_TCP_MSIZE 65536
 
+/**
+ * @brief Default value for _9p_tcp_event_loops
+ */
+#define _9P_TCP_EVENT_LOOPS 4
+
 /**
  * @brief Default value for _9p_rdma_msize
  */
@@ -617,6 +622,9 @@ struct _9p_param {
 	/** Msize for 9P operation on tcp.  Defaults to _9P_TCP_MSIZE,
 	    settable by _9P_TCP_Msize */
 	uint32_t _9p_tcp_msize;
+	/** Threads multiplexing the 9P/TCP connections.  Defaults to
+	    _9P_TCP_EVENT_LOOPS, settable by _9P_TCP_Event_Loops */
+	uint16_t _9p_tcp_event_loops;
 	/** Msize for 9P operation on rdma.  Defaults to _9P_RDMA_MSIZE,
 	    settable by _9P_RDMA_Msize */
 	uint32_t _9p_rdma_msize;
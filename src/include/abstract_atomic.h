@@ -34,6 +34,7 @@
 #define _ABSTRACT_ATOMIC_H
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #undef GCC_SYNC_FUNCTIONS
 #undef GCC_ATOMIC_FUNCTIONS
@@ -2386,4 +2387,89 @@ static inline void atomic_store_uint8_t(uint8_t *var, uint8_t val)
 	(void)__sync_lock_test_and_set(var, val);
 }
 #endif
+
+/*
+ * Compare and swap
+ */
+
+/**
+ * @brief Atomically compare and swap a uint32_t
+ *
+ * If *var equals expected, store newval in it.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in]     expected The value var must hold
+ * @param[in]     newval   The value to store
+ *
+ * @return true if the swap was performed.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_uint32_t(uint32_t *var, uint32_t expected,
+				       uint32_t newval)
+{
+	return __atomic_compare_exchange_n(var, &expected, newval, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_uint32_t(uint32_t *var, uint32_t expected,
+				       uint32_t newval)
+{
+	return __sync_bool_compare_and_swap(var, expected, newval);
+}
+#endif
+
+/**
+ * @brief Atomically compare and swap a uint64_t
+ *
+ * If *var equals expected, store newval in it.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in]     expected The value var must hold
+ * @param[in]     newval   The value to store
+ *
+ * @return true if the swap was performed.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_uint64_t(uint64_t *var, uint64_t expected,
+				       uint64_t newval)
+{
+	return __atomic_compare_exchange_n(var, &expected, newval, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_uint64_t(uint64_t *var, uint64_t expected,
+				       uint64_t newval)
+{
+	return __sync_bool_compare_and_swap(var, expected, newval);
+}
+#endif
+
+/**
+ * @brief Atomically compare and swap a void pointer
+ *
+ * If *var equals expected, store newval in it.
+ *
+ * @param[in,out] var      Pointer to the variable to modify
+ * @param[in]     expected The value var must hold
+ * @param[in]     newval   The value to store
+ *
+ * @return true if the swap was performed.
+ */
+
+#ifdef GCC_ATOMIC_FUNCTIONS
+static inline bool atomic_cas_voidptr(void **var, void *expected,
+				      void *newval)
+{
+	return __atomic_compare_exchange_n(var, &expected, newval, false,
+					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined(GCC_SYNC_FUNCTIONS)
+static inline bool atomic_cas_voidptr(void **var, void *expected,
+				      void *newval)
+{
+	return __sync_bool_compare_and_swap(var, expected, newval);
+}
+#endif
 #endif				/* !_ABSTRACT_ATOMIC_H */
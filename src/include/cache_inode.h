@@ -43,6 +43,7 @@
 #include <time.h>
 #include <pthread.h>
 #include "abstract_mem.h"
+#include "abstract_atomic.h"
 #include "hashtable.h"
 #include "avltree.h"
 #include "fsal.h"
@@ -53,7 +54,9 @@
 #include "nfs4.h"
 #include "nlm4.h"
 #include "ganesha_list.h"
+#include "interval_tree.h"
 #include "nfs4_acls.h"
+#include "nfs_trace.h"
 
 
 /**
@@ -82,6 +85,18 @@ struct cache_inode_parameter {
 	/** Base interval in seconds between runs of the LRU cleaner
 	    thread. Defaults to 60, settable with LRU_Run_Interval. */
 	time_t lru_run_interval;
+	/** Replacement policy for cache entries.  Defaults to
+	    LRU_POLICY_LRU, settable with LRU_Policy. */
+	uint32_t lru_policy;
+	/** Share of Entries_HWMark (percent) that new entries may
+	    occupy on probation before they are preferred for reclaim
+	    under LRU_POLICY_2Q.  Defaults to 25, settable with
+	    LRU_Probation_Percent. */
+	uint32_t lru_probation_percent;
+	/** Size of the ghost list of recently reclaimed probationary
+	    entries, as a percentage of Entries_HWMark.  Defaults to 50,
+	    settable with LRU_Ghost_Percent. */
+	uint32_t lru_ghost_percent;
 	/** Whether to cache open files.  Defaults to true, settable
 	    with Cache_FDs. */
 	bool use_fd_cache;
@@ -121,8 +136,24 @@ struct cache_inode_parameter {
 	    client a partial reply based on what we have.
 	    Defaults to false, settable with Retry_Readdir */
 	bool retry_readdir;
+	/** Directories with more entries than this are cached in
+	    chunks of this many entries, loaded on demand from the
+	    FSAL cookie.  0 always caches whole directories.  Defaults
+	    to 0, settable with Dir_Chunk. */
+	uint32_t dir_chunk;
+	/** High water mark for entries held in directory chunks
+	    across all directories.  Defaults to 1000000, settable
+	    with Dir_Chunk_HWMark. */
+	uint32_t dir_chunk_hwmark;
 };
 
+/**
+ * @brief Replacement policies, selected by LRU_Policy
+ */
+
+#define LRU_POLICY_LRU 0	/*< two-level LRU, new entries enter L1 */
+#define LRU_POLICY_2Q 1		/*< probation queue plus ghost list */
+
 /** @} */
 
 extern struct config_block cache_inode_param_blk;
@@ -152,7 +183,8 @@ enum lru_q_id {
 	LRU_ENTRY_L1,
 	LRU_ENTRY_L2,
 	LRU_ENTRY_PINNED,
-	LRU_ENTRY_CLEANUP
+	LRU_ENTRY_CLEANUP,
+	LRU_ENTRY_PROBATION
 };
 
 typedef struct cache_inode_lru__ {
@@ -183,6 +215,8 @@ struct cache_stats {
 	uint64_t inode_conf;
 	uint64_t inode_added;
 	uint64_t inode_mapping;
+	uint64_t inode_reclaim;
+	uint64_t inode_ghost_hit;
 };
 
 extern struct cache_stats *cache_stp;
@@ -196,7 +230,8 @@ typedef enum io_direction__ {
 	CACHE_INODE_READ = 1,		/*< Reading */
 	CACHE_INODE_WRITE = 2,		/*< Writing */
 	CACHE_INODE_READ_PLUS = 3,	/*< Reading plus */
-	CACHE_INODE_WRITE_PLUS = 4	/*< Writing plus */
+	CACHE_INODE_WRITE_PLUS = 4,	/*< Writing plus */
+	CACHE_INODE_READ_IOBUF = 5	/*< Reading into an FSAL payload */
 } cache_inode_io_direction_t;
 
 /**
@@ -224,6 +259,8 @@ static const uint32_t CACHE_INODE_TRUST_ATTRS = 0x00000001;
 static const uint32_t CACHE_INODE_TRUST_CONTENT = 0x00000002;
 /** The directory has been populated (negative lookups are meaningful) */
 static const uint32_t CACHE_INODE_DIR_POPULATED = 0x00000004;
+/** The directory is too big to cache whole and is cached in chunks */
+static const uint32_t CACHE_INODE_DIR_CHUNKED = 0x00000008;
 
 /**
  * @brief The ref counted share reservation state.
@@ -301,15 +338,36 @@ cache_inode_key_delete(cache_inode_key_t *key)
 	key->kv.addr = (void *)0xdeaddeaddeaddead;
 }
 
+/**
+ * @brief Bump allocator for directory entries
+ *
+ * Dirents of a directory (or of one chunk of it) are carved out of
+ * slabs that grow geometrically up to a maximum size.  Nothing is
+ * freed individually; all slabs go at once when the dirents are
+ * released.  Space given up by dead dirents is counted so that the
+ * owner can throw the arena away once it is mostly garbage.
+ */
+
+struct dir_arena {
+	struct glist_head slabs;	/*< Slabs, newest first */
+	char *next;		/*< Free space in the newest slab */
+	size_t avail;		/*< Bytes free at next */
+	size_t slab_size;	/*< Size of the next slab */
+	size_t used;		/*< Bytes handed out */
+	size_t dead;		/*< Bytes handed out but no longer used */
+};
+
 /**
  * @brief Represents a cached directory entry
  *
  * This is a cached directory entry that associates a name and cookie
- * with a cache entry.
+ * with a cache entry.  The name and the key of the cache entry are
+ * stored inline after the structure, in a struct dir_arena.
  */
 
 #define DIR_ENTRY_FLAG_NONE     0x0000
 #define DIR_ENTRY_FLAG_DELETED  0x0001
+#define DIR_ENTRY_FLAG_CHUNKED  0x0002	/*< Has a struct dir_chunk_link */
 
 typedef struct cache_inode_dir_entry__ {
 	struct avltree_node node_hk;	/*< AVL node in tree */
@@ -319,26 +377,63 @@ typedef struct cache_inode_dir_entry__ {
 	} hk;
 	cache_inode_key_t ckey;	/*< Key of cache entry */
 	uint32_t flags;		/*< Flags */
+	uint32_t size;		/*< Bytes taken from the arena */
 	char name[];		/*< The NUL-terminated filename */
 } cache_inode_dir_entry_t;
 
 /**
- * @brief Deep free a dirent.
- *
- * Deep free a dirent..
- *
- * @param dirent [in] Dirent to be freed.
+ * @brief Chunk linkage of an entry of a chunked directory
  *
- * @return Pointer to node if found, else NULL.
+ * Only dirents allocated for a chunk (DIR_ENTRY_FLAG_CHUNKED) have
+ * one; it sits in the chunk's arena right in front of the dirent, so
+ * the dirents of whole-directory caches do not pay for it.
  */
-static inline void
-cache_inode_free_dirent(cache_inode_dir_entry_t *dirent)
+
+struct dir_chunk_link {
+	struct dir_chunk *chunk;	/*< Chunk holding this entry */
+	struct glist_head chunk_list;	/*< Link in the chunk's entries */
+	struct avltree_node node_name;	/*< Node in chunks.names */
+};
+
+static inline struct dir_chunk_link *
+dirent_chunk_link(cache_inode_dir_entry_t *dirent)
 {
-	if (dirent->ckey.kv.addr)
-		gsh_free(dirent->ckey.kv.addr);
-	gsh_free(dirent);
+	return (struct dir_chunk_link *)dirent - 1;
 }
 
+static inline cache_inode_dir_entry_t *
+chunk_link_dirent(struct dir_chunk_link *link)
+{
+	return (cache_inode_dir_entry_t *)(link + 1);
+}
+
+/**
+ * @brief A run of consecutive entries of a chunked directory
+ *
+ * The chunk holds the entries the FSAL returned when asked to read
+ * from whence.  Entries of a chunked directory are keyed by their
+ * FSAL cookie, which clients see shifted by DIR_CHUNK_COOKIE_OFFSET,
+ * so a chunk that has been evicted can be read again from any cookie
+ * a client sends.  Chunks of all directories share one LRU.
+ */
+
+struct dir_chunk {
+	struct avltree_node node_whence;	/*< Node in chunks.t */
+	struct glist_head dirents;	/*< Entries in FSAL order */
+	struct dir_arena arena;	/*< Storage for the entries */
+	fsal_cookie_t whence;	/*< Cookie the chunk was read from */
+	uint32_t count;		/*< Number of entries */
+	bool eod;		/*< The last entry ends the directory */
+	struct glist_head lru;	/*< Link in the chunk LRU */
+	cache_entry_t *directory;	/*< Directory holding it */
+};
+
+/**
+ * Cookies 1 and 2 stand for "." and ".." in NFS, so the FSAL cookies
+ * of chunked entries are shifted past them.
+ */
+#define DIR_CHUNK_COOKIE_OFFSET 2
+
 /**
  * @brief Represents one of the many-many links between inodes and exports.
  *
@@ -484,6 +579,14 @@ struct cache_entry_t {
 		struct cache_inode_file {
 			/** Pointers for lock list */
 			struct glist_head lock_list;
+			/** Locks on lock_list indexed by byte range */
+			struct itree lock_tree;
+			/** Locks on lock_list not yet granted, oldest first */
+			struct glist_head lock_blocked;
+			/** Export of the locks on lock_list, unless mixed */
+			struct gsh_export *lock_export;
+			/** Locks on lock_list came through several exports */
+			bool lock_exports_mixed;
 			/** Pointers for delegation list */
 			struct glist_head deleg_list;
 			/** Pointers for NLM share list */
@@ -506,7 +609,20 @@ struct cache_entry_t {
 				struct avltree c;
 				/** Heuristic. Expect 0. */
 				uint32_t collisions;
+				/** Storage for the entries of t and c */
+				struct dir_arena arena;
 			} avl;
+			/** Chunks, if CACHE_INODE_DIR_CHUNKED is set */
+			struct {
+				/** Chunks by whence */
+				struct avltree t;
+				/** Chunked entries by FSAL cookie */
+				struct avltree ck;
+				/** Chunked entries by name */
+				struct avltree names;
+				/** Number of chunks */
+				uint32_t count;
+			} chunks;
 			/** If this is a junction, the export this node points
 			    to. Protected by the attr_lock. */
 			struct gsh_export *junction_export;
@@ -846,6 +962,26 @@ cache_inode_status_t cache_inode_rdwr_plus(cache_entry_t *entry,
 				      bool *eof,
 				      bool *sync, struct io_info *info);
 
+cache_inode_status_t cache_inode_read_iobuf(cache_entry_t *entry,
+					    uint64_t offset, size_t io_size,
+					    struct gsh_iobuf **iob,
+					    bool *eof);
+
+cache_inode_status_t cache_inode_rdwr_async(cache_entry_t *entry,
+					    cache_inode_io_direction_t
+					    io_direction,
+					    struct fsal_io_arg *io_arg,
+					    bool *sync,
+					    fsal_async_cb done_cb,
+					    void *caller_arg);
+
+cache_inode_status_t cache_inode_rdwr_async_done(cache_entry_t *entry,
+						 cache_inode_io_direction_t
+						 io_direction,
+						 struct fsal_io_arg *io_arg,
+						 bool *sync,
+						 fsal_status_t fsal_status);
+
 cache_inode_status_t cache_inode_commit(cache_entry_t *entry, uint64_t offset,
 					size_t count);
 
@@ -874,6 +1010,11 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(
 void cache_inode_release_dirents(cache_entry_t *entry,
 				 cache_inode_avl_which_t which);
 
+void cache_inode_release_dir_chunks(cache_entry_t *entry);
+void cache_inode_dir_chunks_changed(cache_entry_t *directory);
+void cache_inode_dir_chunks_removed(cache_entry_t *directory,
+				    const char *name);
+
 void cache_inode_kill_entry(cache_entry_t *entry);
 
 cache_inode_status_t cache_inode_invalidate(cache_entry_t *entry,
@@ -883,6 +1024,70 @@ inline int cache_inode_set_time_current(struct timespec *time);
 
 void cache_inode_destroyer(void);
 
+extern uint32_t cache_inode_fsal_busy;
+extern __thread uint32_t cache_inode_fsal_depth;
+
+/**
+ * @brief Note that this thread is about to call into the FSAL
+ *
+ * Counts the thread in cache_inode_fsal_busy, which the worker pool
+ * sizes itself by, and traces the call.  Calls made from inside
+ * another one, as from a readdir callback, are not counted twice.
+ *
+ * @param[in] op The FSAL call, an enum nfs_trace_fsal_op
+ */
+
+static inline void cache_inode_fsal_enter(uint16_t op)
+{
+	if (cache_inode_fsal_depth++ == 0)
+		atomic_inc_uint32_t(&cache_inode_fsal_busy);
+	NFS_TRACE_FSAL(NFS_TRACE_FSAL_ENTER, op);
+}
+
+/**
+ * @brief Note that this thread is back from the FSAL
+ *
+ * @param[in] op The FSAL call, as passed to cache_inode_fsal_enter
+ */
+
+static inline void cache_inode_fsal_exit(uint16_t op)
+{
+	NFS_TRACE_FSAL(NFS_TRACE_FSAL_EXIT, op);
+	if (--cache_inode_fsal_depth == 0)
+		atomic_dec_uint32_t(&cache_inode_fsal_busy);
+}
+
+/**
+ * @brief Note that this thread is back from submitting an FSAL call
+ *
+ * For asynchronous calls: the thread is no longer busy in the FSAL,
+ * but the call is not over.  Its exit is traced by
+ * cache_inode_fsal_async_done once it completes.
+ */
+
+static inline void cache_inode_fsal_submitted(void)
+{
+	if (--cache_inode_fsal_depth == 0)
+		atomic_dec_uint32_t(&cache_inode_fsal_busy);
+}
+
+/**
+ * @brief Trace the completion of an asynchronous FSAL call
+ *
+ * To be called from the completion callback, on whatever thread runs
+ * it, so op_ctx is not available: the request's trace id has to be
+ * saved at submission.
+ *
+ * @param[in] trace_id op_ctx->trace_id of the submitting request
+ * @param[in] op       The FSAL call, as passed to cache_inode_fsal_enter
+ */
+
+static inline void cache_inode_fsal_async_done(uint64_t trace_id,
+					       uint16_t op)
+{
+	NFS_TRACE(trace_id, NFS_TRACE_FSAL_EXIT, op);
+}
+
 /**
  * @brief Update cache_entry metadata from its attributes
  *
@@ -981,8 +1186,10 @@ cache_inode_refresh_attrs(cache_entry_t *entry)
 		entry->obj_handle->attributes.acl = NULL;
 	}
 
+	cache_inode_fsal_enter(NFS_TRACE_FSAL_GETATTRS);
 	fsal_status =
 	    entry->obj_handle->ops->getattrs(entry->obj_handle);
+	cache_inode_fsal_exit(NFS_TRACE_FSAL_GETATTRS);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		cache_inode_kill_entry(entry);
 		cache_status = cache_inode_error_convert(fsal_status);
@@ -73,9 +73,51 @@ static inline int avl_dirent_hk_cmpf(const struct avltree_node *lhs,
 	return 1;
 }
 
+static inline int avl_dir_chunk_cmpf(const struct avltree_node *lhs,
+				     const struct avltree_node *rhs)
+{
+	struct dir_chunk *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct dir_chunk, node_whence);
+	rk = avltree_container_of(rhs, struct dir_chunk, node_whence);
+
+	if (lk->whence < rk->whence)
+		return -1;
+
+	if (lk->whence == rk->whence)
+		return 0;
+
+	return 1;
+}
+
+static inline int avl_dirent_name_cmpf(const struct avltree_node *lhs,
+				       const struct avltree_node *rhs)
+{
+	struct dir_chunk_link *lk, *rk;
+
+	lk = avltree_container_of(lhs, struct dir_chunk_link, node_name);
+	rk = avltree_container_of(rhs, struct dir_chunk_link, node_name);
+
+	return strcmp(chunk_link_dirent(lk)->name, chunk_link_dirent(rk)->name);
+}
+
 void avl_dirent_set_deleted(cache_entry_t *entry, cache_inode_dir_entry_t *v);
 void avl_dirent_clear_deleted(cache_entry_t *entry,
 			      cache_inode_dir_entry_t *v);
+void dir_arena_init(struct dir_arena *arena);
+void dir_arena_release(struct dir_arena *arena);
+bool dir_arena_wasteful(const struct dir_arena *arena);
+cache_inode_dir_entry_t *
+cache_inode_dirent_alloc(struct dir_arena *arena, const char *name,
+			 const cache_inode_key_t *key);
+cache_inode_dir_entry_t *
+cache_inode_dirent_alloc_chunked(struct dir_arena *arena, const char *name,
+				 const cache_inode_key_t *key);
+void cache_inode_dirent_free(struct dir_arena *arena,
+			     cache_inode_dir_entry_t *dirent);
+int cache_inode_dirent_set_key(struct dir_arena *arena,
+			       cache_inode_dir_entry_t *dirent,
+			       const cache_inode_key_t *key);
 void cache_inode_avl_init(cache_entry_t *entry);
 int cache_inode_avl_qp_insert(cache_entry_t *entry,
 			      cache_inode_dir_entry_t *v);
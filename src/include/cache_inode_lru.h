@@ -67,6 +67,9 @@
 struct lru_state {
 	uint64_t entries_hiwat;
 	uint64_t entries_used;
+	/** Under LRU_POLICY_2Q, probationary entries are reclaimed
+	    ahead of L1 and L2 once there are more than this many. */
+	uint64_t probation_hiwat;
 	uint32_t fds_system_imposed;
 	uint32_t fds_hard_limit;
 	uint32_t fds_hiwat;
@@ -84,6 +87,22 @@ struct lru_state {
 
 extern struct lru_state lru_state;
 
+/**
+ * Occupancy of the LRU lanes of one NUMA node
+ */
+
+struct lru_node_stats {
+	uint64_t entries_used;	/*< entries owned by the node */
+	uint64_t l1;
+	uint64_t l2;
+	uint64_t probation;
+	uint64_t pinned;
+	uint64_t cleanup;
+};
+
+uint32_t cache_inode_lru_nodes(void);
+void cache_inode_lru_node_stats(uint32_t node, struct lru_node_stats *st);
+
 /**
  * Flags for functions in the LRU package
  */
@@ -130,7 +149,8 @@ extern int cache_inode_lru_pkgshutdown(void);
 
 extern size_t open_fd_count;
 
-cache_inode_status_t cache_inode_lru_get(struct cache_entry_t **entry);
+cache_inode_status_t cache_inode_lru_get(const cache_inode_key_t *key,
+					 struct cache_entry_t **entry);
 void cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags);
 
 /* XXX */
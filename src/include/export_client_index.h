@@ -0,0 +1,60 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file   export_client_index.h
+ * @brief  Compiled form of an export's client list
+ *
+ * When an export is committed its client list is compiled into a
+ * binary trie of IPv4 networks, a hash of host addresses and a short
+ * list of the entries that can only be matched by name (netgroups and
+ * wildcards).  A lookup returns the same entry as walking the list in
+ * order would: the first one that matches.  Name matches, which may
+ * need a reverse lookup, are only tried for entries ahead of the best
+ * address match, and their outcome is remembered per client address.
+ *
+ * The index belongs to the export and is rebuilt with it, so removing
+ * and adding an export also drops its cached decisions.
+ */
+
+#ifndef EXPORT_CLIENT_INDEX_H
+#define EXPORT_CLIENT_INDEX_H
+
+#include <stdbool.h>
+#include "ganesha_list.h"
+#include "ganesha_rpc.h"
+#include "nfs_exports.h"
+
+struct client_index;
+
+/**
+ * @brief Match one entry of the client list the slow way
+ */
+typedef bool (*client_match_fn)(exportlist_client_entry_t *client,
+				sockaddr_t *hostaddr);
+
+struct client_index *client_index_build(struct glist_head *clients);
+void client_index_free(struct client_index *ci);
+exportlist_client_entry_t *client_index_match(struct client_index *ci,
+					      sockaddr_t *hostaddr,
+					      client_match_fn match);
+
+#endif				/* EXPORT_CLIENT_INDEX_H */
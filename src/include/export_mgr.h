@@ -79,6 +79,8 @@ struct gsh_export {
 	cache_entry_t *exp_root_cache_inode;
 	/** Allowed clients */
 	struct glist_head clients;
+	/** Compiled form of clients, NULL to walk the list */
+	struct client_index *client_index;
 	/** Entry for the junction of this export.  Protected by lock */
 	cache_entry_t *exp_junction_inode;
 	/** The export this export sits on. Protected by lock */
@@ -84,6 +84,8 @@ struct fridgethr_entry {
 					   threads */
 	struct glist_head idle_link; /*< Link in the idle queue */
 	struct fridgethr *fr; /*< The fridge we belong to */
+	bool retire; /*< Looper thread picked to exit by
+			 fridgethr_shrink */
 };
 
 /**
@@ -211,6 +213,9 @@ struct fridgethr {
 	pthread_cond_t *cb_cv;	/*< Condition variable, signalled on
 				   completion */
 	bool transitioning; /*< Changing state */
+	uint32_t retire_req; /*< Looper threads fridgethr_shrink wants
+				 gone that have not yet noticed */
+	uint32_t retiring; /*< Looper threads on their way out */
 	union {
 		struct glist_head work_q; /*< Work queued */
 		struct {
@@ -246,6 +251,10 @@ int fridgethr_sync_command(struct fridgethr *, fridgethr_comm_t, time_t);
 bool fridgethr_you_should_break(struct fridgethr_context *);
 int fridgethr_populate(struct fridgethr *, void (*)(struct fridgethr_context *),
 		      void *);
+int fridgethr_grow(struct fridgethr *, void (*)(struct fridgethr_context *),
+		   void *, uint32_t);
+uint32_t fridgethr_shrink(struct fridgethr *, uint32_t);
+uint32_t fridgethr_nthreads(struct fridgethr *);
 
 void fridgethr_setwait(struct fridgethr_context *ctx, time_t thread_delay);
 time_t fridgethr_getwait(struct fridgethr_context *ctx);
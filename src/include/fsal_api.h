@@ -43,6 +43,7 @@
 #include "fsal_pnfs.h"
 #include "avltree.h"
 #include "abstract_atomic.h"
+#include "gsh_iobuf.h"
 
 /**
  * @page newapi New FSAL API
@@ -1209,6 +1210,40 @@ typedef uint64_t fsal_cookie_t;
 
 typedef bool(*fsal_readdir_cb) (const char *name, void *dir_state,
 				fsal_cookie_t cookie);
+
+/**
+ * @brief Arguments and results of an asynchronous read or write
+ *
+ * The caller owns this structure and must keep it, and the buffer it
+ * points to, alive until the completion callback has run.
+ */
+
+struct fsal_io_arg {
+	uint64_t offset;	/*< Position at which to read or write */
+	size_t io_length;	/*< Bytes to read or write */
+	void *buffer;		/*< Data to be read into or written from */
+	size_t io_amount;	/*< Bytes actually read or written */
+	bool end_of_file;	/*< A read reached the end of file */
+	bool fsal_stable;	/*< In, stable write requested.  Out, what
+				    the FSAL did */
+};
+
+/**
+ * @brief Completion callback for read2 and write2
+ *
+ * This may run on an FSAL completion thread, without a request
+ * context, and must not block.
+ *
+ * @param[in] obj_hdl    File the I/O was done on
+ * @param[in] ret        Result of the I/O
+ * @param[in] io_arg     The caller's I/O arguments, results filled in
+ * @param[in] caller_arg Opaque argument given by the caller
+ */
+
+typedef void (*fsal_async_cb)(struct fsal_obj_handle *obj_hdl,
+			      fsal_status_t ret,
+			      struct fsal_io_arg *io_arg,
+			      void *caller_arg);
 /**
  * @brief FSAL objectoperations vector
  */
@@ -1595,6 +1630,35 @@ struct fsal_obj_ops {
 				   bool *end_of_file,
 				   struct io_info *info);
 
+/**
+ * @brief Read data from a file into a payload the FSAL provides
+ *
+ * This function reads data from the given file into a reference
+ * counted payload.  The FSAL chooses where the bytes live (a
+ * registered buffer, a pool, the heap) and the caller hands the
+ * payload straight to the protocol reply, dropping its reference with
+ * gsh_iobuf_put once the reply has been sent.
+ *
+ * The default reads through the read op into a pooled payload; VFS
+ * preads straight into one.  The op saves the reply's own buffer, not
+ * a copy: the XDR encoder still copies the payload when it encodes the
+ * reply.
+ *
+ * @param[in]  obj_hdl     File to read
+ * @param[in]  offset      Position from which to read
+ * @param[in]  buffer_size Amount of data to read
+ * @param[out] iob         Payload holding the data read, with one
+ *                         reference held for the caller
+ * @param[out] end_of_file true if the end of file has been reached
+ *
+ * @return FSAL status.
+ */
+	fsal_status_t(*read_iobuf) (struct fsal_obj_handle *obj_hdl,
+				    uint64_t offset,
+				    size_t buffer_size,
+				    struct gsh_iobuf **iob,
+				    bool *end_of_file);
+
 /**
  * @brief Write data to a file
  *
@@ -1641,6 +1705,44 @@ struct fsal_obj_ops {
 				size_t *wrote_amount,
 				bool *fsal_stable,
 				struct io_info *info);
+
+/**
+ * @brief Start an asynchronous read
+ *
+ * This function starts reading data from the given file and returns
+ * without waiting for the data.  done_cb is called exactly once with
+ * the result, possibly before read2 returns.  The FSAL must take
+ * everything it needs from the file and from op_ctx before returning,
+ * since the caller drops its locks on the entry once read2 returns.
+ * Callers only suspend requests on read2 where the export answers
+ * fso_async_io; the default method completes inline.
+ *
+ * @param[in]     obj_hdl    File to read
+ * @param[in,out] read_arg   Offset, length and buffer; results
+ * @param[in]     done_cb    Completion callback
+ * @param[in]     caller_arg Argument for done_cb
+ */
+	 void (*read2) (struct fsal_obj_handle *obj_hdl,
+			struct fsal_io_arg *read_arg,
+			fsal_async_cb done_cb,
+			void *caller_arg);
+
+/**
+ * @brief Start an asynchronous write
+ *
+ * As read2, for writes.  If fsal_stable is set and the FSAL cannot
+ * make the write stable as part of the operation it clears
+ * fsal_stable, and the caller commits.
+ *
+ * @param[in]     obj_hdl    File to be written
+ * @param[in,out] write_arg  Offset, length and data; results
+ * @param[in]     done_cb    Completion callback
+ * @param[in]     caller_arg Argument for done_cb
+ */
+	 void (*write2) (struct fsal_obj_handle *obj_hdl,
+			 struct fsal_io_arg *write_arg,
+			 fsal_async_cb done_cb,
+			 void *caller_arg);
 /**
  * @brief Seek to data or hole
  *
@@ -165,6 +165,7 @@ struct req_op_context {
 	nsecs_elapsed_t start_time;	/*< start time of this op/request */
 	nsecs_elapsed_t queue_wait;	/*< time in wait queue */
 	void *fsal_private;		/*< private for FSAL use */
+	uint64_t trace_id;		/*< request trace id, 0 if none */
 	/* add new context members here */
 };
 
@@ -644,7 +645,8 @@ typedef enum enum_fsal_fsinfo_options {
 	fso_share_support,
 	fso_share_support_owner,
 	fso_pnfs_ds_supported,
-	fso_reopen_method
+	fso_reopen_method,
+	fso_async_io
 } fsal_fsinfo_options_t;
 
 /* The largest maxread and maxwrite value */
@@ -0,0 +1,64 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file   gsh_bufpool.h
+ * @brief  Size-classed pool for I/O payload buffers
+ *
+ * READ and WRITE payloads are taken from power-of-two size classes
+ * between BUFPOOL_MIN_SHIFT and BUFPOOL_MAX_SHIFT.  Each class is a
+ * pool_t on a caching substrate: freed buffers are kept first in a
+ * small per-thread cache and then on a shared free list, so a worker
+ * serving steady I/O reuses the same already-faulted pages instead of
+ * going back to malloc.  Requests larger than the biggest class are
+ * served from the heap and counted as oversize.
+ */
+
+#ifndef GSH_BUFPOOL_H
+#define GSH_BUFPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gsh_iobuf.h"
+
+#define BUFPOOL_MIN_SHIFT 12	/* 4 KiB */
+#define BUFPOOL_MAX_SHIFT 20	/* 1 MiB */
+#define BUFPOOL_N_CLASSES (BUFPOOL_MAX_SHIFT - BUFPOOL_MIN_SHIFT + 1)
+
+/**
+ * @brief Occupancy and miss counters for one size class
+ */
+
+struct bufpool_class_stats {
+	uint64_t size;		/*< Buffer size of this class */
+	uint64_t in_use;	/*< Buffers handed out and not returned */
+	uint64_t cached;	/*< Free buffers held by the pool */
+	uint64_t allocs;	/*< Buffers handed out */
+	uint64_t misses;	/*< Allocations that went to the heap */
+};
+
+int gsh_bufpool_init(void);
+void *gsh_bufpool_get(size_t size);
+void gsh_bufpool_put(void *buf, size_t size);
+struct gsh_iobuf *gsh_bufpool_iobuf(size_t size);
+uint64_t gsh_bufpool_stats(struct bufpool_class_stats *stats);
+
+#endif				/* GSH_BUFPOOL_H */
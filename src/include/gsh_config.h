@@ -81,6 +81,16 @@ typedef enum protos {
  */
 #define NB_WORKER_THREAD_DEFAULT 16
 
+/**
+ * @brief Default value for core_param.worker_qwait_target
+ */
+#define WORKER_QWAIT_TARGET_DEFAULT 2000
+
+/**
+ * @brief Default number of records in a request trace file
+ */
+#define TRACE_RECORDS_DEFAULT 65536
+
 /**
  * @brief Default value for core_param.drc.tcp.npart
  */
@@ -141,6 +151,16 @@ typedef enum protos {
  */
 #define DRC_UDP_CHECKSUM true
 
+/**
+ * @brief Default value for core_param.drc.memory_budget
+ */
+#define DRC_MEMORY_BUDGET (256 * 1024 * 1024)	/* 256 MiB */
+
+/**
+ * @brief Default value for core_param.drc.retire_window_s
+ */
+#define DRC_RETIRE_WINDOW_S 10
+
 /**
  * @brief Default value for core_param.rpc.debug_flags
  */
@@ -188,6 +208,23 @@ typedef struct nfs_core_param {
 	/** Number of worker threads.  Set to NB_WORKER_DEFAULT by
 	    default and changed with the Nb_Worker option. */
 	uint32_t nb_worker;
+	/** Fewest worker threads the pool shrinks to when idle.  0, the
+	    default, means Nb_Worker.  Settable with Min_Worker. */
+	uint32_t min_worker;
+	/** Most worker threads the pool grows to under load.  0, the
+	    default, means Nb_Worker.  Settable with Max_Worker.  The
+	    pool is fixed at Nb_Worker unless Min_Worker or Max_Worker
+	    differs from it. */
+	uint32_t max_worker;
+	/** Average time, in microseconds, requests may wait on the
+	    queue before the worker pool grows.  Defaults to
+	    WORKER_QWAIT_TARGET_DEFAULT and settable with
+	    Worker_Qwait_Target. */
+	uint32_t worker_qwait_target;
+	/** Whether to bind each worker thread to the CPUs of one NUMA
+	    node, spreading workers round-robin over the nodes.  False
+	    by default and settable with Worker_NUMA_Bind. */
+	bool worker_numa_bind;
 	/** For NFSv3, whether to drop rather than reply to requests
 	    yielding I/O errors.  True by default and settable with
 	    Drop_IO_Errors.  As this generally results in client
@@ -212,6 +249,15 @@ typedef struct nfs_core_param {
 	    specific transport.  Defaults to 512 and settable by
 	    Dispatch_Max_Reqs_Xprt. */
 	uint32_t dispatch_max_reqs_xprt;
+	/** Request queueing discipline, REQ_Q_MODE_LIFO for the
+	    shared producer/consumer queues or REQ_Q_MODE_SHARDED for
+	    per-worker rings with work stealing.  Defaults to LIFO and
+	    settable by Dispatch_Queue_Mode. */
+	uint32_t dispatch_queue_mode;
+	/** Number of slots per queue class in each worker's ring when
+	    queues are sharded, rounded up to a power of two.  Defaults
+	    to 1024 and settable by Dispatch_Shard_Size. */
+	uint32_t dispatch_shard_size;
 	/** Parameters controlling the Duplicate Request Cache.  */
 	struct {
 		/** Whether to disable the DRC entirely.  Defaults to
@@ -282,6 +328,18 @@ typedef struct nfs_core_param {
 			    DRC_UDP_Checksum. */
 			bool checksum;
 		} udp;
+		/** Bytes all DRCs together may spend on cached
+		    requests before they are retired regardless
+		    of the retire window, 0 for no limit.  Defaults
+		    to DRC_MEMORY_BUDGET and settable by
+		    DRC_Memory_Budget. */
+		uint64_t memory_budget;
+		/** Seconds of requests, at the current rate, a DRC
+		    partition keeps before retiring them.  Raises
+		    the high water marks above up to the size
+		    limits.  Defaults to DRC_RETIRE_WINDOW_S and
+		    settable by DRC_Retire_Window_S. */
+		uint32_t retire_window_s;
 	} drc;
 	/** Parameters affecting the relation with TIRPC.   */
 	struct {
@@ -341,6 +399,13 @@ typedef struct nfs_core_param {
 	/** Path to the directory containing server specific
 	    modules.  In particular, this is where FSALs live. */
 	char *ganesha_modules_loc;
+	/** Directory for the per-thread binary request trace files.
+	    Tracing is off unless set.  Settable with
+	    Trace_Directory. */
+	char *trace_dir;
+	/** Records in each trace file.  Defaults to
+	    TRACE_RECORDS_DEFAULT and settable with Trace_Records. */
+	uint32_t trace_records;
 } nfs_core_parameter_t;
 
 /** @} */
@@ -366,6 +431,25 @@ typedef struct nfs_core_param {
  */
 #define DOMAINNAME_DEFAULT "localdomain"
 
+/**
+ * @brief Default lifetime, in seconds, of an idmapper cache entry
+ */
+#define IDMAP_CACHE_TTL_DEFAULT 900
+
+/**
+ * @brief Default lifetime, in seconds, of a name or id the directory
+ *        did not know
+ */
+#define IDMAP_NEGATIVE_TTL_DEFAULT 60
+
+/**
+ * @brief Where client ids are kept for recovery after a restart
+ */
+enum recovery_backend {
+	RECOVERY_BACKEND_FS,	/*< A directory per client */
+	RECOVERY_BACKEND_DB	/*< One append-only database file */
+};
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -398,6 +482,30 @@ typedef struct nfs_version4_parameter {
 	/** Whether to allow delegations. Defaults to false and settable
 	    with Delegations */
 	bool allow_delegations;
+	/** Seconds before a cached owner or group mapping is looked
+	    up again in the background, 0 for never.  Defaults to
+	    IDMAP_CACHE_TTL_DEFAULT and settable with
+	    Idmap_Cache_TTL. */
+	uint32_t idmap_cache_ttl;
+	/** Seconds before a name or id the directory did not know
+	    is looked up again, 0 for never.  Defaults to
+	    IDMAP_NEGATIVE_TTL_DEFAULT and settable with
+	    Idmap_Negative_TTL. */
+	uint32_t idmap_negative_ttl;
+	/** Whether to load every user and group the directory
+	    enumerates into the idmapper cache at startup.  Defaults
+	    to false and settable with Idmap_Preload. */
+	bool idmap_preload;
+	/** How clients that may reclaim after a restart are
+	    recorded, RECOVERY_BACKEND_FS or RECOVERY_BACKEND_DB.
+	    Defaults to RECOVERY_BACKEND_FS and settable with
+	    Recovery_Backend. */
+	uint32_t recovery_backend;
+	/** Whether to end the grace period as soon as every NFSv4
+	    client and NLM host known from before the restart is done
+	    reclaiming.  Defaults to false and settable with
+	    Early_Grace_Exit. */
+	bool early_grace_exit;
 } nfs_version4_parameter_t;
 
 /** @} */
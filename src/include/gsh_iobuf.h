@@ -0,0 +1,123 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file   gsh_iobuf.h
+ * @brief  Reference-counted I/O payload buffers
+ *
+ * A gsh_iobuf describes a payload whose memory belongs to whoever
+ * produced it: the FSAL, a buffer pool, or plain heap.  The producer
+ * supplies a release function, and the consumer (typically a protocol
+ * reply) drops its reference once it is done with the bytes, so the
+ * payload travels from the FSAL to the reply encoder without an
+ * intermediate buffer.
+ *
+ * This is not zero-copy I/O.  The FSAL still copies the data into
+ * the payload (pread for VFS), and the XDR encoder in libntirpc copies
+ * the payload into the transport's send buffer.  No FSAL in this tree
+ * splices file pages to the socket.
+ */
+
+#ifndef GSH_IOBUF_H
+#define GSH_IOBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+
+struct gsh_iobuf {
+	void *addr;		/*< Start of the payload */
+	size_t len;		/*< Bytes of valid payload at addr */
+	size_t size;		/*< Bytes available at addr */
+	int32_t refcnt;		/*< References, released at zero */
+	void (*release)(struct gsh_iobuf *iob);	/*< Producer's free */
+	void *priv;		/*< Producer's private data */
+};
+
+/**
+ * @brief Take an additional reference on a payload
+ *
+ * @param[in] iob  The payload
+ */
+
+static inline void
+gsh_iobuf_get(struct gsh_iobuf *iob)
+{
+	(void)atomic_inc_int32_t(&iob->refcnt);
+}
+
+/**
+ * @brief Drop a reference on a payload
+ *
+ * The producer's release function runs when the last reference is
+ * dropped.
+ *
+ * @param[in] iob  The payload
+ */
+
+static inline void
+gsh_iobuf_put(struct gsh_iobuf *iob)
+{
+	if (atomic_dec_int32_t(&iob->refcnt) == 0)
+		iob->release(iob);
+}
+
+static inline void
+gsh_iobuf_heap_release(struct gsh_iobuf *iob)
+{
+	gsh_free(iob->addr);
+	gsh_free(iob);
+}
+
+/**
+ * @brief Allocate a heap-backed payload
+ *
+ * The payload is page aligned, so it is also suitable for direct I/O.
+ *
+ * @param[in] size  Bytes of payload to allocate
+ *
+ * @return A payload holding one reference, or NULL.
+ */
+
+static inline struct gsh_iobuf *
+gsh_iobuf_alloc(size_t size)
+{
+	struct gsh_iobuf *iob = gsh_malloc(sizeof(struct gsh_iobuf));
+
+	if (iob == NULL)
+		return NULL;
+
+	iob->addr = gsh_malloc_aligned(4096, size);
+	if (iob->addr == NULL) {
+		gsh_free(iob);
+		return NULL;
+	}
+	iob->len = 0;
+	iob->size = size;
+	iob->refcnt = 1;
+	iob->release = gsh_iobuf_heap_release;
+	iob->priv = NULL;
+
+	return iob;
+}
+
+#endif				/* GSH_IOBUF_H */
@@ -77,6 +77,9 @@ typedef int (*val_display_function_t)(struct gsh_buffdesc *, char *);
 #define HT_FLAG_NONE 0x0000	/*< Null hash table flags */
 #define HT_FLAG_CACHE 0x0001	/*< Indicates that caching should be
 				   enabled */
+#define HT_FLAG_OPEN_ADDR 0x0002	/*< Use open-addressed buckets with
+					   lock-free readers instead of
+					   red-black trees */
 
 /**
  * @brief Hash parameters
@@ -137,6 +140,49 @@ typedef struct hash_stat {
 				       the rbt used. */
 } hash_stat_t;
 
+/**
+ * @brief Slots per open-addressed bucket
+ *
+ * Sixteen byte slots, so a bucket fills one 64 byte cache line.
+ */
+
+#define HASH_OA_SLOTS 4
+
+/**
+ * @brief Marker for a deleted open-addressed slot
+ *
+ * An empty slot (NULL) ends a probe sequence, a tombstone does not.
+ */
+
+#define HASH_OA_TOMBSTONE ((struct hash_data *)1)
+
+/**
+ * @brief One open-addressed slot
+ */
+
+struct hash_oa_slot {
+	uint64_t hash; /*< Hash of the stored key, a lookup filter */
+	struct hash_data *data; /*< NULL, HASH_OA_TOMBSTONE, or the entry */
+};
+
+/**
+ * @brief A cache line of slots
+ */
+
+struct hash_oa_bucket {
+	struct hash_oa_slot slot[HASH_OA_SLOTS];
+} __attribute__ ((aligned(64)));
+
+/**
+ * @brief An array of open-addressed buckets
+ */
+
+struct hash_oa_array {
+	uint32_t mask; /*< Number of buckets - 1 */
+	uint32_t used; /*< Slots that are live or tombstones */
+	struct hash_oa_bucket *buckets; /*< The buckets */
+};
+
 /**
  * @brief Represents an individual partition
  *
@@ -149,6 +195,20 @@ struct hash_partition {
 	struct rbt_head rbt; /*< The red-black tree */
 	pthread_rwlock_t lock; /*< Lock for this partition */
 	struct rbt_node **cache; /*< Expected entry cache */
+	/* The following are only used with HT_FLAG_OPEN_ADDR.  Readers
+	   never take the lock; writers take it exclusively and wait
+	   for the readers of the current epoch to leave before freeing
+	   anything a reader could still see. */
+	struct hash_oa_array *oa; /*< Current bucket array */
+	struct hash_oa_array *oa_old; /*< Array being drained by an
+					  incremental resize */
+	uint32_t oa_migrated; /*< Buckets of oa_old drained so far */
+	uint32_t oa_epoch; /*< Reader epoch */
+	uint32_t oa_readers[2]; /*< Readers in each epoch phase */
+	uint32_t oa_waiting; /*< A writer sleeps on oa_cond */
+	pthread_mutex_t oa_mtx; /*< Protects the wait on oa_cond */
+	pthread_cond_t oa_cond; /*< Signalled by the last reader of a
+				    phase while a writer waits */
 };
 
 /**
@@ -178,6 +238,9 @@ struct hash_latch {
 	uint32_t index;	/*< Saved partition index */
 	uint64_t rbt_hash; /*< Saved red-black hash */
 	struct rbt_node *locator; /*< Saved location in the tree */
+	struct hash_oa_slot *slot; /*< Saved slot (open addressing) */
+	int32_t oa_phase; /*< Reader phase held by a read latch on an
+			      open-addressed table, -1 if none */
 };
 
 typedef enum hash_set_how {
@@ -229,6 +292,10 @@ hash_error_t hashtable_delall(struct hash_table *,
 				      struct gsh_buffdesc));
 
 void hashtable_log(log_components_t, struct hash_table *);
+void hashtable_for_each(struct hash_table *,
+			void (*)(struct gsh_buffdesc *,
+				 struct gsh_buffdesc *, void *),
+			void *);
 
 /* These are very simple wrappers around the primitives */
 
@@ -54,19 +54,42 @@
  * @{
  */
 
-extern pthread_rwlock_t idmapper_user_lock;
-extern pthread_rwlock_t idmapper_group_lock;
+/**
+ * @brief The maps kept by the cache
+ */
+
+enum idmap_kind {
+	IDMAP_UNAME,		/*< User name to UID */
+	IDMAP_UID,		/*< UID to user name */
+	IDMAP_GNAME,		/*< Group name to GID */
+	IDMAP_GID,		/*< GID to group name */
+	IDMAP_KINDS
+};
+
+/**
+ * @brief Result of a cache lookup
+ */
+
+enum idmap_hit {
+	IDMAP_MISS,		/*< Not cached, ask the directory */
+	IDMAP_HIT,		/*< Cached mapping */
+	IDMAP_NEGATIVE		/*< Cached as unknown to the directory */
+};
 
 void idmapper_cache_init(void);
 bool idmapper_add_user(const struct gsh_buffdesc *, uid_t, const gid_t *,
 		       bool);
 bool idmapper_add_group(const struct gsh_buffdesc *, gid_t);
-bool idmapper_lookup_by_uname(const struct gsh_buffdesc *, uid_t *,
-			      const gid_t **, bool);
-bool idmapper_lookup_by_uid(const uid_t, const struct gsh_buffdesc **,
-			    const gid_t **);
-bool idmapper_lookup_by_gname(const struct gsh_buffdesc *, uid_t *);
-bool idmapper_lookup_by_gid(const gid_t, const struct gsh_buffdesc **);
+bool idmapper_add_negative_id(bool, uint32_t, const struct gsh_buffdesc *);
+bool idmapper_add_negative_name(bool, const struct gsh_buffdesc *);
+void idmapper_remove_name(bool, const struct gsh_buffdesc *);
+enum idmap_hit idmapper_lookup_name(bool, const struct gsh_buffdesc *,
+				    uint32_t *, gid_t *, bool *);
+enum idmap_hit idmapper_lookup_id(bool, uint32_t, struct gsh_buffdesc *);
+bool idmapper_refresh(enum idmap_kind, const struct gsh_buffdesc *,
+		      uint32_t);
+void idmapper_refresh_failed(enum idmap_kind, const struct gsh_buffdesc *,
+			     uint32_t);
 /** @} */
 
 bool idmapper_init(void);
@@ -0,0 +1,90 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file   interval_tree.h
+ * @brief  Augmented AVL tree of closed 64-bit intervals
+ *
+ * Nodes are embedded in the caller's structure, ordered on their
+ * start and carry the largest end in their subtree, so every node
+ * overlapping a range can be found in O(log n + k).  Overlapping and
+ * duplicate intervals are allowed.  The caller serializes access.
+ */
+
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct itree_node {
+	struct itree_node *left, *right, *parent;
+	uint64_t start;		/*< First offset covered */
+	uint64_t end;		/*< Last offset covered, inclusive */
+	uint64_t max_end;	/*< Largest end in this subtree */
+	int height;		/*< 0 when not in a tree */
+};
+
+struct itree {
+	struct itree_node *root;
+	uint64_t size;
+};
+
+#define itree_container_of(node, type, member)				\
+	((type *)((char *)(node) - offsetof(type, member)))
+
+static inline void itree_init(struct itree *tree)
+{
+	tree->root = NULL;
+	tree->size = 0;
+}
+
+/**
+ * @brief Test whether a node is in a tree
+ *
+ * Nodes must start zeroed for this to work.
+ */
+
+static inline bool itree_node_linked(const struct itree_node *node)
+{
+	return node->height != 0;
+}
+
+void itree_insert(struct itree *tree, struct itree_node *node);
+void itree_remove(struct itree *tree, struct itree_node *node);
+struct itree_node *itree_first_overlap(const struct itree *tree,
+				       uint64_t start, uint64_t end);
+struct itree_node *itree_next_overlap(const struct itree_node *node,
+				      uint64_t start, uint64_t end);
+
+/**
+ * @brief Iterate over the nodes overlapping [start, end] in start order
+ *
+ * The current node may not be removed or re-keyed inside the loop.
+ */
+
+#define itree_for_each_overlap(node, tree, start, end)			\
+	for ((node) = itree_first_overlap((tree), (start), (end));	\
+	     (node) != NULL;						\
+	     (node) = itree_next_overlap((node), (start), (end)))
+
+#endif				/* INTERVAL_TREE_H */
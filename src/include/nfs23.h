@@ -446,6 +446,7 @@ struct READ3resok {
 		u_int data_len;
 		char *data_val;
 	} data;
+	struct gsh_iobuf *data_iob;	/* not encoded, owns data_val */
 };
 typedef struct READ3resok READ3resok;
 
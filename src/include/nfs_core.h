@@ -73,6 +73,7 @@ typedef struct nfs_request_data {
 	nfs_arg_t arg_nfs;
 	nfs_res_t *res_nfs;
 	const nfs_function_desc_t *funcdesc;
+	struct nfs_async_req *async;	/*< Saved context while suspended */
 } nfs_request_data_t;
 
 enum rpc_chan_type {
@@ -151,6 +152,7 @@ typedef struct request_data {
 	struct timespec time_queued;	/*< The time at which a request was
 					 *  added to the worker thread queue.
 					 */
+	uint64_t trace_id;	/*< Request trace id, 0 if not traced */
 } request_data_t;
 
 /**
@@ -215,6 +217,7 @@ struct nfs_worker_data {
 
 	sockaddr_t hostaddr;	/*< Client address */
 	struct fridgethr_context *ctx;	/*< Link back to thread context */
+	struct nfs_async_req *async;	/*< Suspension being set up */
 };
 
 /* ServerEpoch is ServerBootTime unless overriden by -E command line option */
@@ -235,6 +238,18 @@ extern ushort g_nodeid;
 request_data_t *nfs_rpc_get_nfsreq(uint32_t flags);
 void nfs_rpc_enqueue_req(request_data_t *req);
 
+/*
+ * Suspending a request on asynchronous I/O, nfs_worker_thread.c
+ */
+typedef int (*nfs_async_resume_t)(void *arg, nfs_res_t *res);
+
+struct nfs_async_req *nfs_rpc_async_start(nfs_worker_data_t *worker,
+					  nfs_async_resume_t resume,
+					  void *arg);
+void nfs_rpc_async_cancel(nfs_worker_data_t *worker);
+int nfs_rpc_async_wait(nfs_worker_data_t *worker, nfs_res_t *res);
+void nfs_rpc_async_done(struct nfs_async_req *async);
+
 /*
  * Thread entry functions
  */
@@ -302,7 +317,28 @@ int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags);
 int reaper_init(void);
 int reaper_shutdown(void);
 
+/**
+ * @brief Worker pool size and the load it was last sized by
+ */
+
+struct worker_pool_stats {
+	uint32_t min;		/*< Fewest workers */
+	uint32_t max;		/*< Most workers */
+	uint32_t threads;	/*< Workers now */
+	uint32_t idle;		/*< Workers waiting for a request */
+	uint32_t fsal_busy;	/*< Threads inside an FSAL call */
+	uint32_t backlog;	/*< Requests queued */
+	uint32_t qwait_us;	/*< Average queue wait, last sample */
+	uint64_t grown;		/*< Workers added since start */
+	uint64_t shrunk;	/*< Workers retired since start */
+	uint64_t steals;	/*< Requests taken from a peer's shard */
+	uint64_t overflows;	/*< Requests that found their shards full */
+};
+
 int worker_init(void);
 int worker_shutdown(void);
+void worker_note_qwait(nsecs_elapsed_t qwait);
+void worker_pool_stats(struct worker_pool_stats *stats);
+uint32_t nfs_rpc_outstanding_reqs(void);
 
 #endif				/* !NFS_CORE_H */
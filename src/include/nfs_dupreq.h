@@ -56,19 +56,36 @@ enum drc_type {
 #define DRC_FLAG_RECYCLE 0x0020
 #define DRC_FLAG_RELEASE 0x0040
 
+/**
+ * @brief Retire state of one partition of a DRC
+ *
+ * Each partition keeps its own FIFO, size and retire window under the
+ * partition lock of the DRC's rbtree_x, so starting and finishing a
+ * request never takes a DRC-wide lock.
+ */
+
+struct drc_part {
+	TAILQ_HEAD(drc_tailq, dupreq_entry) dupreq_q;
+	uint32_t size;
+	uint32_t retwnd;
+	uint32_t rate;		/* requests per second, smoothed */
+	uint32_t count;		/* requests in the current second */
+	time_t tick;		/* the current second */
+};
+
 typedef struct drc {
 	enum drc_type type;
 	struct rbtree_x xt;
-	TAILQ_HEAD(drc_tailq, dupreq_entry) dupreq_q;
+	struct drc_part *part;	/* one per partition of xt */
 	pthread_mutex_t mtx;
 	uint32_t npart;
 	uint32_t cachesz;
-	uint32_t size;
 	uint32_t maxsize;
 	uint32_t hiwat;
+	uint32_t part_maxsize;	/* maxsize per partition */
+	uint32_t part_hiwat;	/* hiwat per partition */
 	uint32_t flags;
 	uint32_t refcnt; /* call path refs */
-	uint32_t retwnd;
 	union {
 		struct {
 			sockaddr_t addr;
@@ -133,6 +150,20 @@ typedef enum dupreq_status {
 	DUPREQ_ERROR,
 } dupreq_status_t;
 
+/**
+ * @brief DRC counters, summed over all DRCs
+ */
+
+struct drc_stats {
+	uint64_t hits;		/*< Replies served from a DRC */
+	uint64_t in_progress;	/*< Retransmits of running requests */
+	uint64_t misses;	/*< Requests entered in a DRC */
+	uint64_t evictions;	/*< Entries retired to make room */
+	uint64_t entries;	/*< Entries cached now */
+	uint64_t tcp_drcs;	/*< Per-connection DRCs allocated */
+	uint64_t tcp_recycled;	/*< Of those, held for a reconnect */
+};
+
 void dupreq2_pkginit(void);
 void dupreq2_pkgshutdown(void);
 
@@ -144,5 +175,6 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *,
 dupreq_status_t nfs_dupreq_finish(struct svc_req *, nfs_res_t *);
 dupreq_status_t nfs_dupreq_delete(struct svc_req *);
 void nfs_dupreq_rele(struct svc_req *, const nfs_function_desc_t *);
+void nfs_dupreq_stats(struct drc_stats *);
 
 #endif /* NFS_DUPREQ_H */
@@ -108,6 +108,7 @@ typedef struct exportlist_client_entry__ {
 		} gssprinc;
 	} client;
 	struct export_perms client_perms;	/*< Available mount options */
+	uint32_t order;		/*< Position in the export's client list */
 } exportlist_client_entry_t;
 
 /* Constants for export options masks */
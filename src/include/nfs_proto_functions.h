@@ -547,6 +547,7 @@ void nfs4_op_io_advise_Free(nfs_resop4 *resp);
 
 #define NFS_REQ_OK   0
 #define NFS_REQ_DROP 1
+#define NFS_REQ_ASYNC_WAIT 2	/* suspended, see nfs_rpc_async_start */
 
 /* Free functions */
 void mnt1_Mnt_Free(nfs_res_t *);
@@ -37,6 +37,8 @@
 
 #include "ganesha_list.h"
 #include "wait_queue.h"
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
 
 /* XXX moving to gsh_intrinsic.h */
 #ifndef CACHE_LINE_SIZE
@@ -73,6 +75,50 @@ struct req_q_set {
 	struct req_q_pair qset[N_REQ_QUEUES];
 };
 
+/**
+ * @brief Queueing disciplines, selected by Dispatch_Queue_Mode
+ */
+
+#define REQ_Q_MODE_LIFO 0	/*< shared producer/consumer queue pairs */
+#define REQ_Q_MODE_SHARDED 1	/*< per-worker rings with work stealing */
+
+/**
+ * @brief Bounded multi-producer, multi-consumer request ring
+ *
+ * Each slot carries a sequence number, so producers and consumers
+ * only contend on the head or tail counter with a single CAS, never
+ * on a lock.  A slot is free for the producer at position pos when
+ * its sequence equals pos, and holds a request for the consumer at
+ * position pos when its sequence equals pos + 1.
+ */
+
+struct req_ring_slot {
+	uint64_t seq;
+	void *req;		/* request_data_t */
+};
+
+struct req_ring {
+	 CACHE_PAD(0);
+	uint64_t head;		/* next enqueue position */
+	 CACHE_PAD(1);
+	uint64_t tail;		/* next dequeue position */
+	 CACHE_PAD(2);
+	uint64_t mask;
+	struct req_ring_slot *slots;
+};
+
+/**
+ * @brief A worker's private set of rings, one per queue class
+ *
+ * Decoders choose a shard by transport, so requests from one
+ * connection stay on one worker; idle workers steal from peers.
+ */
+
+struct req_shard {
+	struct req_ring ring[N_REQ_QUEUES];
+	uint64_t steals;	/* requests taken from this shard by peers */
+};
+
 struct nfs_req_st {
 	struct {
 		uint32_t ctr;
@@ -83,6 +129,13 @@ struct nfs_req_st {
 		uint32_t waiters;
 	} reqs;
 	 CACHE_PAD(1);
+	struct {
+		uint32_t mode;	/* REQ_Q_MODE_* */
+		uint32_t nshards;
+		struct req_shard *shards;
+		uint64_t overflows;	/* ring full, fell back to LIFO */
+	} shard;
+	 CACHE_PAD(2);
 	struct {
 		pthread_mutex_t mtx;
 		struct glist_head q;
@@ -103,6 +156,96 @@ static inline void nfs_rpc_q_init(struct req_q *q)
 	q->waiters = 0;
 }
 
+static inline bool nfs_rpc_ring_init(struct req_ring *r, uint32_t size)
+{
+	uint64_t ix;
+
+	r->head = 0;
+	r->tail = 0;
+	r->mask = size - 1;
+	r->slots = gsh_calloc(size, sizeof(struct req_ring_slot));
+	if (!r->slots)
+		return false;
+	for (ix = 0; ix < size; ++ix)
+		r->slots[ix].seq = ix;
+	return true;
+}
+
+/**
+ * @brief Append a request to a ring
+ *
+ * @param[in] r   The ring
+ * @param[in] req The request
+ *
+ * @retval true if queued.
+ * @retval false if the ring is full.
+ */
+
+static inline bool nfs_rpc_ring_push(struct req_ring *r, void *req)
+{
+	struct req_ring_slot *slot;
+	uint64_t pos = atomic_fetch_uint64_t(&r->head);
+	int64_t dif;
+
+	for (;;) {
+		slot = &r->slots[pos & r->mask];
+		dif = (int64_t) atomic_fetch_uint64_t(&slot->seq) -
+		    (int64_t) pos;
+		if (dif == 0) {
+			if (atomic_cas_uint64_t(&r->head, pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			return false;	/* full */
+		}
+		pos = atomic_fetch_uint64_t(&r->head);
+	}
+
+	slot->req = req;
+	atomic_store_uint64_t(&slot->seq, pos + 1);
+	return true;
+}
+
+/**
+ * @brief Take the oldest request from a ring
+ *
+ * @param[in] r The ring
+ *
+ * @return The request, or NULL if the ring is empty.
+ */
+
+static inline void *nfs_rpc_ring_pop(struct req_ring *r)
+{
+	struct req_ring_slot *slot;
+	uint64_t pos = atomic_fetch_uint64_t(&r->tail);
+	int64_t dif;
+	void *req;
+
+	for (;;) {
+		slot = &r->slots[pos & r->mask];
+		dif = (int64_t) atomic_fetch_uint64_t(&slot->seq) -
+		    (int64_t) (pos + 1);
+		if (dif == 0) {
+			if (atomic_cas_uint64_t(&r->tail, pos, pos + 1))
+				break;
+		} else if (dif < 0) {
+			return NULL;	/* empty */
+		}
+		pos = atomic_fetch_uint64_t(&r->tail);
+	}
+
+	req = slot->req;
+	atomic_store_uint64_t(&slot->seq, pos + r->mask + 1);
+	return req;
+}
+
+static inline uint32_t nfs_rpc_ring_size(struct req_ring *r)
+{
+	uint64_t head = atomic_fetch_uint64_t(&r->head);
+	uint64_t tail = atomic_fetch_uint64_t(&r->tail);
+
+	return (head > tail) ? (uint32_t) (head - tail) : 0;
+}
+
 static inline uint32_t nfs_rpc_q_next_slot(void)
 {
 	uint32_t ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
@@ -0,0 +1,155 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file   nfs_trace.h
+ * @brief  Binary per-request event tracer
+ *
+ * When Trace_Directory is set, every thread that handles requests
+ * maps a ring file of fixed size records in that directory and
+ * appends one record per event: decode, enqueue, dequeue, FSAL entry
+ * and exit, encode and send.  Records of one request share an id, so
+ * tools/ganesha_trace_decode can put the request back together and
+ * show where its time went.
+ *
+ * The file layout below is shared with the decoder, so this header
+ * must not include any other Ganesha header.
+ */
+
+#ifndef NFS_TRACE_H
+#define NFS_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NFS_TRACE_MAGIC 0x47545243	/* "GTRC" */
+#define NFS_TRACE_VERSION 1
+
+/**
+ * @brief Events recorded for a request
+ */
+
+enum nfs_trace_event {
+	NFS_TRACE_DECODE = 1,	/*< Arguments decoded */
+	NFS_TRACE_ENQUEUE,	/*< Put on a worker queue */
+	NFS_TRACE_DEQUEUE,	/*< Taken by a worker */
+	NFS_TRACE_FSAL_ENTER,	/*< FSAL call made, op says which */
+	NFS_TRACE_FSAL_EXIT,	/*< FSAL call returned */
+	NFS_TRACE_ENCODE,	/*< Reply about to be encoded and sent */
+	NFS_TRACE_SEND,		/*< Reply sent, or dropped */
+	NFS_TRACE_EVENT_COUNT
+};
+
+/**
+ * @brief FSAL calls traced by the cache_inode layer
+ */
+
+enum nfs_trace_fsal_op {
+	NFS_TRACE_FSAL_GETATTRS = 1,
+	NFS_TRACE_FSAL_SETATTRS,
+	NFS_TRACE_FSAL_LOOKUP,
+	NFS_TRACE_FSAL_READDIR,
+	NFS_TRACE_FSAL_OPEN,
+	NFS_TRACE_FSAL_READ,
+	NFS_TRACE_FSAL_WRITE,
+	NFS_TRACE_FSAL_COMMIT,
+	NFS_TRACE_FSAL_CREATE,
+	NFS_TRACE_FSAL_UNLINK,
+	NFS_TRACE_FSAL_RENAME,
+	NFS_TRACE_FSAL_OP_COUNT
+};
+
+/**
+ * @brief Header at the start of every ring file
+ */
+
+struct nfs_trace_hdr {
+	uint32_t magic;		/*< NFS_TRACE_MAGIC */
+	uint16_t version;	/*< NFS_TRACE_VERSION */
+	uint16_t rec_size;	/*< sizeof(struct nfs_trace_rec) */
+	uint32_t nrecs;		/*< Records in the ring */
+	uint32_t pid;		/*< Server process */
+	uint64_t head;		/*< Records ever written */
+	int64_t boot_sec;	/*< Server boot time, timestamps are */
+	int64_t boot_nsec;	/*< nanoseconds from here */
+	char thread[16];	/*< Name of the writing thread */
+	uint8_t pad[8];
+};
+
+/**
+ * @brief One event
+ *
+ * Slot head % nrecs is written next.  The newest record may be torn
+ * if the file is read while the server runs.
+ */
+
+struct nfs_trace_rec {
+	uint64_t id;		/*< Request id, shared by its events */
+	uint64_t ts;		/*< Nanoseconds since server boot */
+	uint32_t xid;		/*< RPC xid, on DECODE */
+	uint16_t event;		/*< enum nfs_trace_event */
+	uint16_t op;		/*< RPC proc or enum nfs_trace_fsal_op */
+	uint32_t prog;		/*< RPC program, on DECODE */
+	uint16_t vers;		/*< RPC version, on DECODE */
+	uint16_t export_id;	/*< Export, on ENCODE */
+	uint16_t family;	/*< Client address family, on DECODE */
+	uint16_t port;		/*< Client port, on DECODE */
+	uint8_t addr[16];	/*< Client address, on DECODE */
+	int32_t status;		/*< Service function result, on SEND */
+	uint8_t pad[8];
+};
+
+#ifndef NFS_TRACE_FORMAT_ONLY
+
+extern bool nfs_trace_enabled;
+
+struct request_data;
+
+bool nfs_trace_init(void);
+uint64_t nfs_trace_new_id(void);
+struct nfs_trace_rec *nfs_trace_emit(uint64_t id, enum nfs_trace_event event,
+				     uint16_t op);
+void nfs_trace_decode(struct request_data *req);
+void nfs_trace_encode(struct request_data *req);
+
+/**
+ * @brief Record an event of a request, if tracing it
+ */
+
+#define NFS_TRACE(id, event, op)					\
+	do {								\
+		if (unlikely(nfs_trace_enabled) && (id) != 0)		\
+			(void)nfs_trace_emit((id), (event), (op));	\
+	} while (0)
+
+/**
+ * @brief Record entry to or exit from an FSAL call of this request
+ */
+
+#define NFS_TRACE_FSAL(event, op)					\
+	do {								\
+		if (unlikely(nfs_trace_enabled) && op_ctx != NULL)	\
+			NFS_TRACE(op_ctx->trace_id, (event), (op));	\
+	} while (0)
+
+#endif				/* NFS_TRACE_FORMAT_ONLY */
+
+#endif				/* NFS_TRACE_H */
@@ -1634,6 +1634,7 @@ extern "C" {
 			u_int data_len;
 			char *data_val;
 		} data;
+		struct gsh_iobuf *data_iob; /* not encoded, owns data_val */
 	};
 	typedef struct READ4resok READ4resok;
 
@@ -55,4 +55,8 @@ uid_t setuser(uid_t uid);
 gid_t setgroup(gid_t gid);
 int set_threadgroups(size_t size, const gid_t *list);
 
+uint32_t gsh_numa_node_count(void);
+uint32_t gsh_numa_node_self(void);
+int gsh_numa_bind_self(uint32_t node);
+
 #endif/* SUBR_OS_H */
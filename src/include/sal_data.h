@@ -191,6 +191,11 @@ struct state_refer {
  *
  *****************************************************************************/
 
+/**
+ * @brief Hash chains of clients that may reclaim, a power of two
+ */
+#define CLID_HASH_SIZE 8192
+
 /**
  * @brief Grace period control structure
  *
@@ -203,6 +208,11 @@ typedef struct grace {
 	time_t g_start;		/*< Start of grace period */
 	time_t g_duration;	/*< Duration of grace period */
 	struct glist_head g_clid_list;	/*< Clients */
+	/** Clients by hash of their name */
+	struct glist_head g_clid_hash[CLID_HASH_SIZE];
+	uint32_t g_reclaim_pending;	/*< Clients not done reclaiming */
+	bool g_reclaim_loaded;	/*< The clients that may reclaim in this
+				    grace period are on the list */
 } grace_t;
 
 /**
@@ -210,7 +220,12 @@ typedef struct grace {
  */
 typedef struct clid_entry {
 	struct glist_head cl_list;	/*< Link in the list */
-	char cl_name[PATH_MAX];	/*< Client name */
+	struct glist_head cl_hash;	/*< Link in the hash chain */
+	uint64_t cl_hashval;	/*< Hash of cl_name */
+	bool cl_nlm;		/*< An NLM host, not an NFSv4 client */
+	bool cl_seen;		/*< The NLM host came back */
+	bool cl_reclaimed;	/*< Done reclaiming */
+	char cl_name[];		/*< Client name */
 } clid_entry_t;
 
 extern char v4_old_dir[PATH_MAX+1];
@@ -826,6 +841,13 @@ typedef enum lock_type_t {
 
 struct state_lock_entry_t {
 	struct glist_head sle_list;	/*< Locks on this file */
+	struct itree_node sle_range;	/*< Range index link, only while on
+					   the file lock list */
+	struct glist_head sle_blocked_link; /*< Link on the file's blocked
+					       lock queue */
+	struct glist_head sle_scan;	/*< Scratch link for range walks
+					   and removals under the
+					   state_lock */
 	struct glist_head sle_owner_locks; /*< Link on the owner lock list */
 	struct glist_head sle_locks;	/*< Locks on this state/client */
 #ifdef DEBUG_SAL
@@ -687,6 +687,24 @@ void nfs4_chk_clid(nfs_client_id_t *);
 void nfs4_load_recov_clids(nfs_grace_start_t *gsp);
 void nfs4_clean_old_recov_dir(char *);
 void nfs4_create_recov_dir(void);
+void nfs4_reclaim_complete(nfs_client_id_t *clientid);
+void nlm_reclaim_complete(const char *caller_name);
+void nfs4_recov_nsm_monitor(const char *caller_name);
+void nfs4_recov_nsm_unmonitor(const char *caller_name);
+uint32_t nfs4_foreach_reclaimer(void (*cb)(const char *name, bool nlm,
+					   void *arg),
+				void *arg);
+
+struct recov_db;
+
+struct recov_db *recov_db_open(const char *path, bool readonly);
+void recov_db_close(struct recov_db *db);
+int recov_db_add(struct recov_db *db, const char *name);
+int recov_db_del(struct recov_db *db, const char *name);
+int recov_db_clear(struct recov_db *db);
+int recov_db_merge(struct recov_db *dst, struct recov_db *src);
+void recov_db_foreach(struct recov_db *db,
+		      void (*cb)(const char *name, void *arg), void *arg);
 
 #endif				/* SAL_FUNCTIONS_H */
 
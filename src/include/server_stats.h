@@ -41,6 +41,7 @@
 
 #include <sys/types.h>
 
+void server_stats_pkginit(void);
 void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup);
 
 void server_stats_io_done(size_t requested,
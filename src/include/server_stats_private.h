@@ -43,7 +43,11 @@
 /**
  * @brief Server request statistics
  *
- * These are the stats we keep
+ * These are the stats we keep.  Each protocol pointer is an array
+ * with one copy per stats slot, allocated on first use and folded
+ * together by the server_dbus_* reporting functions.  The latency
+ * histograms are too large to copy per slot and are kept once per
+ * protocol in hist[].
  */
 
 /* Forward references to build pointers to private defs.
@@ -57,6 +61,21 @@ struct nfsv40_stats;
 struct nfsv41_stats;
 struct nfsv42_stats;
 struct _9p_stats;
+struct proto_hists;
+
+/* Protocols with latency histograms, in reporting order */
+
+enum stats_hist_proto {
+	HIST_NFSV3,
+	HIST_NFSV40,
+	HIST_NFSV41,
+	HIST_NFSV42,
+	HIST_MNT,
+	HIST_NLM4,
+	HIST_RQUOTA,
+	HIST_9P,
+	HIST_PROTOS
+};
 
 struct gsh_stats {
 	struct nfsv3_stats *nfsv3;
@@ -67,6 +86,7 @@ struct gsh_stats {
 	struct nfsv41_stats *nfsv41;
 	struct nfsv41_stats *nfsv42;
 	struct _9p_stats *_9p;
+	struct proto_hists *hist[HIST_PROTOS];
 };
 
 /**
@@ -170,6 +190,74 @@ struct export_stats {
 	.direction = "out"   \
 }
 
+#define CACHE_NODES_REPLY	\
+{				\
+	.name = "nodes",	\
+	.type = "a(utttttt)",	\
+	.direction = "out"	\
+}
+
+#define BUFPOOL_REPLY		\
+{				\
+	.name = "oversize",	\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "classes",	\
+	.type = "a(ttttt)",	\
+	.direction = "out"	\
+}
+
+#define DRC_REPLY		\
+{				\
+	.name = "hits",		\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "in_progress",	\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "misses",	\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "evictions",	\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "entries",	\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "tcp_drcs",	\
+	.type = "t",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "tcp_recycled",	\
+	.type = "t",		\
+	.direction = "out"	\
+}
+
+#define LATENCY_REPLY		\
+{				\
+	.name = "bounds",	\
+	.type = "at",		\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "histograms",	\
+	.type = "a(stttat)",	\
+	.direction = "out"	\
+}
+
 #define LAYOUTS_REPLY		\
 {				\
 	.name = "getdevinfo",	\
@@ -207,8 +295,13 @@ void server_dbus_v42_layouts(struct nfsv41_stats *v42p, DBusMessageIter *iter);
 void server_dbus_total_ops(struct export_stats *export_st,
 			   DBusMessageIter *iter);
 void global_dbus_total_ops(DBusMessageIter *iter);
+void server_dbus_latency(struct gsh_stats *st, DBusMessageIter *iter);
+void global_dbus_latency(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void cache_inode_dbus_show(DBusMessageIter *iter);
+void cache_inode_dbus_show_nodes(DBusMessageIter *iter);
+void bufpool_dbus_show(DBusMessageIter *iter);
+void drc_dbus_show(DBusMessageIter *iter);
 
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 void server_dbus_9p_transstats(struct _9p_stats *_9pp, DBusMessageIter *iter);
@@ -43,12 +43,14 @@
 #include <libgen.h>
 #include <execinfo.h>
 #include <sys/resource.h>
+#include <sys/uio.h>
 
 #include "log.h"
 #include "ganesha_list.h"
 #include "rpc/rpc.h"
 #include "common_utils.h"
 #include "abstract_mem.h"
+#include "abstract_atomic.h"
 
 #ifdef USE_DBUS
 #include "ganesha_dbus.h"
@@ -1278,6 +1280,473 @@ static int log_to_stream(log_header_t headers, void *private,
 		return 0;
 }
 
+/*
+ * Asynchronous logging
+ *
+ * With Async set in the LOG block a worker still formats its message
+ * into log_buffer, but then copies it into a ring owned by its thread
+ * instead of calling the facilities.  Only the owner moves a ring's
+ * head and only the drainer moves its tail, so nothing is locked on
+ * the logging path.  The flusher thread drains every ring in batches
+ * and writes all the lines of a batch meant for a file facility with
+ * a single writev.
+ *
+ * When a ring is full the message is dropped and counted, or the
+ * worker waits for the flusher, as Async_Overflow says.  Fatal
+ * messages drain the rings and are then written synchronously.
+ */
+
+/**
+ * @brief What to do with a message that does not fit in the ring
+ */
+
+enum log_overflow {
+	LOG_OVERFLOW_DROP,	/*< Drop it and count it */
+	LOG_OVERFLOW_BLOCK	/*< Wait for the flusher */
+};
+
+/**
+ * @brief A message in a ring
+ *
+ * Records are 8 byte aligned.  A len of 0 marks the unused end of the
+ * ring; the next record starts at offset 0.
+ */
+
+struct log_record {
+	uint32_t len;		/*< Bytes taken in the ring */
+	uint16_t level;		/*< Log level of the message */
+	uint16_t text_len;	/*< Length of text */
+	uint16_t comp_off;	/*< Offset of the component part in text */
+	uint16_t msg_off;	/*< Offset of the message part in text */
+	char text[];		/*< The formatted message, not terminated */
+};
+
+#define LOG_RECORD_LEN(text_len) \
+	((sizeof(struct log_record) + (text_len) + 7) & ~(size_t)7)
+
+/**
+ * @brief Per-thread message ring
+ */
+
+struct log_ring {
+	struct glist_head rings;	/*< On log_async_rings */
+	char *data;		/*< The ring, size bytes */
+	uint64_t size;		/*< A power of two */
+	uint64_t queued;	/*< Messages queued, written by owner */
+	uint64_t dropped;	/*< Messages dropped, written by owner */
+	uint32_t orphaned;	/*< The owning thread has exited */
+	CACHE_PAD(0);
+	uint64_t head;		/*< Next byte to write, owner only */
+	CACHE_PAD(1);
+	uint64_t tail;		/*< Next byte to read, drainer only */
+	CACHE_PAD(2);
+};
+
+/* Bytes per thread ring */
+#define LOG_ASYNC_RING_MIN (64 * 1024)
+#define LOG_ASYNC_RING_MAX (16 * 1024 * 1024)
+#define LOG_ASYNC_RING_DEFAULT (256 * 1024)
+/* Records handed to the facilities at once */
+#define LOG_ASYNC_BATCH 256
+/* How long the flusher sleeps when there is nothing to write */
+#define LOG_ASYNC_IDLE_NS (10 * 1000000)
+
+static bool log_async_enabled;
+static bool log_async_running;
+static enum log_overflow log_async_overflow = LOG_OVERFLOW_DROP;
+static uint32_t log_async_ring_size = LOG_ASYNC_RING_DEFAULT;
+static pthread_t log_async_flusher;
+static pthread_key_t log_async_key;
+
+/* Protects log_async_rings and the totals of freed rings */
+static pthread_mutex_t log_async_mtx = PTHREAD_MUTEX_INITIALIZER;
+/* Held while draining, so each ring has one reader */
+static pthread_mutex_t log_async_drain_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_async_work_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t log_async_space_cv = PTHREAD_COND_INITIALIZER;
+static struct glist_head log_async_rings =
+	GLIST_HEAD_INIT(log_async_rings);
+static uint64_t log_async_freed_queued;
+static uint64_t log_async_freed_dropped;
+
+/* Scratch line for the drainer, log_to_file appends a newline */
+static char log_async_buffer[LOG_BUFF_LEN + 2];
+
+static __thread struct log_ring *log_my_ring;
+
+static void log_ring_release(void *arg)
+{
+	struct log_ring *ring = arg;
+
+	log_my_ring = NULL;
+	atomic_store_uint32_t(&ring->orphaned, 1);
+}
+
+static struct log_ring *log_ring_get(void)
+{
+	struct log_ring *ring = log_my_ring;
+
+	if (likely(ring != NULL))
+		return ring;
+
+	ring = gsh_calloc(1, sizeof(struct log_ring));
+	if (ring == NULL)
+		return NULL;
+
+	ring->size = log_async_ring_size;
+	ring->data = gsh_malloc(ring->size);
+	if (ring->data == NULL) {
+		gsh_free(ring);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&log_async_mtx);
+	glist_add_tail(&log_async_rings, &ring->rings);
+	pthread_mutex_unlock(&log_async_mtx);
+
+	(void)pthread_setspecific(log_async_key, ring);
+	log_my_ring = ring;
+	return ring;
+}
+
+/**
+ * @brief Queue a formatted message on this thread's ring
+ *
+ * @return true if the message was queued or dropped, false if the
+ *         caller must write it itself.
+ */
+
+static bool log_async_queue(log_levels_t level, struct display_buffer *dsp,
+			    char *compstr, char *message)
+{
+	struct log_ring *ring;
+	struct log_record *rec;
+	uint64_t head, tail, pos, skip, need;
+	int text_len = display_buffer_len(dsp);
+	struct timespec ts;
+
+	/* The flusher can't wait for itself */
+	if (!log_async_running
+	    || pthread_equal(pthread_self(), log_async_flusher))
+		return false;
+
+	ring = log_ring_get();
+	if (unlikely(ring == NULL))
+		return false;
+
+	need = LOG_RECORD_LEN(text_len);
+	head = ring->head;
+	pos = head & (ring->size - 1);
+	skip = (ring->size - pos < need) ? ring->size - pos : 0;
+
+	for (;;) {
+		tail = atomic_fetch_uint64_t(&ring->tail);
+		if (head + skip + need - tail <= ring->size)
+			break;
+
+		if (log_async_overflow == LOG_OVERFLOW_DROP
+		    || !log_async_running) {
+			atomic_store_uint64_t(&ring->dropped,
+					      ring->dropped + 1);
+			return true;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		timespec_add_nsecs(LOG_ASYNC_IDLE_NS, &ts);
+		pthread_mutex_lock(&log_async_mtx);
+		pthread_cond_signal(&log_async_work_cv);
+		(void)pthread_cond_timedwait(&log_async_space_cv,
+					     &log_async_mtx, &ts);
+		pthread_mutex_unlock(&log_async_mtx);
+	}
+
+	if (skip != 0) {
+		((struct log_record *)(ring->data + pos))->len = 0;
+		head += skip;
+		pos = 0;
+	}
+
+	rec = (struct log_record *)(ring->data + pos);
+	rec->len = need;
+	rec->level = level;
+	rec->text_len = text_len;
+	rec->comp_off = compstr - dsp->b_start;
+	rec->msg_off = message - dsp->b_start;
+	memcpy(rec->text, dsp->b_start, text_len);
+
+	atomic_store_uint64_t(&ring->head, head + need);
+	atomic_store_uint64_t(&ring->queued, ring->queued + 1);
+
+	/* Don't wait for the flusher's timer once half full */
+	if (head + need - tail > ring->size / 2)
+		pthread_cond_signal(&log_async_work_cv);
+
+	return true;
+}
+
+/**
+ * @brief Write a batch of lines to a file facility
+ *
+ * @note The caller must hold log_rwlock.
+ */
+
+static void log_file_batch(struct log_facility *facility,
+			   struct log_record **recs, int count)
+{
+	struct iovec iov[2 * LOG_ASYNC_BATCH];
+	char *path = facility->lf_private;
+	ssize_t len = 0, rc;
+	int i, iovcnt = 0, fd, my_status;
+
+	for (i = 0; i < count; i++) {
+		if (recs[i]->level > facility->lf_max_level)
+			continue;
+		iov[iovcnt].iov_base = recs[i]->text;
+		iov[iovcnt++].iov_len = recs[i]->text_len;
+		iov[iovcnt].iov_base = "\n";
+		iov[iovcnt++].iov_len = 1;
+		len += recs[i]->text_len + 1;
+	}
+
+	if (iovcnt == 0)
+		return;
+
+	fd = open(path, O_WRONLY | O_SYNC | O_APPEND | O_CREAT, log_mask);
+	if (fd == -1) {
+		my_status = errno;
+		goto error;
+	}
+
+	rc = writev(fd, iov, iovcnt);
+	my_status = rc < 0 ? errno : ENOSPC;
+	(void)close(fd);
+	if (rc == len)
+		return;
+
+ error:
+	fprintf(stderr,
+		"Error: couldn't complete write to the log file %s status=%d (%s), %d messages lost\n",
+		path, my_status, strerror(my_status), iovcnt / 2);
+}
+
+/**
+ * @brief Hand a batch of records to the active facilities
+ */
+
+static void log_write_batch(struct log_record **recs, int count)
+{
+	struct display_buffer dsp = {LOG_BUFF_LEN + 1, log_async_buffer,
+				     log_async_buffer};
+	struct glist_head *glist;
+	struct log_facility *facility;
+	struct log_record *rec;
+	int i;
+
+	PTHREAD_RWLOCK_rdlock(&log_rwlock);
+
+	for (i = 0; i < count; i++) {
+		rec = recs[i];
+		memcpy(log_async_buffer, rec->text, rec->text_len);
+		log_async_buffer[rec->text_len] = '\0';
+		dsp.b_current = log_async_buffer + rec->text_len;
+
+		glist_for_each(glist, &active_facility_list) {
+			facility = glist_entry(glist, struct log_facility,
+					       lf_active);
+
+			if (rec->level <= facility->lf_max_level
+			    && facility->lf_func != NULL
+			    && facility->lf_func != log_to_file)
+				facility->lf_func(facility->lf_headers,
+						  facility->lf_private,
+						  rec->level, &dsp,
+						  log_async_buffer +
+						  rec->comp_off,
+						  log_async_buffer +
+						  rec->msg_off);
+		}
+	}
+
+	glist_for_each(glist, &active_facility_list) {
+		facility = glist_entry(glist, struct log_facility, lf_active);
+
+		if (facility->lf_func == log_to_file)
+			log_file_batch(facility, recs, count);
+	}
+
+	PTHREAD_RWLOCK_unlock(&log_rwlock);
+}
+
+/**
+ * @brief Write out up to one batch from a ring
+ *
+ * @note The caller must hold log_async_drain_mtx.
+ *
+ * @return true if anything was written.
+ */
+
+static bool log_ring_drain(struct log_ring *ring)
+{
+	struct log_record *recs[LOG_ASYNC_BATCH];
+	struct log_record *rec;
+	uint64_t tail = ring->tail;
+	uint64_t head = atomic_fetch_uint64_t(&ring->head);
+	uint64_t pos;
+	int count = 0;
+
+	while (tail != head && count < LOG_ASYNC_BATCH) {
+		pos = tail & (ring->size - 1);
+		rec = (struct log_record *)(ring->data + pos);
+		if (rec->len == 0) {
+			tail += ring->size - pos;
+			continue;
+		}
+		recs[count++] = rec;
+		tail += rec->len;
+	}
+
+	if (count != 0)
+		log_write_batch(recs, count);
+
+	atomic_store_uint64_t(&ring->tail, tail);
+	return count != 0;
+}
+
+/**
+ * @brief Drain one batch from every ring, freeing those of exited
+ *        threads once empty
+ *
+ * @return true if anything was written.
+ */
+
+static bool log_async_drain_once(void)
+{
+	struct log_ring *ring, *next;
+	bool drained = false;
+
+	pthread_mutex_lock(&log_async_drain_mtx);
+
+	pthread_mutex_lock(&log_async_mtx);
+	ring = glist_first_entry(&log_async_rings, struct log_ring, rings);
+	pthread_mutex_unlock(&log_async_mtx);
+
+	/* Only the drainer removes rings, so ring stays valid */
+	while (ring != NULL) {
+		if (log_ring_drain(ring))
+			drained = true;
+
+		pthread_mutex_lock(&log_async_mtx);
+		next = ring->rings.next != &log_async_rings ?
+		    glist_entry(ring->rings.next, struct log_ring, rings) :
+		    NULL;
+		if (atomic_fetch_uint32_t(&ring->orphaned)
+		    && ring->tail == atomic_fetch_uint64_t(&ring->head)) {
+			glist_del(&ring->rings);
+			log_async_freed_queued += ring->queued;
+			log_async_freed_dropped += ring->dropped;
+			gsh_free(ring->data);
+			gsh_free(ring);
+		}
+		pthread_mutex_unlock(&log_async_mtx);
+		ring = next;
+	}
+
+	pthread_mutex_unlock(&log_async_drain_mtx);
+	return drained;
+}
+
+/**
+ * @brief Write out everything queued so far
+ *
+ * Used before a fatal message and at shutdown.  The flusher may hold
+ * log_async_drain_mtx already, so it skips the drain.
+ */
+
+static void log_async_drain(void)
+{
+	if (!log_async_running
+	    || pthread_equal(pthread_self(), log_async_flusher))
+		return;
+
+	while (log_async_drain_once())
+		;
+}
+
+static cleanup_list_element log_async_cleanup = {
+	.clean = log_async_drain
+};
+
+static void *log_async_flush_thread(void *arg)
+{
+	struct timespec ts;
+
+	SetNameFunction("log_flush");
+
+	for (;;) {
+		if (log_async_drain_once()) {
+			pthread_mutex_lock(&log_async_mtx);
+			pthread_cond_broadcast(&log_async_space_cv);
+			pthread_mutex_unlock(&log_async_mtx);
+			continue;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		timespec_add_nsecs(LOG_ASYNC_IDLE_NS, &ts);
+		pthread_mutex_lock(&log_async_mtx);
+		pthread_cond_broadcast(&log_async_space_cv);
+		(void)pthread_cond_timedwait(&log_async_work_cv,
+					     &log_async_mtx, &ts);
+		pthread_mutex_unlock(&log_async_mtx);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Apply the asynchronous logging parameters
+ *
+ * The flusher is started the first time Async is set and keeps
+ * running; clearing Async makes workers write synchronously again
+ * while it drains what is left.  A new ring size applies to threads
+ * that have not logged yet.
+ *
+ * @param[in] enable    Whether workers should queue messages
+ * @param[in] ring_size Bytes per thread, rounded up to a power of two
+ * @param[in] overflow  What to do when a ring is full
+ */
+
+static void log_async_configure(bool enable, uint32_t ring_size,
+				enum log_overflow overflow)
+{
+	uint32_t size = LOG_ASYNC_RING_MIN;
+	int rc;
+
+	while (size < ring_size)
+		size <<= 1;
+	log_async_ring_size = size;
+	log_async_overflow = overflow;
+
+	if (enable && !log_async_running) {
+		rc = pthread_key_create(&log_async_key, log_ring_release);
+		if (rc == 0)
+			rc = pthread_create(&log_async_flusher, NULL,
+					    log_async_flush_thread, NULL);
+		if (rc != 0) {
+			LogCrit(COMPONENT_LOG,
+				"Could not start log flusher (%s), logging synchronously",
+				strerror(rc));
+			return;
+		}
+		log_async_running = true;
+		RegisterCleanup(&log_async_cleanup);
+	}
+
+	if (enable != log_async_enabled)
+		LogEvent(COMPONENT_LOG, "Switching to %s logging",
+			 enable ? "asynchronous" : "synchronous");
+	log_async_enabled = enable && log_async_running;
+}
+
 static int display_log_header(struct display_buffer *dsp_log)
 {
 	int b_left = display_start(dsp_log);
@@ -1431,6 +1900,12 @@ void display_log_component_level(log_components_t component, char *file,
 	if (b_left > 0)
 		b_left = display_vprintf(&dsp_log, format, arguments);
 
+	if (level == NIV_FATAL)
+		log_async_drain();
+	else if (log_async_enabled
+		 && log_async_queue(level, &dsp_log, compstr, message))
+		return;
+
 	PTHREAD_RWLOCK_rdlock(&log_rwlock);
 
 	glist_for_each(glist, &active_facility_list) {
@@ -1785,11 +2260,86 @@ static struct gsh_dbus_prop *log_props[] = {
 	NULL
 };
 
+/**
+ * @brief Total messages queued and dropped by all rings
+ */
+
+static void log_async_totals(uint64_t *queued, uint64_t *dropped)
+{
+	struct glist_head *glist;
+	struct log_ring *ring;
+
+	pthread_mutex_lock(&log_async_mtx);
+	*queued = log_async_freed_queued;
+	*dropped = log_async_freed_dropped;
+	glist_for_each(glist, &log_async_rings) {
+		ring = glist_entry(glist, struct log_ring, rings);
+		*queued += atomic_fetch_uint64_t(&ring->queued);
+		*dropped += atomic_fetch_uint64_t(&ring->dropped);
+	}
+	pthread_mutex_unlock(&log_async_mtx);
+}
+
+/**
+ * @brief DBus method reporting on asynchronous logging
+ *
+ * @param[in]  args  Unused
+ * @param[out] reply Whether async logging is on, the overflow policy
+ *                   and the messages queued and dropped
+ */
+
+static bool dbus_log_async_stats(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	DBusMessageIter iter;
+	dbus_bool_t enabled = log_async_enabled;
+	char *overflow = log_async_overflow == LOG_OVERFLOW_BLOCK ?
+	    "block" : "drop";
+	uint64_t queued, dropped;
+
+	log_async_totals(&queued, &dropped);
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &enabled);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &overflow);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &queued);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &dropped);
+	return true;
+}
+
+static struct gsh_dbus_method log_async_stats = {
+	.name = "GetAsyncStats",
+	.method = dbus_log_async_stats,
+	.args = {{
+		  .name = "enabled",
+		  .type = "b",
+		  .direction = "out"},
+		 {
+		  .name = "overflow",
+		  .type = "s",
+		  .direction = "out"},
+		 {
+		  .name = "queued",
+		  .type = "t",
+		  .direction = "out"},
+		 {
+		  .name = "dropped",
+		  .type = "t",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method *log_methods[] = {
+	&log_async_stats,
+	NULL
+};
+
 struct gsh_dbus_interface log_interface = {
 	.name = "org.ganesha.nfsd.log.component",
 	.signal_props = false,
 	.props = log_props,
-	.methods = NULL,
+	.methods = log_methods,
 	.signals = NULL
 };
 
@@ -1818,6 +2368,9 @@ struct facility_config {
 
 struct logger_config {
 	log_levels_t default_level;
+	bool async;
+	uint32_t async_ring_size;
+	uint32_t async_overflow;
 	struct glist_head facility_list;
 	struct logfields *logfields;
 	log_levels_t *comp_log_level;
@@ -1843,6 +2396,16 @@ static struct config_item_list timeformats[] = {
 	CONFIG_LIST_EOL
 };
 
+/**
+ * @brief Asynchronous logging overflow policies
+ */
+
+static struct config_item_list overflow_options[] = {
+	CONFIG_LIST_TOK("drop", LOG_OVERFLOW_DROP),
+	CONFIG_LIST_TOK("block", LOG_OVERFLOW_BLOCK),
+	CONFIG_LIST_EOL
+};
+
 /**
  * @brief Logging format parameters
  */
@@ -2414,6 +2977,8 @@ static int log_conf_commit(void *node, void *link_mem, void *self_struct,
 		(void)facility_init(&logger->facility_list, conf);
 	}
 	if (errcnt == 0) {
+		log_async_configure(logger->async, logger->async_ring_size,
+				    logger->async_overflow);
 		if (logger->logfields != NULL) {
 			LogEvent(COMPONENT_CONFIG,
 				 "Changing definition of log fields");
@@ -2457,6 +3022,13 @@ static int log_conf_commit(void *node, void *link_mem, void *self_struct,
 static struct config_item logging_params[] = {
 	CONF_ITEM_TOKEN("Default_log_level", NB_LOG_LEVEL, log_levels,
 			 logger_config, default_level),
+	CONF_ITEM_BOOL("Async", false,
+		       logger_config, async),
+	CONF_ITEM_UI32("Async_Ring_Size", LOG_ASYNC_RING_MIN,
+		       LOG_ASYNC_RING_MAX, LOG_ASYNC_RING_DEFAULT,
+		       logger_config, async_ring_size),
+	CONF_ITEM_ENUM("Async_Overflow", LOG_OVERFLOW_DROP, overflow_options,
+		       logger_config, async_overflow),
 	CONF_ITEM_BLOCK("Facility", facility_params,
 			facility_init, facility_commit,
 			logger_config, facility_list),
@@ -523,6 +523,8 @@ make DESTDIR=%{buildroot} install
 /usr/bin/get_clientids
 /usr/bin/grace_period
 /usr/bin/purge_gids
+/usr/bin/stats_bufpool
+/usr/bin/stats_drc
 /usr/bin/stats_fast
 /usr/bin/stats_global
 /usr/bin/stats_inode
@@ -30,6 +30,7 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <os/subr.h>
 #include <dirent.h>
 #include <sys/syscall.h>
@@ -149,3 +150,21 @@ int set_threadgroups(size_t size, const gid_t *list)
 {
 	return syscall(SYS_setgroups, size, list);
 }
+
+/* NUMA placement is not supported on this platform; everything is
+ * node 0. */
+
+uint32_t gsh_numa_node_count(void)
+{
+	return 1;
+}
+
+uint32_t gsh_numa_node_self(void)
+{
+	return 0;
+}
+
+int gsh_numa_bind_self(uint32_t node)
+{
+	return (node == 0) ? 0 : EINVAL;
+}
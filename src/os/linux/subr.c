@@ -26,10 +26,18 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "fsal.h"
 #include <stddef.h>
+#include <stdio.h>
+#include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sys/fsuid.h>
 #include <sys/syscall.h>
 #include "os/subr.h"
@@ -128,3 +136,111 @@ int set_threadgroups(size_t size, const gid_t *list)
 {
 	return syscall(__NR_setgroups, size, list);
 }
+
+/**
+ * @brief NUMA topology, read once from sysfs
+ *
+ * Nodes are numbered densely in the order sysfs lists them, so a
+ * machine with memoryless or offline nodes still gets node indices
+ * 0..numa_nodes-1.
+ */
+
+#define NUMA_MAX_NODES 64
+
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+static uint32_t numa_nodes = 1;
+static int16_t numa_cpu_node[CPU_SETSIZE];
+static cpu_set_t numa_node_cpus[NUMA_MAX_NODES];
+
+static void numa_parse_cpulist(FILE *fp, uint32_t node)
+{
+	unsigned int lo, hi, cpu;
+	char sep;
+
+	while (fscanf(fp, "%u", &lo) == 1) {
+		hi = lo;
+		sep = fgetc(fp);
+		if (sep == '-') {
+			if (fscanf(fp, "%u", &hi) != 1)
+				break;
+			sep = fgetc(fp);
+		}
+		for (cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+			numa_cpu_node[cpu] = node;
+			CPU_SET(cpu, &numa_node_cpus[node]);
+		}
+		if (sep != ',')
+			break;
+	}
+}
+
+static void numa_init(void)
+{
+	char path[64];
+	uint32_t found = 0;
+	int sysnode;
+	FILE *fp;
+
+	memset(numa_cpu_node, 0, sizeof(numa_cpu_node));
+
+	for (sysnode = 0;
+	     sysnode < 1024 && found < NUMA_MAX_NODES;
+	     sysnode++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", sysnode);
+		fp = fopen(path, "r");
+		if (fp == NULL)
+			continue;
+		CPU_ZERO(&numa_node_cpus[found]);
+		numa_parse_cpulist(fp, found);
+		fclose(fp);
+		if (CPU_COUNT(&numa_node_cpus[found]) > 0)
+			found++;
+	}
+
+	numa_nodes = (found > 0) ? found : 1;
+}
+
+/**
+ * @brief Return the number of NUMA nodes with CPUs (at least 1)
+ */
+uint32_t gsh_numa_node_count(void)
+{
+	(void)pthread_once(&numa_once, numa_init);
+	return numa_nodes;
+}
+
+/**
+ * @brief Return the NUMA node the calling thread is running on
+ */
+uint32_t gsh_numa_node_self(void)
+{
+	int cpu;
+
+	(void)pthread_once(&numa_once, numa_init);
+	if (numa_nodes == 1)
+		return 0;
+
+	cpu = sched_getcpu();
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return 0;
+
+	return numa_cpu_node[cpu];
+}
+
+/**
+ * @brief Restrict the calling thread to the CPUs of a NUMA node
+ *
+ * @param[in] node  Dense node index, less than gsh_numa_node_count()
+ *
+ * @return 0 on success, an errno otherwise.
+ */
+int gsh_numa_bind_self(uint32_t node)
+{
+	(void)pthread_once(&numa_once, numa_init);
+	if (node >= numa_nodes)
+		return EINVAL;
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+				      &numa_node_cpus[node]);
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/python
+
+# You must initialize the gobject/dbus support for threading
+# before doing anything.
+import gobject
+import sys
+
+gobject.threads_init()
+
+from dbus import glib
+glib.init_threads()
+
+# Create a session bus.
+import dbus
+bus = dbus.SystemBus()
+
+# Create an object that will proxy for a particular remote object.
+try:
+	admin = bus.get_object("org.ganesha.nfsd",
+                       "/org/ganesha/nfsd/ExportMgr")
+except: # catch *all* exceptions
+      print "Error: Can't talk to ganesha service on d-bus. Looks like Ganesha is down"
+      exit(1)
+
+# call method
+ganesha_bufpool = admin.get_dbus_method('ShowBufferPool',
+                               'org.ganesha.nfsd.exportstats')
+
+pool = ganesha_bufpool()
+if pool[1] != "OK":
+	print "No buffer pool statistics"
+	exit(1)
+
+print "I/O buffer pool (oversize requests: %d):" % pool[3]
+print "  %8s %10s %10s %14s %14s %8s" % \
+    ("size", "in use", "cached", "allocs", "misses", "miss%")
+for (size, in_use, cached, allocs, misses) in pool[4]:
+	if allocs == 0:
+		continue
+	print "  %7dK %10d %10d %14d %14d %7.2f%%" % \
+	    (size / 1024, in_use, cached, allocs, misses,
+	     100.0 * misses / allocs)
+
+exit(0)
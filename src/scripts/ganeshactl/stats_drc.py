@@ -0,0 +1,49 @@
+#!/usr/bin/python
+
+# You must initialize the gobject/dbus support for threading
+# before doing anything.
+import gobject
+import sys
+
+gobject.threads_init()
+
+from dbus import glib
+glib.init_threads()
+
+# Create a session bus.
+import dbus
+bus = dbus.SystemBus()
+
+# Create an object that will proxy for a particular remote object.
+try:
+	admin = bus.get_object("org.ganesha.nfsd",
+                       "/org/ganesha/nfsd/ExportMgr")
+except: # catch *all* exceptions
+      print "Error: Can't talk to ganesha service on d-bus. Looks like Ganesha is down"
+      exit(1)
+
+# call method
+ganesha_drc = admin.get_dbus_method('ShowDRC',
+                               'org.ganesha.nfsd.exportstats')
+
+drc = ganesha_drc()
+if drc[1] != "OK":
+	print "No duplicate request cache statistics"
+	exit(1)
+
+(hits, in_progress, misses, evictions, entries,
+ tcp_drcs, tcp_recycled) = drc[3:10]
+lookups = hits + in_progress + misses
+
+print "Duplicate request cache:"
+print "  %-24s %14d" % ("hits", hits)
+print "  %-24s %14d" % ("in progress", in_progress)
+print "  %-24s %14d" % ("misses", misses)
+if lookups != 0:
+	print "  %-24s %13.2f%%" % ("hit rate", 100.0 * hits / lookups)
+print "  %-24s %14d" % ("evictions", evictions)
+print "  %-24s %14d" % ("cached entries", entries)
+print "  %-24s %14d" % ("TCP DRCs", tcp_drcs)
+print "  %-24s %14d" % ("TCP DRCs for reconnect", tcp_recycled)
+
+exit(0)
@@ -34,5 +34,30 @@ else:
 	for stat in total_ops[3]:
 		print ' ', stat,
 	print
+	stats = dict(zip(total_ops[3][0::2], total_ops[3][1::2]))
+	if stats.get('cache_req', 0) > 0:
+		print "  hit ratio: %.2f%%" % \
+		    (100.0 * stats['cache_hit'] / stats['cache_req'])
+	if stats.get('cache_reclaim', 0) > 0:
+		# Ghost hits are entries reclaimed from probation and
+		# loaded again soon after; a high share of reclaims
+		# suggests Entries_HWMark is too small.
+		print "  ghost hits per reclaim: %.2f%%" % \
+		    (100.0 * stats['cache_ghost_hit'] /
+		     stats['cache_reclaim'])
+
+ganesha_nfsstats_nodes = admin.get_dbus_method('ShowCacheInodeNodes',
+                               'org.ganesha.nfsd.exportstats')
+try:
+	nodes = ganesha_nfsstats_nodes()
+except dbus.exceptions.DBusException:
+	nodes = None
+if nodes is not None and nodes[1] == "OK" and len(nodes[3]) > 1:
+	print "Per NUMA node (entries, L1, L2, probation, pinned, cleanup):"
+	for node in nodes[3]:
+		print "  node %d:" % node[0],
+		for count in node[1:]:
+			print count,
+		print
 
 exit(0)
@@ -0,0 +1,43 @@
+#!/usr/bin/python
+
+# You must initialize the gobject/dbus support for threading
+# before doing anything.
+import gobject
+import sys
+
+gobject.threads_init()
+
+from dbus import glib
+glib.init_threads()
+
+# Create a session bus.
+import dbus
+bus = dbus.SystemBus()
+
+# Create an object that will proxy for a particular remote object.
+try:
+	admin = bus.get_object("org.ganesha.nfsd",
+                       "/org/ganesha/nfsd/ExportMgr")
+except: # catch *all* exceptions
+      print "Error: Can't talk to ganesha service on d-bus. Looks like Ganesha is down"
+      exit(1)
+
+# call method
+ganesha_latency = admin.get_dbus_method('GetGlobalLatency',
+                               'org.ganesha.nfsd.exportstats')
+
+latency=ganesha_latency()
+if latency[1] != "OK":
+	print "No NFS activity"
+	exit(1)
+
+# latencies are reported in nsecs, print usecs
+print "%-32s %12s %10s %10s %10s" % ("Global latency (usecs)", "count",
+				     "p50", "p99", "p999")
+for hist in latency[4]:
+	print "%-32s %12d %10.1f %10.1f %10.1f" % (hist[0], hist[1],
+						   hist[2] / 1000.0,
+						   hist[3] / 1000.0,
+						   hist[4] / 1000.0)
+
+exit(0)
@@ -0,0 +1,508 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup bufpool
+ * @{
+ */
+
+/**
+ * @file bufpool.c
+ * @brief Size-classed I/O buffer pool
+ *
+ * Each size class is a pool_t built on the caching substrate defined
+ * here.  A returned buffer goes to the calling thread's cache for its
+ * class if there is room, else to the class's shared free list, else
+ * back to the heap.  Free buffers are chained through their first
+ * word, so the caches cost no memory beyond the buffers themselves.
+ *
+ * The per-thread cache is bounded in bytes (BUFPOOL_TCACHE_BYTES per
+ * class) so that a few hundred workers do not pin gigabytes of large
+ * buffers, and the shared list is bounded the same way.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "gsh_bufpool.h"
+
+/** Bytes of each class a thread may keep for itself */
+#define BUFPOOL_TCACHE_BYTES (1024 * 1024)
+/** Most buffers of a class a thread may keep */
+#define BUFPOOL_TCACHE_MAX 8
+/** Bytes of each class kept on the shared free list */
+#define BUFPOOL_FREE_BYTES (64 * 1024 * 1024)
+/** Bounds on the shared free list length */
+#define BUFPOOL_FREE_MIN 16
+#define BUFPOOL_FREE_MAX 1024
+
+/** Thread cache slot of the gsh_iobuf header class */
+#define BUFPOOL_IOBUF_CLASS BUFPOOL_N_CLASSES
+
+/**
+ * @brief Parameters for the caching substrate
+ */
+
+struct bufpool_params {
+	uint32_t idx;		/*< Thread cache slot of this pool */
+	uint32_t tcache_depth;	/*< Buffers a thread may cache */
+	uint32_t max_free;	/*< Buffers on the shared free list */
+	size_t align;		/*< Alignment of new buffers, or 0 */
+};
+
+/**
+ * @brief Substrate data of a caching pool
+ */
+
+struct bufpool_class {
+	pthread_mutex_t lock;	/*< Protects free and nfree */
+	void *free;		/*< Shared free list */
+	uint32_t nfree;		/*< Length of the shared free list */
+	struct bufpool_params params;
+	uint64_t in_use;	/*< Buffers handed out */
+	uint64_t cached;	/*< Buffers in thread caches or free list */
+	uint64_t allocs;	/*< Total allocations */
+	uint64_t misses;	/*< Allocations served by the heap */
+};
+
+struct bufpool_tcache {
+	void *head;
+	uint32_t count;
+};
+
+static __thread struct bufpool_tcache bufpool_tcache[BUFPOOL_N_CLASSES + 1];
+static __thread bool bufpool_tcache_registered;
+static pthread_key_t bufpool_tcache_key;
+
+static pool_t *bufpool_pool[BUFPOOL_N_CLASSES];
+static pool_t *bufpool_iobuf_pool;
+static uint64_t bufpool_oversize;
+
+static inline struct bufpool_class *
+bufpool_class_of(pool_t *pool)
+{
+	return (struct bufpool_class *)pool->substrate_data;
+}
+
+static inline void *
+bufpool_next(void *object)
+{
+	return *(void **)object;
+}
+
+static inline void
+bufpool_set_next(void *object, void *next)
+{
+	*(void **)object = next;
+}
+
+/**
+ * @brief Push a buffer on the shared free list or release it
+ */
+
+static void
+bufpool_release(pool_t *pool, void *object)
+{
+	struct bufpool_class *bc = bufpool_class_of(pool);
+
+	pthread_mutex_lock(&bc->lock);
+	if (bc->nfree < bc->params.max_free) {
+		bufpool_set_next(object, bc->free);
+		bc->free = object;
+		bc->nfree++;
+		pthread_mutex_unlock(&bc->lock);
+		return;
+	}
+	pthread_mutex_unlock(&bc->lock);
+
+	(void)atomic_dec_uint64_t(&bc->cached);
+	gsh_free(object);
+}
+
+static pool_t *
+bufpool_slot_pool(uint32_t idx)
+{
+	return idx == BUFPOOL_IOBUF_CLASS ?
+	    bufpool_iobuf_pool : bufpool_pool[idx];
+}
+
+/**
+ * @brief Hand a departing thread's cached buffers back
+ *
+ * @param[in] arg Unused key value
+ */
+
+static void
+bufpool_tcache_flush(void *arg __attribute__ ((unused)))
+{
+	uint32_t idx;
+
+	for (idx = 0; idx <= BUFPOOL_N_CLASSES; idx++) {
+		struct bufpool_tcache *tc = &bufpool_tcache[idx];
+
+		while (tc->head != NULL) {
+			void *object = tc->head;
+
+			tc->head = bufpool_next(object);
+			bufpool_release(bufpool_slot_pool(idx), object);
+		}
+		tc->count = 0;
+	}
+	bufpool_tcache_registered = false;
+}
+
+/**
+ * @brief Create a caching pool
+ *
+ * @param[in] size  Size of the objects (unused)
+ * @param[in] param A struct bufpool_params
+ *
+ * @return The pool_t or NULL.
+ */
+
+static pool_t *
+bufpool_initializer(size_t size __attribute__ ((unused)), void *param)
+{
+	pool_t *pool;
+	struct bufpool_class *bc;
+
+	pool = gsh_calloc(1, sizeof(pool_t) + sizeof(struct bufpool_class));
+	if (pool == NULL)
+		return NULL;
+
+	bc = bufpool_class_of(pool);
+	pthread_mutex_init(&bc->lock, NULL);
+	bc->params = *(struct bufpool_params *)param;
+
+	return pool;
+}
+
+/**
+ * @brief Destroy a caching pool
+ *
+ * Only the shared free list is drained.  Buffers still sitting in
+ * thread caches are released when those threads exit.
+ *
+ * @param[in] pool The pool to destroy
+ */
+
+static void
+bufpool_destroy(pool_t *pool)
+{
+	struct bufpool_class *bc = bufpool_class_of(pool);
+
+	while (bc->free != NULL) {
+		void *object = bc->free;
+
+		bc->free = bufpool_next(object);
+		gsh_free(object);
+	}
+	pthread_mutex_destroy(&bc->lock);
+	gsh_free(pool->name);
+	gsh_free(pool);
+}
+
+/**
+ * @brief Take a buffer from the thread cache, the free list or the heap
+ *
+ * @param[in] pool The pool from which to allocate
+ *
+ * @return The buffer or NULL.
+ */
+
+static void *
+bufpool_alloc(pool_t *pool)
+{
+	struct bufpool_class *bc = bufpool_class_of(pool);
+	struct bufpool_tcache *tc = &bufpool_tcache[bc->params.idx];
+	void *object = tc->head;
+
+	if (object != NULL) {
+		tc->head = bufpool_next(object);
+		tc->count--;
+	} else {
+		pthread_mutex_lock(&bc->lock);
+		object = bc->free;
+		if (object != NULL) {
+			bc->free = bufpool_next(object);
+			bc->nfree--;
+		}
+		pthread_mutex_unlock(&bc->lock);
+	}
+
+	if (object != NULL) {
+		(void)atomic_dec_uint64_t(&bc->cached);
+	} else {
+		(void)atomic_inc_uint64_t(&bc->misses);
+		if (bc->params.align != 0)
+			object = gsh_malloc_aligned(bc->params.align,
+						    pool->object_size);
+		else
+			object = gsh_malloc(pool->object_size);
+		if (object == NULL)
+			return NULL;
+	}
+
+	(void)atomic_inc_uint64_t(&bc->allocs);
+	(void)atomic_inc_uint64_t(&bc->in_use);
+	return object;
+}
+
+/**
+ * @brief Return a buffer to the thread cache or the free list
+ *
+ * @param[in] pool   The pool to which to return the buffer
+ * @param[in] object The buffer
+ */
+
+static void
+bufpool_free(pool_t *pool, void *object)
+{
+	struct bufpool_class *bc = bufpool_class_of(pool);
+	struct bufpool_tcache *tc = &bufpool_tcache[bc->params.idx];
+
+	(void)atomic_dec_uint64_t(&bc->in_use);
+	(void)atomic_inc_uint64_t(&bc->cached);
+
+	if (tc->count < bc->params.tcache_depth) {
+		if (!bufpool_tcache_registered) {
+			/* Any non-NULL value arms the exit destructor */
+			(void)pthread_setspecific(bufpool_tcache_key, tc);
+			bufpool_tcache_registered = true;
+		}
+		bufpool_set_next(object, tc->head);
+		tc->head = object;
+		tc->count++;
+		return;
+	}
+
+	bufpool_release(pool, object);
+}
+
+static const struct pool_substrate_vector bufpool_substrate[] = {
+	{
+		.initializer = bufpool_initializer,
+		.destroyer = bufpool_destroy,
+		.allocator = bufpool_alloc,
+		.freer = bufpool_free
+	}
+};
+
+static inline uint32_t
+bufpool_clamp(uint64_t value, uint32_t min, uint32_t max)
+{
+	if (value < min)
+		return min;
+	if (value > max)
+		return max;
+	return value;
+}
+
+/**
+ * @brief Size class serving a request
+ *
+ * @param[in] size Bytes wanted
+ *
+ * @return The class index, or -1 if the request is oversize.
+ */
+
+static inline int
+bufpool_class_index(size_t size)
+{
+	int shift;
+
+	if (size <= (1UL << BUFPOOL_MIN_SHIFT))
+		return 0;
+
+	shift = 64 - __builtin_clzll((unsigned long long)size - 1);
+	if (shift > BUFPOOL_MAX_SHIFT)
+		return -1;
+
+	return shift - BUFPOOL_MIN_SHIFT;
+}
+
+/**
+ * @brief Create the size classes
+ *
+ * @retval 0 on success.
+ * @retval Non-zero on failure.
+ */
+
+int gsh_bufpool_init(void)
+{
+	struct bufpool_params params;
+	char name[32];
+	uint32_t idx;
+	int rc;
+
+	rc = pthread_key_create(&bufpool_tcache_key, bufpool_tcache_flush);
+	if (rc != 0) {
+		LogCrit(COMPONENT_INIT,
+			"Could not create I/O buffer cache key: %d", rc);
+		return rc;
+	}
+
+	for (idx = 0; idx < BUFPOOL_N_CLASSES; idx++) {
+		uint32_t shift = idx + BUFPOOL_MIN_SHIFT;
+
+		params.idx = idx;
+		params.tcache_depth =
+		    bufpool_clamp(BUFPOOL_TCACHE_BYTES >> shift, 1,
+				  BUFPOOL_TCACHE_MAX);
+		params.max_free =
+		    bufpool_clamp(BUFPOOL_FREE_BYTES >> shift,
+				  BUFPOOL_FREE_MIN, BUFPOOL_FREE_MAX);
+		params.align = 4096;
+
+		snprintf(name, sizeof(name), "I/O buffers %uK",
+			 1U << (shift - 10));
+		bufpool_pool[idx] = pool_init(name, 1UL << shift,
+					      bufpool_substrate, &params,
+					      NULL, NULL);
+		if (bufpool_pool[idx] == NULL) {
+			LogCrit(COMPONENT_INIT,
+				"Could not create I/O buffer pool %s", name);
+			return ENOMEM;
+		}
+	}
+
+	params.idx = BUFPOOL_IOBUF_CLASS;
+	params.tcache_depth = BUFPOOL_TCACHE_MAX;
+	params.max_free = BUFPOOL_FREE_MAX;
+	params.align = 0;
+	bufpool_iobuf_pool = pool_init("I/O buffer headers",
+				       sizeof(struct gsh_iobuf),
+				       bufpool_substrate, &params,
+				       NULL, NULL);
+	if (bufpool_iobuf_pool == NULL) {
+		LogCrit(COMPONENT_INIT,
+			"Could not create I/O buffer header pool");
+		return ENOMEM;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get a page-aligned payload buffer
+ *
+ * @param[in] size Bytes wanted
+ *
+ * @return A buffer of at least size bytes, or NULL.  It must be
+ *         returned with gsh_bufpool_put and the same size.
+ */
+
+void *gsh_bufpool_get(size_t size)
+{
+	int idx = bufpool_class_index(size);
+
+	if (idx < 0) {
+		(void)atomic_inc_uint64_t(&bufpool_oversize);
+		return gsh_malloc_aligned(4096, size);
+	}
+
+	return pool_alloc(bufpool_pool[idx], NULL);
+}
+
+/**
+ * @brief Return a payload buffer
+ *
+ * @param[in] buf  Buffer from gsh_bufpool_get
+ * @param[in] size The size it was requested with
+ */
+
+void gsh_bufpool_put(void *buf, size_t size)
+{
+	int idx = bufpool_class_index(size);
+
+	if (idx < 0)
+		gsh_free(buf);
+	else
+		pool_free(bufpool_pool[idx], buf);
+}
+
+static void
+bufpool_iobuf_release(struct gsh_iobuf *iob)
+{
+	gsh_bufpool_put(iob->addr, iob->size);
+	pool_free(bufpool_iobuf_pool, iob);
+}
+
+/**
+ * @brief Get a pooled payload for read_iobuf
+ *
+ * @param[in] size Bytes wanted
+ *
+ * @return A payload holding one reference, or NULL.
+ */
+
+struct gsh_iobuf *gsh_bufpool_iobuf(size_t size)
+{
+	struct gsh_iobuf *iob = pool_alloc(bufpool_iobuf_pool, NULL);
+
+	if (iob == NULL)
+		return NULL;
+
+	iob->addr = gsh_bufpool_get(size);
+	if (iob->addr == NULL) {
+		pool_free(bufpool_iobuf_pool, iob);
+		return NULL;
+	}
+	iob->len = 0;
+	iob->size = size;
+	iob->refcnt = 1;
+	iob->release = bufpool_iobuf_release;
+	iob->priv = NULL;
+
+	return iob;
+}
+
+/**
+ * @brief Read the pool counters
+ *
+ * @param[out] stats One entry per size class
+ *
+ * @return Number of oversize requests served by the heap.
+ */
+
+uint64_t gsh_bufpool_stats(struct bufpool_class_stats *stats)
+{
+	uint32_t idx;
+
+	for (idx = 0; idx < BUFPOOL_N_CLASSES; idx++) {
+		struct bufpool_class *bc = bufpool_class_of(bufpool_pool[idx]);
+
+		stats[idx].size = bufpool_pool[idx]->object_size;
+		stats[idx].in_use = atomic_fetch_uint64_t(&bc->in_use);
+		stats[idx].cached = atomic_fetch_uint64_t(&bc->cached);
+		stats[idx].allocs = atomic_fetch_uint64_t(&bc->allocs);
+		stats[idx].misses = atomic_fetch_uint64_t(&bc->misses);
+	}
+
+	return atomic_fetch_uint64_t(&bufpool_oversize);
+}
+
+/** @} */
@@ -826,6 +826,46 @@ static struct gsh_dbus_method cltmgr_show_9p_trans = {
 		 END_ARG_LIST}
 };
 
+/**
+ * DBUS method to report latency histograms
+ *
+ */
+
+static bool get_stats_latency(DBusMessageIter *args,
+			      DBusMessage *reply,
+			      DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct server_stats *server_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	client = lookup_client(args, &errormsg);
+	if (client == NULL) {
+		success = false;
+		if (errormsg == NULL)
+			errormsg = "Client IP address not found";
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success) {
+		server_st = container_of(client, struct server_stats, client);
+		server_dbus_latency(&server_st->st, &iter);
+		put_gsh_client(client);
+	}
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_latency = {
+	.name = "GetLatency",
+	.method = get_stats_latency,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LATENCY_REPLY,
+		 END_ARG_LIST}
+};
 
 static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v3_io,
@@ -834,6 +874,7 @@ static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v41_layouts,
 	&cltmgr_show_9p_io,
 	&cltmgr_show_9p_trans,
+	&cltmgr_show_latency,
 	NULL
 };
 
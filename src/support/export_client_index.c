@@ -0,0 +1,432 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file export_client_index.c
+ * @brief Compiled client list matching
+ *
+ * Every entry gets its position in the client list as its order, and
+ * each structure keeps only the earliest entry for a given key.  A
+ * lookup takes the earliest of the MATCH_ANY entry, the host hash hit
+ * and every trie node on the address's path, then tries name entries
+ * ahead of that in list order.  IPv6 clients only ever matched hosts
+ * and MATCH_ANY, and still do.
+ */
+
+#include "config.h"
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include "log.h"
+#include "abstract_mem.h"
+#include "city.h"
+#include "export_client_index.h"
+
+/** Decisions remembered per export, for name matches only */
+#define CLIENT_CACHE_SLOTS 256
+/** Locks over the decision slots */
+#define CLIENT_CACHE_LOCKS 16
+/** Seconds a name match decision is trusted, netgroups and DNS
+ *  do change under us */
+#define CLIENT_CACHE_TTL 60
+
+struct client_trie_node {
+	struct client_trie_node *child[2];
+	exportlist_client_entry_t *client;	/*< First entry for prefix */
+};
+
+struct client_host {
+	struct client_host *next;
+	sa_family_t family;
+	uint8_t addr[16];
+	exportlist_client_entry_t *client;
+};
+
+struct client_decision {
+	in_addr_t addr;
+	time_t expires;			/*< 0 if the slot is empty */
+	exportlist_client_entry_t *client;	/*< NULL for no match */
+};
+
+struct client_index {
+	struct client_trie_node *v4;	/*< IPv4 networks */
+	struct client_host **hosts;	/*< Host addresses, both families */
+	uint32_t host_mask;
+	exportlist_client_entry_t *any;	/*< First MATCH_ANY_CLIENT */
+	exportlist_client_entry_t **slow;	/*< Name entries, in order */
+	uint32_t nslow;
+	struct client_decision *cache;	/*< Only with name entries */
+	pthread_mutex_t cache_mtx[CLIENT_CACHE_LOCKS];
+};
+
+static inline exportlist_client_entry_t *
+client_first(exportlist_client_entry_t *a, exportlist_client_entry_t *b)
+{
+	if (a == NULL)
+		return b;
+	if (b == NULL || a->order < b->order)
+		return a;
+	return b;
+}
+
+static void client_trie_free(struct client_trie_node *node)
+{
+	if (node == NULL)
+		return;
+	client_trie_free(node->child[0]);
+	client_trie_free(node->child[1]);
+	gsh_free(node);
+}
+
+/**
+ * @brief Prefix length of a netmask
+ *
+ * @return The length, or -1 if the mask is not contiguous.
+ */
+
+static int client_prefix_len(uint32_t netmask)
+{
+	int len = 0;
+
+	while (len < 32 && (netmask & (0x80000000U >> len)))
+		len++;
+
+	if (len < 32 && (netmask << len) != 0)
+		return -1;
+
+	return len;
+}
+
+static bool client_trie_insert(struct client_index *ci,
+			       exportlist_client_entry_t *client, int len)
+{
+	struct client_trie_node **link = &ci->v4;
+	uint32_t net = client->client.network.netaddr;
+	int bit = 0;
+
+	for (;;) {
+		if (*link == NULL) {
+			*link = gsh_calloc(1, sizeof(struct client_trie_node));
+			if (*link == NULL)
+				return false;
+		}
+		if (bit == len)
+			break;
+		link = &(*link)->child[(net >> (31 - bit)) & 1];
+		bit++;
+	}
+
+	if ((*link)->client == NULL)
+		(*link)->client = client;
+	return true;
+}
+
+/* addr in host order */
+static exportlist_client_entry_t *
+client_trie_lookup(struct client_index *ci, uint32_t addr)
+{
+	struct client_trie_node *node = ci->v4;
+	exportlist_client_entry_t *best = NULL;
+	int bit = 0;
+
+	while (node != NULL) {
+		best = client_first(best, node->client);
+		if (bit == 32)
+			break;
+		node = node->child[(addr >> (31 - bit)) & 1];
+		bit++;
+	}
+
+	return best;
+}
+
+static inline uint32_t client_host_hash(struct client_index *ci,
+					sa_family_t family, const void *addr)
+{
+	size_t len = family == AF_INET ? 4 : 16;
+
+	return CityHash64(addr, len) & ci->host_mask;
+}
+
+static bool client_host_insert(struct client_index *ci,
+			       exportlist_client_entry_t *client)
+{
+	struct client_host *host;
+	sa_family_t family;
+	const void *addr;
+	uint32_t h;
+
+	if (client->type == HOSTIF_CLIENT) {
+		family = AF_INET;
+		addr = &client->client.hostif.clientaddr;
+	} else {
+		family = AF_INET6;
+		addr = &client->client.hostif.clientaddr6;
+	}
+
+	h = client_host_hash(ci, family, addr);
+	for (host = ci->hosts[h]; host != NULL; host = host->next)
+		if (host->family == family &&
+		    memcmp(host->addr, addr, family == AF_INET ? 4 : 16) == 0)
+			return true;	/* an earlier entry wins */
+
+	host = gsh_calloc(1, sizeof(struct client_host));
+	if (host == NULL)
+		return false;
+	host->family = family;
+	memcpy(host->addr, addr, family == AF_INET ? 4 : 16);
+	host->client = client;
+	host->next = ci->hosts[h];
+	ci->hosts[h] = host;
+	return true;
+}
+
+static exportlist_client_entry_t *
+client_host_lookup(struct client_index *ci, sa_family_t family,
+		   const void *addr)
+{
+	struct client_host *host;
+
+	if (ci->hosts == NULL)
+		return NULL;
+
+	host = ci->hosts[client_host_hash(ci, family, addr)];
+	for (; host != NULL; host = host->next)
+		if (host->family == family &&
+		    memcmp(host->addr, addr, family == AF_INET ? 4 : 16) == 0)
+			return host->client;
+
+	return NULL;
+}
+
+/**
+ * @brief Free a compiled client list
+ *
+ * @param[in] ci The index, may be NULL
+ */
+
+void client_index_free(struct client_index *ci)
+{
+	struct client_host *host;
+	uint32_t i;
+
+	if (ci == NULL)
+		return;
+
+	client_trie_free(ci->v4);
+	if (ci->hosts != NULL) {
+		for (i = 0; i <= ci->host_mask; i++)
+			while ((host = ci->hosts[i]) != NULL) {
+				ci->hosts[i] = host->next;
+				gsh_free(host);
+			}
+		gsh_free(ci->hosts);
+	}
+	if (ci->slow != NULL)
+		gsh_free(ci->slow);
+	if (ci->cache != NULL)
+		gsh_free(ci->cache);
+	for (i = 0; i < CLIENT_CACHE_LOCKS; i++)
+		pthread_mutex_destroy(&ci->cache_mtx[i]);
+	gsh_free(ci);
+}
+
+/**
+ * @brief Compile an export's client list
+ *
+ * Sets the order of each entry.  The list must not change afterwards.
+ *
+ * @param[in] clients The export's client list
+ *
+ * @return The index, or NULL if the list is empty or memory ran out;
+ *         the caller then walks the list.
+ */
+
+struct client_index *client_index_build(struct glist_head *clients)
+{
+	struct client_index *ci;
+	struct glist_head *glist;
+	exportlist_client_entry_t *client;
+	uint32_t order = 0, nhosts = 0, nslow = 0, size;
+	int i, len;
+
+	if (glist_empty(clients))
+		return NULL;
+
+	ci = gsh_calloc(1, sizeof(struct client_index));
+	if (ci == NULL)
+		return NULL;
+	for (i = 0; i < CLIENT_CACHE_LOCKS; i++)
+		pthread_mutex_init(&ci->cache_mtx[i], NULL);
+
+	glist_for_each(glist, clients) {
+		client = glist_entry(glist, exportlist_client_entry_t,
+				     cle_list);
+		client->order = order++;
+		if (client->type == HOSTIF_CLIENT ||
+		    client->type == HOSTIF_CLIENT_V6)
+			nhosts++;
+		else if (client->type == NETGROUP_CLIENT ||
+			 client->type == WILDCARDHOST_CLIENT ||
+			 (client->type == NETWORK_CLIENT &&
+			  client_prefix_len(client->client.network.netmask)
+			  < 0))
+			nslow++;
+	}
+
+	if (nhosts != 0) {
+		for (size = 16; size < 2 * nhosts; size <<= 1)
+			;
+		ci->hosts = gsh_calloc(size, sizeof(struct client_host *));
+		if (ci->hosts == NULL)
+			goto err;
+		ci->host_mask = size - 1;
+	}
+
+	if (nslow != 0) {
+		ci->slow = gsh_calloc(nslow, sizeof(*ci->slow));
+		ci->cache = gsh_calloc(CLIENT_CACHE_SLOTS,
+				       sizeof(struct client_decision));
+		if (ci->slow == NULL || ci->cache == NULL)
+			goto err;
+	}
+
+	glist_for_each(glist, clients) {
+		client = glist_entry(glist, exportlist_client_entry_t,
+				     cle_list);
+		switch (client->type) {
+		case HOSTIF_CLIENT:
+		case HOSTIF_CLIENT_V6:
+			if (!client_host_insert(ci, client))
+				goto err;
+			break;
+
+		case NETWORK_CLIENT:
+			len = client_prefix_len(client->client.network.netmask);
+			if (len < 0)
+				ci->slow[ci->nslow++] = client;
+			else if ((client->client.network.netaddr &
+				  ~client->client.network.netmask) != 0)
+				break;	/* host bits set, never matches */
+			else if (!client_trie_insert(ci, client, len))
+				goto err;
+			break;
+
+		case NETGROUP_CLIENT:
+		case WILDCARDHOST_CLIENT:
+			ci->slow[ci->nslow++] = client;
+			break;
+
+		case MATCH_ANY_CLIENT:
+			if (ci->any == NULL)
+				ci->any = client;
+			break;
+
+		default:
+			/* never matches */
+			break;
+		}
+	}
+
+	LogDebug(COMPONENT_EXPORT,
+		 "Compiled %u clients: %u hosts, %u by name%s",
+		 order, nhosts, ci->nslow,
+		 ci->any != NULL ? ", match any" : "");
+
+	return ci;
+
+err:
+	LogMajor(COMPONENT_EXPORT,
+		 "Could not compile client list, matching linearly");
+	client_index_free(ci);
+	return NULL;
+}
+
+/**
+ * @brief Find the first entry of a compiled client list that matches
+ *
+ * @param[in] ci       The index
+ * @param[in] hostaddr The client, IPv4 mapped addresses already
+ *                     converted
+ * @param[in] match    Matches a single name entry
+ *
+ * @return The matching entry, or NULL.
+ */
+
+exportlist_client_entry_t *client_index_match(struct client_index *ci,
+					      sockaddr_t *hostaddr,
+					      client_match_fn match)
+{
+	exportlist_client_entry_t *best;
+	struct client_decision *slot;
+	pthread_mutex_t *mtx;
+	in_addr_t addr;
+	time_t now;
+	uint32_t i, h;
+
+	if (hostaddr->ss_family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)hostaddr;
+
+		return client_first(ci->any,
+				    client_host_lookup(ci, AF_INET6,
+						       &sin6->sin6_addr));
+	}
+
+	addr = get_in_addr(hostaddr);
+	best = client_first(ci->any, client_host_lookup(ci, AF_INET, &addr));
+	best = client_first(best, client_trie_lookup(ci, ntohl(addr)));
+
+	/* No name entry comes first, the address decides */
+	if (ci->nslow == 0 ||
+	    (best != NULL && best->order < ci->slow[0]->order))
+		return best;
+
+	h = CityHash64((char *)&addr, sizeof(addr)) % CLIENT_CACHE_SLOTS;
+	slot = &ci->cache[h];
+	mtx = &ci->cache_mtx[h % CLIENT_CACHE_LOCKS];
+	now = time(NULL);
+
+	pthread_mutex_lock(mtx);
+	if (slot->expires > now && slot->addr == addr) {
+		best = slot->client;
+		pthread_mutex_unlock(mtx);
+		return best;
+	}
+	pthread_mutex_unlock(mtx);
+
+	for (i = 0; i < ci->nslow; i++) {
+		if (best != NULL && ci->slow[i]->order > best->order)
+			break;
+		if (match(ci->slow[i], hostaddr)) {
+			best = ci->slow[i];
+			break;
+		}
+	}
+
+	pthread_mutex_lock(mtx);
+	slot->addr = addr;
+	slot->client = best;
+	slot->expires = now + CLIENT_CACHE_TTL;
+	pthread_mutex_unlock(mtx);
+
+	return best;
+}
@@ -1418,6 +1418,98 @@ static bool show_cache_inode_stats(DBusMessageIter *args,
 	return true;
 }
 
+static bool show_cache_inode_nodes(DBusMessageIter *args,
+				   DBusMessage *reply,
+				   DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	cache_inode_dbus_show_nodes(&iter);
+
+	return true;
+}
+
+static bool show_bufpool(DBusMessageIter *args,
+			 DBusMessage *reply,
+			 DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	bufpool_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_drc(DBusMessageIter *args,
+		     DBusMessage *reply,
+		     DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	drc_dbus_show(&iter);
+
+	return true;
+}
+
+/**
+ * DBUS method to report latency histograms
+ *
+ */
+
+static bool get_export_latency(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	struct export_stats *export_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL)
+		success = false;
+	dbus_status_reply(&iter, success, errormsg);
+	if (success) {
+		export_st = container_of(export, struct export_stats, export);
+		server_dbus_latency(&export_st->st, &iter);
+		put_gsh_export(export);
+	}
+	return true;
+}
+
+static bool get_global_latency(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	global_dbus_latency(&iter);
+
+	return true;
+}
+
 static struct gsh_dbus_method export_show_v41_layouts = {
 	.name = "GetNFSv41Layouts",
 	.method = get_nfsv41_export_layouts,
@@ -1502,6 +1594,25 @@ static struct gsh_dbus_method global_show_fast_ops = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method export_show_latency = {
+	.name = "GetLatency",
+	.method = get_export_latency,
+	.args = {EXPORT_ID_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LATENCY_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method global_show_latency = {
+	.name = "GetGlobalLatency",
+	.method = get_global_latency,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 LATENCY_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method cache_inode_show = {
 	.name = "ShowCacheInode",
 	.method = show_cache_inode_stats,
@@ -1512,6 +1623,33 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method cache_inode_show_nodes = {
+	.name = "ShowCacheInodeNodes",
+	.method = show_cache_inode_nodes,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 CACHE_NODES_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method bufpool_show = {
+	.name = "ShowBufferPool",
+	.method = show_bufpool,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 BUFPOOL_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method drc_show = {
+	.name = "ShowDRC",
+	.method = show_drc,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 DRC_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_v3_io,
 	&export_show_v40_io,
@@ -1521,7 +1659,12 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_9p_io,
 	&global_show_total_ops,
 	&global_show_fast_ops,
+	&export_show_latency,
+	&global_show_latency,
 	&cache_inode_show,
+	&cache_inode_show_nodes,
+	&bufpool_show,
+	&drc_show,
 	NULL
 };
 
@@ -53,6 +53,7 @@
 #include <strings.h>
 #include <ctype.h>
 #include "export_mgr.h"
+#include "export_client_index.h"
 #include "fsal_up.h"
 
 struct global_export_perms export_opt = {
@@ -824,6 +825,9 @@ static int export_commit(void *node, void *link_mem, void *self_struct,
 	glist_init(&export->exp_nlm_share_list);
 	glist_init(&export->mounted_exports_list);
 
+	/* clients are all in, compile them for export_check_access */
+	export->client_index = client_index_build(&export->clients);
+
 	/* now probe the fsal and init it */
 	/* pass along the block that is/was the FS_Specific */
 	if (!insert_gsh_export(export)) {
@@ -1435,6 +1439,8 @@ static void FreeClientList(struct glist_head *clients)
 
 void free_export_resources(struct gsh_export *export)
 {
+	client_index_free(export->client_index);
+	export->client_index = NULL;
 	FreeClientList(&export->clients);
 	if (export->fsal_export != NULL) {
 		struct fsal_module *fsal = export->fsal_export->fsal;
@@ -1816,143 +1822,141 @@ static char *client_types[] = {
 	 };
 
 /**
- * @brief Match a specific option in the client export list
+ * @brief Match one IPv4 client against one entry of an export's list
  *
- * @param[in]  hostaddr      Host to search for
- * @param[in]  clients       Client list to search
- * @param[out] client_found Matching entry
- * @param[in]  export_option Option to search for
+ * @param[in] client   Client list entry
+ * @param[in] hostaddr Host to match
  *
- * @return true if found, false otherwise.
+ * @return true if the entry matches the host.
  */
-static exportlist_client_entry_t *client_match(sockaddr_t *hostaddr,
-					       struct gsh_export *export)
+static bool client_match_entry(exportlist_client_entry_t *client,
+			       sockaddr_t *hostaddr)
 {
-	struct glist_head *glist;
 	in_addr_t addr = get_in_addr(hostaddr);
 	int rc;
-	int ipvalid = -1;	/* -1 need to print, 0 - invalid, 1 - ok */
+	int ipvalid;
 	char hostname[MAXHOSTNAMELEN + 1];
 	char ipstring[SOCK_NAME_MAX + 1];
 
-	glist_for_each(glist, &export->clients) {
-		exportlist_client_entry_t *client;
-
-		client = glist_entry(glist, exportlist_client_entry_t,
-				     cle_list);
-		LogMidDebug(COMPONENT_EXPORT,
-			    "Match %p, type = %s, options 0x%X",
-			    client,
-			    client_types[client->type],
-			    client->client_perms.options);
-		LogClientListEntry(COMPONENT_EXPORT, client);
+	switch (client->type) {
+	case HOSTIF_CLIENT:
+		return client->client.hostif.clientaddr == addr;
 
-		switch (client->type) {
-		case HOSTIF_CLIENT:
-			if (client->client.hostif.clientaddr == addr)
-				return client;
-			break;
+	case NETWORK_CLIENT:
+		return (client->client.network.netmask & ntohl(addr)) ==
+		    client->client.network.netaddr;
 
-		case NETWORK_CLIENT:
-			if ((client->client.network.netmask & ntohl(addr)) ==
-			    client->client.network.netaddr)
-				return client;
-			break;
+	case NETGROUP_CLIENT:
+		/* Try to get the entry from th IP/name cache */
+		rc = nfs_ip_name_get(hostaddr, hostname, sizeof(hostname));
 
-		case NETGROUP_CLIENT:
-			/* Try to get the entry from th IP/name cache */
-			rc = nfs_ip_name_get(hostaddr, hostname,
-					     sizeof(hostname));
-
-			if (rc != IP_NAME_SUCCESS) {
-				if (rc == IP_NAME_NOT_FOUND) {
-					/* IPaddr was not cached, add it to the
-					 * cache
+		if (rc != IP_NAME_SUCCESS) {
+			if (rc == IP_NAME_NOT_FOUND) {
+				/* IPaddr was not cached, add it to the
+				 * cache
+				 */
+				if (nfs_ip_name_add(hostaddr,
+						    hostname,
+						    sizeof(hostname))
+				    != IP_NAME_SUCCESS) {
+					/* Major failure, name not
+					 * be resolved
 					 */
-					if (nfs_ip_name_add(hostaddr,
-							    hostname,
-							    sizeof(hostname))
-					    != IP_NAME_SUCCESS) {
-						/* Major failure, name not
-						 * be resolved
-						 */
-						break;
-					}
+					return false;
 				}
 			}
+		}
 
-			/* At this point 'hostname' should contain the
-			 * name that was found
-			 */
-			if (innetgr(client->client.netgroup.netgroupname,
-				    hostname, NULL, NULL) == 1) {
-				return client;
-			}
-			break;
+		/* At this point 'hostname' should contain the
+		 * name that was found
+		 */
+		return innetgr(client->client.netgroup.netgroupname,
+			       hostname, NULL, NULL) == 1;
 
-		case WILDCARDHOST_CLIENT:
-			/* Now checking for IP wildcards */
-			if (ipvalid < 0)
-				ipvalid = sprint_sockip(hostaddr,
-							ipstring,
-							sizeof(ipstring));
-
-			if (ipvalid &&
-			    (fnmatch(client->client.wildcard.wildcard,
-				     ipstring,
-				     FNM_PATHNAME) == 0)) {
-				return client;
-			}
+	case WILDCARDHOST_CLIENT:
+		/* Now checking for IP wildcards */
+		ipvalid = sprint_sockip(hostaddr, ipstring, sizeof(ipstring));
+
+		if (ipvalid &&
+		    (fnmatch(client->client.wildcard.wildcard,
+			     ipstring,
+			     FNM_PATHNAME) == 0)) {
+			return true;
+		}
 
-			/* Try to get the entry from th IP/name cache */
-			rc = nfs_ip_name_get(hostaddr, hostname,
-					     sizeof(hostname));
+		/* Try to get the entry from th IP/name cache */
+		rc = nfs_ip_name_get(hostaddr, hostname, sizeof(hostname));
 
-			if (rc != IP_NAME_SUCCESS) {
-				if (rc == IP_NAME_NOT_FOUND) {
-					/* IPaddr was not cached, add it to
-					 * the cache
+		if (rc != IP_NAME_SUCCESS) {
+			if (rc == IP_NAME_NOT_FOUND) {
+				/* IPaddr was not cached, add it to
+				 * the cache
+				 */
+				if (nfs_ip_name_add(hostaddr,
+						    hostname,
+						    sizeof(hostname))
+				    != IP_NAME_SUCCESS) {
+					/* Major failure, name could
+					 * not be resolved
 					 */
-					if (nfs_ip_name_add(hostaddr,
-							    hostname,
-							    sizeof(hostname))
-					    != IP_NAME_SUCCESS) {
-						/* Major failure, name could
-						 * not be resolved
-						 */
 /** @todo this change from 1.5 is not IPv6 useful.
  * come back to this and use the string from client mgr inside req_ctx...
  */
-						break;
-					}
+					return false;
 				}
 			}
-			/* At this point 'hostname' should contain the
-			 * name that was found
-			 */
-			if (fnmatch
-			    (client->client.wildcard.wildcard, hostname,
-			     FNM_PATHNAME) == 0) {
-				return client;
-			}
-			break;
+		}
+		/* At this point 'hostname' should contain the
+		 * name that was found
+		 */
+		return fnmatch(client->client.wildcard.wildcard, hostname,
+			       FNM_PATHNAME) == 0;
 
-		case GSSPRINCIPAL_CLIENT:
+	case GSSPRINCIPAL_CLIENT:
 	  /** @todo BUGAZOMEU a completer lors de l'integration de RPCSEC_GSS */
-			LogCrit(COMPONENT_EXPORT,
-				"Unsupported type GSS_PRINCIPAL_CLIENT");
-			break;
+		LogCrit(COMPONENT_EXPORT,
+			"Unsupported type GSS_PRINCIPAL_CLIENT");
+		return false;
 
-		case HOSTIF_CLIENT_V6:
-			break;
+	case MATCH_ANY_CLIENT:
+		return true;
 
-		case MATCH_ANY_CLIENT:
-			return client;
+	case HOSTIF_CLIENT_V6:
+	case BAD_CLIENT:
+	default:
+		return false;
+	}
+}
 
-		case BAD_CLIENT:
-		default:
-			continue;
-		}
+/**
+ * @brief Match a specific option in the client export list
+ *
+ * @param[in]  hostaddr      Host to search for
+ * @param[in]  clients       Client list to search
+ * @param[out] client_found Matching entry
+ * @param[in]  export_option Option to search for
+ *
+ * @return true if found, false otherwise.
+ */
+static exportlist_client_entry_t *client_match(sockaddr_t *hostaddr,
+					       struct gsh_export *export)
+{
+	struct glist_head *glist;
+
+	glist_for_each(glist, &export->clients) {
+		exportlist_client_entry_t *client;
+
+		client = glist_entry(glist, exportlist_client_entry_t,
+				     cle_list);
+		LogMidDebug(COMPONENT_EXPORT,
+			    "Match %p, type = %s, options 0x%X",
+			    client,
+			    client_types[client->type],
+			    client->client_perms.options);
+		LogClientListEntry(COMPONENT_EXPORT, client);
+
+		if (client_match_entry(client, hostaddr))
+			return client;
 	}
 
 	/* no export found for this option */
@@ -2021,6 +2025,16 @@ static exportlist_client_entry_t *client_matchv6(struct in6_addr *paddrv6,
 static exportlist_client_entry_t *client_match_any(sockaddr_t *hostaddr,
 						   struct gsh_export *export)
 {
+	if (export->client_index != NULL) {
+		exportlist_client_entry_t *client;
+
+		client = client_index_match(export->client_index, hostaddr,
+					    client_match_entry);
+		if (client != NULL)
+			LogClientListEntry(COMPONENT_EXPORT, client);
+		return client;
+	}
+
 	if (hostaddr->ss_family == AF_INET6) {
 		struct sockaddr_in6 *psockaddr_in6 =
 		    (struct sockaddr_in6 *)hostaddr;
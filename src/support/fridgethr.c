@@ -378,10 +378,12 @@ static bool fridgethr_freeze(struct fridgethr *fr,
 
 	/* rc would have been set in the while loop below */
 	if (((rc == ETIMEDOUT) && (fr->nthreads > fr->p.thr_min))
-	    || (fr->command == fridgethr_comm_stop)) {
+	    || (fr->command == fridgethr_comm_stop) || fe->retire) {
 		/* We do this here since we already have the fridge
 		   lock. */
 		--(fr->nthreads);
+		if (fe->retire)
+			--(fr->retiring);
 		glist_del(&fe->thread_link);
 		if ((fr->nthreads == 0) && (fr->command == fridgethr_comm_stop)
 		    && (fr->transitioning) && !fridgethr_deferredwork(fr)) {
@@ -1345,8 +1347,10 @@ int fridgethr_sync_command(struct fridgethr *fr, fridgethr_comm_t command,
 /**
  * @brief Return true if a looper function should return
  *
- * For the moment, this checks if we're in the middle of a state
- * transition.
+ * This checks if we're in the middle of a state transition, or if
+ * fridgethr_shrink wants a thread gone and this one is first to ask.
+ * A looper told to break for the latter exits instead of running its
+ * function again.
  *
  * @param[in] ctx The thread context
  *
@@ -1363,11 +1367,85 @@ bool fridgethr_you_should_break(struct fridgethr_context *ctx)
 	bool rc;
 
 	PTHREAD_MUTEX_lock(&fr->mtx);
-	rc = fr->transitioning;
+	if (!fe->retire && fr->retire_req > 0) {
+		--(fr->retire_req);
+		++(fr->retiring);
+		fe->retire = true;
+	}
+	rc = fr->transitioning || fe->retire;
 	PTHREAD_MUTEX_unlock(&fr->mtx);
 	return rc;
 }
 
+/**
+ * @brief Start one more thread running func
+ *
+ * @note This function must be called with the fridge mutex held and
+ * leaves it held.
+ *
+ * @param[in,out] fr   Fridge to add the thread to
+ * @param[in]     func Function the thread should run
+ * @param[in]     arg  Argument supplied for that function
+ *
+ * @return 0 or POSIX error codes.
+ */
+
+static int fridgethr_add_looper(struct fridgethr *fr,
+				void (*func) (struct fridgethr_context *),
+				void *arg)
+{
+	struct fridgethr_entry *fe = NULL;
+	int rc = 0;
+
+	fe = gsh_calloc(sizeof(struct fridgethr_entry), 1);
+	if (fe == NULL)
+		return ENOMEM;
+
+	fe->fr = fr;
+	rc = pthread_mutex_init(&fe->ctx.mtx, NULL);
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Unable to initialize mutex for new thread "
+			 "in fridge %s: %d", fr->s, rc);
+		goto free_fe;
+	}
+	rc = pthread_cond_init(&fe->ctx.cv, NULL);
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Unable to initialize condition variable "
+			 "for new thread in fridge %s: %d", fr->s, rc);
+		goto destroy_mtx;
+	}
+
+	fe->ctx.func = func;
+	fe->ctx.arg = arg;
+	fe->frozen = false;
+
+	/* Make a new thread */
+	++(fr->nthreads);
+	glist_add_tail(&fr->thread_list, &fe->thread_link);
+
+	rc = pthread_create(&fe->ctx.id, &fr->attr,
+			    fridgethr_start_routine, fe);
+	if (rc != 0) {
+		LogMajor(COMPONENT_THREAD,
+			 "Unable to create new thread "
+			 "in fridge %s: %d", fr->s, rc);
+		--(fr->nthreads);
+		glist_del(&fe->thread_link);
+		pthread_cond_destroy(&fe->ctx.cv);
+		goto destroy_mtx;
+	}
+
+	return 0;
+
+ destroy_mtx:
+	pthread_mutex_destroy(&fe->ctx.mtx);
+ free_fe:
+	gsh_free(fe);
+	return rc;
+}
+
 /**
  * @brief Populate a fridge with threads all running the same thing
  *
@@ -1400,55 +1478,115 @@ int fridgethr_populate(struct fridgethr *fr,
 	}
 
 	for (i = 0; i < threads_to_run; ++i) {
-		struct fridgethr_entry *fe = NULL;
-		int rc = 0;
+		int rc = fridgethr_add_looper(fr, func, arg);
 
-		fe = gsh_calloc(sizeof(struct fridgethr_entry), 1);
-		if (fe == NULL) {
+		if (rc != 0) {
 			PTHREAD_MUTEX_unlock(&fr->mtx);
-			return ENOMEM;
+			return rc;
 		}
+	}
+	PTHREAD_MUTEX_unlock(&fr->mtx);
 
-		/* Make a new thread */
-		++(fr->nthreads);
+	return 0;
+}
 
-		glist_add_tail(&fr->thread_list, &fe->thread_link);
+/**
+ * @brief Add threads to a populated fridge
+ *
+ * Threads fridgethr_shrink asked to leave that have not yet done so
+ * are kept first, then new ones started running func, never going
+ * beyond thr_max.
+ *
+ * @param[in,out] fr   Fridge to grow
+ * @param[in]     func Function each new thread should run
+ * @param[in]     arg  Argument supplied for that function
+ * @param[in]     n    Threads wanted
+ *
+ * @retval 0 on success, even if thr_max allowed fewer than n.
+ * @retval Other codes from thread creation.
+ */
 
-		fe->fr = fr;
-		rc = pthread_mutex_init(&fe->ctx.mtx, NULL);
-		if (rc != 0) {
-			LogMajor(COMPONENT_THREAD,
-				 "Unable to initialize mutex for new thread "
-				 "in fridge %s: %d", fr->s, rc);
-			PTHREAD_MUTEX_unlock(&fr->mtx);
-			return rc;
-		}
-		rc = pthread_cond_init(&fe->ctx.cv, NULL);
-		if (rc != 0) {
-			LogMajor(COMPONENT_THREAD,
-				 "Unable to initialize condition variable "
-				 "for new thread in fridge %s: %d", fr->s, rc);
-			PTHREAD_MUTEX_unlock(&fr->mtx);
-			return rc;
-		}
+int fridgethr_grow(struct fridgethr *fr,
+		   void (*func) (struct fridgethr_context *), void *arg,
+		   uint32_t n)
+{
+	uint32_t live;
+	int rc = 0;
 
-		fe->ctx.func = func;
-		fe->ctx.arg = arg;
-		fe->frozen = false;
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	if (fr->command != fridgethr_comm_run || fr->transitioning) {
+		PTHREAD_MUTEX_unlock(&fr->mtx);
+		return 0;
+	}
 
-		rc = pthread_create(&fe->ctx.id, &fr->attr,
-				    fridgethr_start_routine, fe);
-		if (rc != 0) {
-			LogMajor(COMPONENT_THREAD,
-				 "Unable to create new thread "
-				 "in fridge %s: %d", fr->s, rc);
-			PTHREAD_MUTEX_unlock(&fr->mtx);
-			return rc;
-		}
+	while (n > 0 && fr->retire_req > 0) {
+		--(fr->retire_req);
+		--n;
+	}
+
+	live = fr->nthreads - fr->retire_req - fr->retiring;
+	for (; n > 0 && (fr->p.thr_max == 0 || live < fr->p.thr_max);
+	     --n, ++live) {
+		rc = fridgethr_add_looper(fr, func, arg);
+		if (rc != 0)
+			break;
 	}
 	PTHREAD_MUTEX_unlock(&fr->mtx);
 
-	return 0;
+	return rc;
+}
+
+/**
+ * @brief Ask threads of a looper fridge to exit
+ *
+ * The threads leave the next time they call
+ * fridgethr_you_should_break, so the function they loop in must call
+ * it often, and wake_threads is called to hurry along any waiting
+ * for work.  The fridge never goes below thr_min.
+ *
+ * @param[in,out] fr Fridge to shrink
+ * @param[in]     n  Threads to lose
+ *
+ * @return The number of threads asked to leave.
+ */
+
+uint32_t fridgethr_shrink(struct fridgethr *fr, uint32_t n)
+{
+	uint32_t live;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	live = fr->nthreads - fr->retire_req - fr->retiring;
+	if (live <= fr->p.thr_min)
+		n = 0;
+	else if (n > live - fr->p.thr_min)
+		n = live - fr->p.thr_min;
+	fr->retire_req += n;
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+
+	/* Threads waiting for work on their own only look when woken */
+	if (n > 0 && fr->p.wake_threads != NULL)
+		fr->p.wake_threads(fr->p.wake_threads_arg);
+
+	return n;
+}
+
+/**
+ * @brief Number of threads in a fridge not on their way out
+ *
+ * @param[in] fr The fridge
+ *
+ * @return The thread count.
+ */
+
+uint32_t fridgethr_nthreads(struct fridgethr *fr)
+{
+	uint32_t live;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	live = fr->nthreads - fr->retire_req - fr->retiring;
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+
+	return live;
 }
 
 /**
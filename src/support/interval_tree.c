@@ -0,0 +1,288 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file interval_tree.c
+ * @brief Augmented AVL tree of closed 64-bit intervals
+ *
+ * Every insert and remove rebalances and recomputes max_end on the
+ * whole path to the root, which is O(log n) either way and keeps the
+ * augmentation trivially right across rotations.
+ */
+
+#include "config.h"
+
+#include "interval_tree.h"
+
+static inline int itree_height(const struct itree_node *node)
+{
+	return node != NULL ? node->height : 0;
+}
+
+/* Recompute height and max_end of node from its children */
+static inline void itree_update(struct itree_node *node)
+{
+	int hl = itree_height(node->left);
+	int hr = itree_height(node->right);
+
+	node->height = 1 + (hl > hr ? hl : hr);
+	node->max_end = node->end;
+	if (node->left != NULL && node->left->max_end > node->max_end)
+		node->max_end = node->left->max_end;
+	if (node->right != NULL && node->right->max_end > node->max_end)
+		node->max_end = node->right->max_end;
+}
+
+/* Point the link to old in parent (or the root) at new */
+static inline void itree_replace_child(struct itree *tree,
+				       struct itree_node *parent,
+				       struct itree_node *old,
+				       struct itree_node *new)
+{
+	if (parent == NULL)
+		tree->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+
+	if (new != NULL)
+		new->parent = parent;
+}
+
+static struct itree_node *itree_rotate_left(struct itree *tree,
+					    struct itree_node *x)
+{
+	struct itree_node *y = x->right;
+
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	itree_replace_child(tree, x->parent, x, y);
+	y->left = x;
+	x->parent = y;
+	itree_update(x);
+	itree_update(y);
+	return y;
+}
+
+static struct itree_node *itree_rotate_right(struct itree *tree,
+					     struct itree_node *x)
+{
+	struct itree_node *y = x->left;
+
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	itree_replace_child(tree, x->parent, x, y);
+	y->right = x;
+	x->parent = y;
+	itree_update(x);
+	itree_update(y);
+	return y;
+}
+
+/**
+ * @brief Restore balance and augmentation from node up to the root
+ *
+ * @param[in,out] tree The tree
+ * @param[in]     node Lowest node whose subtree changed, may be NULL
+ */
+
+static void itree_fixup(struct itree *tree, struct itree_node *node)
+{
+	int balance;
+
+	while (node != NULL) {
+		itree_update(node);
+		balance = itree_height(node->left) - itree_height(node->right);
+
+		if (balance > 1) {
+			if (itree_height(node->left->left) <
+			    itree_height(node->left->right))
+				(void)itree_rotate_left(tree, node->left);
+			node = itree_rotate_right(tree, node);
+		} else if (balance < -1) {
+			if (itree_height(node->right->right) <
+			    itree_height(node->right->left))
+				(void)itree_rotate_right(tree, node->right);
+			node = itree_rotate_left(tree, node);
+		}
+
+		node = node->parent;
+	}
+}
+
+/**
+ * @brief Add a node to a tree
+ *
+ * @param[in,out] tree The tree
+ * @param[in,out] node The node, with start and end set
+ */
+
+void itree_insert(struct itree *tree, struct itree_node *node)
+{
+	struct itree_node *parent = NULL;
+	struct itree_node **link = &tree->root;
+
+	while (*link != NULL) {
+		parent = *link;
+		link = node->start < parent->start ? &parent->left
+						   : &parent->right;
+	}
+
+	node->left = NULL;
+	node->right = NULL;
+	node->parent = parent;
+	node->height = 1;
+	node->max_end = node->end;
+	*link = node;
+	tree->size++;
+
+	itree_fixup(tree, parent);
+}
+
+/**
+ * @brief Take a node out of its tree
+ *
+ * @param[in,out] tree The tree
+ * @param[in,out] node The node
+ */
+
+void itree_remove(struct itree *tree, struct itree_node *node)
+{
+	struct itree_node *fix;
+
+	if (node->left != NULL && node->right != NULL) {
+		/* Put the in-order successor in node's place */
+		struct itree_node *succ = node->right;
+
+		while (succ->left != NULL)
+			succ = succ->left;
+
+		if (succ->parent != node) {
+			fix = succ->parent;
+			fix->left = succ->right;
+			if (succ->right != NULL)
+				succ->right->parent = fix;
+			succ->right = node->right;
+			node->right->parent = succ;
+		} else {
+			fix = succ;
+		}
+
+		succ->left = node->left;
+		node->left->parent = succ;
+		itree_replace_child(tree, node->parent, node, succ);
+	} else {
+		fix = node->parent;
+		itree_replace_child(tree, fix, node,
+				    node->left != NULL ? node->left
+						       : node->right);
+	}
+
+	node->left = NULL;
+	node->right = NULL;
+	node->parent = NULL;
+	node->height = 0;
+	tree->size--;
+
+	itree_fixup(tree, fix);
+}
+
+/**
+ * @brief Find the leftmost node of a subtree overlapping [start, end]
+ */
+
+static struct itree_node *itree_subtree_search(struct itree_node *node,
+					       uint64_t start, uint64_t end)
+{
+	while (true) {
+		if (node->left != NULL && start <= node->left->max_end) {
+			/* Something on the left ends late enough, and
+			 * starts no later than node does. */
+			node = node->left;
+			continue;
+		}
+		if (node->start > end)
+			return NULL;
+		if (start <= node->end)
+			return node;
+		node = node->right;
+		if (node == NULL || start > node->max_end)
+			return NULL;
+	}
+}
+
+/**
+ * @brief Find the first node, in start order, overlapping [start, end]
+ *
+ * @param[in] tree  The tree
+ * @param[in] start First offset of the range
+ * @param[in] end   Last offset of the range, inclusive
+ *
+ * @return The node or NULL.
+ */
+
+struct itree_node *itree_first_overlap(const struct itree *tree,
+				       uint64_t start, uint64_t end)
+{
+	if (tree->root == NULL || start > tree->root->max_end)
+		return NULL;
+
+	return itree_subtree_search(tree->root, start, end);
+}
+
+/**
+ * @brief Find the next node, in start order, overlapping [start, end]
+ *
+ * @param[in] node  A node overlapping the range
+ * @param[in] start First offset of the range
+ * @param[in] end   Last offset of the range, inclusive
+ *
+ * @return The node or NULL.
+ */
+
+struct itree_node *itree_next_overlap(const struct itree_node *node,
+				      uint64_t start, uint64_t end)
+{
+	struct itree_node *right = node->right;
+	const struct itree_node *prev;
+
+	while (true) {
+		if (right != NULL && start <= right->max_end)
+			return itree_subtree_search(right, start, end);
+
+		/* Climb until we come up from a left child */
+		do {
+			prev = node;
+			node = node->parent;
+			if (node == NULL)
+				return NULL;
+			right = node->right;
+		} while (prev == right);
+
+		if (node->start > end)
+			return NULL;
+		if (start <= node->end)
+			return (struct itree_node *)node;
+	}
+}
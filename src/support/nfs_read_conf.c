@@ -52,6 +52,7 @@
 #include "nfs_exports.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "nfs_req_queue.h"
 #include "config_parsing.h"
 
 /**
@@ -64,6 +65,12 @@ static struct config_item_list protocols[] = {
 	CONFIG_LIST_EOL
 };
 
+static struct config_item_list queue_modes[] = {
+	CONFIG_LIST_TOK("LIFO", REQ_Q_MODE_LIFO),
+	CONFIG_LIST_TOK("Sharded", REQ_Q_MODE_SHARDED),
+	CONFIG_LIST_EOL
+};
+
 static struct config_item core_params[] = {
 	CONF_ITEM_UI16("NFS_Port", 0, UINT16_MAX, NFS_PORT,
 		       nfs_core_param, port[P_NFS]),
@@ -85,6 +92,15 @@ static struct config_item core_params[] = {
 		       nfs_core_param, program[P_RQUOTA]),
 	CONF_ITEM_UI32("Nb_Worker", 1, 1024*128, NB_WORKER_THREAD_DEFAULT,
 		       nfs_core_param, nb_worker),
+	CONF_ITEM_UI32("Min_Worker", 0, 1024*128, 0,
+		       nfs_core_param, min_worker),
+	CONF_ITEM_UI32("Max_Worker", 0, 1024*128, 0,
+		       nfs_core_param, max_worker),
+	CONF_ITEM_UI32("Worker_Qwait_Target", 1, 10000000,
+		       WORKER_QWAIT_TARGET_DEFAULT,
+		       nfs_core_param, worker_qwait_target),
+	CONF_ITEM_BOOL("Worker_NUMA_Bind", false,
+		       nfs_core_param, worker_numa_bind),
 	CONF_ITEM_BOOL("Drop_IO_Errors", false,
 		       nfs_core_param, drop_io_errors),
 	CONF_ITEM_BOOL("Drop_Inval_Errors", false,
@@ -95,6 +111,10 @@ static struct config_item core_params[] = {
 		       nfs_core_param, dispatch_max_reqs),
 	CONF_ITEM_UI32("Dispatch_Max_Reqs_Xprt", 1, 2048, 512,
 		       nfs_core_param, dispatch_max_reqs_xprt),
+	CONF_ITEM_ENUM("Dispatch_Queue_Mode", REQ_Q_MODE_LIFO, queue_modes,
+		       nfs_core_param, dispatch_queue_mode),
+	CONF_ITEM_UI32("Dispatch_Shard_Size", 16, 65536, 1024,
+		       nfs_core_param, dispatch_shard_size),
 	CONF_ITEM_BOOL("DRC_Disabled", false,
 		       nfs_core_param, drc.disabled),
 	CONF_ITEM_UI32("DRC_TCP_Npart", 1, 20, DRC_TCP_NPART,
@@ -121,6 +141,10 @@ static struct config_item core_params[] = {
 		       nfs_core_param, drc.udp.hiwat),
 	CONF_ITEM_BOOL("DRC_UDP_Checksum", DRC_UDP_CHECKSUM,
 		       nfs_core_param, drc.udp.checksum),
+	CONF_ITEM_UI64("DRC_Memory_Budget", 0, UINT64_MAX, DRC_MEMORY_BUDGET,
+		       nfs_core_param, drc.memory_budget),
+	CONF_ITEM_UI32("DRC_Retire_Window_S", 0, 60*60, DRC_RETIRE_WINDOW_S,
+		       nfs_core_param, drc.retire_window_s),
 	CONF_ITEM_UI32("RPC_Debug_Flags", 0, UINT32_MAX, TIRPC_DEBUG_FLAGS,
 		       nfs_core_param, rpc.debug_flags),
 	CONF_ITEM_UI32("RPC_Max_Connections", 1, 10000, 1024,
@@ -155,6 +179,11 @@ static struct config_item core_params[] = {
 			nfs_core_param, manage_gids_expiration),
 	CONF_ITEM_PATH("Plugins_Dir", 1, MAXPATHLEN, FSAL_MODULE_LOC,
 		       nfs_core_param, ganesha_modules_loc),
+	CONF_ITEM_PATH("Trace_Directory", 1, MAXPATHLEN, NULL,
+		       nfs_core_param, trace_dir),
+	CONF_ITEM_UI32("Trace_Records", 1024, 16 * 1024 * 1024,
+		       TRACE_RECORDS_DEFAULT,
+		       nfs_core_param, trace_records),
 	CONFIG_EOL
 };
 
@@ -202,6 +231,12 @@ struct config_block krb5_param = {
 #define GETPWNAMDEF true
 #endif
 
+static struct config_item_list recovery_backends[] = {
+	CONFIG_LIST_TOK("fs", RECOVERY_BACKEND_FS),
+	CONFIG_LIST_TOK("db", RECOVERY_BACKEND_DB),
+	CONFIG_LIST_EOL
+};
+
 /**
  * @brief NFSv4 specific parameters
  */
@@ -225,6 +260,18 @@ static struct config_item version4_params[] = {
 		       nfs_version4_parameter, allow_numeric_owners),
 	CONF_ITEM_BOOL("Delegations", false,
 		       nfs_version4_parameter, allow_delegations),
+	CONF_ITEM_UI32("Idmap_Cache_TTL", 0, 86400, IDMAP_CACHE_TTL_DEFAULT,
+		       nfs_version4_parameter, idmap_cache_ttl),
+	CONF_ITEM_UI32("Idmap_Negative_TTL", 0, 86400,
+		       IDMAP_NEGATIVE_TTL_DEFAULT,
+		       nfs_version4_parameter, idmap_negative_ttl),
+	CONF_ITEM_BOOL("Idmap_Preload", false,
+		       nfs_version4_parameter, idmap_preload),
+	CONF_ITEM_ENUM("Recovery_Backend", RECOVERY_BACKEND_FS,
+		       recovery_backends, nfs_version4_parameter,
+		       recovery_backend),
+	CONF_ITEM_BOOL("Early_Grace_Exit", false,
+		       nfs_version4_parameter, early_grace_exit),
 	CONFIG_EOL
 };
 
@@ -0,0 +1,334 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file nfs_trace.c
+ * @brief Binary per-request event tracer
+ *
+ * Each thread that records an event gets its own ring file,
+ * ganesha-<pid>-<n>.trace, mapped shared so that the records reach
+ * the file without any system call on the request path and survive
+ * a crash.  Only the owning thread writes a ring, so nothing is
+ * locked.  Request ids are the ring number of the decoding thread in
+ * the top bits and a per-ring sequence below, which keeps them unique
+ * without a shared counter.
+ *
+ * When a thread exits its ring is kept mapped on a free list and
+ * handed, with its number, file and sequence, to the next thread that
+ * needs one.  The number of files is thus bounded by the most threads
+ * ever tracing at once, however much the worker pool churns.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "log.h"
+#include "abstract_atomic.h"
+#include "common_utils.h"
+#include "nfs_core.h"
+#include "export_mgr.h"
+#include "nfs_trace.h"
+
+/* Bits of a request id holding the per-ring sequence */
+#define NFS_TRACE_SEQ_BITS 40
+
+/**
+ * @brief A thread's ring file
+ */
+
+struct nfs_trace_ring {
+	struct nfs_trace_hdr *hdr;	/*< Mapped file */
+	struct nfs_trace_rec *recs;	/*< Records following hdr */
+	size_t map_len;		/*< Length of the mapping */
+	uint64_t index;		/*< Ring number */
+	uint64_t seq;		/*< Last request id sequence */
+	struct nfs_trace_ring *next;	/*< On the free list */
+};
+
+bool nfs_trace_enabled;
+
+static uint32_t nfs_trace_rings;
+/* Rings of exited threads, for reuse */
+static struct nfs_trace_ring *nfs_trace_free;
+static pthread_mutex_t nfs_trace_free_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t nfs_trace_key;
+static __thread struct nfs_trace_ring *nfs_trace_my_ring;
+/* Set once a thread failed to map its ring, so it stops trying */
+static __thread bool nfs_trace_failed;
+
+static void nfs_trace_release(void *arg)
+{
+	struct nfs_trace_ring *ring = arg;
+
+	nfs_trace_my_ring = NULL;
+	pthread_mutex_lock(&nfs_trace_free_mtx);
+	ring->next = nfs_trace_free;
+	nfs_trace_free = ring;
+	pthread_mutex_unlock(&nfs_trace_free_mtx);
+}
+
+/**
+ * @brief Hand this thread the ring of an exited one, if any
+ */
+
+static struct nfs_trace_ring *nfs_trace_ring_reuse(void)
+{
+	struct nfs_trace_ring *ring;
+
+	pthread_mutex_lock(&nfs_trace_free_mtx);
+	ring = nfs_trace_free;
+	if (ring != NULL)
+		nfs_trace_free = ring->next;
+	pthread_mutex_unlock(&nfs_trace_free_mtx);
+
+	if (ring == NULL)
+		return NULL;
+
+	ring->next = NULL;
+	memset(ring->hdr->thread, 0, sizeof(ring->hdr->thread));
+	(void)pthread_getname_np(pthread_self(), ring->hdr->thread,
+				 sizeof(ring->hdr->thread));
+	(void)pthread_setspecific(nfs_trace_key, ring);
+	nfs_trace_my_ring = ring;
+	return ring;
+}
+
+/**
+ * @brief Start tracing if Trace_Directory is set
+ *
+ * @return false if tracing was asked for but cannot be done.
+ */
+
+bool nfs_trace_init(void)
+{
+	int rc;
+
+	if (nfs_param.core_param.trace_dir == NULL)
+		return true;
+
+	if (access(nfs_param.core_param.trace_dir, W_OK | X_OK) != 0) {
+		LogCrit(COMPONENT_INIT, "Trace directory %s: %s",
+			nfs_param.core_param.trace_dir, strerror(errno));
+		return false;
+	}
+
+	rc = pthread_key_create(&nfs_trace_key, nfs_trace_release);
+	if (rc != 0) {
+		LogCrit(COMPONENT_INIT, "Could not create trace key: %s",
+			strerror(rc));
+		return false;
+	}
+
+	nfs_trace_enabled = true;
+	LogEvent(COMPONENT_INIT,
+		 "Tracing requests to %s, %u records per thread",
+		 nfs_param.core_param.trace_dir,
+		 nfs_param.core_param.trace_records);
+	return true;
+}
+
+static struct nfs_trace_ring *nfs_trace_ring_get(void)
+{
+	struct nfs_trace_ring *ring = nfs_trace_my_ring;
+	char path[MAXPATHLEN];
+	uint32_t nrecs = nfs_param.core_param.trace_records;
+	void *map;
+	int fd;
+
+	if (likely(ring != NULL) || nfs_trace_failed)
+		return ring;
+
+	ring = nfs_trace_ring_reuse();
+	if (ring != NULL)
+		return ring;
+
+	ring = gsh_calloc(1, sizeof(struct nfs_trace_ring));
+	if (ring == NULL)
+		goto fail;
+
+	ring->index = atomic_inc_uint32_t(&nfs_trace_rings);
+	ring->map_len = sizeof(struct nfs_trace_hdr) +
+	    (size_t)nrecs * sizeof(struct nfs_trace_rec);
+	snprintf(path, sizeof(path), "%s/ganesha-%d-%" PRIu64 ".trace",
+		 nfs_param.core_param.trace_dir, (int)getpid(), ring->index);
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		LogWarn(COMPONENT_DISPATCH, "Could not create %s: %s", path,
+			strerror(errno));
+		goto fail;
+	}
+	if (ftruncate(fd, ring->map_len) != 0) {
+		LogWarn(COMPONENT_DISPATCH, "Could not size %s: %s", path,
+			strerror(errno));
+		(void)close(fd);
+		goto fail;
+	}
+	map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	(void)close(fd);
+	if (map == MAP_FAILED) {
+		LogWarn(COMPONENT_DISPATCH, "Could not map %s: %s", path,
+			strerror(errno));
+		goto fail;
+	}
+
+	ring->hdr = map;
+	ring->recs = (struct nfs_trace_rec *)(ring->hdr + 1);
+	ring->hdr->magic = NFS_TRACE_MAGIC;
+	ring->hdr->version = NFS_TRACE_VERSION;
+	ring->hdr->rec_size = sizeof(struct nfs_trace_rec);
+	ring->hdr->nrecs = nrecs;
+	ring->hdr->pid = getpid();
+	ring->hdr->boot_sec = ServerBootTime.tv_sec;
+	ring->hdr->boot_nsec = ServerBootTime.tv_nsec;
+	(void)pthread_getname_np(pthread_self(), ring->hdr->thread,
+				 sizeof(ring->hdr->thread));
+
+	(void)pthread_setspecific(nfs_trace_key, ring);
+	nfs_trace_my_ring = ring;
+	return ring;
+
+ fail:
+	gsh_free(ring);
+	nfs_trace_failed = true;
+	return NULL;
+}
+
+/**
+ * @brief Allocate an id for a new request
+ *
+ * @return The id, or 0 if the request cannot be traced.
+ */
+
+uint64_t nfs_trace_new_id(void)
+{
+	struct nfs_trace_ring *ring = nfs_trace_ring_get();
+
+	if (ring == NULL)
+		return 0;
+
+	return (ring->index << NFS_TRACE_SEQ_BITS) | ++ring->seq;
+}
+
+/**
+ * @brief Append an event to this thread's ring
+ *
+ * The record comes back with id, ts, event and op set and the rest
+ * zeroed, for the caller to fill in.
+ *
+ * @param[in] id    Request id
+ * @param[in] event What happened
+ * @param[in] op    RPC procedure or FSAL operation
+ *
+ * @return The record, or NULL if this thread has no ring.
+ */
+
+struct nfs_trace_rec *nfs_trace_emit(uint64_t id, enum nfs_trace_event event,
+				     uint16_t op)
+{
+	struct nfs_trace_ring *ring = nfs_trace_ring_get();
+	struct nfs_trace_rec *rec;
+	struct timespec ts;
+	uint64_t head;
+
+	if (unlikely(ring == NULL))
+		return NULL;
+
+	now(&ts);
+	head = ring->hdr->head;
+	rec = &ring->recs[head % ring->hdr->nrecs];
+	memset(rec, 0, sizeof(*rec));
+	rec->id = id;
+	rec->ts = timespec_diff(&ServerBootTime, &ts);
+	rec->event = event;
+	rec->op = op;
+	atomic_store_uint64_t(&ring->hdr->head, head + 1);
+
+	return rec;
+}
+
+/**
+ * @brief Give a decoded request an id and record its DECODE event
+ *
+ * @param[in,out] req The request
+ */
+
+void nfs_trace_decode(struct request_data *req)
+{
+	nfs_request_data_t *reqnfs = req->r_u.nfs;
+	struct nfs_trace_rec *rec;
+	sockaddr_t addr;
+
+	req->trace_id = nfs_trace_new_id();
+	if (req->trace_id == 0)
+		return;
+
+	rec = nfs_trace_emit(req->trace_id, NFS_TRACE_DECODE,
+			     reqnfs->req.rq_proc);
+	if (rec == NULL)
+		return;
+
+	rec->xid = reqnfs->req.rq_xid;
+	rec->prog = reqnfs->req.rq_prog;
+	rec->vers = reqnfs->req.rq_vers;
+
+	if (!copy_xprt_addr(&addr, reqnfs->xprt))
+		return;
+
+	rec->family = addr.ss_family;
+	if (addr.ss_family == AF_INET) {
+		struct sockaddr_in *sin = (struct sockaddr_in *)&addr;
+
+		memcpy(rec->addr, &sin->sin_addr, sizeof(sin->sin_addr));
+		rec->port = ntohs(sin->sin_port);
+	} else if (addr.ss_family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&addr;
+
+		memcpy(rec->addr, &sin6->sin6_addr, sizeof(sin6->sin6_addr));
+		rec->port = ntohs(sin6->sin6_port);
+	}
+}
+
+/**
+ * @brief Record the ENCODE event of a request about to be answered
+ *
+ * @param[in] req The request
+ */
+
+void nfs_trace_encode(struct request_data *req)
+{
+	struct nfs_trace_rec *rec;
+
+	rec = nfs_trace_emit(req->trace_id, NFS_TRACE_ENCODE,
+			     req->r_u.nfs->req.rq_proc);
+	if (rec != NULL && op_ctx != NULL && op_ctx->export != NULL)
+		rec->export_id = op_ctx->export->export_id;
+}
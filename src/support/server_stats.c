@@ -37,14 +37,20 @@
  * @brief FSAL module manager
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		/* sched_getcpu */
+#endif
+
 #include "config.h"
 
 #include <time.h>
 #include <unistd.h>
+#include <string.h>
 #include <sys/types.h>
 #include <stdint.h>
 #include <sys/param.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 #include <arpa/inet.h>
 #include "fsal.h"
@@ -58,7 +64,11 @@
 #include "client_mgr.h"
 #include "export_mgr.h"
 #include "server_stats.h"
+#include "cache_inode_lru.h"
+#include "gsh_bufpool.h"
+#include "nfs_dupreq.h"
 #include <abstract_atomic.h>
+#include "gsh_intrinsic.h"
 
 #define NFS_V3_NB_COMMAND (NFSPROC3_COMMIT + 1)
 #define NFS_V4_NB_COMMAND 2
@@ -262,6 +272,55 @@ struct op_latency {
 	uint64_t max;
 };
 
+/* latency histograms
+ *
+ * Log bucketed, HDR style: each power of two nanoseconds from
+ * 2^LAT_HIST_MIN_SHIFT (~1us) to 2^LAT_HIST_MAX_SHIFT (~68s) is split
+ * into LAT_HIST_SUB linear sub-buckets, so a bucket bound is never
+ * more than 25% above the values counted in it.  Bucket 0 takes
+ * everything faster than ~1us, the last bucket everything slower
+ * than ~68s.
+ */
+
+#define LAT_HIST_SUB_BITS 2
+#define LAT_HIST_SUB (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MIN_SHIFT 10
+#define LAT_HIST_MAX_SHIFT 36
+#define LAT_HIST_BUCKETS \
+	((LAT_HIST_MAX_SHIFT - LAT_HIST_MIN_SHIFT) * LAT_HIST_SUB + 2)
+
+#define LAT_HIST_NPCT 3	/* p50, p99, p999 */
+
+struct lat_hist {
+	uint64_t bucket[LAT_HIST_BUCKETS];
+};
+
+/* service and queue wait distributions of a proto op
+ */
+struct op_hist {
+	struct lat_hist latency;	/* executed ops latency distribution */
+	struct lat_hist queue;	/* queue wait distribution */
+};
+
+/* the histograms of a protocol
+ *
+ * Indexed by HIST_OP_*: the ops (or compounds), read and write,
+ * except for MNT (v1, v3) and RQUOTA (plain, ext).
+ */
+
+#define HIST_OP_CMDS 0
+#define HIST_OP_READ 1
+#define HIST_OP_WRITE 2
+#define HIST_OP_MNT_V1 0
+#define HIST_OP_MNT_V3 1
+#define HIST_OP_RQUOTA 0
+#define HIST_OP_RQUOTA_EXT 1
+#define PROTO_HIST_OPS 3
+
+struct proto_hists {
+	struct op_hist op[PROTO_HIST_OPS];
+};
+
 /* v3 ops
  */
 struct nfsv3_ops {
@@ -403,7 +462,34 @@ struct global_stats {
 	struct qta_ops qt;
 };
 
-static struct global_stats global_st;
+/* Stats slots
+ *
+ * Every counter bumped on the request path lives in stats_nslots
+ * copies instead of one, so that workers on different cpus do not
+ * bounce the same cache lines.  Updates go to the slot of the cpu
+ * the thread runs on; the DBus readers fold the slots together.
+ * There is a slot per cpu up to STATS_MAX_SLOTS, beyond which cpus
+ * share slots, since every active export and client carries one copy
+ * per slot.  Threads can migrate and cpus share slots, so the
+ * counters are still updated atomically, just rarely contended.
+ *
+ * Per-slot arrays are allocated cache line aligned, with each slot
+ * rounded up to whole cache lines.
+ */
+
+#define STATS_MAX_SLOTS 32
+
+#define STATS_SLOT_SIZE(type) \
+	((sizeof(type) + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1))
+
+#define STATS_SLOT(base, type, idx) \
+	((type *)((char *)(base) + (idx) * STATS_SLOT_SIZE(type)))
+
+static uint32_t stats_nslots = 1;
+static uint32_t stats_next_slot;
+static __thread int32_t stats_slot = -1;
+
+static struct global_stats *global_st;
 
 struct cache_stats cache_st;
 struct cache_stats *cache_stp = &cache_st;
@@ -412,164 +498,297 @@ struct cache_stats *cache_stp = &cache_st;
  */
 #include "server_stats_private.h"
 
+/* global latency histograms
+ *
+ * One copy, not one per slot: they are large, and the samples of
+ * concurrent requests rarely land in the same bucket.
+ */
+
+struct global_hists {
+	struct proto_hists proto[HIST_PROTOS];
+	struct lat_hist v3[NFS_V3_NB_COMMAND];	/* per-op latency */
+	struct lat_hist v4[NFS_V42_NB_OPERATION];
+};
+
+static struct global_hists global_hist;
+
 /**
- * @brief Get stats struct helpers
+ * @brief Return the stats slot of the cpu we are running on
  *
- * These functions dereference the protocol specific struct
- * silently calloc the struct on first use.
+ * Without sched_getcpu a thread picks a slot round robin the first
+ * time it records and keeps it.
+ */
+
+static inline uint32_t get_stats_slot(void)
+{
+#ifdef LINUX
+	int cpu = sched_getcpu();
+
+	if (likely(cpu >= 0))
+		return (uint32_t)cpu % stats_nslots;
+#endif
+	if (unlikely(stats_slot < 0))
+		stats_slot = atomic_inc_uint32_t(&stats_next_slot) %
+		    stats_nslots;
+	return stats_slot;
+}
+
+/**
+ * @brief Allocate a zeroed per-slot array
  *
- * @param stats [IN] the stats structure to dereference in
- * @param lock  [IN] the lock in the stats owning struct
+ * @param slot_size [IN] STATS_SLOT_SIZE of the element type
  *
- * @return pointer to proto struct, NULL on OOM
+ * @return the array, NULL on OOM
+ */
+
+static void *alloc_stats_slots(size_t slot_size)
+{
+	size_t size = slot_size * stats_nslots;
+	void *slots = gsh_malloc_aligned(CACHE_LINE_SIZE, size);
+
+	if (slots != NULL)
+		memset(slots, 0, size);
+	return slots;
+}
+
+/**
+ * @brief Return this thread's slot of a per-slot array
  *
- * @TODO make them inlines for release
+ * The array is allocated on first use and published with a
+ * compare and swap, the loser of a race frees its copy.
+ *
+ * @param slotsp    [IN] where the array pointer lives
+ * @param slot_size [IN] STATS_SLOT_SIZE of the element type
+ *
+ * @return pointer to our slot, NULL on OOM
  */
 
-static struct nfsv3_stats *get_v3(struct gsh_stats *stats,
-				  pthread_rwlock_t *lock)
+static void *get_stats_slots(void **slotsp, size_t slot_size)
 {
-	if (unlikely(stats->nfsv3 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv3 == NULL)
-			stats->nfsv3 =
-			    gsh_calloc(sizeof(struct nfsv3_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
+	void *slots = atomic_fetch_voidptr(slotsp);
+
+	if (unlikely(slots == NULL)) {
+		void *new_slots = alloc_stats_slots(slot_size);
+
+		if (new_slots == NULL)
+			return NULL;
+		if (atomic_cas_voidptr(slotsp, NULL, new_slots)) {
+			slots = new_slots;
+		} else {
+			gsh_free(new_slots);
+			slots = atomic_fetch_voidptr(slotsp);
+		}
 	}
-	return stats->nfsv3;
+	return (char *)slots + get_stats_slot() * slot_size;
 }
 
-static struct mnt_stats *get_mnt(struct gsh_stats *stats,
-				 pthread_rwlock_t *lock)
+/**
+ * @brief Return one histogram pair of a protocol
+ *
+ * The protocol's histograms are allocated on first use and published
+ * like the per-slot arrays, but in a single copy.
+ *
+ * @param stats [IN] the stats structure to dereference in
+ * @param proto [IN] protocol
+ * @param op    [IN] HIST_OP_* index
+ *
+ * @return the histograms, NULL on OOM
+ */
+
+static struct op_hist *get_hist(struct gsh_stats *stats,
+				enum stats_hist_proto proto, int op)
 {
-	if (unlikely(stats->mnt == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->mnt == NULL)
-			stats->mnt = gsh_calloc(sizeof(struct mnt_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
+	void **histp = (void **)&stats->hist[proto];
+	struct proto_hists *hists = atomic_fetch_voidptr(histp);
+
+	if (unlikely(hists == NULL)) {
+		struct proto_hists *new_hists;
+
+		new_hists = gsh_calloc(1, sizeof(struct proto_hists));
+		if (new_hists == NULL)
+			return NULL;
+		if (atomic_cas_voidptr(histp, NULL, new_hists)) {
+			hists = new_hists;
+		} else {
+			gsh_free(new_hists);
+			hists = atomic_fetch_voidptr(histp);
+		}
 	}
-	return stats->mnt;
+	return &hists->op[op];
 }
 
-static struct nlmv4_stats *get_nlm4(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+#define GLOBAL_HIST(p, o) (&global_hist.proto[(p)].op[(o)])
+
+static inline struct global_stats *get_global(void)
 {
-	if (unlikely(stats->nlm4 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nlm4 == NULL)
-			stats->nlm4 = gsh_calloc(sizeof(struct nlmv4_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nlm4;
+	return STATS_SLOT(global_st, struct global_stats, get_stats_slot());
 }
 
-static struct rquota_stats *get_rquota(struct gsh_stats *stats,
-				       pthread_rwlock_t *lock)
+/**
+ * @brief Get stats struct helpers
+ *
+ * These functions dereference the protocol specific struct
+ * silently allocating its per-slot array on first use.
+ *
+ * @param stats [IN] the stats structure to dereference in
+ *
+ * @return pointer to this thread's slot of the proto struct,
+ *         NULL on OOM
+ */
+
+static struct nfsv3_stats *get_v3(struct gsh_stats *stats)
 {
-	if (unlikely(stats->rquota == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->rquota == NULL)
-			stats->rquota =
-			    gsh_calloc(sizeof(struct rquota_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->rquota;
+	return get_stats_slots((void **)&stats->nfsv3,
+			       STATS_SLOT_SIZE(struct nfsv3_stats));
 }
 
-static struct nfsv40_stats *get_v40(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static struct mnt_stats *get_mnt(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv40 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv40 == NULL)
-			stats->nfsv40 =
-			    gsh_calloc(sizeof(struct nfsv40_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv40;
+	return get_stats_slots((void **)&stats->mnt,
+			       STATS_SLOT_SIZE(struct mnt_stats));
 }
 
-static struct nfsv41_stats *get_v41(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static struct nlmv4_stats *get_nlm4(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv41 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv41 == NULL)
-			stats->nfsv41 =
-			    gsh_calloc(sizeof(struct nfsv41_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv41;
+	return get_stats_slots((void **)&stats->nlm4,
+			       STATS_SLOT_SIZE(struct nlmv4_stats));
 }
 
-static struct nfsv41_stats *get_v42(struct gsh_stats *stats,
-				    pthread_rwlock_t *lock)
+static struct rquota_stats *get_rquota(struct gsh_stats *stats)
 {
-	if (unlikely(stats->nfsv42 == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->nfsv42 == NULL)
-			stats->nfsv42 =
-			    gsh_calloc(sizeof(struct nfsv41_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->nfsv42;
+	return get_stats_slots((void **)&stats->rquota,
+			       STATS_SLOT_SIZE(struct rquota_stats));
+}
+
+static struct nfsv40_stats *get_v40(struct gsh_stats *stats)
+{
+	return get_stats_slots((void **)&stats->nfsv40,
+			       STATS_SLOT_SIZE(struct nfsv40_stats));
+}
+
+static struct nfsv41_stats *get_v41(struct gsh_stats *stats)
+{
+	return get_stats_slots((void **)&stats->nfsv41,
+			       STATS_SLOT_SIZE(struct nfsv41_stats));
+}
+
+static struct nfsv41_stats *get_v42(struct gsh_stats *stats)
+{
+	return get_stats_slots((void **)&stats->nfsv42,
+			       STATS_SLOT_SIZE(struct nfsv41_stats));
 }
 
 #ifdef _USE_9P
-static struct _9p_stats *get_9p(struct gsh_stats *stats, pthread_rwlock_t *lock)
+static struct _9p_stats *get_9p(struct gsh_stats *stats)
 {
-	if (unlikely(stats->_9p == NULL)) {
-		PTHREAD_RWLOCK_wrlock(lock);
-		if (stats->_9p == NULL)
-			stats->_9p = gsh_calloc(sizeof(struct _9p_stats), 1);
-		PTHREAD_RWLOCK_unlock(lock);
-	}
-	return stats->_9p;
+	return get_stats_slots((void **)&stats->_9p,
+			       STATS_SLOT_SIZE(struct _9p_stats));
 }
 #endif
 
+/**
+ * @brief Size the stats slots and set up the global stats
+ *
+ * Called once at startup, before any worker runs.
+ */
+
+void server_stats_pkginit(void)
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+
+	if (ncpu < 1)
+		ncpu = 1;
+	stats_nslots = MIN(ncpu, STATS_MAX_SLOTS);
+	global_st = alloc_stats_slots(STATS_SLOT_SIZE(struct global_stats));
+	if (global_st == NULL)
+		LogFatal(COMPONENT_INIT,
+			 "Unable to allocate %" PRIu32 " global stats slots",
+			 stats_nslots);
+}
+
 /* Functions for recording statistics
  */
 
+/**
+ * @brief Map a latency to its histogram bucket
+ *
+ * @param ns [IN] latency in nsecs
+ *
+ * @return bucket index.
+ */
+
+static inline int lat_hist_index(nsecs_elapsed_t ns)
+{
+	int shift;
+
+	if (ns < (1ULL << LAT_HIST_MIN_SHIFT))
+		return 0;
+	shift = 63 - __builtin_clzll(ns);
+	if (shift >= LAT_HIST_MAX_SHIFT)
+		return LAT_HIST_BUCKETS - 1;
+	return 1 + (shift - LAT_HIST_MIN_SHIFT) * LAT_HIST_SUB +
+	    ((ns >> (shift - LAT_HIST_SUB_BITS)) & (LAT_HIST_SUB - 1));
+}
+
+static inline void record_hist(struct lat_hist *hist, nsecs_elapsed_t ns)
+{
+	(void)atomic_inc_uint64_t(&hist->bucket[lat_hist_index(ns)]);
+}
+
+/**
+ * @brief Fold a sample into min/max
+ *
+ * Lost races would leave a stale min or max forever, so retry
+ * until our value is either stored or beaten.
+ *
+ * @param lat [IN] latency struct to update
+ * @param ns  [IN] sample
+ */
+
+static inline void record_min_max(struct op_latency *lat, nsecs_elapsed_t ns)
+{
+	uint64_t cur;
+
+	cur = atomic_fetch_uint64_t(&lat->min);
+	while ((cur == 0L || cur > ns) &&
+	       !atomic_cas_uint64_t(&lat->min, cur, ns))
+		cur = atomic_fetch_uint64_t(&lat->min);
+
+	cur = atomic_fetch_uint64_t(&lat->max);
+	while (cur < ns && !atomic_cas_uint64_t(&lat->max, cur, ns))
+		cur = atomic_fetch_uint64_t(&lat->max);
+}
+
 /**
  * @brief Record latency stats
  *
  * @param op           [IN] protocol op stats struct
+ * @param hist         [IN] its histograms, NULL if unavailable
  * @param request_time [IN] time consumed by request
  * @param qwait_time   [IN] time sitting on queue
  * @param dup          [IN] detected this was a dup request
  */
-void record_latency(struct proto_op *op, nsecs_elapsed_t request_time,
+void record_latency(struct proto_op *op, struct op_hist *hist,
+		    nsecs_elapsed_t request_time,
 		    nsecs_elapsed_t qwait_time, bool dup)
 {
 
 	/* dup latency is counted separately */
 	if (likely(!dup)) {
 		(void)atomic_add_uint64_t(&op->latency.latency, request_time);
-		if (op->latency.min == 0L || op->latency.min > request_time)
-			(void)atomic_store_uint64_t(&op->latency.min,
-						    request_time);
-		if (op->latency.max == 0L || op->latency.max < request_time)
-			(void)atomic_store_uint64_t(&op->latency.max,
-						    request_time);
+		record_min_max(&op->latency, request_time);
+		if (hist != NULL)
+			record_hist(&hist->latency, request_time);
 	} else {
 		(void)atomic_add_uint64_t(&op->dup_latency.latency,
 					  request_time);
-		if (op->dup_latency.min == 0L
-		    || op->dup_latency.min > request_time)
-			(void)atomic_store_uint64_t(&op->dup_latency.min,
-						    request_time);
-		if (op->dup_latency.max == 0L
-		    || op->dup_latency.max < request_time)
-			(void)atomic_store_uint64_t(&op->dup_latency.max,
-						    request_time);
+		record_min_max(&op->dup_latency, request_time);
 	}
 	/* record how long it was laying around waiting ... */
 	(void)atomic_add_uint64_t(&op->queue_latency.latency, qwait_time);
-	if (op->queue_latency.min == 0L || op->queue_latency.min > qwait_time)
-		(void)atomic_store_uint64_t(&op->queue_latency.min, qwait_time);
-	if (op->queue_latency.max == 0L || op->queue_latency.max < qwait_time)
-		(void)atomic_store_uint64_t(&op->queue_latency.max, qwait_time);
+	record_min_max(&op->queue_latency, qwait_time);
+	if (hist != NULL)
+		record_hist(&hist->queue, qwait_time);
 }
 
 /**
@@ -601,34 +820,33 @@ static void record_io(struct xfer_op *iop, size_t requested, size_t transferred,
  * @brief record i/o stats by protocol
  */
 
-static void record_io_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			    size_t requested,
+static void record_io_stats(struct gsh_stats *gsh_st, size_t requested,
 			    size_t transferred, bool success, bool is_write)
 {
 	struct xfer_op *iop = NULL;
 
 	if (op_ctx->req_type == NFS_REQUEST) {
 		if (op_ctx->nfs_vers == NFS_V3) {
-			struct nfsv3_stats *sp = get_v3(gsh_st, lock);
+			struct nfsv3_stats *sp = get_v3(gsh_st);
 
 			if (sp == NULL)
 				return;
 			iop = is_write ? &sp->write : &sp->read;
 		} else if (op_ctx->nfs_vers == NFS_V4) {
 			if (op_ctx->nfs_minorvers == 0) {
-				struct nfsv40_stats *sp = get_v40(gsh_st, lock);
+				struct nfsv40_stats *sp = get_v40(gsh_st);
 
 				if (sp == NULL)
 					return;
 				iop = is_write ? &sp->write : &sp->read;
 			} else if (op_ctx->nfs_minorvers == 1) {
-				struct nfsv41_stats *sp = get_v41(gsh_st, lock);
+				struct nfsv41_stats *sp = get_v41(gsh_st);
 
 				if (sp == NULL)
 					return;
 				iop = is_write ? &sp->write : &sp->read;
 			} else if (op_ctx->nfs_minorvers == 2) {
-				struct nfsv41_stats *sp = get_v42(gsh_st, lock);
+				struct nfsv41_stats *sp = get_v42(gsh_st);
 
 				if (sp == NULL)
 					return;
@@ -640,7 +858,7 @@ static void record_io_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 		}
 #ifdef _USE_9P
 	} else if (op_ctx->req_type == _9P_REQUEST) {
-		struct _9p_stats *sp = get_9p(gsh_st, lock);
+		struct _9p_stats *sp = get_9p(gsh_st);
 
 		if (sp == NULL)
 			return;
@@ -655,18 +873,19 @@ static void record_io_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
 /**
  * @brief count the protocol operation
  *
- * Use atomic ops to avoid locks. We don't lock for the max
- * and min because if there is a collision, over the long haul,
- * the error is near zero...
+ * Use atomic ops to avoid locks.  The counters are in this
+ * thread's stats slot so they are rarely shared with other cpus.
  *
  * @param op           [IN] pointer to specific protocol struct
+ * @param hist         [IN] its histograms, NULL if unavailable
  * @param request_time [IN] wallclock time (nsecs) for this op
  * @param qwait_time   [IN] wallclock time (nsecs) waiting for service
  * @param success      [IN] protocol error code == OK
  * @param dup          [IN] true if op was detected duplicate
  */
 
-static void record_op(struct proto_op *op, nsecs_elapsed_t request_time,
+static void record_op(struct proto_op *op, struct op_hist *hist,
+		      nsecs_elapsed_t request_time,
 		      nsecs_elapsed_t qwait_time, bool success, bool dup)
 {
 	/* count the op */
@@ -676,7 +895,7 @@ static void record_op(struct proto_op *op, nsecs_elapsed_t request_time,
 		(void)atomic_inc_uint64_t(&op->errors);
 	if (unlikely(dup))
 		(void)atomic_inc_uint64_t(&op->dups);
-	record_latency(op, request_time, qwait_time, dup);
+	record_latency(op, hist, request_time, qwait_time, dup);
 }
 
 /**
@@ -714,72 +933,90 @@ static void record_layout(struct nfsv41_stats *sp, int proto_op, int status)
  * @brief Record NFS V4 compound stats
  */
 
-static void record_nfsv4_op(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			    int proto_op, int minorversion,
+static void record_nfsv4_op(struct gsh_stats *gsh_st, int proto_op,
+			    int minorversion,
 			    nsecs_elapsed_t request_time,
 			    nsecs_elapsed_t qwait_time, int status)
 {
 	if (minorversion == 0) {
-		struct nfsv40_stats *sp = get_v40(gsh_st, lock);
+		struct nfsv40_stats *sp = get_v40(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		switch (nfsv40_optype[proto_op]) {
 		case READ_OP:
-			record_latency(&sp->read.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sp->read.cmd,
+				       get_hist(gsh_st, HIST_NFSV40,
+						HIST_OP_READ),
+				       request_time, qwait_time, false);
 			break;
 		case WRITE_OP:
-			record_latency(&sp->write.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sp->write.cmd,
+				       get_hist(gsh_st, HIST_NFSV40,
+						HIST_OP_WRITE),
+				       request_time, qwait_time, false);
 			break;
 		default:
-			record_op(&sp->compounds, request_time, qwait_time,
+			record_op(&sp->compounds,
+				  get_hist(gsh_st, HIST_NFSV40, HIST_OP_CMDS),
+				  request_time, qwait_time,
 				  status == NFS4_OK, false);
 		}
 	} else if (minorversion == 1) {
-		struct nfsv41_stats *sp = get_v41(gsh_st, lock);
+		struct nfsv41_stats *sp = get_v41(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		switch (nfsv41_optype[proto_op]) {
 		case READ_OP:
-			record_latency(&sp->read.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sp->read.cmd,
+				       get_hist(gsh_st, HIST_NFSV41,
+						HIST_OP_READ),
+				       request_time, qwait_time, false);
 			break;
 		case WRITE_OP:
-			record_latency(&sp->write.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sp->write.cmd,
+				       get_hist(gsh_st, HIST_NFSV41,
+						HIST_OP_WRITE),
+				       request_time, qwait_time, false);
 			break;
 		case LAYOUT_OP:
 			record_layout(sp, proto_op, status);
 			break;
 		default:
-			record_op(&sp->compounds, request_time, qwait_time,
+			record_op(&sp->compounds,
+				  get_hist(gsh_st, HIST_NFSV41, HIST_OP_CMDS),
+				  request_time, qwait_time,
 				  status == NFS4_OK, false);
 		}
 	} else if (minorversion == 2) {
-		struct nfsv41_stats *sp = get_v42(gsh_st, lock);
+		struct nfsv41_stats *sp = get_v42(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		switch (nfsv42_optype[proto_op]) {
 		case READ_OP:
-			record_latency(&sp->read.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sp->read.cmd,
+				       get_hist(gsh_st, HIST_NFSV42,
+						HIST_OP_READ),
+				       request_time, qwait_time, false);
 			break;
 		case WRITE_OP:
-			record_latency(&sp->write.cmd, request_time, qwait_time,
-				       false);
+			record_latency(&sp->write.cmd,
+				       get_hist(gsh_st, HIST_NFSV42,
+						HIST_OP_WRITE),
+				       request_time, qwait_time, false);
 			break;
 		case LAYOUT_OP:
 			record_layout(sp, proto_op, status);
 			break;
 		default:
-			record_op(&sp->compounds, request_time, qwait_time,
+			record_op(&sp->compounds,
+				  get_hist(gsh_st, HIST_NFSV42, HIST_OP_CMDS),
+				  request_time, qwait_time,
 				  status == NFS4_OK, false);
 		}
 	}
@@ -790,38 +1027,41 @@ static void record_nfsv4_op(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
  * @brief Record NFS V4 compound stats
  */
 
-static void record_compound(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			    int minorversion, uint64_t num_ops,
+static void record_compound(struct gsh_stats *gsh_st, int minorversion,
+			    uint64_t num_ops,
 			    nsecs_elapsed_t request_time,
 			    nsecs_elapsed_t qwait_time, bool success)
 {
 	if (minorversion == 0) {
 
-		struct nfsv40_stats *sp = get_v40(gsh_st, lock);
+		struct nfsv40_stats *sp = get_v40(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->compounds, request_time, qwait_time, success,
-			  false);
+		record_op(&sp->compounds,
+			  get_hist(gsh_st, HIST_NFSV40, HIST_OP_CMDS),
+			  request_time, qwait_time, success, false);
 		(void)atomic_add_uint64_t(&sp->ops_per_compound, num_ops);
 	} else if (minorversion == 1) {
-		struct nfsv41_stats *sp = get_v41(gsh_st, lock);
+		struct nfsv41_stats *sp = get_v41(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->compounds, request_time, qwait_time, success,
-			  false);
+		record_op(&sp->compounds,
+			  get_hist(gsh_st, HIST_NFSV41, HIST_OP_CMDS),
+			  request_time, qwait_time, success, false);
 		(void)atomic_add_uint64_t(&sp->ops_per_compound, num_ops);
 	} else if (minorversion == 2) {
-		struct nfsv41_stats *sp = get_v42(gsh_st, lock);
+		struct nfsv41_stats *sp = get_v42(gsh_st);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->compounds, request_time, qwait_time, success,
-			  false);
+		record_op(&sp->compounds,
+			  get_hist(gsh_st, HIST_NFSV42, HIST_OP_CMDS),
+			  request_time, qwait_time, success, false);
 		(void)atomic_add_uint64_t(&sp->ops_per_compound, num_ops);
 	}
 
@@ -834,7 +1074,6 @@ static void record_compound(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
  * Once we found the stats block, do the update(s).
  *
  * @param gsh_st       [IN] stats struct from client or export
- * @param lock         [IN] lock on client|export for malloc
  * @param reqdata      [IN] info about the proto request
  * @param success      [IN] the op returned OK (or error)
  * @param request_time [IN] time consumed by request
@@ -842,87 +1081,109 @@ static void record_compound(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
  * @param dup          [IN] detected this was a dup request
  */
 
-static void record_stats(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
-			 request_data_t *reqdata, bool success,
+static void record_stats(struct gsh_stats *gsh_st, request_data_t *reqdata,
+			 bool success,
 			 nsecs_elapsed_t request_time,
 			 nsecs_elapsed_t qwait_time, bool dup, bool global)
 {
 	struct svc_req *req = &reqdata->r_u.nfs->req;
 	uint32_t proto_op = req->rq_proc;
+	struct global_stats *gsp = get_global();
 
 	if (req->rq_prog == nfs_param.core_param.program[P_NFS]) {
 		if (proto_op == 0)
 			return;	/* we don't count NULL ops */
 		if (req->rq_vers == NFS_V3) {
-			struct nfsv3_stats *sp = get_v3(gsh_st, lock);
+			struct nfsv3_stats *sp = get_v3(gsh_st);
 
 			if (sp == NULL)
 				return;
 			/* record stuff */
 			if (global)
-				record_op(&global_st.nfsv3.cmds, request_time,
-					  qwait_time, success, dup);
+				record_op(&gsp->nfsv3.cmds,
+					  GLOBAL_HIST(HIST_NFSV3,
+						      HIST_OP_CMDS),
+					  request_time, qwait_time, success,
+					  dup);
 			switch (nfsv3_optype[proto_op]) {
 			case READ_OP:
-				record_latency(&sp->read.cmd, request_time,
-					       qwait_time, dup);
+				record_latency(&sp->read.cmd,
+					       get_hist(gsh_st, HIST_NFSV3,
+							HIST_OP_READ),
+					       request_time, qwait_time, dup);
 				break;
 			case WRITE_OP:
-				record_latency(&sp->write.cmd, request_time,
-					       qwait_time, dup);
+				record_latency(&sp->write.cmd,
+					       get_hist(gsh_st, HIST_NFSV3,
+							HIST_OP_WRITE),
+					       request_time, qwait_time, dup);
 				break;
 			default:
-				record_op(&sp->cmds, request_time, qwait_time,
-					  success, dup);
+				record_op(&sp->cmds,
+					  get_hist(gsh_st, HIST_NFSV3,
+						   HIST_OP_CMDS),
+					  request_time, qwait_time, success,
+					  dup);
 			}
 		} else {
 			/* We don't do V4 here and V2 is toast */
 			return;
 		}
 	} else if (req->rq_prog == nfs_param.core_param.program[P_MNT]) {
-		struct mnt_stats *sp = get_mnt(gsh_st, lock);
+		struct mnt_stats *sp = get_mnt(gsh_st);
 
 		if (global && req->rq_vers == MOUNT_V1)
-			record_op(&global_st.mnt.v1_ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->mnt.v1_ops,
+				  GLOBAL_HIST(HIST_MNT, HIST_OP_MNT_V1),
+				  request_time, qwait_time, success, dup);
 		else if (global)
-			record_op(&global_st.mnt.v3_ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->mnt.v3_ops,
+				  GLOBAL_HIST(HIST_MNT, HIST_OP_MNT_V3),
+				  request_time, qwait_time, success, dup);
 
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		if (req->rq_vers == MOUNT_V1)
-			record_op(&sp->v1_ops, request_time, qwait_time,
-				  success, dup);
+			record_op(&sp->v1_ops,
+				  get_hist(gsh_st, HIST_MNT, HIST_OP_MNT_V1),
+				  request_time, qwait_time, success, dup);
 		else
-			record_op(&sp->v3_ops, request_time, qwait_time,
-				  success, dup);
+			record_op(&sp->v3_ops,
+				  get_hist(gsh_st, HIST_MNT, HIST_OP_MNT_V3),
+				  request_time, qwait_time, success, dup);
 	} else if (req->rq_prog == nfs_param.core_param.program[P_NLM]) {
-		struct nlmv4_stats *sp = get_nlm4(gsh_st, lock);
+		struct nlmv4_stats *sp = get_nlm4(gsh_st);
 
 		if (global)
-			record_op(&global_st.nlm4.ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->nlm4.ops,
+				  GLOBAL_HIST(HIST_NLM4, HIST_OP_CMDS),
+				  request_time, qwait_time, success, dup);
 		if (sp == NULL)
 			return;
 		/* record stuff */
-		record_op(&sp->ops, request_time, qwait_time, success, dup);
+		record_op(&sp->ops, get_hist(gsh_st, HIST_NLM4, HIST_OP_CMDS),
+			  request_time, qwait_time, success, dup);
 	} else if (req->rq_prog == nfs_param.core_param.program[P_RQUOTA]) {
-		struct rquota_stats *sp = get_rquota(gsh_st, lock);
+		struct rquota_stats *sp = get_rquota(gsh_st);
 
 		if (global)
-			record_op(&global_st.rquota.ops, request_time,
-				  qwait_time, success, dup);
+			record_op(&gsp->rquota.ops,
+				  GLOBAL_HIST(HIST_RQUOTA, HIST_OP_RQUOTA),
+				  request_time, qwait_time, success, dup);
 		if (sp == NULL)
 			return;
 		/* record stuff */
 		if (req->rq_vers == RQUOTAVERS)
-			record_op(&sp->ops, request_time, qwait_time, success,
-				  dup);
+			record_op(&sp->ops,
+				  get_hist(gsh_st, HIST_RQUOTA,
+					   HIST_OP_RQUOTA),
+				  request_time, qwait_time, success, dup);
 		else
-			record_op(&sp->ext_ops, request_time, qwait_time,
-				  success, dup);
+			record_op(&sp->ext_ops,
+				  get_hist(gsh_st, HIST_RQUOTA,
+					   HIST_OP_RQUOTA_EXT),
+				  request_time, qwait_time, success, dup);
 	}
 }
 
@@ -963,7 +1224,7 @@ void server_stats_transport_done(struct gsh_client *client,
 {
 	struct server_stats *server_st =
 		container_of(client, struct server_stats, client);
-	struct _9p_stats *sp = get_9p(&server_st->st, &client->lock);
+	struct _9p_stats *sp = get_9p(&server_st->st);
 
 	if (sp != NULL)
 		record_transport_stats(&sp->trans, rx_bytes, rx_pkt, rx_err,
@@ -984,28 +1245,32 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 	nsecs_elapsed_t stop_time;
 	struct svc_req *req = &reqdata->r_u.nfs->req;
 	uint32_t proto_op = req->rq_proc;
+	struct global_stats *gsp = get_global();
 
 	if (req->rq_prog == NFS_PROGRAM && op_ctx->nfs_vers == NFS_V3)
-			global_st.v3.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->v3.op[proto_op]);
 	else if (req->rq_prog == nfs_param.core_param.program[P_NLM])
-		global_st.lm.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->lm.op[proto_op]);
 	else if (req->rq_prog == nfs_param.core_param.program[P_MNT])
-		global_st.mn.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->mn.op[proto_op]);
 	else if (req->rq_prog == nfs_param.core_param.program[P_RQUOTA])
-		global_st.qt.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->qt.op[proto_op]);
 
 	if (nfs_param.core_param.enable_FASTSTATS)
 		return;
 
 	now(&current_time);
 	stop_time = timespec_diff(&ServerBootTime, &current_time);
+	if (!dup && req->rq_prog == NFS_PROGRAM &&
+	    op_ctx->nfs_vers == NFS_V3)
+		record_hist(&global_hist.v3[proto_op],
+			    stop_time - op_ctx->start_time);
 	if (client != NULL) {
 		struct server_stats *server_st;
 		server_st = container_of(client, struct server_stats, client);
-		record_stats(&server_st->st, &client->lock, reqdata,
+		record_stats(&server_st->st, reqdata, rc == NFS_REQ_OK,
 			     stop_time - op_ctx->start_time,
-			     op_ctx->queue_wait,
-			     rc == NFS_REQ_OK, dup, true);
+			     op_ctx->queue_wait, dup, true);
 		(void)atomic_store_uint64_t(&client->last_update, stop_time);
 	}
 	if (!dup && op_ctx->export != NULL) {
@@ -1013,9 +1278,9 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_stats(&exp_st->st, &op_ctx->export->lock, reqdata,
+		record_stats(&exp_st->st, reqdata, rc == NFS_REQ_OK,
 			     stop_time - op_ctx->start_time,
-			     op_ctx->queue_wait, rc == NFS_REQ_OK, dup, false);
+			     op_ctx->queue_wait, dup, false);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
 					    stop_time);
 	}
@@ -1032,43 +1297,51 @@ void server_stats_nfsv4_op_done(int proto_op,
 				nsecs_elapsed_t start_time, int status)
 {
 	struct gsh_client *client = op_ctx->client;
+	struct global_stats *gsp = get_global();
 	struct timespec current_time;
 	nsecs_elapsed_t stop_time;
 
 	if (op_ctx->nfs_vers == NFS_V4)
-		global_st.v4.op[proto_op]++;
+		(void)atomic_inc_uint64_t(&gsp->v4.op[proto_op]);
 
 	if (nfs_param.core_param.enable_FASTSTATS)
 		return;
 
 	now(&current_time);
 	stop_time = timespec_diff(&ServerBootTime, &current_time);
+	record_hist(&global_hist.v4[proto_op], stop_time - start_time);
 
 	if (client != NULL) {
 		struct server_stats *server_st;
 		server_st = container_of(client, struct server_stats, client);
-		record_nfsv4_op(&server_st->st, &client->lock, proto_op,
+		record_nfsv4_op(&server_st->st, proto_op,
 				op_ctx->nfs_minorvers, stop_time - start_time,
 				op_ctx->queue_wait, status);
 		(void)atomic_store_uint64_t(&client->last_update, stop_time);
 	}
 
 	if (op_ctx->nfs_minorvers == 0)
-		record_op(&global_st.nfsv40.compounds, stop_time - start_time,
-			  op_ctx->queue_wait, status == NFS4_OK, false);
+		record_op(&gsp->nfsv40.compounds,
+			  GLOBAL_HIST(HIST_NFSV40, HIST_OP_CMDS),
+			  stop_time - start_time, op_ctx->queue_wait,
+			  status == NFS4_OK, false);
 	else if (op_ctx->nfs_minorvers == 1)
-		record_op(&global_st.nfsv41.compounds, stop_time - start_time,
-			  op_ctx->queue_wait, status == NFS4_OK, false);
+		record_op(&gsp->nfsv41.compounds,
+			  GLOBAL_HIST(HIST_NFSV41, HIST_OP_CMDS),
+			  stop_time - start_time, op_ctx->queue_wait,
+			  status == NFS4_OK, false);
 	else if (op_ctx->nfs_minorvers == 2)
-		record_op(&global_st.nfsv42.compounds, stop_time - start_time,
-			  op_ctx->queue_wait, status == NFS4_OK, false);
+		record_op(&gsp->nfsv42.compounds,
+			  GLOBAL_HIST(HIST_NFSV42, HIST_OP_CMDS),
+			  stop_time - start_time, op_ctx->queue_wait,
+			  status == NFS4_OK, false);
 
 	if (op_ctx->export != NULL) {
 		struct export_stats *exp_st;
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_nfsv4_op(&exp_st->st, &op_ctx->export->lock, proto_op,
+		record_nfsv4_op(&exp_st->st, proto_op,
 				op_ctx->nfs_minorvers, stop_time - start_time,
 				op_ctx->queue_wait, status);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
@@ -1094,8 +1367,7 @@ void server_stats_compound_done(int num_ops, int status)
 	if (client != NULL) {
 		struct server_stats *server_st;
 		server_st = container_of(client, struct server_stats, client);
-		record_compound(&server_st->st, &client->lock,
-				op_ctx->nfs_minorvers,
+		record_compound(&server_st->st, op_ctx->nfs_minorvers,
 				num_ops, stop_time - op_ctx->start_time,
 				op_ctx->queue_wait, status == NFS4_OK);
 		(void)atomic_store_uint64_t(&client->last_update, stop_time);
@@ -1105,8 +1377,7 @@ void server_stats_compound_done(int num_ops, int status)
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_compound(&exp_st->st, &op_ctx->export->lock,
-				op_ctx->nfs_minorvers, num_ops,
+		record_compound(&exp_st->st, op_ctx->nfs_minorvers, num_ops,
 				stop_time - op_ctx->start_time,
 				op_ctx->queue_wait, status == NFS4_OK);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
@@ -1130,23 +1401,154 @@ void server_stats_io_done(size_t requested,
 
 		server_st = container_of(op_ctx->client, struct server_stats,
 					 client);
-		record_io_stats(&server_st->st, &op_ctx->client->lock,
-				requested, transferred, success,
-				is_write);
+		record_io_stats(&server_st->st, requested, transferred,
+				success, is_write);
 	}
 	if (op_ctx->export != NULL) {
 		struct export_stats *exp_st;
 
 		exp_st =
 		    container_of(op_ctx->export, struct export_stats, export);
-		record_io_stats(&exp_st->st, &op_ctx->export->lock,
-				requested, transferred, success, is_write);
+		record_io_stats(&exp_st->st, requested, transferred,
+				success, is_write);
 	}
 	return;
 }
 
 #ifdef USE_DBUS
 
+/* Functions for folding the stats slots together
+ */
+
+static void merge_latency(struct op_latency *dst,
+			  const struct op_latency *src)
+{
+	dst->latency += src->latency;
+	if (src->min != 0 && (dst->min == 0 || src->min < dst->min))
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+static void merge_proto_op(struct proto_op *dst, const struct proto_op *src)
+{
+	dst->total += src->total;
+	dst->errors += src->errors;
+	dst->dups += src->dups;
+	merge_latency(&dst->latency, &src->latency);
+	merge_latency(&dst->dup_latency, &src->dup_latency);
+	merge_latency(&dst->queue_latency, &src->queue_latency);
+}
+
+static void merge_xfer(struct xfer_op *dst, const struct xfer_op *src)
+{
+	merge_proto_op(&dst->cmd, &src->cmd);
+	dst->requested += src->requested;
+	dst->transferred += src->transferred;
+}
+
+static void merge_layout(struct layout_op *dst, const struct layout_op *src)
+{
+	dst->total += src->total;
+	dst->errors += src->errors;
+	dst->delays += src->delays;
+}
+
+static void merge_v3(struct nfsv3_stats *dst, const struct nfsv3_stats *src)
+{
+	merge_proto_op(&dst->cmds, &src->cmds);
+	merge_xfer(&dst->read, &src->read);
+	merge_xfer(&dst->write, &src->write);
+}
+
+static void merge_mnt(struct mnt_stats *dst, const struct mnt_stats *src)
+{
+	merge_proto_op(&dst->v1_ops, &src->v1_ops);
+	merge_proto_op(&dst->v3_ops, &src->v3_ops);
+}
+
+static void merge_nlm4(struct nlmv4_stats *dst,
+		       const struct nlmv4_stats *src)
+{
+	merge_proto_op(&dst->ops, &src->ops);
+}
+
+static void merge_rquota(struct rquota_stats *dst,
+			 const struct rquota_stats *src)
+{
+	merge_proto_op(&dst->ops, &src->ops);
+	merge_proto_op(&dst->ext_ops, &src->ext_ops);
+}
+
+static void merge_v40(struct nfsv40_stats *dst,
+		      const struct nfsv40_stats *src)
+{
+	merge_proto_op(&dst->compounds, &src->compounds);
+	dst->ops_per_compound += src->ops_per_compound;
+	merge_xfer(&dst->read, &src->read);
+	merge_xfer(&dst->write, &src->write);
+}
+
+/* also used for v4.2 */
+static void merge_v41(struct nfsv41_stats *dst,
+		      const struct nfsv41_stats *src)
+{
+	merge_proto_op(&dst->compounds, &src->compounds);
+	dst->ops_per_compound += src->ops_per_compound;
+	merge_xfer(&dst->read, &src->read);
+	merge_xfer(&dst->write, &src->write);
+	merge_layout(&dst->getdevinfo, &src->getdevinfo);
+	merge_layout(&dst->layout_get, &src->layout_get);
+	merge_layout(&dst->layout_commit, &src->layout_commit);
+	merge_layout(&dst->layout_return, &src->layout_return);
+	merge_layout(&dst->recall, &src->recall);
+}
+
+static void merge_9p(struct _9p_stats *dst, const struct _9p_stats *src)
+{
+	merge_proto_op(&dst->cmds, &src->cmds);
+	merge_xfer(&dst->read, &src->read);
+	merge_xfer(&dst->write, &src->write);
+	dst->trans.rx_bytes += src->trans.rx_bytes;
+	dst->trans.rx_pkt += src->trans.rx_pkt;
+	dst->trans.rx_err += src->trans.rx_err;
+	dst->trans.tx_bytes += src->trans.tx_bytes;
+	dst->trans.tx_pkt += src->trans.tx_pkt;
+	dst->trans.tx_err += src->trans.tx_err;
+}
+
+/**
+ * @brief Fold a per-slot array into one struct
+ *
+ * @param dst   [OUT] struct to fill
+ * @param slots [IN] per-slot array as stored in struct gsh_stats
+ * @param type  [IN] struct type of the elements
+ * @param merge [IN] merge_* function for the type
+ */
+
+#define FOLD_SLOTS(dst, slots, type, merge)				\
+	do {								\
+		uint32_t __slot;					\
+									\
+		memset((dst), 0, sizeof(type));				\
+		for (__slot = 0; __slot < stats_nslots; __slot++)	\
+			merge((dst), STATS_SLOT(slots, type, __slot));	\
+	} while (0)
+
+/**
+ * @brief Sum one counter over all slots of a per-slot array
+ */
+
+#define SUM_SLOTS(slots, type, field)					\
+	({								\
+		uint64_t __sum = 0;					\
+		uint32_t __slot;					\
+									\
+		for (__slot = 0; __slot < stats_nslots; __slot++)	\
+			__sum += STATS_SLOT(slots, type, __slot)->field; \
+		__sum;							\
+	})
+
 /* Functions for marshalling statistics to DBUS
  */
 
@@ -1263,8 +1665,9 @@ static void server_dbus_transportstats(struct transport_stats *tstats,
 
 void server_dbus_total(struct export_stats *export_st, DBusMessageIter *iter)
 {
+	struct gsh_stats *st = &export_st->st;
 	DBusMessageIter struct_iter;
-	uint64_t total = 0;
+	uint64_t total;
 	char *version;
 
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
@@ -1273,45 +1676,37 @@ void server_dbus_total(struct export_stats *export_st, DBusMessageIter *iter)
 	version = "NFSv3";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	if (export_st->st.nfsv3 == NULL)
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&total);
-	else
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv3->cmds.total);
+	total = st->nfsv3 == NULL ? 0 :
+		SUM_SLOTS(st->nfsv3, struct nfsv3_stats, cmds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NFSv40";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	if (export_st->st.nfsv40 == NULL)
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&total);
-	else
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv40->compounds.total);
+	total = st->nfsv40 == NULL ? 0 :
+		SUM_SLOTS(st->nfsv40, struct nfsv40_stats,
+			  compounds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NFSv41";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	if (export_st->st.nfsv41 == NULL)
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&total);
-	else
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv41->compounds.total);
+	total = st->nfsv41 == NULL ? 0 :
+		SUM_SLOTS(st->nfsv41, struct nfsv41_stats,
+			  compounds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NFSv42";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	if (export_st->st.nfsv42 == NULL)
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&total);
-	else
-		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-				&export_st->st.nfsv42->compounds.total);
+	total = st->nfsv42 == NULL ? 0 :
+		SUM_SLOTS(st->nfsv42, struct nfsv41_stats,
+			  compounds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
 void global_dbus_total(DBusMessageIter *iter)
 {
 	DBusMessageIter struct_iter;
+	uint64_t total;
 	char *version;
 
 	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
@@ -1320,49 +1715,50 @@ void global_dbus_total(DBusMessageIter *iter)
 	version = "NFSv3";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv3.cmds.total);
+	total = SUM_SLOTS(global_st, struct global_stats, nfsv3.cmds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NFSv40";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv40.compounds.total);
+	total = SUM_SLOTS(global_st, struct global_stats, nfsv40.compounds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NFSv41";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv41.compounds.total);
+	total = SUM_SLOTS(global_st, struct global_stats, nfsv41.compounds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NFSv42";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nfsv42.compounds.total);
+	total = SUM_SLOTS(global_st, struct global_stats, nfsv42.compounds.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "NLM4";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.nlm4.ops.total);
+	total = SUM_SLOTS(global_st, struct global_stats, nlm4.ops.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "MNTv1";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.mnt.v1_ops.total);
+	total = SUM_SLOTS(global_st, struct global_stats, mnt.v1_ops.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "MNTv3";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.mnt.v3_ops.total);
+	total = SUM_SLOTS(global_st, struct global_stats, mnt.v3_ops.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	version = "RQUOTA";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
-	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
-					&global_st.rquota.ops.total);
+	total = SUM_SLOTS(global_st, struct global_stats, rquota.ops.total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &total);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
 void global_dbus_fast(DBusMessageIter *iter)
 {
 	DBusMessageIter struct_iter;
+	uint64_t total;
 	char *version;
 	char *op;
 	int i;
@@ -1374,60 +1770,65 @@ void global_dbus_fast(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < NFSPROC3_COMMIT; i++) {
-		if (global_st.v3.op[i] > 0) {
+		total = SUM_SLOTS(global_st, struct global_stats, v3.op[i]);
+		if (total > 0) {
 			op = optabv3[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.v3.op[i]);
+					DBUS_TYPE_UINT64, &total);
 		}
 	}
 	version = "\nNFSv4:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < NFS4_OP_IO_ADVISE; i++) {
-		if (global_st.v4.op[i] > 0) {
+		total = SUM_SLOTS(global_st, struct global_stats, v4.op[i]);
+		if (total > 0) {
 			op = optabv4[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.v4.op[i]);
+					DBUS_TYPE_UINT64, &total);
 		}
 	}
 	version = "\nNLM:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < NLM4_FAILED; i++) {
-		if (global_st.lm.op[i] > 0) {
+		total = SUM_SLOTS(global_st, struct global_stats, lm.op[i]);
+		if (total > 0) {
 			op = optnlm[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.lm.op[i]);
+					DBUS_TYPE_UINT64, &total);
 		}
 	}
 	version = "\nMNT:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < MOUNTPROC3_EXPORT; i++) {
-		if (global_st.mn.op[i] > 0) {
+		total = SUM_SLOTS(global_st, struct global_stats, mn.op[i]);
+		if (total > 0) {
 			op = optmnt[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.mn.op[i]);
+					DBUS_TYPE_UINT64, &total);
 		}
 	}
 	version = "\nQUOTA:";
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
 				       &version);
 	for (i = 0; i < RQUOTAPROC_SETACTIVEQUOTA; i++) {
-		if (global_st.qt.op[i] > 0) {
+		total = SUM_SLOTS(global_st, struct global_stats, qt.op[i]);
+		if (total > 0) {
 			op = optqta[i].name;
 			dbus_message_iter_append_basic(&struct_iter,
 					DBUS_TYPE_STRING, &op);
 			dbus_message_iter_append_basic(&struct_iter,
-					DBUS_TYPE_UINT64, &global_st.qt.op[i]);
+					DBUS_TYPE_UINT64, &total);
 		}
 	}
 	dbus_message_iter_close_container(iter, &struct_iter);
@@ -1436,41 +1837,49 @@ void global_dbus_fast(DBusMessageIter *iter)
 void server_dbus_v3_iostats(struct nfsv3_stats *v3p, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv3_stats sum;
 
+	FOLD_SLOTS(&sum, v3p, struct nfsv3_stats, merge_v3);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v3p->read, iter);
-	server_dbus_iostats(&v3p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
 void server_dbus_v40_iostats(struct nfsv40_stats *v40p, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv40_stats sum;
 
+	FOLD_SLOTS(&sum, v40p, struct nfsv40_stats, merge_v40);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v40p->read, iter);
-	server_dbus_iostats(&v40p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
 void server_dbus_v41_iostats(struct nfsv41_stats *v41p, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	FOLD_SLOTS(&sum, v41p, struct nfsv41_stats, merge_v41);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v41p->read, iter);
-	server_dbus_iostats(&v41p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
 void server_dbus_v42_iostats(struct nfsv41_stats *v42p, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	FOLD_SLOTS(&sum, v42p, struct nfsv41_stats, merge_v41);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&v42p->read, iter);
-	server_dbus_iostats(&v42p->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
 void server_dbus_total_ops(struct export_stats *export_st,
@@ -1501,6 +1910,205 @@ void global_dbus_total_ops(DBusMessageIter *iter)
 	global_dbus_total(iter);
 }
 
+/**
+ * @brief Upper bound (exclusive, nsecs) of a histogram bucket
+ *
+ * @param idx [IN] bucket index
+ *
+ * @return the bound, UINT64_MAX for the overflow bucket.
+ */
+
+static uint64_t lat_hist_bound(int idx)
+{
+	int shift, sub;
+
+	if (idx == 0)
+		return 1ULL << LAT_HIST_MIN_SHIFT;
+	if (idx == LAT_HIST_BUCKETS - 1)
+		return UINT64_MAX;
+	shift = LAT_HIST_MIN_SHIFT + (idx - 1) / LAT_HIST_SUB;
+	sub = (idx - 1) % LAT_HIST_SUB;
+	return (uint64_t)(LAT_HIST_SUB + sub + 1) <<
+	    (shift - LAT_HIST_SUB_BITS);
+}
+
+/**
+ * @brief Report one latency histogram as a struct
+ *
+ * struct latency_histogram {
+ *	char *name;
+ *	uint64_t count;
+ *	uint64_t p50;
+ *	uint64_t p99;
+ *	uint64_t p999;
+ *	uint64_t buckets[];
+ * }
+ *
+ * Percentiles are reported as the upper bound of the bucket they
+ * fall in.  Empty histograms are skipped.
+ *
+ * @param array_iter [IN] array iterator to add the struct to
+ * @param name       [IN] name of the series
+ * @param hist       [IN] histogram to report
+ */
+
+static void server_dbus_hist(DBusMessageIter *array_iter, char *name,
+			     struct lat_hist *hist)
+{
+	static const uint32_t permille[LAT_HIST_NPCT] = { 500, 990, 999 };
+	DBusMessageIter struct_iter, bucket_iter;
+	uint64_t buckets[LAT_HIST_BUCKETS];
+	uint64_t count = 0, seen = 0, target, pct;
+	int i, p = 0;
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		buckets[i] = atomic_fetch_uint64_t(&hist->bucket[i]);
+		count += buckets[i];
+	}
+	if (count == 0)
+		return;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &count);
+	for (i = 0; i < LAT_HIST_BUCKETS && p < LAT_HIST_NPCT; i++) {
+		seen += buckets[i];
+		target = (count * permille[p] + 999) / 1000;
+		while (p < LAT_HIST_NPCT && seen >= target) {
+			pct = lat_hist_bound(i);
+			dbus_message_iter_append_basic(&struct_iter,
+						       DBUS_TYPE_UINT64, &pct);
+			if (++p < LAT_HIST_NPCT)
+				target = (count * permille[p] + 999) / 1000;
+		}
+	}
+	dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY,
+					 DBUS_TYPE_UINT64_AS_STRING,
+					 &bucket_iter);
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		dbus_message_iter_append_basic(&bucket_iter, DBUS_TYPE_UINT64,
+					       &buckets[i]);
+	dbus_message_iter_close_container(&struct_iter, &bucket_iter);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report service and queue wait histograms of a proto op
+ */
+
+static void server_dbus_proto_hist(DBusMessageIter *array_iter,
+				   const char *name, struct op_hist *hist)
+{
+	char series[64];
+
+	snprintf(series, sizeof(series), "%s", name);
+	server_dbus_hist(array_iter, series, &hist->latency);
+	snprintf(series, sizeof(series), "%s qwait", name);
+	server_dbus_hist(array_iter, series, &hist->queue);
+}
+
+/* series names of the histograms, by protocol and HIST_OP_* */
+
+static const char *const hist_names[HIST_PROTOS][PROTO_HIST_OPS] = {
+	[HIST_NFSV3] = {"NFSv3", "NFSv3 read", "NFSv3 write"},
+	[HIST_NFSV40] = {"NFSv40", "NFSv40 read", "NFSv40 write"},
+	[HIST_NFSV41] = {"NFSv41", "NFSv41 read", "NFSv41 write"},
+	[HIST_NFSV42] = {"NFSv42", "NFSv42 read", "NFSv42 write"},
+	[HIST_MNT] = {"MNTv1", "MNTv3", NULL},
+	[HIST_NLM4] = {"NLM4", NULL, NULL},
+	[HIST_RQUOTA] = {"RQUOTA", "RQUOTA ext", NULL},
+	[HIST_9P] = {"9P", "9P read", "9P write"},
+};
+
+/**
+ * @brief Report the bucket bounds and the per protocol histograms
+ *
+ * @param hists      [IN] histograms by protocol, NULL where unused
+ * @param iter       [IN] reply iterator
+ * @param array_iter [OUT] opened histogram array, caller closes it
+ */
+
+static void server_dbus_stats_hist(struct proto_hists *const *hists,
+				   DBusMessageIter *iter,
+				   DBusMessageIter *array_iter)
+{
+	DBusMessageIter bound_iter;
+	struct proto_hists *ph;
+	uint64_t bound;
+	int i, proto, op;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 DBUS_TYPE_UINT64_AS_STRING,
+					 &bound_iter);
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		bound = lat_hist_bound(i);
+		dbus_message_iter_append_basic(&bound_iter, DBUS_TYPE_UINT64,
+					       &bound);
+	}
+	dbus_message_iter_close_container(iter, &bound_iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(stttat)",
+					 array_iter);
+	for (proto = 0; proto < HIST_PROTOS; proto++) {
+		ph = atomic_fetch_voidptr((void **)&hists[proto]);
+		if (ph == NULL)
+			continue;
+		for (op = 0; op < PROTO_HIST_OPS; op++) {
+			if (hist_names[proto][op] == NULL)
+				break;
+			server_dbus_proto_hist(array_iter,
+					       hist_names[proto][op],
+					       &ph->op[op]);
+		}
+	}
+}
+
+void server_dbus_latency(struct gsh_stats *st, DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	server_dbus_stats_hist(st->hist, iter, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report global latency histograms
+ *
+ * Same as server_dbus_latency plus one series per NFSv3 procedure
+ * and NFSv4 operation.
+ */
+
+void global_dbus_latency(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter;
+	struct proto_hists *hists[HIST_PROTOS];
+	char series[64];
+	int op;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	for (op = 0; op < HIST_PROTOS; op++)
+		hists[op] = &global_hist.proto[op];
+	server_dbus_stats_hist(hists, iter, &array_iter);
+
+	for (op = 1; op < NFS_V3_NB_COMMAND; op++) {
+		snprintf(series, sizeof(series), "NFSv3 %s",
+			 optabv3[op].name);
+		server_dbus_hist(&array_iter, series, &global_hist.v3[op]);
+	}
+	for (op = NFS4_OP_ACCESS; op < NFS_V42_NB_OPERATION; op++) {
+		snprintf(series, sizeof(series), "NFSv4 %s",
+			 optabv4[op].name);
+		server_dbus_hist(&array_iter, series, &global_hist.v4[op]);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
 void cache_inode_dbus_show(DBusMessageIter *iter)
 {
 	struct timespec timestamp;
@@ -1536,27 +2144,150 @@ void cache_inode_dbus_show(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 					&cache_st.inode_mapping);
+	type = "cache_reclaim";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_reclaim);
+	type = "cache_ghost_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_ghost_hit);
 
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
+/**
+ * @brief Report per-NUMA-node occupancy of the inode cache
+ *
+ * One (node, entries, L1, L2, probation, pinned, cleanup) struct per
+ * node.
+ */
+
+void cache_inode_dbus_show_nodes(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter, struct_iter;
+	struct lru_node_stats st;
+	uint32_t node;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(utttttt)",
+					 &array_iter);
+	for (node = 0; node < cache_inode_lru_nodes(); node++) {
+		cache_inode_lru_node_stats(node, &st);
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+					       &node);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.entries_used);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.l1);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.l2);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.probation);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.pinned);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st.cleanup);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report occupancy and misses of the I/O buffer pool
+ *
+ * The heap fallback count for oversize requests, then one (size,
+ * in_use, cached, allocs, misses) struct per size class.
+ */
+
+void bufpool_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter, struct_iter;
+	struct bufpool_class_stats st[BUFPOOL_N_CLASSES];
+	uint64_t oversize;
+	int i;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	oversize = gsh_bufpool_stats(st);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &oversize);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(ttttt)",
+					 &array_iter);
+	for (i = 0; i < BUFPOOL_N_CLASSES; i++) {
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st[i].size);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st[i].in_use);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st[i].cached);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st[i].allocs);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &st[i].misses);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report duplicate request cache counters
+ *
+ * Hits, retransmits of requests still in progress, misses, evictions
+ * and cached entries, summed over all DRCs, then the number of TCP
+ * DRCs and how many of them wait on the recycle queues.
+ */
+
+void drc_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	struct drc_stats st;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	nfs_dupreq_stats(&st);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &st.hits);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64,
+				       &st.in_progress);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &st.misses);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &st.evictions);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &st.entries);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &st.tcp_drcs);
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64,
+				       &st.tcp_recycled);
+}
+
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct _9p_stats sum;
 
+	FOLD_SLOTS(&sum, _9pp, struct _9p_stats, merge_9p);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_iostats(&_9pp->read, iter);
-	server_dbus_iostats(&_9pp->write, iter);
+	server_dbus_iostats(&sum.read, iter);
+	server_dbus_iostats(&sum.write, iter);
 }
 
 void server_dbus_9p_transstats(struct _9p_stats *_9pp, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct _9p_stats sum;
 
+	FOLD_SLOTS(&sum, _9pp, struct _9p_stats, merge_9p);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_transportstats(&_9pp->trans, iter);
+	server_dbus_transportstats(&sum.trans, iter);
 }
 
 /**
@@ -1590,27 +2321,31 @@ static void server_dbus_layouts(struct layout_op *lop, DBusMessageIter *iter)
 void server_dbus_v41_layouts(struct nfsv41_stats *v41p, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	FOLD_SLOTS(&sum, v41p, struct nfsv41_stats, merge_v41);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_layouts(&v41p->getdevinfo, iter);
-	server_dbus_layouts(&v41p->layout_get, iter);
-	server_dbus_layouts(&v41p->layout_commit, iter);
-	server_dbus_layouts(&v41p->layout_return, iter);
-	server_dbus_layouts(&v41p->recall, iter);
+	server_dbus_layouts(&sum.getdevinfo, iter);
+	server_dbus_layouts(&sum.layout_get, iter);
+	server_dbus_layouts(&sum.layout_commit, iter);
+	server_dbus_layouts(&sum.layout_return, iter);
+	server_dbus_layouts(&sum.recall, iter);
 }
 
 void server_dbus_v42_layouts(struct nfsv41_stats *v42p, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
+	struct nfsv41_stats sum;
 
+	FOLD_SLOTS(&sum, v42p, struct nfsv41_stats, merge_v41);
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
-	server_dbus_layouts(&v42p->getdevinfo, iter);
-	server_dbus_layouts(&v42p->layout_get, iter);
-	server_dbus_layouts(&v42p->layout_commit, iter);
-	server_dbus_layouts(&v42p->layout_return, iter);
-	server_dbus_layouts(&v42p->recall, iter);
+	server_dbus_layouts(&sum.getdevinfo, iter);
+	server_dbus_layouts(&sum.layout_get, iter);
+	server_dbus_layouts(&sum.layout_commit, iter);
+	server_dbus_layouts(&sum.layout_return, iter);
+	server_dbus_layouts(&sum.recall, iter);
 }
 
 #endif				/* USE_DBUS */
@@ -1626,6 +2361,8 @@ void server_dbus_v42_layouts(struct nfsv41_stats *v42p, DBusMessageIter *iter)
 
 void server_stats_free(struct gsh_stats *statsp)
 {
+	int i;
+
 	if (statsp->nfsv3 != NULL) {
 		gsh_free(statsp->nfsv3);
 		statsp->nfsv3 = NULL;
@@ -1658,6 +2395,10 @@ void server_stats_free(struct gsh_stats *statsp)
 		gsh_free(statsp->_9p);
 		statsp->_9p = NULL;
 	}
+	for (i = 0; i < HIST_PROTOS; i++) {
+		gsh_free(statsp->hist[i]);
+		statsp->hist[i] = NULL;
+	}
 }
 
 /** @} */
@@ -0,0 +1,166 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "interval_tree.h"
+
+#define NODES 2000
+#define ROUNDS 20000
+#define SPACE 10000
+
+struct range {
+	int value;
+	struct itree_node node;
+};
+
+static struct range ranges[NODES];
+static struct itree tree;
+static int failures;
+
+#define CHECK(cond, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			printf(__VA_ARGS__);				\
+			failures++;					\
+		}							\
+	} while (0)
+
+/* Check AVL balance, ordering, parents and max_end; return height */
+static int check_node(struct itree_node *node, struct itree_node *parent)
+{
+	int hl, hr;
+	uint64_t max_end;
+
+	if (node == NULL)
+		return 0;
+
+	CHECK(node->parent == parent, "bad parent at %llu\n",
+	      (unsigned long long)node->start);
+	if (node->left != NULL)
+		CHECK(node->left->start <= node->start, "bad order\n");
+	if (node->right != NULL)
+		CHECK(node->right->start >= node->start, "bad order\n");
+
+	hl = check_node(node->left, node);
+	hr = check_node(node->right, node);
+
+	CHECK(hl - hr <= 1 && hr - hl <= 1, "unbalanced at %llu\n",
+	      (unsigned long long)node->start);
+	CHECK(node->height == 1 + (hl > hr ? hl : hr), "bad height\n");
+
+	max_end = node->end;
+	if (node->left != NULL && node->left->max_end > max_end)
+		max_end = node->left->max_end;
+	if (node->right != NULL && node->right->max_end > max_end)
+		max_end = node->right->max_end;
+	CHECK(node->max_end == max_end, "bad max_end at %llu\n",
+	      (unsigned long long)node->start);
+
+	return node->height;
+}
+
+/* Compare an overlap query against a scan of every linked node */
+static void check_query(uint64_t start, uint64_t end)
+{
+	struct itree_node *node;
+	char seen[NODES];
+	uint64_t last = 0;
+	int i, found = 0, expected = 0;
+
+	memset(seen, 0, sizeof(seen));
+
+	itree_for_each_overlap(node, &tree, start, end) {
+		struct range *r = itree_container_of(node, struct range, node);
+
+		CHECK(node->start <= end && start <= node->end,
+		      "%d does not overlap\n", r->value);
+		CHECK(node->start >= last, "out of order\n");
+		CHECK(!seen[r->value], "%d seen twice\n", r->value);
+		seen[r->value] = 1;
+		last = node->start;
+		found++;
+	}
+
+	for (i = 0; i < NODES; i++) {
+		struct itree_node *n = &ranges[i].node;
+
+		if (itree_node_linked(n) && n->start <= end &&
+		    start <= n->end) {
+			expected++;
+			CHECK(seen[i], "missed %d\n", i);
+		}
+	}
+
+	CHECK(found == expected, "found %d expected %d\n", found, expected);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t linked = 0;
+	int i;
+
+	srandom(argc > 1 ? atoi(argv[1]) : 1);
+	itree_init(&tree);
+
+	for (i = 0; i < NODES; i++)
+		ranges[i].value = i;
+
+	for (i = 0; i < ROUNDS && failures == 0; i++) {
+		struct range *r = &ranges[random() % NODES];
+		uint64_t start = random() % SPACE;
+
+		if (itree_node_linked(&r->node)) {
+			itree_remove(&tree, &r->node);
+			linked--;
+		} else {
+			r->node.start = start;
+			r->node.end = start + random() % (SPACE / 20);
+			/* Exercise lock-to-EOF style ranges too */
+			if (random() % 50 == 0)
+				r->node.end = UINT64_MAX;
+			itree_insert(&tree, &r->node);
+			linked++;
+		}
+
+		CHECK(tree.size == linked, "size %llu expected %llu\n",
+		      (unsigned long long)tree.size,
+		      (unsigned long long)linked);
+
+		if (i % 100 == 0)
+			(void)check_node(tree.root, NULL);
+
+		start = random() % SPACE;
+		check_query(start, start + random() % (SPACE / 10));
+	}
+
+	check_query(0, UINT64_MAX);
+	check_query(UINT64_MAX, UINT64_MAX);
+
+	if (failures != 0) {
+		printf("FAILED: %d errors\n", failures);
+		return 1;
+	}
+
+	printf("PASSED\n");
+	return 0;
+}
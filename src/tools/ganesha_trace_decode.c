@@ -0,0 +1,334 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file ganesha_trace_decode.c
+ * @brief Offline decoder for the request trace rings
+ *
+ * Reads the ganesha-<pid>-<n>.trace files written when
+ * Trace_Directory is set, joins the events of each request across
+ * the threads that handled it and prints where its time went:
+ *
+ *   ganesha_trace_decode [-r] [-s usec] file...
+ *
+ * -r dumps the records one per line instead, -s only shows requests
+ * that took at least usec microseconds from decode to send.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#define NFS_TRACE_FORMAT_ONLY
+#include "nfs_trace.h"
+
+static const char *event_names[NFS_TRACE_EVENT_COUNT] = {
+	[NFS_TRACE_DECODE] = "decode",
+	[NFS_TRACE_ENQUEUE] = "enqueue",
+	[NFS_TRACE_DEQUEUE] = "dequeue",
+	[NFS_TRACE_FSAL_ENTER] = "fsal_enter",
+	[NFS_TRACE_FSAL_EXIT] = "fsal_exit",
+	[NFS_TRACE_ENCODE] = "encode",
+	[NFS_TRACE_SEND] = "send",
+};
+
+static const char *fsal_op_names[NFS_TRACE_FSAL_OP_COUNT] = {
+	[NFS_TRACE_FSAL_GETATTRS] = "getattrs",
+	[NFS_TRACE_FSAL_SETATTRS] = "setattrs",
+	[NFS_TRACE_FSAL_LOOKUP] = "lookup",
+	[NFS_TRACE_FSAL_READDIR] = "readdir",
+	[NFS_TRACE_FSAL_OPEN] = "open",
+	[NFS_TRACE_FSAL_READ] = "read",
+	[NFS_TRACE_FSAL_WRITE] = "write",
+	[NFS_TRACE_FSAL_COMMIT] = "commit",
+	[NFS_TRACE_FSAL_CREATE] = "create",
+	[NFS_TRACE_FSAL_UNLINK] = "unlink",
+	[NFS_TRACE_FSAL_RENAME] = "rename",
+};
+
+static struct nfs_trace_rec *recs;
+static size_t nrecs;
+static size_t recs_alloc;
+
+/**
+ * @brief Append the live records of one ring file to recs
+ *
+ * @param[in] path The file
+ *
+ * @return 0 or -1 if the file is unreadable or not a ring.
+ */
+
+static int load_ring(const char *path)
+{
+	struct nfs_trace_hdr hdr;
+	uint64_t count, i;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1
+	    || hdr.magic != NFS_TRACE_MAGIC
+	    || hdr.version != NFS_TRACE_VERSION
+	    || hdr.rec_size != sizeof(struct nfs_trace_rec)
+	    || hdr.nrecs == 0) {
+		fprintf(stderr, "%s: not a version %d trace file\n", path,
+			NFS_TRACE_VERSION);
+		fclose(f);
+		return -1;
+	}
+
+	/* Once the ring wrapped every slot holds a live record, and the
+	 * order they are read in does not matter since they get sorted.
+	 */
+	count = hdr.head < hdr.nrecs ? hdr.head : hdr.nrecs;
+	if (nrecs + count > recs_alloc) {
+		recs_alloc = (nrecs + count) * 2;
+		recs = realloc(recs, recs_alloc * sizeof(*recs));
+		if (recs == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < count; i++) {
+		struct nfs_trace_rec *rec = &recs[nrecs];
+
+		if (fread(rec, sizeof(*rec), 1, f) != 1)
+			break;
+		/* Skip slots caught half written */
+		if (rec->id == 0 || rec->event == 0
+		    || rec->event >= NFS_TRACE_EVENT_COUNT)
+			continue;
+		nrecs++;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static int rec_cmp(const void *a, const void *b)
+{
+	const struct nfs_trace_rec *ra = a, *rb = b;
+
+	if (ra->id != rb->id)
+		return ra->id < rb->id ? -1 : 1;
+	if (ra->ts != rb->ts)
+		return ra->ts < rb->ts ? -1 : 1;
+	return (int)ra->event - (int)rb->event;
+}
+
+static const char *fmt_client(const struct nfs_trace_rec *rec, char *buf,
+			      size_t len)
+{
+	char addr[INET6_ADDRSTRLEN];
+	int family;
+
+	if (rec->family == AF_INET)
+		family = AF_INET;
+	else if (rec->family == AF_INET6)
+		family = AF_INET6;
+	else
+		return "-";
+
+	if (inet_ntop(family, rec->addr, addr, sizeof(addr)) == NULL)
+		return "-";
+	snprintf(buf, len, "%s:%u", addr, rec->port);
+	return buf;
+}
+
+static void print_raw(const struct nfs_trace_rec *rec)
+{
+	char client[INET6_ADDRSTRLEN + 8];
+
+	printf("%" PRIu64 ".%09" PRIu64 " %016" PRIx64 " %-10s ",
+	       rec->ts / 1000000000, rec->ts % 1000000000, rec->id,
+	       event_names[rec->event]);
+
+	switch (rec->event) {
+	case NFS_TRACE_DECODE:
+		printf("xid=%u prog=%u vers=%u proc=%u client=%s\n",
+		       rec->xid, rec->prog, rec->vers, rec->op,
+		       fmt_client(rec, client, sizeof(client)));
+		break;
+	case NFS_TRACE_FSAL_ENTER:
+	case NFS_TRACE_FSAL_EXIT:
+		printf("%s\n", rec->op < NFS_TRACE_FSAL_OP_COUNT
+		       && fsal_op_names[rec->op] ? fsal_op_names[rec->op]
+		       : "?");
+		break;
+	case NFS_TRACE_ENCODE:
+		printf("export=%u\n", rec->export_id);
+		break;
+	case NFS_TRACE_SEND:
+		printf("status=%d\n", rec->status);
+		break;
+	default:
+		printf("\n");
+		break;
+	}
+}
+
+/* Microseconds between two stages, or -1 if either is missing */
+static int64_t stage_us(uint64_t from, uint64_t to)
+{
+	if (from == 0 || to == 0 || to < from)
+		return -1;
+	return (to - from) / 1000;
+}
+
+static void print_us(int64_t us)
+{
+	if (us < 0)
+		printf(" %10s", "-");
+	else
+		printf(" %10" PRId64, us);
+}
+
+/**
+ * @brief Print one line per request for recs[first..last)
+ */
+
+static void print_request(size_t first, size_t last, int64_t min_us)
+{
+	const struct nfs_trace_rec *decode = NULL;
+	uint64_t ts[NFS_TRACE_EVENT_COUNT] = { 0 };
+	uint64_t fsal_ns = 0, fsal_enter = 0;
+	int32_t status = 0;
+	uint16_t export_id = 0;
+	char client[INET6_ADDRSTRLEN + 8];
+	size_t i;
+
+	for (i = first; i < last; i++) {
+		const struct nfs_trace_rec *rec = &recs[i];
+
+		switch (rec->event) {
+		case NFS_TRACE_DECODE:
+			decode = rec;
+			break;
+		case NFS_TRACE_FSAL_ENTER:
+			fsal_enter = rec->ts;
+			break;
+		case NFS_TRACE_FSAL_EXIT:
+			if (fsal_enter != 0 && rec->ts >= fsal_enter)
+				fsal_ns += rec->ts - fsal_enter;
+			fsal_enter = 0;
+			break;
+		case NFS_TRACE_ENCODE:
+			export_id = rec->export_id;
+			break;
+		case NFS_TRACE_SEND:
+			status = rec->status;
+			break;
+		}
+		/* The first enqueue and dequeue, the last of the rest */
+		if (ts[rec->event] == 0
+		    || (rec->event != NFS_TRACE_ENQUEUE
+			&& rec->event != NFS_TRACE_DEQUEUE))
+			ts[rec->event] = rec->ts;
+	}
+
+	/* Requests whose decode fell off the ring tell too little */
+	if (decode == NULL)
+		return;
+	if (min_us > 0 && stage_us(ts[NFS_TRACE_DECODE],
+				   ts[NFS_TRACE_SEND]) < min_us)
+		return;
+
+	printf("%016" PRIx64 " %10u %6u/%u/%-3u %6u %-24s",
+	       decode->id, decode->xid, decode->prog, decode->vers,
+	       decode->op, export_id,
+	       fmt_client(decode, client, sizeof(client)));
+	print_us(stage_us(ts[NFS_TRACE_DECODE], ts[NFS_TRACE_SEND]));
+	print_us(stage_us(ts[NFS_TRACE_DECODE], ts[NFS_TRACE_ENQUEUE]));
+	print_us(stage_us(ts[NFS_TRACE_ENQUEUE], ts[NFS_TRACE_DEQUEUE]));
+	print_us(stage_us(ts[NFS_TRACE_DEQUEUE], ts[NFS_TRACE_ENCODE]));
+	print_us(fsal_ns / 1000);
+	print_us(stage_us(ts[NFS_TRACE_ENCODE], ts[NFS_TRACE_SEND]));
+	printf(" %6d\n", status);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-r] [-s usec] file...\n"
+		"  -r       dump records instead of per request stages\n"
+		"  -s usec  only requests slower than usec microseconds\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int64_t min_us = 0;
+	int raw = 0;
+	size_t i, first;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "rs:")) != -1) {
+		switch (opt) {
+		case 'r':
+			raw = 1;
+			break;
+		case 's':
+			min_us = strtoll(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind >= argc)
+		usage(argv[0]);
+
+	for (; optind < argc; optind++)
+		(void)load_ring(argv[optind]);
+
+	if (nrecs == 0)
+		return 0;
+
+	qsort(recs, nrecs, sizeof(*recs), rec_cmp);
+
+	if (raw) {
+		for (i = 0; i < nrecs; i++)
+			print_raw(&recs[i]);
+		return 0;
+	}
+
+	printf("%-16s %10s %-12s %6s %-24s %10s %10s %10s %10s %10s %10s"
+	       " %6s\n", "id", "xid", "prog/v/proc", "export", "client",
+	       "total_us", "decode_us", "queue_us", "exec_us", "fsal_us",
+	       "send_us", "status");
+
+	for (first = 0, i = 1; i <= nrecs; i++) {
+		if (i < nrecs && recs[i].id == recs[first].id)
+			continue;
+		print_request(first, i, min_us);
+		first = i;
+	}
+
+	free(recs);
+	return 0;
+}